@@ -14,7 +14,7 @@
 #include <aducpal/stdlib.h> // setenv
 #include <aducpal/unistd.h> // getegid, geteuid, getuid, setuid
 
-#include <unordered_map>
+#include <exception>
 #include <vector>
 
 #include "aduc/aduc_banned.h"
@@ -251,26 +251,57 @@ void ShowChildProcessLogs(const std::string& output)
     }
 }
 
+/**
+ * @brief An update type and the task function that handles it.
+ */
+struct ADUShellTaskEntry
+{
+    const char* updateType;
+    ADUShellTaskResult (*task)(const ADUShell_LaunchArguments&);
+};
+
 /**
  * @brief Starts a child process for task(s) for a given update actions.
  */
 int ADUShell_Dowork(const ADUShell_LaunchArguments& launchArgs)
 {
+    // A fixed table, so no map (and no std::function objects) is built on every launch.
+    static const ADUShellTaskEntry taskTable[] = {
+        { adushconst::update_type_common, CommonTasks::DoCommonTask },
+        { adushconst::update_type_microsoft_apt, AptGetTasks::DoAptGetTask },
+        { adushconst::update_type_microsoft_script, ScriptTasks::DoScriptTask },
+        { adushconst::update_type_fus_update, FUSUpdateTasks::DoFUSUpdateTask }
+    };
+
     ADUShellTaskResult taskResult;
+    bool found = false;
 
-    try
+    for (const ADUShellTaskEntry& entry : taskTable)
     {
-        const std::unordered_map<std::string, ADUShellTaskFuncType> actionMap = {
-            { adushconst::update_type_common, CommonTasks::DoCommonTask },
-            { adushconst::update_type_microsoft_apt, AptGetTasks::DoAptGetTask },
-            { adushconst::update_type_microsoft_script, ScriptTasks::DoScriptTask },
-            { adushconst::update_type_fus_update, FUSUpdateTasks::DoFUSUpdateTask }
-        };
+        if (strcmp(entry.updateType, launchArgs.updateType) == 0)
+        {
+            found = true;
 
-        ADUShellTaskFuncType task = actionMap.at(std::string(launchArgs.updateType));
-        taskResult = task(launchArgs);
+            // A task that throws exits with the same status as before the table lookup replaced the map.
+            try
+            {
+                taskResult = entry.task(launchArgs);
+            }
+            catch (const std::exception& e)
+            {
+                Log_Error("Task for update type '%s' failed: %s", launchArgs.updateType, e.what());
+                taskResult.SetExitStatus(ADUSHELL_EXIT_UNSUPPORTED);
+            }
+            catch (...)
+            {
+                Log_Error("Task for update type '%s' failed with an unknown exception.", launchArgs.updateType);
+                taskResult.SetExitStatus(ADUSHELL_EXIT_UNSUPPORTED);
+            }
+            break;
+        }
     }
-    catch (...)
+
+    if (!found)
     {
         Log_Error("Unknown update type: '%s'", launchArgs.updateType);
         taskResult.SetExitStatus(ADUSHELL_EXIT_UNSUPPORTED);
@@ -284,24 +315,32 @@ int ADUShell_Dowork(const ADUShell_LaunchArguments& launchArgs)
 /**
  * @brief Checking if the process has permission to run the adu shell operations
  *
+ * @details The caller's effective uid and gid are checked first; root is trusted without
+ * reading the configuration file or looking up any user or group records. Otherwise, only
+ * the trusted user list is read from the configuration file.
+ *
+ * @param configFolder The folder containing the configuration file.
  * @return true if the process is either in the trusted Group, or is one of the adu shell trusted users.
  * @return false otherwise
  */
-bool ADUShell_PermissionCheck()
+bool ADUShell_PermissionCheck(const char* configFolder)
 {
+    if (ADUCPAL_geteuid() == 0 || ADUCPAL_getegid() == 0)
+    {
+        return true;
+    }
+
     bool isTrusted = false;
 
     // If config file is provided, check if user is in trusted user list.
-    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
-    if (config != NULL)
+    VECTOR_HANDLE aduShellTrustedUsers = ADUC_ConfigInfo_ReadAduShellTrustedUsers(configFolder);
+    if (aduShellTrustedUsers != nullptr)
     {
-        VECTOR_HANDLE aduShellTrustedUsers = ADUC_ConfigInfo_GetAduShellTrustedUsers(config);
-
         isTrusted = VerifyProcessEffectiveUser(aduShellTrustedUsers);
 
         ADUC_ConfigInfo_FreeAduShellTrustedUsers(aduShellTrustedUsers);
+        VECTOR_destroy(aduShellTrustedUsers);
         aduShellTrustedUsers = nullptr;
-        ADUC_ConfigInfo_ReleaseInstance(config);
     }
 
     // If config file not provided or user not in the trusted users list, then
@@ -330,7 +369,6 @@ bool ADUShell_PermissionCheck()
 int main(int argc, char** argv)
 {
     ADUShell_LaunchArguments launchArgs;
-    const ADUC_ConfigInfo* config = NULL;
     uid_t defaultUserId = ADUCPAL_getuid();
     uid_t effectiveUserId = ADUCPAL_geteuid();
 
@@ -338,33 +376,26 @@ int main(int argc, char** argv)
     if (ret != 0)
     {
         printf("Failed to parse launch arguments.\n");
-        goto done;
+        return ret;
     }
 
     if (launchArgs.showVersion)
     {
         printf("%s\n", ADUC_VERSION);
-        ret = 0;
-        goto done;
+        return 0;
     }
 
+    // The log file is only created once something is logged at or above the requested level.
+    ADUC_Logging_InitDeferred(launchArgs.logLevel, "adu-shell");
+
     ADUCPAL_setenv(ADUC_CONFIG_FOLDER_ENV, launchArgs.configFolder, 1);
-    config = ADUC_ConfigInfo_GetInstance();
-    if (config == NULL)
-    {
-        Log_Error("Cannot read configuration from '%s' folder.", launchArgs.configFolder);
-        ret = EXIT_FAILURE;
-        goto done;
-    }
 
-    if (!ADUShell_PermissionCheck())
+    if (!ADUShell_PermissionCheck(launchArgs.configFolder))
     {
         ret = EPERM;
         goto done;
     }
 
-    ADUC_Logging_Init(launchArgs.logLevel, "adu-shell");
-
     Log_Debug("Update type: %s", launchArgs.updateType);
     Log_Debug("Update action: %s", launchArgs.updateAction);
     Log_Debug("Target data: %s", launchArgs.targetData);
@@ -379,7 +410,7 @@ int main(int argc, char** argv)
     ret = ADUCPAL_setuid(effectiveUserId);
     if (ret == 0)
     {
-        Log_Info(
+        Log_Debug(
             "Run as uid(%d), defaultUid(%d), effectiveUid(%d), effectiveGid(%d)",
             ADUCPAL_getuid(),
             defaultUserId,
@@ -388,13 +419,11 @@ int main(int argc, char** argv)
 
         ret = ADUShell_Dowork(launchArgs);
 
-        ADUC_Logging_Uninit();
-
         goto done;
     }
 
     Log_Error("Cannot set user identity. (code: %d, errno: %d)", ret, errno);
 done:
-    ADUC_ConfigInfo_ReleaseInstance(config);
+    ADUC_Logging_Uninit();
     return ret;
 }
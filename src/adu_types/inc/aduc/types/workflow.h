@@ -10,6 +10,7 @@
 
 #include <limits.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "aduc/result.h"
 #include "aduc/types/adu_core.h"
@@ -109,6 +110,9 @@ typedef struct tagADUC_WorkflowData
         LastReportedState; /**< Last state set for the workflow and may have been reported as per agent orchestration. */
     char* LastCompletedWorkflowId; /**< Last workflow id for deployment that completed successfully. */
 
+    char* LastAcceptedDesiredDigest; /**< Digest of the last desired update action handed to the workflow. */
+    int LastAckedDesiredVersion; /**< Twin version of the last acknowledged desired update action. */
+
     ADUC_UpdateActionCallbacks UpdateActionCallbacks; /**< Upper-level registration data; function pointers, etc. */
 
     bool IsRegistered; /**< True if UpdateActionCallbacks is valid and needs to be ultimately unregistered. */
@@ -117,6 +121,10 @@ typedef struct tagADUC_WorkflowData
 
     bool OperationCancelled; /**< Was the operation in progress requested to cancel? */
 
+    bool InstallStaged; /**< True while a downloaded deployment waits for the local install policy. */
+
+    time_t NextInstallPolicyCheckTime; /**< The earliest time the install policy of a staged deployment is evaluated. */
+
     ADUC_SystemRebootState SystemRebootState; /**< The system reboot state. */
 
     ADUC_AgentRestartState AgentRestartState; /**< The agent restart state. */
@@ -9,6 +9,7 @@
 #define ADUC_AGENT_WORKFLOW_H
 
 #include "aduc/types/workflow.h"
+#include <parson.h> // for JSON_Value
 #include <stdbool.h> // for bool
 
 EXTERN_C_BEGIN
@@ -16,7 +17,7 @@ EXTERN_C_BEGIN
 void ADUC_Workflow_DoWork(ADUC_WorkflowData* workflowData);
 
 void ADUC_Workflow_HandlePropertyUpdate(
-    ADUC_WorkflowData* currentWorkflowData, const unsigned char* propertyUpdateValue, bool forceUpdate);
+    ADUC_WorkflowData* currentWorkflowData, JSON_Value* propertyUpdateValue, bool forceUpdate);
 
 void ADUC_Workflow_HandleUpdateAction(ADUC_WorkflowData* workflowData);
 
@@ -69,6 +70,14 @@ void ADUC_Workflow_SetUpdateStateWithResult(
     ADUC_WorkflowData* workflowData, ADUCITF_State updateState, ADUC_Result result);
 void ADUC_Workflow_SetInstalledUpdateIdAndGoToIdle(ADUC_WorkflowData* workflowData, const char* updateId);
 
+//
+// Housekeeping
+//
+
+void ADUC_Workflow_StartHousekeeping(void);
+void ADUC_Workflow_StopHousekeeping(void);
+void ADUC_Workflow_WaitForHousekeeping(void);
+
 void ADUC_Workflow_DefaultDownloadProgressCallback(
     const char* workflowId,
     const char* fileId,
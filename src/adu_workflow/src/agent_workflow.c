@@ -23,9 +23,12 @@
 #include "aduc/config_utils.h"
 #include "aduc/download_handler_factory.h" // ADUC_DownloadHandlerFactory_LoadDownloadHandler
 #include "aduc/download_handler_plugin.h" // ADUC_DownloadHandlerPlugin_OnUpdateWorkflowCompleted
+#include "aduc/housekeeping_utils.h"
+#include "aduc/install_policy_utils.h"
 #include "aduc/logging.h"
 #include "aduc/parser_utils.h" // ADUC_FileEntity_Uninit
 #include "aduc/result.h"
+#include "aduc/self_profile_utils.h"
 #include "aduc/string_c_utils.h"
 #include "aduc/system_utils.h"
 #include "aduc/types/workflow.h"
@@ -33,6 +36,9 @@
 #include "aduc/workflow_utils.h"
 #include "root_key_util.h" // RootKeyUtility_GetReportingErc
 
+#include <aducpal/stdio.h> // ADUCPAL_rename
+#include <errno.h>
+#include <parson.h>
 #include <pthread.h>
 
 // fwd decl
@@ -45,6 +51,11 @@ void ADUC_Workflow_WorkCompletionCallback(const void* workCompletionToken, ADUC_
 //         - when asynchronously called (worker thread) it takes the lock
 static pthread_mutex_t s_workflow_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ * @brief The housekeeping queue for work after a deployment has completed, or NULL if not started.
+ */
+static ADUC_HousekeepingQueue* s_housekeepingQueue = NULL;
+
 static inline void s_workflow_lock(void)
 {
     pthread_mutex_lock(&s_workflow_mutex);
@@ -324,6 +335,160 @@ const ADUC_WorkflowHandlerMapEntry* GetWorkflowHandlerMapEntryForAction(ADUCITF_
     return entry;
 }
 
+/**
+ * @brief How often the install policy of a staged deployment is evaluated.
+ */
+#define INSTALL_POLICY_CHECK_INTERVAL_SECONDS 60
+
+/**
+ * @brief Evaluates the local install policy of the config.
+ *
+ * @param config The config info.
+ * @return true if install may run now, or if no install policy is configured.
+ */
+static bool IsInstallAllowedNow(const ADUC_ConfigInfo* config)
+{
+    ADUC_InstallPolicy policy;
+
+    // A malformed policy is logged and disabled, so it never blocks an install.
+    (void)ADUC_InstallPolicy_Init(&policy, config->installPolicy);
+
+    return ADUC_InstallPolicy_IsInstallAllowedNow(&policy);
+}
+
+/**
+ * @brief Stages the downloaded deployment if the local install policy does not allow install now.
+ * @remark Must be in a lock.
+ *
+ * @param workflowData The workflow data, after the Download step succeeded.
+ * @return true if the deployment was staged, and must not transition to install.
+ */
+static bool ADUC_Workflow_StageInstallIfNotAllowed(ADUC_WorkflowData* workflowData)
+{
+    bool staged = false;
+    char* stagedWorkflowId = NULL;
+    time_t stagedTime = 0;
+    const char* workflowId = workflow_peek_id(workflowData->WorkflowHandle);
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config == NULL || workflowId == NULL)
+    {
+        goto done;
+    }
+
+    if (IsInstallAllowedNow(config))
+    {
+        ADUC_InstallPolicy_RemoveStagedMarker(config->dataFolder);
+        goto done;
+    }
+
+    // The record outlives an agent restart. In that case, the re-run download step only revalidates
+    // the payloads already in the sandbox, and the deployment is staged again under its original time.
+    if (ADUC_InstallPolicy_ReadStagedMarker(config->dataFolder, &stagedWorkflowId, &stagedTime)
+        && strcmp(stagedWorkflowId, workflowId) == 0)
+    {
+        Log_Info("Deployment %s is still staged since %" PRIu64 ".", workflowId, (uint64_t)stagedTime);
+    }
+    else if (!ADUC_InstallPolicy_WriteStagedMarker(config->dataFolder, workflowId, time(NULL)))
+    {
+        Log_Warn("Could not persist staged deployment %s.", workflowId);
+    }
+
+    Log_Info("Deployment %s is staged. Install is deferred until the install policy allows it.", workflowId);
+
+    workflowData->InstallStaged = true;
+    workflowData->NextInstallPolicyCheckTime = time(NULL) + INSTALL_POLICY_CHECK_INTERVAL_SECONDS;
+    staged = true;
+
+done:
+    free(stagedWorkflowId);
+
+    if (config != NULL)
+    {
+        ADUC_ConfigInfo_ReleaseInstance(config);
+    }
+
+    return staged;
+}
+
+/**
+ * @brief Clears the staged state of the current deployment, e.g. when it is cancelled or replaced.
+ * @remark Must be in a lock.
+ *
+ * @param workflowData The workflow data.
+ */
+static void ADUC_Workflow_ClearStagedInstall(ADUC_WorkflowData* workflowData)
+{
+    workflowData->InstallStaged = false;
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config != NULL)
+    {
+        ADUC_InstallPolicy_RemoveStagedMarker(config->dataFolder);
+        ADUC_ConfigInfo_ReleaseInstance(config);
+    }
+}
+
+/**
+ * @brief Continues a staged deployment with its install steps, once the install policy allows it.
+ *
+ * @param workflowData The workflow data.
+ */
+static void ADUC_Workflow_ResumeStagedInstall(ADUC_WorkflowData* workflowData)
+{
+    s_workflow_lock();
+
+    // InstallStaged is also written by the worker threads, so it is only read in the lock.
+    if (!workflowData->InstallStaged)
+    {
+        goto done;
+    }
+
+    time_t now = time(NULL);
+    if (now < workflowData->NextInstallPolicyCheckTime)
+    {
+        goto done;
+    }
+
+    workflowData->NextInstallPolicyCheckTime = now + INSTALL_POLICY_CHECK_INTERVAL_SECONDS;
+
+    if (workflowData->WorkflowHandle == NULL
+        || ADUC_WorkflowData_GetLastReportedState(workflowData) != ADUCITF_State_DownloadSucceeded)
+    {
+        Log_Warn("Staged deployment is no longer current.");
+        ADUC_Workflow_ClearStagedInstall(workflowData);
+        goto done;
+    }
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config == NULL)
+    {
+        goto done;
+    }
+
+    bool installAllowed = IsInstallAllowedNow(config);
+    ADUC_ConfigInfo_ReleaseInstance(config);
+
+    if (!installAllowed)
+    {
+        goto done;
+    }
+
+    Log_Info(
+        "Install policy allows install of staged deployment %s.", workflow_peek_id(workflowData->WorkflowHandle));
+
+    ADUC_Workflow_ClearStagedInstall(workflowData);
+
+    const ADUC_WorkflowHandlerMapEntry* downloadEntry =
+        GetWorkflowHandlerMapEntryForAction(ADUCITF_WorkflowStep_Download);
+    workflow_set_current_workflowstep(workflowData->WorkflowHandle, downloadEntry->AutoTransitionWorkflowStepOnSuccess);
+
+    ADUC_Workflow_TransitionWorkflow(workflowData);
+
+done:
+    s_workflow_unlock();
+}
+
 /**
  * @brief Called regularly to allow for cooperative multitasking during work.
  *
@@ -336,6 +501,8 @@ void ADUC_Workflow_DoWork(ADUC_WorkflowData* workflowData)
     const ADUC_UpdateActionCallbacks* updateActionCallbacks = &(workflowData->UpdateActionCallbacks);
 
     updateActionCallbacks->DoWorkCallback(updateActionCallbacks->PlatformLayerHandle, workflowData);
+
+    ADUC_Workflow_ResumeStagedInstall(workflowData);
 }
 
 void ADUC_Workflow_HandleStartupWorkflowData(ADUC_WorkflowData* currentWorkflowData)
@@ -411,15 +578,16 @@ done:
  * @brief Handles updates to a 1 or more PnP Properties in the ADU Core interface.
  *
  * @param[in,out] currentWorkflowData The current ADUC_WorkflowData object.
- * @param[in] propertyUpdateValue The updated property value.
+ * @param[in] propertyUpdateValue The updated property value, as parsed from the twin. Ownership is transferred to the
+ * workflow, also on failure.
  * @param[in] forceUpdate Ensures that specifed @p propertyUpdateValue will be processed by force deferral if there is ongoing workflow processing.
  */
 void ADUC_Workflow_HandlePropertyUpdate(
-    ADUC_WorkflowData* currentWorkflowData, const unsigned char* propertyUpdateValue, bool forceUpdate)
+    ADUC_WorkflowData* currentWorkflowData, JSON_Value* propertyUpdateValue, bool forceUpdate)
 {
     ADUC_WorkflowHandle nextWorkflow;
 
-    ADUC_Result result = workflow_init((const char*)propertyUpdateValue, true /* shouldValidate */, &nextWorkflow);
+    ADUC_Result result = workflow_init_from_value(propertyUpdateValue, true /* shouldValidate */, &nextWorkflow);
 
     workflow_set_force_update(nextWorkflow, forceUpdate);
 
@@ -431,7 +599,7 @@ void ADUC_Workflow_HandlePropertyUpdate(
 
     if (IsAducResultCodeFailure(result.ResultCode))
     {
-        Log_Error("Invalid desired update action data. Update data: (%s)", propertyUpdateValue);
+        Log_Error("Invalid desired update action data, erc: 0x%08x", result.ExtendedResultCode);
 
         ADUC_Workflow_SetUpdateStateWithResult(currentWorkflowData, ADUCITF_State_Failed, result);
         return;
@@ -609,6 +777,13 @@ void ADUC_Workflow_HandleUpdateAction(ADUC_WorkflowData* workflowData)
 {
     unsigned int desiredAction = workflow_get_action(workflowData->WorkflowHandle);
 
+    // Any new action supersedes a deployment that is staged for install.
+    const bool wasInstallStaged = workflowData->InstallStaged;
+    if (wasInstallStaged)
+    {
+        ADUC_Workflow_ClearStagedInstall(workflowData);
+    }
+
     // Special case: Cancel is handled here.
     //
     // If Cancel action is received while another ProcessDeployment update action is in progress then the agent
@@ -656,6 +831,14 @@ void ADUC_Workflow_HandleUpdateAction(ADUC_WorkflowData* workflowData)
             workflow_set_cancellation_type(workflowData->WorkflowHandle, ADUC_WorkflowCancellationType_None);
 
             Log_Info("Cancel received with no operation in progress - returning to Idle state");
+
+            if (wasInstallStaged)
+            {
+                // A staged deployment still reports DownloadSucceeded, so report Idle explicitly.
+                ADUC_Result result = { .ResultCode = ADUC_Result_Idle_Success, .ExtendedResultCode = 0 };
+                ADUC_WorkflowData_SetCurrentAction(desiredAction, workflowData);
+                ADUC_Workflow_SetUpdateStateWithResult(workflowData, ADUCITF_State_Idle, result);
+            }
             goto done;
         }
         else
@@ -776,6 +959,12 @@ void ADUC_Workflow_AutoTransitionWorkflow(ADUC_WorkflowData* workflowData, bool
         {
             Log_Info("Workflow is Complete.");
         }
+        else if (
+            currentWorkflowStep == ADUCITF_WorkflowStep_Download
+            && ADUC_Workflow_StageInstallIfNotAllowed(workflowData))
+        {
+            // Payloads are downloaded and verified; ADUC_Workflow_DoWork continues with install later.
+        }
         else
         {
             workflow_set_current_workflowstep(
@@ -828,6 +1017,9 @@ void ADUC_Workflow_TransitionWorkflow(ADUC_WorkflowData* workflowData)
     Log_Debug("Setting operation_in_progress => true");
     workflow_set_operation_in_progress(workflowData->WorkflowHandle, true);
 
+    // Housekeeping yields to the workflow while an operation is in progress.
+    ADUC_HousekeepingQueue_SetPaused(s_housekeepingQueue, true);
+
     // Perform an update operation.
     result = entry->OperationFunc(methodCallData);
 
@@ -872,6 +1064,8 @@ void ADUC_Workflow_WorkCompletionCallback(const void* workCompletionToken, ADUC_
         s_workflow_lock();
     }
 
+    ADUC_HousekeepingQueue_SetPaused(s_housekeepingQueue, false);
+
     ADUCITF_WorkflowStep currentWorkflowStep = workflow_get_current_workflowstep(workflowData->WorkflowHandle);
 
     const ADUC_WorkflowHandlerMapEntry* entry = GetWorkflowHandlerMapEntryForAction(currentWorkflowStep);
@@ -1088,6 +1282,8 @@ static void ADUC_Workflow_SetUpdateStateHelper(
     Log_Info("Setting UpdateState to %s", ADUCITF_StateToString(updateState));
     ADUC_WorkflowHandle workflowHandle = workflowData->WorkflowHandle;
 
+    ADUC_SelfProfile_SetPhase(ADUC_SelfProfile_PhaseFromState(updateState));
+
     // If we're transitioning from Apply_Started to Idle, we need to report InstalledUpdateId.
     //  if apply succeeded.
     // This is required by ADU service.
@@ -1165,6 +1361,104 @@ static void ADUC_Workflow_SetUpdateStateHelper(
     ADUC_WorkflowData_SetLastReportedState(updateState, workflowData);
 }
 
+/**
+ * @brief Name of the housekeeping queue folder under the data folder.
+ */
+#define HOUSEKEEPING_FOLDER_NAME "housekeeping"
+
+/**
+ * @brief Name of the folder in a housekeeping task that holds the sandbox of the completed workflow.
+ */
+#define HOUSEKEEPING_SANDBOX_FOLDER_NAME "sandbox"
+
+/**
+ * @brief Type of the housekeeping task that calls OnUpdateWorkflowCompleted of the download handlers.
+ */
+#define HOUSEKEEPING_TASK_UPDATE_WORKFLOW_COMPLETED "updateWorkflowCompleted"
+
+/**
+ * @brief Name of the updateWorkflowCompleted task property that holds the number of payloads already handled.
+ */
+#define HOUSEKEEPING_TASK_COMPLETED_PAYLOADS "completedPayloads"
+
+/**
+ * @brief Maximum time the download worker waits for a running housekeeping task to reach its next payload.
+ */
+#define HOUSEKEEPING_RUNNING_TASK_TIMEOUT_MS (60 * 1000)
+
+/**
+ * @brief Checks whether any update payload has a DownloadHandlerId.
+ *
+ * @param workflowHandle The workflow handle.
+ * @return bool true if a download handler must be called when the workflow completes.
+ */
+static bool HasDownloadHandlerPayloads(const ADUC_WorkflowHandle workflowHandle)
+{
+    bool found = false;
+    size_t payloadCount = workflow_get_update_files_count(workflowHandle);
+    for (size_t i = 0; i < payloadCount && !found; ++i)
+    {
+        ADUC_FileEntity fileEntity;
+        memset(&fileEntity, 0, sizeof(fileEntity));
+
+        if (workflow_get_update_file(workflowHandle, i, &fileEntity))
+        {
+            found = !IsNullOrEmpty(fileEntity.DownloadHandlerId);
+            ADUC_FileEntity_Uninit(&fileEntity);
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief If the update payload has a DownloadHandlerId, load the handler and call OnUpdateWorkflowCompleted.
+ *
+ * @param workflowHandle The workflow handle.
+ * @param payloadIndex The index of the update payload.
+ * @details On failure, the error result codes are logged and the extended result code is saved in the workflow.
+ * @return bool false if the download handler failed.
+ */
+static bool CallDownloadHandlerOnUpdateWorkflowCompletedForPayload(
+    const ADUC_WorkflowHandle workflowHandle, size_t payloadIndex)
+{
+    ADUC_Result result;
+    memset(&result, 0, sizeof(result));
+
+    ADUC_FileEntity fileEntity;
+    memset(&fileEntity, 0, sizeof(fileEntity));
+
+    if (!workflow_get_update_file(workflowHandle, payloadIndex, &fileEntity))
+    {
+        return true;
+    }
+
+    if (IsNullOrEmpty(fileEntity.DownloadHandlerId))
+    {
+        ADUC_FileEntity_Uninit(&fileEntity);
+        return true;
+    }
+
+    // NOTE: do not free the handle as it is owned by the DownloadHandlerFactory.
+    DownloadHandlerHandle* handle = ADUC_DownloadHandlerFactory_LoadDownloadHandler(fileEntity.DownloadHandlerId);
+    ADUC_FileEntity_Uninit(&fileEntity);
+    if (handle == NULL)
+    {
+        return true;
+    }
+
+    result = ADUC_DownloadHandlerPlugin_OnUpdateWorkflowCompleted(handle, workflowHandle);
+    if (IsAducResultCodeFailure(result.ResultCode))
+    {
+        Log_Warn("OnupdateWorkflowCompleted, result 0x%08x, erc 0x%08x", result.ResultCode, result.ExtendedResultCode);
+
+        workflow_add_erc(workflowHandle, result.ExtendedResultCode);
+        return false;
+    }
+
+    return true;
+}
+
 /**
  * @brief For each update payload that has a DownloadHandlerId, load the handler and call OnUpdateWorkflowCompleted.
  *
@@ -1176,40 +1470,297 @@ static void CallDownloadHandlerOnUpdateWorkflowCompleted(const ADUC_WorkflowHand
     size_t payloadCount = workflow_get_update_files_count(workflowHandle);
     for (size_t i = 0; i < payloadCount; ++i)
     {
-        ADUC_Result result;
-        memset(&result, 0, sizeof(result));
+        CallDownloadHandlerOnUpdateWorkflowCompletedForPayload(workflowHandle, i);
+    }
+}
+
+/**
+ * @brief Runs a housekeeping task queued by QueueDownloadHandlerOnUpdateWorkflowCompleted.
+ * @details The number of payloads handled is saved in the task after each payload. When the queue is paused for a
+ * deployment, the task yields before the next payload and continues from there when the queue is resumed.
+ *
+ * @param taskValue The task description.
+ * @param taskDir The task directory.
+ * @param context Unused.
+ * @return ADUC_HousekeepingTaskResult The outcome of the task.
+ */
+static ADUC_HousekeepingTaskResult RunHousekeepingTask(JSON_Value* taskValue, const char* taskDir, void* context)
+{
+    UNREFERENCED_PARAMETER(context);
+
+    ADUC_HousekeepingTaskResult taskResult = ADUC_HousekeepingTaskResult_Failed;
+    JSON_Object* task = json_value_get_object(taskValue);
+    ADUC_WorkflowHandle workflowHandle = NULL;
+    char* updateActionJson = NULL;
+    bool succeeded = true;
+
+    const char* type = json_object_get_string(task, "type");
+    if (type == NULL || strcmp(type, HOUSEKEEPING_TASK_UPDATE_WORKFLOW_COMPLETED) != 0)
+    {
+        Log_Warn("Unknown housekeeping task type '%s'", type != NULL ? type : "(null)");
+        goto done;
+    }
+
+    updateActionJson = json_serialize_to_string(json_object_get_value(task, "updateAction"));
+    if (updateActionJson == NULL)
+    {
+        goto done;
+    }
+
+    // The manifest was validated when the deployment was processed.
+    ADUC_Result result = workflow_init(updateActionJson, false /* shouldValidate */, &workflowHandle);
+    if (IsAducResultCodeFailure(result.ResultCode))
+    {
+        goto done;
+    }
+
+    if (!workflow_set_workfolder(workflowHandle, "%s/%s", taskDir, HOUSEKEEPING_SANDBOX_FOLDER_NAME))
+    {
+        goto done;
+    }
+
+    const size_t payloadCount = workflow_get_update_files_count(workflowHandle);
+    size_t completedPayloads = (size_t)json_object_get_number(task, HOUSEKEEPING_TASK_COMPLETED_PAYLOADS);
+
+    Log_Info(
+        "Calling OnUpdateWorkflowCompleted for workflow %s from payload %zu",
+        workflow_peek_id(workflowHandle),
+        completedPayloads);
+
+    for (; completedPayloads < payloadCount; ++completedPayloads)
+    {
+        // A deployment that started meanwhile must not compete with the rest of this task for disk and CPU.
+        if (ADUC_HousekeepingQueue_IsPaused(s_housekeepingQueue))
+        {
+            Log_Info("Housekeeping is paused. OnUpdateWorkflowCompleted continues at payload %zu.", completedPayloads);
+            taskResult = ADUC_HousekeepingTaskResult_Yielded;
+            goto done;
+        }
+
+        if (!CallDownloadHandlerOnUpdateWorkflowCompletedForPayload(workflowHandle, completedPayloads))
+        {
+            succeeded = false;
+        }
+
+        // A payload is not handled twice, even if the agent stops before the task is done.
+        if (json_object_set_number(task, HOUSEKEEPING_TASK_COMPLETED_PAYLOADS, (double)(completedPayloads + 1))
+                != JSONSuccess
+            || !ADUC_HousekeepingQueue_UpdateTask(s_housekeepingQueue, taskDir, taskValue))
+        {
+            Log_Warn("Cannot save the progress of housekeeping task %s", taskDir);
+        }
+    }
+
+    taskResult = succeeded ? ADUC_HousekeepingTaskResult_Succeeded : ADUC_HousekeepingTaskResult_Failed;
+
+done:
+    json_free_serialized_string(updateActionJson);
+    workflow_free(workflowHandle);
+
+    return taskResult;
+}
+
+/**
+ * @brief Creates the description of an updateWorkflowCompleted housekeeping task.
+ * @details The update action holds the effective update manifest and the file URLs, so that the workflow can be
+ * restored without downloading a detached manifest again.
+ *
+ * @param workflowHandle The workflow handle.
+ * @return JSON_Value* The task description, or NULL on failure. Caller must call json_value_free().
+ */
+static JSON_Value* CreateUpdateWorkflowCompletedTask(const ADUC_WorkflowHandle workflowHandle)
+{
+    bool succeeded = false;
+    JSON_Value* taskValue = json_value_init_object();
+    JSON_Object* task = json_value_get_object(taskValue);
+    JSON_Value* fileUrlsValue = json_value_init_object();
+    char* updateManifest = workflow_get_serialized_update_manifest(workflowHandle, false /* pretty */);
+
+    if (task == NULL || fileUrlsValue == NULL || updateManifest == NULL)
+    {
+        goto done;
+    }
 
+    size_t payloadCount = workflow_get_update_files_count(workflowHandle);
+    for (size_t i = 0; i < payloadCount; ++i)
+    {
         ADUC_FileEntity fileEntity;
         memset(&fileEntity, 0, sizeof(fileEntity));
 
         if (!workflow_get_update_file(workflowHandle, i, &fileEntity))
         {
-            continue;
+            goto done;
         }
 
-        if (IsNullOrEmpty(fileEntity.DownloadHandlerId))
+        const JSON_Status status =
+            json_object_set_string(json_value_get_object(fileUrlsValue), fileEntity.FileId, fileEntity.DownloadUri);
+        ADUC_FileEntity_Uninit(&fileEntity);
+        if (status != JSONSuccess)
         {
-            ADUC_FileEntity_Uninit(&fileEntity);
-            continue;
+            goto done;
         }
+    }
 
-        // NOTE: do not free the handle as it is owned by the DownloadHandlerFactory.
-        DownloadHandlerHandle* handle = ADUC_DownloadHandlerFactory_LoadDownloadHandler(fileEntity.DownloadHandlerId);
-        ADUC_FileEntity_Uninit(&fileEntity);
-        if (handle != NULL)
-        {
-            result = ADUC_DownloadHandlerPlugin_OnUpdateWorkflowCompleted(handle, workflowHandle);
-            if (IsAducResultCodeFailure(result.ResultCode))
-            {
-                Log_Warn(
-                    "OnupdateWorkflowCompleted, result 0x%08x, erc 0x%08x",
-                    result.ResultCode,
-                    result.ExtendedResultCode);
+    if (json_object_set_string(task, "type", HOUSEKEEPING_TASK_UPDATE_WORKFLOW_COMPLETED) != JSONSuccess
+        || json_object_dotset_string(task, "updateAction.workflow.id", workflow_peek_id(workflowHandle)) != JSONSuccess
+        || json_object_dotset_string(task, "updateAction.updateManifest", updateManifest) != JSONSuccess
+        || json_object_dotset_value(task, "updateAction.fileUrls", fileUrlsValue) != JSONSuccess)
+    {
+        goto done;
+    }
 
-                workflow_add_erc(workflowHandle, result.ExtendedResultCode);
-            }
-        }
+    // Ownership was transferred to the task.
+    fileUrlsValue = NULL;
+
+    succeeded = true;
+
+done:
+    json_free_serialized_string(updateManifest);
+    json_value_free(fileUrlsValue);
+
+    if (!succeeded)
+    {
+        json_value_free(taskValue);
+        taskValue = NULL;
     }
+
+    return taskValue;
+}
+
+/**
+ * @brief Queues the OnUpdateWorkflowCompleted calls of the download handlers as a housekeeping task.
+ * @details The sandbox is moved into the task, so that it survives the sandbox cleanup and agent restarts.
+ *
+ * @param workflowHandle The workflow handle.
+ * @return bool true if the calls were queued, or if there is nothing to call. On false, the sandbox is unchanged.
+ */
+static bool QueueDownloadHandlerOnUpdateWorkflowCompleted(const ADUC_WorkflowHandle workflowHandle)
+{
+    bool queued = false;
+    char* workFolder = NULL;
+    char* taskDir = NULL;
+    char* taskSandbox = NULL;
+    JSON_Value* task = NULL;
+
+    if (!HasDownloadHandlerPayloads(workflowHandle))
+    {
+        return true;
+    }
+
+    if (s_housekeepingQueue == NULL)
+    {
+        goto done;
+    }
+
+    workFolder = workflow_get_workfolder(workflowHandle);
+    if (workFolder == NULL || !SystemUtils_IsDir(workFolder, NULL))
+    {
+        goto done;
+    }
+
+    task = CreateUpdateWorkflowCompletedTask(workflowHandle);
+    if (task == NULL)
+    {
+        goto done;
+    }
+
+    taskDir = ADUC_HousekeepingQueue_BeginTask(s_housekeepingQueue);
+    if (taskDir == NULL)
+    {
+        goto done;
+    }
+
+    taskSandbox = ADUC_StringFormat("%s/%s", taskDir, HOUSEKEEPING_SANDBOX_FOLDER_NAME);
+    if (taskSandbox == NULL)
+    {
+        ADUC_HousekeepingQueue_AbortTask(s_housekeepingQueue, taskDir);
+        goto done;
+    }
+
+    // Fails with EXDEV if the data folder is on another file system than the downloads folder.
+    if (ADUCPAL_rename(workFolder, taskSandbox) != 0)
+    {
+        Log_Info("Cannot move sandbox %s to housekeeping, errno %d", workFolder, errno);
+        ADUC_HousekeepingQueue_AbortTask(s_housekeepingQueue, taskDir);
+        goto done;
+    }
+
+    if (!ADUC_HousekeepingQueue_CommitTask(s_housekeepingQueue, taskDir, task))
+    {
+        // The sandbox was removed with the task, so the calls cannot be made anymore.
+        Log_Warn("Failed to queue OnUpdateWorkflowCompleted for workflow %s", workflow_peek_id(workflowHandle));
+        queued = true;
+        goto done;
+    }
+
+    Log_Info("Queued OnUpdateWorkflowCompleted for workflow %s", workflow_peek_id(workflowHandle));
+    queued = true;
+
+done:
+    json_value_free(task);
+    free(taskSandbox);
+    free(taskDir);
+    workflow_free_string(workFolder);
+
+    return queued;
+}
+
+/**
+ * @brief Starts the housekeeping queue, and resumes the tasks queued before the agent stopped.
+ */
+void ADUC_Workflow_StartHousekeeping(void)
+{
+    char* queueDir = NULL;
+
+    if (s_housekeepingQueue != NULL)
+    {
+        return;
+    }
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config == NULL)
+    {
+        Log_Error("Cannot start housekeeping. Config is NULL.");
+        return;
+    }
+
+    queueDir = ADUC_StringFormat("%s/%s", config->dataFolder, HOUSEKEEPING_FOLDER_NAME);
+    ADUC_ConfigInfo_ReleaseInstance(config);
+
+    if (queueDir == NULL)
+    {
+        return;
+    }
+
+    s_housekeepingQueue = ADUC_HousekeepingQueue_Create(queueDir, RunHousekeepingTask, NULL /* context */);
+    if (s_housekeepingQueue == NULL)
+    {
+        Log_Warn("Housekeeping queue is not available. Completion tasks run inline.");
+    }
+
+    free(queueDir);
+}
+
+/**
+ * @brief Waits until a housekeeping task that was running when the workflow step started has yielded.
+ * @details Housekeeping is paused during a workflow step, but a running task yields only after its current payload.
+ * Must be called on the worker thread of the step, not on the main thread.
+ */
+void ADUC_Workflow_WaitForHousekeeping(void)
+{
+    if (!ADUC_HousekeepingQueue_WaitForRunningTask(s_housekeepingQueue, HOUSEKEEPING_RUNNING_TASK_TIMEOUT_MS))
+    {
+        Log_Warn("Housekeeping task is still running. Continuing anyway.");
+    }
+}
+
+/**
+ * @brief Stops the housekeeping queue after the running task. Pending tasks are resumed after the next start.
+ */
+void ADUC_Workflow_StopHousekeeping(void)
+{
+    ADUC_HousekeepingQueue_Destroy(s_housekeepingQueue);
+    s_housekeepingQueue = NULL;
 }
 
 /**
@@ -1244,6 +1795,8 @@ void ADUC_Workflow_SetUpdateStateWithResult(
  */
 void ADUC_Workflow_SetInstalledUpdateIdAndGoToIdle(ADUC_WorkflowData* workflowData, const char* updateId)
 {
+    ADUC_SelfProfile_SetPhase(ADUC_SelfProfile_Phase_Idle);
+
     ADUC_Result idleResult;
     idleResult.ResultCode = ADUC_Result_Apply_Success;
     idleResult.ExtendedResultCode = 0;
@@ -1261,7 +1814,12 @@ void ADUC_Workflow_SetInstalledUpdateIdAndGoToIdle(ADUC_WorkflowData* workflowDa
         Log_Error("Failed to set last completed workflow id. Going to idle state.");
     }
 
-    CallDownloadHandlerOnUpdateWorkflowCompleted(workflowData->WorkflowHandle);
+    // Populating the source update cache can take long for large payloads, so it is done in the background
+    // unless the sandbox cannot be handed over.
+    if (!QueueDownloadHandlerOnUpdateWorkflowCompleted(workflowData->WorkflowHandle))
+    {
+        CallDownloadHandlerOnUpdateWorkflowCompleted(workflowData->WorkflowHandle);
+    }
 
     ADUC_Workflow_MethodCall_Idle(workflowData);
 
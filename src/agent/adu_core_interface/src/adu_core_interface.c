@@ -21,6 +21,7 @@
 #include "aduc/rootkeypackage_do_download.h"
 #include "aduc/rootkeypackage_types.h"
 #include "aduc/rootkeypackage_utils.h"
+#include "aduc/startup_report_utils.h"
 #include "aduc/string_c_utils.h"
 #include "aduc/types/adu_core.h"
 #include "aduc/types/update_content.h"
@@ -64,6 +65,29 @@ static void OnUpdateResultD2CMessageCompleted(void* context, ADUC_D2C_Message_St
     Log_Debug("Send message completed (status:%d)", status);
 }
 
+/**
+ * @brief This function is called when the startup message is no longer being processed.
+ * @details Records the startup report once the hub acknowledged it, so that its unchanged
+ * sections are skipped on the next connect.
+ *
+ * @param context The ADUC_D2C_Message object
+ * @param status The message status.
+ */
+static void OnStartupMsgD2CMessageCompleted(void* context, ADUC_D2C_Message_Status status)
+{
+    ADUC_StartupReport* report = (ADUC_StartupReport*)((ADUC_D2C_Message*)context)->userData;
+
+    Log_Debug("Send startup message completed (status:%d)", status);
+
+    if (status == ADUC_D2C_Message_Status_Success && !ADUC_StartupReport_Acknowledge(report))
+    {
+        Log_Warn("Could not record the acknowledged startup message.");
+    }
+
+    ADUC_StartupReport_Uninit(report);
+    free(report);
+}
+
 /**
  * @brief Initialize a ADUC_WorkflowData object.
  *
@@ -94,6 +118,9 @@ bool ADUC_WorkflowData_Init(ADUC_WorkflowData* workflowData, int argc, char** ar
 
     workflowData->LastCompletedWorkflowId = NULL;
 
+    workflowData->LastAcceptedDesiredDigest = NULL;
+    workflowData->LastAckedDesiredVersion = -1;
+
     workflow_set_cancellation_type(workflowData->WorkflowHandle, ADUC_WorkflowCancellationType_None);
 
     succeeded = true;
@@ -120,27 +147,30 @@ void ADUC_WorkflowData_Uninit(ADUC_WorkflowData* workflowData)
     }
 
     workflow_free_string(workflowData->LastCompletedWorkflowId);
+    free(workflowData->LastAcceptedDesiredDigest);
     memset(workflowData, 0, sizeof(*workflowData));
 }
 
 /**
- * @brief Reports the client json via PnP so it ends up in the reported section of the twin.
+ * @brief Sends the client json via PnP so it ends up in the reported section of the twin.
  *
  * @param messageType The message type.
  * @param json_value The json value to be reported.
- * @param workflowData The workflow data.
+ * @param completedCallback The callback to be called when the message is no longer being processed.
+ * @param userData The user data of the message. It is owned by @p completedCallback if this call succeeds.
  * @return bool true if call succeeded.
  */
-static bool
-ReportClientJsonProperty(ADUC_D2C_Message_Type messageType, const char* json_value, ADUC_WorkflowData* workflowData)
+static bool SendClientJsonProperty(
+    ADUC_D2C_Message_Type messageType,
+    const char* json_value,
+    ADUC_D2C_MESSAGE_COMPLETED_CALLBACK completedCallback,
+    void* userData)
 {
-    UNREFERENCED_PARAMETER(workflowData);
-
     bool success = false;
 
     if (g_iotHubClientHandleForADUComponent == NULL)
     {
-        Log_Error("ReportClientJsonProperty called with invalid IoTHub Device Client handle! Can't report!");
+        Log_Error("SendClientJsonProperty called with invalid IoTHub Device Client handle! Can't report!");
         return false;
     }
 
@@ -158,9 +188,9 @@ ReportClientJsonProperty(ADUC_D2C_Message_Type messageType, const char* json_val
             &g_iotHubClientHandleForADUComponent,
             STRING_c_str(jsonToSend),
             NULL /* responseCallback */,
-            OnUpdateResultD2CMessageCompleted,
+            completedCallback,
             NULL /* statusChangedCallback */,
-            NULL /* userData */))
+            userData))
     {
         Log_Error("Unable to send update result.");
         goto done;
@@ -174,10 +204,28 @@ done:
     return success;
 }
 
+/**
+ * @brief Reports the client json via PnP so it ends up in the reported section of the twin.
+ *
+ * @param messageType The message type.
+ * @param json_value The json value to be reported.
+ * @param workflowData The workflow data.
+ * @return bool true if call succeeded.
+ */
+static bool
+ReportClientJsonProperty(ADUC_D2C_Message_Type messageType, const char* json_value, ADUC_WorkflowData* workflowData)
+{
+    UNREFERENCED_PARAMETER(workflowData);
+
+    return SendClientJsonProperty(messageType, json_value, OnUpdateResultD2CMessageCompleted, NULL /* userData */);
+}
+
 /**
  * @brief Reports values to the cloud which do not change throughout ADUs execution
  * @details the current expectation is to report these values after the successful
- * connection of the AzureDeviceUpdateCoreInterface
+ * connection of the AzureDeviceUpdateCoreInterface. Sections that are unchanged since the last
+ * report acknowledged by the hub are left out, so that a fleet that reboots together does not
+ * flood the hub with identical twin writes.
  * @param workflowData the workflow data.
  * @returns true when the report is sent and false when reporting fails.
  */
@@ -189,9 +237,14 @@ bool ReportStartupMsg(ADUC_WorkflowData* workflowData)
         return false;
     }
 
+    UNREFERENCED_PARAMETER(workflowData);
+
     bool success = false;
     const ADUC_ConfigInfo* config = NULL;
     char* jsonString = NULL;
+    ADUC_StartupReport* report = NULL;
+    ADUC_StartupReport_Identity identity;
+    memset(&identity, 0, sizeof(identity));
 
     JSON_Value* startupMsgValue = json_value_init_object();
 
@@ -228,6 +281,29 @@ bool ReportStartupMsg(ADUC_WorkflowData* workflowData)
         goto done;
     }
 
+    report = calloc(1, sizeof(*report));
+
+    if (report == NULL)
+    {
+        goto done;
+    }
+
+    // The record is tied to the hub identity, so that a device that moved to another hub reports in full.
+    const bool hasIdentity = ClientHandle_GetIdentity(&identity.hostName, &identity.deviceId, &identity.moduleId);
+
+    if (!ADUC_StartupReport_Prepare(
+            report,
+            config->dataFolder,
+            hasIdentity ? &identity : NULL,
+            startupMsgObj,
+            time(NULL),
+            ADUC_STARTUP_REPORT_REFRESH_SECONDS))
+    {
+        Log_Info("Startup message is unchanged since the last acknowledged report. Skipping.");
+        success = true;
+        goto done;
+    }
+
     jsonString = json_serialize_to_string(startupMsgValue);
 
     if (jsonString == NULL)
@@ -236,10 +312,21 @@ bool ReportStartupMsg(ADUC_WorkflowData* workflowData)
         goto done;
     }
 
-    ReportClientJsonProperty(ADUC_D2C_Message_Type_Device_Properties, jsonString, workflowData);
+    if (SendClientJsonProperty(
+            ADUC_D2C_Message_Type_Device_Properties, jsonString, OnStartupMsgD2CMessageCompleted, report))
+    {
+        // The report is recorded and freed once the message is no longer being processed.
+        report = NULL;
+    }
 
     success = true;
 done:
+    if (report != NULL)
+    {
+        ADUC_StartupReport_Uninit(report);
+        free(report);
+    }
+
     json_value_free(startupMsgValue);
     json_free_serialized_string(jsonString);
     ADUC_ConfigInfo_ReleaseInstance(config);
@@ -322,7 +409,7 @@ void AzureDeviceUpdateCoreInterface_Destroy(void** componentContext)
 /**
  * @brief Update twin to report state transition before workflow processing has started.
  *
- * @param propertyValue The json value to use for reporting.
+ * @param propertyValue The json value to use for reporting. It is borrowed, not copied.
  * @param deploymentState The final deployment state to report.
  * @param workflowData The workflow data to receive the last reported state upon reporting success.
  * @param result The result to be reported.
@@ -331,7 +418,6 @@ void AzureDeviceUpdateCoreInterface_Destroy(void** componentContext)
 static bool ReportPreDeploymentProcessingState(
     JSON_Value* propertyValue, ADUCITF_State deploymentState, ADUC_WorkflowData* workflowData, ADUC_Result result)
 {
-    JSON_Value* propertyValueCopy = NULL;
     bool reportingSuccess = false;
 
     // Temp workflowData and workflow handle for reporting
@@ -343,17 +429,11 @@ static bool ReportPreDeploymentProcessingState(
         goto done;
     }
 
-    // Synthesize workflowData current action and set a copy of the
-    // propertyValue to workflow UpdateActionObject, both of which are
-    // needed to generate the reporting json.
+    // Synthesize workflowData current action and lend the propertyValue
+    // to workflow UpdateActionObject, both of which are needed to generate
+    // the reporting json.
     tmpWorkflowData.CurrentAction = ADUCITF_UpdateAction_ProcessDeployment;
-    propertyValueCopy = json_value_deep_copy(propertyValue);
-    if (propertyValueCopy == NULL)
-    {
-        goto done;
-    }
-
-    if (!workflow_set_update_action_object(tmpWorkflowData.WorkflowHandle, json_object(propertyValueCopy)))
+    if (!workflow_set_update_action_object(tmpWorkflowData.WorkflowHandle, json_object(propertyValue)))
     {
         goto done;
     }
@@ -373,7 +453,8 @@ done:
 
     if (tmpWorkflowData.WorkflowHandle != NULL)
     {
-        // propertyValueCopy will get freed by workflow_free
+        // propertyValue is owned by the caller, so take it back before workflow_free.
+        workflow_set_update_action_object(tmpWorkflowData.WorkflowHandle, NULL);
         workflow_free(tmpWorkflowData.WorkflowHandle);
     }
 
@@ -402,87 +483,114 @@ void OrchestratorUpdateCallback(
 
     STRING_HANDLE jsonToSend = NULL;
     char* ackString = NULL;
-    JSON_Object* signatureObj = NULL;
+    JSON_Value* updateActionValue = NULL;
 
     ADUCITF_UpdateAction updateAction = ADUCITF_UpdateAction_Undefined;
     char* workflowId = NULL;
     char* rootKeyPkgUrl = NULL;
     STRING_HANDLE rootKeyPackageFilePath = NULL;
     char* workFolder = NULL;
+    char* desiredDigest = NULL;
 
-    // Reads out the json string so we can Log Out what we've got.
-    // The value will be parsed and handled in ADUC_Workflow_HandlePropertyUpdate.
-    char* jsonString = json_serialize_to_string(propertyValue);
-    if (jsonString == NULL)
-    {
-        Log_Error(
-            "OrchestratorUpdateCallback failed to convert property JSON value to string, property version (%d)",
-            propertyVersion);
-        goto done;
-    }
-
-    // To reduce TWIN size, remove UpdateManifestSignature and fileUrls before ACK.
-    signatureObj = json_value_get_object(propertyValue);
-    if (signatureObj != NULL)
+    // The hub delivers the full desired property again on every reconnection and twin refresh.
+    // Only hand it to the workflow when it differs from the last accepted one, unless a retry is forced.
+    if (!ADUC_HashUtils_GetJsonValueHash(propertyValue, SHA256, &desiredDigest))
     {
-        json_object_set_null(signatureObj, "updateManifestSignature");
-        json_object_set_null(signatureObj, "fileUrls");
-        ackString = json_serialize_to_string(propertyValue);
+        Log_Warn("Cannot compute digest of desired update action. Processing it in full.");
     }
 
-    Log_Debug("Update Action info string (%s), property version (%d)", ackString, propertyVersion);
+    const bool isUnchanged = !sourceContext->forceUpdate && desiredDigest != NULL
+        && workflowData->LastAcceptedDesiredDigest != NULL
+        && strcmp(desiredDigest, workflowData->LastAcceptedDesiredDigest) == 0;
 
-    tmpResult = workflow_parse_peek_unprotected_workflow_properties(
-        json_object(propertyValue), &updateAction, &rootKeyPkgUrl, &workflowId);
-    if (IsAducResultCodeFailure(tmpResult.ResultCode))
+    if (isUnchanged && propertyVersion == workflowData->LastAckedDesiredVersion)
     {
-        Log_Error("Parse failed for unprotected properties, erc: 0x%08x", tmpResult.ExtendedResultCode);
-        // Note, cannot report failure here since workflowId from unprotected properties is needed for that.
+        Log_Info("Desired update action is unchanged, property version (%d). Skipping.", propertyVersion);
         goto done;
     }
 
-    if (updateAction == ADUCITF_UpdateAction_ProcessDeployment && !IsNullOrEmpty(workflowId))
+    // The property value is parsed once from the twin and handed to the workflow as is,
+    // so it is not serialized and parsed again on the way.
+    if (isUnchanged)
     {
-        Log_Debug("Processing deployment %s ...", workflowId);
-
-        ADUC_Result inProgressResult = { .ResultCode = ADUC_GeneralResult_Success, .ExtendedResultCode = 0 };
-        if (!ReportPreDeploymentProcessingState(
-                propertyValue, ADUCITF_State_DeploymentInProgress, workflowData, inProgressResult))
-        {
-            Log_Warn("Reporting InProgress failed. Continuing processing deployment %s", workflowId);
-        }
-
-        // Ensure update to latest rootkey pkg, which is required for validating the update metadata.
-        workFolder = workflow_get_root_sandbox_dir(workflowData->WorkflowHandle);
-        if (workFolder == NULL)
+        Log_Info(
+            "Desired update action is unchanged, acknowledging new property version (%d) only.", propertyVersion);
+    }
+    else
+    {
+        tmpResult = workflow_parse_peek_unprotected_workflow_properties(
+            json_object(propertyValue), &updateAction, &rootKeyPkgUrl, &workflowId);
+        if (IsAducResultCodeFailure(tmpResult.ResultCode))
         {
-            Log_Error("workflow_get_root_sandbox_dir failed");
+            Log_Error("Parse failed for unprotected properties, erc: 0x%08x", tmpResult.ExtendedResultCode);
+            // Note, cannot report failure here since workflowId from unprotected properties is needed for that.
             goto done;
         }
 
-        tmpResult = RootKeyWorkflow_UpdateRootKeys(workflowId, workFolder, rootKeyPkgUrl);
-        if (IsAducResultCodeFailure(tmpResult.ResultCode))
+        if (updateAction == ADUCITF_UpdateAction_ProcessDeployment && !IsNullOrEmpty(workflowId))
         {
-            Log_Error("Update Rootkey failed, 0x%08x. Deployment cannot proceed.", tmpResult.ExtendedResultCode);
+            Log_Debug("Processing deployment %s ...", workflowId);
 
-            if (!ReportPreDeploymentProcessingState(propertyValue, ADUCITF_State_Failed, workflowData, tmpResult))
+            ADUC_Result inProgressResult = { .ResultCode = ADUC_GeneralResult_Success, .ExtendedResultCode = 0 };
+            if (!ReportPreDeploymentProcessingState(
+                    propertyValue, ADUCITF_State_DeploymentInProgress, workflowData, inProgressResult))
             {
-                Log_Warn("FAIL: report rootkey update 'Failed' State.");
+                Log_Warn("Reporting InProgress failed. Continuing processing deployment %s", workflowId);
+            }
+
+            // Ensure update to latest rootkey pkg, which is required for validating the update metadata.
+            workFolder = workflow_get_root_sandbox_dir(workflowData->WorkflowHandle);
+            if (workFolder == NULL)
+            {
+                Log_Error("workflow_get_root_sandbox_dir failed");
+                goto done;
+            }
+
+            tmpResult = RootKeyWorkflow_UpdateRootKeys(workflowId, workFolder, rootKeyPkgUrl);
+            if (IsAducResultCodeFailure(tmpResult.ResultCode))
+            {
+                Log_Error("Update Rootkey failed, 0x%08x. Deployment cannot proceed.", tmpResult.ExtendedResultCode);
+
+                if (!ReportPreDeploymentProcessingState(propertyValue, ADUCITF_State_Failed, workflowData, tmpResult))
+                {
+                    Log_Warn("FAIL: report rootkey update 'Failed' State.");
+                }
+
+                goto done;
             }
+        }
 
+        // The twin is freed after this callback returns, so the workflow takes ownership of a copy.
+        updateActionValue = json_value_deep_copy(propertyValue);
+        if (updateActionValue == NULL)
+        {
+            Log_Error("Cannot copy desired update action, property version (%d)", propertyVersion);
             goto done;
         }
+
+        ADUC_Workflow_HandlePropertyUpdate(workflowData, updateActionValue, sourceContext->forceUpdate);
+        updateActionValue = NULL;
+
+        free(workflowData->LastAcceptedDesiredDigest);
+        workflowData->LastAcceptedDesiredDigest = desiredDigest;
+        desiredDigest = NULL;
     }
 
-    ADUC_Workflow_HandlePropertyUpdate(workflowData, (const unsigned char*)jsonString, sourceContext->forceUpdate);
-    free(jsonString);
-    jsonString = ackString;
+    // To reduce TWIN size, the ACK omits the updateManifestSignature and fileUrls of the property value.
+    ackString = workflow_serialize_update_action_ack(json_value_get_object(propertyValue));
+    if (ackString == NULL)
+    {
+        Log_Error("Unable to serialize update action ACK, property version (%d)", propertyVersion);
+        goto done;
+    }
+
+    Log_Debug("Update Action info string (%s), property version (%d)", ackString, propertyVersion);
 
     // ACK the request.
     jsonToSend = PnP_CreateReportedPropertyWithStatus(
         g_aduPnPComponentName,
         g_aduPnPComponentServicePropertyName,
-        jsonString,
+        ackString,
         PNP_STATUS_SUCCESS,
         "", // Description for this acknowledgement.
         propertyVersion);
@@ -506,13 +614,17 @@ void OrchestratorUpdateCallback(
         goto done;
     }
 
+    workflowData->LastAckedDesiredVersion = propertyVersion;
+
 done:
     STRING_delete(rootKeyPackageFilePath);
     workflow_free_string(rootKeyPkgUrl);
     workflow_free_string(workflowId);
     workflow_free_string(workFolder);
     STRING_delete(jsonToSend);
-    free(jsonString);
+    json_free_serialized_string(ackString);
+    json_value_free(updateActionValue);
+    free(desiredDigest);
 
     Log_Info("OrchestratorPropertyUpdateCallback ended");
 }
@@ -43,6 +43,13 @@ bool DeviceInfoInterface_Create(void** componentContext, int argc, char** argv);
  */
 void DeviceInfoInterface_Connected(void* componentContext);
 
+/**
+ * @brief Called regularly from the main loop. Samples and reports the agent's own resource usage.
+ *
+ * @param componentContext Context object from Create.
+ */
+void DeviceInfoInterface_DoWork(void* componentContext);
+
 /**
  * @brief Uninitialize the interface.
  *
@@ -11,6 +11,7 @@
 #include "aduc/d2c_messaging.h"
 #include "aduc/device_info_exports.h"
 #include "aduc/logging.h"
+#include "aduc/self_profile_utils.h"
 #include "aduc/string_c_utils.h" // atoint64t
 #include "pnp_protocol.h"
 #include <ctype.h> // isalnum
@@ -24,6 +25,14 @@ static const char g_deviceInfoPnPComponentName[] = "deviceInformation";
  */
 ADUC_ClientHandle g_iotHubClientHandleForDeviceInfoComponent;
 
+// Name of the reported property that holds the agent's own resource usage summary.
+static const char g_agentProfilePropertyName[] = "agentProfile";
+
+/**
+ * @brief The latest agent resource usage summary, or NULL if none yet.
+ */
+static JSON_Value* g_agentProfile = NULL;
+
 //
 // DeviceInfoInterfaceData
 //
@@ -179,6 +188,34 @@ void DeviceInfoInterface_Destroy(void** componentContext)
 
     // context isn't used, as we reference the global deviceInfoInterface_Data.
     DeviceInfoInterfaceData_Free();
+
+    json_value_free(g_agentProfile);
+    g_agentProfile = NULL;
+}
+
+/**
+ * @brief Samples the agent's own resource usage, and reports the summary when it changed significantly.
+ *
+ * @param componentContext Context object from Create.
+ */
+void DeviceInfoInterface_DoWork(void* componentContext)
+{
+    UNREFERENCED_PARAMETER(componentContext);
+
+    JSON_Value* agentProfile = ADUC_SelfProfile_DoWork();
+    if (agentProfile == NULL)
+    {
+        return;
+    }
+
+    json_value_free(g_agentProfile);
+    g_agentProfile = agentProfile;
+
+    // Until connected, the summary is sent along with the properties reported by DeviceInfoInterface_Connected.
+    if (g_iotHubClientHandleForDeviceInfoComponent != NULL)
+    {
+        DeviceInfoInterface_ReportChangedPropertiesAsync();
+    }
 }
 
 /**
@@ -229,6 +266,17 @@ void DeviceInfoInterface_ReportChangedPropertiesAsync()
         }
     }
 
+    // All properties are sent in one message, as a pending message of the same type is replaced.
+    if (g_agentProfile != NULL)
+    {
+        JSON_Value* agentProfile = json_value_deep_copy(g_agentProfile);
+        if (agentProfile != NULL
+            && json_object_set_value(root_object, g_agentProfilePropertyName, agentProfile) != JSONSuccess)
+        {
+            json_value_free(agentProfile);
+        }
+    }
+
     serialized_string = json_serialize_to_string(root_value);
 
     jsonToSend = STRING_construct_sprintf(pnpReportedPropertyFormat, g_deviceInfoPnPComponentName, serialized_string);
@@ -23,11 +23,12 @@
 #include "aduc/health_management.h"
 #include "aduc/https_proxy_utils.h"
 #include "aduc/iothub_communication_manager.h"
+#include "aduc/lazy_component_utils.h"
 #include "aduc/logging.h"
 #include "aduc/permission_utils.h"
 #include "aduc/shutdown_service.h"
 #include "aduc/string_c_utils.h"
-#include "aduc/system_utils.h" // ADUC_SystemUtils_MkDirRecursiveDefault
+#include "aduc/system_utils.h" // ADUC_SystemUtils_MkDirRecursiveDefault, ADUC_PAGE_CACHE_MODE_ENV
 #include "aducpal/stdlib.h" // setenv
 #include <azure_c_shared_utility/shared_util_options.h>
 #include <azure_c_shared_utility/threadapi.h> // ThreadAPI_Sleep
@@ -52,9 +53,11 @@
 #include <stdio.h>
 #include <stdlib.h> // strtol
 #include <sys/stat.h>
+#include <time.h> // clock_gettime
 
 #include "pnp_protocol.h"
 
+#include "crypto_lib.h" // CryptoUtils_SetProvider
 #include "eis_utils.h"
 
 // make this last so that it does not interfere when system headers are included after it
@@ -83,6 +86,11 @@ static const char g_deviceInfoPnPComponentName[] = "deviceInformation";
 // Name of the Diagnostics subcomponent that this device is using
 static const char g_diagnosticsPnPComponentName[] = "diagnosticInformation";
 
+/**
+ * @brief Time the diagnostics component is kept after its last request.
+ */
+#define DIAGNOSTICS_IDLE_TIMEOUT_SECONDS 600
+
 /**
  * @brief Global IoT Hub client handle.
  */
@@ -135,6 +143,23 @@ static ADUC_PnPComponentClient_PropertyUpdate_Context g_iotHubInitiatedPnPProper
 
 static ADUC_PnPComponentClient_PropertyUpdate_Context g_deviceInitiatedRetryPnPPropertyChangeContext = { true, true };
 
+/**
+ * @brief Most devices never receive a diagnostics request, so the diagnostics component, with its configuration
+ * and upload worker, is created when its first desired property arrives.
+ */
+static ADUC_LazyComponent g_diagnosticsLazyComponent = {
+    g_diagnosticsPnPComponentName,
+    DiagnosticsInterface_Create,
+    DiagnosticsInterface_Destroy,
+    DiagnosticsInterface_IsIdle,
+    DIAGNOSTICS_IDLE_TIMEOUT_SECONDS,
+};
+
+/**
+ * @brief Set once the components were notified that the first device twin was processed.
+ */
+static bool g_firstDeviceTwinDataProcessed = false;
+
 /**
  * @brief Defines an PnP Component Client that this agent supports.
  */
@@ -148,6 +173,7 @@ typedef struct tagPnPComponentEntry
     const PnPComponentDestroyFunc Destroy;
     const PnPComponentPropertyUpdateCallback
         PnPPropertyUpdateCallback; /**< Called when a component's property is updated. (optional) */
+    ADUC_LazyComponent* const Lazy; /**< Created on first use instead of Create and Destroy. (optional) */
     //
     // Following data is dynamic.
     // Must be initialized to NULL in map and remain last entries in this struct.
@@ -172,25 +198,28 @@ static PnPComponentEntry componentList[] = {
         AzureDeviceUpdateCoreInterface_Connected,
         AzureDeviceUpdateCoreInterface_DoWork,
         AzureDeviceUpdateCoreInterface_Destroy,
-        AzureDeviceUpdateCoreInterface_PropertyUpdateCallback
+        AzureDeviceUpdateCoreInterface_PropertyUpdateCallback,
+        NULL /* Lazy - created at startup */
     },
     {
         g_deviceInfoPnPComponentName,
         &g_iotHubClientHandleForDeviceInfoComponent,
         DeviceInfoInterface_Create,
         DeviceInfoInterface_Connected,
-        NULL /* DoWork method - not used */,
+        DeviceInfoInterface_DoWork,
         DeviceInfoInterface_Destroy,
-        NULL /* PropertyUpdateCallback - not used */
+        NULL /* PropertyUpdateCallback - not used */,
+        NULL /* Lazy - created at startup */
     },
     {
         g_diagnosticsPnPComponentName,
         &g_iotHubClientHandleForDiagnosticsComponent,
-        DiagnosticsInterface_Create,
+        NULL /* Create - see Lazy */,
         DiagnosticsInterface_Connected,
         NULL /* DoWork method - not used */,
-        DiagnosticsInterface_Destroy,
-        DiagnosticsInterface_PropertyUpdateCallback
+        NULL /* Destroy - see Lazy */,
+        DiagnosticsInterface_PropertyUpdateCallback,
+        &g_diagnosticsLazyComponent
     },
 };
 
@@ -448,6 +477,32 @@ done:
 // IotHub methods.
 //
 
+/**
+ * @brief Gets the time of a clock that does not jump, for the idle timeout of lazy components.
+ */
+static time_t ADUC_PnP_Components_GetTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+/**
+ * @brief Returns whether the component instance exists; a lazy component exists after its first use.
+ */
+static bool ADUC_PnP_Component_IsCreated(const PnPComponentEntry* entry)
+{
+    return entry->Lazy == NULL || entry->Lazy->created;
+}
+
+/**
+ * @brief Gets the context of the component instance.
+ */
+static void* ADUC_PnP_Component_GetContext(const PnPComponentEntry* entry)
+{
+    return (entry->Lazy != NULL) ? entry->Lazy->context : entry->Context;
+}
+
 /**
  * @brief Uninitialize all PnP components' handler.
  */
@@ -457,7 +512,11 @@ static void ADUC_PnP_Components_Destroy()
     {
         PnPComponentEntry* entry = componentList + index;
 
-        if (entry->Destroy != NULL)
+        if (entry->Lazy != NULL)
+        {
+            ADUC_LazyComponent_Destroy(entry->Lazy);
+        }
+        else if (entry->Destroy != NULL)
         {
             entry->Destroy(&(entry->Context));
         }
@@ -501,7 +560,11 @@ static bool ADUC_PnP_Components_Create(ADUC_ClientHandle clientHandle, int argc,
     {
         PnPComponentEntry* entry = componentList + index;
 
-        if (!entry->Create(&entry->Context, argc, argv))
+        if (entry->Lazy != NULL)
+        {
+            ADUC_LazyComponent_Register(entry->Lazy, argc, argv);
+        }
+        else if (!entry->Create(&entry->Context, argc, argv))
         {
             Log_Error("Failed to initialize PnP component '%s'.", entry->ComponentName);
             goto done;
@@ -551,8 +614,29 @@ static void ADUC_PnP_ComponentClient_PropertyUpdate_Callback(
             supported = true;
             if (entry->PnPPropertyUpdateCallback != NULL)
             {
+                void* context = entry->Context;
+
+                if (entry->Lazy != NULL)
+                {
+                    bool createdNow = false;
+                    context = ADUC_LazyComponent_Acquire(entry->Lazy, ADUC_PnP_Components_GetTime(), &createdNow);
+
+                    if (!entry->Lazy->created)
+                    {
+                        Log_Error(
+                            "Ignoring the property '%s' change event of component %s.", propertyName, componentName);
+                        continue;
+                    }
+
+                    // Components created later than the first twin are notified here instead of by the twin callback.
+                    if (createdNow && g_firstDeviceTwinDataProcessed && entry->Connected != NULL)
+                    {
+                        entry->Connected(context);
+                    }
+                }
+
                 entry->PnPPropertyUpdateCallback(
-                    *(entry->clientHandle), propertyName, propertyValue, version, sourceContext, entry->Context);
+                    *(entry->clientHandle), propertyName, propertyValue, version, sourceContext, context);
             }
             else
             {
@@ -579,8 +663,6 @@ static const char* g_modeledComponents[ARRAY_SIZE(componentList)];
 
 static const size_t g_numModeledComponents = ARRAY_SIZE(g_modeledComponents);
 
-static bool g_firstDeviceTwinDataProcessed = false;
-
 static void InitializeModeledComponents()
 {
     const size_t numModeledComponents = ARRAY_SIZE(g_modeledComponents);
@@ -651,9 +733,9 @@ static void ADUC_PnPDeviceTwin_Callback(
         for (unsigned index = 0; index < componentCount; ++index)
         {
             PnPComponentEntry* entry = componentList + index;
-            if (entry->Connected != NULL)
+            if (entry->Connected != NULL && ADUC_PnP_Component_IsCreated(entry))
             {
-                entry->Connected(entry->Context);
+                entry->Connected(ADUC_PnP_Component_GetContext(entry));
             }
         }
     }
@@ -801,6 +883,9 @@ bool StartupAgent(const ADUC_LaunchArguments* launchArgs)
         goto done;
     }
 
+    // Resumes post-deployment work that was queued before the agent stopped.
+    ADUC_Workflow_StartHousekeeping();
+
     succeeded = true;
 
 done:
@@ -819,6 +904,7 @@ void ShutdownAgent()
 #ifdef ADUC_COMMAND_HELPER_H
     UninitializeCommandListenerThread();
 #endif
+    ADUC_Workflow_StopHousekeeping();
     ADUC_PnP_Components_Destroy();
     IoTHub_CommunicationManager_Deinit();
     DiagnosticsComponent_DestroyDeviceName();
@@ -931,6 +1017,25 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Extensions and child processes (e.g. adu-shell) pick the page cache mode up from the environment.
+    if (config->pageCacheMode != NULL)
+    {
+        ADUCPAL_setenv(ADUC_PAGE_CACHE_MODE_ENV, config->pageCacheMode, 1);
+    }
+
+    // Manifest and root key package signatures are verified in this process.
+    if (config->cryptoProvider != NULL)
+    {
+        if (CryptoUtils_SetProvider(config->cryptoProvider))
+        {
+            Log_Info("Using crypto provider '%s' for signature verification.", config->cryptoProvider);
+        }
+        else
+        {
+            Log_Warn("Cannot load crypto provider '%s', using the default.", config->cryptoProvider);
+        }
+    }
+
     // default to failure
     ret = 1;
 
@@ -1082,9 +1187,14 @@ int main(int argc, char** argv)
         {
             PnPComponentEntry* entry = componentList + index;
 
-            if (entry->DoWork != NULL)
+            if (entry->Lazy != NULL)
+            {
+                ADUC_LazyComponent_DoWork(entry->Lazy, ADUC_PnP_Components_GetTime());
+            }
+
+            if (entry->DoWork != NULL && ADUC_PnP_Component_IsCreated(entry))
             {
-                entry->DoWork(entry->Context);
+                entry->DoWork(ADUC_PnP_Component_GetContext(entry));
             }
         }
 
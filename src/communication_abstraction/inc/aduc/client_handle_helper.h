@@ -214,5 +214,15 @@ bool ClientHandle_Create(
     const char* iotHubSuffix,
     IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol);
 
+/**
+ * @brief Gets the hub identity of the current client.
+ * @details The values stay valid until the client is destroyed with ClientHandle_Destroy.
+ * @param[out] hostName The host name of the hub.
+ * @param[out] deviceId The device id.
+ * @param[out] moduleId The module id, or NULL for a device client.
+ * @returns true if a client was created and its hub identity is known; false otherwise.
+ */
+bool ClientHandle_GetIdentity(const char** hostName, const char** deviceId, const char** moduleId);
+
 EXTERN_C_END
 #endif // CLIENT_HANDLE_HELPER_H
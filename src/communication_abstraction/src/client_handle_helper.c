@@ -8,12 +8,52 @@
 
 #include "aduc/client_handle_helper.h"
 
+#include <aduc/connection_string_utils.h>
 #include <aduc/logging.h>
+#include <aduc/string_c_utils.h> // ADUC_StringFormat
 #include <azureiot/iothub_device_client_ll.h>
 #include <azureiot/iothub_module_client_ll.h>
 
 static ADUC_ConnType g_ClientHandleType = ADUC_ConnType_NotSet;
 
+// The hub identity of the current client.
+static char* g_ClientHostName = NULL;
+static char* g_ClientDeviceId = NULL;
+static char* g_ClientModuleId = NULL;
+
+/**
+ * @brief Frees the hub identity of the current client.
+ */
+static void ClearIdentity(void)
+{
+    free(g_ClientHostName);
+    g_ClientHostName = NULL;
+    free(g_ClientDeviceId);
+    g_ClientDeviceId = NULL;
+    free(g_ClientModuleId);
+    g_ClientModuleId = NULL;
+}
+
+/**
+ * @brief Records the hub identity of the client created from @p connectionString.
+ * @param connectionString the connection string of the client
+ */
+static void SetIdentityFromConnectionString(const char* connectionString)
+{
+    ClearIdentity();
+
+    if (!ConnectionStringUtils_GetValue(connectionString, "HostName", &g_ClientHostName)
+        || !ConnectionStringUtils_GetDeviceIdFromConnectionString(connectionString, &g_ClientDeviceId))
+    {
+        Log_Warn("Cannot get the hub identity from the connection string");
+        ClearIdentity();
+        return;
+    }
+
+    // Note: not all connection strings have a module-id
+    ConnectionStringUtils_GetModuleIdFromConnectionString(connectionString, &g_ClientModuleId);
+}
+
 /**
  * @brief Safely casts @p handle to an IOTHUB_DEVICE_CLIENT_LL_HANDLE
  * @param handle the pointer to be cast
@@ -103,6 +143,7 @@ done:
     }
 
     g_ClientHandleType = type;
+    SetIdentityFromConnectionString(connectionString);
     return true;
 }
 
@@ -175,6 +216,10 @@ done:
     }
 
     g_ClientHandleType = type;
+
+    ClearIdentity();
+    g_ClientHostName = ADUC_StringFormat("%s.%s", iotHubName, iotHubSuffix);
+    g_ClientDeviceId = ADUC_StringFormat("%s", deviceID);
     return true;
 }
 
@@ -471,4 +516,26 @@ void ClientHandle_Destroy(ADUC_ClientHandle iotHubClientHandle)
     }
 
     g_ClientHandleType = ADUC_ConnType_NotSet;
+    ClearIdentity();
+}
+
+/**
+ * @brief Gets the hub identity of the current client.
+ * @details The values stay valid until the client is destroyed with ClientHandle_Destroy.
+ * @param[out] hostName The host name of the hub.
+ * @param[out] deviceId The device id.
+ * @param[out] moduleId The module id, or NULL for a device client.
+ * @returns true if a client was created and its hub identity is known; false otherwise.
+ */
+bool ClientHandle_GetIdentity(const char** hostName, const char** deviceId, const char** moduleId)
+{
+    if (g_ClientHandleType == ADUC_ConnType_NotSet || g_ClientHostName == NULL || g_ClientDeviceId == NULL)
+    {
+        return false;
+    }
+
+    *hostName = g_ClientHostName;
+    *deviceId = g_ClientDeviceId;
+    *moduleId = g_ClientModuleId;
+    return true;
 }
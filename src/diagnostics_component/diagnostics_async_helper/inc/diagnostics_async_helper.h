@@ -6,6 +6,7 @@
  * Licensed under the MIT License.
  */
 #include <aduc/c_utils.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #ifndef DIAGNOSTICS_ASYNC_HELPER_H
@@ -18,6 +19,8 @@ typedef struct tagDiagnosticWorkflowData DiagnosticsWorkflowData;
 void DiagnosticsWorkflow_DiscoverAndUploadLogsAsync(
     const DiagnosticsWorkflowData* workflowData, const char* jsonString);
 
+bool DiagnosticsWorkflow_IsUploadInProgress(void);
+
 EXTERN_C_END
 
 #endif // DIAGNOSTICS_ASYNC_HELPER_H
@@ -10,6 +10,7 @@
 
 #include <aduc/logging.h>
 #include <aduc/string_handle_wrapper.hpp>
+#include <atomic>
 #include <azure_c_shared_utility/strings.h>
 #include <diagnostics_workflow.h>
 #include <mutex>
@@ -25,6 +26,7 @@ class DiagnosticsWorkflowManager
 {
 private:
     std::thread worker; //!< current thread doing work
+    std::atomic<bool> uploadInProgress{ false }; //!< true while the worker uses the workflow data
 
 public:
     explicit DiagnosticsWorkflowManager() = default;
@@ -59,7 +61,9 @@ public:
 
             STRING_HANDLE jsonStringHandleClone = STRING_clone(jsonStringHandle);
 
-            std::thread newWorker{ [diagnosticsWorkflowData, jsonStringHandleClone] {
+            uploadInProgress = true;
+
+            std::thread newWorker{ [this, diagnosticsWorkflowData, jsonStringHandleClone] {
                 ADUC::StringUtils::STRING_HANDLE_wrapper cloneWrapper(jsonStringHandleClone);
 
                 try
@@ -74,6 +78,8 @@ public:
                 {
                     Log_Error("StartNewDiagnosticsWorkflowThread worker thread failed with unknown exception");
                 }
+
+                uploadInProgress = false;
             } };
 
             worker = std::move(newWorker);
@@ -87,9 +93,23 @@ public:
             Log_Error("StartNewDiagnosticsWorkflowThread failed with unknown exception");
         }
 
+        if (!worker.joinable())
+        {
+            uploadInProgress = false;
+        }
+
         STRING_delete(jsonStringHandle);
     }
 
+    /**
+     * @brief Returns whether a worker thread is still uploading logs
+     * @returns true while the workflow data passed to StartDiagnosticsWorkflow is in use
+     */
+    bool IsUploadInProgress() const
+    {
+        return uploadInProgress;
+    }
+
     /**
      * @brief Destructor assures that the worker thread will have been joined before exiting
     */
@@ -129,3 +149,12 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogsAsync(
         Log_Error("DiagnosticsAsyncHelper_DiscoverAndUploadFiles failed with unknown exception");
     }
 }
+
+/**
+ * @brief Returns whether a log upload started by DiagnosticsWorkflow_DiscoverAndUploadLogsAsync is in progress
+ * @returns true while the workflow data passed to DiagnosticsWorkflow_DiscoverAndUploadLogsAsync is in use
+ */
+bool DiagnosticsWorkflow_IsUploadInProgress()
+{
+    return s_DiagnosticsManager.IsUploadInProgress();
+}
@@ -46,6 +46,11 @@ EXTERN_C_BEGIN
  */
 #define DIAGNOSTICSITF_FIELDNAME_OPERATIONID "operationId"
 
+/**
+ * @brief JSON field name for the optional filters applied to the logs before upload
+ */
+#define DIAGNOSTICSITF_FIELDNAME_FILTERS "filters"
+
 /**
  * @brief Handle for Diagnostics component to communicate to the service.
  */
@@ -79,6 +84,14 @@ void DiagnosticsInterface_Connected(void* componentContext);
  */
 void DiagnosticsInterface_Destroy(void** componentContext);
 
+/**
+ * @brief Returns whether the interface may be destroyed, i.e. no log upload is in progress.
+ *
+ * @param componentContext Context object from Create.
+ * @return bool True if idle.
+ */
+bool DiagnosticsInterface_IsIdle(void* componentContext);
+
 /**
  * @brief A callback for the diagnostic component's property update events.
  */
@@ -112,6 +112,14 @@ void DiagnosticsInterface_Destroy(void** componentContext)
     *componentContext = NULL;
 }
 
+bool DiagnosticsInterface_IsIdle(void* componentContext)
+{
+    UNREFERENCED_PARAMETER(componentContext);
+
+    // The upload worker reads the workflow data, which Destroy frees.
+    return !DiagnosticsWorkflow_IsUploadInProgress();
+}
+
 /**
  * @brief This function is called when the message is no longer being process.
  *
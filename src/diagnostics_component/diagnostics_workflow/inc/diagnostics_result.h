@@ -19,6 +19,7 @@ EXTERN_C_BEGIN
  */
 typedef enum tagDiagnostics_Result
 {
+    Diagnostics_Result_InvalidFilters = -8, //!< Cloud to device message contains filters that cannot be applied
     Diagnostics_Result_NoSasCredential = -7, //!< Cloud to device message contains no sas credential
     Diagnostics_Result_NoOperationId = -6, // !< Cloud to device message contains no operation id
     Diagnostics_Result_NoDiagnosticsComponents = -5, // !< Diagnostics configuration doesn't contain any components
@@ -16,6 +16,8 @@ const char* DiagnosticsResult_ToString(Diagnostics_Result result)
 {
     switch (result)
     {
+    case Diagnostics_Result_InvalidFilters:
+        return "InvalidFilters";
     case Diagnostics_Result_NoSasCredential:
         return "NoSasCredential";
     case Diagnostics_Result_NoOperationId:
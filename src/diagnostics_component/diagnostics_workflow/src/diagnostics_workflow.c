@@ -10,6 +10,7 @@
 
 #include <aduc/logging.h>
 #include <aduc/string_c_utils.h>
+#include <aduc/system_utils.h> // for ADUC_SystemUtils_GetTemporaryPathName, ADUC_SystemUtils_RmDirRecursive
 
 #if defined(_WIN32)
 typedef struct tagBlobStorageInfo
@@ -35,11 +36,19 @@ static bool FileUploadUtility_UploadFilesToContainer(
 #include <diagnostics_devicename.h>
 #include <diagnostics_interface.h>
 #include <file_info_utils.h>
+#include <log_filter_utils.h>
 #include <operation_id_utils.h>
+#include <errno.h>
+#include <limits.h> // for LLONG_MAX, PATH_MAX
 #include <parson_json_utils.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/**
+ * @brief Name of the manifest uploaded with filtered logs, describing what was filtered
+ */
+#define DIAGNOSTICS_FILTER_MANIFEST_FILENAME "filter-manifest.json"
+
 /**
  * @brief Sets the memory in @p memory which points to the storage location in @p sasCredential to 0 before calling STRING_delete() on sasCredential
  * @param sasCredential credential to be deleted
@@ -132,10 +141,184 @@ done:
     return result;
 }
 
+/**
+ * @brief Writes the lines of the logs in @p fileNames that pass @p filter to a new directory, with a manifest
+ * @details @p maxUploadSize applies to the filtered logs: the newest files are kept until their filtered size reaches
+ * it, and the older ones are removed from @p fileNames. On success, the manifest is added to @p fileNames, so that it
+ * is uploaded with the filtered logs
+ * @param fileNames vector of files discovered for @p logComponent, newest first
+ * @param logComponent descriptor for the component whose logs are filtered
+ * @param filter the enabled filter of the request
+ * @param filtersObj the filters object of the request, copied into the manifest
+ * @param maxUploadSize maximum number of bytes of filtered logs allowed to be uploaded
+ * @param filteredDirPath to be loaded with the directory holding the filtered logs; remove with
+ * ADUC_SystemUtils_RmDirRecursive and free with STRING_delete
+ * @returns a value of Diagnostics_Result indicating the status of the filtering
+ */
+Diagnostics_Result DiagnosticsWorkflow_FilterFilesForComponent(
+    VECTOR_HANDLE fileNames,
+    const DiagnosticsLogComponent* logComponent,
+    const LogFilter* filter,
+    const JSON_Object* filtersObj,
+    const long long maxUploadSize,
+    STRING_HANDLE* filteredDirPath)
+{
+    Diagnostics_Result result = Diagnostics_Result_Failure;
+    STRING_HANDLE inputPath = NULL;
+    STRING_HANDLE outputPath = NULL;
+    STRING_HANDLE manifestName = NULL;
+    JSON_Value* manifestValue = NULL;
+    char dirPathTemplate[PATH_MAX];
+    unsigned long long bytesRead = 0;
+    unsigned long long bytesWritten = 0;
+
+    if (fileNames == NULL || logComponent == NULL || filter == NULL || filteredDirPath == NULL)
+    {
+        return Diagnostics_Result_Failure;
+    }
+
+    *filteredDirPath = NULL;
+
+    const int templateLength = snprintf(
+        dirPathTemplate, sizeof(dirPathTemplate), "%s/adu-diagnostics-XXXXXX", ADUC_SystemUtils_GetTemporaryPathName());
+    if (templateLength <= 0 || (size_t)templateLength >= sizeof(dirPathTemplate))
+    {
+        goto done;
+    }
+
+    if (mkdtemp(dirPathTemplate) == NULL)
+    {
+        Log_Error("DiagnosticsWorkflow_FilterFilesForComponent cannot create directory, errno: %d", errno);
+        goto done;
+    }
+
+    *filteredDirPath = STRING_construct(dirPathTemplate);
+    if (*filteredDirPath == NULL)
+    {
+        ADUC_SystemUtils_RmDirRecursive(dirPathTemplate);
+        goto done;
+    }
+
+    inputPath = STRING_new();
+    outputPath = STRING_new();
+    manifestValue = json_value_init_object();
+
+    if (inputPath == NULL || outputPath == NULL || manifestValue == NULL)
+    {
+        goto done;
+    }
+
+    JSON_Object* manifestObj = json_value_get_object(manifestValue);
+    JSON_Value* filtersCopy = json_value_deep_copy(json_object_get_wrapping_value(filtersObj));
+    if (json_object_set_value(manifestObj, DIAGNOSTICSITF_FIELDNAME_FILTERS, filtersCopy) != JSONSuccess)
+    {
+        json_value_free(filtersCopy);
+        goto done;
+    }
+
+    if (json_object_set_value(manifestObj, "files", json_value_init_array()) != JSONSuccess)
+    {
+        goto done;
+    }
+
+    JSON_Array* manifestFiles = json_object_get_array(manifestObj, "files");
+
+    size_t fileCount = VECTOR_size(fileNames);
+    for (size_t i = 0; i < fileCount; ++i)
+    {
+        const STRING_HANDLE* fileName = VECTOR_element(fileNames, i);
+        LogFilter_Stats stats;
+
+        // Same budget as discovery without a filter, but counted after filtering.
+        if (bytesWritten >= (unsigned long long)maxUploadSize)
+        {
+            for (size_t j = i; j < fileCount; ++j)
+            {
+                STRING_delete(*(STRING_HANDLE*)VECTOR_element(fileNames, j));
+            }
+
+            VECTOR_erase(fileNames, VECTOR_element(fileNames, i), fileCount - i);
+            fileCount = i;
+            break;
+        }
+
+        // STRING_sprintf appends, so the paths of the previous file are cleared first.
+        if (STRING_empty(inputPath) != 0 || STRING_empty(outputPath) != 0
+            || STRING_sprintf(inputPath, "%s/%s", STRING_c_str(logComponent->logPath), STRING_c_str(*fileName)) != 0
+            || STRING_sprintf(outputPath, "%s/%s", STRING_c_str(*filteredDirPath), STRING_c_str(*fileName)) != 0)
+        {
+            goto done;
+        }
+
+        if (!LogFilter_FilterFile(filter, STRING_c_str(inputPath), STRING_c_str(outputPath), &stats))
+        {
+            goto done;
+        }
+
+        JSON_Value* fileValue = json_value_init_object();
+        JSON_Object* fileObj = json_value_get_object(fileValue);
+        if (fileValue == NULL || json_object_set_string(fileObj, "fileName", STRING_c_str(*fileName)) != JSONSuccess
+            || json_object_set_number(fileObj, "linesRead", (double)stats.linesRead) != JSONSuccess
+            || json_object_set_number(fileObj, "linesUploaded", (double)stats.linesWritten) != JSONSuccess
+            || json_object_set_number(fileObj, "bytesRead", (double)stats.bytesRead) != JSONSuccess
+            || json_object_set_number(fileObj, "bytesUploaded", (double)stats.bytesWritten) != JSONSuccess
+            || json_array_append_value(manifestFiles, fileValue) != JSONSuccess)
+        {
+            json_value_free(fileValue);
+            goto done;
+        }
+
+        bytesRead += stats.bytesRead;
+        bytesWritten += stats.bytesWritten;
+    }
+
+    if (STRING_empty(outputPath) != 0
+        || STRING_sprintf(outputPath, "%s/%s", STRING_c_str(*filteredDirPath), DIAGNOSTICS_FILTER_MANIFEST_FILENAME)
+            != 0
+        || json_serialize_to_file_pretty(manifestValue, STRING_c_str(outputPath)) != JSONSuccess)
+    {
+        goto done;
+    }
+
+    manifestName = STRING_construct(DIAGNOSTICS_FILTER_MANIFEST_FILENAME);
+    if (manifestName == NULL || VECTOR_push_back(fileNames, &manifestName, 1) != 0)
+    {
+        goto done;
+    }
+
+    // Now owned by fileNames.
+    manifestName = NULL;
+
+    Log_Info(
+        "Filtered logs of component %s from %llu to %llu bytes",
+        STRING_c_str(logComponent->componentName),
+        bytesRead,
+        bytesWritten);
+
+    result = Diagnostics_Result_Success;
+
+done:
+
+    if (result != Diagnostics_Result_Success && *filteredDirPath != NULL)
+    {
+        ADUC_SystemUtils_RmDirRecursive(STRING_c_str(*filteredDirPath));
+        STRING_delete(*filteredDirPath);
+        *filteredDirPath = NULL;
+    }
+
+    STRING_delete(manifestName);
+    STRING_delete(inputPath);
+    STRING_delete(outputPath);
+    json_value_free(manifestValue);
+
+    return result;
+}
+
 /**
  * @brief Uploads the logs held within @p fileNames described by @p logComponent
  * @param fileNames vector of files to be uploaded for @p logComponent
  * @param logComponent descriptor for the component for which we're going to upload logs
+ * @param directoryPath directory holding the files in @p fileNames, or NULL for the logPath of @p logComponent
  * @param deviceName name of the device the DiagnosticsWorkflow is running on
  * @param operationId the id associated with this upload request sent down by Diagnostics Service
  * @param storageSasUrl credential to be used for the Azure Blob Storage upload
@@ -144,6 +327,7 @@ done:
 Diagnostics_Result DiagnosticsWorkflow_UploadFilesForComponent(
     VECTOR_HANDLE fileNames,
     const DiagnosticsLogComponent* logComponent,
+    const char* directoryPath,
     const char* deviceName,
     const char* operationId,
     const char* storageSasUrl)
@@ -187,7 +371,12 @@ Diagnostics_Result DiagnosticsWorkflow_UploadFilesForComponent(
         goto done;
     }
 
-    if (!FileUploadUtility_UploadFilesToContainer(&blobInfo, fileNames, STRING_c_str(logComponent->logPath)))
+    if (directoryPath == NULL)
+    {
+        directoryPath = STRING_c_str(logComponent->logPath);
+    }
+
+    if (!FileUploadUtility_UploadFilesToContainer(&blobInfo, fileNames, directoryPath))
     {
         result = Diagnostics_Result_UploadFailed;
         Log_Warn(
@@ -259,6 +448,11 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogs(const DiagnosticsWorkflowData* wo
 
     VECTOR_HANDLE logComponentFileNames = NULL;
 
+    LogFilter filter;
+    memset(&filter, 0, sizeof(filter));
+
+    STRING_HANDLE filteredDirPath = NULL;
+
     if (jsonString == NULL)
     {
         goto done;
@@ -309,6 +503,14 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogs(const DiagnosticsWorkflowData* wo
         goto done;
     }
 
+    const JSON_Object* filtersObj = json_object_get_object(cloudMsgObj, DIAGNOSTICSITF_FIELDNAME_FILTERS);
+
+    if (!LogFilter_Init(&filter, filtersObj))
+    {
+        result = Diagnostics_Result_InvalidFilters;
+        goto done;
+    }
+
     const long long uploadSizePerComponent = workflowData->maxBytesToUploadPerLogPath;
 
     if (uploadSizePerComponent == 0)
@@ -316,6 +518,9 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogs(const DiagnosticsWorkflowData* wo
         goto done;
     }
 
+    // A filter usually shrinks the logs a lot, so its size cap is applied to the filtered output instead.
+    const long long discoverySizePerComponent = filter.enabled ? LLONG_MAX : uploadSizePerComponent;
+
     if (!DiagnosticsComponent_GetDeviceName(&deviceName))
     {
         goto done;
@@ -344,7 +549,8 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogs(const DiagnosticsWorkflowData* wo
 
         VECTOR_HANDLE discoveredFileNames = NULL;
 
-        result = DiagnosticsWorkflow_GetFilesForComponent(&discoveredFileNames, logComponent, uploadSizePerComponent);
+        result =
+            DiagnosticsWorkflow_GetFilesForComponent(&discoveredFileNames, logComponent, discoverySizePerComponent);
 
         if (result != Diagnostics_Result_Success || discoveredFileNames == NULL)
         {
@@ -378,13 +584,32 @@ void DiagnosticsWorkflow_DiscoverAndUploadLogs(const DiagnosticsWorkflowData* wo
             goto done;
         }
 
+        if (filter.enabled)
+        {
+            result = DiagnosticsWorkflow_FilterFilesForComponent(
+                *discoveredLogFileNames, logComponent, &filter, filtersObj, uploadSizePerComponent, &filteredDirPath);
+
+            if (result != Diagnostics_Result_Success)
+            {
+                goto done;
+            }
+        }
+
         result = DiagnosticsWorkflow_UploadFilesForComponent(
             *discoveredLogFileNames,
             logComponent,
+            STRING_c_str(filteredDirPath),
             deviceName,
             STRING_c_str(operationId),
             STRING_c_str(storageSasCredential));
 
+        if (filteredDirPath != NULL)
+        {
+            ADUC_SystemUtils_RmDirRecursive(STRING_c_str(filteredDirPath));
+            STRING_delete(filteredDirPath);
+            filteredDirPath = NULL;
+        }
+
         if (result != Diagnostics_Result_Success)
         {
             goto done;
@@ -424,6 +649,8 @@ done:
 
     free(deviceName);
 
+    LogFilter_UnInit(&filter);
+
     STRING_delete(operationId);
 
     DiagnosticsComponent_SecurelyFreeSasCredential(&storageSasCredential, &storageSasCredentialMemory);
@@ -0,0 +1,119 @@
+/**
+ * @file log_filter_utils.h
+ * @brief Filtering of log files on the device before they are uploaded.
+ *
+ * A log upload request may carry an optional "filters" object:
+ *
+ *   "filters": {
+ *       "startTime": "2026-10-01T00:00:00Z",
+ *       "endTime": "2026-10-02T12:00:00+02:00",
+ *       "minSeverity": "warning",
+ *       "contains": "workflow",
+ *       "regex": "result(Code)?: [1-9]"
+ *   }
+ *
+ * All fields are optional, and a line is uploaded only if it passes all given filters. Times are ISO 8601,
+ * UTC unless an offset is given, and the range includes both ends. Severities are "debug", "info", "warning"
+ * and "error". The regex is a POSIX extended regular expression.
+ *
+ * The time of a line is the timestamp it starts with. Lines without one, e.g. the continuation lines of a
+ * multi-line entry, take the time and severity of the line before. The severity is recognized from the
+ * agent's "[D]", "[I]", "[W]" and "[E]" markers, and from words such as "warning" or "ERROR" near the start
+ * of the line. Lines whose time or severity is not known do not pass a time or severity filter.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef LOG_FILTER_UTILS_H
+#define LOG_FILTER_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Severity of a log line, in increasing order.
+ */
+typedef enum tagLogFilter_Severity
+{
+    LogFilter_Severity_Unknown = 0, //!< No severity recognized
+    LogFilter_Severity_Debug = 1, //!< Debug and trace output
+    LogFilter_Severity_Info = 2, //!< Informational messages
+    LogFilter_Severity_Warning = 3, //!< Warnings
+    LogFilter_Severity_Error = 4, //!< Errors and worse
+} LogFilter_Severity;
+
+/**
+ * @brief The filters of a log upload request.
+ */
+typedef struct tagLogFilter
+{
+    bool enabled; //!< True if the request has filters
+    bool hasStartTime; //!< True if startTime is set
+    time_t startTime; //!< Earliest time of an uploaded line
+    bool hasEndTime; //!< True if endTime is set
+    time_t endTime; //!< Latest time of an uploaded line
+    LogFilter_Severity minSeverity; //!< Lowest severity of an uploaded line, or Unknown to upload all
+    char* contains; //!< Substring an uploaded line contains, or NULL
+    bool hasRegex; //!< True if regex is compiled
+    regex_t regex; //!< Expression an uploaded line matches
+} LogFilter;
+
+/**
+ * @brief What the filtering of a file kept.
+ */
+typedef struct tagLogFilter_Stats
+{
+    unsigned long long linesRead; //!< Lines of the original file
+    unsigned long long linesWritten; //!< Lines that passed the filters
+    unsigned long long bytesRead; //!< Size of the original file
+    unsigned long long bytesWritten; //!< Size of the filtered file
+} LogFilter_Stats;
+
+/**
+ * @brief Initializes @p filter from the "filters" object of a request
+ * @param filter the filter to initialize, disabled if @p filtersObj is NULL. Free with LogFilter_UnInit
+ * @param filtersObj the "filters" object, or NULL if the request has none
+ * @returns true if @p filtersObj is NULL or valid; false on an invalid filter
+ */
+bool LogFilter_Init(LogFilter* filter, const JSON_Object* filtersObj);
+
+/**
+ * @brief Frees the members of @p filter
+ * @param filter the filter to uninitialize
+ */
+void LogFilter_UnInit(LogFilter* filter);
+
+/**
+ * @brief Parses an ISO 8601 date and time, e.g. "2026-10-01T12:00:00.123Z"
+ * @param str the string, which may continue after the time
+ * @param[out] time the time in seconds since the epoch
+ * @returns the length of the parsed time, or 0 if @p str does not start with a time
+ */
+size_t LogFilter_ParseTime(const char* str, time_t* time);
+
+/**
+ * @brief Recognizes the severity of a log line
+ * @param line the line
+ * @returns the severity, or LogFilter_Severity_Unknown
+ */
+LogFilter_Severity LogFilter_GetLineSeverity(const char* line);
+
+/**
+ * @brief Streams @p inputPath to @p outputPath, keeping the lines that pass @p filter
+ * @param filter an enabled filter
+ * @param inputPath the log file
+ * @param outputPath the filtered file to create
+ * @param[out] stats what was kept
+ * @returns true on success; false if a file cannot be read or written
+ */
+bool LogFilter_FilterFile(
+    const LogFilter* filter, const char* inputPath, const char* outputPath, LogFilter_Stats* stats);
+
+EXTERN_C_END
+
+#endif // LOG_FILTER_UTILS_H
@@ -0,0 +1,558 @@
+/**
+ * @file log_filter_utils.c
+ * @brief Implementation for filtering log files on the device before they are uploaded
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+
+#include "log_filter_utils.h"
+#include <aduc/logging.h>
+#include <aducpal/strings.h> // for ADUCPAL_strcasecmp
+#include <azure_c_shared_utility/crt_abstractions.h> // for mallocAndStrcpy_s
+#include <ctype.h> // for isdigit
+#include <errno.h>
+#include <stdio.h> // for getline
+#include <stdlib.h> // for free
+#include <string.h>
+
+/**
+ * @brief Fieldname for the start of the time range in the filters object
+ */
+#define LOG_FILTER_FIELDNAME_STARTTIME "startTime"
+
+/**
+ * @brief Fieldname for the end of the time range in the filters object
+ */
+#define LOG_FILTER_FIELDNAME_ENDTIME "endTime"
+
+/**
+ * @brief Fieldname for the minimum severity in the filters object
+ */
+#define LOG_FILTER_FIELDNAME_MINSEVERITY "minSeverity"
+
+/**
+ * @brief Fieldname for the substring in the filters object
+ */
+#define LOG_FILTER_FIELDNAME_CONTAINS "contains"
+
+/**
+ * @brief Fieldname for the regular expression in the filters object
+ */
+#define LOG_FILTER_FIELDNAME_REGEX "regex"
+
+/**
+ * @brief Number of leading characters of a line that are searched for a severity
+ */
+#define LOG_FILTER_SEVERITY_PREFIX_LENGTH 96
+
+/**
+ * @brief Number of leading words of a line that are compared with the severity names
+ */
+#define LOG_FILTER_SEVERITY_MAX_WORDS 8
+
+/**
+ * @brief Longest word that is compared with the severity names
+ */
+#define LOG_FILTER_SEVERITY_MAX_WORD_LENGTH 16
+
+/**
+ * @brief Words that name a severity in common log formats
+ */
+static const struct
+{
+    const char* name;
+    LogFilter_Severity severity;
+} s_severityNames[] = {
+    { "debug", LogFilter_Severity_Debug },   { "trace", LogFilter_Severity_Debug },
+    { "info", LogFilter_Severity_Info },     { "notice", LogFilter_Severity_Info },
+    { "warn", LogFilter_Severity_Warning },  { "warning", LogFilter_Severity_Warning },
+    { "error", LogFilter_Severity_Error },   { "err", LogFilter_Severity_Error },
+    { "crit", LogFilter_Severity_Error },    { "critical", LogFilter_Severity_Error },
+    { "fatal", LogFilter_Severity_Error },   { "alert", LogFilter_Severity_Error },
+    { "emerg", LogFilter_Severity_Error },
+};
+
+/**
+ * @brief Parses a fixed number of digits
+ * @returns the value, or -1 if @p str does not start with @p count digits
+ */
+static int ParseDigits(const char* str, size_t count)
+{
+    int value = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!isdigit((unsigned char)str[i]))
+        {
+            return -1;
+        }
+
+        value = value * 10 + (str[i] - '0');
+    }
+
+    return value;
+}
+
+/**
+ * @brief Gets the number of days since 1970-01-01 of a date in the proleptic Gregorian calendar
+ */
+static long long DaysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const long long era = (year >= 0 ? year : year - 399) / 400;
+    const long long yearOfEra = year - era * 400;
+    const long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+size_t LogFilter_ParseTime(const char* str, time_t* time)
+{
+    if (str == NULL || time == NULL)
+    {
+        return 0;
+    }
+
+    // YYYY-MM-DDTHH:MM:SS, the T may be a space. Each check stops at the terminator of a short string.
+    const int year = ParseDigits(str, 4);
+    if (year < 0 || str[4] != '-')
+    {
+        return 0;
+    }
+
+    const int month = ParseDigits(str + 5, 2);
+    if (month < 1 || month > 12 || str[7] != '-')
+    {
+        return 0;
+    }
+
+    const int day = ParseDigits(str + 8, 2);
+    if (day < 1 || day > 31 || (str[10] != 'T' && str[10] != ' '))
+    {
+        return 0;
+    }
+
+    const int hour = ParseDigits(str + 11, 2);
+    if (hour < 0 || hour > 23 || str[13] != ':')
+    {
+        return 0;
+    }
+
+    const int minute = ParseDigits(str + 14, 2);
+    if (minute < 0 || minute > 59 || str[16] != ':')
+    {
+        return 0;
+    }
+
+    const int second = ParseDigits(str + 17, 2);
+    if (second < 0 || second > 60)
+    {
+        return 0;
+    }
+
+    size_t length = 19;
+
+    if (str[length] == '.' || str[length] == ',')
+    {
+        ++length;
+        while (isdigit((unsigned char)str[length]))
+        {
+            ++length;
+        }
+    }
+
+    long long offsetSeconds = 0;
+    if (str[length] == 'Z')
+    {
+        ++length;
+    }
+    else if (str[length] == '+' || str[length] == '-')
+    {
+        // +HH:MM or +HHMM
+        const int sign = str[length] == '-' ? -1 : 1;
+        const int offsetHours = ParseDigits(str + length + 1, 2);
+        if (offsetHours >= 0 && offsetHours <= 23)
+        {
+            const size_t minutesStart = length + (str[length + 3] == ':' ? 4 : 3);
+            const int offsetMinutes = ParseDigits(str + minutesStart, 2);
+            if (offsetMinutes >= 0 && offsetMinutes <= 59)
+            {
+                offsetSeconds = sign * (offsetHours * 3600LL + offsetMinutes * 60LL);
+                length = minutesStart + 2;
+            }
+        }
+    }
+
+    const long long seconds =
+        DaysFromCivil(year, month, day) * 86400 + hour * 3600LL + minute * 60LL + second - offsetSeconds;
+
+    *time = (time_t)seconds;
+    return length;
+}
+
+LogFilter_Severity LogFilter_GetLineSeverity(const char* line)
+{
+    char prefix[LOG_FILTER_SEVERITY_PREFIX_LENGTH + 1];
+    size_t prefixLength = 0;
+
+    if (line == NULL)
+    {
+        return LogFilter_Severity_Unknown;
+    }
+
+    while (prefixLength < LOG_FILTER_SEVERITY_PREFIX_LENGTH && line[prefixLength] != '\0'
+           && line[prefixLength] != '\n')
+    {
+        prefix[prefixLength] = line[prefixLength];
+        ++prefixLength;
+    }
+
+    prefix[prefixLength] = '\0';
+
+    // The agent logs "[D]", "[I]", "[W]" or "[E]" after the timestamp.
+    for (const char* marker = strchr(prefix, '['); marker != NULL; marker = strchr(marker + 1, '['))
+    {
+        if (marker[1] != '\0' && marker[2] == ']')
+        {
+            switch (marker[1])
+            {
+            case 'D':
+                return LogFilter_Severity_Debug;
+            case 'I':
+                return LogFilter_Severity_Info;
+            case 'W':
+                return LogFilter_Severity_Warning;
+            case 'E':
+                return LogFilter_Severity_Error;
+            default:
+                break;
+            }
+        }
+    }
+
+    // Other logs name it, e.g. "<3>err:", "WARNING" or "[error]".
+    const char* delimiters = " \t[]()<>:|,=";
+    char* context = NULL;
+    char* word = strtok_r(prefix, delimiters, &context);
+    for (size_t wordCount = 0; word != NULL && wordCount < LOG_FILTER_SEVERITY_MAX_WORDS;
+         word = strtok_r(NULL, delimiters, &context), ++wordCount)
+    {
+        if (strlen(word) > LOG_FILTER_SEVERITY_MAX_WORD_LENGTH)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < sizeof(s_severityNames) / sizeof(s_severityNames[0]); ++i)
+        {
+            if (ADUCPAL_strcasecmp(word, s_severityNames[i].name) == 0)
+            {
+                return s_severityNames[i].severity;
+            }
+        }
+    }
+
+    return LogFilter_Severity_Unknown;
+}
+
+/**
+ * @brief Parses the severity name of the filters object
+ */
+static LogFilter_Severity ParseSeverity(const char* name)
+{
+    if (name == NULL)
+    {
+        return LogFilter_Severity_Unknown;
+    }
+
+    if (strcmp(name, "debug") == 0)
+    {
+        return LogFilter_Severity_Debug;
+    }
+
+    if (strcmp(name, "info") == 0)
+    {
+        return LogFilter_Severity_Info;
+    }
+
+    if (strcmp(name, "warning") == 0)
+    {
+        return LogFilter_Severity_Warning;
+    }
+
+    if (strcmp(name, "error") == 0)
+    {
+        return LogFilter_Severity_Error;
+    }
+
+    return LogFilter_Severity_Unknown;
+}
+
+/**
+ * @brief Parses an optional time field of the filters object
+ * @returns false if the field is present but not a complete ISO 8601 time
+ */
+static bool ParseTimeField(const JSON_Object* filtersObj, const char* name, bool* hasTime, time_t* time)
+{
+    *hasTime = false;
+
+    if (!json_object_has_value(filtersObj, name))
+    {
+        return true;
+    }
+
+    const char* str = json_object_get_string(filtersObj, name);
+    if (str == NULL)
+    {
+        return false;
+    }
+
+    const size_t length = LogFilter_ParseTime(str, time);
+    if (length == 0 || str[length] != '\0')
+    {
+        return false;
+    }
+
+    *hasTime = true;
+    return true;
+}
+
+bool LogFilter_Init(LogFilter* filter, const JSON_Object* filtersObj)
+{
+    bool succeeded = false;
+
+    if (filter == NULL)
+    {
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+
+    if (filtersObj == NULL)
+    {
+        return true;
+    }
+
+    if (!ParseTimeField(filtersObj, LOG_FILTER_FIELDNAME_STARTTIME, &filter->hasStartTime, &filter->startTime)
+        || !ParseTimeField(filtersObj, LOG_FILTER_FIELDNAME_ENDTIME, &filter->hasEndTime, &filter->endTime))
+    {
+        Log_Error("LogFilter_Init invalid time, expected ISO 8601 e.g. 2026-10-01T00:00:00Z");
+        goto done;
+    }
+
+    if (filter->hasStartTime && filter->hasEndTime && filter->startTime > filter->endTime)
+    {
+        Log_Error("LogFilter_Init %s is after %s", LOG_FILTER_FIELDNAME_STARTTIME, LOG_FILTER_FIELDNAME_ENDTIME);
+        goto done;
+    }
+
+    if (json_object_has_value(filtersObj, LOG_FILTER_FIELDNAME_MINSEVERITY))
+    {
+        filter->minSeverity = ParseSeverity(json_object_get_string(filtersObj, LOG_FILTER_FIELDNAME_MINSEVERITY));
+        if (filter->minSeverity == LogFilter_Severity_Unknown)
+        {
+            Log_Error(
+                "LogFilter_Init invalid %s, expected debug, info, warning or error",
+                LOG_FILTER_FIELDNAME_MINSEVERITY);
+            goto done;
+        }
+    }
+
+    if (json_object_has_value(filtersObj, LOG_FILTER_FIELDNAME_CONTAINS))
+    {
+        const char* contains = json_object_get_string(filtersObj, LOG_FILTER_FIELDNAME_CONTAINS);
+        if (contains == NULL || *contains == '\0' || mallocAndStrcpy_s(&filter->contains, contains) != 0)
+        {
+            Log_Error("LogFilter_Init invalid %s", LOG_FILTER_FIELDNAME_CONTAINS);
+            goto done;
+        }
+    }
+
+    if (json_object_has_value(filtersObj, LOG_FILTER_FIELDNAME_REGEX))
+    {
+        const char* regex = json_object_get_string(filtersObj, LOG_FILTER_FIELDNAME_REGEX);
+        if (regex == NULL || *regex == '\0' || regcomp(&filter->regex, regex, REG_EXTENDED | REG_NOSUB) != 0)
+        {
+            Log_Error(
+                "LogFilter_Init invalid %s, expected a POSIX extended regular expression", LOG_FILTER_FIELDNAME_REGEX);
+            goto done;
+        }
+
+        filter->hasRegex = true;
+    }
+
+    filter->enabled = true;
+    succeeded = true;
+
+done:
+
+    if (!succeeded)
+    {
+        LogFilter_UnInit(filter);
+    }
+
+    return succeeded;
+}
+
+void LogFilter_UnInit(LogFilter* filter)
+{
+    if (filter == NULL)
+    {
+        return;
+    }
+
+    free(filter->contains);
+
+    if (filter->hasRegex)
+    {
+        regfree(&filter->regex);
+    }
+
+    memset(filter, 0, sizeof(*filter));
+}
+
+/**
+ * @brief Time and severity of the last line, which lines without a timestamp continue
+ */
+typedef struct tagLogFilter_Entry
+{
+    bool hasTime; //!< True if a timestamp was seen
+    time_t time; //!< The last timestamp
+    LogFilter_Severity severity; //!< The severity of the entry
+} LogFilter_Entry;
+
+/**
+ * @brief Checks @p line against @p filter, updating @p entry with its time and severity
+ * @param line the line, terminated without its newline
+ */
+static bool IsMatchingLine(const LogFilter* filter, LogFilter_Entry* entry, const char* line)
+{
+    time_t lineTime = 0;
+    if (LogFilter_ParseTime(line, &lineTime) != 0)
+    {
+        entry->hasTime = true;
+        entry->time = lineTime;
+        entry->severity = LogFilter_GetLineSeverity(line);
+    }
+    else
+    {
+        const LogFilter_Severity severity = LogFilter_GetLineSeverity(line);
+        if (severity != LogFilter_Severity_Unknown)
+        {
+            entry->severity = severity;
+        }
+    }
+
+    if ((filter->hasStartTime || filter->hasEndTime) && !entry->hasTime)
+    {
+        return false;
+    }
+
+    if ((filter->hasStartTime && entry->time < filter->startTime)
+        || (filter->hasEndTime && entry->time > filter->endTime))
+    {
+        return false;
+    }
+
+    if (filter->minSeverity != LogFilter_Severity_Unknown && entry->severity < filter->minSeverity)
+    {
+        return false;
+    }
+
+    if (filter->contains != NULL && strstr(line, filter->contains) == NULL)
+    {
+        return false;
+    }
+
+    return !filter->hasRegex || regexec(&filter->regex, line, 0, NULL, 0) == 0;
+}
+
+bool LogFilter_FilterFile(
+    const LogFilter* filter, const char* inputPath, const char* outputPath, LogFilter_Stats* stats)
+{
+    bool succeeded = false;
+    FILE* input = NULL;
+    FILE* output = NULL;
+    char* line = NULL;
+    size_t lineCapacity = 0;
+    LogFilter_Entry entry;
+
+    if (filter == NULL || inputPath == NULL || outputPath == NULL || stats == NULL)
+    {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    memset(&entry, 0, sizeof(entry));
+
+    input = fopen(inputPath, "r");
+    if (input == NULL)
+    {
+        Log_Error("LogFilter_FilterFile cannot open %s, errno: %d", inputPath, errno);
+        goto done;
+    }
+
+    output = fopen(outputPath, "w");
+    if (output == NULL)
+    {
+        Log_Error("LogFilter_FilterFile cannot create %s, errno: %d", outputPath, errno);
+        goto done;
+    }
+
+    ssize_t lineLength = 0;
+    while ((lineLength = getline(&line, &lineCapacity, input)) > 0)
+    {
+        ++stats->linesRead;
+        stats->bytesRead += (unsigned long long)lineLength;
+
+        // Match without the newline, and write the line as it was read.
+        const bool hasNewline = line[lineLength - 1] == '\n';
+        if (hasNewline)
+        {
+            line[lineLength - 1] = '\0';
+        }
+
+        if (!IsMatchingLine(filter, &entry, line))
+        {
+            continue;
+        }
+
+        if (hasNewline)
+        {
+            line[lineLength - 1] = '\n';
+        }
+
+        if (fwrite(line, 1, (size_t)lineLength, output) != (size_t)lineLength)
+        {
+            Log_Error("LogFilter_FilterFile cannot write %s, errno: %d", outputPath, errno);
+            goto done;
+        }
+
+        ++stats->linesWritten;
+        stats->bytesWritten += (unsigned long long)lineLength;
+    }
+
+    if (ferror(input))
+    {
+        Log_Error("LogFilter_FilterFile cannot read %s", inputPath);
+        goto done;
+    }
+
+    succeeded = true;
+
+done:
+
+    free(line);
+
+    if (input != NULL)
+    {
+        fclose(input);
+    }
+
+    if (output != NULL && fclose(output) != 0)
+    {
+        Log_Error("LogFilter_FilterFile cannot close %s, errno: %d", outputPath, errno);
+        succeeded = false;
+    }
+
+    return succeeded;
+}
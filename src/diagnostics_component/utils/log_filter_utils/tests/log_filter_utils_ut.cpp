@@ -0,0 +1,223 @@
+/**
+ * @file log_filter_utils_ut.cpp
+ * @brief Unit Tests for log_filter_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "log_filter_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <parson.h>
+#include <string>
+
+#define TEST_DIR "/tmp/adutest/log_filter_utils_ut"
+
+static bool InitFilter(LogFilter* filter, const char* json)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool initialized = LogFilter_Init(filter, json_value_get_object(value));
+    json_value_free(value);
+    return initialized;
+}
+
+/**
+ * @brief A log file in agent format and the path of its filtered copy.
+ */
+class TestLog
+{
+public:
+    explicit TestLog(const std::string& content) : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+        std::ofstream{ Input(), std::ios::binary } << content;
+    }
+
+    TestLog(const TestLog&) = delete;
+    TestLog& operator=(const TestLog&) = delete;
+    TestLog(TestLog&&) = delete;
+    TestLog& operator=(TestLog&&) = delete;
+
+    std::string Input() const
+    {
+        return _dir.GetDir() + "/aduc.log";
+    }
+
+    std::string Output() const
+    {
+        return _dir.GetDir() + "/aduc.log.filtered";
+    }
+
+    std::string Filter(const char* json, LogFilter_Stats* stats) const
+    {
+        LogFilter filter;
+        REQUIRE(InitFilter(&filter, json));
+        REQUIRE(LogFilter_FilterFile(&filter, Input().c_str(), Output().c_str(), stats));
+        LogFilter_UnInit(&filter);
+
+        std::ifstream file{ Output(), std::ios::binary };
+        return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+};
+
+static const std::string agentLog =
+    "2026-10-01T10:00:00.0000Z 100[101] [I] Agent started [main:10]\n"
+    "2026-10-01T10:05:00.0000Z 100[101] [D] Polling [Poll:20]\n"
+    "2026-10-01T11:00:00.0000Z 100[101] [W] Download slow, workflow 42 [Download:30]\n"
+    "2026-10-01T12:00:00.0000Z 100[101] [E] Install failed, resultCode: 5 [Install:40]\n"
+    "  continuation of the failure\n"
+    "2026-10-01T13:00:00.0000Z 100[101] [I] Workflow 42 done [Apply:50]";
+
+TEST_CASE("LogFilter_ParseTime")
+{
+    time_t time = 0;
+
+    SECTION("UTC")
+    {
+        CHECK(LogFilter_ParseTime("1970-01-01T00:00:00Z", &time) == 20);
+        CHECK(time == 0);
+        CHECK(LogFilter_ParseTime("2026-10-01T10:00:00.0000Z 100[101]", &time) == 25);
+        CHECK(time == 1790848800);
+        CHECK(LogFilter_ParseTime("2026-10-01 10:00:00 info", &time) == 19);
+        CHECK(time == 1790848800);
+    }
+
+    SECTION("Offsets")
+    {
+        CHECK(LogFilter_ParseTime("2026-10-01T12:00:00+02:00", &time) == 25);
+        CHECK(time == 1790848800);
+        CHECK(LogFilter_ParseTime("2026-10-01T05:30:00-0430", &time) == 24);
+        CHECK(time == 1790848800);
+    }
+
+    SECTION("Not a time")
+    {
+        CHECK(LogFilter_ParseTime("", &time) == 0);
+        CHECK(LogFilter_ParseTime("2026-10", &time) == 0);
+        CHECK(LogFilter_ParseTime("2026-13-01T00:00:00Z", &time) == 0);
+        CHECK(LogFilter_ParseTime("Oct  1 10:00:00 host agent", &time) == 0);
+        CHECK(LogFilter_ParseTime(nullptr, &time) == 0);
+    }
+}
+
+TEST_CASE("LogFilter_GetLineSeverity")
+{
+    CHECK(LogFilter_GetLineSeverity("2026-10-01T10:00:00.0000Z 1[2] [D] x [f:1]") == LogFilter_Severity_Debug);
+    CHECK(LogFilter_GetLineSeverity("2026-10-01T10:00:00.0000Z 1[2] [W] x [f:1]") == LogFilter_Severity_Warning);
+    CHECK(LogFilter_GetLineSeverity("[INFO] started") == LogFilter_Severity_Info);
+    CHECK(LogFilter_GetLineSeverity("2026-10-01 10:00:00 ERROR: no space") == LogFilter_Severity_Error);
+    CHECK(LogFilter_GetLineSeverity("<3>crit: device lost") == LogFilter_Severity_Error);
+    CHECK(LogFilter_GetLineSeverity("level=warning msg=slow") == LogFilter_Severity_Warning);
+    CHECK(LogFilter_GetLineSeverity("informational text") == LogFilter_Severity_Unknown);
+    CHECK(LogFilter_GetLineSeverity("a b c d e f g h i error") == LogFilter_Severity_Unknown);
+    CHECK(LogFilter_GetLineSeverity(nullptr) == LogFilter_Severity_Unknown);
+}
+
+TEST_CASE("LogFilter_Init")
+{
+    LogFilter filter;
+
+    SECTION("No filters")
+    {
+        REQUIRE(LogFilter_Init(&filter, nullptr));
+        CHECK_FALSE(filter.enabled);
+        LogFilter_UnInit(&filter);
+    }
+
+    SECTION("All filters")
+    {
+        REQUIRE(InitFilter(
+            &filter,
+            R"({"startTime":"2026-10-01T00:00:00Z","endTime":"2026-10-02T00:00:00Z",)"
+            R"("minSeverity":"warning","contains":"workflow","regex":"result(Code)?: [1-9]"})"));
+        CHECK(filter.enabled);
+        CHECK(filter.hasStartTime);
+        CHECK(filter.endTime - filter.startTime == 86400);
+        CHECK(filter.minSeverity == LogFilter_Severity_Warning);
+        CHECK(std::string{ filter.contains } == "workflow");
+        CHECK(filter.hasRegex);
+        LogFilter_UnInit(&filter);
+        CHECK(filter.contains == nullptr);
+    }
+
+    SECTION("Invalid filters")
+    {
+        CHECK_FALSE(InitFilter(&filter, R"({"startTime":"yesterday"})"));
+        CHECK_FALSE(filter.enabled);
+        CHECK_FALSE(InitFilter(&filter, R"({"endTime":"2026-10-01T00:00:00Z and more"})"));
+        CHECK_FALSE(InitFilter(&filter, R"({"startTime":"2026-10-02T00:00:00Z","endTime":"2026-10-01T00:00:00Z"})"));
+        CHECK_FALSE(InitFilter(&filter, R"({"minSeverity":"verbose"})"));
+        CHECK_FALSE(InitFilter(&filter, R"({"contains":""})"));
+        CHECK_FALSE(InitFilter(&filter, R"({"regex":"(unbalanced"})"));
+    }
+}
+
+TEST_CASE("LogFilter_FilterFile")
+{
+    TestLog log{ agentLog };
+    LogFilter_Stats stats;
+
+    SECTION("Time range")
+    {
+        CHECK(
+            log.Filter(R"({"startTime":"2026-10-01T11:00:00Z","endTime":"2026-10-01T12:00:00Z"})", &stats)
+            == "2026-10-01T11:00:00.0000Z 100[101] [W] Download slow, workflow 42 [Download:30]\n"
+               "2026-10-01T12:00:00.0000Z 100[101] [E] Install failed, resultCode: 5 [Install:40]\n"
+               "  continuation of the failure\n");
+        CHECK(stats.linesRead == 6);
+        CHECK(stats.linesWritten == 3);
+        CHECK(stats.bytesRead == agentLog.size());
+    }
+
+    SECTION("Minimum severity includes continuation lines")
+    {
+        CHECK(
+            log.Filter(R"({"minSeverity":"error"})", &stats)
+            == "2026-10-01T12:00:00.0000Z 100[101] [E] Install failed, resultCode: 5 [Install:40]\n"
+               "  continuation of the failure\n");
+    }
+
+    SECTION("Substring and regex")
+    {
+        CHECK(
+            log.Filter(R"({"contains":"42"})", &stats)
+            == "2026-10-01T11:00:00.0000Z 100[101] [W] Download slow, workflow 42 [Download:30]\n"
+               "2026-10-01T13:00:00.0000Z 100[101] [I] Workflow 42 done [Apply:50]");
+        CHECK(stats.linesWritten == 2);
+
+        CHECK(
+            log.Filter(R"({"regex":"[Ww]orkflow [0-9]+ done"})", &stats)
+            == "2026-10-01T13:00:00.0000Z 100[101] [I] Workflow 42 done [Apply:50]");
+    }
+
+    SECTION("All filters must pass")
+    {
+        CHECK(log.Filter(R"({"minSeverity":"warning","contains":"done"})", &stats).empty());
+        CHECK(stats.linesWritten == 0);
+        CHECK(stats.bytesWritten == 0);
+    }
+
+    SECTION("Lines without time or severity do not pass those filters")
+    {
+        TestLog plainLog{ "no time here\nERROR: but a severity\n" };
+        CHECK(plainLog.Filter(R"({"startTime":"2026-10-01T00:00:00Z"})", &stats).empty());
+        CHECK(plainLog.Filter(R"({"minSeverity":"info"})", &stats) == "ERROR: but a severity\n");
+    }
+
+    SECTION("Missing input")
+    {
+        LogFilter filter;
+        REQUIRE(InitFilter(&filter, R"({"contains":"x"})"));
+        CHECK_FALSE(LogFilter_FilterFile(&filter, "/nonexistent/aduc.log", log.Output().c_str(), &stats));
+        LogFilter_UnInit(&filter);
+    }
+}
@@ -6,7 +6,7 @@
  * Licensed under the MIT License.
  */
 
-#include "curl_content_downloader.h" // for Download_curl
+#include "curl_content_downloader.h" // for Download_curl, Initialize_curl
 #include <aduc/c_utils.h> // for EXTERN_C_BEGIN, EXTERN_C_END
 #include <aduc/contract_utils.h> // for ADUC_ExtensionContractInfo
 #include <aduc/types/download.h> // for ADUC_DownloadProgressCallback
@@ -33,8 +33,7 @@ EXPORTED_METHOD ADUC_Result Download(
 
 EXPORTED_METHOD ADUC_Result Initialize(const char* initializeData)
 {
-    UNREFERENCED_PARAMETER(initializeData);
-    return { ADUC_GeneralResult_Success };
+    return Initialize_curl(initializeData);
 }
 
 /**
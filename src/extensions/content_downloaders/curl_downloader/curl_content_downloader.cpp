@@ -6,19 +6,41 @@
  * Licensed under the MIT License.
  */
 
+#include "aduc/config_utils.h" // for ADUC_ConfigInfo_GetInstance
 #include "aduc/content_downloader_extension.hpp"
 #include "aduc/contract_utils.h"
+#include "aduc/curl_download_utils.hpp" // for ADUC::CurlDownload::Downloader
 #include "aduc/hash_utils.h"
 #include "aduc/logging.h"
-#include "aduc/process_utils.hpp" // for ADUC_LaunchChildProcess
 
 #include <sstream>
+#include <string>
 #include <sys/stat.h> // for stat
-#include <vector>
 
 // keep this last to minimize chance to interfere with system header includes.
 #include "aduc/aduc_banned.h"
 
+/**
+ * @brief Downloads with curl and the download settings of du-config.json.
+ * @details Destroyed when the extension is unloaded, which stops the DNS cache refresh thread before the code is
+ * unmapped.
+ */
+static ADUC::CurlDownload::Downloader s_curlDownloader;
+
+ADUC_Result Initialize_curl(const char* initializeData)
+{
+    UNREFERENCED_PARAMETER(initializeData);
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config != nullptr)
+    {
+        s_curlDownloader.Initialize(config);
+        ADUC_ConfigInfo_ReleaseInstance(config);
+    }
+
+    return { ADUC_GeneralResult_Success };
+}
+
 ADUC_Result Download_curl(
     const ADUC_FileEntity* entity,
     const char* workflowId,
@@ -29,7 +51,6 @@ ADUC_Result Download_curl(
     UNREFERENCED_PARAMETER(timeoutInSeconds);
     ADUC_Result result = { ADUC_Result_Failure };
     SHAversion algVersion;
-    std::vector<std::string> args;
     std::string output;
     int exitCode = 1;
     std::stringstream fullFilePath;
@@ -108,12 +129,7 @@ ADUC_Result Download_curl(
         entity->DownloadUri,
         fullFilePath.str().c_str());
 
-    args.emplace_back("-o");
-    args.emplace_back(fullFilePath.str().c_str());
-    args.emplace_back("-O");
-    args.emplace_back(entity->DownloadUri);
-
-    exitCode = ADUC_LaunchChildProcess("/usr/bin/curl", args, output);
+    exitCode = s_curlDownloader.Download(entity->DownloadUri, fullFilePath.str(), nullptr, output);
 
     if (exitCode == 0)
     {
@@ -3,6 +3,8 @@
 #include <aduc/types/download.h> // for ADUC_DownloadProgressCallback
 #include <aduc/types/update_content.h> // for ADUC_FileEntity
 
+ADUC_Result Initialize_curl(const char* initializeData);
+
 ADUC_Result Download_curl(
     const ADUC_FileEntity* entity,
     const char* workflowId,
@@ -0,0 +1,411 @@
+/**
+ * @file peer_content_downloader.cpp
+ * @brief Content Downloader Extension that fetches payloads from agents on the local network,
+ * and falls back to the origin URL with the curl command.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+
+#include "peer_content_downloader.h"
+#include "aduc/config_utils.h" // for ADUC_ConfigInfo_GetInstance
+#include "aduc/content_downloader_extension.hpp"
+#include "aduc/contract_utils.h"
+#include "aduc/curl_download_utils.hpp" // for ADUC::CurlDownload::Downloader
+#include "aduc/hash_utils.h"
+#include "aduc/logging.h"
+#include "aduc/multicast_utils.h"
+#include "aduc/peer_sharing_utils.h"
+#include "aduc/socket_tuning_utils.h" // for ADUC_SocketTuning_ParseProfile
+
+#include <cstring> // for memset
+#include <errno.h>
+#include <fcntl.h> // for open
+#include <memory>
+#include <sstream>
+#include <stdio.h> // for remove
+#include <sys/stat.h> // for stat
+#include <unistd.h> // for pread, pwrite
+#include <vector>
+
+// keep this last to minimize chance to interfere with system header includes.
+#include "aduc/aduc_banned.h"
+
+namespace
+{
+/**
+ * @brief Frees the peer sharing instance.
+ */
+struct PeerSharingDeleter
+{
+    void operator()(ADUC_PeerSharing* sharing) const
+    {
+        ADUC_PeerSharing_Destroy(sharing);
+    }
+};
+
+/**
+ * @brief The peer sharing instance, or nullptr if peer sharing is not enabled.
+ * @details Destroyed when the extension is unloaded, which stops the sharing threads before the code is unmapped.
+ */
+std::unique_ptr<ADUC_PeerSharing, PeerSharingDeleter> s_peerSharing;
+
+/**
+ * @brief The multicast receiver configuration. Disabled if multicast is not configured.
+ */
+ADUC_Multicast_ReceiverConfig s_multicastConfig;
+
+/**
+ * @brief Downloads from the origin URL with curl and the download settings of du-config.json.
+ * @details Destroyed when the extension is unloaded, which stops the DNS cache refresh thread before the code is
+ * unmapped.
+ */
+ADUC::CurlDownload::Downloader s_originDownloader;
+
+/**
+ * @brief The context of FetchOriginRange.
+ */
+struct OriginContext
+{
+    const char* downloadUri; /**< The origin URL. */
+    std::string rangeFilePath; /**< Temporary file for a range. */
+};
+
+/**
+ * @brief Downloads a range of the payload from the origin URL with curl.
+ */
+bool FetchOriginRange(void* context, int fd, uint64_t offset, uint64_t length)
+{
+    const auto* origin = static_cast<const OriginContext*>(context);
+    bool succeeded = false;
+    int rangeFd = -1;
+    std::string output;
+    std::vector<char> buffer(64 * 1024);
+    std::stringstream range;
+    range << offset << "-" << (offset + length - 1);
+
+    const int exitCode =
+        s_originDownloader.Download(origin->downloadUri, origin->rangeFilePath, range.str().c_str(), output);
+    if (exitCode != 0)
+    {
+        Log_Error("curl failed to download range %s, exit code: %d", range.str().c_str(), exitCode);
+        goto done;
+    }
+
+    rangeFd = open(origin->rangeFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (rangeFd == -1)
+    {
+        goto done;
+    }
+
+    // A server that ignores the range returns the whole file, which is detected by the size.
+    for (uint64_t copied = 0; copied <= length;)
+    {
+        const ssize_t readSize = pread(rangeFd, buffer.data(), buffer.size(), static_cast<off_t>(copied));
+        if (readSize == 0)
+        {
+            succeeded = (copied == length);
+            break;
+        }
+
+        if (readSize < 0 || copied + static_cast<uint64_t>(readSize) > length
+            || pwrite(fd, buffer.data(), static_cast<size_t>(readSize), static_cast<off_t>(offset + copied))
+                != readSize)
+        {
+            break;
+        }
+
+        copied += static_cast<uint64_t>(readSize);
+    }
+
+    if (!succeeded)
+    {
+        Log_Error("Range %s from origin has an unexpected size", range.str().c_str());
+    }
+
+done:
+    if (rangeFd != -1)
+    {
+        close(rangeFd);
+    }
+
+    remove(origin->rangeFilePath.c_str());
+    return succeeded;
+}
+
+/**
+ * @brief Downloads the whole payload from the origin URL with curl.
+ *
+ * @return int The curl exit code.
+ */
+int DownloadFromOrigin(const char* downloadUri, const std::string& filePath)
+{
+    std::string output;
+
+    const int exitCode = s_originDownloader.Download(downloadUri, filePath, nullptr, output);
+
+    Log_Info("Download output:: \n%s", output.c_str());
+    return exitCode;
+}
+
+/**
+ * @brief Downloads the payload from peers, if any peer holds it, and validates it.
+ *
+ * @return bool true if the payload was downloaded and is valid.
+ */
+bool DownloadFromPeers(
+    const ADUC_FileEntity* entity, const char* hash, SHAversion algVersion, const std::string& filePath)
+{
+    ADUC_PeerSharing_Peer peers[ADUC_PEER_SHARING_MAX_PEERS];
+    ADUC_PeerSharing_Stats stats;
+
+    const size_t peerCount = ADUC_PeerSharing_FindPeers(
+        s_peerSharing.get(), hash, entity->SizeInBytes, peers, ADUC_PEER_SHARING_MAX_PEERS);
+    if (peerCount == 0)
+    {
+        return false;
+    }
+
+    Log_Info("Downloading File '%s' from %zu peers", entity->TargetFilename, peerCount);
+
+    OriginContext origin{ entity->DownloadUri, filePath + ".range" };
+    if (!ADUC_PeerSharing_Download(
+            s_peerSharing.get(), hash, peers, peerCount, filePath.c_str(), FetchOriginRange, &origin, &stats))
+    {
+        return false;
+    }
+
+    // Peers are not trusted, so the assembled file must match the manifest hash before it is used.
+    if (!ADUC_HashUtils_IsValidFileHash(filePath.c_str(), hash, algVersion, true /* suppressErrorLog */))
+    {
+        Log_Warn("File '%s' from peers does not match the manifest hash", entity->TargetFilename);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Receives the payload from a multicast transmission, if one is announced, and validates it.
+ *
+ * @return bool true if the payload was received and is valid.
+ */
+bool DownloadFromMulticast(
+    const ADUC_FileEntity* entity, const char* hash, SHAversion algVersion, const std::string& filePath)
+{
+    ADUC_Multicast_Stats stats;
+    OriginContext origin{ entity->DownloadUri, filePath + ".range" };
+
+    if (!ADUC_Multicast_Receive(
+            &s_multicastConfig,
+            hash,
+            entity->SizeInBytes,
+            filePath.c_str(),
+            FetchOriginRange,
+            &origin,
+            &stats))
+    {
+        return false;
+    }
+
+    // Multicast is not authenticated, so the file must match the manifest hash before it is used.
+    if (!ADUC_HashUtils_IsValidFileHash(filePath.c_str(), hash, algVersion, true /* suppressErrorLog */))
+    {
+        Log_Warn("File '%s' from multicast does not match the manifest hash", entity->TargetFilename);
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+ADUC_Result Initialize_peer(const char* initializeData)
+{
+    UNREFERENCED_PARAMETER(initializeData);
+
+    ADUC_PeerSharing_Config peerSharingConfig;
+    memset(&peerSharingConfig, 0, sizeof(peerSharingConfig));
+
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+    if (config != nullptr)
+    {
+        ADUC_PeerSharing_ParseConfig(&peerSharingConfig, config->peerSharing);
+        ADUC_SocketTuning_ParseProfile(&peerSharingConfig.socketTuning, config->socketTuning);
+        ADUC_Multicast_ParseReceiverConfig(
+            &s_multicastConfig, json_object_get_object(config->peerSharing, "multicast"));
+
+        s_originDownloader.Initialize(config);
+
+        ADUC_ConfigInfo_ReleaseInstance(config);
+    }
+
+    if (peerSharingConfig.enabled && s_peerSharing == nullptr)
+    {
+        s_peerSharing.reset(ADUC_PeerSharing_Create(&peerSharingConfig));
+    }
+
+    if (s_peerSharing == nullptr)
+    {
+        Log_Info("Peer sharing is not enabled. Payloads are downloaded from the origin only.");
+    }
+
+    return { ADUC_GeneralResult_Success };
+}
+
+ADUC_Result Download_peer(
+    const ADUC_FileEntity* entity,
+    const char* workflowId,
+    const char* workFolder,
+    unsigned int timeoutInSeconds,
+    ADUC_DownloadProgressCallback downloadProgressCallback)
+{
+    UNREFERENCED_PARAMETER(timeoutInSeconds);
+    ADUC_Result result = { ADUC_Result_Failure };
+    SHAversion algVersion;
+    const char* hash = nullptr;
+    int exitCode = 1;
+    std::stringstream fullFilePath;
+    bool reportProgress = false;
+
+    if (entity == nullptr)
+    {
+        result.ExtendedResultCode = ADUC_ERC_CONTENT_DOWNLOADER_INVALID_FILE_ENTITY;
+        goto done;
+    }
+
+    if (entity->DownloadUri == nullptr || *entity->DownloadUri == 0)
+    {
+        result.ExtendedResultCode = ADUC_ERC_CONTENT_DOWNLOADER_INVALID_DOWNLOAD_URI;
+        goto done;
+    }
+
+    if (entity->HashCount == 0)
+    {
+        Log_Error("File entity does not contain a file hash! Cannot validate cancelling download.");
+        result.ExtendedResultCode = ADUC_ERC_VALIDATION_FILE_HASH_IS_EMPTY;
+        if (downloadProgressCallback != nullptr)
+        {
+            downloadProgressCallback(
+                workflowId,
+                entity->FileId,
+                ADUC_DownloadProgressState_Error,
+                result.ResultCode,
+                result.ExtendedResultCode);
+        }
+        goto done;
+    }
+
+    fullFilePath << workFolder << "/" << entity->TargetFilename;
+    hash = ADUC_HashUtils_GetHashValue(entity->Hash, entity->HashCount, 0);
+
+    if (!ADUC_HashUtils_GetShaVersionForTypeString(
+            ADUC_HashUtils_GetHashType(entity->Hash, entity->HashCount, 0), &algVersion))
+    {
+        Log_Error(
+            "FileEntity for %s has unsupported hash type %s",
+            fullFilePath.str().c_str(),
+            ADUC_HashUtils_GetHashType(entity->Hash, entity->HashCount, 0));
+        result.ExtendedResultCode = ADUC_ERC_VALIDATION_FILE_HASH_TYPE_NOT_SUPPORTED;
+
+        if (downloadProgressCallback != nullptr)
+        {
+            downloadProgressCallback(
+                workflowId,
+                entity->FileId,
+                ADUC_DownloadProgressState_Error,
+                result.ResultCode,
+                result.ExtendedResultCode);
+        }
+        goto done;
+    }
+
+    // If target file exists, validate file hash.
+    // If file is valid, then skip the download.
+    if (ADUC_HashUtils_IsValidFileHash(fullFilePath.str().c_str(), hash, algVersion, false /* suppressErrorLog */))
+    {
+        result = { ADUC_Result_Download_Skipped_FileExists };
+        reportProgress = true;
+        goto done;
+    }
+
+    if (s_multicastConfig.enabled && DownloadFromMulticast(entity, hash, algVersion, fullFilePath.str()))
+    {
+        result = { ADUC_Result_Download_Success };
+        reportProgress = true;
+        goto done;
+    }
+
+    if (s_peerSharing != nullptr && DownloadFromPeers(entity, hash, algVersion, fullFilePath.str()))
+    {
+        result = { ADUC_Result_Download_Success };
+        reportProgress = true;
+        goto done;
+    }
+
+    Log_Info(
+        "Downloading File '%s' from '%s' to '%s'",
+        entity->TargetFilename,
+        entity->DownloadUri,
+        fullFilePath.str().c_str());
+
+    exitCode = DownloadFromOrigin(entity->DownloadUri, fullFilePath.str());
+    if (exitCode != 0)
+    {
+        result.ResultCode = ADUC_Result_Failure;
+        result.ExtendedResultCode = ADUC_ERROR_CURL_DOWNLOADER_EXTERNAL_FAILURE(exitCode);
+        reportProgress = true;
+        goto done;
+    }
+
+    Log_Info("Validating file hash");
+
+    if (!ADUC_HashUtils_IsValidFileHash(fullFilePath.str().c_str(), hash, algVersion, true /* suppressErrorLog */))
+    {
+        Log_Error("Hash for %s is not valid", entity->TargetFilename);
+
+        result.ResultCode = ADUC_Result_Failure;
+        result.ExtendedResultCode = ADUC_ERC_VALIDATION_FILE_HASH_INVALID_HASH;
+        reportProgress = true;
+        goto done;
+    }
+
+    result = { ADUC_Result_Download_Success };
+    reportProgress = true;
+
+done:
+
+    // Only content that matches the manifest hash is offered to peers.
+    if (IsAducResultCodeSuccess(result.ResultCode) && s_peerSharing != nullptr)
+    {
+        ADUC_PeerSharing_ShareFile(s_peerSharing.get(), hash, fullFilePath.str().c_str());
+    }
+
+    if (reportProgress && (downloadProgressCallback != nullptr))
+    {
+        if (IsAducResultCodeSuccess(result.ResultCode))
+        {
+            struct stat st;
+            const off_t fileSize{ (stat(fullFilePath.str().c_str(), &st) == 0) ? st.st_size : 0 };
+            downloadProgressCallback(
+                workflowId, entity->FileId, ADUC_DownloadProgressState_Completed, fileSize, entity->SizeInBytes);
+        }
+        else
+        {
+            downloadProgressCallback(
+                workflowId,
+                entity->FileId,
+                (result.ResultCode == ADUC_Result_Failure_Cancelled) ? ADUC_DownloadProgressState_Cancelled
+                                                                     : ADUC_DownloadProgressState_Error,
+                0,
+                entity->SizeInBytes);
+        }
+    }
+
+    Log_Info(
+        "Download task end. resultCode: %d, extendedCode: %d (0x%X)",
+        result.ResultCode,
+        result.ExtendedResultCode,
+        result.ExtendedResultCode);
+    return result;
+}
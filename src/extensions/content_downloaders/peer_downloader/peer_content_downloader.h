@@ -0,0 +1,12 @@
+#include <aduc/result.h> // for ADUC_Result
+#include <aduc/types/download.h> // for ADUC_DownloadProgressCallback
+#include <aduc/types/update_content.h> // for ADUC_FileEntity
+
+ADUC_Result Initialize_peer(const char* initializeData);
+
+ADUC_Result Download_peer(
+    const ADUC_FileEntity* entity,
+    const char* workflowId,
+    const char* workFolder,
+    unsigned int timeoutInSeconds,
+    ADUC_DownloadProgressCallback downloadProgressCallback);
@@ -10,6 +10,7 @@
 #define ADUC_DOWNLOAD_HANDLER_FACTORY_HPP
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -47,6 +48,11 @@ private:
      *
      */
     std::unordered_map<std::string, std::unique_ptr<DownloadHandlerPlugin>> cachedPlugins;
+
+    /**
+     * @brief Guards cachedPlugins. Plugins are also loaded by the housekeeping worker thread.
+     */
+    std::mutex cachedPluginsMutex;
 };
 
 #endif // ADUC_DOWNLOAD_HANDLER_FACTORY_HPP
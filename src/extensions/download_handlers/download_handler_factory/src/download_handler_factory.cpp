@@ -15,6 +15,7 @@
 #include <aduc/logging.h> // ADUC_Logging_GetLevel
 #include <aduc/plugin_exception.hpp>
 #include <aduc/types/update_content.h> // ADUC_FileEntity
+#include <mutex>
 #include <unordered_map>
 
 using DownloadHandlerHandle = void*;
@@ -28,6 +29,8 @@ DownloadHandlerFactory* DownloadHandlerFactory::GetInstance()
 
 DownloadHandlerPlugin* DownloadHandlerFactory::LoadDownloadHandler(const std::string& downloadHandlerId) noexcept
 {
+    std::lock_guard<std::mutex> lock{ cachedPluginsMutex };
+
     auto entry = cachedPlugins.find(downloadHandlerId);
     if (entry != cachedPlugins.end())
     {
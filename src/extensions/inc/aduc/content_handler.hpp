@@ -11,6 +11,7 @@
 #include <aduc/c_utils.h>
 #include <aduc/contract_utils.h>
 #include <aduc/result.h>
+#include <stddef.h>
 
 // Forward declaration.
 struct tagADUC_WorkflowData;
@@ -40,6 +41,39 @@ public:
     {
     }
 
+    // The batch methods follow the destructor, so that handlers built against the v1.0 contract keep their vtable
+    // layout. Add new virtual methods below them.
+
+    /**
+     * @brief Installs a contiguous run of steps of this handler at once, e.g. in one package manager transaction.
+     * The steps handler only calls it if the handler reports a v1.1 contract (ADUC_V1_1_CONTRACT_MINOR_VER).
+     * The default installs the steps one by one, until the first failure.
+     *
+     * @param stepWorkflows The workflows of the steps, in manifest order.
+     * @param stepCount The number of steps.
+     * @param[out] stepResults The install result of each step.
+     * @return ADUC_Result The result of the batch, a failure if any step failed.
+     */
+    virtual ADUC_Result InstallBatch(
+        const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults)
+    {
+        return ForEachStep(&ContentHandler::Install, stepWorkflows, stepCount, stepResults);
+    }
+
+    /**
+     * @brief Applies a contiguous run of installed steps of this handler at once. See InstallBatch.
+     *
+     * @param stepWorkflows The workflows of the steps, in manifest order.
+     * @param stepCount The number of steps.
+     * @param[out] stepResults The apply result of each step.
+     * @return ADUC_Result The result of the batch, a failure if any step failed.
+     */
+    virtual ADUC_Result ApplyBatch(
+        const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults)
+    {
+        return ForEachStep(&ContentHandler::Apply, stepWorkflows, stepCount, stepResults);
+    }
+
     void SetContractInfo(const ADUC_ExtensionContractInfo& info)
     {
         contractInfo = info;
@@ -53,6 +87,36 @@ public:
 protected:
     ContentHandler() = default;
 
+    /**
+     * @brief Calls @p action for each step until the first failure. Steps that are not reached fail.
+     */
+    ADUC_Result ForEachStep(
+        ADUC_Result (ContentHandler::*action)(const tagADUC_WorkflowData*),
+        const tagADUC_WorkflowData* const* stepWorkflows,
+        size_t stepCount,
+        ADUC_Result* stepResults)
+    {
+        ADUC_Result result = { ADUC_GeneralResult_Failure, 0 };
+
+        for (size_t i = 0; i < stepCount; i++)
+        {
+            stepResults[i] = { ADUC_GeneralResult_Failure, 0 };
+        }
+
+        for (size_t i = 0; i < stepCount; i++)
+        {
+            result = (this->*action)(stepWorkflows[i]);
+            stepResults[i] = result;
+
+            if (IsAducResultCodeFailure(result.ResultCode))
+            {
+                break;
+            }
+        }
+
+        return result;
+    }
+
 private:
     ADUC_ExtensionContractInfo contractInfo{};
 };
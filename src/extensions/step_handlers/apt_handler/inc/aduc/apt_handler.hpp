@@ -57,6 +57,8 @@ public:
     ADUC_Result Restore(const tagADUC_WorkflowData* workflowData) override;
     ADUC_Result Cancel(const tagADUC_WorkflowData* workflowData) override;
     ADUC_Result IsInstalled(const tagADUC_WorkflowData* workflowData) override;
+    ADUC_Result InstallBatch(
+        const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults) override;
 
 protected:
     AptHandlerImpl()
@@ -65,6 +67,8 @@ protected:
 
 private:
     ADUC_Result ParseContent(const std::string& aptManifestFile, std::unique_ptr<AptContent>& aptContent);
+    ADUC_Result ReadPackages(const tagADUC_WorkflowData* workflowData, std::vector<std::string>& packages);
+    ADUC_Result InstallPackages(const std::vector<std::string>& packages);
 };
 
 /**
@@ -32,6 +32,7 @@
 #include <parson.h>
 #include <sstream>
 #include <string>
+#include <vector>
 
 // keep this last to avoid interfering with system headers
 #include "aduc/aduc_banned.h"
@@ -80,8 +81,9 @@ EXPORTED_METHOD ContentHandler* CreateUpdateContentHandlerExtension(ADUC_LOG_SEV
  */
 EXPORTED_METHOD ADUC_Result GetContractInfo(ADUC_ExtensionContractInfo* contractInfo)
 {
+    // The APT handler supports step batches.
     contractInfo->majorVer = ADUC_V1_CONTRACT_MAJOR_VER;
-    contractInfo->minorVer = ADUC_V1_CONTRACT_MINOR_VER;
+    contractInfo->minorVer = ADUC_V1_1_CONTRACT_MINOR_VER;
     return ADUC_Result{ ADUC_GeneralResult_Success, 0 };
 }
 
@@ -295,28 +297,19 @@ done:
 }
 
 /**
- * @brief Install implementation for APT Handler.
+ * @brief Appends the packages of the APT manifest of a step to @p packages.
  *
- * @return ADUC_Result The result of the install.
+ * @return ADUC_Result The result of reading the APT manifest.
  */
-ADUC_Result AptHandlerImpl::Install(const ADUC_WorkflowData* workflowData)
+ADUC_Result AptHandlerImpl::ReadPackages(const ADUC_WorkflowData* workflowData, std::vector<std::string>& packages)
 {
-    std::string aptOutput;
-    int aptExitCode = -1;
-    ADUC_Result result = { .ResultCode = ADUC_Result_Download_Success, .ExtendedResultCode = 0 };
+    ADUC_Result result = { .ResultCode = ADUC_Result_Failure, .ExtendedResultCode = 0 };
     ADUC_FileEntity fileEntity;
     memset(&fileEntity, 0, sizeof(fileEntity));
     ADUC_WorkflowHandle handle = workflowData->WorkflowHandle;
     char* workFolder = workflow_get_workfolder(handle);
     std::stringstream aptManifestFilename;
     std::unique_ptr<AptContent> aptContent;
-    const ADUC_ConfigInfo* config = nullptr;
-
-    if (workflow_is_cancel_requested(handle))
-    {
-        result = this->Cancel(workflowData);
-        goto done;
-    }
 
     if (!workflow_get_update_file(handle, 0, &fileEntity))
     {
@@ -333,7 +326,26 @@ ADUC_Result AptHandlerImpl::Install(const ADUC_WorkflowData* workflowData)
         goto done;
     }
 
-    config = ADUC_ConfigInfo_GetInstance();
+    packages.insert(packages.end(), aptContent->Packages.begin(), aptContent->Packages.end());
+
+done:
+    workflow_free_string(workFolder);
+    ADUC_FileEntity_Uninit(&fileEntity);
+    return result;
+}
+
+/**
+ * @brief Installs @p packages in one apt-get transaction through adu-shell.
+ *
+ * @return ADUC_Result The result of the install.
+ */
+ADUC_Result AptHandlerImpl::InstallPackages(const std::vector<std::string>& packages)
+{
+    std::string aptOutput;
+    int aptExitCode = -1;
+    ADUC_Result result = { .ResultCode = ADUC_Result_Failure, .ExtendedResultCode = 0 };
+    const ADUC_ConfigInfo* config = ADUC_ConfigInfo_GetInstance();
+
     if (config == NULL)
     {
         Log_Error("Failed to get config instance.");
@@ -354,7 +366,7 @@ ADUC_Result AptHandlerImpl::Install(const ADUC_WorkflowData* workflowData)
 
         // For microsoft/apt, target-data is a list of packages.
         std::stringstream data;
-        for (const std::string& package : aptContent->Packages)
+        for (const std::string& package : packages)
         {
             data << package << " ";
         }
@@ -387,8 +399,70 @@ ADUC_Result AptHandlerImpl::Install(const ADUC_WorkflowData* workflowData)
 
 done:
     ADUC_ConfigInfo_ReleaseInstance(config);
-    workflow_free_string(workFolder);
-    ADUC_FileEntity_Uninit(&fileEntity);
+    return result;
+}
+
+/**
+ * @brief Install implementation for APT Handler.
+ *
+ * @return ADUC_Result The result of the install.
+ */
+ADUC_Result AptHandlerImpl::Install(const ADUC_WorkflowData* workflowData)
+{
+    ADUC_Result result = { .ResultCode = ADUC_Result_Failure, .ExtendedResultCode = 0 };
+    std::vector<std::string> packages;
+
+    if (workflow_is_cancel_requested(workflowData->WorkflowHandle))
+    {
+        return this->Cancel(workflowData);
+    }
+
+    result = ReadPackages(workflowData, packages);
+    if (IsAducResultCodeFailure(result.ResultCode))
+    {
+        return result;
+    }
+
+    return InstallPackages(packages);
+}
+
+/**
+ * @brief Installs the packages of consecutive APT steps in one apt-get transaction, so that the dependencies are
+ * solved and dpkg runs once. The transaction succeeds or fails as a whole, so every step gets its result.
+ *
+ * @return ADUC_Result The result of the install.
+ */
+ADUC_Result AptHandlerImpl::InstallBatch(
+    const ADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults)
+{
+    ADUC_Result result = { .ResultCode = ADUC_Result_Failure, .ExtendedResultCode = 0 };
+    std::vector<std::string> packages;
+
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        if (workflow_is_cancel_requested(stepWorkflows[i]->WorkflowHandle))
+        {
+            result = this->Cancel(stepWorkflows[i]);
+            goto done;
+        }
+
+        result = ReadPackages(stepWorkflows[i], packages);
+        if (IsAducResultCodeFailure(result.ResultCode))
+        {
+            goto done;
+        }
+    }
+
+    Log_Info("Installing the packages of %zu APT steps in one transaction.", stepCount);
+
+    result = InstallPackages(packages);
+
+done:
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        stepResults[i] = result;
+    }
+
     return result;
 }
 
@@ -9,6 +9,7 @@
 #define ADUC_FSUPDATE_HANDLER_HPP
 
 #include "aduc/content_handler.hpp"
+#include "aduc/fsupdate_state.hpp"
 #include "aduc/logging.h"
 #include <filesystem>
 #include <memory>
@@ -54,6 +55,8 @@ private:
     std::filesystem::path work_dir;
     /* default permissions of work directory */
     std::filesystem::perms work_dir_perms;
+    /* state shared with the update tooling through work_dir, as last written */
+    FSUpdate::UpdateState state;
     bool create_work_dir();
 public:
     static ContentHandler* CreateContentHandler();
@@ -0,0 +1,59 @@
+/**
+ * @file fsupdate_state.hpp
+ * @brief Defines the persisted state of the fsupdate handler.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_FSUPDATE_STATE_HPP
+#define ADUC_FSUPDATE_STATE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace FSUpdate
+{
+/**
+ * @brief The handler state that is shared with the update tooling through the work directory.
+ * @details Each field is kept in its own file (update_version, update_type, update_size, update_location,
+ * errorState), since the fs-updater tooling reads them.
+ */
+struct UpdateState
+{
+    std::string updateVersion; /**< The installed criteria of the update. */
+    std::string updateType; /**< The update type name, e.g. "firmware". */
+    int64_t updateSize = 0; /**< The size of the update payload. */
+    std::string updateLocation; /**< The full path of the downloaded update payload. */
+    bool hasResult = false; /**< True once the result of an install is known. */
+    int32_t resultCode = 0; /**< ResultCode of the last install. */
+    int32_t extendedResultCode = 0; /**< ExtendedResultCode of the last install. */
+};
+
+/**
+ * @brief Writes the state files in @p workDir that differ between @p saved and @p state.
+ * @details Each file is written to a temporary file, flushed to storage and renamed over the previous file,
+ * so readers see either the old or the new value. The directory is synced once afterwards.
+ * update_version, update_type and update_size are only written once there is an update type,
+ * update_location once it has a value, and errorState once there is an install result.
+ *
+ * @param workDir The work directory.
+ * @param[in,out] saved The state the files in @p workDir hold. Set to @p state on success.
+ * @param state The state to write.
+ * @return true on success.
+ */
+bool SaveState(const std::filesystem::path& workDir, UpdateState& saved, const UpdateState& state);
+
+/**
+ * @brief Loads the handler state from the files in @p workDir, once when the handler is created.
+ * @details The install result is not loaded, since errorState holds its two codes without a separator.
+ *
+ * @param workDir The work directory.
+ * @param[out] state The loaded state. Left default-initialized if there is no state.
+ * @return true if a state was loaded.
+ */
+bool LoadState(const std::filesystem::path& workDir, UpdateState& state);
+
+} // namespace FSUpdate
+
+#endif // ADUC_FSUPDATE_STATE_HPP
@@ -17,6 +17,7 @@
  */
 #include "aduc/fsupdate_handler.hpp"
 #include "aduc/fsupdate_result.h" /* fsupdate result codes */
+#include "aduc/fsupdate_state.hpp"
 
 #include "aduc/adu_core_exports.h"
 #include "aduc/config_utils.h"
@@ -24,6 +25,7 @@
 #include "aduc/logging.h"
 #include "aduc/parser_utils.h" // ADUC_FileEntity_Uninit
 #include "aduc/process_utils.hpp"
+#include "aduc/sparse_image_utils.h"
 #include "aduc/string_c_utils.h"
 #include "aduc/string_utils.hpp"
 #include "aduc/system_utils.h"
@@ -113,6 +115,8 @@ EXTERN_C_END
 FSUpdateHandlerImpl::FSUpdateHandlerImpl() :
     work_dir(TEMP_ADU_WORK_DIR), work_dir_perms(std::filesystem::perms::all)
 {
+    // Read once; later transitions only write the state files that change.
+    FSUpdate::LoadState(work_dir, state);
 }
 
 /**
@@ -219,18 +223,6 @@ static ADUC_Result HandleExecuteAction(const std::string& targetaction, std::str
     return result;
 }
 
-static void WriteErrorState(const std::filesystem::path& error_file, ADUC_Result& error_code)
-{
-    std::ofstream error_state(error_file);
-    if (!error_state.is_open())
-    {
-        Log_Error("Could not create %s.", error_file.string().c_str());
-    }
-    error_state << error_code.ResultCode;
-    error_state << error_code.ExtendedResultCode;
-    error_state.close();
-}
-
 static bool GetNextSubstringFromString(std::string& fullstr, const std::string& substr)
 {
     std::string next_substr;
@@ -301,80 +293,35 @@ ADUC_Result FSUpdateHandlerImpl::Download(const tagADUC_WorkflowData* workflowDa
         int updateSize = ADUC_WorkflowData_GetUpdateSize(workflowData);
 
         this->create_work_dir();
-        std::filesystem::path file_path = (work_dir / "update_version");
-        std::ofstream update_version(file_path);
-        if (!update_version.is_open())
+
+        // The work directory starts empty.
+        state = FSUpdate::UpdateState{};
+
+        FSUpdate::UpdateState next;
+        next.updateVersion = installedCriteria != nullptr ? installedCriteria : "";
+        next.updateType = updateType;
+        next.updateSize = updateSize;
+        workflow_free_string(installedCriteria);
+
+        if (!FSUpdate::SaveState(work_dir, state, next))
         {
-            Log_Error("Could not create %s.", file_path.string().c_str());
             result = { .ResultCode = ADUC_Result_Failure,
                    .ExtendedResultCode = ADUC_ERC_FSUPDATE_HANDLER_DOWNLOAD_FAILURE_CREATE_FAILED_UPDATE_VERSION };
             goto done;
         }
-        update_version << installedCriteria;
-        update_version.close();
-
-        std::filesystem::permissions(
-            file_path,
-            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
-                | std::filesystem::perms::group_read | std::filesystem::perms::others_read,
-            std::filesystem::perm_options::replace);
-
-        file_path = work_dir / "update_type";
-        std::ofstream update_type(file_path);
-        if (!update_type.is_open())
-        {
-            Log_Error("Could not create %s.", file_path.string().c_str());
-            result = { .ResultCode = ADUC_Result_Failure,
-                   .ExtendedResultCode = ADUC_ERC_FSUPDATE_HANDLER_DOWNLOAD_FAILURE_CREATE_FAILED_UPDATE_TYPE };
-            goto done;
-        }
-        update_type << updateType;
-        update_type.close();
-        std::filesystem::permissions(
-            file_path,
-            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
-                | std::filesystem::perms::group_read | std::filesystem::perms::others_read,
-            std::filesystem::perm_options::replace);
-
-        file_path = work_dir / "update_size";
-        std::ofstream update_size(file_path);
-        if (!update_size.is_open())
-        {
-            result = { .ResultCode = ADUC_Result_Failure,
-                   .ExtendedResultCode = ADUC_ERC_FSUPDATE_HANDLER_DOWNLOAD_FAILURE_CREATE_FAILED_UPDATE_SIZE };
-            Log_Error("Could not create %s.", file_path.string().c_str());
-            goto done;
-        }
-        update_size << updateSize;
-        update_size.close();
-        std::filesystem::permissions(
-            file_path,
-            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
-                | std::filesystem::perms::group_read | std::filesystem::perms::others_read,
-            std::filesystem::perm_options::replace);
 
         while (std::filesystem::exists(work_dir / "downloadUpdate") == false)
         {
             ThreadAPI_Sleep(100);
         }
 
-        file_path = work_dir / "update_location";
-        std::ofstream update_location(file_path);
-        if (!update_location.is_open())
+        next.updateLocation = updateFilename.str();
+        if (!FSUpdate::SaveState(work_dir, state, next))
         {
             result = { .ResultCode = ADUC_Result_Failure,
                    .ExtendedResultCode = ADUC_ERC_FSUPDATE_HANDLER_DOWNLOAD_FAILURE_CREATE_FAILED_UPDATE_LOCATION };
-            Log_Error("Could not create %s.", file_path.string().c_str());
             goto done;
         }
-
-        update_location << updateFilename.str().c_str();
-        update_location.close();
-        std::filesystem::permissions(
-            file_path,
-            std::filesystem::perms::owner_read | std::filesystem::perms::owner_write
-                | std::filesystem::perms::group_read | std::filesystem::perms::others_read,
-            std::filesystem::perm_options::replace);
     }
 
     //--------------------------------------------------
@@ -406,6 +353,7 @@ ADUC_Result FSUpdateHandlerImpl::Install(const tagADUC_WorkflowData* workflowDat
     ADUC_WorkflowHandle workflowHandle = workflowData->WorkflowHandle;
     char* workFolder = workflow_get_workfolder(workflowHandle);
     update_type_t up_type = UPDATE_UNKNOWN;
+    std::string expandedImage;
     memset(&fileEntity, 0, sizeof(fileEntity));
 
     Log_Info("Installing from %s", workFolder);
@@ -452,6 +400,23 @@ ADUC_Result FSUpdateHandlerImpl::Install(const tagADUC_WorkflowData* workflowDat
 
         std::stringstream data;
         data << workFolder << "/" << fileEntity.TargetFilename;
+
+        // An Android sparse image is expanded into a sparse raw image for fs-updater. The payload itself
+        // stays as downloaded, so that it still matches the manifest hash.
+        if (ADUC_SparseImage_IsSparseImage(data.str().c_str()))
+        {
+            expandedImage = data.str() + ".raw";
+            if (!ADUC_SparseImage_Expand(data.str().c_str(), expandedImage.c_str(), nullptr))
+            {
+                expandedImage.clear();
+                result = { .ResultCode = ADUC_Result_Failure,
+                           .ExtendedResultCode = ADUC_ERC_FSUPDATE_HANDLER_INSTALL_FAILURE_BAD_FILE_ENTITY };
+                goto done;
+            }
+
+            data.str(expandedImage);
+        }
+
         args.emplace_back(data.str().c_str());
 
         std::string update_type_name = type_name;
@@ -507,12 +472,27 @@ ADUC_Result FSUpdateHandlerImpl::Install(const tagADUC_WorkflowData* workflowDat
 
 done:
     workflow_free_string(workFolder);
+    if (!expandedImage.empty())
+    {
+        std::error_code errorCode;
+        std::filesystem::remove(expandedImage, errorCode);
+    }
+
     if(result.ResultCode != ADUC_Result_Install_Success)
     {
         /* remove installUpdate file because installation fails.*/
         std::filesystem::remove( work_dir / "installUpdate");
     }
-    WriteErrorState(work_dir / "errorState", result);
+    {
+        FSUpdate::UpdateState next = state;
+        next.hasResult = true;
+        next.resultCode = result.ResultCode;
+        next.extendedResultCode = result.ExtendedResultCode;
+        if (!FSUpdate::SaveState(work_dir, state, next))
+        {
+            Log_Error("Could not write install result to errorState.");
+        }
+    }
     return result;
 }
 
@@ -0,0 +1,214 @@
+/**
+ * @file fsupdate_state.cpp
+ * @brief Implements the persisted state of the fsupdate handler.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/fsupdate_state.hpp"
+#include "aduc/logging.h"
+
+#include <fstream>
+#include <system_error>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h> // strtoll
+#include <string.h>
+#include <unistd.h>
+
+namespace FSUpdate
+{
+namespace
+{
+// One file per field, as read by the fs-updater tooling.
+const char* UpdateVersionFile = "update_version";
+const char* UpdateTypeFile = "update_type";
+const char* UpdateSizeFile = "update_size";
+const char* UpdateLocationFile = "update_location";
+const char* ErrorStateFile = "errorState";
+
+/**
+ * @brief Writes @p content to @p path, and flushes it to storage.
+ */
+bool WriteFileDurably(const std::filesystem::path& path, const char* content)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        Log_Error("Could not create %s, errno = %d", path.c_str(), errno);
+        return false;
+    }
+
+    bool succeeded = true;
+    size_t remaining = strlen(content);
+    while (remaining > 0)
+    {
+        ssize_t written = write(fd, content, remaining);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Log_Error("Could not write %s, errno = %d", path.c_str(), errno);
+            succeeded = false;
+            break;
+        }
+        content += written;
+        remaining -= static_cast<size_t>(written);
+    }
+
+    if (succeeded && fsync(fd) != 0)
+    {
+        Log_Error("Could not sync %s, errno = %d", path.c_str(), errno);
+        succeeded = false;
+    }
+
+    close(fd);
+    return succeeded;
+}
+
+/**
+ * @brief Flushes the directory entry changes of @p dir to storage.
+ */
+void SyncDirectory(const std::filesystem::path& dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        (void)fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ * @brief Reads the first line of a state file.
+ */
+bool ReadStateFile(const std::filesystem::path& path, std::string& value)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    std::getline(file, value);
+    return true;
+}
+
+/**
+ * @brief Writes @p value to the state file @p name in @p workDir, replacing it atomically.
+ */
+bool WriteStateFile(const std::filesystem::path& workDir, const char* name, const std::string& value)
+{
+    const std::filesystem::path path = workDir / name;
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+
+    if (!WriteFileDurably(tempPath, value.c_str()))
+    {
+        std::error_code ec;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        Log_Error("Could not rename %s, errno = %d", tempPath.c_str(), errno);
+        std::error_code ec;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::permissions(
+        path,
+        std::filesystem::perms::owner_read | std::filesystem::perms::owner_write | std::filesystem::perms::group_read
+            | std::filesystem::perms::others_read,
+        std::filesystem::perm_options::replace,
+        ec);
+    return true;
+}
+
+} // namespace
+
+bool SaveState(const std::filesystem::path& workDir, UpdateState& saved, const UpdateState& state)
+{
+    bool succeeded = true;
+    bool written = false;
+
+    if (!state.updateType.empty())
+    {
+        // The three files are written together the first time, and afterwards only when their value changes.
+        const bool unwritten = saved.updateType.empty();
+
+        if (unwritten || state.updateVersion != saved.updateVersion)
+        {
+            succeeded &= WriteStateFile(workDir, UpdateVersionFile, state.updateVersion);
+            written = true;
+        }
+
+        if (unwritten || state.updateType != saved.updateType)
+        {
+            succeeded &= WriteStateFile(workDir, UpdateTypeFile, state.updateType);
+            written = true;
+        }
+
+        if (unwritten || state.updateSize != saved.updateSize)
+        {
+            succeeded &= WriteStateFile(workDir, UpdateSizeFile, std::to_string(state.updateSize));
+            written = true;
+        }
+    }
+
+    if (!state.updateLocation.empty() && state.updateLocation != saved.updateLocation)
+    {
+        succeeded &= WriteStateFile(workDir, UpdateLocationFile, state.updateLocation);
+        written = true;
+    }
+
+    // errorState holds ResultCode and ExtendedResultCode without a separator, as the tooling expects.
+    if (state.hasResult
+        && (!saved.hasResult || state.resultCode != saved.resultCode
+            || state.extendedResultCode != saved.extendedResultCode))
+    {
+        succeeded &= WriteStateFile(
+            workDir, ErrorStateFile, std::to_string(state.resultCode) + std::to_string(state.extendedResultCode));
+        written = true;
+    }
+
+    if (written)
+    {
+        SyncDirectory(workDir);
+    }
+
+    if (succeeded)
+    {
+        saved = state;
+    }
+
+    return succeeded;
+}
+
+bool LoadState(const std::filesystem::path& workDir, UpdateState& state)
+{
+    bool found = false;
+    std::string size;
+
+    state = UpdateState{};
+
+    found |= ReadStateFile(workDir / UpdateVersionFile, state.updateVersion);
+    found |= ReadStateFile(workDir / UpdateTypeFile, state.updateType);
+    found |= ReadStateFile(workDir / UpdateLocationFile, state.updateLocation);
+
+    if (ReadStateFile(workDir / UpdateSizeFile, size))
+    {
+        found = true;
+        state.updateSize = strtoll(size.c_str(), nullptr, 10);
+    }
+
+    return found;
+}
+
+} // namespace FSUpdate
@@ -0,0 +1,179 @@
+/**
+ * @file fsupdate_state_ut.cpp
+ * @brief Unit Tests for the fsupdate handler state files.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/fsupdate_state.hpp"
+
+#include <catch2/catch.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+class TestWorkDir
+{
+public:
+    TestWorkDir() : path(fs::path(ADUC_TMP_DIR_PATH) / "fsupdate_state_ut")
+    {
+        fs::remove_all(path);
+        fs::create_directories(path);
+    }
+
+    ~TestWorkDir()
+    {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    TestWorkDir(const TestWorkDir&) = delete;
+    TestWorkDir& operator=(const TestWorkDir&) = delete;
+    TestWorkDir(TestWorkDir&&) = delete;
+    TestWorkDir& operator=(TestWorkDir&&) = delete;
+
+    void WriteFile(const char* name, const std::string& content) const
+    {
+        std::ofstream file(path / name);
+        file << content;
+    }
+
+    std::string ReadFile(const char* name) const
+    {
+        std::string content;
+        std::ifstream file(path / name);
+        std::getline(file, content);
+        return content;
+    }
+
+    fs::path path;
+};
+
+TEST_CASE("SaveState writes the state files for the fs-updater tooling")
+{
+    TestWorkDir workDir;
+
+    FSUpdate::UpdateState saved;
+    FSUpdate::UpdateState state;
+    state.updateVersion = "1.2.3";
+    state.updateType = "firmware";
+    state.updateSize = 4096;
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+
+    CHECK(workDir.ReadFile("update_version") == "1.2.3");
+    CHECK(workDir.ReadFile("update_type") == "firmware");
+    CHECK(workDir.ReadFile("update_size") == "4096");
+    CHECK_FALSE(fs::exists(workDir.path / "update_location"));
+    CHECK_FALSE(fs::exists(workDir.path / "errorState"));
+    CHECK(saved.updateVersion == "1.2.3");
+
+    state.updateLocation = "/var/lib/adu/downloads/abc/image.fs";
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+    CHECK(workDir.ReadFile("update_location") == "/var/lib/adu/downloads/abc/image.fs");
+
+    state.hasResult = true;
+    state.resultCode = 600;
+    state.extendedResultCode = 0;
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+    CHECK(workDir.ReadFile("errorState") == "6000");
+    CHECK_FALSE(fs::exists(workDir.path / "errorState.tmp"));
+}
+
+TEST_CASE("SaveState writes only the state files that changed")
+{
+    TestWorkDir workDir;
+
+    FSUpdate::UpdateState saved;
+    FSUpdate::UpdateState state;
+    state.updateVersion = "1.2.3";
+    state.updateType = "firmware";
+    state.updateSize = 4096;
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+
+    // A file that is rewritten reappears.
+    fs::remove(workDir.path / "update_version");
+    fs::remove(workDir.path / "update_size");
+
+    state.updateSize = 8192;
+    state.updateLocation = "/var/lib/adu/downloads/abc/image.fs";
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+
+    CHECK_FALSE(fs::exists(workDir.path / "update_version"));
+    CHECK(workDir.ReadFile("update_size") == "8192");
+    CHECK(workDir.ReadFile("update_location") == "/var/lib/adu/downloads/abc/image.fs");
+
+    fs::remove(workDir.path / "update_location");
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+    CHECK_FALSE(fs::exists(workDir.path / "update_location"));
+}
+
+TEST_CASE("SaveState writes an install result even if it has no error")
+{
+    TestWorkDir workDir;
+
+    FSUpdate::UpdateState saved;
+    FSUpdate::UpdateState state;
+    state.hasResult = true;
+    REQUIRE(FSUpdate::SaveState(workDir.path, saved, state));
+
+    CHECK(workDir.ReadFile("errorState") == "00");
+    CHECK_FALSE(fs::exists(workDir.path / "update_type"));
+}
+
+TEST_CASE("LoadState reads the state files")
+{
+    TestWorkDir workDir;
+    workDir.WriteFile("update_version", "2023.04");
+    workDir.WriteFile("update_type", "application");
+    workDir.WriteFile("update_size", "4096");
+    workDir.WriteFile("update_location", "/var/lib/adu/downloads/xyz/app.fs");
+    workDir.WriteFile("errorState", "00");
+
+    FSUpdate::UpdateState state;
+    REQUIRE(FSUpdate::LoadState(workDir.path, state));
+    CHECK(state.updateVersion == "2023.04");
+    CHECK(state.updateType == "application");
+    CHECK(state.updateSize == 4096);
+    CHECK(state.updateLocation == "/var/lib/adu/downloads/xyz/app.fs");
+    CHECK_FALSE(state.hasResult);
+
+    SECTION("a later install result only writes errorState")
+    {
+        fs::remove(workDir.path / "update_version");
+
+        FSUpdate::UpdateState next = state;
+        next.hasResult = true;
+        next.resultCode = 600;
+        next.extendedResultCode = 0;
+        REQUIRE(FSUpdate::SaveState(workDir.path, state, next));
+
+        CHECK(workDir.ReadFile("errorState") == "6000");
+        CHECK_FALSE(fs::exists(workDir.path / "update_version"));
+    }
+}
+
+TEST_CASE("LoadState reads a partially written work directory")
+{
+    TestWorkDir workDir;
+    workDir.WriteFile("update_version", "2023.04");
+    workDir.WriteFile("update_type", "firmware");
+
+    FSUpdate::UpdateState state;
+    REQUIRE(FSUpdate::LoadState(workDir.path, state));
+    CHECK(state.updateVersion == "2023.04");
+    CHECK(state.updateType == "firmware");
+    CHECK(state.updateSize == 0);
+    CHECK(state.updateLocation.empty());
+}
+
+TEST_CASE("LoadState with an empty work directory")
+{
+    TestWorkDir workDir;
+
+    FSUpdate::UpdateState state;
+    CHECK_FALSE(FSUpdate::LoadState(workDir.path, state));
+    CHECK(state.updateVersion.empty());
+}
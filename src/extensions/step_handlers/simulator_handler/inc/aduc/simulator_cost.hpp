@@ -0,0 +1,84 @@
+/**
+ * @file simulator_cost.hpp
+ * @brief Synthetic cost and fault injection of the simulator handler actions.
+ *
+ * A step may declare the cost of each simulated action in its "simulatorCost" handler property:
+ *
+ *   "handlerProperties": {
+ *       "installedCriteria": "1.0",
+ *       "simulatorCost": {
+ *           "download": { "latencyMs": { "distribution": "uniform", "min": 5, "max": 20 }, "ioKB": 256 },
+ *           "install": { "cpuMs": 10, "failEvery": 100, "failResult": { "extendedResultCode": 1234 } },
+ *           "*": { "latencyMs": 1, "cancelProbability": 0.001 }
+ *       }
+ *   }
+ *
+ * The "*" entry applies to actions without an entry of their own. An action first waits "latencyMs", which is
+ * a fixed number or a "fixed", "uniform" (min, max), "normal" (mean, stddev) or "exponential" (mean)
+ * distribution. It then burns "cpuMs" of CPU time and writes and syncs "ioKB" of data to a scratch file.
+ * Finally it fails on every "failEvery"-th call or with "failProbability", returning "failResult", and is
+ * cancelled on every "cancelEvery"-th call or with "cancelProbability", as if a cancel request arrived.
+ *
+ * Every action records its calls and handler time, so a harness can tell the time spent by the workflow
+ * engine apart from the time spent in the handler.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_SIMULATOR_COST_HPP
+#define ADUC_SIMULATOR_COST_HPP
+
+#include "aduc/result.h"
+#include "aduc/workflow_utils.h"
+
+#include <stdint.h>
+
+/**
+ * @brief What the calls of one simulated action cost.
+ */
+typedef struct tagSimulatorCost_ActionStats
+{
+    uint64_t calls; //!< Calls of the action
+    uint64_t handlerNanoseconds; //!< Wall time spent in the action, including the synthetic cost
+    uint64_t injectedFailures; //!< Calls that returned the injected failure
+    uint64_t injectedCancels; //!< Calls that were cancelled
+} SimulatorCost_ActionStats;
+
+/**
+ * @brief Returns the monotonic clock in nanoseconds, the start time for SimulatorCost_Record
+ */
+uint64_t SimulatorCost_Now();
+
+/**
+ * @brief Spends the cost declared for @p action in the "simulatorCost" handler property of @p handle
+ * @param handle the step workflow, or nullptr for no cost
+ * @param action the action name, e.g. "install"
+ * @param scratchFolder the folder of the scratch file for synthetic I/O
+ * @param[out] injectedResult the failure or cancellation to return instead of the simulated result
+ * @returns true if a failure or cancellation was injected
+ */
+bool SimulatorCost_Spend(
+    ADUC_WorkflowHandle handle, const char* action, const char* scratchFolder, ADUC_Result* injectedResult);
+
+/**
+ * @brief Adds a call of @p action that started at @p startNanoseconds to the stats
+ * @param action the action name
+ * @param startNanoseconds the SimulatorCost_Now() value when the call started
+ */
+void SimulatorCost_Record(const char* action, uint64_t startNanoseconds);
+
+/**
+ * @brief Gets the stats of @p action
+ * @param action the action name, or nullptr for the sum of all actions
+ * @param[out] stats the stats
+ * @returns false if @p action is not a simulated action
+ */
+bool SimulatorCost_GetStats(const char* action, SimulatorCost_ActionStats* stats);
+
+/**
+ * @brief Clears the stats and call counts, and reseeds the random cost and fault injection
+ * @param seed the random seed
+ */
+void SimulatorCost_Reset(unsigned int seed);
+
+#endif // ADUC_SIMULATOR_COST_HPP
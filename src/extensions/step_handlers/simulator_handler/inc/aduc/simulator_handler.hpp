@@ -19,6 +19,14 @@ EXTERN_C_BEGIN
  */
 EXPORTED_METHOD ContentHandler* CreateUpdateContentHandlerExtension(ADUC_LOG_SEVERITY logLevel);
 
+/**
+ * @brief Gets the extension contract info.
+ *
+ * @param[out] contractInfo The extension contract info.
+ * @return ADUC_Result The result.
+ */
+EXPORTED_METHOD ADUC_Result GetContractInfo(ADUC_ExtensionContractInfo* contractInfo);
+
 EXTERN_C_END
 
 /**
@@ -45,6 +53,10 @@ public:
     ADUC_Result Restore(const tagADUC_WorkflowData* workflowData) override;
     ADUC_Result Cancel(const tagADUC_WorkflowData* workflowData) override;
     ADUC_Result IsInstalled(const tagADUC_WorkflowData* workflowData) override;
+    ADUC_Result InstallBatch(
+        const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults) override;
+    ADUC_Result ApplyBatch(
+        const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults) override;
 
 private:
     // Private constructor, must call CreateContentHandler factory method.
@@ -0,0 +1,353 @@
+/**
+ * @file simulator_cost.cpp
+ * @brief Implements the synthetic cost and fault injection of the simulator handler actions.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/simulator_cost.hpp"
+#include "aduc/logging.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h> // open
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string.h> // strcmp
+#include <string>
+#include <sys/stat.h> // S_IRUSR
+#include <thread>
+#include <time.h> // clock_gettime
+#include <unistd.h> // write, fsync, getpid
+#include <vector>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define HANDLER_PROPERTIES_SIMULATOR_COST "simulatorCost"
+
+/**
+ * @brief Size of the writes of the synthetic I/O.
+ */
+#define SIMULATOR_COST_IO_CHUNK_SIZE (64 * 1024)
+
+static const char* const SimulatedActions[] = { "download", "backup", "install",    "apply",
+                                                "restore",  "cancel", "isInstalled" };
+
+static const size_t SimulatedActionsCount = sizeof(SimulatedActions) / sizeof(SimulatedActions[0]);
+
+static std::mutex s_mutex;
+static SimulatorCost_ActionStats s_stats[SimulatedActionsCount];
+static std::mt19937 s_random;
+
+/**
+ * @brief Returns the index of @p action in SimulatedActions, or SimulatedActionsCount if it is unknown.
+ */
+static size_t GetActionIndex(const char* action)
+{
+    size_t index = 0;
+    while (index < SimulatedActionsCount && (action == nullptr || strcmp(SimulatedActions[index], action) != 0))
+    {
+        index++;
+    }
+
+    return index;
+}
+
+/**
+ * @brief Reads a non-negative number field, logging an invalid one.
+ *
+ * @return the number, or 0 if the field is missing or invalid.
+ */
+static double GetNonNegativeNumber(const JSON_Object* obj, const char* name)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return 0;
+    }
+
+    const double number = json_object_get_number(obj, name);
+    if (!json_object_has_value_of_type(obj, name, JSONNumber) || number < 0)
+    {
+        Log_Warn("Ignoring invalid %s.%s, expected a non-negative number.", HANDLER_PROPERTIES_SIMULATOR_COST, name);
+        return 0;
+    }
+
+    return number;
+}
+
+/**
+ * @brief Draws the latency of a call from the "latencyMs" number or distribution of @p spec.
+ */
+static double DrawLatencyMs(const JSON_Object* spec)
+{
+    const JSON_Object* distribution = json_object_get_object(spec, "latencyMs");
+    if (distribution == nullptr)
+    {
+        return GetNonNegativeNumber(spec, "latencyMs");
+    }
+
+    const char* type = json_object_get_string(distribution, "distribution");
+    double latencyMs = 0;
+
+    if (type == nullptr || strcmp(type, "fixed") == 0)
+    {
+        latencyMs = GetNonNegativeNumber(distribution, "mean");
+    }
+    else if (strcmp(type, "uniform") == 0)
+    {
+        const double min = GetNonNegativeNumber(distribution, "min");
+        const double max = GetNonNegativeNumber(distribution, "max");
+        latencyMs = max > min ? std::uniform_real_distribution<double>{ min, max }(s_random) : min;
+    }
+    else if (strcmp(type, "normal") == 0)
+    {
+        const double mean = GetNonNegativeNumber(distribution, "mean");
+        const double stddev = GetNonNegativeNumber(distribution, "stddev");
+        latencyMs = stddev > 0 ? std::normal_distribution<double>{ mean, stddev }(s_random) : mean;
+    }
+    else if (strcmp(type, "exponential") == 0)
+    {
+        const double mean = GetNonNegativeNumber(distribution, "mean");
+        latencyMs = mean > 0 ? std::exponential_distribution<double>{ 1 / mean }(s_random) : 0;
+    }
+    else
+    {
+        Log_Warn("Ignoring unknown latency distribution '%s'.", type);
+    }
+
+    return latencyMs > 0 ? latencyMs : 0;
+}
+
+/**
+ * @brief Returns whether the @p call of an action is selected by the "<name>Every" and "<name>Probability"
+ * fields of @p spec.
+ */
+static bool IsInjected(const JSON_Object* spec, const char* name, uint64_t call)
+{
+    const std::string every = std::string{ name } + "Every";
+    const std::string probability = std::string{ name } + "Probability";
+
+    const auto period = static_cast<uint64_t>(GetNonNegativeNumber(spec, every.c_str()));
+    if (period != 0 && call != 0 && call % period == 0)
+    {
+        return true;
+    }
+
+    const double p = GetNonNegativeNumber(spec, probability.c_str());
+    return p > 0 && std::uniform_real_distribution<double>{ 0, 1 }(s_random) < p;
+}
+
+/**
+ * @brief Burns @p cpuMs of CPU time of the calling thread.
+ */
+static void BurnCpu(double cpuMs)
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    const double end = now.tv_sec * 1e3 + now.tv_nsec / 1e6 + cpuMs;
+
+    volatile uint64_t sink = 0;
+    do
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            sink = sink * 6364136223846793005ULL + 1442695040888963407ULL;
+        }
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    } while (now.tv_sec * 1e3 + now.tv_nsec / 1e6 < end);
+}
+
+/**
+ * @brief Writes and syncs @p ioKB KiB to a scratch file in @p scratchFolder, then removes it.
+ */
+static void WriteScratchFile(const char* scratchFolder, uint64_t ioKB)
+{
+    static const std::vector<char> chunk(SIMULATOR_COST_IO_CHUNK_SIZE, 'S');
+
+    std::stringstream path;
+    path << scratchFolder << "/du-simulator-io." << getpid() << "." << std::this_thread::get_id();
+
+    const int fd = open(path.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1)
+    {
+        Log_Warn("Cannot create scratch file %s, errno: %d", path.str().c_str(), errno);
+        return;
+    }
+
+    for (uint64_t remaining = ioKB * 1024; remaining > 0;)
+    {
+        const size_t size = remaining < chunk.size() ? static_cast<size_t>(remaining) : chunk.size();
+        const ssize_t written = write(fd, chunk.data(), size);
+        if (written <= 0)
+        {
+            Log_Warn("Cannot write scratch file %s, errno: %d", path.str().c_str(), errno);
+            break;
+        }
+
+        remaining -= static_cast<uint64_t>(written);
+    }
+
+    fsync(fd);
+    close(fd);
+    unlink(path.str().c_str());
+}
+
+uint64_t SimulatorCost_Now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+bool SimulatorCost_Spend(
+    ADUC_WorkflowHandle handle, const char* action, const char* scratchFolder, ADUC_Result* injectedResult)
+{
+    const size_t index = GetActionIndex(action);
+    const JSON_Object* spec = nullptr;
+    uint64_t call = 0;
+    double latencyMs = 0;
+    bool failed = false;
+    bool cancelled = false;
+
+    if (handle != nullptr)
+    {
+        const JSON_Object* costs =
+            workflow_peek_update_manifest_handler_properties_object(handle, HANDLER_PROPERTIES_SIMULATOR_COST);
+        spec = json_object_get_object(costs, action);
+        if (spec == nullptr)
+        {
+            spec = json_object_get_object(costs, "*");
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ s_mutex };
+        if (index < SimulatedActionsCount)
+        {
+            call = ++s_stats[index].calls;
+        }
+
+        if (spec != nullptr)
+        {
+            latencyMs = DrawLatencyMs(spec);
+            failed = IsInjected(spec, "fail", call);
+            cancelled = !failed && IsInjected(spec, "cancel", call);
+        }
+    }
+
+    if (spec == nullptr)
+    {
+        return false;
+    }
+
+    if (latencyMs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>{ latencyMs });
+    }
+
+    const double cpuMs = GetNonNegativeNumber(spec, "cpuMs");
+    if (cpuMs > 0)
+    {
+        BurnCpu(cpuMs);
+    }
+
+    const auto ioKB = static_cast<uint64_t>(GetNonNegativeNumber(spec, "ioKB"));
+    if (ioKB > 0 && scratchFolder != nullptr)
+    {
+        WriteScratchFile(scratchFolder, ioKB);
+    }
+
+    if (failed)
+    {
+        const JSON_Object* failResult = json_object_get_object(spec, "failResult");
+        injectedResult->ResultCode = json_object_has_value_of_type(failResult, "resultCode", JSONNumber)
+            ? static_cast<ADUC_Result_t>(json_object_get_number(failResult, "resultCode"))
+            : ADUC_Result_Failure;
+        injectedResult->ExtendedResultCode =
+            static_cast<ADUC_Result_t>(json_object_get_number(failResult, "extendedResultCode"));
+
+        const char* details = json_object_get_string(failResult, "resultDetails");
+        if (details != nullptr)
+        {
+            workflow_set_result_details(handle, "%s", details);
+        }
+        else
+        {
+            workflow_set_result_details(
+                handle, "Simulated %s failure (call #%llu)", action, static_cast<unsigned long long>(call));
+        }
+
+        Log_Info("Injecting %s failure on call #%llu", action, static_cast<unsigned long long>(call));
+    }
+    else if (cancelled)
+    {
+        workflow_request_cancel(workflow_get_root(handle));
+        injectedResult->ResultCode = ADUC_Result_Failure_Cancelled;
+        injectedResult->ExtendedResultCode = 0;
+        Log_Info("Injecting cancellation of %s on call #%llu", action, static_cast<unsigned long long>(call));
+    }
+
+    if (index < SimulatedActionsCount && (failed || cancelled))
+    {
+        std::lock_guard<std::mutex> lock{ s_mutex };
+        s_stats[index].injectedFailures += failed ? 1 : 0;
+        s_stats[index].injectedCancels += cancelled ? 1 : 0;
+    }
+
+    return failed || cancelled;
+}
+
+void SimulatorCost_Record(const char* action, uint64_t startNanoseconds)
+{
+    const size_t index = GetActionIndex(action);
+    const uint64_t elapsed = SimulatorCost_Now() - startNanoseconds;
+
+    if (index < SimulatedActionsCount)
+    {
+        std::lock_guard<std::mutex> lock{ s_mutex };
+        s_stats[index].handlerNanoseconds += elapsed;
+    }
+}
+
+bool SimulatorCost_GetStats(const char* action, SimulatorCost_ActionStats* stats)
+{
+    std::lock_guard<std::mutex> lock{ s_mutex };
+
+    if (action != nullptr)
+    {
+        const size_t index = GetActionIndex(action);
+        if (index == SimulatedActionsCount)
+        {
+            return false;
+        }
+
+        *stats = s_stats[index];
+        return true;
+    }
+
+    *stats = {};
+    for (const SimulatorCost_ActionStats& actionStats : s_stats)
+    {
+        stats->calls += actionStats.calls;
+        stats->handlerNanoseconds += actionStats.handlerNanoseconds;
+        stats->injectedFailures += actionStats.injectedFailures;
+        stats->injectedCancels += actionStats.injectedCancels;
+    }
+
+    return true;
+}
+
+void SimulatorCost_Reset(unsigned int seed)
+{
+    std::lock_guard<std::mutex> lock{ s_mutex };
+
+    for (SimulatorCost_ActionStats& actionStats : s_stats)
+    {
+        actionStats = {};
+    }
+
+    s_random.seed(seed);
+}
@@ -8,6 +8,7 @@
 
 #include "aduc/simulator_handler.hpp"
 #include "aduc/logging.h"
+#include "aduc/simulator_cost.hpp"
 #include "aduc/parser_utils.h" // ADUC_FileEntity_Uninit
 #include "aduc/workflow_utils.h"
 #include <stdarg.h> // for va_*
@@ -62,8 +63,9 @@ EXPORTED_METHOD ContentHandler* CreateUpdateContentHandlerExtension(ADUC_LOG_SEV
  */
 EXPORTED_METHOD ADUC_Result GetContractInfo(ADUC_ExtensionContractInfo* contractInfo)
 {
+    // The simulator supports step batches.
     contractInfo->majorVer = ADUC_V1_CONTRACT_MAJOR_VER;
-    contractInfo->minorVer = ADUC_V1_CONTRACT_MINOR_VER;
+    contractInfo->minorVer = ADUC_V1_1_CONTRACT_MINOR_VER;
     return ADUC_Result{ ADUC_GeneralResult_Success, 0 };
 }
 
@@ -217,6 +219,7 @@ done:
  */
 ADUC_Result SimulatorHandlerImpl::Download(const tagADUC_WorkflowData* workflowData)
 {
+    const uint64_t start = SimulatorCost_Now();
     ADUC_Result result;
     result.ResultCode = ADUC_Result_Download_Success;
     result.ExtendedResultCode = 0;
@@ -227,8 +230,15 @@ ADUC_Result SimulatorHandlerImpl::Download(const tagADUC_WorkflowData* workflowD
     auto fileCount = static_cast<unsigned int>(workflow_get_update_files_count(handle));
 
     JSON_Object* downloadResult = nullptr;
+    JSON_Object* data = nullptr;
 
-    JSON_Object* data = ReadDataFile();
+    // Spend the synthetic cost declared in the step's handler properties, if any.
+    if (SimulatorCost_Spend(handle, "download", _GetTemporaryPathName(), &result))
+    {
+        goto done;
+    }
+
+    data = ReadDataFile();
     if (data == nullptr)
     {
         Log_Info("No simulator data file provided, returning default result code...");
@@ -289,10 +299,15 @@ done:
         json_value_free(json_object_get_wrapping_value(data));
     }
 
+    SimulatorCost_Record("download", start);
     return result;
 }
 
-ADUC_Result SimulatorActionHelper(
+/**
+ * @brief Gets the simulated result of @p action from the simulator data file.
+ * @return ADUC_Result The result from the data file if specified. Otherwise, @p defaultResultCode.
+ */
+static ADUC_Result SimulatorDataResult(
     const tagADUC_WorkflowData* workflowData,
     ADUC_Result_t defaultResultCode,
     const char* action,
@@ -304,8 +319,9 @@ ADUC_Result SimulatorActionHelper(
     ADUC_WorkflowHandle handle = workflowData->WorkflowHandle;
 
     JSON_Object* resultObject = nullptr;
+    JSON_Object* data = nullptr;
 
-    JSON_Object* data = ReadDataFile();
+    data = ReadDataFile();
     if (data == nullptr)
     {
         Log_Info("No simulator data file provided, returning default result code...");
@@ -348,16 +364,87 @@ ADUC_Result SimulatorActionHelper(
         }
     }
 
-    if (IsAducResultCodeFailure(result.ResultCode))
+done:
+    if (data != nullptr)
+    {
+        json_value_free(json_object_get_wrapping_value(data));
+    }
+
+    return result;
+}
+
+ADUC_Result SimulatorActionHelper(
+    const tagADUC_WorkflowData* workflowData,
+    ADUC_Result_t defaultResultCode,
+    const char* action,
+    const char* resultSelector)
+{
+    const uint64_t start = SimulatorCost_Now();
+    ADUC_Result result;
+    result.ResultCode = defaultResultCode;
+    result.ExtendedResultCode = 0;
+
+    // Spend the synthetic cost declared in the step's handler properties, if any.
+    if (!SimulatorCost_Spend(workflowData->WorkflowHandle, action, _GetTemporaryPathName(), &result))
+    {
+        result = SimulatorDataResult(workflowData, defaultResultCode, action, resultSelector);
+    }
+
+    SimulatorCost_Record(action, start);
+    return result;
+}
+
+/**
+ * @brief Simulates @p action of a batch of steps as one transaction. The cost declared by the first step is spent
+ * once for the batch, and the result of each step is read from the simulator data file. A failed step fails the
+ * steps after it.
+ * @return ADUC_Result The result of the batch, a failure if any step failed.
+ */
+static ADUC_Result SimulatorBatchHelper(
+    const tagADUC_WorkflowData* const* stepWorkflows,
+    size_t stepCount,
+    ADUC_Result* stepResults,
+    ADUC_Result_t defaultResultCode,
+    const char* action)
+{
+    const uint64_t start = SimulatorCost_Now();
+    ADUC_Result result;
+    result.ResultCode = defaultResultCode;
+    result.ExtendedResultCode = 0;
+
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        stepResults[i] = { ADUC_Result_Failure, 0 };
+    }
+
+    if (stepCount == 0)
     {
         goto done;
     }
 
-done:
-    if (data != nullptr)
+    if (SimulatorCost_Spend(stepWorkflows[0]->WorkflowHandle, action, _GetTemporaryPathName(), &result))
     {
-        json_value_free(json_object_get_wrapping_value(data));
+        for (size_t i = 0; i < stepCount; i++)
+        {
+            stepResults[i] = result;
+        }
+
+        goto done;
+    }
+
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        stepResults[i] = SimulatorDataResult(stepWorkflows[i], defaultResultCode, action, nullptr);
+
+        if (IsAducResultCodeFailure(stepResults[i].ResultCode))
+        {
+            result = stepResults[i];
+            goto done;
+        }
     }
+
+done:
+    SimulatorCost_Record(action, start);
     return result;
 }
 
@@ -381,6 +468,28 @@ ADUC_Result SimulatorHandlerImpl::Install(const tagADUC_WorkflowData* workflowDa
     return SimulatorActionHelper(workflowData, ADUC_Result_Install_Success, "install", nullptr);
 }
 
+/**
+ * @brief Mock implementation of a batch install, as one transaction.
+ * @return ADUC_Result Return result from simulator data file if specified.
+ *         Otherwise, return ADUC_Result_Install_Success.
+ */
+ADUC_Result SimulatorHandlerImpl::InstallBatch(
+    const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults)
+{
+    return SimulatorBatchHelper(stepWorkflows, stepCount, stepResults, ADUC_Result_Install_Success, "install");
+}
+
+/**
+ * @brief Mock implementation of a batch apply, as one transaction.
+ * @return ADUC_Result Return result from simulator data file if specified.
+ *         Otherwise, return ADUC_Result_Apply_Success.
+ */
+ADUC_Result SimulatorHandlerImpl::ApplyBatch(
+    const tagADUC_WorkflowData* const* stepWorkflows, size_t stepCount, ADUC_Result* stepResults)
+{
+    return SimulatorBatchHelper(stepWorkflows, stepCount, stepResults, ADUC_Result_Apply_Success, "apply");
+}
+
 /**
  * @brief Mock implementation of restore
  * @return ADUC_Result Return result from simulator data file if specified.
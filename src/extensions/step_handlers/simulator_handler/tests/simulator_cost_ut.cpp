@@ -0,0 +1,452 @@
+/**
+ * @file simulator_cost_ut.cpp
+ * @brief Unit Tests for the synthetic cost of the Simulator Update Handler, and the steps handler benchmark.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+
+#include "aduc/extension_manager.hpp"
+#include "aduc/simulator_cost.hpp"
+#include "aduc/simulator_handler.hpp"
+#include "aduc/steps_handler.hpp"
+#include "aduc/workflow_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+using Catch::Matchers::Equals;
+
+#include <fstream>
+#include <memory>
+#include <parson.h>
+#include <stdlib.h> // getenv
+#include <string>
+#include <vector>
+
+ADUC_Result PrepareStepsWorkflowDataObject(ADUC_WorkflowHandle handle);
+
+#define SIMULATOR_UPDATE_TYPE "microsoft/simulator:1"
+#define TEST_DIR "/tmp/adutest/simulator_cost_ut"
+
+/**
+ * @brief Creates the update action of a workflow with @p stepCount inline simulator steps.
+ *
+ * @param stepCount the number of steps.
+ * @param cost the "simulatorCost" handler property of every step.
+ * @return the update action json.
+ */
+static std::string CreateSimulatorWorkflow(size_t stepCount, const char* cost)
+{
+    JSON_Value* manifestValue = json_parse_string(
+        R"({"manifestVersion":"4","updateId":{"provider":"Contoso","name":"Simulator","version":"1.0"},)"
+        R"("compatibility":[{"deviceManufacturer":"contoso","deviceModel":"simulator"}],)"
+        R"("instructions":{"steps":[]},"files":{},"createdDateTime":"2026-10-18T00:00:00Z"})");
+    REQUIRE(manifestValue != nullptr);
+    JSON_Array* steps = json_object_dotget_array(json_value_get_object(manifestValue), "instructions.steps");
+
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        JSON_Value* stepValue = json_parse_string(
+            R"({"handler":")" SIMULATOR_UPDATE_TYPE R"(","files":[],"handlerProperties":{"installedCriteria":"1.0"}})");
+        JSON_Value* costValue = json_parse_string(cost);
+        REQUIRE(costValue != nullptr);
+        json_object_dotset_value(json_value_get_object(stepValue), "handlerProperties.simulatorCost", costValue);
+        json_array_append_value(steps, stepValue);
+    }
+
+    char* manifest = json_serialize_to_string(manifestValue);
+
+    JSON_Value* updateActionValue =
+        json_parse_string(R"({"workflow":{"action":3,"id":"4b9e8f6c-5a0d-4d8e-9f3a-2c7d1e6b0a51"}})");
+    json_object_set_string(json_value_get_object(updateActionValue), "updateManifest", manifest);
+    char* updateAction = json_serialize_to_string(updateActionValue);
+    std::string updateActionJson{ updateAction };
+
+    json_free_serialized_string(updateAction);
+    json_free_serialized_string(manifest);
+    json_value_free(updateActionValue);
+    json_value_free(manifestValue);
+
+    return updateActionJson;
+}
+
+/**
+ * @brief A workflow of one inline simulator step, and the simulator handler.
+ */
+class SimulatorStep
+{
+public:
+    explicit SimulatorStep(const char* cost) : _handler{ CreateUpdateContentHandlerExtension(ADUC_LOG_DEBUG) }
+    {
+        SimulatorCost_Reset(0);
+
+        ADUC_Result result = workflow_init(CreateSimulatorWorkflow(1, cost).c_str(), false, &handle);
+        REQUIRE(result.ResultCode != 0);
+        result = PrepareStepsWorkflowDataObject(handle);
+        REQUIRE(result.ResultCode != 0);
+
+        stepWorkflow.WorkflowHandle = workflow_get_child(handle, 0);
+        REQUIRE(stepWorkflow.WorkflowHandle != nullptr);
+    }
+
+    ~SimulatorStep()
+    {
+        workflow_free(handle);
+    }
+
+    SimulatorStep(const SimulatorStep&) = delete;
+    SimulatorStep& operator=(const SimulatorStep&) = delete;
+    SimulatorStep(SimulatorStep&&) = delete;
+    SimulatorStep& operator=(SimulatorStep&&) = delete;
+
+    ContentHandler* operator->()
+    {
+        return _handler.get();
+    }
+
+    ADUC_WorkflowHandle handle = nullptr;
+    ADUC_WorkflowData stepWorkflow{};
+
+private:
+    std::unique_ptr<ContentHandler> _handler;
+};
+
+static SimulatorCost_ActionStats GetStats(const char* action)
+{
+    SimulatorCost_ActionStats stats{};
+    REQUIRE(SimulatorCost_GetStats(action, &stats));
+    return stats;
+}
+
+TEST_CASE("SimulatorCost - no cost")
+{
+    SimulatorStep step{ "{}" };
+
+    ADUC_Result result = step->Install(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Install_Success);
+
+    CHECK(GetStats("install").calls == 1);
+    CHECK(GetStats("apply").calls == 0);
+    CHECK(GetStats(nullptr).calls == 1);
+
+    SimulatorCost_ActionStats stats{};
+    CHECK_FALSE(SimulatorCost_GetStats("unknown", &stats));
+}
+
+TEST_CASE("SimulatorCost - latency")
+{
+    SimulatorStep step{
+        R"({"install":{"latencyMs":20},"*":{"latencyMs":{"distribution":"uniform","min":2,"max":4}}})"
+    };
+
+    const uint64_t start = SimulatorCost_Now();
+    ADUC_Result result = step->Install(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Install_Success);
+    CHECK(SimulatorCost_Now() - start >= 20000000);
+    CHECK(GetStats("install").handlerNanoseconds >= 20000000);
+
+    for (int i = 0; i < 5; i++)
+    {
+        result = step->Apply(&step.stepWorkflow);
+        CHECK(result.ResultCode == ADUC_Result_Apply_Success);
+    }
+
+    CHECK(GetStats("apply").calls == 5);
+    CHECK(GetStats("apply").handlerNanoseconds >= 10000000);
+}
+
+TEST_CASE("SimulatorCost - CPU and I/O")
+{
+    SimulatorStep step{ R"({"backup":{"cpuMs":10,"ioKB":256}})" };
+
+    ADUC_Result result = step->Backup(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Backup_Success);
+    CHECK(GetStats("backup").handlerNanoseconds >= 10000000);
+}
+
+TEST_CASE("SimulatorCost - failure injection")
+{
+    SimulatorStep step{
+        R"({"*":{"failEvery":2,"failResult":{"extendedResultCode":1234,"resultDetails":"Injected failure"}}})"
+    };
+
+    ADUC_Result result = step->Apply(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Apply_Success);
+
+    result = step->Apply(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Failure);
+    CHECK(result.ExtendedResultCode == 1234);
+    CHECK_THAT(workflow_peek_result_details(step.stepWorkflow.WorkflowHandle), Equals("Injected failure"));
+
+    result = step->Apply(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Apply_Success);
+
+    CHECK(GetStats("apply").calls == 3);
+    CHECK(GetStats("apply").injectedFailures == 1);
+    CHECK(GetStats("apply").injectedCancels == 0);
+}
+
+TEST_CASE("SimulatorCost - cancel injection")
+{
+    SimulatorStep step{ R"({"download":{"cancelProbability":1}})" };
+
+    ADUC_Result result = step->Download(&step.stepWorkflow);
+    CHECK(result.ResultCode == ADUC_Result_Failure_Cancelled);
+    CHECK(workflow_is_cancel_requested(step.handle));
+    CHECK(workflow_is_cancel_requested(step.stepWorkflow.WorkflowHandle));
+    CHECK(GetStats("download").injectedCancels == 1);
+}
+
+/**
+ * @brief A workflow of several inline simulator steps, and the simulator handler.
+ */
+class SimulatorSteps
+{
+public:
+    SimulatorSteps(size_t stepCount, const char* cost) :
+        stepWorkflows(stepCount), _handler{ CreateUpdateContentHandlerExtension(ADUC_LOG_DEBUG) }
+    {
+        SimulatorCost_Reset(0);
+
+        ADUC_Result result = workflow_init(CreateSimulatorWorkflow(stepCount, cost).c_str(), false, &handle);
+        REQUIRE(result.ResultCode != 0);
+        result = PrepareStepsWorkflowDataObject(handle);
+        REQUIRE(result.ResultCode != 0);
+
+        for (size_t i = 0; i < stepCount; i++)
+        {
+            stepWorkflows[i].WorkflowHandle = workflow_get_child(handle, i);
+            REQUIRE(stepWorkflows[i].WorkflowHandle != nullptr);
+            batch.push_back(&stepWorkflows[i]);
+        }
+
+        stepResults.resize(stepCount);
+    }
+
+    ~SimulatorSteps()
+    {
+        workflow_free(handle);
+    }
+
+    SimulatorSteps(const SimulatorSteps&) = delete;
+    SimulatorSteps& operator=(const SimulatorSteps&) = delete;
+    SimulatorSteps(SimulatorSteps&&) = delete;
+    SimulatorSteps& operator=(SimulatorSteps&&) = delete;
+
+    ContentHandler* operator->()
+    {
+        return _handler.get();
+    }
+
+    ADUC_WorkflowHandle handle = nullptr;
+    std::vector<ADUC_WorkflowData> stepWorkflows;
+    std::vector<const ADUC_WorkflowData*> batch;
+    std::vector<ADUC_Result> stepResults;
+
+private:
+    std::unique_ptr<ContentHandler> _handler;
+};
+
+TEST_CASE("SimulatorCost - step batch")
+{
+    SECTION("The simulator supports step batches")
+    {
+        ADUC_ExtensionContractInfo contractInfo{};
+        ADUC_Result result = GetContractInfo(&contractInfo);
+        CHECK(IsAducResultCodeSuccess(result.ResultCode));
+        CHECK(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+    }
+
+    SECTION("A batch is one transaction with a result for each step")
+    {
+        SimulatorSteps steps{ 5, R"({"install":{"latencyMs":20},"apply":{"latencyMs":20}})" };
+
+        ADUC_Result result = steps->InstallBatch(steps.batch.data(), steps.batch.size(), steps.stepResults.data());
+        CHECK(result.ResultCode == ADUC_Result_Install_Success);
+        for (const ADUC_Result& stepResult : steps.stepResults)
+        {
+            CHECK(stepResult.ResultCode == ADUC_Result_Install_Success);
+        }
+
+        result = steps->ApplyBatch(steps.batch.data(), steps.batch.size(), steps.stepResults.data());
+        CHECK(result.ResultCode == ADUC_Result_Apply_Success);
+        for (const ADUC_Result& stepResult : steps.stepResults)
+        {
+            CHECK(stepResult.ResultCode == ADUC_Result_Apply_Success);
+        }
+
+        // The cost of the transaction is spent once, not once per step.
+        CHECK(GetStats("install").calls == 1);
+        CHECK(GetStats("install").handlerNanoseconds >= 20000000);
+        CHECK(GetStats("apply").calls == 1);
+    }
+
+    SECTION("An injected failure fails every step of the batch")
+    {
+        SimulatorSteps steps{ 3, R"({"install":{"failEvery":1,"failResult":{"extendedResultCode":1234}}})" };
+
+        ADUC_Result result = steps->InstallBatch(steps.batch.data(), steps.batch.size(), steps.stepResults.data());
+        CHECK(result.ResultCode == ADUC_Result_Failure);
+        CHECK(result.ExtendedResultCode == 1234);
+        for (const ADUC_Result& stepResult : steps.stepResults)
+        {
+            CHECK(stepResult.ResultCode == ADUC_Result_Failure);
+            CHECK(stepResult.ExtendedResultCode == 1234);
+        }
+
+        CHECK(GetStats("install").injectedFailures == 1);
+    }
+
+    SECTION("A failed step fails the steps after it")
+    {
+        char* dataFilePath = GetSimulatorDataFilePath();
+        std::ofstream{ dataFilePath, std::ios::trunc }
+            << R"({"apply":{"resultCode":0,"extendedResultCode":44444,"resultDetails":"Failed apply"}})";
+
+        SimulatorSteps steps{ 3, "{}" };
+
+        ADUC_Result result = steps->ApplyBatch(steps.batch.data(), steps.batch.size(), steps.stepResults.data());
+        CHECK(result.ResultCode == ADUC_Result_Failure);
+        CHECK(result.ExtendedResultCode == 44444);
+        CHECK(steps.stepResults[0].ExtendedResultCode == 44444);
+        CHECK_THAT(workflow_peek_result_details(steps.stepWorkflows[0].WorkflowHandle), Equals("Failed apply"));
+        CHECK(steps.stepResults[1].ResultCode == ADUC_Result_Failure);
+        CHECK(steps.stepResults[1].ExtendedResultCode == 0);
+        CHECK(steps.stepResults[2].ResultCode == ADUC_Result_Failure);
+
+        remove(dataFilePath);
+        free(dataFilePath); // NOLINT(cppcoreguidelines-owning-memory)
+    }
+}
+
+/**
+ * @brief Runs simulator steps through the steps handler's download and install phases.
+ *
+ * The steps handler creates its work folder as the adu user, so the user and group must exist.
+ */
+class StepsHandlerRun
+{
+public:
+    StepsHandlerRun(size_t stepCount, const char* cost) : _workFolder(TEST_DIR)
+    {
+        // Steps that are not installed yet, so that every step is downloaded, backed up, installed and applied.
+        _dataFilePath = GetSimulatorDataFilePath();
+        std::ofstream{ _dataFilePath, std::ios::trunc } << R"({"isInstalled":{"*":{"resultCode":901}}})";
+
+        REQUIRE(_workFolder.RemoveDir());
+        REQUIRE(_workFolder.CreateDir());
+
+        // Handlers set by the test are not loaded by the extension manager, which sets the contract info.
+        ContentHandler* simulatorHandler = CreateUpdateContentHandlerExtension(ADUC_LOG_INFO);
+        REQUIRE(simulatorHandler != nullptr);
+        ADUC_ExtensionContractInfo contractInfo{};
+        GetContractInfo(&contractInfo);
+        simulatorHandler->SetContractInfo(contractInfo);
+        ExtensionManager::SetUpdateContentHandlerExtension(SIMULATOR_UPDATE_TYPE, simulatorHandler);
+        _stepsHandler.reset(StepsHandlerImpl::CreateContentHandler());
+
+        ADUC_Result result = workflow_init(CreateSimulatorWorkflow(stepCount, cost).c_str(), false, &handle);
+        REQUIRE(result.ResultCode != 0);
+        workflow_set_workfolder(handle, "%s", _workFolder.GetDir().c_str());
+    }
+
+    ~StepsHandlerRun()
+    {
+        workflow_free(handle);
+        ExtensionManager::Uninit();
+        remove(_dataFilePath);
+        free(_dataFilePath); // NOLINT(cppcoreguidelines-owning-memory)
+    }
+
+    StepsHandlerRun(const StepsHandlerRun&) = delete;
+    StepsHandlerRun& operator=(const StepsHandlerRun&) = delete;
+    StepsHandlerRun(StepsHandlerRun&&) = delete;
+    StepsHandlerRun& operator=(StepsHandlerRun&&) = delete;
+
+    /**
+     * @brief Runs the download and install phases, after resetting the simulator stats.
+     */
+    void Run()
+    {
+        ADUC_WorkflowData workflowData{};
+        workflowData.WorkflowHandle = handle;
+        SimulatorCost_Reset(0);
+
+        downloadResult = _stepsHandler->Download(&workflowData);
+        installResult = _stepsHandler->Install(&workflowData);
+    }
+
+    ADUC_WorkflowHandle handle = nullptr;
+    ADUC_Result downloadResult{};
+    ADUC_Result installResult{};
+
+private:
+    char* _dataFilePath = nullptr;
+    aduc::AutoDir _workFolder; // auto rmdir on scope exit
+    std::unique_ptr<ContentHandler> _stepsHandler;
+};
+
+/**
+ * @brief Runs consecutive simulator steps through the steps handler, which installs them as one batch.
+ *
+ * Hidden, since it needs the adu user, run it with: simulator_handler_unit_tests "[steps_handler]"
+ */
+TEST_CASE("SimulatorCost - steps handler batches consecutive steps", "[.][steps_handler]")
+{
+    StepsHandlerRun run{ 5, "{}" };
+
+    run.Run();
+
+    CHECK(run.downloadResult.ResultCode == ADUC_Result_Download_Success);
+    CHECK(run.installResult.ResultCode == ADUC_Result_Install_Success);
+
+    // Every step is checked and backed up on its own, but installed and applied in one batch.
+    CHECK(GetStats("isInstalled").calls == 10);
+    CHECK(GetStats("backup").calls == 5);
+    CHECK(GetStats("install").calls == 1);
+    CHECK(GetStats("apply").calls == 1);
+
+    for (size_t i = 0; i < 5; i++)
+    {
+        CHECK(workflow_get_result(workflow_get_child(run.handle, i)).ResultCode == ADUC_Result_Apply_Success);
+    }
+}
+
+/**
+ * @brief Runs many simulator steps through the steps handler and reports the engine overhead per step.
+ *
+ * Hidden, run it with: simulator_handler_unit_tests "[benchmark]"
+ * DU_SIMULATOR_BENCHMARK_STEPS sets the number of steps (default 1000), and DU_SIMULATOR_BENCHMARK_COST the
+ * "simulatorCost" of every step (default none). The steps handler creates its work folder as the adu user,
+ * so the user and group must exist. Consecutive simulator steps are installed as one batch.
+ */
+TEST_CASE("SimulatorCost - steps handler benchmark", "[.][benchmark]")
+{
+    const char* stepsEnv = getenv("DU_SIMULATOR_BENCHMARK_STEPS");
+    const char* costEnv = getenv("DU_SIMULATOR_BENCHMARK_COST");
+    const size_t stepCount = stepsEnv != nullptr ? std::stoul(stepsEnv) : 1000;
+    const char* cost = costEnv != nullptr ? costEnv : "{}";
+
+    StepsHandlerRun run{ stepCount, cost };
+
+    const uint64_t start = SimulatorCost_Now();
+    run.Run();
+    const uint64_t elapsed = SimulatorCost_Now() - start;
+
+    SimulatorCost_ActionStats stats{};
+    REQUIRE(SimulatorCost_GetStats(nullptr, &stats));
+
+    const double stepsMs = static_cast<double>(elapsed) / 1e6;
+    const double handlerMs = static_cast<double>(stats.handlerNanoseconds) / 1e6;
+    WARN(
+        "Steps: " << stepCount << ", handler calls: " << stats.calls << ", total: " << stepsMs
+                  << " ms, handler: " << handlerMs << " ms, engine overhead per step: "
+                  << (stepsMs - handlerMs) * 1000 / stepCount << " us, injected failures: " << stats.injectedFailures
+                  << ", injected cancels: " << stats.injectedCancels);
+
+    if (stats.injectedFailures == 0 && stats.injectedCancels == 0)
+    {
+        CHECK(IsAducResultCodeSuccess(run.downloadResult.ResultCode));
+        CHECK(IsAducResultCodeSuccess(run.installResult.ResultCode));
+    }
+}
@@ -23,6 +23,7 @@
 #include <parson.h>
 #include <sstream>
 #include <string>
+#include <vector>
 
 // keep this last to avoid interfering with system headers
 #include "aduc/aduc_banned.h"
@@ -619,7 +620,8 @@ static ADUC_Result StepsHandler_Download(const tagADUC_WorkflowData* workflowDat
             }
 
             ADUC_ExtensionContractInfo contractInfo = contentHandler->GetContractInfo();
-            if (ADUC_ContractUtils_IsV1Contract(&contractInfo))
+            if (ADUC_ContractUtils_IsV1Contract(&contractInfo)
+                || ADUC_ContractUtils_SupportsStepBatches(&contractInfo))
             {
                 result = DoV1DownloadWork(&stepWorkflow, contentHandler, handle, stepHandle);
 
@@ -705,6 +707,323 @@ ADUC_Result StepsHandlerImpl::Download(const tagADUC_WorkflowData* workflowData)
     return StepsHandler_Download(workflowData);
 }
 
+/**
+ * @brief What the steps loop does after a batch of steps.
+ */
+enum class StepBatchOutcome
+{
+    Continue, //!< Continue with the step after the batch.
+    SkipRemainingSteps, //!< A step requested a reboot or agent restart; skip the remaining steps.
+    Stop, //!< Stop the install phase.
+};
+
+/**
+ * @brief Gets the end of the contiguous run of inline steps, starting at @p first, that use @p stepUpdateType.
+ *
+ * @return size_t One past the last step of the run.
+ */
+static size_t GetStepBatchEnd(ADUC_WorkflowHandle handle, size_t first, size_t stepsCount, const char* stepUpdateType)
+{
+    size_t end = first + 1;
+
+    while (end < stepsCount && workflow_is_inline_step(handle, end))
+    {
+        const char* nextUpdateType = workflow_peek_update_manifest_step_handler(handle, end);
+        if (nextUpdateType == nullptr || strcmp(nextUpdateType, stepUpdateType) != 0)
+        {
+            break;
+        }
+
+        ++end;
+    }
+
+    return end;
+}
+
+/**
+ * @brief Returns true if the handler of any of @p stepWorkflows requested the interruption @p isRequested.
+ */
+static bool IsRequestedByAnyStep(
+    const std::vector<const ADUC_WorkflowData*>& stepWorkflows, bool (*isRequested)(ADUC_WorkflowHandle))
+{
+    for (const ADUC_WorkflowData* stepWorkflow : stepWorkflows)
+    {
+        if (isRequested(stepWorkflow->WorkflowHandle))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Propagates the resultDetails of the first failed step to the parent workflow.
+ */
+static void PropagateFirstStepFailureDetails(
+    ADUC_WorkflowHandle handle,
+    const std::vector<const ADUC_WorkflowData*>& stepWorkflows,
+    const std::vector<ADUC_Result>& stepResults)
+{
+    for (size_t k = 0; k < stepWorkflows.size(); k++)
+    {
+        if (IsAducResultCodeFailure(stepResults[k].ResultCode))
+        {
+            workflow_set_result_details(handle, workflow_peek_result_details(stepWorkflows[k]->WorkflowHandle));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Restores each of @p stepWorkflows after a failed batch (best effort).
+ */
+static void RestoreStepBatch(ContentHandler* contentHandler, const std::vector<const ADUC_WorkflowData*>& stepWorkflows)
+{
+    for (const ADUC_WorkflowData* stepWorkflow : stepWorkflows)
+    {
+        try
+        {
+            // The restore result is discarded, since install result is more important to customer.
+            contentHandler->Restore(stepWorkflow);
+        }
+        catch (...)
+        {
+            Log_Warn("Unexpected error happened during restore action.");
+        }
+    }
+}
+
+/**
+ * @brief Performs the backup, install and apply actions of the inline steps [@p first, @p end), which use the same
+ * step handler, as one batch. The handler installs and applies the steps that are not installed yet with one
+ * InstallBatch and one ApplyBatch call, and the result of each step is set on its workflow, as if the steps were
+ * processed one by one.
+ *
+ * @param handle The parent workflow.
+ * @param first The first step of the batch.
+ * @param end One past the last step of the batch.
+ * @param serializedComponentString The selected component, or nullptr.
+ * @param contentHandler The step handler, which supports step batches.
+ * @param[out] outcome What the steps loop does next.
+ * @return ADUC_Result The result of the batch.
+ */
+static ADUC_Result InstallStepBatch(
+    ADUC_WorkflowHandle handle,
+    size_t first,
+    size_t end,
+    const char* serializedComponentString,
+    ContentHandler* contentHandler,
+    StepBatchOutcome* outcome)
+{
+    ADUC_Result result{ ADUC_Result_Failure, 0 };
+    std::vector<ADUC_WorkflowData> stepWorkflows(end - first);
+    std::vector<const ADUC_WorkflowData*> installSteps;
+    std::vector<const ADUC_WorkflowData*> applySteps;
+    std::vector<ADUC_Result> installResults;
+    std::vector<ADUC_Result> applyResults;
+
+    *outcome = StepBatchOutcome::Stop;
+
+    Log_Info("Installing child steps #%lu to #%lu as one batch.", first, end - 1);
+
+    for (size_t i = first; i < end; i++)
+    {
+        ADUC_WorkflowData* stepWorkflow = &stepWorkflows[i - first];
+
+        stepWorkflow->WorkflowHandle = workflow_get_child(handle, i);
+        if (stepWorkflow->WorkflowHandle == nullptr)
+        {
+            const char* errorFmt = "Cannot process step #%lu due to missing (child) workflow data.";
+            Log_Error(errorFmt, i);
+            result.ExtendedResultCode = ADUC_ERC_STEPS_HANDLER_INSTALL_FAILURE_MISSING_CHILD_WORKFLOW;
+            workflow_set_result_details(handle, errorFmt, i);
+            return result;
+        }
+
+        if (serializedComponentString != nullptr
+            && !workflow_set_selected_components(stepWorkflow->WorkflowHandle, serializedComponentString))
+        {
+            result.ExtendedResultCode = ADUC_ERC_STEPS_HANDLER_SET_SELECTED_COMPONENTS_FAILURE;
+            workflow_set_result_details(handle, "Cannot set target component(s) for step #%d", i);
+            return result;
+        }
+
+        // If this item is already installed, leave it out of the batch.
+        try
+        {
+            result = contentHandler->IsInstalled(stepWorkflow);
+        }
+        catch (...)
+        {
+            // Cannot determine whether the step has been applied, so, we'll try to process the step.
+            result.ResultCode = ADUC_Result_IsInstalled_NotInstalled;
+            result.ExtendedResultCode = 0;
+        }
+
+        if (result.ResultCode == ADUC_Result_IsInstalled_Installed)
+        {
+            result.ResultCode = ADUC_Result_Install_Skipped_UpdateAlreadyInstalled;
+            result.ExtendedResultCode = 0;
+            workflow_set_result(stepWorkflow->WorkflowHandle, result);
+            workflow_set_result_details(handle, workflow_peek_result_details(stepWorkflow->WorkflowHandle));
+            continue;
+        }
+
+        installSteps.push_back(stepWorkflow);
+    }
+
+    if (installSteps.empty())
+    {
+        *outcome = StepBatchOutcome::Continue;
+        return result;
+    }
+
+    //
+    // Perform 'backup' action of each step before install.
+    //
+    for (const ADUC_WorkflowData* stepWorkflow : installSteps)
+    {
+        try
+        {
+            result = contentHandler->Backup(stepWorkflow);
+        }
+        catch (...)
+        {
+            result.ResultCode = ADUC_Result_Failure;
+            result.ExtendedResultCode = ADUC_ERC_STEPS_HANDLER_INSTALL_UNKNOWN_EXCEPTION_BACKUP_CHILD_STEP;
+            return result;
+        }
+
+        if (IsAducResultCodeFailure(result.ResultCode))
+        {
+            // Propagate item's resultDetails to parent.
+            workflow_set_result_details(handle, workflow_peek_result_details(stepWorkflow->WorkflowHandle));
+            return result;
+        }
+    }
+
+    //
+    // Perform 'install' action of the batch.
+    //
+    installResults.assign(installSteps.size(), ADUC_Result{ ADUC_Result_Failure, 0 });
+    try
+    {
+        result = contentHandler->InstallBatch(installSteps.data(), installSteps.size(), installResults.data());
+    }
+    catch (...)
+    {
+        Log_Error("The handler throws an exception inside InstallBatch().");
+        result.ResultCode = ADUC_Result_Failure;
+        result.ExtendedResultCode = ADUC_ERC_STEPS_HANDLER_INSTALL_UNKNOWN_EXCEPTION_INSTALL_CHILD_STEP;
+        return result;
+    }
+
+    // If the workflow interruption is required as part of the Install action,
+    // we must propagate that request to the wrapping workflow and skip the remaining instance(s).
+    if (IsRequestedByAnyStep(installSteps, workflow_is_immediate_reboot_requested))
+    {
+        workflow_request_immediate_reboot(handle);
+        return result;
+    }
+
+    if (IsRequestedByAnyStep(installSteps, workflow_is_immediate_agent_restart_requested))
+    {
+        workflow_request_immediate_agent_restart(handle);
+        return result;
+    }
+
+    if (IsAducResultCodeFailure(result.ResultCode))
+    {
+        PropagateFirstStepFailureDetails(handle, installSteps, installResults);
+        RestoreStepBatch(contentHandler, installSteps);
+
+        for (size_t k = 0; k < installSteps.size(); k++)
+        {
+            workflow_set_result(installSteps[k]->WorkflowHandle, installResults[k]);
+        }
+
+        return result;
+    }
+
+    // Steps that report the update is already installed skip the 'apply' action.
+    for (size_t k = 0; k < installSteps.size(); k++)
+    {
+        switch (installResults[k].ResultCode)
+        {
+        case ADUC_Result_Install_Skipped_UpdateAlreadyInstalled:
+        case ADUC_Result_Install_Skipped_NoMatchingComponents:
+            workflow_set_result(installSteps[k]->WorkflowHandle, installResults[k]);
+            break;
+
+        default:
+            applySteps.push_back(installSteps[k]);
+            break;
+        }
+    }
+
+    //
+    // Perform 'apply' action of the batch.
+    //
+    if (!applySteps.empty())
+    {
+        applyResults.assign(applySteps.size(), ADUC_Result{ ADUC_Result_Failure, 0 });
+        try
+        {
+            result = contentHandler->ApplyBatch(applySteps.data(), applySteps.size(), applyResults.data());
+            Log_Debug("Steps' ApplyBatch() return r:0x%x rc:0x%x", result.ResultCode, result.ExtendedResultCode);
+        }
+        catch (...)
+        {
+            Log_Error("The handler throws an exception inside ApplyBatch().");
+            result.ResultCode = ADUC_Result_Failure;
+            result.ExtendedResultCode = ADUC_ERC_STEPS_HANDLER_INSTALL_UNKNOWN_EXCEPTION_APPLY_CHILD_STEP;
+            return result;
+        }
+
+        if (IsAducResultCodeFailure(result.ResultCode))
+        {
+            PropagateFirstStepFailureDetails(handle, applySteps, applyResults);
+            Log_Info("Failed to apply the batch. Try to restore now...");
+            RestoreStepBatch(contentHandler, applySteps);
+        }
+    }
+
+    if (IsRequestedByAnyStep(applySteps, workflow_is_immediate_reboot_requested))
+    {
+        workflow_request_immediate_reboot(handle);
+        return result;
+    }
+
+    if (IsRequestedByAnyStep(applySteps, workflow_is_immediate_agent_restart_requested))
+    {
+        workflow_request_immediate_agent_restart(handle);
+        return result;
+    }
+
+    *outcome = StepBatchOutcome::Continue;
+
+    if (IsRequestedByAnyStep(installSteps, workflow_is_reboot_requested))
+    {
+        // Continue with the remaining instance(s).
+        workflow_request_reboot(handle);
+        *outcome = StepBatchOutcome::SkipRemainingSteps;
+    }
+    else if (IsRequestedByAnyStep(installSteps, workflow_is_agent_restart_requested))
+    {
+        // Continue with the remaining instance(s).
+        workflow_request_agent_restart(handle);
+        *outcome = StepBatchOutcome::SkipRemainingSteps;
+    }
+
+    for (size_t k = 0; k < applySteps.size(); k++)
+    {
+        workflow_set_result(applySteps[k]->WorkflowHandle, applyResults[k]);
+    }
+
+    return result;
+}
+
 /**
  * @brief Performs 'Install' phase.
  * All files required for installation must be downloaded in to sandbox.
@@ -743,6 +1062,11 @@ ADUC_Result StepsHandlerImpl::Download(const tagADUC_WorkflowData* workflowData)
  *           In this case, if the reference step is intended to be install onto a component, it's likely to be failed, due to missing component info.
  *              - [Process the step] (same as above, but w/o selected component data)
  *
+ *     - Consecutive inline steps of a step handler with a v1.1 contract are processed as one batch:
+ *         - Steps that are already installed are left out.
+ *         - Invoke contentHandler::Backup for each step, then contentHandler::InstallBatch and
+ *           contentHandler::ApplyBatch once for all steps, and set the result of each step.
+ *
  * @return ADUC_Result The 'install' result
  */
 static ADUC_Result StepsHandler_Install(const tagADUC_WorkflowData* workflowData)
@@ -906,6 +1230,39 @@ static ADUC_Result StepsHandler_Install(const tagADUC_WorkflowData* workflowData
                 goto done;
             }
 
+            // Process consecutive steps of a handler that supports step batches at once.
+            if (workflow_is_inline_step(handle, i))
+            {
+                ADUC_ExtensionContractInfo contractInfo = contentHandler->GetContractInfo();
+                const size_t batchEnd = GetStepBatchEnd(handle, i, stepsCount, stepUpdateType);
+
+                if (ADUC_ContractUtils_SupportsStepBatches(&contractInfo) && batchEnd - i > 1)
+                {
+                    StepBatchOutcome outcome = StepBatchOutcome::Stop;
+                    result = InstallStepBatch(
+                        handle, i, batchEnd, serializedComponentString, contentHandler, &outcome);
+                    stepHandle = nullptr;
+                    i = batchEnd - 1;
+
+                    if (outcome == StepBatchOutcome::Stop)
+                    {
+                        goto done;
+                    }
+
+                    if (outcome == StepBatchOutcome::SkipRemainingSteps)
+                    {
+                        break;
+                    }
+
+                    if (IsAducResultCodeFailure(result.ResultCode))
+                    {
+                        goto componentDone;
+                    }
+
+                    continue;
+                }
+            }
+
             // If this item is already installed, skip to the next one.
             try
             {
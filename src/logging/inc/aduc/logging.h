@@ -39,6 +39,7 @@ typedef enum tagADUC_LOG_SEVERITY
 // Logging Init and Uninit helper function forward declarations.
 // These are implemented for each logging library.
 void ADUC_Logging_Init(ADUC_LOG_SEVERITY logLevel, const char* filePrefix);
+void ADUC_Logging_InitDeferred(ADUC_LOG_SEVERITY logLevel, const char* filePrefix);
 void ADUC_Logging_Uninit();
 ADUC_LOG_SEVERITY ADUC_Logging_GetLevel();
 
@@ -69,6 +70,7 @@ ADUC_LOG_SEVERITY ADUC_Logging_GetLevel();
 // Logging Init and Uninit helper function forward declarations.
 // These are implemented for each logging library.
 #    define ADUC_Logging_Init(...)
+#    define ADUC_Logging_InitDeferred(...)
 #    define ADUC_Logging_Uninit(...)
 #    define ADUC_Logging_GetLevel(...) (0)
 
@@ -51,6 +51,15 @@ int zlog_init(
     int file_enable,
     enum ZLOG_SEVERITY console_level,
     enum ZLOG_SEVERITY file_level);
+// initialize zlog log settings, but defer creating the log file until the first file log entry
+int zlog_init_deferred(
+    const char* log_dir,
+    const char* log_file,
+    int console_enable,
+    int file_enable,
+    enum ZLOG_SEVERITY console_level,
+    enum ZLOG_SEVERITY file_level,
+    void (*on_first_file_log)(void));
 // finish using the zlog; clean up
 void zlog_finish(void);
 // explicitly flush the buffer in memory
@@ -59,15 +59,12 @@ ADUC_LOG_SEVERITY ZLogLevelToAducLogSeverity(enum ZLOG_SEVERITY logLevel)
 ADUC_LOG_SEVERITY g_logLevel = ADUC_LOG_INFO;
 
 /**
- * @brief Initialize logging.
- * @param logLevel log level.
+ * @brief Creates the log folder if it does not exist.
+ * @details zlog_init doesn't create the log path, so attempt to create it here.
+ * If it can't be created, zlogging will send output to console.
  */
-void ADUC_Logging_Init(ADUC_LOG_SEVERITY logLevel, const char* filePrefix)
+static void EnsureLogFolderExists(void)
 {
-    g_logLevel = ADUC_LOG_INFO;
-
-    // zlog_init doesn't create the log path, so attempt to create it here if it does not exist.
-    // If it can't be created, zlogging will send output to console.
     struct stat st;
     if (stat(ADUC_LOG_FOLDER, &st) != 0)
     {
@@ -79,6 +76,17 @@ void ADUC_Logging_Init(ADUC_LOG_SEVERITY logLevel, const char* filePrefix)
             printf("WARNING: Cannot create a folder for logging file. ('%s')", ADUC_LOG_FOLDER);
         }
     }
+}
+
+/**
+ * @brief Initialize logging.
+ * @param logLevel log level.
+ */
+void ADUC_Logging_Init(ADUC_LOG_SEVERITY logLevel, const char* filePrefix)
+{
+    g_logLevel = ADUC_LOG_INFO;
+
+    EnsureLogFolderExists();
 
     if (zlog_init(
             ADUC_LOG_FOLDER,
@@ -94,6 +102,31 @@ void ADUC_Logging_Init(ADUC_LOG_SEVERITY logLevel, const char* filePrefix)
     }
 }
 
+/**
+ * @brief Initialize logging, deferring creation of the log folder and log file until
+ * the first entry at or above @p logLevel is logged.
+ * @details Meant for short-lived processes (e.g. adu-shell) that usually log little or nothing.
+ * @param logLevel log level.
+ * @param filePrefix log file name prefix.
+ */
+void ADUC_Logging_InitDeferred(ADUC_LOG_SEVERITY logLevel, const char* filePrefix)
+{
+    g_logLevel = ADUC_LOG_INFO;
+
+    if (zlog_init_deferred(
+            ADUC_LOG_FOLDER,
+            filePrefix == NULL ? "aduc" : filePrefix,
+            ZLOG_ENABLED /* enable console logging*/,
+            ZLOG_ENABLED /* enable file logging*/,
+            AducLogSeverityToZLogLevel(logLevel) /* set console log level*/,
+            AducLogSeverityToZLogLevel(logLevel) /* set file log level*/,
+            EnsureLogFolderExists)
+        != 0)
+    {
+        printf("WARNING: Unable to start file logger. (Log folder: %s)\n", ADUC_LOG_FOLDER);
+    }
+}
+
 /**
  * @brief Disable logging.
  */
@@ -55,6 +55,10 @@ char _zlog_buffer[ZLOG_BUFFER_MAXLINES][ZLOG_BUFFER_LINE_MAXCHARS];
 static int _zlog_buffer_count = 0;
 static pthread_mutex_t _zlog_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static bool zlog_deferred_file_log_pending = false;
+static void (*zlog_deferred_file_log_hook)(void) = NULL;
+static pthread_mutex_t zlog_deferred_file_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 struct tm* get_current_utctime();
 bool get_current_utctime_filename(char* fullpath, size_t fullpath_len);
 static inline void _zlog_buffer_lock(void);
@@ -113,10 +117,9 @@ static bool zlog_term_supports_color()
 
 // ------------------------- Logging Utilities -------------------------
 
-// Initialize zlog logging settings:
-// Return true when the settings are initialized exactly as specified
-// Otherwise leave zlog_fout = NULL and return false
-int zlog_init(
+// Initialize the console and file logging settings, and take copies of the log folder and file prefix.
+// Does not open the log file.
+static int zlog_init_settings(
     char const* log_dir,
     char const* log_file,
     int console_enable,
@@ -168,25 +171,103 @@ int zlog_init(
         }
         strcpy(zlog_file_log_prefix, log_file); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
         strcat(zlog_file_log_prefix, "."); // NOLINT(clang-analyzer-security.insecureAPI.strcpy)
+    }
 
-        // Timestamp the log file
-        char zlog_file_log_fullpath[512];
-        if (!get_current_utctime_filename(zlog_file_log_fullpath, sizeof(zlog_file_log_fullpath)))
+    return 0;
+}
+
+// Open the timestamped log file in zlog_file_log_dir and trim old log files.
+static int zlog_open_file_log(void)
+{
+    // Timestamp the log file
+    char zlog_file_log_fullpath[512];
+    if (!get_current_utctime_filename(zlog_file_log_fullpath, sizeof(zlog_file_log_fullpath)))
+    {
+        // When error occurs to snprintf filepath, return false
+        return -1;
+    }
+
+    zlog_fout = fopen(zlog_file_log_fullpath, "a+");
+    if (zlog_fout == NULL)
+    {
+        return -1;
+    }
+    log_debug("Log file created: %s", zlog_file_log_fullpath);
+
+    zlog_ensure_at_most_n_logfiles(ZLOG_MAX_FILE_COUNT);
+    return 0;
+}
+
+// Initialize zlog logging settings:
+// Return true when the settings are initialized exactly as specified
+// Otherwise leave zlog_fout = NULL and return false
+int zlog_init(
+    char const* log_dir,
+    char const* log_file,
+    int console_enable,
+    int file_enable,
+    enum ZLOG_SEVERITY console_level,
+    enum ZLOG_SEVERITY file_level)
+{
+    if (zlog_init_settings(log_dir, log_file, console_enable, file_enable, console_level, file_level) != 0)
+    {
+        return -1;
+    }
+
+    if (file_enable == ZLOG_ENABLED)
+    {
+        return zlog_open_file_log();
+    }
+
+    return 0;
+}
+
+// Same as zlog_init, but the log file is only created (and old log files trimmed) when the
+// first entry at or above file_level is logged. on_first_file_log, if not NULL, is called
+// right before the log file is opened.
+int zlog_init_deferred(
+    char const* log_dir,
+    char const* log_file,
+    int console_enable,
+    int file_enable,
+    enum ZLOG_SEVERITY console_level,
+    enum ZLOG_SEVERITY file_level,
+    void (*on_first_file_log)(void))
+{
+    if (zlog_init_settings(log_dir, log_file, console_enable, file_enable, console_level, file_level) != 0)
+    {
+        return -1;
+    }
+
+    if (file_enable == ZLOG_ENABLED)
+    {
+        zlog_deferred_file_log_hook = on_first_file_log;
+        zlog_deferred_file_log_pending = true;
+    }
+
+    return 0;
+}
+
+// Open the deferred log file, if any. Only the first caller does the work.
+static void zlog_open_deferred_file_log(void)
+{
+    pthread_mutex_lock(&zlog_deferred_file_log_mutex);
+    if (zlog_deferred_file_log_pending)
+    {
+        // Clear first, since zlog_open_file_log logs.
+        zlog_deferred_file_log_pending = false;
+
+        if (zlog_deferred_file_log_hook != NULL)
         {
-            // When error occurs to snprintf filepath, return false
-            return -1;
+            zlog_deferred_file_log_hook();
         }
 
-        zlog_fout = fopen(zlog_file_log_fullpath, "a+");
-        if (zlog_fout == NULL)
+        if (zlog_open_file_log() != 0)
         {
-            return -1;
+            printf("WARNING: Unable to start file logger. (Log folder: %s)\n", zlog_file_log_dir);
         }
-        log_debug("Log file created: %s", zlog_file_log_fullpath);
-
-        zlog_ensure_at_most_n_logfiles(ZLOG_MAX_FILE_COUNT);
     }
-    return 0;
+    pthread_mutex_unlock(&zlog_deferred_file_log_mutex);
 }
 
 // Caller should NOT hold the lock
@@ -200,6 +281,9 @@ void zlog_flush_buffer(void)
 // Caller should NOT hold the lock
 void zlog_finish(void)
 {
+    zlog_deferred_file_log_pending = false;
+    zlog_deferred_file_log_hook = NULL;
+
     zlog_flush_buffer();
 
     zlog_close_file_log();
@@ -237,6 +321,12 @@ void zlog_log(enum ZLOG_SEVERITY msg_level, const char* func, unsigned int line,
 {
     const bool console_log_needed =
         (log_setting.console_logging_mode != ZLOG_CLM_DISABLED) && (msg_level >= log_setting.console_level);
+
+    if (zlog_deferred_file_log_pending && msg_level >= log_setting.file_level)
+    {
+        zlog_open_deferred_file_log();
+    }
+
     const bool file_log_needed = zlog_is_file_log_open() && (msg_level >= log_setting.file_level);
 
     if (!console_log_needed && !file_log_needed)
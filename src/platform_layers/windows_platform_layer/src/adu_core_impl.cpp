@@ -141,6 +141,9 @@ ADUC_Result WindowsPlatformLayer::Download(const ADUC_WorkflowData* workflowData
         goto done;
     }
 
+    // Runs on the download thread, so the main thread is not blocked while housekeeping yields.
+    ADUC_Workflow_WaitForHousekeeping();
+
     result = contentHandler->Download(workflowData);
     if (_IsCancellationRequested)
     {
@@ -32,6 +32,8 @@ bool atoul(const char* str, unsigned long* converted);
 
 bool atoui(const char* str, unsigned int* ui);
 
+bool ADUC_ParseTimeOfDay(const char* str, unsigned int* minuteOfDay);
+
 size_t ADUC_StrNLen(const char* str, size_t maxsize);
 
 char* ADUC_StringFormat(const char* fmt, ...);
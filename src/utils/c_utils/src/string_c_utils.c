@@ -223,6 +223,38 @@ bool atoui(const char* str, unsigned int* ui)
     return true;
 }
 
+/**
+ * @brief Parses a "HH:MM" time of day.
+ * @param[in] str The time string, e.g. "02:30".
+ * @param[out] minuteOfDay Minutes after midnight.
+ * @return true on success.
+ */
+bool ADUC_ParseTimeOfDay(const char* str, unsigned int* minuteOfDay)
+{
+    if (str == NULL || strlen(str) != 5 || str[2] != ':')
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 5; ++i)
+    {
+        if (i != 2 && (str[i] < '0' || str[i] > '9'))
+        {
+            return false;
+        }
+    }
+
+    unsigned int hours = (unsigned int)((str[0] - '0') * 10 + (str[1] - '0'));
+    unsigned int minutes = (unsigned int)((str[3] - '0') * 10 + (str[4] - '0'));
+    if (hours > 23 || minutes > 59)
+    {
+        return false;
+    }
+
+    *minuteOfDay = hours * 60 + minutes;
+    return true;
+}
+
 /**
  * @brief  Finds the length in bytes of the given string, not including the final null character. Only the first maxsize characters are inspected: if the null character is not found, maxsize is returned.
  * @param str  string whose length is to be computed
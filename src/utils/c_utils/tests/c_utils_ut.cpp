@@ -356,6 +356,28 @@ TEST_CASE("atoul")
     }
 }
 
+TEST_CASE("ADUC_ParseTimeOfDay")
+{
+    unsigned int minuteOfDay = 0;
+
+    SECTION("Valid times")
+    {
+        CHECK(ADUC_ParseTimeOfDay("00:00", &minuteOfDay));
+        CHECK(minuteOfDay == 0);
+        CHECK(ADUC_ParseTimeOfDay("23:59", &minuteOfDay));
+        CHECK(minuteOfDay == 23 * 60 + 59);
+    }
+
+    SECTION("Invalid times")
+    {
+        CHECK(!ADUC_ParseTimeOfDay(nullptr, &minuteOfDay));
+        CHECK(!ADUC_ParseTimeOfDay("2:00", &minuteOfDay));
+        CHECK(!ADUC_ParseTimeOfDay("24:00", &minuteOfDay));
+        CHECK(!ADUC_ParseTimeOfDay("12:60", &minuteOfDay));
+        CHECK(!ADUC_ParseTimeOfDay("12-30", &minuteOfDay));
+    }
+}
+
 TEST_CASE("ADUC_StrNLen")
 {
     SECTION("Check string in bounds")
@@ -92,6 +92,22 @@ typedef struct tagADUC_ConfigInfo
     unsigned int
         downloadTimeoutInMinutes; /**< The timeout for downloading an update payload. A value of zero means to use the default. */
 
+    const JSON_Object* installPolicy; /**< Optional local install policy, e.g. a maintenance window. */
+
+    const char* pageCacheMode; /**< Optional page cache mode for payload I/O: "default" or "dropBehind". */
+
+    const JSON_Object* peerSharing; /**< Optional sharing of payloads with agents on the local network. */
+
+    const JSON_Object* downloadTransport; /**< Optional HTTP version of payload downloads, per endpoint. */
+
+    const JSON_Object* socketTuning; /**< Optional TCP tuning of download connections. */
+
+    const char* cryptoProvider; /**< Optional OpenSSL provider or engine for signature verification. */
+
+    const JSON_Object* tlsSessionCache; /**< Optional persisted TLS session cache of download connections. */
+
+    const JSON_Object* dnsCache; /**< Optional DNS cache of download hosts. */
+
     const char* aduShellFolder; /**< The folder where ADU shell is installed. */
 
     char* aduShellFilePath; /**< The full path to ADU shell binary. */
@@ -161,6 +177,15 @@ const ADUC_AgentInfo* ADUC_ConfigInfo_GetAgent(const ADUC_ConfigInfo* config, un
  */
 VECTOR_HANDLE ADUC_ConfigInfo_GetAduShellTrustedUsers(const ADUC_ConfigInfo* config);
 
+/**
+ * @brief Reads only the adu shell trusted user list from the configuration file, without
+ * initializing the full ADUC_ConfigInfo object.
+ *
+ * @param configFolder The folder of configuration files. If NULL or empty, the default folder is used.
+ * @return VECTOR_HANDLE The trusted users, or NULL if failure. Free with ADUC_ConfigInfo_FreeAduShellTrustedUsers.
+ */
+VECTOR_HANDLE ADUC_ConfigInfo_ReadAduShellTrustedUsers(const char* configFolder);
+
 /**
  * @brief Free the VECTOR_HANDLE (adu shell truster users) and all the elements in it
  *
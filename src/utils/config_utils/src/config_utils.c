@@ -51,6 +51,14 @@ static const char* CONFIG_MANUFACTURER = "manufacturer";
 static const char* CONFIG_MODEL = "model";
 static const char* CONFIG_SCHEMA_VERSION = "schemaVersion";
 static const char* CONFIG_DOWNLOAD_TIMEOUT_IN_MINUTES = "downloadTimeoutInMinutes";
+static const char* CONFIG_INSTALL_POLICY = "installPolicy";
+static const char* CONFIG_PAGE_CACHE_MODE = "pageCacheMode";
+static const char* CONFIG_PEER_SHARING = "peerSharing";
+static const char* CONFIG_DOWNLOAD_TRANSPORT = "downloadTransport";
+static const char* CONFIG_SOCKET_TUNING = "socketTuning";
+static const char* CONFIG_CRYPTO_PROVIDER = "cryptoProvider";
+static const char* CONFIG_TLS_SESSION_CACHE = "tlsSessionCache";
+static const char* CONFIG_DNS_CACHE = "dnsCache";
 
 static const char* CONFIG_NAME = "name";
 static const char* CONFIG_RUN_AS = "runas";
@@ -491,6 +499,30 @@ bool ADUC_ConfigInfo_Init(ADUC_ConfigInfo* config, const char* configFolder)
     ADUC_JSON_GetUnsignedIntegerField(
         config->rootJsonValue, CONFIG_DOWNLOAD_TIMEOUT_IN_MINUTES, &(config->downloadTimeoutInMinutes));
 
+    // Note: install policy is optional.
+    config->installPolicy = json_object_get_object(root_object, CONFIG_INSTALL_POLICY);
+
+    // Note: page cache mode is optional.
+    config->pageCacheMode = ADUC_JSON_GetStringFieldPtr(config->rootJsonValue, CONFIG_PAGE_CACHE_MODE);
+
+    // Note: peer sharing is optional.
+    config->peerSharing = json_object_get_object(root_object, CONFIG_PEER_SHARING);
+
+    // Note: download transport is optional.
+    config->downloadTransport = json_object_get_object(root_object, CONFIG_DOWNLOAD_TRANSPORT);
+
+    // Note: socket tuning is optional.
+    config->socketTuning = json_object_get_object(root_object, CONFIG_SOCKET_TUNING);
+
+    // Note: crypto provider is optional.
+    config->cryptoProvider = ADUC_JSON_GetStringFieldPtr(config->rootJsonValue, CONFIG_CRYPTO_PROVIDER);
+
+    // Note: TLS session cache is optional.
+    config->tlsSessionCache = json_object_get_object(root_object, CONFIG_TLS_SESSION_CACHE);
+
+    // Note: DNS cache is optional.
+    config->dnsCache = json_object_get_object(root_object, CONFIG_DNS_CACHE);
+
     // Ensure that adu-shell folder is valid.
     config->aduShellFolder = ADUC_JSON_GetStringFieldPtr(config->rootJsonValue, CONFIG_ADU_SHELL_FOLDER);
 
@@ -642,24 +674,17 @@ const ADUC_AgentInfo* ADUC_ConfigInfo_GetAgent(const ADUC_ConfigInfo* config, un
 }
 
 /**
- * @brief Get the adu trusted user list
+ * @brief Copies the users in the @p trustedUsers JSON array into a new vector.
  *
- * @param config A pointer to a const ADUC_ConfigInfo struct
- * @return VECTOR_HANDLE
+ * @param trustedUsers The aduShellTrustedUsers JSON array.
+ * @return VECTOR_HANDLE The vector (type VECTOR_HANDLE) containing users (type STRING_HANDLE), or NULL on failure.
  */
-VECTOR_HANDLE ADUC_ConfigInfo_GetAduShellTrustedUsers(const ADUC_ConfigInfo* config)
+static VECTOR_HANDLE TrustedUsersArrayToVector(const JSON_Array* trustedUsers)
 {
     bool success = false;
 
-    if (config == NULL)
-    {
-        return NULL;
-    }
-
     VECTOR_HANDLE userVector = VECTOR_create(sizeof(STRING_HANDLE));
 
-    JSON_Array* trustedUsers = config->aduShellTrustedUsers;
-
     for (size_t i = 0; i < json_array_get_count(trustedUsers); i++)
     {
         STRING_HANDLE userString = STRING_construct(json_array_get_string(trustedUsers, i));
@@ -689,6 +714,72 @@ done:
     return userVector;
 }
 
+/**
+ * @brief Get the adu trusted user list
+ *
+ * @param config A pointer to a const ADUC_ConfigInfo struct
+ * @return VECTOR_HANDLE
+ */
+VECTOR_HANDLE ADUC_ConfigInfo_GetAduShellTrustedUsers(const ADUC_ConfigInfo* config)
+{
+    if (config == NULL)
+    {
+        return NULL;
+    }
+
+    return TrustedUsersArrayToVector(config->aduShellTrustedUsers);
+}
+
+/**
+ * @brief Reads only the adu shell trusted user list from the configuration file.
+ *
+ * Unlike ADUC_ConfigInfo_GetInstance, this does not validate the rest of the configuration
+ * or compute the agents and extension folders, so it is cheap enough for short-lived processes.
+ *
+ * @param configFolder The folder of configuration files. If NULL or empty, the default folder (ADUC_CONF_FOLDER) will be used.
+ * @return VECTOR_HANDLE The trusted users, or NULL if the file cannot be parsed or the field is missing.
+ * Caller must call ADUC_ConfigInfo_FreeAduShellTrustedUsers to free the vector.
+ */
+VECTOR_HANDLE ADUC_ConfigInfo_ReadAduShellTrustedUsers(const char* configFolder)
+{
+    VECTOR_HANDLE userVector = NULL;
+    JSON_Value* rootValue = NULL;
+
+    char* configFilePath =
+        ADUC_StringFormat("%s/%s", IsNullOrEmpty(configFolder) ? ADUC_CONF_FOLDER : configFolder, ADUC_CONF_FILE);
+
+    if (configFilePath == NULL)
+    {
+        Log_Error("Failed to allocate memory for config file path");
+        goto done;
+    }
+
+    rootValue = Parse_JSON_File(configFilePath);
+
+    if (rootValue == NULL)
+    {
+        Log_Error("Failed parse of JSON file: %s", configFilePath);
+        goto done;
+    }
+
+    const JSON_Array* trustedUsers =
+        json_object_get_array(json_value_get_object(rootValue), CONFIG_ADU_SHELL_TRUSTED_USERS);
+
+    if (trustedUsers == NULL)
+    {
+        Log_Error(INVALID_OR_MISSING_FIELD_ERROR_FMT, CONFIG_ADU_SHELL_TRUSTED_USERS);
+        goto done;
+    }
+
+    userVector = TrustedUsersArrayToVector(trustedUsers);
+
+done:
+    json_value_free(rootValue);
+    free(configFilePath);
+
+    return userVector;
+}
+
 /**
  * @brief Free the VECTOR_HANDLE (adu shell truster users) and all the elements in it
  *
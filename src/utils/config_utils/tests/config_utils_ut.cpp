@@ -306,6 +306,37 @@ static const char* validConfigContentDownloadTimeout =
         R"(])"
     R"(})";
 
+static const char* validConfigContentInstallPolicy =
+    R"({)"
+        R"("schemaVersion": "1.1",)"
+        R"("aduShellTrustedUsers": ["adu","do"],)"
+        R"("manufacturer": "device_info_manufacturer",)"
+        R"("model": "device_info_model",)"
+        R"("installPolicy": {)"
+            R"("maintenanceWindow": { "start": "02:00", "end": "04:30" },)"
+            R"("maxLoadAverage": 0.5)"
+        R"(},)"
+        R"("pageCacheMode": "default",)"
+        R"("peerSharing": { "rangeKB": 512 },)"
+        R"("downloadTransport": { "httpVersion": "http3" },)"
+        R"("socketTuning": { "calibrate": true },)"
+        R"("cryptoProvider": "default",)"
+        R"("tlsSessionCache": { "maxEndpoints": 4 },)"
+        R"("dnsCache": { "staleSeconds": 600 },)"
+        R"("agents": [)"
+            R"({ )"
+            R"("name": "host-update",)"
+            R"("runas": "adu",)"
+            R"("connectionSource": {)"
+                R"("connectionType": "AIS",)"
+                R"("connectionData": "iotHubDeviceUpdate")"
+            R"(},)"
+            R"("manufacturer": "Contoso",)"
+            R"("model": "Smart-Box")"
+            R"(})"
+        R"(])"
+    R"(})";
+
 static const char* validConfigWithOverrideFolder =
     R"({)"
         R"("schemaVersion": "1.1",)"
@@ -519,6 +550,41 @@ TEST_CASE_METHOD(GlobalMockHookTestCaseFixture, "ADUC_ConfigInfo_Init Functional
 
         CHECK(ADUC_ConfigInfo_Init(&config, "/etc/adu"));
         CHECK(config.downloadTimeoutInMinutes == 1440);
+        CHECK(config.installPolicy == nullptr);
+        CHECK(config.pageCacheMode == nullptr);
+        CHECK(config.peerSharing == nullptr);
+        CHECK(config.downloadTransport == nullptr);
+        CHECK(config.socketTuning == nullptr);
+        CHECK(config.cryptoProvider == nullptr);
+        CHECK(config.tlsSessionCache == nullptr);
+        CHECK(config.dnsCache == nullptr);
+
+        ADUC_ConfigInfo_UnInit(&config);
+    }
+
+    SECTION("Valid config content, installPolicy")
+    {
+        REQUIRE(mallocAndStrcpy_s(&g_configContentString, validConfigContentInstallPolicy) == 0);
+        ADUC::StringUtils::cstr_wrapper configStr{ g_configContentString };
+
+        ADUC_ConfigInfo config = {};
+
+        CHECK(ADUC_ConfigInfo_Init(&config, "/etc/adu"));
+        REQUIRE(config.installPolicy != nullptr);
+        CHECK(json_object_get_number(config.installPolicy, "maxLoadAverage") == Approx(0.5));
+        CHECK(json_object_get_object(config.installPolicy, "maintenanceWindow") != nullptr);
+        CHECK_THAT(config.pageCacheMode, Equals("default"));
+        REQUIRE(config.peerSharing != nullptr);
+        CHECK(json_object_get_number(config.peerSharing, "rangeKB") == Approx(512));
+        REQUIRE(config.downloadTransport != nullptr);
+        CHECK_THAT(json_object_get_string(config.downloadTransport, "httpVersion"), Equals("http3"));
+        REQUIRE(config.socketTuning != nullptr);
+        CHECK(json_object_get_boolean(config.socketTuning, "calibrate") == 1);
+        CHECK_THAT(config.cryptoProvider, Equals("default"));
+        REQUIRE(config.tlsSessionCache != nullptr);
+        CHECK(json_object_get_number(config.tlsSessionCache, "maxEndpoints") == 4);
+        REQUIRE(config.dnsCache != nullptr);
+        CHECK(json_object_get_number(config.dnsCache, "staleSeconds") == 600);
 
         ADUC_ConfigInfo_UnInit(&config);
     }
@@ -642,3 +708,50 @@ TEST_CASE_METHOD(GlobalMockHookTestCaseFixture, "ADUC_ConfigInfo_Init Functional
         CHECK(config->refCount == 0);
     }
 }
+
+TEST_CASE_METHOD(GlobalMockHookTestCaseFixture, "ADUC_ConfigInfo_ReadAduShellTrustedUsers Functional Tests")
+{
+    SECTION("Valid config content, Success Test")
+    {
+        REQUIRE(mallocAndStrcpy_s(&g_configContentString, validConfigContentStr) == 0);
+        ADUC::StringUtils::cstr_wrapper configStr{ g_configContentString };
+
+        VECTOR_HANDLE users = ADUC_ConfigInfo_ReadAduShellTrustedUsers("/etc/adu");
+        REQUIRE(users != nullptr);
+        CHECK(VECTOR_size(users) == 2);
+        CHECK_THAT(STRING_c_str(*static_cast<STRING_HANDLE*>(VECTOR_element(users, 0))), Equals("adu"));
+        CHECK_THAT(STRING_c_str(*static_cast<STRING_HANDLE*>(VECTOR_element(users, 1))), Equals("do"));
+
+        ADUC_ConfigInfo_FreeAduShellTrustedUsers(users);
+        VECTOR_destroy(users);
+    }
+
+    SECTION("Agents are not required, Success Test")
+    {
+        REQUIRE(mallocAndStrcpy_s(&g_configContentString, R"({ "aduShellTrustedUsers": ["adu"] })") == 0);
+        ADUC::StringUtils::cstr_wrapper configStr{ g_configContentString };
+
+        VECTOR_HANDLE users = ADUC_ConfigInfo_ReadAduShellTrustedUsers(nullptr);
+        REQUIRE(users != nullptr);
+        CHECK(VECTOR_size(users) == 1);
+
+        ADUC_ConfigInfo_FreeAduShellTrustedUsers(users);
+        VECTOR_destroy(users);
+    }
+
+    SECTION("Missing aduShellTrustedUsers, Failure Test")
+    {
+        REQUIRE(mallocAndStrcpy_s(&g_configContentString, R"({ "schemaVersion": "1.1" })") == 0);
+        ADUC::StringUtils::cstr_wrapper configStr{ g_configContentString };
+
+        CHECK(ADUC_ConfigInfo_ReadAduShellTrustedUsers("/etc/adu") == nullptr);
+    }
+
+    SECTION("Invalid config content, Failure Test")
+    {
+        REQUIRE(mallocAndStrcpy_s(&g_configContentString, "{ invalid") == 0);
+        ADUC::StringUtils::cstr_wrapper configStr{ g_configContentString };
+
+        CHECK(ADUC_ConfigInfo_ReadAduShellTrustedUsers("/etc/adu") == nullptr);
+    }
+}
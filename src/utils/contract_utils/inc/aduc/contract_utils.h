@@ -15,6 +15,7 @@
 
 #define ADUC_V1_CONTRACT_MAJOR_VER 1 //!< The major version of the v1 contract model
 #define ADUC_V1_CONTRACT_MINOR_VER 0 //!< The minor version of the v1 contract model
+#define ADUC_V1_1_CONTRACT_MINOR_VER 1 //!< The minor version of the v1.1 contract model, which adds step batches
 
 /**
  * @brief The Extenstion Contract Info struct that wraps the version for the contract information
@@ -34,6 +35,14 @@ EXTERN_C_BEGIN
  */
 bool ADUC_ContractUtils_IsV1Contract(ADUC_ExtensionContractInfo* contractInfo);
 
+/**
+ * @brief Checks if @p contractInfo is a v1.1 or later v1 contract, whose step handlers accept a contiguous run
+ * of their own steps as one batch (ContentHandler::InstallBatch and ContentHandler::ApplyBatch)
+ * @param contractInfo the contractInfo to check
+ * @returns true if step batches are supported; false otherwise
+ */
+bool ADUC_ContractUtils_SupportsStepBatches(ADUC_ExtensionContractInfo* contractInfo);
+
 EXTERN_C_END
 
 #endif // ADUC_CONTRACT_UTILS
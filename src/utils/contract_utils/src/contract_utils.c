@@ -18,3 +18,10 @@ bool ADUC_ContractUtils_IsV1Contract(ADUC_ExtensionContractInfo* contractInfo)
         || (contractInfo->majorVer == ADUC_V1_CONTRACT_MAJOR_VER
             && contractInfo->minorVer == ADUC_V1_CONTRACT_MINOR_VER);
 }
+
+bool ADUC_ContractUtils_SupportsStepBatches(ADUC_ExtensionContractInfo* contractInfo)
+{
+    // A v1.1 contract is a superset of the v1.0 contract.
+    return contractInfo != NULL && contractInfo->majorVer == ADUC_V1_CONTRACT_MAJOR_VER
+        && contractInfo->minorVer >= ADUC_V1_1_CONTRACT_MINOR_VER;
+}
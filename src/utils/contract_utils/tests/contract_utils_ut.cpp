@@ -45,3 +45,41 @@ TEST_CASE("ADUC_ContractUtils_IsV1Contract")
         CHECK(ADUC_ContractUtils_IsV1Contract(&contractInfo));
     }
 }
+
+TEST_CASE("ADUC_ContractUtils_SupportsStepBatches")
+{
+    SECTION("NULL contractInfo")
+    {
+        ADUC_ExtensionContractInfo* info = nullptr;
+        CHECK_FALSE(ADUC_ContractUtils_SupportsStepBatches(info));
+    }
+
+    SECTION("Before 1.1")
+    {
+        ADUC_ExtensionContractInfo contractInfo{};
+        CHECK_FALSE(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+
+        contractInfo.majorVer = 1;
+        contractInfo.minorVer = 0;
+        CHECK_FALSE(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+    }
+
+    SECTION("Other than 1.x")
+    {
+        ADUC_ExtensionContractInfo contractInfo{};
+        contractInfo.majorVer = 2;
+        contractInfo.minorVer = 1;
+        CHECK_FALSE(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+    }
+
+    SECTION("Is 1.1 or later")
+    {
+        ADUC_ExtensionContractInfo contractInfo{};
+        contractInfo.majorVer = 1;
+        contractInfo.minorVer = 1;
+        CHECK(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+
+        contractInfo.minorVer = 2;
+        CHECK(ADUC_ContractUtils_SupportsStepBatches(&contractInfo));
+    }
+}
@@ -23,6 +23,17 @@ EXTERN_C_BEGIN
 //
 
 #    define CRYPTO_UTILS_SIGNATURE_VALIDATION_ALG_RS256 "rs256"
+
+//
+// Provider Selection
+//
+
+bool CryptoUtils_SetProvider(const char* name);
+
+const char* CryptoUtils_GetProviderName(void);
+
+void CryptoUtils_ResetProvider(void);
+
 //
 // Signature Verification
 //
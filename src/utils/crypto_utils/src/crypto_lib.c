@@ -9,17 +9,24 @@
 #include "crypto_lib.h"
 #include "base64_utils.h"
 #include "root_key_util.h"
+#include <aduc/logging.h>
+#include <aduc/string_c_utils.h> // ADUC_StringFormat, IsNullOrEmpty
 #include <azure_c_shared_utility/azure_base64.h>
+#include <azure_c_shared_utility/crt_abstractions.h> // mallocAndStrcpy_s
 #include <ctype.h>
 #include <openssl/bn.h>
 #include <openssl/evp.h>
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 #    include <openssl/encoder.h>
 #    include <openssl/param_build.h>
+#    include <openssl/provider.h>
+#elif !defined(OPENSSL_NO_ENGINE)
+#    include <openssl/engine.h>
 #endif
 
 #include <openssl/rsa.h>
 #include <stdio.h>
+#include <stdlib.h> // free
 #include <string.h>
 
 #include <aducpal/strings.h> // strcasecmp
@@ -83,25 +90,183 @@ Algorithm_Id AlgorithmIdFromString(const char* alg)
     return algorithmId;
 }
 
+//
+// Provider Selection
+//
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
 /**
- * @brief Verifies the @p signature using RS256 on the @p blob and the @p key.
- * @details This RS256 implementation uses the RSA_PKCS1_PADDING type.
+ * @brief The configured provider, or NULL to use the default implementation.
+ */
+static OSSL_PROVIDER* s_provider = NULL;
+
+/**
+ * @brief The default provider, loaded along with the first configured provider and kept for the process lifetime.
+ * @details Loading a provider explicitly stops OpenSSL from loading the default one on demand, and unloading it
+ * again would leave no implementation at all.
+ */
+static OSSL_PROVIDER* s_defaultProvider = NULL;
+
+/**
+ * @brief The property query that prefers the configured provider, e.g. "?provider=caam", or NULL.
+ * @details A "?" query is a preference: algorithms the provider does not implement come from the default provider.
+ */
+static char* s_propertyQuery = NULL;
+
+/**
+ * @brief SHA256 fetched with s_propertyQuery, or NULL.
+ */
+static EVP_MD* s_sha256 = NULL;
+#else
+/**
+ * @brief The configured engine, or NULL to use the default implementation.
+ */
+static ENGINE* s_engine = NULL;
+#endif
+
+/**
+ * @brief The name of the configured provider or engine, or NULL.
+ */
+static char* s_providerName = NULL;
+
+/**
+ * @brief Selects the OpenSSL 3 provider, or with OpenSSL 1.1 the engine, for signature verification and key import.
+ * @details Algorithms the provider does not implement, and operations it fails to set up, fall back to the default
+ * implementation. Call it at startup, before any verification; it is not thread-safe.
+ * @param name the provider or engine name, e.g. "caam" or "pkcs11", or NULL or empty to use the default implementation
+ * @returns true on success, false if the provider cannot be loaded, in which case the default implementation is used
+ */
+bool CryptoUtils_SetProvider(const char* name)
+{
+    bool success = false;
+
+    CryptoUtils_ResetProvider();
+
+    if (IsNullOrEmpty(name))
+    {
+        return true;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (s_defaultProvider == NULL)
+    {
+        s_defaultProvider = OSSL_PROVIDER_load(NULL, "default");
+
+        if (s_defaultProvider == NULL)
+        {
+            goto done;
+        }
+    }
+
+    s_provider = OSSL_PROVIDER_load(NULL, name);
+
+    if (s_provider == NULL)
+    {
+        goto done;
+    }
+
+    s_propertyQuery = ADUC_StringFormat("?provider=%s", OSSL_PROVIDER_get0_name(s_provider));
+
+    if (s_propertyQuery == NULL)
+    {
+        goto done;
+    }
+
+    s_sha256 = EVP_MD_fetch(NULL, "SHA256", s_propertyQuery);
+
+    if (s_sha256 == NULL)
+    {
+        goto done;
+    }
+#elif !defined(OPENSSL_NO_ENGINE)
+    s_engine = ENGINE_by_id(name);
+
+    if (s_engine == NULL)
+    {
+        goto done;
+    }
+
+    if (ENGINE_init(s_engine) != 1)
+    {
+        ENGINE_free(s_engine);
+        s_engine = NULL;
+        goto done;
+    }
+#else
+    goto done;
+#endif
+
+    if (mallocAndStrcpy_s(&s_providerName, name) != 0)
+    {
+        goto done;
+    }
+
+    success = true;
+
+done:
+
+    if (!success)
+    {
+        CryptoUtils_ResetProvider();
+    }
+
+    return success;
+}
+
+/**
+ * @brief Gets the name of the provider or engine selected by CryptoUtils_SetProvider.
+ * @returns the name, or NULL if the default implementation is used
+ */
+const char* CryptoUtils_GetProviderName(void)
+{
+    return s_providerName;
+}
+
+/**
+ * @brief Releases the configured provider or engine and returns to the default implementation.
+ */
+void CryptoUtils_ResetProvider(void)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MD_free(s_sha256);
+    s_sha256 = NULL;
+
+    free(s_propertyQuery);
+    s_propertyQuery = NULL;
+
+    if (s_provider != NULL)
+    {
+        OSSL_PROVIDER_unload(s_provider);
+        s_provider = NULL;
+    }
+#elif !defined(OPENSSL_NO_ENGINE)
+    if (s_engine != NULL)
+    {
+        ENGINE_finish(s_engine);
+        ENGINE_free(s_engine);
+        s_engine = NULL;
+    }
+#endif
+
+    free(s_providerName);
+    s_providerName = NULL;
+}
+
+/**
+ * @brief Verifies the @p signature using RS256 on the @p blob and the @p key, with or without the configured provider.
  *
- * @param signature the expected signature to compare against the one computed from @p blob using RS256 and the @p key
- * @param sigLength the total length of the signature
- * @param blob the data for which the RS256 encoded hash will be computed from
- * @param blobLength the size of buffer @p blob
- * @param keyToSign the public key for the RS256 validation of the expected signature against blob
- * @returns True if @p signature equals the one computer from the blob and key using RS256, False otherwise
+ * @param useProvider whether to use the configured provider or engine instead of the default implementation
+ * @returns 1 if the signature is valid, 0 if it is invalid, and -1 if the verification could not be set up
  */
-bool VerifyRS256Signature(
+static int VerifyRS256SignatureWithProvider(
     const uint8_t* signature,
     const size_t sigLength,
     const uint8_t* blob,
     const size_t blobLength,
-    CryptoKeyHandle keyToSign)
+    CryptoKeyHandle keyToSign,
+    bool useProvider)
 {
-    bool success = false;
+    int verified = -1;
     EVP_MD_CTX* mdctx = NULL;
     EVP_PKEY_CTX* ctx = NULL;
 
@@ -113,11 +278,23 @@ bool VerifyRS256Signature(
         goto done;
     }
 
-    const EVP_MD* hash_alg = EVP_sha256();
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    const EVP_MD* hash_alg = (useProvider && s_sha256 != NULL) ? s_sha256 : EVP_sha256();
+    const char* propertyQuery = useProvider ? s_propertyQuery : NULL;
+
     if (EVP_DigestInit_ex(mdctx, hash_alg, NULL) != 1)
     {
         goto done;
     }
+#else
+    const EVP_MD* hash_alg = EVP_sha256();
+    ENGINE* engine = useProvider ? s_engine : NULL;
+
+    if (EVP_DigestInit_ex(mdctx, hash_alg, engine) != 1)
+    {
+        goto done;
+    }
+#endif
 
     if (EVP_DigestUpdate(mdctx, blob, blobLength) != 1)
     {
@@ -131,7 +308,11 @@ bool VerifyRS256Signature(
     }
 
     EVP_PKEY* pu_key = CryptoKeyHandleToEVP_PKEY(keyToSign);
-    ctx = EVP_PKEY_CTX_new(pu_key, NULL);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    ctx = EVP_PKEY_CTX_new_from_pkey(NULL, pu_key, propertyQuery);
+#else
+    ctx = EVP_PKEY_CTX_new(pu_key, engine);
+#endif
 
     if (ctx == NULL)
     {
@@ -153,10 +334,7 @@ bool VerifyRS256Signature(
         goto done;
     }
 
-    if (EVP_PKEY_verify(ctx, signature, sigLength, digest, digest_len) == 1)
-    {
-        success = true;
-    }
+    verified = EVP_PKEY_verify(ctx, signature, sigLength, digest, digest_len) == 1 ? 1 : 0;
 
 done:
 
@@ -170,7 +348,36 @@ done:
         EVP_PKEY_CTX_free(ctx);
     }
 
-    return success;
+    return verified;
+}
+
+/**
+ * @brief Verifies the @p signature using RS256 on the @p blob and the @p key.
+ * @details This RS256 implementation uses the RSA_PKCS1_PADDING type. It uses the provider selected by
+ * CryptoUtils_SetProvider, and falls back to the default implementation if the provider cannot set up the verification.
+ *
+ * @param signature the expected signature to compare against the one computed from @p blob using RS256 and the @p key
+ * @param sigLength the total length of the signature
+ * @param blob the data for which the RS256 encoded hash will be computed from
+ * @param blobLength the size of buffer @p blob
+ * @param keyToSign the public key for the RS256 validation of the expected signature against blob
+ * @returns True if @p signature equals the one computer from the blob and key using RS256, False otherwise
+ */
+bool VerifyRS256Signature(
+    const uint8_t* signature,
+    const size_t sigLength,
+    const uint8_t* blob,
+    const size_t blobLength,
+    CryptoKeyHandle keyToSign)
+{
+    int verified = VerifyRS256SignatureWithProvider(signature, sigLength, blob, blobLength, keyToSign, true);
+
+    if (verified < 0 && s_providerName != NULL)
+    {
+        verified = VerifyRS256SignatureWithProvider(signature, sigLength, blob, blobLength, keyToSign, false);
+    }
+
+    return verified == 1;
 }
 
 //
@@ -217,24 +424,66 @@ bool CryptoUtils_IsValidSignature(
     return result;
 }
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/**
+ * @brief Imports an RSA public key from @p params with the configured provider.
+ * @details Falls back to the default provider if the configured one cannot import the key.
+ * @param params the "n" and "e" parameters of the key
+ * @returns the key, or NULL on failure
+ */
+static EVP_PKEY* RsaPublicKeyFromParams(OSSL_PARAM* params)
+{
+    EVP_PKEY* result = NULL;
+    const char* propertyQueries[] = { s_propertyQuery, NULL };
+    const size_t queryCount = s_propertyQuery != NULL ? 2 : 1;
+
+    for (size_t i = 0; i < queryCount && result == NULL; ++i)
+    {
+        EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", propertyQueries[i]);
+
+        if (ctx != NULL && EVP_PKEY_fromdata_init(ctx) == 1)
+        {
+            if (EVP_PKEY_fromdata(ctx, &result, EVP_PKEY_PUBLIC_KEY, params) != 1)
+            {
+                result = NULL;
+            }
+        }
+
+        EVP_PKEY_CTX_free(ctx);
+    }
+
+    return result;
+}
+#else
+/**
+ * @brief Creates an RSA key with the configured engine.
+ * @details Falls back to the default implementation if the configured engine cannot create the key.
+ * @returns the key, or NULL on failure
+ */
+static RSA* RsaNewWithEngine(void)
+{
+    RSA* rsa = RSA_new_method(s_engine);
+
+    if (rsa == NULL && s_engine != NULL)
+    {
+        Log_Warn("Engine '%s' cannot create an RSA key. Using the default implementation.", s_providerName);
+        rsa = RSA_new();
+    }
+
+    return rsa;
+}
+#endif
+
 CryptoKeyHandle RSAKey_ObjFromModulusBytesExponentInt(const uint8_t* N, size_t N_len, const unsigned int e)
 {
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
     int status = 0;
     EVP_PKEY* result = NULL;
-    EVP_PKEY_CTX* ctx = NULL;
     OSSL_PARAM_BLD* param_bld = NULL;
     OSSL_PARAM* params = NULL;
     BIGNUM* bn_N = NULL;
     BIGNUM* bn_e = NULL;
 
-    ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL);
-
-    if (ctx == NULL)
-    {
-        goto done;
-    }
-
     bn_N = BN_new();
 
     if (bn_N == NULL)
@@ -290,24 +539,9 @@ CryptoKeyHandle RSAKey_ObjFromModulusBytesExponentInt(const uint8_t* N, size_t N
         goto done;
     }
 
-    status = EVP_PKEY_fromdata_init(ctx);
-    if (status != 1)
-    {
-        goto done;
-    }
-
-    status = EVP_PKEY_fromdata(ctx, &result, EVP_PKEY_PUBLIC_KEY, params);
-    if (status != 1)
-    {
-        goto done;
-    }
+    result = RsaPublicKeyFromParams(params);
 done:
 
-    if (ctx != NULL)
-    {
-        EVP_PKEY_CTX_free(ctx);
-    }
-
     if (param_bld != NULL)
     {
         OSSL_PARAM_BLD_free(param_bld);
@@ -343,7 +577,7 @@ done:
     BIGNUM* rsa_N = NULL;
     BIGNUM* rsa_e = NULL;
 
-    RSA* rsa = RSA_new();
+    RSA* rsa = RsaNewWithEngine();
 
     if (rsa == NULL)
     {
@@ -424,19 +658,11 @@ CryptoKeyHandle RSAKey_ObjFromBytes(const uint8_t* N, size_t N_len, const uint8_
 #if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
     int status = 0;
     EVP_PKEY* result = NULL;
-    EVP_PKEY_CTX* ctx = NULL;
     OSSL_PARAM_BLD* param_bld = NULL;
     OSSL_PARAM* params = NULL;
     BIGNUM* bn_N = NULL;
     BIGNUM* bn_e = NULL;
 
-    ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL);
-
-    if (ctx == NULL)
-    {
-        goto done;
-    }
-
     bn_N = BN_new();
 
     if (bn_N == NULL)
@@ -492,25 +718,10 @@ CryptoKeyHandle RSAKey_ObjFromBytes(const uint8_t* N, size_t N_len, const uint8_
         goto done;
     }
 
-    status = EVP_PKEY_fromdata_init(ctx);
-    if (status != 1)
-    {
-        goto done;
-    }
-
-    status = EVP_PKEY_fromdata(ctx, &result, EVP_PKEY_PUBLIC_KEY, params);
-    if (status != 1)
-    {
-        goto done;
-    }
+    result = RsaPublicKeyFromParams(params);
 
 done:
 
-    if (ctx != NULL)
-    {
-        EVP_PKEY_CTX_free(ctx);
-    }
-
     if (param_bld != NULL)
     {
         OSSL_PARAM_BLD_free(param_bld);
@@ -545,7 +756,7 @@ done:
     BIGNUM* rsa_N = NULL;
     BIGNUM* rsa_e = NULL;
 
-    RSA* rsa = RSA_new();
+    RSA* rsa = RsaNewWithEngine();
 
     if (rsa == NULL)
     {
@@ -620,19 +831,11 @@ CryptoKeyHandle RSAKey_ObjFromStrings(const char* N, const char* e)
 #if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
     int status = 0;
     EVP_PKEY* result = NULL;
-    EVP_PKEY_CTX* ctx = NULL;
     OSSL_PARAM_BLD* param_bld = NULL;
     OSSL_PARAM* params = NULL;
     BIGNUM* bn_N = NULL;
     BIGNUM* bn_e = NULL;
 
-    ctx = EVP_PKEY_CTX_new_from_name(NULL, "RSA", NULL);
-
-    if (ctx == NULL)
-    {
-        goto done;
-    }
-
     bn_N = BN_new();
     if (bn_N == NULL)
     {
@@ -685,25 +888,10 @@ CryptoKeyHandle RSAKey_ObjFromStrings(const char* N, const char* e)
         goto done;
     }
 
-    status = EVP_PKEY_fromdata_init(ctx);
-    if (status != 1)
-    {
-        goto done;
-    }
-
-    status = EVP_PKEY_fromdata(ctx, &result, EVP_PKEY_PUBLIC_KEY, params);
-    if (status != 1)
-    {
-        goto done;
-    }
+    result = RsaPublicKeyFromParams(params);
 
 done:
 
-    if (ctx != NULL)
-    {
-        EVP_PKEY_CTX_free(ctx);
-    }
-
     if (param_bld != NULL)
     {
         OSSL_PARAM_BLD_free(param_bld);
@@ -737,7 +925,7 @@ done:
     BIGNUM* M = NULL;
     BIGNUM* E = NULL;
 
-    RSA* rsa = RSA_new();
+    RSA* rsa = RsaNewWithEngine();
     if (rsa == NULL)
     {
         goto done;
@@ -12,7 +12,10 @@
 #include <aduc/calloc_wrapper.hpp>
 #include <array>
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdlib> // getenv
 #include <cstring>
+#include <string>
 
 TEST_CASE("Base64 Encoding")
 {
@@ -168,3 +171,139 @@ TEST_CASE("Signature Verification")
             key));
     }
 }
+
+// A JWS signed with the ADU.200702.R root key.
+static const char* const signedBlob = "eyJhbGciOiJSUzI1NiIsImtpZCI6IkFEVS4yMDA3MDIuUiJ9.eyJrdHkiOiJSU"
+                                      "0EiLCJuIjoickhWQkVGS1IxdnNoZytBaElnL1NEUU8zeDRrajNDVVQ3ZkduSmh"
+                                      "BbXVEaHZIZmozZ0h6aTBUMklBcUMxeDJCQ1dkT281djh0dW1xUmovbllwZzk3a"
+                                      "mpQQ0t1Y2RPNm0zN2RjT21hNDZoN08wa0hwd0wzblVIR0VySjVEQS9hcFlud0V"
+                                      "lc2V4VGpUOFNwLytiVHFXRW16Z0QzN3BmZEthcWp0SExHVmlZd1ZIUHp0QmFid"
+                                      "3dqaEF2enlSWS95OU9mbXpEZlhtclkxcm8vKzJoRXFFeWt1andRRVlraGpKYSt"
+                                      "CNDc2KzBtdUd5V0k1ZUl2L29sdDJSZVh4TWI5TWxsWE55b1AzYU5LSUppYlpNc"
+                                      "zd1S2Npd2t5aVVJYVljTWpzOWkvUkV5K2xNOXZJWnFyZnBDVVh1M3RuMUtnYzJ"
+                                      "Rcy9UZDh0TlRDR1Y2d3RWYXFpSXBUZFQ0UnJDZE1vTzVTTmVmZkR5YzJsQzd1O"
+                                      "DUrb21Ua2NqUGptNmZhcGRJeUYycWVtdlNCRGZCN2NhajVESUkyNVd3NUVKY2F"
+                                      "2ZnlQNTRtcU5RUTNHY01RYjJkZ2hpY2xwallvKzQzWmdZQ2RHdGFaZDJFZkxad"
+                                      "0gzUWcyckRsZmsvaWEwLzF5cWlrL1haMW5zWlRpMEJjNUNwT01FcWZOSkZRazN"
+                                      "CV29BMDVyQ1oiLCJlIjoiQVFBQiIsImFsZyI6IlJTMjU2Iiwia2lkIjoiQURVL"
+                                      "jIwMDcwMi5SLlMifQ";
+
+static const char* const validSignature = "iSTgAEBXsd7AANkQMkaG-FAV6QOGUEuxuHg2YfSuWhtY"
+                                          "XqbpM-jI5RVLKesSLCehK-lRC9x6-_LeyxNh1DOFc-Fa6oCEGwUj8ziOF_AT6s"
+                                          "6EOmckqPrxuvCWtyYkkDRF74dtaK1jNA7SdXrZzvWCsMqOUMNz0gCoVR0Cs125"
+                                          "4kFMRmRPVfEcjgT7j4lCpyDuWgr9SenSeqgKLYxjaaG0sRh9cdi2dKrwgaNaqA"
+                                          "bHmCrrhxSPCTBzWMExZrLYzudEofyYHiVVRhSJpj0OQ18ecu4DPXV1Tct1y3k7"
+                                          "LLio7n8izKuq2m3TxF9vPdqb9NP6Sc9-myaptpbFpHeFkUL-F5ytl_UBFKpwN9"
+                                          "CL4wp6yZ-jdXNagrmU_qL1CyXw1omNCgTmJF3Gd3lyqKHHDerDs-MRpmKjwSwp"
+                                          "ZCQJGDRcRovWyL12vjw3LBJMhmUxsEdBaZP5wGdsfD8ldKYFVFEcZ0orMNrUkS"
+                                          "MAl6pIxtefEXiy5lqmiPzq_LJ1eRIrqY0_";
+
+// Note: Signature has been garbled to create an invalid signature
+static const char* const invalidSignature = "asdgAEBXsd7AANkQMkaG-FAV6QOGUEuxuHg2YfSuWhtY"
+                                            "XqbpM-jI5RVLKesSLCehK-lRC9x6-_LeyxNh1DOFc-Fa6oCEGwUj8ziOF_AT6s"
+                                            "6EOmckqPrxuvCWtyYkkDRF74dtaK1jNA7SdXrZzvWCsMqOUMNz0gCoVR0Cs125"
+                                            "4kFMRmRPVfEcjgT7j4lCpyDuWgr9SenSeqgKLYxjaaG0sRh9cdi2dKrwgaNaqA"
+                                            "bHmCrrhxSPCTBzWMExZrLYzudEofyYHiVVRhSJpj0OQ18ecu4DPXV1Tct1y3k7"
+                                            "LLio7n8izKuq2m3TxF9vPdqb9NP6Sc9-myaptpbFpHeFkUL-F5ytl_UBFKpwN9"
+                                            "CL4wp6yZ-jdXNagrmU_qL1CyXw1omNCgTmJF3Gd3lyqKHHDerDs-MRpmKjwSwp"
+                                            "ZCQJGDRcRovWyL12vjw3LBJMhmUxsEdBaZP5wGdsfD8ldKYFVFEcZ0orMNrUkS"
+                                            "MAl6pIxtefEXiy5lqmiPzq_LJ1eRIrqY0_";
+
+/**
+ * @brief Verifies @p signature of signedBlob with the hardcoded ADU.200702.R root key.
+ */
+static bool IsValidTestSignature(const char* signature)
+{
+    CryptoKeyHandle key = nullptr;
+
+    ADUC_Result result = RootKeyUtility_GetKeyForKidFromHardcodedKeys(&key, "ADU.200702.R");
+
+    REQUIRE(IsAducResultCodeSuccess(result.ResultCode));
+    REQUIRE(key != nullptr);
+
+    ADUC::StringUtils::calloc_wrapper<uint8_t> d_sig_handle;
+    size_t sig_len = Base64URLDecode(signature, d_sig_handle.address_of());
+
+    bool valid = CryptoUtils_IsValidSignature(
+        CRYPTO_UTILS_SIGNATURE_VALIDATION_ALG_RS256,
+        d_sig_handle.get(),
+        sig_len,
+        reinterpret_cast<const uint8_t*>(signedBlob), // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        strlen(signedBlob),
+        key);
+
+    CryptoUtils_FreeCryptoKeyHandle(key);
+    return valid;
+}
+
+TEST_CASE("Crypto Provider")
+{
+    SECTION("Verifying with the default provider")
+    {
+        REQUIRE(CryptoUtils_SetProvider("default"));
+        CHECK(strcmp(CryptoUtils_GetProviderName(), "default") == 0);
+
+        CHECK(IsValidTestSignature(validSignature));
+        CHECK(!IsValidTestSignature(invalidSignature));
+
+        CryptoUtils_ResetProvider();
+        CHECK(CryptoUtils_GetProviderName() == nullptr);
+        CHECK(IsValidTestSignature(validSignature));
+    }
+
+    SECTION("Falling back from an unknown provider")
+    {
+        CHECK_FALSE(CryptoUtils_SetProvider("no-such-provider"));
+        CHECK(CryptoUtils_GetProviderName() == nullptr);
+
+        CHECK(IsValidTestSignature(validSignature));
+        CHECK(!IsValidTestSignature(invalidSignature));
+    }
+
+    SECTION("Selecting no provider")
+    {
+        CHECK(CryptoUtils_SetProvider(""));
+        CHECK(CryptoUtils_GetProviderName() == nullptr);
+        CHECK(CryptoUtils_SetProvider(nullptr));
+        CHECK(CryptoUtils_GetProviderName() == nullptr);
+    }
+
+    CryptoUtils_ResetProvider();
+}
+
+/**
+ * @brief Times root key import and signature verification with the default implementation and with a provider.
+ *
+ * Hidden, run it with: crypto_utils_unit_test "[benchmark]"
+ * DU_CRYPTO_BENCHMARK_PROVIDER sets the provider or engine (default "default"), and
+ * DU_CRYPTO_BENCHMARK_ITERATIONS the number of verifications (default 1000).
+ */
+TEST_CASE("Crypto Provider - verification benchmark", "[.][benchmark]")
+{
+    const char* providerEnv = getenv("DU_CRYPTO_BENCHMARK_PROVIDER");
+    const char* iterationsEnv = getenv("DU_CRYPTO_BENCHMARK_ITERATIONS");
+    const char* provider = providerEnv != nullptr ? providerEnv : "default";
+    const unsigned long iterations = iterationsEnv != nullptr ? std::stoul(iterationsEnv) : 1000;
+
+    const auto timeVerifications = [iterations]() {
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < iterations; ++i)
+        {
+            REQUIRE(IsValidTestSignature(validSignature));
+        }
+
+        return std::chrono::duration<double, std::micro>{ std::chrono::steady_clock::now() - start }.count()
+            / static_cast<double>(iterations);
+    };
+
+    CryptoUtils_ResetProvider();
+    const double defaultMicroseconds = timeVerifications();
+
+    REQUIRE(CryptoUtils_SetProvider(provider));
+    const double providerMicroseconds = timeVerifications();
+    CryptoUtils_ResetProvider();
+
+    WARN(
+        "Verifications: " << iterations << ", default: " << defaultMicroseconds << " us, " << provider << ": "
+                          << providerMicroseconds << " us, speedup: " << defaultMicroseconds / providerMicroseconds);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file curl_download_utils.hpp
+ * @brief Downloads from the origin URL with curl, for the content downloaders.
+ *
+ * Every transfer of a Downloader gets the download settings of du-config.json: the HTTP version of the
+ * "downloadTransport" policy, with a fallback for a curl without HTTP/3, the persisted TLS sessions of
+ * "tlsSessionCache", the addresses of the "dnsCache", and the pacing of the download governor.
+ *
+ * Transfers run the curl command, which opens its own sockets. With a "socketTuning" profile they run in the
+ * agent through libcurl instead, which applies the profile to every socket before it connects and calibrates
+ * from the first large transfer. The libcurl handle is kept across transfers, so its connections and TLS
+ * sessions are reused in place of the session files of "tlsSessionCache".
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_CURL_DOWNLOAD_UTILS_HPP
+#define ADUC_CURL_DOWNLOAD_UTILS_HPP
+
+#include <aduc/config_utils.h>
+#include <aduc/dns_cache_utils.h>
+#include <aduc/download_transport_utils.h>
+#include <aduc/socket_tuning_utils.h>
+#include <aduc/tls_session_cache_utils.h>
+
+#include <curl/curl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ADUC
+{
+namespace CurlDownload
+{
+/**
+ * @brief The curl options of one transfer that come from the download settings.
+ */
+struct TransferSettings
+{
+    const char* httpOption = nullptr; /**< The option that selects the HTTP version, or nullptr. */
+    const char* sessionFile = nullptr; /**< The TLS session file of the endpoint, or nullptr. */
+    const char* resolve = nullptr; /**< The --resolve value of the host, or nullptr. */
+};
+
+/**
+ * @brief Builds the curl arguments of a transfer, without the command.
+ *
+ * @param uri The URI to download.
+ * @param outputPath The target file, or "-" for stdout.
+ * @param settings The options from the download settings.
+ * @param extraArgs Options of the caller, e.g. a range.
+ * @return std::vector<std::string> The arguments.
+ */
+std::vector<std::string> BuildArgs(
+    const char* uri,
+    const std::string& outputPath,
+    const TransferSettings& settings,
+    const std::vector<std::string>& extraArgs);
+
+/**
+ * @brief Frees a DNS cache.
+ */
+struct DnsCacheDeleter
+{
+    void operator()(ADUC_DnsCache* cache) const
+    {
+        ADUC_DnsCache_Destroy(cache);
+    }
+};
+
+/**
+ * @brief Frees a libcurl handle.
+ */
+struct CurlEasyDeleter
+{
+    void operator()(CURL* curl) const
+    {
+        curl_easy_cleanup(curl);
+    }
+};
+
+/**
+ * @brief Downloads with curl and the download settings of du-config.json.
+ * @details A content downloader keeps one instance for the lifetime of the extension. Destroying it stops the
+ * DNS cache refresh thread, so it must be destroyed before the extension is unloaded.
+ */
+class Downloader
+{
+public:
+    Downloader();
+    ~Downloader();
+
+    Downloader(const Downloader&) = delete;
+    Downloader& operator=(const Downloader&) = delete;
+    Downloader(Downloader&&) = delete;
+    Downloader& operator=(Downloader&&) = delete;
+
+    /**
+     * @brief Reads the download settings from @p config. The DNS cache is only created once.
+     *
+     * @param config The agent configuration.
+     */
+    void Initialize(const ADUC_ConfigInfo* config);
+
+    /**
+     * @brief Downloads @p uri to @p filePath.
+     *
+     * @param uri The URI to download.
+     * @param filePath The target file path.
+     * @param range The byte range "first-last" to download, or nullptr for the whole file. A range download
+     * fails on an HTTP error status.
+     * @param[out] output The output of curl. Not captured in a throttled or in-process download.
+     * @return int The curl exit code, or -1 on a local failure.
+     */
+    int Download(const char* uri, const std::string& filePath, const char* range, std::string& output);
+
+private:
+    int Launch(
+        const char* uri,
+        const std::string& filePath,
+        ADUC_HttpVersion httpVersion,
+        const char* range,
+        std::string& output);
+
+    int TransferInProcess(
+        const char* uri,
+        const std::string& filePath,
+        ADUC_HttpVersion httpVersion,
+        const char* resolve,
+        const char* range);
+
+    ADUC_DownloadTransport_Policy _transportPolicy; /**< The HTTP version policy. */
+    ADUC_SocketTuning_Profile _tuningProfile; /**< The tuning profile. If enabled, transfers run in-process. */
+    ADUC_SocketTuning_Calibration _calibration; /**< The receive buffer calibrated from the first transfer. */
+    ADUC_TlsSessionCache _tlsSessionCache; /**< The persisted TLS sessions. Closed if not configured. */
+    std::unique_ptr<ADUC_DnsCache, DnsCacheDeleter> _dnsCache; /**< The DNS cache, or nullptr. */
+    std::unique_ptr<CURL, CurlEasyDeleter> _curl; /**< The libcurl handle of in-process transfers, or nullptr. */
+    std::mutex _curlMutex; /**< Guards _curl and _calibration. */
+};
+
+} // namespace CurlDownload
+} // namespace ADUC
+
+#endif // ADUC_CURL_DOWNLOAD_UTILS_HPP
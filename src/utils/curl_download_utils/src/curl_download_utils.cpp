@@ -0,0 +1,580 @@
+/**
+ * @file curl_download_utils.cpp
+ * @brief Implements the downloads with the curl command, or in-process with libcurl.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/curl_download_utils.hpp"
+#include "aduc/download_governor_utils.h" // for ADUC_DownloadGovernor_IsEnabled, ADUC_DownloadGovernor_Throttle
+#include "aduc/logging.h"
+#include "aduc/process_utils.hpp" // for ADUC_LaunchChildProcess
+#include "aduc/socket_tuning_utils.h" // for ADUC_SocketTuning_ParseProfile, ADUC_SocketTuning_Apply
+
+#include <cstring> // for memset
+#include <errno.h>
+#include <fcntl.h> // for open
+#include <limits.h> // for PATH_MAX
+#include <signal.h> // for kill
+#include <sys/socket.h> // for getsockopt
+#include <sys/wait.h> // for waitpid
+#include <unistd.h> // for fork, pipe, execv
+
+// keep this last to minimize chance to interfere with system header includes.
+#include "aduc/aduc_banned.h"
+
+namespace
+{
+/**
+ * @brief The curl command.
+ */
+const char* const CURL_COMMAND = "/usr/bin/curl";
+
+/**
+ * @brief Size of the chunks read from curl in a throttled download.
+ */
+const size_t THROTTLED_DOWNLOAD_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * @brief The curl exit codes of a curl that does not support a requested HTTP version:
+ * CURLE_UNSUPPORTED_PROTOCOL and CURLE_FAILED_INIT.
+ */
+const int CURL_EXIT_UNSUPPORTED_PROTOCOL = 1;
+const int CURL_EXIT_FAILED_INIT = 2;
+
+/**
+ * @brief The curl exit code of an option that curl knows, but was built without: CURLE_NOT_BUILT_IN.
+ */
+const int CURL_EXIT_NOT_BUILT_IN = 4;
+
+/**
+ * @brief The libcurl HTTP versions of the download transport policy, for in-process transfers.
+ */
+const struct
+{
+    ADUC_HttpVersion httpVersion;
+    long curlHttpVersion;
+} CURL_HTTP_VERSIONS[] = {
+    { ADUC_HttpVersion_Http1_1, CURL_HTTP_VERSION_1_1 },
+    { ADUC_HttpVersion_Http2, CURL_HTTP_VERSION_2_0 },
+    { ADUC_HttpVersion_Http3, CURL_HTTP_VERSION_3 },
+#if LIBCURL_VERSION_NUM >= 0x075800
+    { ADUC_HttpVersion_Http3Only, CURL_HTTP_VERSION_3ONLY },
+#else
+    { ADUC_HttpVersion_Http3Only, CURL_HTTP_VERSION_3 },
+#endif
+};
+
+/**
+ * @brief The state of an in-process transfer, for the libcurl callbacks.
+ */
+struct InProcessTransfer
+{
+    int fd = -1; /**< The target file. */
+    const ADUC_SocketTuning_Profile* profile = nullptr; /**< The tuning profile. */
+    const ADUC_SocketTuning_Calibration* calibration = nullptr; /**< The calibration, for new connections. */
+};
+
+/**
+ * @brief Writes all of @p size bytes of @p buffer to @p fd.
+ */
+bool WriteAll(int fd, const char* buffer, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t written = write(fd, buffer, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        buffer += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Runs curl with @p args writing to a pipe, and paces the reads from the pipe with the download
+ * governor. Once the pipe is full, curl stops reading from the socket, so the TCP window closes and the
+ * server is slowed down to the configured rate.
+ *
+ * @param args The curl arguments, with "-" as output.
+ * @param filePath The target file path.
+ * @return int The curl exit code, or -1 on a local failure.
+ */
+int LaunchThrottledCurl(const std::vector<std::string>& args, const std::string& filePath)
+{
+    int exitCode = -1;
+    int pipeFds[2] = { -1, -1 };
+    int fileFd = -1;
+    pid_t pid = -1;
+    bool transferFailed = false;
+    std::vector<char> buffer(THROTTLED_DOWNLOAD_CHUNK_SIZE);
+    std::vector<const char*> argv{ CURL_COMMAND };
+
+    for (const std::string& arg : args)
+    {
+        argv.push_back(arg.c_str());
+    }
+
+    argv.push_back(nullptr);
+
+    fileFd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fileFd == -1)
+    {
+        Log_Error("Cannot open '%s', errno: %d", filePath.c_str(), errno);
+        goto done;
+    }
+
+    if (pipe2(pipeFds, O_CLOEXEC) != 0)
+    {
+        Log_Error("Cannot create pipe, errno: %d", errno);
+        goto done;
+    }
+
+    pid = fork();
+    if (pid == -1)
+    {
+        Log_Error("Cannot fork, errno: %d", errno);
+        goto done;
+    }
+
+    if (pid == 0)
+    {
+        // Child: curl writes the content to stdout, which is the write end of the pipe.
+        if (dup2(pipeFds[1], STDOUT_FILENO) == -1)
+        {
+            _exit(EXIT_FAILURE);
+        }
+
+        execv(argv[0], const_cast<char* const*>(argv.data()));
+        _exit(EXIT_FAILURE);
+    }
+
+    close(pipeFds[1]);
+    pipeFds[1] = -1;
+
+    for (;;)
+    {
+        const ssize_t readSize = read(pipeFds[0], buffer.data(), buffer.size());
+        if (readSize == 0)
+        {
+            break;
+        }
+
+        if (readSize < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            Log_Error("Failed to read from curl, errno: %d", errno);
+            transferFailed = true;
+            break;
+        }
+
+        if (!WriteAll(fileFd, buffer.data(), static_cast<size_t>(readSize)))
+        {
+            Log_Error("Failed to write '%s', errno: %d", filePath.c_str(), errno);
+            transferFailed = true;
+            break;
+        }
+
+        ADUC_DownloadGovernor_Throttle(static_cast<size_t>(readSize));
+    }
+
+    if (transferFailed)
+    {
+        kill(pid, SIGTERM);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1)
+    {
+        if (errno != EINTR)
+        {
+            Log_Error("waitpid failed, errno: %d", errno);
+            goto done;
+        }
+    }
+
+    if (!transferFailed)
+    {
+        exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+
+done:
+    if (pipeFds[0] != -1)
+    {
+        close(pipeFds[0]);
+    }
+
+    if (pipeFds[1] != -1)
+    {
+        close(pipeFds[1]);
+    }
+
+    if (fileFd != -1 && close(fileFd) != 0 && exitCode == 0)
+    {
+        Log_Error("Failed to close '%s', errno: %d", filePath.c_str(), errno);
+        exitCode = -1;
+    }
+
+    return exitCode;
+}
+
+/**
+ * @brief The libcurl write callback of an in-process transfer. Writes the content to the target file, paced by
+ * the download governor. While it waits, libcurl does not read from the socket, so the TCP window closes as with
+ * a throttled curl command.
+ */
+size_t WriteContent(char* data, size_t size, size_t count, void* userData)
+{
+    const auto* transfer = static_cast<const InProcessTransfer*>(userData);
+    const size_t length = size * count;
+
+    if (!WriteAll(transfer->fd, data, length))
+    {
+        Log_Error("Failed to write the download, errno: %d", errno);
+        return 0;
+    }
+
+    ADUC_DownloadGovernor_Throttle(length);
+    return length;
+}
+
+/**
+ * @brief The libcurl socket option callback of an in-process transfer. Applies the tuning profile to a TCP
+ * socket before it connects. The UDP sockets of HTTP/3 are left alone.
+ */
+int ApplySocketTuning(void* userData, curl_socket_t fd, curlsocktype purpose)
+{
+    const auto* transfer = static_cast<const InProcessTransfer*>(userData);
+    int type = 0;
+    socklen_t typeLength = sizeof(type);
+
+    if (purpose == CURLSOCKTYPE_IPCXN && getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength) == 0
+        && type == SOCK_STREAM)
+    {
+        ADUC_SocketTuning_Apply(transfer->profile, transfer->calibration, fd);
+    }
+
+    return CURL_SOCKOPT_OK;
+}
+
+/**
+ * @brief Runs one curl transfer of @p uri to @p filePath, paced by the download governor if it is enabled.
+ *
+ * @return int The curl exit code, or -1 on a local failure.
+ */
+int Transfer(
+    const char* uri,
+    const std::string& filePath,
+    const ADUC::CurlDownload::TransferSettings& settings,
+    const std::vector<std::string>& extraArgs,
+    std::string& output)
+{
+    if (ADUC_DownloadGovernor_IsEnabled())
+    {
+        std::vector<std::string> throttledArgs{ "-sS" };
+        throttledArgs.insert(throttledArgs.end(), extraArgs.begin(), extraArgs.end());
+
+        return LaunchThrottledCurl(ADUC::CurlDownload::BuildArgs(uri, "-", settings, throttledArgs), filePath);
+    }
+
+    return ADUC_LaunchChildProcess(
+        CURL_COMMAND, ADUC::CurlDownload::BuildArgs(uri, filePath, settings, extraArgs), output);
+}
+
+} // namespace
+
+namespace ADUC
+{
+namespace CurlDownload
+{
+std::vector<std::string> BuildArgs(
+    const char* uri,
+    const std::string& outputPath,
+    const TransferSettings& settings,
+    const std::vector<std::string>& extraArgs)
+{
+    std::vector<std::string> args{ extraArgs };
+
+    if (settings.httpOption != nullptr)
+    {
+        args.emplace_back(settings.httpOption);
+    }
+
+    if (settings.sessionFile != nullptr)
+    {
+        args.emplace_back("--ssl-sessions");
+        args.emplace_back(settings.sessionFile);
+    }
+
+    if (settings.resolve != nullptr)
+    {
+        args.emplace_back("--resolve");
+        args.emplace_back(settings.resolve);
+    }
+
+    args.emplace_back("-o");
+    args.emplace_back(outputPath);
+    args.emplace_back(uri);
+
+    return args;
+}
+
+Downloader::Downloader()
+{
+    memset(&_transportPolicy, 0, sizeof(_transportPolicy));
+    memset(&_tuningProfile, 0, sizeof(_tuningProfile));
+    memset(&_calibration, 0, sizeof(_calibration));
+    memset(&_tlsSessionCache, 0, sizeof(_tlsSessionCache));
+}
+
+Downloader::~Downloader()
+{
+    ADUC_TlsSessionCache_Close(&_tlsSessionCache);
+}
+
+void Downloader::Initialize(const ADUC_ConfigInfo* config)
+{
+    ADUC_DownloadTransport_ParsePolicy(&_transportPolicy, config->downloadTransport);
+
+    // The curl command opens its own sockets, so the tuning profile needs the transfers to run in-process.
+    ADUC_SocketTuning_ParseProfile(&_tuningProfile, config->socketTuning);
+    if (_tuningProfile.enabled)
+    {
+        std::lock_guard<std::mutex> lock{ _curlMutex };
+        if (_curl == nullptr)
+        {
+            _curl.reset(curl_easy_init());
+        }
+
+        if (_curl == nullptr)
+        {
+            Log_Error("Cannot create a libcurl handle. Downloads from the origin are not tuned.");
+            _tuningProfile.enabled = false;
+        }
+    }
+
+    ADUC_TlsSessionCache_Policy sessionCachePolicy;
+    ADUC_TlsSessionCache_Close(&_tlsSessionCache);
+    if (ADUC_TlsSessionCache_ParsePolicy(&sessionCachePolicy, config->tlsSessionCache) && sessionCachePolicy.enabled)
+    {
+        if (_tuningProfile.enabled)
+        {
+            Log_Info("tlsSessionCache: with socketTuning, TLS sessions are reused by the in-process transfers and "
+                     "are not persisted.");
+        }
+        else
+        {
+            std::string curlVersion;
+            ADUC_LaunchChildProcess(CURL_COMMAND, { "--version" }, curlVersion);
+            ADUC_TlsSessionCache_OpenForCurl(
+                &_tlsSessionCache, &sessionCachePolicy, config->dataFolder, curlVersion.c_str());
+        }
+    }
+
+    ADUC_DnsCache_Config dnsCacheConfig;
+    if (_dnsCache == nullptr && ADUC_DnsCache_ParseConfig(&dnsCacheConfig, config->dnsCache) && dnsCacheConfig.enabled
+        && config->dataFolder != nullptr)
+    {
+        const std::string persistFile = std::string{ config->dataFolder } + "/" + ADUC_DNS_CACHE_FILE_NAME;
+        _dnsCache.reset(ADUC_DnsCache_Create(&dnsCacheConfig, persistFile.c_str()));
+    }
+}
+
+int Downloader::Download(const char* uri, const std::string& filePath, const char* range, std::string& output)
+{
+    const ADUC_HttpVersion httpVersion = ADUC_DownloadTransport_GetHttpVersion(&_transportPolicy, uri);
+
+    int exitCode = Launch(uri, filePath, httpVersion, range, output);
+
+    // curl falls back from QUIC to TCP by itself, but a curl built without HTTP/3 rejects the option.
+    if (httpVersion == ADUC_HttpVersion_Http3
+        && (exitCode == CURL_EXIT_UNSUPPORTED_PROTOCOL || exitCode == CURL_EXIT_FAILED_INIT))
+    {
+        Log_Warn("curl does not support HTTP/3, exit code: %d. Downloading with the default HTTP version.", exitCode);
+        output.clear();
+        exitCode = Launch(uri, filePath, ADUC_HttpVersion_Default, range, output);
+    }
+
+    return exitCode;
+}
+
+/**
+ * @brief Downloads @p uri to @p filePath, paced by the download governor if it is enabled. The host is resolved
+ * by the DNS cache, if it is configured. With a tuning profile the transfer runs in-process. Otherwise curl runs,
+ * and the TLS session of the endpoint is resumed from and stored to the TLS session cache, if it is open. If
+ * curl rejects --ssl-sessions, the transfer is retried without it, and the TLS session cache is closed.
+ */
+int Downloader::Launch(
+    const char* uri, const std::string& filePath, ADUC_HttpVersion httpVersion, const char* range, std::string& output)
+{
+    int exitCode = -1;
+    char sessionFilePath[PATH_MAX];
+    char resolveValue[ADUC_DNS_CACHE_MAX_CURL_RESOLVE];
+    TransferSettings settings;
+    std::vector<std::string> extraArgs;
+
+    settings.resolve = ADUC_DnsCache_GetCurlResolve(_dnsCache.get(), uri, resolveValue, sizeof(resolveValue))
+        ? resolveValue
+        : nullptr;
+
+    if (_tuningProfile.enabled)
+    {
+        return TransferInProcess(uri, filePath, httpVersion, settings.resolve, range);
+    }
+
+    if (range != nullptr)
+    {
+        extraArgs = { "-sS", "-f", "-r", range };
+    }
+
+    settings.httpOption = ADUC_DownloadTransport_GetCurlOption(httpVersion);
+    settings.sessionFile =
+        ADUC_TlsSessionCache_GetSessionFile(&_tlsSessionCache, uri, sessionFilePath, sizeof(sessionFilePath))
+        ? sessionFilePath
+        : nullptr;
+
+    exitCode = Transfer(uri, filePath, settings, extraArgs, output);
+
+    if (settings.sessionFile == nullptr)
+    {
+        return exitCode;
+    }
+
+    ADUC_TlsSessionCache_FinishTransfer(&_tlsSessionCache, settings.sessionFile, exitCode);
+
+    // `curl --version` can list session export while curl still rejects the option, e.g. with another libcurl.
+    if (exitCode == CURL_EXIT_FAILED_INIT || exitCode == CURL_EXIT_NOT_BUILT_IN)
+    {
+        settings.sessionFile = nullptr;
+        output.clear();
+
+        const int retryExitCode = Transfer(uri, filePath, settings, extraArgs, output);
+        if (retryExitCode != exitCode)
+        {
+            Log_Warn("curl rejected --ssl-sessions, exit code: %d. TLS sessions are not cached.", exitCode);
+            ADUC_TlsSessionCache_Close(&_tlsSessionCache);
+        }
+
+        exitCode = retryExitCode;
+    }
+
+    return exitCode;
+}
+
+/**
+ * @brief Downloads @p uri to @p filePath with the libcurl handle of the downloader. The tuning profile is applied
+ * to every new connection, and the first transfer large enough calibrates the receive buffer of later ones.
+ *
+ * @return int The libcurl result, which matches the curl exit code, or -1 on a local failure.
+ */
+int Downloader::TransferInProcess(
+    const char* uri,
+    const std::string& filePath,
+    ADUC_HttpVersion httpVersion,
+    const char* resolve,
+    const char* range)
+{
+    int exitCode = -1;
+    CURL* curl = nullptr;
+    CURLcode result = CURLE_OK;
+    curl_slist* resolveList = nullptr;
+    curl_socket_t fd = CURL_SOCKET_BAD;
+    curl_off_t bytes = 0;
+    curl_off_t totalMicroseconds = 0;
+    curl_off_t pretransferMicroseconds = 0;
+    InProcessTransfer transfer;
+    std::lock_guard<std::mutex> lock{ _curlMutex };
+
+    transfer.profile = &_tuningProfile;
+    transfer.calibration = &_calibration;
+
+    // Reset the options of the previous transfer. The connections and TLS sessions stay for reuse.
+    curl = _curl.get();
+    curl_easy_reset(curl);
+
+    transfer.fd = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (transfer.fd == -1)
+    {
+        Log_Error("Cannot open '%s', errno: %d", filePath.c_str(), errno);
+        goto done;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, uri);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteContent);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, ApplySocketTuning);
+    curl_easy_setopt(curl, CURLOPT_SOCKOPTDATA, &transfer);
+
+    if (range != nullptr)
+    {
+        curl_easy_setopt(curl, CURLOPT_RANGE, range);
+        curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    }
+
+    if (resolve != nullptr)
+    {
+        resolveList = curl_slist_append(nullptr, resolve);
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, resolveList);
+    }
+
+    for (const auto& version : CURL_HTTP_VERSIONS)
+    {
+        if (version.httpVersion == httpVersion)
+        {
+            // Fails with CURLE_UNSUPPORTED_PROTOCOL if libcurl is built without HTTP/3, as the curl command does.
+            result = curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, version.curlHttpVersion);
+        }
+    }
+
+    if (result == CURLE_OK)
+    {
+        result = curl_easy_perform(curl);
+    }
+
+    exitCode = static_cast<int>(result);
+
+    if (result == CURLE_OK && curl_easy_getinfo(curl, CURLINFO_ACTIVESOCKET, &fd) == CURLE_OK
+        && fd != CURL_SOCKET_BAD && curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes) == CURLE_OK
+        && curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &totalMicroseconds) == CURLE_OK
+        && curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransferMicroseconds) == CURLE_OK)
+    {
+        ADUC_SocketTuning_Calibrate(
+            &_tuningProfile,
+            &_calibration,
+            fd,
+            static_cast<uint64_t>(bytes),
+            static_cast<double>(totalMicroseconds - pretransferMicroseconds) / 1e6);
+    }
+
+done:
+    if (resolveList != nullptr)
+    {
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, nullptr);
+        curl_slist_free_all(resolveList);
+    }
+
+    if (transfer.fd != -1 && close(transfer.fd) != 0 && exitCode == 0)
+    {
+        Log_Error("Failed to close '%s', errno: %d", filePath.c_str(), errno);
+        exitCode = -1;
+    }
+
+    return exitCode;
+}
+
+} // namespace CurlDownload
+} // namespace ADUC
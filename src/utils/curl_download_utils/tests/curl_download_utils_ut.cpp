@@ -0,0 +1,247 @@
+/**
+ * @file curl_download_utils_ut.cpp
+ * @brief Unit Tests for curl_download_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/curl_download_utils.hpp"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <netinet/in.h>
+#include <parson.h>
+#include <poll.h>
+#include <stdio.h> // sscanf
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define TEST_DIR "/tmp/adutest/curl_download_utils_ut"
+
+using ADUC::CurlDownload::BuildArgs;
+using ADUC::CurlDownload::Downloader;
+using ADUC::CurlDownload::TransferSettings;
+
+static std::string ReadFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+/**
+ * @brief An HTTP/1.1 server on loopback that serves one payload, with byte ranges and keep-alive, and counts the
+ * connections.
+ */
+class StubHttpServer
+{
+public:
+    explicit StubHttpServer(const std::string& payload) : _payload(payload)
+    {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(_fd >= 0);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        REQUIRE(bind(_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        REQUIRE(listen(_fd, 4) == 0);
+        REQUIRE(getsockname(_fd, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+        _port = ntohs(address.sin_port);
+
+        _thread = std::thread{ [this]() { Serve(); } };
+    }
+
+    ~StubHttpServer()
+    {
+        _stopping = true;
+        _thread.join();
+        close(_fd);
+    }
+
+    StubHttpServer(const StubHttpServer&) = delete;
+    StubHttpServer& operator=(const StubHttpServer&) = delete;
+    StubHttpServer(StubHttpServer&&) = delete;
+    StubHttpServer& operator=(StubHttpServer&&) = delete;
+
+    unsigned int Connections() const
+    {
+        return _connections;
+    }
+
+    std::string Uri() const
+    {
+        return "http://127.0.0.1:" + std::to_string(_port) + "/payload.bin";
+    }
+
+private:
+    static bool WaitReadable(int fd, const std::atomic<bool>& stopping)
+    {
+        while (!stopping)
+        {
+            pollfd pfd{ fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 50) > 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Serve()
+    {
+        while (WaitReadable(_fd, _stopping))
+        {
+            const int connection = accept(_fd, nullptr, nullptr);
+            if (connection == -1)
+            {
+                continue;
+            }
+
+            ++_connections;
+            ServeConnection(connection);
+            close(connection);
+        }
+    }
+
+    void ServeConnection(int connection)
+    {
+        std::string request;
+        char buffer[4096];
+
+        while (WaitReadable(connection, _stopping))
+        {
+            const ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                return;
+            }
+
+            request.append(buffer, static_cast<size_t>(received));
+
+            const size_t end = request.find("\r\n\r\n");
+            if (end == std::string::npos)
+            {
+                continue;
+            }
+
+            std::string response = "HTTP/1.1 200 OK\r\n";
+            std::string body = _payload;
+            size_t first = 0;
+            size_t last = 0;
+            const size_t range = request.find("Range: bytes=");
+            if (range < end && sscanf(request.c_str() + range, "Range: bytes=%zu-%zu", &first, &last) == 2)
+            {
+                response = "HTTP/1.1 206 Partial Content\r\n";
+                body = _payload.substr(first, last - first + 1);
+            }
+
+            response += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            request.erase(0, end + 4);
+
+            for (size_t sent = 0; sent < response.size();)
+            {
+                const ssize_t written = send(connection, response.data() + sent, response.size() - sent, 0);
+                if (written <= 0)
+                {
+                    return;
+                }
+
+                sent += static_cast<size_t>(written);
+            }
+        }
+    }
+
+    std::string _payload;
+    int _fd = -1;
+    unsigned short _port = 0;
+    std::thread _thread;
+    std::atomic<bool> _stopping{ false };
+    std::atomic<unsigned int> _connections{ 0 };
+};
+
+TEST_CASE("BuildArgs")
+{
+    const char* uri = "https://cdn.example.com/payload.bin";
+
+    SECTION("Without download settings")
+    {
+        TransferSettings settings;
+
+        CHECK(
+            BuildArgs(uri, "/tmp/payload.bin", settings, {})
+            == std::vector<std::string>{ "-o", "/tmp/payload.bin", uri });
+    }
+
+    SECTION("With all download settings")
+    {
+        TransferSettings settings;
+        settings.httpOption = "--http2";
+        settings.sessionFile = "/var/lib/adu/tlssessions/cdn.example.com_443";
+        settings.resolve = "cdn.example.com:443:192.0.2.1";
+
+        CHECK(
+            BuildArgs(uri, "-", settings, { "-sS", "-f", "-r", "0-99" })
+            == std::vector<std::string>{ "-sS",
+                                         "-f",
+                                         "-r",
+                                         "0-99",
+                                         "--http2",
+                                         "--ssl-sessions",
+                                         "/var/lib/adu/tlssessions/cdn.example.com_443",
+                                         "--resolve",
+                                         "cdn.example.com:443:192.0.2.1",
+                                         "-o",
+                                         "-",
+                                         uri });
+    }
+}
+
+TEST_CASE("Downloader transfers in-process with a socket tuning profile")
+{
+    std::string payload;
+    for (size_t i = 0; payload.size() < 1024 * 1024; ++i)
+    {
+        payload += std::to_string(i) + "\n";
+    }
+
+    StubHttpServer server{ payload };
+
+    aduc::AutoDir dir{ TEST_DIR }; // auto rmdir on scope exit
+    REQUIRE(dir.RemoveDir());
+    REQUIRE(dir.CreateDir());
+    const std::string filePath = dir.GetDir() + "/payload.bin";
+
+    JSON_Value* tuningValue =
+        json_parse_string(R"({"calibrate":true,"keepAliveIdleSeconds":30,"keepAliveIntervalSeconds":5})");
+    REQUIRE(tuningValue != nullptr);
+
+    ADUC_ConfigInfo config = {};
+    config.socketTuning = json_value_get_object(tuningValue);
+
+    {
+        Downloader downloader;
+        downloader.Initialize(&config);
+
+        std::string output;
+        CHECK(downloader.Download(server.Uri().c_str(), filePath, nullptr, output) == 0);
+        CHECK(ReadFile(filePath) == payload);
+
+        CHECK(downloader.Download(server.Uri().c_str(), filePath, "100-199", output) == 0);
+        CHECK(ReadFile(filePath) == payload.substr(100, 100));
+
+        // The libcurl handle is kept, so the second transfer reuses the connection.
+        CHECK(server.Connections() == 1);
+    }
+
+    json_value_free(tuningValue);
+}
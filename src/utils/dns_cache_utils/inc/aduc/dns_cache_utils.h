@@ -0,0 +1,168 @@
+/**
+ * @file dns_cache_utils.h
+ * @brief In-process DNS cache of the download hosts.
+ *
+ * Downloads on flaky links fail early when the name of the download host does not resolve, although its
+ * addresses rarely change. The cache resolves names with its own UDP client, so that the TTLs of the records
+ * are known, and keeps the addresses for the TTL. An expired entry is still served for staleSeconds while it
+ * is refreshed in the background, and the last known addresses are served when a refresh fails. A name that
+ * does not exist is cached for negativeTtlSeconds. Entries with addresses are persisted, so the last known
+ * addresses survive a restart. The cache is configured by the optional "dnsCache" object of du-config.json:
+ *
+ *   "dnsCache": {
+ *       "minTtlSeconds": 30,
+ *       "maxTtlSeconds": 3600,
+ *       "staleSeconds": 86400,
+ *       "negativeTtlSeconds": 30,
+ *       "timeoutMs": 2000,
+ *       "maxEntries": 64,
+ *       "nameservers": [ "192.168.1.1", "[fd00::1]:53" ]
+ *   }
+ *
+ * The nameservers of /etc/resolv.conf are used if none are configured. Names in /etc/hosts and address
+ * literals are not cached. The system resolver is used when no nameserver is known, or when a response is
+ * truncated. All fields are optional.
+ *
+ * A cache is thread safe.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_DNS_CACHE_UTILS_H
+#define ADUC_DNS_CACHE_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <aduc/dns_message.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Name of the file the cache is persisted to in the agent data folder.
+ */
+#define ADUC_DNS_CACHE_FILE_NAME "dnscache.json"
+
+/**
+ * @brief Maximum number of nameservers.
+ */
+#define ADUC_DNS_CACHE_MAX_NAMESERVERS 3
+
+/**
+ * @brief Maximum length of a nameserver, an address with an optional port, including the terminator.
+ */
+#define ADUC_DNS_CACHE_MAX_NAMESERVER 56
+
+/**
+ * @brief Maximum length of a curl --resolve value, including the terminator.
+ */
+#define ADUC_DNS_CACHE_MAX_CURL_RESOLVE (ADUC_DNS_MAX_NAME + 8 + ADUC_DNS_MAX_ADDRESSES * 48)
+
+/**
+ * @brief Gets the current time. Used by tests to move the clock.
+ */
+typedef time_t (*ADUC_DnsCache_ClockFunc)(void);
+
+/**
+ * @brief The cache configuration.
+ */
+typedef struct tagADUC_DnsCache_Config
+{
+    bool enabled; /**< True if "dnsCache" is configured. */
+    unsigned int minTtlSeconds; /**< Lower bound of the TTL of an entry. */
+    unsigned int maxTtlSeconds; /**< Upper bound of the TTL of an entry. */
+    unsigned int staleSeconds; /**< Time an expired entry is served while it is refreshed. */
+    unsigned int negativeTtlSeconds; /**< Time a name that does not exist is cached. */
+    unsigned int timeoutMs; /**< Time to wait for the answers of a nameserver. */
+    unsigned int maxEntries; /**< Number of cached names; the least recently used one is evicted. */
+    size_t nameserverCount; /**< Number of entries in nameservers. */
+    char nameservers[ADUC_DNS_CACHE_MAX_NAMESERVERS][ADUC_DNS_CACHE_MAX_NAMESERVER]; /**< Nameservers. */
+    const char* resolvConfFile; /**< Not parsed; /etc/resolv.conf if NULL. Must outlive the cache. */
+    const char* hostsFile; /**< Not parsed; /etc/hosts if NULL. Must outlive the cache. */
+    ADUC_DnsCache_ClockFunc clock; /**< Not parsed; time() if NULL. */
+} ADUC_DnsCache_Config;
+
+/**
+ * @brief How lookups were answered.
+ */
+typedef struct tagADUC_DnsCache_Stats
+{
+    unsigned int hits; /**< Answered by an entry within its TTL. */
+    unsigned int staleHits; /**< Answered by an expired entry while it is refreshed. */
+    unsigned int lastKnownGoodHits; /**< Answered by an expired entry after resolving failed. */
+    unsigned int negativeHits; /**< Answered by a cached nonexistent name. */
+    unsigned int resolves; /**< Names resolved during a lookup. */
+    unsigned int refreshes; /**< Names refreshed in the background. */
+    unsigned int failures; /**< Lookups without an answer. */
+    unsigned int queries; /**< Queries sent to nameservers. */
+} ADUC_DnsCache_Stats;
+
+/**
+ * @brief Opaque cache instance.
+ */
+typedef struct tagADUC_DnsCache ADUC_DnsCache;
+
+/**
+ * @brief Parses the "dnsCache" configuration object.
+ *
+ * @param[out] config The parsed configuration. Disabled if @p dnsCacheObj is NULL or invalid.
+ * @param dnsCacheObj The "dnsCache" object, or NULL if not configured.
+ * @return bool true if not configured or valid.
+ */
+bool ADUC_DnsCache_ParseConfig(ADUC_DnsCache_Config* config, const JSON_Object* dnsCacheObj);
+
+/**
+ * @brief Creates a cache and loads the entries persisted in @p persistFile.
+ *
+ * @param config An enabled configuration.
+ * @param persistFile The file the entries are persisted to, or NULL to not persist them. The file is replaced
+ * atomically, so caches of several processes may share it; the last one written wins.
+ * @return ADUC_DnsCache* The instance, or NULL on failure. Free with ADUC_DnsCache_Destroy.
+ */
+ADUC_DnsCache* ADUC_DnsCache_Create(const ADUC_DnsCache_Config* config, const char* persistFile);
+
+/**
+ * @brief Stops the background refresh and frees the instance. Waits for a refresh in progress.
+ *
+ * @param cache The instance. May be NULL.
+ */
+void ADUC_DnsCache_Destroy(ADUC_DnsCache* cache);
+
+/**
+ * @brief Looks up the addresses of @p host.
+ *
+ * @param cache The instance.
+ * @param host A domain name or an address literal.
+ * @param addresses The buffer for the addresses, IPv4 addresses first.
+ * @param maxAddresses The number of entries of @p addresses.
+ * @return size_t The number of addresses, or 0 if @p host does not resolve.
+ */
+size_t ADUC_DnsCache_Lookup(
+    ADUC_DnsCache* cache, const char* host, ADUC_DnsAddress* addresses, size_t maxAddresses);
+
+/**
+ * @brief Gets the value of the curl --resolve option for the host of @p url, "<host>:<port>:<addresses>".
+ *
+ * @param cache The instance.
+ * @param url An http or https URL.
+ * @param resolve The buffer for the value.
+ * @param resolveSize The size of @p resolve; ADUC_DNS_CACHE_MAX_CURL_RESOLVE always suffices.
+ * @return bool false if the host of @p url is an address literal or does not resolve, so that curl resolves
+ * it itself.
+ */
+bool ADUC_DnsCache_GetCurlResolve(ADUC_DnsCache* cache, const char* url, char* resolve, size_t resolveSize);
+
+/**
+ * @brief Gets how lookups were answered so far.
+ *
+ * @param cache The instance.
+ * @param[out] stats The statistics.
+ */
+void ADUC_DnsCache_GetStats(ADUC_DnsCache* cache, ADUC_DnsCache_Stats* stats);
+
+EXTERN_C_END
+
+#endif // ADUC_DNS_CACHE_UTILS_H
@@ -0,0 +1,131 @@
+/**
+ * @file dns_message.h
+ * @brief DNS queries and responses for the address lookups of the DNS cache.
+ *
+ * Only what an A or AAAA lookup over UDP needs is implemented: a query with one question, and a response
+ * whose answer section is followed through CNAME records to the addresses of the queried name. The TTL of
+ * the answer is the smallest TTL of the records on that chain.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_DNS_MESSAGE_H
+#define ADUC_DNS_MESSAGE_H
+
+#include <aduc/c_utils.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum size of a DNS message over UDP without EDNS.
+ */
+#define ADUC_DNS_MAX_MESSAGE 512
+
+/**
+ * @brief Maximum length of a domain name in text form, including the terminator.
+ */
+#define ADUC_DNS_MAX_NAME 256
+
+/**
+ * @brief Maximum number of addresses of a response that are kept.
+ */
+#define ADUC_DNS_MAX_ADDRESSES 8
+
+/**
+ * @brief The record types of a lookup.
+ */
+typedef enum tagADUC_DnsType
+{
+    ADUC_DnsType_A = 1, /**< IPv4 address. */
+    ADUC_DnsType_CNAME = 5, /**< Canonical name. */
+    ADUC_DnsType_AAAA = 28, /**< IPv6 address. */
+} ADUC_DnsType;
+
+/**
+ * @brief The response codes the lookup distinguishes.
+ */
+typedef enum tagADUC_DnsRcode
+{
+    ADUC_DnsRcode_NoError = 0, /**< The name exists; the answer may still hold no address of the type. */
+    ADUC_DnsRcode_ServFail = 2, /**< The server failed. */
+    ADUC_DnsRcode_NxDomain = 3, /**< The name does not exist. */
+} ADUC_DnsRcode;
+
+/**
+ * @brief An IPv4 or IPv6 address.
+ */
+typedef struct tagADUC_DnsAddress
+{
+    int family; /**< AF_INET or AF_INET6. */
+    uint8_t bytes[16]; /**< The address in network order; 4 bytes for AF_INET. */
+} ADUC_DnsAddress;
+
+/**
+ * @brief A parsed response.
+ */
+typedef struct tagADUC_DnsResponse
+{
+    unsigned int rcode; /**< The response code. */
+    bool truncated; /**< True if the response did not fit into a UDP message. */
+    uint32_t ttl; /**< Smallest TTL of the records leading to the addresses, or 0 without addresses. */
+    size_t addressCount; /**< Number of entries in addresses. */
+    ADUC_DnsAddress addresses[ADUC_DNS_MAX_ADDRESSES]; /**< The addresses of the queried name. */
+} ADUC_DnsResponse;
+
+/**
+ * @brief Builds a recursive query for the @p type records of @p name.
+ *
+ * @param buffer The buffer for the query.
+ * @param bufferSize The size of @p buffer.
+ * @param id The message id.
+ * @param name The domain name, without or with a trailing dot.
+ * @param type ADUC_DnsType_A or ADUC_DnsType_AAAA.
+ * @return size_t The length of the query, or 0 if @p name is not a valid domain name or does not fit.
+ */
+size_t ADUC_Dns_BuildQuery(uint8_t* buffer, size_t bufferSize, uint16_t id, const char* name, ADUC_DnsType type);
+
+/**
+ * @brief Parses the response to a query built by ADUC_Dns_BuildQuery.
+ *
+ * @param message The response.
+ * @param length The length of @p message.
+ * @param id The message id of the query.
+ * @param name The queried name.
+ * @param type The queried type.
+ * @param[out] response The parsed response.
+ * @return bool false if @p message is malformed, or is not a response to the query.
+ */
+bool ADUC_Dns_ParseResponse(
+    const uint8_t* message,
+    size_t length,
+    uint16_t id,
+    const char* name,
+    ADUC_DnsType type,
+    ADUC_DnsResponse* response);
+
+/**
+ * @brief Parses an IPv4 or IPv6 address literal.
+ *
+ * @param text The address, an IPv6 address may be in brackets.
+ * @param[out] address The address.
+ * @return bool false if @p text is not an address literal.
+ */
+bool ADUC_Dns_ParseAddress(const char* text, ADUC_DnsAddress* address);
+
+/**
+ * @brief Formats @p address as text, an IPv6 address in brackets if @p bracketIPv6 is set.
+ *
+ * @param address The address.
+ * @param bracketIPv6 Whether an IPv6 address is put in brackets, as in URLs.
+ * @param text The buffer for the text.
+ * @param textSize The size of @p text; 48 bytes always suffice.
+ * @return bool false if the text does not fit.
+ */
+bool ADUC_Dns_FormatAddress(const ADUC_DnsAddress* address, bool bracketIPv6, char* text, size_t textSize);
+
+EXTERN_C_END
+
+#endif // ADUC_DNS_MESSAGE_H
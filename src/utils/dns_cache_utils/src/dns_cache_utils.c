@@ -0,0 +1,1345 @@
+/**
+ * @file dns_cache_utils.c
+ * @brief Implements the in-process DNS cache of the download hosts.
+ *
+ * A lookup is answered from the cache when it can, and otherwise resolves the name while the caller waits:
+ *
+ *   - within the TTL, the entry is served;
+ *   - within staleSeconds after the TTL, the entry is served and queued for the refresh thread;
+ *   - later, the name is resolved, and the entry is served as last known good if that fails.
+ *
+ * A failed resolve is not retried for minTtlSeconds, so that an unreachable nameserver does not delay every
+ * download by the query timeout.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/dns_cache_utils.h"
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN, ADUC_StringFormat
+
+#include <arpa/inet.h> // inet_pton
+#include <ctype.h> // isalnum, tolower
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h> // getaddrinfo
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h> // fopen, snprintf
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define DEFAULT_MIN_TTL_SECONDS 30
+#define DEFAULT_MAX_TTL_SECONDS 3600
+#define DEFAULT_STALE_SECONDS 86400
+#define DEFAULT_NEGATIVE_TTL_SECONDS 30
+#define DEFAULT_TIMEOUT_MS 2000
+#define DEFAULT_MAX_ENTRIES 64
+
+#define DEFAULT_RESOLV_CONF_FILE "/etc/resolv.conf"
+#define DEFAULT_HOSTS_FILE "/etc/hosts"
+#define DNS_PORT 53
+
+/**
+ * @brief Maximum length of a line of /etc/resolv.conf or /etc/hosts that is read.
+ */
+#define MAX_LINE 1024
+
+static const char* CONFIG_DNS_CACHE = "dnsCache";
+static const char* CONFIG_MIN_TTL_SECONDS = "minTtlSeconds";
+static const char* CONFIG_MAX_TTL_SECONDS = "maxTtlSeconds";
+static const char* CONFIG_STALE_SECONDS = "staleSeconds";
+static const char* CONFIG_NEGATIVE_TTL_SECONDS = "negativeTtlSeconds";
+static const char* CONFIG_TIMEOUT_MS = "timeoutMs";
+static const char* CONFIG_MAX_ENTRIES = "maxEntries";
+static const char* CONFIG_NAMESERVERS = "nameservers";
+
+static const char* PERSIST_ENTRIES = "entries";
+static const char* PERSIST_NAME = "name";
+static const char* PERSIST_EXPIRES_AT = "expiresAt";
+static const char* PERSIST_ADDRESSES = "addresses";
+
+/**
+ * @brief A nameserver address.
+ */
+typedef struct tagADUC_DnsCache_Nameserver
+{
+    struct sockaddr_storage address; /**< Address and port. */
+    socklen_t addressLength; /**< Length of address. */
+} ADUC_DnsCache_Nameserver;
+
+/**
+ * @brief A cached name.
+ */
+typedef struct tagADUC_DnsCache_Entry
+{
+    char name[ADUC_DNS_MAX_NAME]; /**< The lowercase name. Empty if the slot is free. */
+    bool negative; /**< True if the name does not exist. */
+    time_t expiresAt; /**< End of the TTL. */
+    time_t retryAt; /**< Time before which a failed resolve is not retried. */
+    time_t lastUsed; /**< Time of the last lookup, for eviction. */
+    bool refreshPending; /**< True if queued for the refresh thread. */
+    size_t addressCount; /**< Number of entries in addresses. */
+    ADUC_DnsAddress addresses[ADUC_DNS_MAX_ADDRESSES]; /**< The addresses, IPv4 addresses first. */
+} ADUC_DnsCache_Entry;
+
+/**
+ * @brief The outcome of resolving a name.
+ */
+typedef enum tagADUC_DnsCache_Outcome
+{
+    ADUC_DnsCache_Outcome_Resolved, /**< The name has addresses. */
+    ADUC_DnsCache_Outcome_NotFound, /**< The name does not exist, or has no addresses. */
+    ADUC_DnsCache_Outcome_Failed, /**< No nameserver answered. */
+    ADUC_DnsCache_Outcome_UseSystem, /**< The answer did not fit into UDP; the system resolver must be asked. */
+} ADUC_DnsCache_Outcome;
+
+/**
+ * @brief The result of resolving a name.
+ */
+typedef struct tagADUC_DnsCache_Result
+{
+    ADUC_DnsCache_Outcome outcome; /**< The outcome. */
+    uint32_t ttl; /**< The TTL of the addresses. */
+    size_t addressCount; /**< Number of entries in addresses. */
+    ADUC_DnsAddress addresses[ADUC_DNS_MAX_ADDRESSES]; /**< The addresses, IPv4 addresses first. */
+    unsigned int queries; /**< Number of queries sent. */
+} ADUC_DnsCache_Result;
+
+struct tagADUC_DnsCache
+{
+    ADUC_DnsCache_Config config; /**< The configuration. */
+    ADUC_DnsCache_Nameserver nameservers[ADUC_DNS_CACHE_MAX_NAMESERVERS]; /**< The nameservers. */
+    size_t nameserverCount; /**< Number of entries in nameservers. */
+    char* persistFile; /**< The persisted entries, or NULL. */
+    char* persistTempFile; /**< The file persistFile is written to before it is replaced. */
+    pthread_mutex_t mutex; /**< Guards entries, dirty, stats and stopping. */
+    pthread_cond_t refreshCondition; /**< Signaled when an entry is queued for refresh, or on stop. */
+    ADUC_DnsCache_Entry* entries; /**< The config.maxEntries cache slots. */
+    bool dirty; /**< True if the entries changed since they were persisted. */
+    ADUC_DnsCache_Stats stats; /**< The statistics. */
+    bool stopping; /**< Set when the refresh thread must exit. */
+    pthread_t refreshThread; /**< Refreshes stale entries. */
+    bool refreshThreadStarted; /**< True if refreshThread must be joined. */
+};
+
+//
+// Configuration
+//
+
+/**
+ * @brief Reads a non-negative integer field.
+ *
+ * @return false if the field is present but not a number in [0, @p maxValue].
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int maxValue, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 0 || number > (double)maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+/**
+ * @brief Parses a nameserver, an IPv4 or IPv6 address with an optional port: "10.0.0.1", "10.0.0.1:5353",
+ * "fd00::1" or "[fd00::1]:5353".
+ */
+static bool ParseNameserver(const char* text, ADUC_DnsCache_Nameserver* nameserver)
+{
+    char address[ADUC_DNS_CACHE_MAX_NAMESERVER];
+    const char* portText = NULL;
+    unsigned int port = DNS_PORT;
+    size_t addressLength = 0;
+
+    memset(nameserver, 0, sizeof(*nameserver));
+
+    if (text == NULL || *text == '\0' || strlen(text) >= sizeof(address))
+    {
+        return false;
+    }
+
+    if (text[0] == '[')
+    {
+        const char* end = strchr(text, ']');
+        if (end == NULL || (end[1] != '\0' && end[1] != ':'))
+        {
+            return false;
+        }
+
+        ADUC_Safe_StrCopyN(address, text + 1, sizeof(address), (size_t)(end - text - 1));
+        portText = (end[1] == ':') ? end + 2 : NULL;
+    }
+    else
+    {
+        const char* colon = strchr(text, ':');
+        addressLength = (colon != NULL && strchr(colon + 1, ':') == NULL) ? (size_t)(colon - text) : strlen(text);
+        ADUC_Safe_StrCopyN(address, text, sizeof(address), addressLength);
+        portText = (text[addressLength] == ':') ? text + addressLength + 1 : NULL;
+    }
+
+    if (portText != NULL && (!atoui(portText, &port) || port == 0 || port > UINT16_MAX))
+    {
+        return false;
+    }
+
+    struct sockaddr_in* address4 = (struct sockaddr_in*)&nameserver->address;
+    struct sockaddr_in6* address6 = (struct sockaddr_in6*)&nameserver->address;
+
+    if (inet_pton(AF_INET, address, &address4->sin_addr) == 1)
+    {
+        address4->sin_family = AF_INET;
+        address4->sin_port = htons((uint16_t)port);
+        nameserver->addressLength = sizeof(*address4);
+        return true;
+    }
+
+    if (inet_pton(AF_INET6, address, &address6->sin6_addr) == 1)
+    {
+        address6->sin6_family = AF_INET6;
+        address6->sin6_port = htons((uint16_t)port);
+        nameserver->addressLength = sizeof(*address6);
+        return true;
+    }
+
+    return false;
+}
+
+bool ADUC_DnsCache_ParseConfig(ADUC_DnsCache_Config* config, const JSON_Object* dnsCacheObj)
+{
+    bool succeeded = false;
+    ADUC_DnsCache_Nameserver nameserver;
+
+    memset(config, 0, sizeof(*config));
+
+    if (dnsCacheObj == NULL)
+    {
+        return true;
+    }
+
+    config->minTtlSeconds = DEFAULT_MIN_TTL_SECONDS;
+    config->maxTtlSeconds = DEFAULT_MAX_TTL_SECONDS;
+    config->staleSeconds = DEFAULT_STALE_SECONDS;
+    config->negativeTtlSeconds = DEFAULT_NEGATIVE_TTL_SECONDS;
+    config->timeoutMs = DEFAULT_TIMEOUT_MS;
+    config->maxEntries = DEFAULT_MAX_ENTRIES;
+
+    if (!GetUIntField(dnsCacheObj, CONFIG_MIN_TTL_SECONDS, INT32_MAX, &config->minTtlSeconds)
+        || !GetUIntField(dnsCacheObj, CONFIG_MAX_TTL_SECONDS, INT32_MAX, &config->maxTtlSeconds)
+        || !GetUIntField(dnsCacheObj, CONFIG_STALE_SECONDS, INT32_MAX, &config->staleSeconds)
+        || !GetUIntField(dnsCacheObj, CONFIG_NEGATIVE_TTL_SECONDS, INT32_MAX, &config->negativeTtlSeconds)
+        || !GetUIntField(dnsCacheObj, CONFIG_TIMEOUT_MS, 60 * 1000, &config->timeoutMs)
+        || !GetUIntField(dnsCacheObj, CONFIG_MAX_ENTRIES, 4096, &config->maxEntries)
+        || config->minTtlSeconds > config->maxTtlSeconds || config->timeoutMs == 0 || config->maxEntries == 0)
+    {
+        Log_Error("Invalid %s, expected positive limits and %s <= %s.",
+            CONFIG_DNS_CACHE,
+            CONFIG_MIN_TTL_SECONDS,
+            CONFIG_MAX_TTL_SECONDS);
+        goto done;
+    }
+
+    if (json_object_has_value(dnsCacheObj, CONFIG_NAMESERVERS)
+        && !json_object_has_value_of_type(dnsCacheObj, CONFIG_NAMESERVERS, JSONArray))
+    {
+        Log_Error("Invalid %s.%s, expected an array.", CONFIG_DNS_CACHE, CONFIG_NAMESERVERS);
+        goto done;
+    }
+
+    const JSON_Array* nameservers = json_object_get_array(dnsCacheObj, CONFIG_NAMESERVERS);
+    config->nameserverCount = json_array_get_count(nameservers);
+    if (config->nameserverCount > ADUC_DNS_CACHE_MAX_NAMESERVERS)
+    {
+        Log_Error("Invalid %s.%s, at most %d nameservers are supported.",
+            CONFIG_DNS_CACHE,
+            CONFIG_NAMESERVERS,
+            ADUC_DNS_CACHE_MAX_NAMESERVERS);
+        goto done;
+    }
+
+    for (size_t i = 0; i < config->nameserverCount; ++i)
+    {
+        const char* text = json_array_get_string(nameservers, i);
+        if (!ParseNameserver(text, &nameserver))
+        {
+            Log_Error("Invalid %s.%s entry, expected an address with an optional port.",
+                CONFIG_DNS_CACHE,
+                CONFIG_NAMESERVERS);
+            goto done;
+        }
+
+        ADUC_Safe_StrCopyN(config->nameservers[i], text, sizeof(config->nameservers[i]), strlen(text));
+    }
+
+    config->enabled = true;
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(config, 0, sizeof(*config));
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Reads the nameservers of a resolv.conf file.
+ */
+static void ReadResolvConf(ADUC_DnsCache* cache, const char* path)
+{
+    char line[MAX_LINE];
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        Log_Warn("Could not read %s, errno = %d", path, errno);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL && cache->nameserverCount < ADUC_DNS_CACHE_MAX_NAMESERVERS)
+    {
+        char* saveptr = NULL;
+        const char* keyword = strtok_r(line, " \t\r\n", &saveptr);
+        const char* address = strtok_r(NULL, " \t\r\n", &saveptr);
+
+        // Scoped IPv6 addresses ("fe80::1%eth0") do not parse, and are skipped.
+        if (keyword != NULL && address != NULL && strcmp(keyword, "nameserver") == 0
+            && ParseNameserver(address, &cache->nameservers[cache->nameserverCount]))
+        {
+            ++cache->nameserverCount;
+        }
+    }
+
+    fclose(file);
+}
+
+//
+// Names
+//
+
+/**
+ * @brief Lowercases @p host and removes a trailing dot.
+ *
+ * @return false if @p host is not a domain name of at most ADUC_DNS_MAX_NAME - 1 characters.
+ */
+static bool NormalizeName(const char* host, char* name, size_t nameSize)
+{
+    size_t length = strlen(host);
+
+    if (length > 0 && host[length - 1] == '.')
+    {
+        --length;
+    }
+
+    if (length == 0 || length >= nameSize)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        const unsigned char c = (unsigned char)host[i];
+        if (!isalnum(c) && c != '-' && c != '.' && c != '_')
+        {
+            return false;
+        }
+
+        name[i] = (char)tolower(c);
+    }
+
+    name[length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Looks up @p name in a hosts file.
+ *
+ * @return size_t The number of addresses of @p name, IPv4 addresses first.
+ */
+static size_t LookupHostsFile(const char* path, const char* name, ADUC_DnsAddress* addresses, size_t maxAddresses)
+{
+    char line[MAX_LINE];
+    char hostName[ADUC_DNS_MAX_NAME];
+    ADUC_DnsAddress found[ADUC_DNS_MAX_ADDRESSES];
+    size_t foundCount = 0;
+    size_t count = 0;
+    FILE* file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL && foundCount < ADUC_DNS_MAX_ADDRESSES)
+    {
+        char* saveptr = NULL;
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        const char* address = strtok_r(line, " \t\r\n", &saveptr);
+        if (address == NULL || !ADUC_Dns_ParseAddress(address, &found[foundCount]))
+        {
+            continue;
+        }
+
+        for (const char* alias = strtok_r(NULL, " \t\r\n", &saveptr); alias != NULL;
+             alias = strtok_r(NULL, " \t\r\n", &saveptr))
+        {
+            if (NormalizeName(alias, hostName, sizeof(hostName)) && strcmp(hostName, name) == 0)
+            {
+                ++foundCount;
+                break;
+            }
+        }
+    }
+
+    fclose(file);
+
+    for (int family = AF_INET; family != 0; family = (family == AF_INET) ? AF_INET6 : 0)
+    {
+        for (size_t i = 0; i < foundCount && count < maxAddresses; ++i)
+        {
+            if (found[i].family == family)
+            {
+                addresses[count++] = found[i];
+            }
+        }
+    }
+
+    return count;
+}
+
+//
+// Resolving
+//
+
+/**
+ * @brief Gets a random message id, to make spoofed responses unlikely to be accepted.
+ */
+static uint16_t GetRandomId(void)
+{
+    uint16_t id = 0;
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+    if (fd >= 0)
+    {
+        if (read(fd, &id, sizeof(id)) != (ssize_t)sizeof(id))
+        {
+            id = 0;
+        }
+
+        close(fd);
+    }
+
+    if (id == 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        id = (uint16_t)(now.tv_nsec ^ getpid());
+    }
+
+    return id;
+}
+
+static int64_t GetMonotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Appends the addresses of @p response to @p result.
+ */
+static void AppendAddresses(ADUC_DnsCache_Result* result, const ADUC_DnsResponse* response)
+{
+    for (size_t i = 0; i < response->addressCount && result->addressCount < ADUC_DNS_MAX_ADDRESSES; ++i)
+    {
+        result->addresses[result->addressCount++] = response->addresses[i];
+    }
+
+    if (response->addressCount != 0 && (result->ttl == 0 || response->ttl < result->ttl))
+    {
+        result->ttl = response->ttl;
+    }
+}
+
+/**
+ * @brief Asks @p nameserver for the A and AAAA records of @p name.
+ */
+static void QueryNameserver(
+    const ADUC_DnsCache* cache,
+    const ADUC_DnsCache_Nameserver* nameserver,
+    const char* name,
+    ADUC_DnsCache_Result* result)
+{
+    static const ADUC_DnsType types[2] = { ADUC_DnsType_A, ADUC_DnsType_AAAA };
+    uint8_t message[ADUC_DNS_MAX_MESSAGE];
+    uint16_t ids[2];
+    bool answered[2] = { false, false };
+    ADUC_DnsResponse responses[2];
+    ADUC_DnsResponse response;
+
+    memset(result, 0, sizeof(*result));
+    result->outcome = ADUC_DnsCache_Outcome_Failed;
+
+    int fd = socket(nameserver->address.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if (connect(fd, (const struct sockaddr*)&nameserver->address, nameserver->addressLength) != 0)
+    {
+        goto done;
+    }
+
+    ids[0] = GetRandomId();
+    ids[1] = (uint16_t)(ids[0] + 1);
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        const size_t length = ADUC_Dns_BuildQuery(message, sizeof(message), ids[i], name, types[i]);
+        if (length == 0)
+        {
+            result->outcome = ADUC_DnsCache_Outcome_NotFound;
+            goto done;
+        }
+
+        if (send(fd, message, length, 0) != (ssize_t)length)
+        {
+            goto done;
+        }
+
+        ++result->queries;
+    }
+
+    const int64_t deadline = GetMonotonicMs() + cache->config.timeoutMs;
+    while (!answered[0] || !answered[1])
+    {
+        const int64_t remaining = deadline - GetMonotonicMs();
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+        if (remaining <= 0)
+        {
+            break;
+        }
+
+        const int ready = poll(&pfd, 1, (int)remaining);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ready <= 0)
+        {
+            break;
+        }
+
+        // A refused connection means the nameserver is down; other responses that do not match are dropped.
+        const ssize_t received = recv(fd, message, sizeof(message), 0);
+        if (received < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        for (size_t i = 0; i < 2; ++i)
+        {
+            if (!answered[i]
+                && ADUC_Dns_ParseResponse(message, (size_t)received, ids[i], name, types[i], &response))
+            {
+                answered[i] = true;
+                responses[i] = response;
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        if (!answered[i])
+        {
+            continue;
+        }
+
+        if (responses[i].truncated)
+        {
+            result->outcome = ADUC_DnsCache_Outcome_UseSystem;
+            goto done;
+        }
+
+        if (responses[i].rcode == ADUC_DnsRcode_NxDomain)
+        {
+            result->outcome = ADUC_DnsCache_Outcome_NotFound;
+            goto done;
+        }
+
+        if (responses[i].rcode == ADUC_DnsRcode_NoError)
+        {
+            AppendAddresses(result, &responses[i]);
+        }
+    }
+
+    if (result->addressCount != 0)
+    {
+        result->outcome = ADUC_DnsCache_Outcome_Resolved;
+    }
+    else if (answered[0] && answered[1] && responses[0].rcode == ADUC_DnsRcode_NoError
+             && responses[1].rcode == ADUC_DnsRcode_NoError)
+    {
+        result->outcome = ADUC_DnsCache_Outcome_NotFound;
+    }
+
+done:
+    close(fd);
+}
+
+/**
+ * @brief Resolves @p name with the system resolver. The TTL is unknown, so it is 0.
+ */
+static void ResolveWithSystem(const char* name, ADUC_DnsCache_Result* result)
+{
+    struct addrinfo hints;
+    struct addrinfo* addressInfos = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    const int error = getaddrinfo(name, NULL, &hints, &addressInfos);
+    if (error != 0)
+    {
+        result->outcome = (error == EAI_NONAME) ? ADUC_DnsCache_Outcome_NotFound : ADUC_DnsCache_Outcome_Failed;
+        return;
+    }
+
+    for (int family = AF_INET; family != 0; family = (family == AF_INET) ? AF_INET6 : 0)
+    {
+        for (const struct addrinfo* info = addressInfos; info != NULL && result->addressCount < ADUC_DNS_MAX_ADDRESSES;
+             info = info->ai_next)
+        {
+            if (info->ai_family != family)
+            {
+                continue;
+            }
+
+            ADUC_DnsAddress* address = &result->addresses[result->addressCount++];
+            memset(address, 0, sizeof(*address));
+            address->family = family;
+            if (family == AF_INET)
+            {
+                memcpy(address->bytes, &((const struct sockaddr_in*)info->ai_addr)->sin_addr, 4);
+            }
+            else
+            {
+                memcpy(address->bytes, &((const struct sockaddr_in6*)info->ai_addr)->sin6_addr, 16);
+            }
+        }
+    }
+
+    freeaddrinfo(addressInfos);
+
+    result->ttl = 0;
+    result->outcome = (result->addressCount != 0) ? ADUC_DnsCache_Outcome_Resolved : ADUC_DnsCache_Outcome_NotFound;
+}
+
+/**
+ * @brief Resolves @p name with the nameservers, one after another until one answers. Called without the lock.
+ */
+static void ResolveName(const ADUC_DnsCache* cache, const char* name, ADUC_DnsCache_Result* result)
+{
+    unsigned int queries = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->outcome = (cache->nameserverCount == 0) ? ADUC_DnsCache_Outcome_UseSystem : ADUC_DnsCache_Outcome_Failed;
+
+    for (size_t i = 0; i < cache->nameserverCount && result->outcome == ADUC_DnsCache_Outcome_Failed; ++i)
+    {
+        QueryNameserver(cache, &cache->nameservers[i], name, result);
+        queries += result->queries;
+    }
+
+    if (result->outcome == ADUC_DnsCache_Outcome_UseSystem)
+    {
+        memset(result, 0, sizeof(*result));
+        ResolveWithSystem(name, result);
+    }
+
+    result->queries = queries;
+}
+
+//
+// Entries
+//
+
+static time_t GetNow(const ADUC_DnsCache* cache)
+{
+    return (cache->config.clock != NULL) ? cache->config.clock() : time(NULL);
+}
+
+static ADUC_DnsCache_Entry* FindEntry(ADUC_DnsCache* cache, const char* name)
+{
+    for (unsigned int i = 0; i < cache->config.maxEntries; ++i)
+    {
+        if (strcmp(cache->entries[i].name, name) == 0)
+        {
+            return &cache->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Gets the entry of @p name, replacing a free or the least recently used entry if there is none.
+ */
+static ADUC_DnsCache_Entry* GetOrAddEntry(ADUC_DnsCache* cache, const char* name)
+{
+    ADUC_DnsCache_Entry* entry = FindEntry(cache, name);
+
+    if (entry != NULL)
+    {
+        return entry;
+    }
+
+    entry = &cache->entries[0];
+    for (unsigned int i = 0; i < cache->config.maxEntries && entry->name[0] != '\0'; ++i)
+    {
+        if (cache->entries[i].name[0] == '\0' || cache->entries[i].lastUsed < entry->lastUsed)
+        {
+            entry = &cache->entries[i];
+        }
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    ADUC_Safe_StrCopyN(entry->name, name, sizeof(entry->name), strlen(name));
+    return entry;
+}
+
+static size_t CopyAddresses(const ADUC_DnsCache_Entry* entry, ADUC_DnsAddress* addresses, size_t maxAddresses)
+{
+    const size_t count = (entry->addressCount < maxAddresses) ? entry->addressCount : maxAddresses;
+    memcpy(addresses, entry->addresses, count * sizeof(*addresses));
+    return count;
+}
+
+/**
+ * @brief Stores the result of resolving @p name. A failed resolve keeps the entry as last known good.
+ *
+ * @return ADUC_DnsCache_Entry* The entry of @p name, or NULL if there is none.
+ */
+static ADUC_DnsCache_Entry*
+ApplyResult(ADUC_DnsCache* cache, const char* name, const ADUC_DnsCache_Result* result, time_t now)
+{
+    ADUC_DnsCache_Entry* entry = NULL;
+    uint32_t ttl = result->ttl;
+
+    cache->stats.queries += result->queries;
+
+    switch (result->outcome)
+    {
+    case ADUC_DnsCache_Outcome_Resolved:
+        ttl = (ttl < cache->config.minTtlSeconds) ? cache->config.minTtlSeconds : ttl;
+        ttl = (ttl > cache->config.maxTtlSeconds) ? cache->config.maxTtlSeconds : ttl;
+
+        entry = GetOrAddEntry(cache, name);
+        entry->negative = false;
+        entry->expiresAt = now + (time_t)ttl;
+        entry->retryAt = 0;
+        entry->addressCount = result->addressCount;
+        memcpy(entry->addresses, result->addresses, result->addressCount * sizeof(entry->addresses[0]));
+        cache->dirty = true;
+        break;
+
+    case ADUC_DnsCache_Outcome_NotFound:
+        entry = GetOrAddEntry(cache, name);
+        entry->negative = true;
+        entry->expiresAt = now + (time_t)cache->config.negativeTtlSeconds;
+        entry->retryAt = 0;
+        entry->addressCount = 0;
+        cache->dirty = true;
+        break;
+
+    default:
+        entry = FindEntry(cache, name);
+        if (entry != NULL)
+        {
+            entry->retryAt = now + (time_t)cache->config.minTtlSeconds;
+        }
+
+        break;
+    }
+
+    if (entry != NULL)
+    {
+        entry->refreshPending = false;
+        entry->lastUsed = now;
+    }
+
+    return entry;
+}
+
+//
+// Persistence
+//
+
+/**
+ * @brief Writes the entries with addresses to the persist file. Called with the lock held.
+ */
+static void PersistEntries(ADUC_DnsCache* cache)
+{
+    char addressText[48];
+    JSON_Value* rootValue = json_value_init_object();
+    JSON_Value* entriesValue = json_value_init_array();
+    JSON_Array* entriesArray = json_value_get_array(entriesValue);
+
+    cache->dirty = false;
+
+    if (cache->persistFile == NULL || rootValue == NULL || entriesArray == NULL)
+    {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < cache->config.maxEntries; ++i)
+    {
+        const ADUC_DnsCache_Entry* entry = &cache->entries[i];
+        if (entry->name[0] == '\0' || entry->negative || entry->addressCount == 0)
+        {
+            continue;
+        }
+
+        JSON_Value* entryValue = json_value_init_object();
+        JSON_Value* addressesValue = json_value_init_array();
+        JSON_Object* entryObj = json_value_get_object(entryValue);
+        JSON_Array* addressesArray = json_value_get_array(addressesValue);
+
+        if (entryObj == NULL || addressesArray == NULL)
+        {
+            json_value_free(entryValue);
+            json_value_free(addressesValue);
+            goto done;
+        }
+
+        for (size_t j = 0; j < entry->addressCount; ++j)
+        {
+            if (ADUC_Dns_FormatAddress(&entry->addresses[j], false, addressText, sizeof(addressText)))
+            {
+                json_array_append_string(addressesArray, addressText);
+            }
+        }
+
+        if (json_object_set_value(entryObj, PERSIST_ADDRESSES, addressesValue) != JSONSuccess)
+        {
+            json_value_free(addressesValue);
+            json_value_free(entryValue);
+            goto done;
+        }
+
+        if (json_object_set_string(entryObj, PERSIST_NAME, entry->name) != JSONSuccess
+            || json_object_set_number(entryObj, PERSIST_EXPIRES_AT, (double)entry->expiresAt) != JSONSuccess
+            || json_array_append_value(entriesArray, entryValue) != JSONSuccess)
+        {
+            json_value_free(entryValue);
+            goto done;
+        }
+    }
+
+    if (json_object_set_value(json_value_get_object(rootValue), PERSIST_ENTRIES, entriesValue) != JSONSuccess)
+    {
+        goto done;
+    }
+
+    entriesValue = NULL;
+
+    // Write and rename, so that an interrupted write never leaves a partial file behind.
+    if (json_serialize_to_file(rootValue, cache->persistTempFile) != JSONSuccess)
+    {
+        Log_Error("Could not write %s", cache->persistTempFile);
+        goto done;
+    }
+
+    if (rename(cache->persistTempFile, cache->persistFile) != 0)
+    {
+        Log_Error("Could not rename %s, errno = %d", cache->persistTempFile, errno);
+        (void)remove(cache->persistTempFile);
+    }
+
+done:
+    json_value_free(entriesValue);
+    json_value_free(rootValue);
+}
+
+/**
+ * @brief Loads the persisted entries. Their TTL is cut to maxTtlSeconds, in case the clock was off when they
+ * were written.
+ */
+static void LoadEntries(ADUC_DnsCache* cache)
+{
+    char name[ADUC_DNS_MAX_NAME];
+    const time_t now = GetNow(cache);
+    JSON_Value* rootValue = json_parse_file(cache->persistFile);
+    const JSON_Array* entriesArray = json_object_get_array(json_value_get_object(rootValue), PERSIST_ENTRIES);
+    size_t loaded = 0;
+
+    for (size_t i = 0; i < json_array_get_count(entriesArray) && loaded < cache->config.maxEntries; ++i)
+    {
+        const JSON_Object* entryObj = json_array_get_object(entriesArray, i);
+        const char* host = json_object_get_string(entryObj, PERSIST_NAME);
+        const JSON_Array* addressesArray = json_object_get_array(entryObj, PERSIST_ADDRESSES);
+
+        if (host == NULL || !NormalizeName(host, name, sizeof(name)) || FindEntry(cache, name) != NULL)
+        {
+            continue;
+        }
+
+        ADUC_DnsCache_Entry* entry = &cache->entries[loaded];
+        for (size_t j = 0; j < json_array_get_count(addressesArray) && entry->addressCount < ADUC_DNS_MAX_ADDRESSES;
+             ++j)
+        {
+            if (ADUC_Dns_ParseAddress(json_array_get_string(addressesArray, j), &entry->addresses[entry->addressCount]))
+            {
+                ++entry->addressCount;
+            }
+        }
+
+        if (entry->addressCount == 0)
+        {
+            continue;
+        }
+
+        const time_t maxExpiresAt = now + (time_t)cache->config.maxTtlSeconds;
+        entry->expiresAt = (time_t)json_object_get_number(entryObj, PERSIST_EXPIRES_AT);
+        entry->expiresAt = (entry->expiresAt > maxExpiresAt) ? maxExpiresAt : entry->expiresAt;
+        ADUC_Safe_StrCopyN(entry->name, name, sizeof(entry->name), strlen(name));
+        ++loaded;
+    }
+
+    if (loaded != 0)
+    {
+        Log_Info("Loaded %zu DNS cache entries from %s", loaded, cache->persistFile);
+    }
+
+    json_value_free(rootValue);
+}
+
+//
+// Refresh
+//
+
+static void* RefreshThreadMain(void* arg)
+{
+    ADUC_DnsCache* cache = (ADUC_DnsCache*)arg;
+    char name[ADUC_DNS_MAX_NAME];
+    ADUC_DnsCache_Result result;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    while (!cache->stopping)
+    {
+        const ADUC_DnsCache_Entry* pending = NULL;
+        for (unsigned int i = 0; i < cache->config.maxEntries && pending == NULL; ++i)
+        {
+            if (cache->entries[i].name[0] != '\0' && cache->entries[i].refreshPending)
+            {
+                pending = &cache->entries[i];
+            }
+        }
+
+        if (pending == NULL)
+        {
+            pthread_cond_wait(&cache->refreshCondition, &cache->mutex);
+            continue;
+        }
+
+        ADUC_Safe_StrCopyN(name, pending->name, sizeof(name), strlen(pending->name));
+        pthread_mutex_unlock(&cache->mutex);
+
+        ResolveName(cache, name, &result);
+
+        pthread_mutex_lock(&cache->mutex);
+
+        ++cache->stats.refreshes;
+        if (ApplyResult(cache, name, &result, GetNow(cache)) != NULL
+            && result.outcome == ADUC_DnsCache_Outcome_Failed)
+        {
+            Log_Warn("Refreshing %s failed, its last known addresses are served.", name);
+        }
+
+        if (cache->dirty)
+        {
+            PersistEntries(cache);
+        }
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+    return NULL;
+}
+
+//
+// Public functions
+//
+
+ADUC_DnsCache* ADUC_DnsCache_Create(const ADUC_DnsCache_Config* config, const char* persistFile)
+{
+    bool succeeded = false;
+    ADUC_DnsCache* cache = NULL;
+
+    if (config == NULL || !config->enabled || config->maxEntries == 0)
+    {
+        goto done;
+    }
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL)
+    {
+        goto done;
+    }
+
+    cache->config = *config;
+
+    if (pthread_mutex_init(&cache->mutex, NULL) != 0)
+    {
+        free(cache);
+        cache = NULL;
+        goto done;
+    }
+
+    if (pthread_cond_init(&cache->refreshCondition, NULL) != 0)
+    {
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache);
+        cache = NULL;
+        goto done;
+    }
+
+    cache->entries = calloc(config->maxEntries, sizeof(*cache->entries));
+    if (cache->entries == NULL)
+    {
+        goto done;
+    }
+
+    for (size_t i = 0; i < config->nameserverCount; ++i)
+    {
+        if (ParseNameserver(config->nameservers[i], &cache->nameservers[cache->nameserverCount]))
+        {
+            ++cache->nameserverCount;
+        }
+    }
+
+    if (config->nameserverCount == 0)
+    {
+        ReadResolvConf(cache, (config->resolvConfFile != NULL) ? config->resolvConfFile : DEFAULT_RESOLV_CONF_FILE);
+    }
+
+    if (cache->nameserverCount == 0)
+    {
+        Log_Warn("No nameservers, the DNS cache uses the system resolver without TTLs.");
+    }
+
+    if (persistFile != NULL)
+    {
+        cache->persistFile = ADUC_StringFormat("%s", persistFile);
+        cache->persistTempFile = ADUC_StringFormat("%s.tmp", persistFile);
+        if (cache->persistFile == NULL || cache->persistTempFile == NULL)
+        {
+            goto done;
+        }
+
+        LoadEntries(cache);
+    }
+
+    if (pthread_create(&cache->refreshThread, NULL, RefreshThreadMain, cache) != 0)
+    {
+        Log_Error("Could not start the DNS cache refresh thread.");
+        goto done;
+    }
+
+    cache->refreshThreadStarted = true;
+    succeeded = true;
+
+done:
+    if (!succeeded && cache != NULL)
+    {
+        ADUC_DnsCache_Destroy(cache);
+        cache = NULL;
+    }
+
+    return cache;
+}
+
+void ADUC_DnsCache_Destroy(ADUC_DnsCache* cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    cache->stopping = true;
+    pthread_cond_broadcast(&cache->refreshCondition);
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (cache->refreshThreadStarted)
+    {
+        pthread_join(cache->refreshThread, NULL);
+    }
+
+    if (cache->dirty)
+    {
+        PersistEntries(cache);
+    }
+
+    pthread_cond_destroy(&cache->refreshCondition);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    free(cache->persistFile);
+    free(cache->persistTempFile);
+    free(cache);
+}
+
+size_t ADUC_DnsCache_Lookup(ADUC_DnsCache* cache, const char* host, ADUC_DnsAddress* addresses, size_t maxAddresses)
+{
+    char name[ADUC_DNS_MAX_NAME];
+    ADUC_DnsCache_Result result;
+    size_t count = 0;
+
+    if (cache == NULL || host == NULL || addresses == NULL || maxAddresses == 0)
+    {
+        return 0;
+    }
+
+    if (ADUC_Dns_ParseAddress(host, &addresses[0]))
+    {
+        return 1;
+    }
+
+    if (!NormalizeName(host, name, sizeof(name)))
+    {
+        return 0;
+    }
+
+    count = LookupHostsFile(
+        (cache->config.hostsFile != NULL) ? cache->config.hostsFile : DEFAULT_HOSTS_FILE,
+        name,
+        addresses,
+        maxAddresses);
+    if (count != 0)
+    {
+        return count;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    time_t now = GetNow(cache);
+    ADUC_DnsCache_Entry* entry = FindEntry(cache, name);
+    if (entry != NULL)
+    {
+        entry->lastUsed = now;
+
+        if (entry->negative && now < entry->expiresAt)
+        {
+            ++cache->stats.negativeHits;
+            goto done;
+        }
+
+        if (!entry->negative && now < entry->expiresAt)
+        {
+            ++cache->stats.hits;
+            count = CopyAddresses(entry, addresses, maxAddresses);
+            goto done;
+        }
+
+        if (!entry->negative && now - entry->expiresAt < (time_t)cache->config.staleSeconds)
+        {
+            ++cache->stats.staleHits;
+            count = CopyAddresses(entry, addresses, maxAddresses);
+            if (!entry->refreshPending && now >= entry->retryAt)
+            {
+                entry->refreshPending = true;
+                pthread_cond_signal(&cache->refreshCondition);
+            }
+
+            goto done;
+        }
+
+        if (!entry->negative && now < entry->retryAt)
+        {
+            ++cache->stats.lastKnownGoodHits;
+            count = CopyAddresses(entry, addresses, maxAddresses);
+            goto done;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    ResolveName(cache, name, &result);
+
+    pthread_mutex_lock(&cache->mutex);
+
+    now = GetNow(cache);
+    ++cache->stats.resolves;
+    entry = ApplyResult(cache, name, &result, now);
+
+    if (result.outcome == ADUC_DnsCache_Outcome_Resolved)
+    {
+        count = CopyAddresses(entry, addresses, maxAddresses);
+    }
+    else if (result.outcome == ADUC_DnsCache_Outcome_Failed && entry != NULL && !entry->negative)
+    {
+        Log_Warn("Resolving %s failed, its last known addresses are served.", name);
+        ++cache->stats.lastKnownGoodHits;
+        count = CopyAddresses(entry, addresses, maxAddresses);
+    }
+
+    if (cache->dirty)
+    {
+        PersistEntries(cache);
+    }
+
+done:
+    if (count == 0)
+    {
+        ++cache->stats.failures;
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+    return count;
+}
+
+/**
+ * @brief Gets the host and port of an http or https URL.
+ */
+static bool GetUrlHostAndPort(const char* url, char* host, size_t hostSize, unsigned int* port)
+{
+    const char* authority = NULL;
+
+    if (strncmp(url, "https://", 8) == 0)
+    {
+        authority = url + 8;
+        *port = 443;
+    }
+    else if (strncmp(url, "http://", 7) == 0)
+    {
+        authority = url + 7;
+        *port = 80;
+    }
+    else
+    {
+        return false;
+    }
+
+    const size_t authorityLength = strcspn(authority, "/?#");
+    const char* userInfoEnd = memchr(authority, '@', authorityLength);
+    const char* hostStart = (userInfoEnd != NULL) ? userInfoEnd + 1 : authority;
+    const char* hostEnd = authority + authorityLength;
+    const char* portStart = NULL;
+
+    if (*hostStart == '[')
+    {
+        // An IPv6 literal needs no resolving.
+        return false;
+    }
+
+    portStart = memchr(hostStart, ':', (size_t)(hostEnd - hostStart));
+    if (portStart != NULL)
+    {
+        char portText[8];
+        const size_t portLength = (size_t)(hostEnd - portStart - 1);
+        if (portLength == 0 || portLength >= sizeof(portText))
+        {
+            return false;
+        }
+
+        ADUC_Safe_StrCopyN(portText, portStart + 1, sizeof(portText), portLength);
+        if (!atoui(portText, port) || *port == 0 || *port > UINT16_MAX)
+        {
+            return false;
+        }
+
+        hostEnd = portStart;
+    }
+
+    const size_t hostLength = (size_t)(hostEnd - hostStart);
+    if (hostLength == 0 || hostLength >= hostSize)
+    {
+        return false;
+    }
+
+    ADUC_Safe_StrCopyN(host, hostStart, hostSize, hostLength);
+    return true;
+}
+
+bool ADUC_DnsCache_GetCurlResolve(ADUC_DnsCache* cache, const char* url, char* resolve, size_t resolveSize)
+{
+    char host[ADUC_DNS_MAX_NAME];
+    char addressText[48];
+    ADUC_DnsAddress address;
+    ADUC_DnsAddress addresses[ADUC_DNS_MAX_ADDRESSES];
+    unsigned int port = 0;
+
+    if (cache == NULL || url == NULL || resolve == NULL
+        || !GetUrlHostAndPort(url, host, sizeof(host), &port) || ADUC_Dns_ParseAddress(host, &address))
+    {
+        return false;
+    }
+
+    const size_t count = ADUC_DnsCache_Lookup(cache, host, addresses, ADUC_DNS_MAX_ADDRESSES);
+    if (count == 0)
+    {
+        return false;
+    }
+
+    // curl matches the host of the URL as given, so the name is not normalized here.
+    int length = snprintf(resolve, resolveSize, "%s:%u:", host, port);
+    for (size_t i = 0; i < count && length > 0 && (size_t)length < resolveSize; ++i)
+    {
+        if (!ADUC_Dns_FormatAddress(&addresses[i], true, addressText, sizeof(addressText)))
+        {
+            return false;
+        }
+
+        length += snprintf(resolve + length, resolveSize - (size_t)length, "%s%s", (i == 0) ? "" : ",", addressText);
+    }
+
+    return length > 0 && (size_t)length < resolveSize;
+}
+
+void ADUC_DnsCache_GetStats(ADUC_DnsCache* cache, ADUC_DnsCache_Stats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (cache != NULL)
+    {
+        pthread_mutex_lock(&cache->mutex);
+        *stats = cache->stats;
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
@@ -0,0 +1,359 @@
+/**
+ * @file dns_message.c
+ * @brief Implements DNS queries and responses for the address lookups of the DNS cache.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/dns_message.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN
+
+#include <arpa/inet.h> // inet_pton, inet_ntop
+#include <ctype.h> // tolower
+#include <string.h>
+#include <sys/socket.h> // AF_INET, AF_INET6
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define DNS_HEADER_SIZE 12
+#define DNS_CLASS_IN 1
+#define DNS_FLAG_RESPONSE 0x8000
+#define DNS_FLAG_TRUNCATED 0x0200
+#define DNS_FLAG_RECURSION_DESIRED 0x0100
+#define DNS_RCODE_MASK 0x000F
+#define DNS_MAX_LABEL 63
+
+/**
+ * @brief Maximum number of compression pointers followed in one name, to stop at pointer loops.
+ */
+#define DNS_MAX_POINTERS 16
+
+/**
+ * @brief Maximum number of CNAME records followed from the queried name.
+ */
+#define DNS_MAX_CNAME_CHAIN 8
+
+static uint16_t ReadU16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t ReadU32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void WriteU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+size_t ADUC_Dns_BuildQuery(uint8_t* buffer, size_t bufferSize, uint16_t id, const char* name, ADUC_DnsType type)
+{
+    size_t length = DNS_HEADER_SIZE;
+
+    if (buffer == NULL || name == NULL || *name == '\0' || bufferSize < DNS_HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    memset(buffer, 0, DNS_HEADER_SIZE);
+    WriteU16(buffer, id);
+    WriteU16(buffer + 2, DNS_FLAG_RECURSION_DESIRED);
+    WriteU16(buffer + 4, 1); // QDCOUNT
+
+    for (const char* label = name; *label != '\0';)
+    {
+        const size_t labelLength = strcspn(label, ".");
+        if (labelLength == 0 || labelLength > DNS_MAX_LABEL || length + 1 + labelLength >= bufferSize)
+        {
+            return 0;
+        }
+
+        buffer[length++] = (uint8_t)labelLength;
+        memcpy(buffer + length, label, labelLength);
+        length += labelLength;
+
+        label += labelLength;
+        if (*label == '.')
+        {
+            ++label;
+        }
+    }
+
+    // The root label, QTYPE and QCLASS.
+    if (length + 5 > bufferSize || length - DNS_HEADER_SIZE + 1 > ADUC_DNS_MAX_NAME - 1)
+    {
+        return 0;
+    }
+
+    buffer[length++] = 0;
+    WriteU16(buffer + length, (uint16_t)type);
+    WriteU16(buffer + length + 2, DNS_CLASS_IN);
+    return length + 4;
+}
+
+/**
+ * @brief Reads the possibly compressed name at @p *offset in text form, without the trailing dot,
+ * and advances @p *offset past it.
+ */
+static bool ReadName(const uint8_t* message, size_t length, size_t* offset, char* name, size_t nameSize)
+{
+    size_t position = *offset;
+    size_t nameLength = 0;
+    size_t end = 0;
+    unsigned int pointers = 0;
+
+    for (;;)
+    {
+        if (position >= length)
+        {
+            return false;
+        }
+
+        const uint8_t labelLength = message[position];
+        if ((labelLength & 0xC0) == 0xC0)
+        {
+            if (position + 1 >= length || ++pointers > DNS_MAX_POINTERS)
+            {
+                return false;
+            }
+
+            if (end == 0)
+            {
+                end = position + 2;
+            }
+
+            position = ((size_t)(labelLength & 0x3F) << 8) | message[position + 1];
+            continue;
+        }
+
+        if ((labelLength & 0xC0) != 0 || position + 1 + labelLength > length)
+        {
+            return false;
+        }
+
+        if (labelLength == 0)
+        {
+            break;
+        }
+
+        if (nameLength + (nameLength != 0 ? 1 : 0) + labelLength >= nameSize)
+        {
+            return false;
+        }
+
+        if (nameLength != 0)
+        {
+            name[nameLength++] = '.';
+        }
+
+        memcpy(name + nameLength, message + position + 1, labelLength);
+        nameLength += labelLength;
+        position += 1 + (size_t)labelLength;
+    }
+
+    name[nameLength] = '\0';
+    *offset = (end != 0) ? end : position + 1;
+    return true;
+}
+
+/**
+ * @brief Compares domain names case-insensitively, ignoring a trailing dot.
+ */
+static bool IsSameName(const char* a, const char* b)
+{
+    for (;; ++a, ++b)
+    {
+        const bool aEnd = (*a == '\0' || (*a == '.' && a[1] == '\0'));
+        const bool bEnd = (*b == '\0' || (*b == '.' && b[1] == '\0'));
+        if (aEnd || bEnd)
+        {
+            return aEnd && bEnd;
+        }
+
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+        {
+            return false;
+        }
+    }
+}
+
+bool ADUC_Dns_ParseResponse(
+    const uint8_t* message,
+    size_t length,
+    uint16_t id,
+    const char* name,
+    ADUC_DnsType type,
+    ADUC_DnsResponse* response)
+{
+    char owner[ADUC_DNS_MAX_NAME];
+    char target[ADUC_DNS_MAX_NAME];
+    size_t offset = DNS_HEADER_SIZE;
+    unsigned int cnameCount = 0;
+    uint32_t chainTtl = UINT32_MAX;
+    uint32_t addressTtl = UINT32_MAX;
+
+    memset(response, 0, sizeof(*response));
+
+    if (message == NULL || name == NULL || length < DNS_HEADER_SIZE || ReadU16(message) != id)
+    {
+        return false;
+    }
+
+    const uint16_t flags = ReadU16(message + 2);
+    const uint16_t questionCount = ReadU16(message + 4);
+    const uint16_t answerCount = ReadU16(message + 6);
+
+    if ((flags & DNS_FLAG_RESPONSE) == 0 || questionCount != 1)
+    {
+        return false;
+    }
+
+    response->rcode = flags & DNS_RCODE_MASK;
+    response->truncated = (flags & DNS_FLAG_TRUNCATED) != 0;
+
+    // The question must be the one that was asked.
+    if (!ReadName(message, length, &offset, owner, sizeof(owner)) || offset + 4 > length
+        || !IsSameName(owner, name) || ReadU16(message + offset) != (uint16_t)type)
+    {
+        return false;
+    }
+
+    offset += 4;
+    ADUC_Safe_StrCopyN(target, name, sizeof(target), strlen(name));
+
+    // Records are usually ordered along the CNAME chain, but need not be, so the answers are scanned until
+    // the chain does not advance any more.
+    for (bool advanced = true; advanced && cnameCount <= DNS_MAX_CNAME_CHAIN;)
+    {
+        size_t recordOffset = offset;
+        advanced = false;
+        response->addressCount = 0;
+        addressTtl = UINT32_MAX;
+
+        for (uint16_t i = 0; i < answerCount; ++i)
+        {
+            if (!ReadName(message, length, &recordOffset, owner, sizeof(owner)) || recordOffset + 10 > length)
+            {
+                return false;
+            }
+
+            const uint16_t recordType = ReadU16(message + recordOffset);
+            const uint16_t recordClass = ReadU16(message + recordOffset + 2);
+            const uint32_t ttl = ReadU32(message + recordOffset + 4);
+            const uint16_t dataLength = ReadU16(message + recordOffset + 8);
+            const size_t dataOffset = recordOffset + 10;
+
+            if (dataOffset + dataLength > length)
+            {
+                return false;
+            }
+
+            recordOffset = dataOffset + dataLength;
+
+            if (recordClass != DNS_CLASS_IN || !IsSameName(owner, target))
+            {
+                continue;
+            }
+
+            if (recordType == ADUC_DnsType_CNAME && response->addressCount == 0)
+            {
+                size_t nameOffset = dataOffset;
+                if (!ReadName(message, length, &nameOffset, target, sizeof(target)))
+                {
+                    return false;
+                }
+
+                chainTtl = (ttl < chainTtl) ? ttl : chainTtl;
+                ++cnameCount;
+                advanced = true;
+                break;
+            }
+
+            const size_t addressLength = (recordType == ADUC_DnsType_A) ? 4 : 16;
+            if (recordType != (uint16_t)type || dataLength != addressLength)
+            {
+                continue;
+            }
+
+            if (response->addressCount < ADUC_DNS_MAX_ADDRESSES)
+            {
+                ADUC_DnsAddress* address = &response->addresses[response->addressCount++];
+                address->family = (type == ADUC_DnsType_A) ? AF_INET : AF_INET6;
+                memcpy(address->bytes, message + dataOffset, addressLength);
+            }
+
+            addressTtl = (ttl < addressTtl) ? ttl : addressTtl;
+        }
+    }
+
+    if (response->addressCount != 0)
+    {
+        response->ttl = (chainTtl < addressTtl) ? chainTtl : addressTtl;
+    }
+
+    return true;
+}
+
+bool ADUC_Dns_ParseAddress(const char* text, ADUC_DnsAddress* address)
+{
+    char buffer[48];
+    size_t length = (text != NULL) ? strlen(text) : 0;
+
+    memset(address, 0, sizeof(*address));
+
+    if (length == 0 || length >= sizeof(buffer))
+    {
+        return false;
+    }
+
+    if (text[0] == '[')
+    {
+        if (length < 3 || text[length - 1] != ']')
+        {
+            return false;
+        }
+
+        ADUC_Safe_StrCopyN(buffer, text + 1, sizeof(buffer), length - 2);
+        address->family = AF_INET6;
+        return inet_pton(AF_INET6, buffer, address->bytes) == 1;
+    }
+
+    ADUC_Safe_StrCopyN(buffer, text, sizeof(buffer), length);
+    address->family = (strchr(buffer, ':') != NULL) ? AF_INET6 : AF_INET;
+    return inet_pton(address->family, buffer, address->bytes) == 1;
+}
+
+bool ADUC_Dns_FormatAddress(const ADUC_DnsAddress* address, bool bracketIPv6, char* text, size_t textSize)
+{
+    char buffer[INET6_ADDRSTRLEN];
+
+    if (inet_ntop(address->family, address->bytes, buffer, sizeof(buffer)) == NULL)
+    {
+        return false;
+    }
+
+    const bool bracket = bracketIPv6 && address->family == AF_INET6;
+    const size_t length = strlen(buffer) + (bracket ? 2 : 0);
+    if (length >= textSize)
+    {
+        return false;
+    }
+
+    if (bracket)
+    {
+        text[0] = '[';
+        memcpy(text + 1, buffer, length - 2);
+        text[length - 1] = ']';
+        text[length] = '\0';
+    }
+    else
+    {
+        memcpy(text, buffer, length + 1);
+    }
+
+    return true;
+}
@@ -0,0 +1,748 @@
+/**
+ * @file dns_cache_utils_ut.cpp
+ * @brief Unit Tests for dns_cache_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/dns_cache_utils.h"
+#include "aduc/dns_message.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <parson.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define TEST_DIR "/tmp/adutest/dns_cache_utils_ut"
+
+/**
+ * @brief The records of a name on the stub DNS server.
+ */
+struct StubRecord
+{
+    std::vector<std::string> ipv4;
+    std::vector<std::string> ipv6;
+    uint32_t ttl = 300;
+    std::string cname;
+    uint32_t cnameTtl = 300;
+    bool nxdomain = false;
+    bool truncated = false;
+};
+
+static void AppendU16(std::vector<uint8_t>& message, uint16_t value)
+{
+    message.push_back(static_cast<uint8_t>(value >> 8));
+    message.push_back(static_cast<uint8_t>(value));
+}
+
+static void AppendU32(std::vector<uint8_t>& message, uint32_t value)
+{
+    AppendU16(message, static_cast<uint16_t>(value >> 16));
+    AppendU16(message, static_cast<uint16_t>(value));
+}
+
+static void AppendName(std::vector<uint8_t>& message, const std::string& name)
+{
+    size_t start = 0;
+    while (start < name.size())
+    {
+        size_t end = name.find('.', start);
+        end = (end == std::string::npos) ? name.size() : end;
+        message.push_back(static_cast<uint8_t>(end - start));
+        message.insert(message.end(), name.begin() + static_cast<long>(start), name.begin() + static_cast<long>(end));
+        start = end + 1;
+    }
+
+    message.push_back(0);
+}
+
+/**
+ * @brief Builds the response to @p query from @p record, compressing names like real servers do.
+ * Also called by the stub server thread, so it must not use the Catch assertion macros.
+ */
+static std::vector<uint8_t> BuildResponse(const std::vector<uint8_t>& query, const StubRecord& record)
+{
+    size_t questionEnd = 12;
+    while (questionEnd < query.size() && query[questionEnd] != 0)
+    {
+        questionEnd += 1 + query[questionEnd];
+    }
+
+    questionEnd += 5;
+    if (questionEnd > query.size())
+    {
+        return {};
+    }
+
+    const uint16_t type = static_cast<uint16_t>((query[questionEnd - 4] << 8) | query[questionEnd - 3]);
+    const std::vector<std::string>& addresses = (type == ADUC_DnsType_A) ? record.ipv4 : record.ipv6;
+    const uint16_t answerCount =
+        record.nxdomain ? 0 : static_cast<uint16_t>(addresses.size() + (record.cname.empty() ? 0 : 1));
+
+    std::vector<uint8_t> response{ query[0], query[1] };
+    AppendU16(response, static_cast<uint16_t>(0x8180 | (record.nxdomain ? 3 : 0) | (record.truncated ? 0x0200 : 0)));
+    AppendU16(response, 1);
+    AppendU16(response, answerCount);
+    AppendU16(response, 0);
+    AppendU16(response, 0);
+    response.insert(response.end(), query.begin() + 12, query.begin() + static_cast<long>(questionEnd));
+
+    if (record.nxdomain)
+    {
+        return response;
+    }
+
+    uint16_t owner = 0xC00C;
+    if (!record.cname.empty())
+    {
+        AppendU16(response, owner);
+        AppendU16(response, ADUC_DnsType_CNAME);
+        AppendU16(response, 1);
+        AppendU32(response, record.cnameTtl);
+        AppendU16(response, static_cast<uint16_t>(record.cname.size() + 2));
+        owner = static_cast<uint16_t>(0xC000 | response.size());
+        AppendName(response, record.cname);
+    }
+
+    for (const std::string& text : addresses)
+    {
+        uint8_t bytes[16];
+        const int family = (type == ADUC_DnsType_A) ? AF_INET : AF_INET6;
+        if (inet_pton(family, text.c_str(), bytes) != 1)
+        {
+            return {};
+        }
+
+        AppendU16(response, owner);
+        AppendU16(response, type);
+        AppendU16(response, 1);
+        AppendU32(response, record.ttl);
+        AppendU16(response, (family == AF_INET) ? 4 : 16);
+        response.insert(response.end(), bytes, bytes + ((family == AF_INET) ? 4 : 16));
+    }
+
+    return response;
+}
+
+static std::vector<uint8_t> BuildQuery(const char* name, ADUC_DnsType type, uint16_t id = 0x1234)
+{
+    uint8_t buffer[ADUC_DNS_MAX_MESSAGE];
+    const size_t length = ADUC_Dns_BuildQuery(buffer, sizeof(buffer), id, name, type);
+    REQUIRE(length != 0);
+    return std::vector<uint8_t>(buffer, buffer + length);
+}
+
+static bool ParseResponse(
+    const std::vector<uint8_t>& message, uint16_t id, const char* name, ADUC_DnsType type, ADUC_DnsResponse* response)
+{
+    return ADUC_Dns_ParseResponse(message.data(), message.size(), id, name, type, response);
+}
+
+/**
+ * @brief A DNS server on loopback that answers from configured records and counts the queries.
+ */
+class StubDnsServer
+{
+public:
+    StubDnsServer()
+    {
+        _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        REQUIRE(_fd >= 0);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        REQUIRE(bind(_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+        REQUIRE(getsockname(_fd, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+        _port = ntohs(address.sin_port);
+
+        _thread = std::thread{ [this]() { Serve(); } };
+    }
+
+    ~StubDnsServer()
+    {
+        _stopping = true;
+        _thread.join();
+        close(_fd);
+    }
+
+    StubDnsServer(const StubDnsServer&) = delete;
+    StubDnsServer& operator=(const StubDnsServer&) = delete;
+    StubDnsServer(StubDnsServer&&) = delete;
+    StubDnsServer& operator=(StubDnsServer&&) = delete;
+
+    void SetRecord(const std::string& name, const StubRecord& record)
+    {
+        std::lock_guard<std::mutex> lock{ _mutex };
+        _records[name] = record;
+    }
+
+    /**
+     * @brief Drops all queries, like an unreachable nameserver.
+     */
+    void SetDown(bool down)
+    {
+        _down = down;
+    }
+
+    unsigned int Queries() const
+    {
+        return _queries;
+    }
+
+    std::string Nameserver() const
+    {
+        return "127.0.0.1:" + std::to_string(_port);
+    }
+
+private:
+    void Serve()
+    {
+        uint8_t buffer[ADUC_DNS_MAX_MESSAGE];
+
+        while (!_stopping)
+        {
+            pollfd pfd{ _fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 50) <= 0)
+            {
+                continue;
+            }
+
+            sockaddr_storage peer{};
+            socklen_t peerLength = sizeof(peer);
+            const ssize_t received =
+                recvfrom(_fd, buffer, sizeof(buffer), 0, reinterpret_cast<sockaddr*>(&peer), &peerLength);
+            if (received < 12)
+            {
+                continue;
+            }
+
+            ++_queries;
+            if (_down)
+            {
+                continue;
+            }
+
+            std::string name;
+            for (size_t i = 12; i < static_cast<size_t>(received) && buffer[i] != 0; i += 1 + buffer[i])
+            {
+                name += (name.empty() ? "" : ".") + std::string{ reinterpret_cast<char*>(buffer) + i + 1, buffer[i] };
+            }
+
+            StubRecord record;
+            {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                auto it = _records.find(name);
+                if (it == _records.end())
+                {
+                    record.nxdomain = true;
+                }
+                else
+                {
+                    record = it->second;
+                }
+            }
+
+            const std::vector<uint8_t> response =
+                BuildResponse(std::vector<uint8_t>(buffer, buffer + received), record);
+            sendto(_fd, response.data(), response.size(), 0, reinterpret_cast<sockaddr*>(&peer), peerLength);
+        }
+    }
+
+    int _fd = -1;
+    unsigned short _port = 0;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::map<std::string, StubRecord> _records;
+    std::atomic<bool> _stopping{ false };
+    std::atomic<bool> _down{ false };
+    std::atomic<unsigned int> _queries{ 0 };
+};
+
+static time_t s_now = 1700000000;
+
+static time_t GetTestTime()
+{
+    return s_now;
+}
+
+static ADUC_DnsCache_Config ParseConfig(const char* json)
+{
+    ADUC_DnsCache_Config config;
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    REQUIRE(ADUC_DnsCache_ParseConfig(&config, json_value_get_object(value)));
+    json_value_free(value);
+    return config;
+}
+
+static std::string ReadFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+class TestFolder
+{
+public:
+    TestFolder() : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+        _hostsFile = _dir.GetDir() + "/hosts";
+        std::ofstream{ HostsFile() } << "# test hosts\n10.1.2.3 myhost.local alias # comment\nfd00::3 myhost.local\n";
+    }
+
+    TestFolder(const TestFolder&) = delete;
+    TestFolder& operator=(const TestFolder&) = delete;
+    TestFolder(TestFolder&&) = delete;
+    TestFolder& operator=(TestFolder&&) = delete;
+
+    const std::string& HostsFile() const
+    {
+        return _hostsFile;
+    }
+
+    std::string PersistFile() const
+    {
+        return _dir.GetDir() + "/" ADUC_DNS_CACHE_FILE_NAME;
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+    std::string _hostsFile;
+};
+
+/**
+ * @brief Creates a cache that asks only @p server, and reads the clock from s_now.
+ */
+static ADUC_DnsCache* CreateCache(const StubDnsServer& server, const TestFolder& folder, bool persist = false)
+{
+    const std::string json = R"({"minTtlSeconds":10,"maxTtlSeconds":600,"staleSeconds":3600,)"
+                             R"("negativeTtlSeconds":20,"timeoutMs":200,"nameservers":[")"
+        + server.Nameserver() + R"("]})";
+    ADUC_DnsCache_Config config = ParseConfig(json.c_str());
+    config.hostsFile = folder.HostsFile().c_str();
+    config.clock = GetTestTime;
+
+    ADUC_DnsCache* cache = ADUC_DnsCache_Create(&config, persist ? folder.PersistFile().c_str() : nullptr);
+    REQUIRE(cache != nullptr);
+    return cache;
+}
+
+static std::vector<std::string> Lookup(ADUC_DnsCache* cache, const char* host)
+{
+    ADUC_DnsAddress addresses[ADUC_DNS_MAX_ADDRESSES];
+    char text[48];
+    std::vector<std::string> result;
+
+    const size_t count = ADUC_DnsCache_Lookup(cache, host, addresses, ADUC_DNS_MAX_ADDRESSES);
+    for (size_t i = 0; i < count; ++i)
+    {
+        REQUIRE(ADUC_Dns_FormatAddress(&addresses[i], false, text, sizeof(text)));
+        result.emplace_back(text);
+    }
+
+    return result;
+}
+
+static ADUC_DnsCache_Stats GetStats(ADUC_DnsCache* cache)
+{
+    ADUC_DnsCache_Stats stats;
+    ADUC_DnsCache_GetStats(cache, &stats);
+    return stats;
+}
+
+static bool WaitForRefreshes(ADUC_DnsCache* cache, unsigned int refreshes)
+{
+    for (int i = 0; i < 100 && GetStats(cache).refreshes < refreshes; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+    }
+
+    return GetStats(cache).refreshes >= refreshes;
+}
+
+using Addresses = std::vector<std::string>;
+
+TEST_CASE("ADUC_Dns_BuildQuery")
+{
+    uint8_t buffer[ADUC_DNS_MAX_MESSAGE];
+
+    SECTION("Encodes the question")
+    {
+        const std::vector<uint8_t> query = BuildQuery("dl.example.com.", ADUC_DnsType_AAAA, 0xBEEF);
+        const std::vector<uint8_t> expected{ 0xBE, 0xEF, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0, 2, 'd', 'l', 7,
+                                             'e',  'x',  'a',  'm',  'p', 'l', 'e', 3, 'c', 'o', 'm', 0, 0, 28, 0, 1 };
+        CHECK(query == expected);
+    }
+
+    SECTION("Rejects invalid names")
+    {
+        CHECK(ADUC_Dns_BuildQuery(buffer, sizeof(buffer), 1, "", ADUC_DnsType_A) == 0);
+        CHECK(ADUC_Dns_BuildQuery(buffer, sizeof(buffer), 1, "a..b", ADUC_DnsType_A) == 0);
+        CHECK(ADUC_Dns_BuildQuery(buffer, sizeof(buffer), 1, (std::string(64, 'a') + ".com").c_str(), ADUC_DnsType_A)
+              == 0);
+        CHECK(ADUC_Dns_BuildQuery(buffer, 20, 1, "example.com", ADUC_DnsType_A) == 0);
+    }
+}
+
+TEST_CASE("ADUC_Dns_ParseResponse")
+{
+    ADUC_DnsResponse response;
+    char text[48];
+
+    SECTION("Follows CNAMEs to the addresses with the smallest TTL")
+    {
+        StubRecord record;
+        record.cname = "edge.cdn.test";
+        record.cnameTtl = 120;
+        record.ipv4 = { "192.0.2.1", "192.0.2.2" };
+        record.ttl = 300;
+
+        const std::vector<uint8_t> query = BuildQuery("dl.example.com", ADUC_DnsType_A);
+        const std::vector<uint8_t> message = BuildResponse(query, record);
+        REQUIRE(ParseResponse(message, 0x1234, "DL.example.com.", ADUC_DnsType_A, &response));
+        CHECK(response.rcode == ADUC_DnsRcode_NoError);
+        CHECK_FALSE(response.truncated);
+        CHECK(response.ttl == 120);
+        REQUIRE(response.addressCount == 2);
+        REQUIRE(ADUC_Dns_FormatAddress(&response.addresses[1], false, text, sizeof(text)));
+        CHECK(std::string{ text } == "192.0.2.2");
+
+        record.ttl = 60;
+        const std::vector<uint8_t> shorter = BuildResponse(query, record);
+        REQUIRE(ParseResponse(shorter, 0x1234, "dl.example.com", ADUC_DnsType_A, &response));
+        CHECK(response.ttl == 60);
+    }
+
+    SECTION("Reports NXDOMAIN and truncation")
+    {
+        StubRecord record;
+        record.nxdomain = true;
+        const std::vector<uint8_t> query = BuildQuery("missing.test", ADUC_DnsType_A);
+        std::vector<uint8_t> message = BuildResponse(query, record);
+        REQUIRE(ParseResponse(message, 0x1234, "missing.test", ADUC_DnsType_A, &response));
+        CHECK(response.rcode == ADUC_DnsRcode_NxDomain);
+        CHECK(response.addressCount == 0);
+
+        record = StubRecord{};
+        record.truncated = true;
+        message = BuildResponse(query, record);
+        REQUIRE(ParseResponse(message, 0x1234, "missing.test", ADUC_DnsType_A, &response));
+        CHECK(response.truncated);
+    }
+
+    SECTION("Rejects responses to other queries and malformed responses")
+    {
+        StubRecord record;
+        record.ipv6 = { "2001:db8::1" };
+        const std::vector<uint8_t> query = BuildQuery("host.test", ADUC_DnsType_AAAA);
+        std::vector<uint8_t> message = BuildResponse(query, record);
+
+        CHECK(ParseResponse(message, 0x1234, "host.test", ADUC_DnsType_AAAA, &response));
+        CHECK_FALSE(ParseResponse(message, 0x4321, "host.test", ADUC_DnsType_AAAA, &response));
+        CHECK_FALSE(ParseResponse(message, 0x1234, "other.test", ADUC_DnsType_AAAA, &response));
+        CHECK_FALSE(ParseResponse(message, 0x1234, "host.test", ADUC_DnsType_A, &response));
+        CHECK_FALSE(ParseResponse(query, 0x1234, "host.test", ADUC_DnsType_AAAA, &response));
+        const std::vector<uint8_t> cut(message.begin(), message.end() - 1);
+        CHECK_FALSE(ParseResponse(cut, 0x1234, "host.test", ADUC_DnsType_AAAA, &response));
+
+        // An answer owner that points at itself.
+        message[query.size()] = 0xC0;
+        message[query.size() + 1] = static_cast<uint8_t>(query.size());
+        CHECK_FALSE(ParseResponse(message, 0x1234, "host.test", ADUC_DnsType_AAAA, &response));
+    }
+}
+
+TEST_CASE("ADUC_Dns_ParseAddress and ADUC_Dns_FormatAddress")
+{
+    ADUC_DnsAddress address;
+    char text[48];
+
+    REQUIRE(ADUC_Dns_ParseAddress("192.0.2.7", &address));
+    CHECK(address.family == AF_INET);
+    REQUIRE(ADUC_Dns_FormatAddress(&address, true, text, sizeof(text)));
+    CHECK(std::string{ text } == "192.0.2.7");
+
+    REQUIRE(ADUC_Dns_ParseAddress("[2001:db8::7]", &address));
+    CHECK(address.family == AF_INET6);
+    REQUIRE(ADUC_Dns_FormatAddress(&address, true, text, sizeof(text)));
+    CHECK(std::string{ text } == "[2001:db8::7]");
+    REQUIRE(ADUC_Dns_FormatAddress(&address, false, text, sizeof(text)));
+    CHECK(std::string{ text } == "2001:db8::7");
+    CHECK_FALSE(ADUC_Dns_FormatAddress(&address, true, text, 12));
+
+    CHECK_FALSE(ADUC_Dns_ParseAddress("example.com", &address));
+    CHECK_FALSE(ADUC_Dns_ParseAddress("192.0.2.256", &address));
+    CHECK_FALSE(ADUC_Dns_ParseAddress("[192.0.2.1]", &address));
+    CHECK_FALSE(ADUC_Dns_ParseAddress("", &address));
+}
+
+TEST_CASE("ADUC_DnsCache_ParseConfig")
+{
+    ADUC_DnsCache_Config config;
+
+    SECTION("Not configured")
+    {
+        CHECK(ADUC_DnsCache_ParseConfig(&config, nullptr));
+        CHECK_FALSE(config.enabled);
+    }
+
+    SECTION("Defaults")
+    {
+        config = ParseConfig("{}");
+        CHECK(config.enabled);
+        CHECK(config.minTtlSeconds == 30);
+        CHECK(config.maxTtlSeconds == 3600);
+        CHECK(config.staleSeconds == 86400);
+        CHECK(config.negativeTtlSeconds == 30);
+        CHECK(config.timeoutMs == 2000);
+        CHECK(config.maxEntries == 64);
+        CHECK(config.nameserverCount == 0);
+    }
+
+    SECTION("Full configuration")
+    {
+        config = ParseConfig(R"({"minTtlSeconds":5,"maxTtlSeconds":60,"staleSeconds":0,"negativeTtlSeconds":0,)"
+                             R"("timeoutMs":500,"maxEntries":8,)"
+                             R"("nameservers":["10.0.0.1","127.0.0.1:5353","[::1]:53"]})");
+        CHECK(config.minTtlSeconds == 5);
+        CHECK(config.maxTtlSeconds == 60);
+        CHECK(config.staleSeconds == 0);
+        CHECK(config.negativeTtlSeconds == 0);
+        CHECK(config.timeoutMs == 500);
+        CHECK(config.maxEntries == 8);
+        REQUIRE(config.nameserverCount == 3);
+        CHECK(std::string{ config.nameservers[2] } == "[::1]:53");
+    }
+
+    SECTION("Invalid configurations")
+    {
+        for (const char* json : { R"({"minTtlSeconds":100,"maxTtlSeconds":10})",
+                                  R"({"timeoutMs":0})",
+                                  R"({"maxEntries":0})",
+                                  R"({"staleSeconds":-1})",
+                                  R"({"nameservers":"10.0.0.1"})",
+                                  R"({"nameservers":["dns.example.com"]})",
+                                  R"({"nameservers":["10.0.0.1:0"]})",
+                                  R"({"nameservers":["10.0.0.1","10.0.0.2","10.0.0.3","10.0.0.4"]})" })
+        {
+            JSON_Value* value = json_parse_string(json);
+            REQUIRE(value != nullptr);
+            CHECK_FALSE(ADUC_DnsCache_ParseConfig(&config, json_value_get_object(value)));
+            CHECK_FALSE(config.enabled);
+            json_value_free(value);
+        }
+    }
+}
+
+TEST_CASE("ADUC_DnsCache serves cached addresses with a stub DNS server")
+{
+    TestFolder folder;
+    StubDnsServer server;
+    StubRecord record;
+    record.ipv4 = { "192.0.2.10" };
+    record.ipv6 = { "2001:db8::10" };
+    record.ttl = 60;
+    server.SetRecord("download.example.test", record);
+
+    ADUC_DnsCache* cache = CreateCache(server, folder);
+
+    SECTION("Entries are served within their TTL")
+    {
+        CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.10", "2001:db8::10" });
+        CHECK(server.Queries() == 2);
+
+        s_now += 59;
+        CHECK(Lookup(cache, "Download.Example.Test.") == Addresses{ "192.0.2.10", "2001:db8::10" });
+        CHECK(server.Queries() == 2);
+        CHECK(GetStats(cache).hits == 1);
+    }
+
+    SECTION("TTLs are clamped to the configured bounds")
+    {
+        record.ttl = 1;
+        server.SetRecord("short.example.test", record);
+        CHECK(Lookup(cache, "short.example.test").size() == 2);
+
+        s_now += 9;
+        CHECK(Lookup(cache, "short.example.test").size() == 2);
+        CHECK(GetStats(cache).hits == 1);
+        CHECK(server.Queries() == 2);
+    }
+
+    SECTION("Expired entries are served while they are refreshed in the background")
+    {
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+
+        record.ipv4 = { "192.0.2.11" };
+        server.SetRecord("download.example.test", record);
+        s_now += 61;
+
+        CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.10", "2001:db8::10" });
+        CHECK(GetStats(cache).staleHits == 1);
+        REQUIRE(WaitForRefreshes(cache, 1));
+
+        CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.11", "2001:db8::10" });
+        CHECK(GetStats(cache).hits == 1);
+        CHECK(server.Queries() == 4);
+    }
+
+    SECTION("The last known addresses are served when the nameserver is down")
+    {
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+
+        server.SetDown(true);
+        s_now += 61;
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+        REQUIRE(WaitForRefreshes(cache, 1));
+
+        // Past the stale window the name is resolved while waiting, and the last known addresses are served.
+        s_now += 3600;
+        CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.10", "2001:db8::10" });
+        CHECK(GetStats(cache).lastKnownGoodHits == 1);
+        const unsigned int queries = server.Queries();
+
+        // The failed resolve is not retried for minTtlSeconds.
+        s_now += 5;
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+        CHECK(server.Queries() == queries);
+        CHECK(GetStats(cache).lastKnownGoodHits == 2);
+
+        CHECK(Lookup(cache, "never-resolved.example.test").empty());
+        CHECK(GetStats(cache).failures == 1);
+    }
+
+    SECTION("Nonexistent names are cached briefly")
+    {
+        CHECK(Lookup(cache, "missing.example.test").empty());
+        CHECK(server.Queries() == 2);
+
+        s_now += 19;
+        CHECK(Lookup(cache, "missing.example.test").empty());
+        CHECK(server.Queries() == 2);
+        CHECK(GetStats(cache).negativeHits == 1);
+
+        server.SetRecord("missing.example.test", record);
+        s_now += 1;
+        CHECK(Lookup(cache, "missing.example.test").size() == 2);
+        CHECK(server.Queries() == 4);
+    }
+
+    SECTION("Names of the hosts file and address literals are not cached")
+    {
+        CHECK(Lookup(cache, "MyHost.local.") == Addresses{ "10.1.2.3", "fd00::3" });
+        CHECK(Lookup(cache, "alias") == Addresses{ "10.1.2.3" });
+        CHECK(Lookup(cache, "192.0.2.99") == Addresses{ "192.0.2.99" });
+        CHECK(Lookup(cache, "[2001:db8::99]") == Addresses{ "2001:db8::99" });
+        CHECK(server.Queries() == 0);
+
+        CHECK(Lookup(cache, "bad name.test").empty());
+        CHECK(Lookup(cache, "").empty());
+    }
+
+    SECTION("The least recently used entry is evicted")
+    {
+        ADUC_DnsCache_Destroy(cache);
+        std::string json = R"({"maxEntries":1,"timeoutMs":200,"nameservers":[")" + server.Nameserver() + R"("]})";
+        ADUC_DnsCache_Config config = ParseConfig(json.c_str());
+        config.hostsFile = folder.HostsFile().c_str();
+        config.clock = GetTestTime;
+        cache = ADUC_DnsCache_Create(&config, nullptr);
+        REQUIRE(cache != nullptr);
+
+        server.SetRecord("other.example.test", record);
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+        CHECK(Lookup(cache, "other.example.test").size() == 2);
+        CHECK(Lookup(cache, "download.example.test").size() == 2);
+        CHECK(server.Queries() == 6);
+    }
+
+    ADUC_DnsCache_Destroy(cache);
+}
+
+TEST_CASE("ADUC_DnsCache persists the last known addresses")
+{
+    TestFolder folder;
+    StubDnsServer server;
+    StubRecord record;
+    record.ipv4 = { "192.0.2.20" };
+    record.ttl = 300;
+    server.SetRecord("download.example.test", record);
+
+    ADUC_DnsCache* cache = CreateCache(server, folder, true);
+    CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.20" });
+    CHECK(Lookup(cache, "missing.example.test").empty());
+    ADUC_DnsCache_Destroy(cache);
+
+    const std::string content = ReadFile(folder.PersistFile());
+    CHECK(content.find("download.example.test") != std::string::npos);
+    CHECK(content.find("missing.example.test") == std::string::npos);
+
+    // After a restart without a reachable nameserver, the persisted addresses are served.
+    server.SetDown(true);
+    s_now += 10000;
+    cache = CreateCache(server, folder, true);
+    CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.20" });
+    CHECK(GetStats(cache).lastKnownGoodHits + GetStats(cache).staleHits == 1);
+    ADUC_DnsCache_Destroy(cache);
+
+    // A file from a clock far ahead is cut to maxTtlSeconds.
+    server.SetDown(false);
+    record.ipv4 = { "192.0.2.21" };
+    server.SetRecord("download.example.test", record);
+    std::ofstream{ folder.PersistFile(), std::ios::trunc }
+        << R"({"entries":[{"name":"download.example.test","expiresAt":4000000000,"addresses":["192.0.2.20"]}]})";
+    cache = CreateCache(server, folder, true);
+    CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.20" });
+    s_now += 601;
+    CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.20" });
+    REQUIRE(WaitForRefreshes(cache, 1));
+    CHECK(Lookup(cache, "download.example.test") == Addresses{ "192.0.2.21" });
+    ADUC_DnsCache_Destroy(cache);
+}
+
+TEST_CASE("ADUC_DnsCache_GetCurlResolve")
+{
+    TestFolder folder;
+    StubDnsServer server;
+    StubRecord record;
+    record.ipv4 = { "192.0.2.30" };
+    record.ipv6 = { "2001:db8::30" };
+    server.SetRecord("download.example.test", record);
+
+    ADUC_DnsCache* cache = CreateCache(server, folder);
+    char resolve[ADUC_DNS_CACHE_MAX_CURL_RESOLVE];
+
+    REQUIRE(ADUC_DnsCache_GetCurlResolve(cache, "https://download.example.test/a/b.swu?x=1", resolve, sizeof(resolve)));
+    CHECK(std::string{ resolve } == "download.example.test:443:192.0.2.30,[2001:db8::30]");
+
+    REQUIRE(ADUC_DnsCache_GetCurlResolve(cache, "http://user@download.example.test:8080", resolve, sizeof(resolve)));
+    CHECK(std::string{ resolve } == "download.example.test:8080:192.0.2.30,[2001:db8::30]");
+
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "https://download.example.test/", resolve, 30));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "https://192.0.2.1/x", resolve, sizeof(resolve)));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "https://[2001:db8::1]/x", resolve, sizeof(resolve)));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "ftp://download.example.test/x", resolve, sizeof(resolve)));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "https://download.example.test:0/x", resolve, sizeof(resolve)));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(cache, "https://missing.example.test/x", resolve, sizeof(resolve)));
+    CHECK_FALSE(ADUC_DnsCache_GetCurlResolve(nullptr, "https://download.example.test/", resolve, sizeof(resolve)));
+
+    ADUC_DnsCache_Destroy(cache);
+}
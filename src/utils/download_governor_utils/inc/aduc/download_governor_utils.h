@@ -0,0 +1,165 @@
+/**
+ * @file download_governor_utils.h
+ * @brief Process-wide download bandwidth governor.
+ *
+ * The governor is configured by the optional "downloadThrottle" object of du-config.json:
+ *
+ *   "downloadThrottle": {
+ *       "maxKBps": 512,
+ *       "burstKB": 256,
+ *       "windows": [ { "start": "08:00", "end": "18:00", "maxKBps": 64 } ],
+ *       "linkOverrides": { "wwan": 32, "ppp": 32 }
+ *   }
+ *
+ * maxKBps is the rate outside of all windows. A window applies its own rate in local time and may
+ * span midnight; the first matching window wins. When the interface of the default route starts
+ * with a linkOverrides key, that rate overrides the time-of-day rate. A rate of 0 means unlimited.
+ *
+ * All transfers of the process draw from one token bucket. The configuration file is re-read when
+ * it changes, so the limits can be adjusted without restarting the agent.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_DOWNLOAD_GOVERNOR_UTILS_H
+#define ADUC_DOWNLOAD_GOVERNOR_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum number of time-of-day windows.
+ */
+#define ADUC_DOWNLOAD_GOVERNOR_MAX_WINDOWS 8
+
+/**
+ * @brief Maximum number of link overrides.
+ */
+#define ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_OVERRIDES 8
+
+/**
+ * @brief Maximum length of a link override interface prefix, including the terminator.
+ */
+#define ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_NAME 16
+
+/**
+ * @brief Seconds between two checks of the configuration file and the default route.
+ */
+#define ADUC_DOWNLOAD_GOVERNOR_REFRESH_INTERVAL_SECONDS 5
+
+/**
+ * @brief A time-of-day window with its own rate.
+ */
+typedef struct tagADUC_DownloadGovernor_Window
+{
+    unsigned int startMinute; /**< Window start, in minutes after local midnight. */
+    unsigned int endMinute; /**< Window end (exclusive), in minutes after local midnight. */
+    unsigned int maxKBps; /**< Rate in the window, in KiB/s. 0 is unlimited. */
+} ADUC_DownloadGovernor_Window;
+
+/**
+ * @brief A rate that applies while the default route uses a matching interface.
+ */
+typedef struct tagADUC_DownloadGovernor_LinkOverride
+{
+    char interfacePrefix[ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_NAME]; /**< Interface name prefix, e.g. "wwan". */
+    unsigned int maxKBps; /**< Rate on this link, in KiB/s. 0 is unlimited. */
+} ADUC_DownloadGovernor_LinkOverride;
+
+/**
+ * @brief The download throttle policy.
+ */
+typedef struct tagADUC_DownloadGovernor_Policy
+{
+    bool enabled; /**< True if "downloadThrottle" is configured. */
+    unsigned int maxKBps; /**< Rate outside of all windows, in KiB/s. 0 is unlimited. */
+    unsigned int burstKB; /**< Bucket size, in KiB. 0 is one second worth of the current rate. */
+    size_t windowCount; /**< Number of entries in windows. */
+    ADUC_DownloadGovernor_Window windows[ADUC_DOWNLOAD_GOVERNOR_MAX_WINDOWS]; /**< Time-of-day windows. */
+    size_t linkOverrideCount; /**< Number of entries in linkOverrides. */
+    ADUC_DownloadGovernor_LinkOverride linkOverrides[ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_OVERRIDES]; /**< Overrides. */
+} ADUC_DownloadGovernor_Policy;
+
+/**
+ * @brief A token bucket in bytes. Callers may overdraw it, and then wait for the debt to be refilled.
+ */
+typedef struct tagADUC_TokenBucket
+{
+    double rate; /**< Refill rate, in bytes per second. */
+    double burst; /**< Bucket size, in bytes. */
+    double tokens; /**< Available bytes. Negative when overdrawn. */
+    double lastRefillTime; /**< Time of the last refill, in seconds. */
+} ADUC_TokenBucket;
+
+/**
+ * @brief Parses the "downloadThrottle" configuration object.
+ *
+ * @param policy The policy to initialize.
+ * @param throttleObj The configuration object, or NULL if not configured.
+ * @return true on success. On failure, @p policy is disabled.
+ */
+bool ADUC_DownloadGovernor_ParsePolicy(ADUC_DownloadGovernor_Policy* policy, const JSON_Object* throttleObj);
+
+/**
+ * @brief Gets the rate that applies at @p minuteOfDay on @p linkName.
+ *
+ * @param policy The policy.
+ * @param minuteOfDay Minutes after local midnight.
+ * @param linkName The interface of the default route, or NULL if unknown.
+ * @return unsigned int The rate in KiB/s. 0 is unlimited.
+ */
+unsigned int ADUC_DownloadGovernor_GetRateKBps(
+    const ADUC_DownloadGovernor_Policy* policy, unsigned int minuteOfDay, const char* linkName);
+
+/**
+ * @brief Finds the interface of the default route in the content of /proc/net/route.
+ *
+ * @param content The file content.
+ * @param[out] name The interface name.
+ * @param nameSize The size of @p name.
+ * @return true if a default route was found.
+ */
+bool ADUC_DownloadGovernor_ParseDefaultRouteInterface(const char* content, char* name, size_t nameSize);
+
+/**
+ * @brief Sets the rate and size of @p bucket. A bucket with no rate yet starts full.
+ *
+ * @param bucket The bucket.
+ * @param rate Refill rate, in bytes per second. Must be positive.
+ * @param burst Bucket size, in bytes. Must be positive.
+ * @param now The current time, in seconds.
+ */
+void ADUC_TokenBucket_SetRate(ADUC_TokenBucket* bucket, double rate, double burst, double now);
+
+/**
+ * @brief Takes @p bytes from @p bucket.
+ *
+ * @param bucket The bucket.
+ * @param bytes The number of bytes transferred.
+ * @param now The current time, in seconds.
+ * @return double The seconds to wait before transferring more.
+ */
+double ADUC_TokenBucket_Reserve(ADUC_TokenBucket* bucket, size_t bytes, double now);
+
+/**
+ * @brief Checks whether a download throttle is configured.
+ *
+ * @return true if transfers should be paced with ADUC_DownloadGovernor_Throttle().
+ */
+bool ADUC_DownloadGovernor_IsEnabled(void);
+
+/**
+ * @brief Accounts @p bytes received by a transfer, and blocks the caller as long as the current rate requires.
+ * @remark Thread-safe. Concurrent transfers share the bandwidth budget.
+ *
+ * @param bytes The number of bytes received.
+ */
+void ADUC_DownloadGovernor_Throttle(size_t bytes);
+
+EXTERN_C_END
+
+#endif // ADUC_DOWNLOAD_GOVERNOR_UTILS_H
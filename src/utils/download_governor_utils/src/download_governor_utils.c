@@ -0,0 +1,455 @@
+/**
+ * @file download_governor_utils.c
+ * @brief Implements the process-wide download bandwidth governor.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/download_governor_utils.h"
+#include "aduc/config_utils.h" // ADUC_CONFIG_FOLDER_ENV
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_ParseTimeOfDay, ADUC_StringFormat, IsNullOrEmpty, LoadBufferWithFileContents
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h> // UINT32_MAX
+#include <stdio.h> // sscanf
+#include <stdlib.h> // getenv
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define MINUTES_PER_DAY (24 * 60)
+#define BYTES_PER_KB 1024.0
+
+static const char* CONFIG_DOWNLOAD_THROTTLE = "downloadThrottle";
+static const char* CONFIG_MAX_KBPS = "maxKBps";
+static const char* CONFIG_BURST_KB = "burstKB";
+static const char* CONFIG_WINDOWS = "windows";
+static const char* CONFIG_WINDOW_START = "start";
+static const char* CONFIG_WINDOW_END = "end";
+static const char* CONFIG_LINK_OVERRIDES = "linkOverrides";
+
+static const char* PROC_NET_ROUTE_PATH = "/proc/net/route";
+
+/**
+ * @brief Reads a non-negative integer rate or size field.
+ *
+ * @return false if the field is present but not a non-negative number.
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 0 || number > (double)UINT32_MAX)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+bool ADUC_DownloadGovernor_ParsePolicy(ADUC_DownloadGovernor_Policy* policy, const JSON_Object* throttleObj)
+{
+    bool succeeded = false;
+
+    memset(policy, 0, sizeof(*policy));
+
+    if (throttleObj == NULL)
+    {
+        return true;
+    }
+
+    if (!GetUIntField(throttleObj, CONFIG_MAX_KBPS, &policy->maxKBps)
+        || !GetUIntField(throttleObj, CONFIG_BURST_KB, &policy->burstKB))
+    {
+        Log_Error(
+            "Invalid %s, expected non-negative %s and %s.", CONFIG_DOWNLOAD_THROTTLE, CONFIG_MAX_KBPS, CONFIG_BURST_KB);
+        goto done;
+    }
+
+    const JSON_Array* windows = json_object_get_array(throttleObj, CONFIG_WINDOWS);
+    size_t windowCount = json_array_get_count(windows);
+    if (windowCount > ADUC_DOWNLOAD_GOVERNOR_MAX_WINDOWS)
+    {
+        Log_Error(
+            "Too many %s.%s, at most %d are supported.",
+            CONFIG_DOWNLOAD_THROTTLE,
+            CONFIG_WINDOWS,
+            ADUC_DOWNLOAD_GOVERNOR_MAX_WINDOWS);
+        goto done;
+    }
+
+    for (size_t i = 0; i < windowCount; ++i)
+    {
+        const JSON_Object* windowObj = json_array_get_object(windows, i);
+        ADUC_DownloadGovernor_Window* window = &policy->windows[i];
+
+        if (windowObj == NULL
+            || !ADUC_ParseTimeOfDay(json_object_get_string(windowObj, CONFIG_WINDOW_START), &window->startMinute)
+            || !ADUC_ParseTimeOfDay(json_object_get_string(windowObj, CONFIG_WINDOW_END), &window->endMinute)
+            || window->startMinute == window->endMinute || !json_object_has_value(windowObj, CONFIG_MAX_KBPS)
+            || !GetUIntField(windowObj, CONFIG_MAX_KBPS, &window->maxKBps))
+        {
+            Log_Error(
+                "Invalid %s.%s[%zu], expected 'HH:MM' start and end and a %s.",
+                CONFIG_DOWNLOAD_THROTTLE,
+                CONFIG_WINDOWS,
+                i,
+                CONFIG_MAX_KBPS);
+            goto done;
+        }
+    }
+    policy->windowCount = windowCount;
+
+    const JSON_Object* linkOverrides = json_object_get_object(throttleObj, CONFIG_LINK_OVERRIDES);
+    size_t linkOverrideCount = json_object_get_count(linkOverrides);
+    if (linkOverrideCount > ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_OVERRIDES)
+    {
+        Log_Error(
+            "Too many %s.%s, at most %d are supported.",
+            CONFIG_DOWNLOAD_THROTTLE,
+            CONFIG_LINK_OVERRIDES,
+            ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_OVERRIDES);
+        goto done;
+    }
+
+    for (size_t i = 0; i < linkOverrideCount; ++i)
+    {
+        const char* prefix = json_object_get_name(linkOverrides, i);
+        ADUC_DownloadGovernor_LinkOverride* linkOverride = &policy->linkOverrides[i];
+
+        if (IsNullOrEmpty(prefix) || strlen(prefix) >= sizeof(linkOverride->interfacePrefix)
+            || !GetUIntField(linkOverrides, prefix, &linkOverride->maxKBps))
+        {
+            Log_Error("Invalid %s.%s entry %zu.", CONFIG_DOWNLOAD_THROTTLE, CONFIG_LINK_OVERRIDES, i);
+            goto done;
+        }
+
+        strcpy(linkOverride->interfacePrefix, prefix);
+    }
+    policy->linkOverrideCount = linkOverrideCount;
+
+    policy->enabled = true;
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(policy, 0, sizeof(*policy));
+    }
+
+    return succeeded;
+}
+
+unsigned int ADUC_DownloadGovernor_GetRateKBps(
+    const ADUC_DownloadGovernor_Policy* policy, unsigned int minuteOfDay, const char* linkName)
+{
+    if (!policy->enabled)
+    {
+        return 0;
+    }
+
+    if (!IsNullOrEmpty(linkName))
+    {
+        for (size_t i = 0; i < policy->linkOverrideCount; ++i)
+        {
+            const char* prefix = policy->linkOverrides[i].interfacePrefix;
+            if (strncmp(linkName, prefix, strlen(prefix)) == 0)
+            {
+                return policy->linkOverrides[i].maxKBps;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < policy->windowCount; ++i)
+    {
+        const ADUC_DownloadGovernor_Window* window = &policy->windows[i];
+        bool inWindow = (window->startMinute < window->endMinute)
+            ? (minuteOfDay >= window->startMinute && minuteOfDay < window->endMinute)
+            : (minuteOfDay >= window->startMinute || minuteOfDay < window->endMinute);
+
+        if (inWindow)
+        {
+            return window->maxKBps;
+        }
+    }
+
+    return policy->maxKBps;
+}
+
+bool ADUC_DownloadGovernor_ParseDefaultRouteInterface(const char* content, char* name, size_t nameSize)
+{
+    if (content == NULL || name == NULL || nameSize == 0)
+    {
+        return false;
+    }
+
+    // Skip the header line: "Iface Destination Gateway Flags ..."
+    const char* line = strchr(content, '\n');
+
+    while (line != NULL)
+    {
+        ++line;
+
+        char iface[ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_NAME * 2];
+        char destination[16];
+        if (sscanf(line, "%31s %15s", iface, destination) == 2 && strcmp(destination, "00000000") == 0)
+        {
+            if (strlen(iface) >= nameSize)
+            {
+                return false;
+            }
+
+            strcpy(name, iface);
+            return true;
+        }
+
+        line = strchr(line, '\n');
+    }
+
+    return false;
+}
+
+void ADUC_TokenBucket_SetRate(ADUC_TokenBucket* bucket, double rate, double burst, double now)
+{
+    if (bucket->rate <= 0)
+    {
+        bucket->tokens = burst;
+    }
+    else
+    {
+        // Settle the time elapsed so far at the old rate.
+        bucket->tokens += (now - bucket->lastRefillTime) * bucket->rate;
+        if (bucket->tokens > burst)
+        {
+            bucket->tokens = burst;
+        }
+    }
+
+    bucket->rate = rate;
+    bucket->burst = burst;
+    bucket->lastRefillTime = now;
+}
+
+double ADUC_TokenBucket_Reserve(ADUC_TokenBucket* bucket, size_t bytes, double now)
+{
+    if (now > bucket->lastRefillTime)
+    {
+        bucket->tokens += (now - bucket->lastRefillTime) * bucket->rate;
+        if (bucket->tokens > bucket->burst)
+        {
+            bucket->tokens = bucket->burst;
+        }
+
+        bucket->lastRefillTime = now;
+    }
+
+    bucket->tokens -= (double)bytes;
+
+    return (bucket->tokens < 0) ? -bucket->tokens / bucket->rate : 0;
+}
+
+//
+// Process-wide governor
+//
+
+/**
+ * @brief The state shared by all transfers of the process.
+ */
+typedef struct tagADUC_DownloadGovernor
+{
+    pthread_mutex_t mutex; /**< Guards all other members. */
+    bool loaded; /**< True once the configuration has been read. */
+    double nextRefreshTime; /**< Monotonic time of the next configuration and route check. */
+    time_t configModifiedTime; /**< Modification time of the configuration file that was read. */
+    ADUC_DownloadGovernor_Policy policy; /**< The current policy. */
+    char linkName[ADUC_DOWNLOAD_GOVERNOR_MAX_LINK_NAME * 2]; /**< Interface of the default route. */
+    unsigned int rateKBps; /**< The rate the bucket is configured for. 0 is unlimited. */
+    ADUC_TokenBucket bucket; /**< The shared bucket. */
+} ADUC_DownloadGovernor;
+
+static ADUC_DownloadGovernor s_governor = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static double GetMonotonicSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int GetLocalMinuteOfDay(void)
+{
+    time_t now = time(NULL);
+    struct tm local;
+    if (localtime_r(&now, &local) == NULL)
+    {
+        return 0;
+    }
+
+    return (unsigned int)(local.tm_hour * 60 + local.tm_min) % MINUTES_PER_DAY;
+}
+
+/**
+ * @brief Re-reads the policy if the configuration file changed since it was last read.
+ * @remark Called with the governor mutex held.
+ */
+static void RefreshPolicy(ADUC_DownloadGovernor* governor)
+{
+    JSON_Value* rootValue = NULL;
+    const char* configFolder = getenv(ADUC_CONFIG_FOLDER_ENV);
+    char* configFilePath =
+        ADUC_StringFormat("%s/%s", IsNullOrEmpty(configFolder) ? ADUC_CONF_FOLDER : configFolder, ADUC_CONF_FILE);
+
+    if (configFilePath == NULL)
+    {
+        goto done;
+    }
+
+    struct stat st;
+    if (stat(configFilePath, &st) != 0)
+    {
+        if (governor->policy.enabled)
+        {
+            Log_Warn("Cannot stat %s, errno: %d. Download throttle disabled.", configFilePath, errno);
+        }
+
+        memset(&governor->policy, 0, sizeof(governor->policy));
+        governor->configModifiedTime = 0;
+        goto done;
+    }
+
+    if (governor->loaded && st.st_mtime == governor->configModifiedTime)
+    {
+        goto done;
+    }
+
+    governor->configModifiedTime = st.st_mtime;
+
+    rootValue = json_parse_file(configFilePath);
+    if (rootValue == NULL)
+    {
+        Log_Error("Failed parse of JSON file: %s", configFilePath);
+        goto done;
+    }
+
+    ADUC_DownloadGovernor_ParsePolicy(
+        &governor->policy, json_object_get_object(json_value_get_object(rootValue), CONFIG_DOWNLOAD_THROTTLE));
+
+done:
+    governor->loaded = true;
+    json_value_free(rootValue);
+    free(configFilePath);
+}
+
+/**
+ * @brief Updates the interface of the default route, if link overrides are configured.
+ * @remark Called with the governor mutex held.
+ */
+static void RefreshLinkName(ADUC_DownloadGovernor* governor)
+{
+    char content[4096];
+
+    governor->linkName[0] = '\0';
+
+    if (governor->policy.linkOverrideCount == 0)
+    {
+        return;
+    }
+
+    if (LoadBufferWithFileContents(PROC_NET_ROUTE_PATH, content, sizeof(content)))
+    {
+        ADUC_DownloadGovernor_ParseDefaultRouteInterface(content, governor->linkName, sizeof(governor->linkName));
+    }
+}
+
+/**
+ * @brief Refreshes the configuration periodically and applies the rate for the current time and link.
+ * @remark Called with the governor mutex held.
+ */
+static void UpdateRate(ADUC_DownloadGovernor* governor, double now)
+{
+    if (!governor->loaded || now >= governor->nextRefreshTime)
+    {
+        RefreshPolicy(governor);
+        RefreshLinkName(governor);
+        governor->nextRefreshTime = now + ADUC_DOWNLOAD_GOVERNOR_REFRESH_INTERVAL_SECONDS;
+    }
+
+    unsigned int rateKBps =
+        ADUC_DownloadGovernor_GetRateKBps(&governor->policy, GetLocalMinuteOfDay(), governor->linkName);
+
+    if (rateKBps != governor->rateKBps)
+    {
+        Log_Info(
+            "Download throttle %u KiB/s (link: '%s').",
+            rateKBps,
+            governor->linkName[0] == '\0' ? "unknown" : governor->linkName);
+        governor->rateKBps = rateKBps;
+    }
+
+    if (rateKBps == 0)
+    {
+        memset(&governor->bucket, 0, sizeof(governor->bucket));
+        return;
+    }
+
+    double rate = rateKBps * BYTES_PER_KB;
+    double burst = (governor->policy.burstKB != 0) ? governor->policy.burstKB * BYTES_PER_KB : rate;
+
+    if (rate != governor->bucket.rate || burst != governor->bucket.burst)
+    {
+        ADUC_TokenBucket_SetRate(&governor->bucket, rate, burst, now);
+    }
+}
+
+bool ADUC_DownloadGovernor_IsEnabled(void)
+{
+    pthread_mutex_lock(&s_governor.mutex);
+    UpdateRate(&s_governor, GetMonotonicSeconds());
+    bool enabled = s_governor.policy.enabled;
+    pthread_mutex_unlock(&s_governor.mutex);
+
+    return enabled;
+}
+
+void ADUC_DownloadGovernor_Throttle(size_t bytes)
+{
+    double waitSeconds = 0;
+
+    pthread_mutex_lock(&s_governor.mutex);
+
+    double now = GetMonotonicSeconds();
+    UpdateRate(&s_governor, now);
+
+    if (s_governor.rateKBps != 0)
+    {
+        waitSeconds = ADUC_TokenBucket_Reserve(&s_governor.bucket, bytes, now);
+    }
+
+    pthread_mutex_unlock(&s_governor.mutex);
+
+    if (waitSeconds > 0)
+    {
+        struct timespec delay;
+        delay.tv_sec = (time_t)waitSeconds;
+        delay.tv_nsec = (long)((waitSeconds - (double)delay.tv_sec) * 1e9);
+
+        while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+        {
+        }
+    }
+}
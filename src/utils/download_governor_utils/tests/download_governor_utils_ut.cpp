@@ -0,0 +1,222 @@
+/**
+ * @file download_governor_utils_ut.cpp
+ * @brief Unit Tests for download_governor_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/download_governor_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <parson.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/adutest/download_governor_utils_ut"
+
+static ADUC_DownloadGovernor_Policy ParsePolicy(const char* json)
+{
+    ADUC_DownloadGovernor_Policy policy;
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    REQUIRE(ADUC_DownloadGovernor_ParsePolicy(&policy, json_value_get_object(value)));
+    json_value_free(value);
+    return policy;
+}
+
+static bool ParsePolicyFails(const char* json)
+{
+    ADUC_DownloadGovernor_Policy policy;
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool failed = !ADUC_DownloadGovernor_ParsePolicy(&policy, json_value_get_object(value)) && !policy.enabled;
+    json_value_free(value);
+    return failed;
+}
+
+TEST_CASE("ADUC_DownloadGovernor_ParsePolicy")
+{
+    SECTION("Not configured")
+    {
+        ADUC_DownloadGovernor_Policy policy;
+        REQUIRE(ADUC_DownloadGovernor_ParsePolicy(&policy, nullptr));
+        CHECK_FALSE(policy.enabled);
+    }
+
+    SECTION("Full policy")
+    {
+        ADUC_DownloadGovernor_Policy policy = ParsePolicy(
+            R"({"maxKBps":512,"burstKB":256,)"
+            R"("windows":[{"start":"08:00","end":"18:00","maxKBps":64}],)"
+            R"("linkOverrides":{"wwan":32}})");
+
+        CHECK(policy.enabled);
+        CHECK(policy.maxKBps == 512);
+        CHECK(policy.burstKB == 256);
+        REQUIRE(policy.windowCount == 1);
+        CHECK(policy.windows[0].startMinute == 8 * 60);
+        CHECK(policy.windows[0].endMinute == 18 * 60);
+        CHECK(policy.windows[0].maxKBps == 64);
+        REQUIRE(policy.linkOverrideCount == 1);
+        CHECK(std::string{ policy.linkOverrides[0].interfacePrefix } == "wwan");
+        CHECK(policy.linkOverrides[0].maxKBps == 32);
+    }
+
+    SECTION("Invalid policies")
+    {
+        CHECK(ParsePolicyFails(R"({"maxKBps":-1})"));
+        CHECK(ParsePolicyFails(R"({"maxKBps":"fast"})"));
+        CHECK(ParsePolicyFails(R"({"windows":[{"start":"8:00","end":"18:00","maxKBps":64}]})"));
+        CHECK(ParsePolicyFails(R"({"windows":[{"start":"08:00","end":"08:00","maxKBps":64}]})"));
+        CHECK(ParsePolicyFails(R"({"windows":[{"start":"08:00","end":"18:00"}]})"));
+        CHECK(ParsePolicyFails(R"({"linkOverrides":{"wwan":-5}})"));
+    }
+}
+
+TEST_CASE("ADUC_DownloadGovernor_GetRateKBps")
+{
+    ADUC_DownloadGovernor_Policy policy = ParsePolicy(
+        R"({"maxKBps":512,)"
+        R"("windows":[{"start":"08:00","end":"18:00","maxKBps":64},{"start":"22:00","end":"02:00","maxKBps":0}],)"
+        R"("linkOverrides":{"wwan":32,"ppp":16}})");
+
+    SECTION("Time of day")
+    {
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 7 * 60 + 59, "eth0") == 512);
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 8 * 60, "eth0") == 64);
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 18 * 60, nullptr) == 512);
+    }
+
+    SECTION("Window spanning midnight")
+    {
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 23 * 60, "eth0") == 0);
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 60, "eth0") == 0);
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 2 * 60, "eth0") == 512);
+    }
+
+    SECTION("Link override wins over the time of day")
+    {
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 23 * 60, "wwan0") == 32);
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&policy, 12 * 60, "ppp0") == 16);
+    }
+
+    SECTION("Disabled policy is unlimited")
+    {
+        ADUC_DownloadGovernor_Policy disabled = {};
+        CHECK(ADUC_DownloadGovernor_GetRateKBps(&disabled, 12 * 60, "wwan0") == 0);
+    }
+}
+
+TEST_CASE("ADUC_DownloadGovernor_ParseDefaultRouteInterface")
+{
+    const char* routes =
+        "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\tMetric\tMask\t\tMTU\tWindow\tIRTT\n"
+        "eth0\t0002A8C0\t00000000\t0001\t0\t0\t100\t00FFFFFF\t0\t0\t0\n"
+        "wwan0\t00000000\t0102A8C0\t0003\t0\t0\t700\t00000000\t0\t0\t0\n";
+    char name[32];
+
+    REQUIRE(ADUC_DownloadGovernor_ParseDefaultRouteInterface(routes, name, sizeof(name)));
+    CHECK(std::string{ name } == "wwan0");
+
+    CHECK_FALSE(ADUC_DownloadGovernor_ParseDefaultRouteInterface(
+        "Iface\tDestination\n eth0\t0002A8C0\n", name, sizeof(name)));
+    CHECK_FALSE(ADUC_DownloadGovernor_ParseDefaultRouteInterface(routes, name, 3));
+}
+
+TEST_CASE("ADUC_TokenBucket")
+{
+    ADUC_TokenBucket bucket = {};
+
+    SECTION("Starts full and paces after the burst")
+    {
+        ADUC_TokenBucket_SetRate(&bucket, 1000, 500, 10.0);
+
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 500, 10.0) == Approx(0));
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 1000, 10.0) == Approx(1.0));
+
+        // The debt is refilled after the wait.
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 100, 11.0) == Approx(0.1));
+    }
+
+    SECTION("Idle time refills at most the burst")
+    {
+        ADUC_TokenBucket_SetRate(&bucket, 1000, 500, 0.0);
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 500, 0.0) == Approx(0));
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 1500, 100.0) == Approx(1.0));
+    }
+
+    SECTION("Rate change settles at the old rate")
+    {
+        ADUC_TokenBucket_SetRate(&bucket, 1000, 1000, 0.0);
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 2000, 0.0) == Approx(1.0));
+
+        ADUC_TokenBucket_SetRate(&bucket, 100, 1000, 0.5);
+        CHECK(bucket.tokens == Approx(-500));
+        CHECK(ADUC_TokenBucket_Reserve(&bucket, 0, 0.5) == Approx(5.0));
+    }
+}
+
+TEST_CASE("ADUC_DownloadGovernor_Throttle paces a loopback transfer")
+{
+    aduc::AutoDir dir{ TEST_DIR }; // auto rmdir on scope exit
+    REQUIRE(dir.RemoveDir());
+    REQUIRE(dir.CreateDir());
+    const std::string folder = dir.GetDir();
+    const std::string configFile = folder + "/" + ADUC_CONF_FILE;
+
+    {
+        std::ofstream config{ configFile };
+        config << R"({"downloadThrottle":{"maxKBps":256,"burstKB":64}})";
+    }
+
+    REQUIRE(setenv("ADUC_CONF_FOLDER", folder.c_str(), 1) == 0);
+    REQUIRE(ADUC_DownloadGovernor_IsEnabled());
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    const size_t totalBytes = 256 * 1024;
+    const size_t chunkSize = 16 * 1024;
+
+    std::thread writer{ [&]() {
+        std::string chunk(chunkSize, 'x');
+        for (size_t sent = 0; sent < totalBytes; sent += chunkSize)
+        {
+            if (write(fds[0], chunk.data(), chunk.size()) != static_cast<ssize_t>(chunk.size()))
+            {
+                break;
+            }
+        }
+        close(fds[0]);
+    } };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t received = 0;
+    char buffer[chunkSize];
+    ssize_t readSize;
+    while ((readSize = read(fds[1], buffer, sizeof(buffer))) > 0)
+    {
+        received += static_cast<size_t>(readSize);
+        ADUC_DownloadGovernor_Throttle(static_cast<size_t>(readSize));
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    writer.join();
+    close(fds[1]);
+    unsetenv("ADUC_CONF_FOLDER");
+
+    CHECK(received == totalBytes);
+
+    // 256 KiB at 256 KiB/s with a 64 KiB burst takes 0.75 s.
+    CHECK(elapsed >= 0.7);
+    CHECK(elapsed < 2.0);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file download_transport_utils.h
+ * @brief HTTP version selection for payload downloads.
+ *
+ * The HTTP version is configured by the optional "downloadTransport" object of du-config.json:
+ *
+ *   "downloadTransport": {
+ *       "httpVersion": "http2",
+ *       "endpoints": { "cdn.example.com": "http3", "*.blob.core.windows.net": "http1.1" }
+ *   }
+ *
+ * httpVersion applies to all endpoints that are not listed in endpoints. An endpoint is a host name,
+ * or "*." followed by a domain to match all hosts in the domain; the first matching endpoint wins.
+ *
+ * The versions are "http1.1", "http2", "http3" and "http3Only". "http3" uses HTTP/3 over QUIC, and falls
+ * back to HTTP/2 or HTTP/1.1 over TCP when no QUIC connection can be established, e.g. when UDP is
+ * blocked. "http3Only" does not fall back. Without a configured version, curl picks its default.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_DOWNLOAD_TRANSPORT_UTILS_H
+#define ADUC_DOWNLOAD_TRANSPORT_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum number of configured endpoints.
+ */
+#define ADUC_DOWNLOAD_TRANSPORT_MAX_ENDPOINTS 16
+
+/**
+ * @brief Maximum length of an endpoint host name, including the terminator.
+ */
+#define ADUC_DOWNLOAD_TRANSPORT_MAX_HOST 256
+
+/**
+ * @brief The HTTP version of a download.
+ */
+typedef enum tagADUC_HttpVersion
+{
+    ADUC_HttpVersion_Default = 0, /**< Not configured, curl picks the version. */
+    ADUC_HttpVersion_Http1_1 = 1, /**< HTTP/1.1 over TCP. */
+    ADUC_HttpVersion_Http2 = 2, /**< HTTP/2 over TCP. */
+    ADUC_HttpVersion_Http3 = 3, /**< HTTP/3 over QUIC, with fallback to TCP. */
+    ADUC_HttpVersion_Http3Only = 4, /**< HTTP/3 over QUIC, without fallback. */
+} ADUC_HttpVersion;
+
+/**
+ * @brief An endpoint with its own HTTP version.
+ */
+typedef struct tagADUC_DownloadTransport_Endpoint
+{
+    char host[ADUC_DOWNLOAD_TRANSPORT_MAX_HOST]; /**< Host name, or "*." and a domain. */
+    ADUC_HttpVersion httpVersion; /**< HTTP version for this endpoint. */
+} ADUC_DownloadTransport_Endpoint;
+
+/**
+ * @brief The download transport policy.
+ */
+typedef struct tagADUC_DownloadTransport_Policy
+{
+    ADUC_HttpVersion httpVersion; /**< HTTP version of the endpoints that are not listed. */
+    size_t endpointCount; /**< Number of entries in endpoints. */
+    ADUC_DownloadTransport_Endpoint endpoints[ADUC_DOWNLOAD_TRANSPORT_MAX_ENDPOINTS]; /**< Endpoints. */
+} ADUC_DownloadTransport_Policy;
+
+/**
+ * @brief Parses the "downloadTransport" configuration object.
+ *
+ * @param policy The policy to initialize.
+ * @param transportObj The configuration object, or NULL if not configured.
+ * @return true on success. On failure, @p policy uses the default version for all endpoints.
+ */
+bool ADUC_DownloadTransport_ParsePolicy(ADUC_DownloadTransport_Policy* policy, const JSON_Object* transportObj);
+
+/**
+ * @brief Gets the HTTP version for downloading @p url.
+ *
+ * @param policy The policy.
+ * @param url The download URL.
+ * @return ADUC_HttpVersion The version of the first endpoint that matches the host of @p url, or the
+ * policy version.
+ */
+ADUC_HttpVersion ADUC_DownloadTransport_GetHttpVersion(const ADUC_DownloadTransport_Policy* policy, const char* url);
+
+/**
+ * @brief Gets the curl command line option that selects @p httpVersion.
+ *
+ * @param httpVersion The HTTP version.
+ * @return const char* The option, or NULL for ADUC_HttpVersion_Default.
+ */
+const char* ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion httpVersion);
+
+EXTERN_C_END
+
+#endif // ADUC_DOWNLOAD_TRANSPORT_UTILS_H
@@ -0,0 +1,214 @@
+/**
+ * @file download_transport_utils.c
+ * @brief Implements the HTTP version selection for payload downloads.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/download_transport_utils.h"
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN
+
+#include <aducpal/strings.h> // strcasecmp
+#include <string.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+static const char* CONFIG_DOWNLOAD_TRANSPORT = "downloadTransport";
+static const char* CONFIG_HTTP_VERSION = "httpVersion";
+static const char* CONFIG_ENDPOINTS = "endpoints";
+
+static const char* WILDCARD_PREFIX = "*.";
+
+/**
+ * @brief The configuration names of the HTTP versions, and their curl options.
+ */
+static const struct
+{
+    const char* name;
+    ADUC_HttpVersion httpVersion;
+    const char* curlOption;
+} s_httpVersions[] = {
+    { "http1.1", ADUC_HttpVersion_Http1_1, "--http1.1" },
+    { "http2", ADUC_HttpVersion_Http2, "--http2" },
+    { "http3", ADUC_HttpVersion_Http3, "--http3" },
+    { "http3Only", ADUC_HttpVersion_Http3Only, "--http3-only" },
+};
+
+#define HTTP_VERSION_COUNT (sizeof(s_httpVersions) / sizeof(s_httpVersions[0]))
+
+static bool ParseHttpVersion(const char* name, ADUC_HttpVersion* httpVersion)
+{
+    if (name == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < HTTP_VERSION_COUNT; ++i)
+    {
+        if (strcmp(name, s_httpVersions[i].name) == 0)
+        {
+            *httpVersion = s_httpVersions[i].httpVersion;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ADUC_DownloadTransport_ParsePolicy(ADUC_DownloadTransport_Policy* policy, const JSON_Object* transportObj)
+{
+    bool succeeded = false;
+
+    memset(policy, 0, sizeof(*policy));
+
+    if (transportObj == NULL)
+    {
+        return true;
+    }
+
+    if (json_object_has_value(transportObj, CONFIG_HTTP_VERSION)
+        && !ParseHttpVersion(json_object_get_string(transportObj, CONFIG_HTTP_VERSION), &policy->httpVersion))
+    {
+        Log_Error("Invalid %s.%s.", CONFIG_DOWNLOAD_TRANSPORT, CONFIG_HTTP_VERSION);
+        goto done;
+    }
+
+    const JSON_Object* endpoints = json_object_get_object(transportObj, CONFIG_ENDPOINTS);
+    const size_t endpointCount = json_object_get_count(endpoints);
+    if (endpointCount > ADUC_DOWNLOAD_TRANSPORT_MAX_ENDPOINTS)
+    {
+        Log_Error(
+            "Too many %s.%s, at most %d are supported.",
+            CONFIG_DOWNLOAD_TRANSPORT,
+            CONFIG_ENDPOINTS,
+            ADUC_DOWNLOAD_TRANSPORT_MAX_ENDPOINTS);
+        goto done;
+    }
+
+    for (size_t i = 0; i < endpointCount; ++i)
+    {
+        const char* host = json_object_get_name(endpoints, i);
+        ADUC_DownloadTransport_Endpoint* endpoint = &policy->endpoints[i];
+
+        if (host == NULL || *host == '\0' || strlen(host) >= sizeof(endpoint->host)
+            || !ParseHttpVersion(json_value_get_string(json_object_get_value_at(endpoints, i)), &endpoint->httpVersion))
+        {
+            Log_Error("Invalid %s.%s entry '%s'.", CONFIG_DOWNLOAD_TRANSPORT, CONFIG_ENDPOINTS, host);
+            goto done;
+        }
+
+        ADUC_Safe_StrCopyN(endpoint->host, host, sizeof(endpoint->host), strlen(host));
+    }
+    policy->endpointCount = endpointCount;
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(policy, 0, sizeof(*policy));
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Finds the host of @p url, without user info, port and IPv6 brackets.
+ *
+ * @return bool false if @p url has no host, or a host longer than @p hostSize.
+ */
+static bool GetUrlHost(const char* url, char* host, size_t hostSize)
+{
+    const char* start = strstr(url, "://");
+    if (start == NULL)
+    {
+        return false;
+    }
+
+    start += 3;
+
+    const char* end = start + strcspn(start, "/?#");
+
+    // Skip user info.
+    for (const char* p = start; p < end; ++p)
+    {
+        if (*p == '@')
+        {
+            start = p + 1;
+        }
+    }
+
+    const char* hostEnd = NULL;
+    if (*start == '[')
+    {
+        ++start;
+        hostEnd = memchr(start, ']', (size_t)(end - start));
+    }
+    else
+    {
+        hostEnd = memchr(start, ':', (size_t)(end - start));
+    }
+
+    if (hostEnd == NULL)
+    {
+        hostEnd = end;
+    }
+
+    const size_t length = (size_t)(hostEnd - start);
+    if (length == 0 || length >= hostSize)
+    {
+        return false;
+    }
+
+    ADUC_Safe_StrCopyN(host, start, hostSize, length);
+    return true;
+}
+
+static bool IsMatchingEndpoint(const char* endpoint, const char* host)
+{
+    const size_t prefixLength = strlen(WILDCARD_PREFIX);
+    if (strncmp(endpoint, WILDCARD_PREFIX, prefixLength) != 0)
+    {
+        return ADUCPAL_strcasecmp(endpoint, host) == 0;
+    }
+
+    // "*.example.com" matches "a.example.com" and "a.b.example.com", but not "example.com".
+    const char* domain = endpoint + prefixLength - 1;
+    const size_t domainLength = strlen(domain);
+    const size_t hostLength = strlen(host);
+
+    return hostLength > domainLength && ADUCPAL_strcasecmp(host + hostLength - domainLength, domain) == 0;
+}
+
+ADUC_HttpVersion ADUC_DownloadTransport_GetHttpVersion(const ADUC_DownloadTransport_Policy* policy, const char* url)
+{
+    char host[ADUC_DOWNLOAD_TRANSPORT_MAX_HOST];
+
+    if (url != NULL && GetUrlHost(url, host, sizeof(host)))
+    {
+        for (size_t i = 0; i < policy->endpointCount; ++i)
+        {
+            if (IsMatchingEndpoint(policy->endpoints[i].host, host))
+            {
+                return policy->endpoints[i].httpVersion;
+            }
+        }
+    }
+
+    return policy->httpVersion;
+}
+
+const char* ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion httpVersion)
+{
+    for (size_t i = 0; i < HTTP_VERSION_COUNT; ++i)
+    {
+        if (s_httpVersions[i].httpVersion == httpVersion)
+        {
+            return s_httpVersions[i].curlOption;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file download_transport_utils_ut.cpp
+ * @brief Unit Tests for download_transport_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/download_transport_utils.h"
+
+#include <catch2/catch.hpp>
+using Catch::Matchers::Equals;
+
+#include <parson.h>
+
+static bool ParsePolicy(const char* json, ADUC_DownloadTransport_Policy* policy)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool parsed = ADUC_DownloadTransport_ParsePolicy(policy, json_value_get_object(value));
+    json_value_free(value);
+    return parsed;
+}
+
+TEST_CASE("ADUC_DownloadTransport_ParsePolicy")
+{
+    ADUC_DownloadTransport_Policy policy;
+
+    SECTION("Not configured")
+    {
+        REQUIRE(ADUC_DownloadTransport_ParsePolicy(&policy, nullptr));
+        CHECK(policy.httpVersion == ADUC_HttpVersion_Default);
+        CHECK(policy.endpointCount == 0);
+    }
+
+    SECTION("Full policy")
+    {
+        REQUIRE(ParsePolicy(
+            R"({"httpVersion":"http2","endpoints":{"cdn.example.com":"http3","*.example.net":"http3Only",)"
+            R"("legacy.example.com":"http1.1"}})",
+            &policy));
+        CHECK(policy.httpVersion == ADUC_HttpVersion_Http2);
+        REQUIRE(policy.endpointCount == 3);
+        CHECK_THAT(policy.endpoints[0].host, Equals("cdn.example.com"));
+        CHECK(policy.endpoints[0].httpVersion == ADUC_HttpVersion_Http3);
+        CHECK_THAT(policy.endpoints[1].host, Equals("*.example.net"));
+        CHECK(policy.endpoints[1].httpVersion == ADUC_HttpVersion_Http3Only);
+        CHECK(policy.endpoints[2].httpVersion == ADUC_HttpVersion_Http1_1);
+    }
+
+    SECTION("Invalid policies")
+    {
+        CHECK_FALSE(ParsePolicy(R"({"httpVersion":"quic"})", &policy));
+        CHECK(policy.httpVersion == ADUC_HttpVersion_Default);
+        CHECK_FALSE(ParsePolicy(R"({"httpVersion":3})", &policy));
+        CHECK_FALSE(ParsePolicy(R"({"endpoints":{"cdn.example.com":"http4"}})", &policy));
+        CHECK(policy.endpointCount == 0);
+        CHECK_FALSE(ParsePolicy(R"({"endpoints":{"":"http3"}})", &policy));
+    }
+}
+
+TEST_CASE("ADUC_DownloadTransport_GetHttpVersion")
+{
+    ADUC_DownloadTransport_Policy policy;
+    REQUIRE(ParsePolicy(
+        R"({"httpVersion":"http2","endpoints":{"cdn.example.com":"http3","*.example.net":"http3Only",)"
+        R"("*.example.com":"http1.1"}})",
+        &policy));
+
+    SECTION("Exact host")
+    {
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://cdn.example.com/a/b") == ADUC_HttpVersion_Http3);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://CDN.Example.com/b") == ADUC_HttpVersion_Http3);
+    }
+
+    SECTION("Host with user info and port")
+    {
+        CHECK(
+            ADUC_DownloadTransport_GetHttpVersion(&policy, "https://user:pw@cdn.example.com:8443/b.swu?x=y")
+            == ADUC_HttpVersion_Http3);
+    }
+
+    SECTION("Domain wildcard")
+    {
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://a.example.net/b") == ADUC_HttpVersion_Http3Only);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "http://a.b.example.net") == ADUC_HttpVersion_Http3Only);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://example.net/b") == ADUC_HttpVersion_Http2);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://badexample.net/b") == ADUC_HttpVersion_Http2);
+    }
+
+    SECTION("First matching endpoint wins")
+    {
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://www.example.com/b") == ADUC_HttpVersion_Http1_1);
+    }
+
+    SECTION("Other hosts use the policy version")
+    {
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "https://[2001:db8::1]:443/b") == ADUC_HttpVersion_Http2);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, "not a url") == ADUC_HttpVersion_Http2);
+        CHECK(ADUC_DownloadTransport_GetHttpVersion(&policy, nullptr) == ADUC_HttpVersion_Http2);
+    }
+}
+
+TEST_CASE("ADUC_DownloadTransport_GetCurlOption")
+{
+    CHECK(ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion_Default) == nullptr);
+    CHECK_THAT(ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion_Http1_1), Equals("--http1.1"));
+    CHECK_THAT(ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion_Http2), Equals("--http2"));
+    CHECK_THAT(ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion_Http3), Equals("--http3"));
+    CHECK_THAT(ADUC_DownloadTransport_GetCurlOption(ADUC_HttpVersion_Http3Only), Equals("--http3-only"));
+}
@@ -10,15 +10,53 @@
 #include "aduc/auto_opendir.hpp"
 
 #include <aduc/system_utils.h>
+#include <errno.h>
 #include <queue>
 #include <sstream>
 #include <stdexcept>
 #include <sys/stat.h>
+#include <system_error>
 
 #include <aducpal/dirent.h>
 
 namespace aduc
 {
+#ifdef __linux__
+
+/**
+ * @brief Collects the regular files, skipping hidden files and directories.
+ */
+static int FindFilesInDir_WalkCallback(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    if (entry->name[0] == '.')
+    {
+        return ADUC_DIRWALK_SKIP;
+    }
+
+    if (entry->type == ADUC_DirWalk_EntryType_File)
+    {
+        static_cast<std::vector<std::string>*>(context)->emplace_back(entry->path);
+    }
+
+    // Not a dir or regular file, e.g. fifo(named pipe), socket, symlink, is ignored.
+    return 0;
+}
+
+void findFilesInDir(const std::string& dirPath, std::vector<std::string>* outPaths)
+{
+    if (!SystemUtils_IsDir(dirPath.c_str(), nullptr))
+    {
+        throw std::invalid_argument{ "not a dir" };
+    }
+
+    if (ADUC_SystemUtils_WalkDir(dirPath.c_str(), ADUC_DIRWALK_RECURSIVE, FindFilesInDir_WalkCallback, outPaths) != 0)
+    {
+        throw std::system_error{ errno, std::generic_category(), dirPath };
+    }
+}
+
+#else // __linux__
+
 void findFilesInDir(const std::string& dirPath, std::vector<std::string>* outPaths)
 {
     if (!SystemUtils_IsDir(dirPath.c_str(), nullptr))
@@ -64,4 +102,6 @@ void findFilesInDir(const std::string& dirPath, std::vector<std::string>* outPat
     }
 }
 
+#endif // __linux__
+
 } // namespace aduc
@@ -13,6 +13,8 @@
 
 #include "azure_c_shared_utility/sha.h" // for SHAversion
 
+#include <parson.h> // for JSON_Value
+
 #include <stdbool.h> // for bool
 #include <stddef.h> // for size_t
 
@@ -88,6 +90,16 @@ bool ADUC_HashUtils_VerifyWithStrongestHash(const char* filePath, const ADUC_Has
  */
 bool ADUC_HashUtils_IsValidHashAlgorithm(SHAversion sha);
 
+/**
+ * @brief Computes a digest of a JSON value that does not depend on the order of object members or on formatting.
+ *
+ * @param value The JSON value.
+ * @param algorithm The SHA algorithm.
+ * @param[out] hash The base64 encoded digest. Caller must call free() to deallocate it.
+ * @return bool true on success.
+ */
+bool ADUC_HashUtils_GetJsonValueHash(const JSON_Value* value, SHAversion algorithm, char** hash);
+
 EXTERN_C_END
 
 #endif // ADUC_HASH_UTILS_H
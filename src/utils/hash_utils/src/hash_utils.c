@@ -7,10 +7,14 @@
  */
 #include "aduc/hash_utils.h"
 
+#include <errno.h>
 #include <stdio.h> // for FILE
-#include <stdlib.h> // for calloc
+#include <stdlib.h> // for calloc, qsort
+#include <string.h> // for strcmp, strlen
 
 #include <aducpal/strings.h> // strcasecmp
+#include <aducpal/sys_stat.h> // fstat
+#include <aducpal/unistd.h> // pread
 
 #include <azure_c_shared_utility/azure_base64.h>
 #include <azure_c_shared_utility/buffer_.h>
@@ -18,6 +22,7 @@
 #include <azure_c_shared_utility/sha.h>
 
 #include <aduc/logging.h>
+#include <aduc/system_utils.h> // ADUC_PageCacheStream, ADUC_SystemUtils_GetNextDataRange
 
 /**
  * @brief Helper function gets the calculated hash from the @p context, compares it to @p hashBase64, and returns the appropriate value
@@ -168,6 +173,96 @@ bool ADUC_HashUtils_VerifyWithStrongestHash(const char* filePath, const ADUC_Has
     return true;
 }
 
+/**
+ * @brief Hashes the content of @p file. Holes of sparse files are hashed as zeros without reading them.
+ *
+ * @param file The file.
+ * @param context The hash context.
+ * @param algorithm The hashing algorithm, for logging.
+ * @param suppressErrorLog A boolean indicates whether to log error message inside this function.
+ * @return bool True if the whole content was hashed.
+ */
+static bool HashFileContent(FILE* file, USHAContext* context, SHAversion algorithm, bool suppressErrorLog)
+{
+    static const uint8_t zeros[16 * 1024] = { 0 };
+    bool success = false;
+    uint8_t buffer[16 * 1024];
+    ADUC_PageCacheStream stream;
+    struct stat st;
+    const int fd = fileno(file);
+
+    ADUC_PageCacheStream_Init(&stream, fd, false);
+
+    if (fstat(fd, &st) != 0)
+    {
+        if (!suppressErrorLog)
+        {
+            Log_Error("Cannot stat file, errno: %d", errno);
+        }
+        goto done;
+    }
+
+    off_t dataStart;
+    off_t dataEnd;
+    for (off_t offset = 0; offset < st.st_size; offset = dataEnd)
+    {
+        const int err = ADUC_SystemUtils_GetNextDataRange(fd, offset, st.st_size, &dataStart, &dataEnd);
+        if (err != 0)
+        {
+            if (!suppressErrorLog)
+            {
+                Log_Error("Error finding file data, errno: %d", err);
+            }
+            goto done;
+        }
+
+        for (off_t position = offset; position < dataEnd;)
+        {
+            const bool isHole = position < dataStart;
+            const off_t rangeEnd = isHole ? dataStart : dataEnd;
+            const size_t chunkSize =
+                rangeEnd - position < (off_t)sizeof(buffer) ? (size_t)(rangeEnd - position) : sizeof(buffer);
+            ssize_t readSize = (ssize_t)chunkSize;
+
+            if (!isHole)
+            {
+                readSize = pread(fd, buffer, chunkSize, position);
+                if (readSize < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+
+                if (readSize <= 0)
+                {
+                    if (!suppressErrorLog)
+                    {
+                        Log_Error("Error reading file content.");
+                    }
+                    goto done;
+                }
+            }
+
+            if (USHAInput(context, isHole ? zeros : buffer, (unsigned int)readSize) != 0)
+            {
+                if (!suppressErrorLog)
+                {
+                    Log_Error("Error in SHA Input, SHAversion: %d", algorithm);
+                }
+                goto done;
+            }
+
+            ADUC_PageCacheStream_Advance(&stream, (size_t)readSize);
+            position += readSize;
+        }
+    }
+
+    success = true;
+
+done:
+    ADUC_PageCacheStream_Finish(&stream);
+    return success;
+}
+
 /**
  * @brief Checks if the hash of the file at @p path matches @p hashBase64
  *
@@ -206,34 +301,14 @@ bool ADUC_HashUtils_GetFileHash(const char* path, SHAversion algorithm, char** h
         goto done;
     };
 
-    // Repeatedly read and hash chunks of the file
-    while (!feof(file))
+    if (!HashFileContent(file, &context, algorithm, false /* suppressErrorLog */))
     {
-        uint8_t buffer[USHA_Max_Message_Block_Size];
-        const size_t readSize = fread(buffer, sizeof(buffer[0]), ARRAY_SIZE(buffer), file);
-        if (readSize == 0)
-        {
-            if (ferror(file))
-            {
-                Log_Error("Error reading file content.");
-                goto done;
-            }
-
-            // At the end of file. We're done here.
-            break;
-        }
-
-        if (USHAInput(&context, buffer, (unsigned int)readSize) != 0)
-        {
-            Log_Error("Error in SHA Input, SHAversion: %d", algorithm);
-            goto done;
-        };
+        goto done;
     }
 
     success = GetResultAndCompareHashes(&context, NULL, algorithm, true, hash);
 
 done:
-
     if (file != NULL)
     {
         fclose(file);
@@ -315,34 +390,9 @@ bool ADUC_HashUtils_IsValidFileHash(
         goto done;
     };
 
-    // Repeatedly read and hash chunks of the file
-    while (!feof(file))
+    if (!HashFileContent(file, &context, algorithm, suppressErrorLog))
     {
-        uint8_t buffer[USHA_Max_Message_Block_Size];
-        const size_t readSize = fread(buffer, sizeof(buffer[0]), ARRAY_SIZE(buffer), file);
-        if (readSize == 0)
-        {
-            if (ferror(file))
-            {
-                if (!suppressErrorLog)
-                {
-                    Log_Error("Error reading file content.");
-                }
-                goto done;
-            }
-
-            // At the end of file. We're done here.
-            break;
-        }
-
-        if (USHAInput(&context, buffer, (unsigned int)readSize) != 0)
-        {
-            if (!suppressErrorLog)
-            {
-                Log_Error("Error in SHA Input, SHAversion: %d", algorithm);
-            }
-            goto done;
-        };
+        goto done;
     }
 
     success = GetResultAndCompareHashes(&context, hashBase64, algorithm, suppressErrorLog, NULL /* outputHash */);
@@ -503,3 +553,173 @@ void ADUC_Hash_FreeArray(size_t hashCount, ADUC_Hash* hashArray)
         free(hashArray);
     }
 }
+
+/**
+ * @brief An object member, for visiting the members of an object in name order.
+ */
+typedef struct tagADUC_JsonHashMember
+{
+    const char* name; /**< The member name. */
+    const JSON_Value* value; /**< The member value. */
+} ADUC_JsonHashMember;
+
+static int CompareJsonHashMembers(const void* a, const void* b)
+{
+    return strcmp(((const ADUC_JsonHashMember*)a)->name, ((const ADUC_JsonHashMember*)b)->name);
+}
+
+static bool HashInputString(USHAContext* context, const char* tag, const char* str)
+{
+    char prefix[32];
+    const size_t len = strlen(str);
+    const int prefixLen = snprintf(prefix, sizeof(prefix), "%s%zu:", tag, len);
+
+    return USHAInput(context, (const uint8_t*)prefix, (unsigned int)prefixLen) == 0
+        && USHAInput(context, (const uint8_t*)str, (unsigned int)len) == 0;
+}
+
+/**
+ * @brief Feeds an unambiguous encoding of @p value to @p context. Object members are visited in name order.
+ *
+ * @param context The SHA context.
+ * @param value The JSON value.
+ * @return bool true on success.
+ */
+static bool HashInputJsonValue(USHAContext* context, const JSON_Value* value)
+{
+    bool success = false;
+    ADUC_JsonHashMember* members = NULL;
+    char scratch[64];
+
+    switch (json_value_get_type(value))
+    {
+    case JSONNull:
+        success = HashInputString(context, "z", "");
+        break;
+
+    case JSONBoolean:
+        success = HashInputString(context, "b", json_value_get_boolean(value) ? "1" : "0");
+        break;
+
+    case JSONNumber:
+        snprintf(scratch, sizeof(scratch), "%.17g", json_value_get_number(value));
+        success = HashInputString(context, "n", scratch);
+        break;
+
+    case JSONString:
+        success = HashInputString(context, "s", json_value_get_string(value));
+        break;
+
+    case JSONArray:
+    {
+        const JSON_Array* array = json_value_get_array(value);
+        const size_t count = json_array_get_count(array);
+
+        snprintf(scratch, sizeof(scratch), "%zu", count);
+        if (!HashInputString(context, "a", scratch))
+        {
+            goto done;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!HashInputJsonValue(context, json_array_get_value(array, i)))
+            {
+                goto done;
+            }
+        }
+
+        success = true;
+        break;
+    }
+
+    case JSONObject:
+    {
+        const JSON_Object* object = json_value_get_object(value);
+        const size_t count = json_object_get_count(object);
+
+        snprintf(scratch, sizeof(scratch), "%zu", count);
+        if (!HashInputString(context, "o", scratch))
+        {
+            goto done;
+        }
+
+        if (count == 0)
+        {
+            success = true;
+            break;
+        }
+
+        members = calloc(count, sizeof(*members));
+        if (members == NULL)
+        {
+            goto done;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            members[i].name = json_object_get_name(object, i);
+            members[i].value = json_object_get_value_at(object, i);
+        }
+
+        qsort(members, count, sizeof(*members), CompareJsonHashMembers);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!HashInputString(context, "k", members[i].name) || !HashInputJsonValue(context, members[i].value))
+            {
+                goto done;
+            }
+        }
+
+        success = true;
+        break;
+    }
+
+    default:
+        break;
+    }
+
+done:
+    free(members);
+    return success;
+}
+
+/**
+ * @brief Computes a digest of a JSON value that does not depend on the order of object members or on formatting.
+ *
+ * @param value The JSON value.
+ * @param algorithm The SHA algorithm.
+ * @param[out] hash The base64 encoded digest. Caller must call free() to deallocate it.
+ * @return bool true on success.
+ */
+bool ADUC_HashUtils_GetJsonValueHash(const JSON_Value* value, SHAversion algorithm, char** hash)
+{
+    bool success = false;
+    USHAContext context;
+
+    if (value == NULL || hash == NULL)
+    {
+        Log_Error("Invalid input.");
+        goto done;
+    }
+
+    *hash = NULL;
+
+    if (USHAReset(&context, algorithm) != 0)
+    {
+        Log_Error("Error in SHA Reset, SHAversion: %d", algorithm);
+        goto done;
+    }
+
+    if (!HashInputJsonValue(&context, value))
+    {
+        Log_Error("Error hashing JSON value, SHAversion: %d", algorithm);
+        goto done;
+    }
+
+    success = GetResultAndCompareHashes(&context, NULL, algorithm, false, hash);
+
+done:
+    return success;
+}
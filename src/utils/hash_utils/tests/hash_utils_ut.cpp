@@ -13,9 +13,15 @@
 using Catch::Matchers::Equals;
 
 #include <aduc/calloc_wrapper.hpp>
+#include <algorithm>
 #include <array>
+#include <fcntl.h> // open
 #include <fstream>
+#include <parson.h>
+#include <string>
+#include <unistd.h> // ftruncate, pwrite
 #include <unordered_map>
+#include <vector>
 
 // To generate file hashes:
 // openssl dgst -binary -sha256 < test.bin  | openssl base64
@@ -212,6 +218,52 @@ TEST_CASE("ADUC_HashUtils_GetShaVersionForTypeString")
     }
 }
 
+static std::string GetJsonHash(const char* json)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+
+    char* hash = nullptr;
+    CHECK(ADUC_HashUtils_GetJsonValueHash(value, SHAversion::SHA256, &hash));
+    json_value_free(value);
+
+    REQUIRE(hash != nullptr);
+    std::string result{ hash };
+    free(hash);
+    return result;
+}
+
+TEST_CASE("ADUC_HashUtils_GetJsonValueHash")
+{
+    const std::string hash = GetJsonHash(R"({"workflow":{"action":3,"id":"a"},"fileUrls":{"f1":"http://x/1"}})");
+
+    SECTION("Member order and formatting do not matter")
+    {
+        CHECK(hash == GetJsonHash(R"({ "fileUrls": { "f1": "http://x/1" }, "workflow": { "id": "a", "action": 3 } })"));
+    }
+
+    SECTION("Any value change is detected")
+    {
+        CHECK(hash != GetJsonHash(R"({"workflow":{"action":3,"id":"b"},"fileUrls":{"f1":"http://x/1"}})"));
+        CHECK(hash != GetJsonHash(R"({"workflow":{"action":"3","id":"a"},"fileUrls":{"f1":"http://x/1"}})"));
+        CHECK(hash != GetJsonHash(R"({"workflow":{"action":3,"id":"a"},"fileUrls":{"f1":"http://x/1","f2":null}})"));
+        CHECK(hash != GetJsonHash(R"({"workflow":{"action":3,"id":"a"},"fileUrls":["f1","http://x/1"]})"));
+    }
+
+    SECTION("Array order matters")
+    {
+        CHECK(GetJsonHash("[1,2]") != GetJsonHash("[2,1]"));
+        CHECK(GetJsonHash(R"(["ab","c"])") != GetJsonHash(R"(["a","bc"])"));
+    }
+
+    SECTION("Invalid input")
+    {
+        char* result = nullptr;
+        CHECK_FALSE(ADUC_HashUtils_GetJsonValueHash(nullptr, SHAversion::SHA256, &result));
+        CHECK(result == nullptr);
+    }
+}
+
 class LargeFile : public TestFile
 {
 public:
@@ -306,3 +358,63 @@ TEST_CASE("ADUC_HashUtils_GetFileHash - LargeFile")
         CHECK_THAT(hash.get(), Equals(testFile.GetDataHashBase64(version)));
     }
 }
+
+TEST_CASE("ADUC_HashUtils_GetFileHash - SparseFile")
+{
+    char sparsePath[] = "/tmp/sparseXXXXXX";
+    char densePath[] = "/tmp/denseXXXXXX";
+    ADUC_SystemUtils_MkTemp(sparsePath);
+    ADUC_SystemUtils_MkTemp(densePath);
+
+    // Data between and after holes, with sizes that are not multiples of the read size.
+    std::vector<uint8_t> content(5 * 1024 * 1024 + 123);
+    for (size_t offset : { static_cast<size_t>(1024 * 1024 + 7), static_cast<size_t>(3 * 1024 * 1024) })
+    {
+        for (size_t i = 0; i < 70000; ++i)
+        {
+            content[offset + i] = static_cast<uint8_t>(i * 31 + 1);
+        }
+    }
+    content.back() = 0xff;
+
+    const int fd = open(sparsePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd != -1);
+    REQUIRE(ftruncate(fd, static_cast<off_t>(content.size())) == 0);
+    for (size_t offset = 0; offset < content.size(); offset += 4096)
+    {
+        const size_t length = std::min<size_t>(4096, content.size() - offset);
+        const auto block = content.begin() + static_cast<std::ptrdiff_t>(offset);
+        if (std::any_of(block, block + static_cast<std::ptrdiff_t>(length), [](uint8_t b) { return b != 0; }))
+        {
+            REQUIRE(
+                pwrite(fd, content.data() + offset, length, static_cast<off_t>(offset))
+                == static_cast<ssize_t>(length));
+        }
+    }
+    close(fd);
+
+    {
+        std::ofstream dense{ densePath, std::ios::binary };
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        dense.write(reinterpret_cast<const char*>(content.data()), static_cast<std::streamsize>(content.size()));
+    }
+
+    // clang-format off
+    auto version = GENERATE( // NOLINT(google-build-using-namespace)
+        SHAversion::SHA1,
+        SHAversion::SHA256,
+        SHAversion::SHA512);
+    // clang-format on
+
+    INFO("SHAversion: " << version);
+    ADUC::StringUtils::cstr_wrapper sparseHash;
+    ADUC::StringUtils::cstr_wrapper denseHash;
+    REQUIRE(ADUC_HashUtils_GetFileHash(sparsePath, version, sparseHash.address_of()));
+    REQUIRE(ADUC_HashUtils_GetFileHash(densePath, version, denseHash.address_of()));
+    CHECK_THAT(sparseHash.get(), Equals(denseHash.get()));
+    CHECK(ADUC_HashUtils_IsValidBufferHash(content.data(), content.size(), sparseHash.get(), version));
+    CHECK(ADUC_HashUtils_IsValidFileHash(sparsePath, denseHash.get(), version, true));
+
+    REQUIRE(std::remove(sparsePath) == 0);
+    REQUIRE(std::remove(densePath) == 0);
+}
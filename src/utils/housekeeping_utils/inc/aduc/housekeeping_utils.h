@@ -0,0 +1,153 @@
+/**
+ * @file housekeeping_utils.h
+ * @brief Persistent, low-priority queue for work that may run after a deployment has completed.
+ *
+ * Each task is a directory under the queue folder. The producer creates it with
+ * ADUC_HousekeepingQueue_BeginTask(), moves the files the task needs into it, and commits it with
+ * ADUC_HousekeepingQueue_CommitTask(), which writes the task description to "task.json".
+ * Only committed tasks are run; uncommitted task directories are removed when the queue is created.
+ *
+ * Tasks are run one at a time in commit order by a background thread with idle CPU and I/O priority.
+ * The task directory is removed after the task has run, whether it succeeded or not. A task that yielded
+ * because the queue was paused or stopped is kept, and is run again when the queue resumes; such a task
+ * records its progress with ADUC_HousekeepingQueue_UpdateTask(). Tasks that are pending when the agent
+ * stops are run after the next start.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_HOUSEKEEPING_UTILS_H
+#define ADUC_HOUSEKEEPING_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Name of the task description file in a task directory.
+ */
+#define ADUC_HOUSEKEEPING_TASK_FILE "task.json"
+
+/**
+ * @brief The housekeeping queue.
+ */
+typedef struct tagADUC_HousekeepingQueue ADUC_HousekeepingQueue;
+
+/**
+ * @brief The outcome of running a task.
+ */
+typedef enum tagADUC_HousekeepingTaskResult
+{
+    ADUC_HousekeepingTaskResult_Succeeded = 0, /**< The task is done and is removed. */
+    ADUC_HousekeepingTaskResult_Failed = 1, /**< The task failed and is removed. It is not retried. */
+    ADUC_HousekeepingTaskResult_Yielded = 2, /**< The queue was paused. The task is kept and run again later. */
+} ADUC_HousekeepingTaskResult;
+
+/**
+ * @brief Runs one task.
+ *
+ * @param task The task description. The task may change it and save it with ADUC_HousekeepingQueue_UpdateTask().
+ * @param taskDir The task directory.
+ * @param context The context passed to ADUC_HousekeepingQueue_Create().
+ * @return ADUC_HousekeepingTaskResult The outcome. A task returns ADUC_HousekeepingTaskResult_Yielded only after
+ * ADUC_HousekeepingQueue_IsPaused() returned true.
+ */
+typedef ADUC_HousekeepingTaskResult (*ADUC_HousekeepingQueue_TaskFunc)(
+    JSON_Value* task, const char* taskDir, void* context);
+
+/**
+ * @brief Creates the queue and starts its worker. Tasks committed before are resumed.
+ *
+ * @param queueDir The queue folder. It is created if needed.
+ * @param taskFunc The function that runs a task.
+ * @param context Context for @p taskFunc.
+ * @return ADUC_HousekeepingQueue* The queue, or NULL on failure.
+ */
+ADUC_HousekeepingQueue*
+ADUC_HousekeepingQueue_Create(const char* queueDir, ADUC_HousekeepingQueue_TaskFunc taskFunc, void* context);
+
+/**
+ * @brief Stops the worker after the running task, and frees the queue. Pending tasks stay on disk.
+ *
+ * @param queue The queue. May be NULL.
+ */
+void ADUC_HousekeepingQueue_Destroy(ADUC_HousekeepingQueue* queue);
+
+/**
+ * @brief Creates the directory of a new task.
+ *
+ * @param queue The queue.
+ * @return char* The task directory, or NULL on failure. Caller must call free() to deallocate it.
+ */
+char* ADUC_HousekeepingQueue_BeginTask(ADUC_HousekeepingQueue* queue);
+
+/**
+ * @brief Commits a task created with ADUC_HousekeepingQueue_BeginTask(). On failure, the task directory is removed.
+ *
+ * @param queue The queue.
+ * @param taskDir The task directory.
+ * @param task The task description.
+ * @return bool true if the task was queued.
+ */
+bool ADUC_HousekeepingQueue_CommitTask(ADUC_HousekeepingQueue* queue, const char* taskDir, const JSON_Value* task);
+
+/**
+ * @brief Replaces the description of a committed task, e.g. to record its progress before it yields.
+ *
+ * @param queue The queue.
+ * @param taskDir The task directory.
+ * @param task The task description.
+ * @return bool true if the description was saved. On false, the previous description is kept.
+ */
+bool ADUC_HousekeepingQueue_UpdateTask(ADUC_HousekeepingQueue* queue, const char* taskDir, const JSON_Value* task);
+
+/**
+ * @brief Removes a task directory that was not committed.
+ *
+ * @param queue The queue.
+ * @param taskDir The task directory.
+ */
+void ADUC_HousekeepingQueue_AbortTask(ADUC_HousekeepingQueue* queue, const char* taskDir);
+
+/**
+ * @brief Pauses or resumes the worker. A paused worker finishes the running task but starts no new one.
+ *
+ * @param queue The queue. May be NULL.
+ * @param paused true to pause.
+ */
+void ADUC_HousekeepingQueue_SetPaused(ADUC_HousekeepingQueue* queue, bool paused);
+
+/**
+ * @brief Gets whether the worker is paused or stopping.
+ * @details A long task checks this between its steps, so that it yields to the workflow or to the agent shutdown
+ * as soon as possible.
+ *
+ * @param queue The queue. May be NULL.
+ * @return bool true if the worker is paused or stopping.
+ */
+bool ADUC_HousekeepingQueue_IsPaused(ADUC_HousekeepingQueue* queue);
+
+/**
+ * @brief Waits until the worker is not running a task. Pending tasks are not waited for.
+ *
+ * @param queue The queue. May be NULL.
+ * @param timeoutMilliseconds The maximum time to wait.
+ * @return bool true if no task is running.
+ */
+bool ADUC_HousekeepingQueue_WaitForRunningTask(ADUC_HousekeepingQueue* queue, unsigned int timeoutMilliseconds);
+
+/**
+ * @brief Waits until no committed task is pending or running.
+ *
+ * @param queue The queue.
+ * @param timeoutMilliseconds The maximum time to wait.
+ * @return bool true if the queue is idle.
+ */
+bool ADUC_HousekeepingQueue_WaitIdle(ADUC_HousekeepingQueue* queue, unsigned int timeoutMilliseconds);
+
+EXTERN_C_END
+
+#endif // ADUC_HOUSEKEEPING_UTILS_H
@@ -0,0 +1,647 @@
+/**
+ * @file housekeeping_utils.c
+ * @brief Implements the persistent, low-priority housekeeping queue.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/housekeeping_utils.h"
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_StringFormat, IsNullOrEmpty
+#include "aduc/system_utils.h" // ADUC_SystemUtils_*, SystemUtils_*
+
+#include <aducpal/stdio.h> // ADUCPAL_rename, remove
+#include <azure_c_shared_utility/crt_abstractions.h> // mallocAndStrcpy_s
+
+#include <errno.h>
+#include <fcntl.h> // open, O_*
+#include <inttypes.h> // PRIu64
+#include <pthread.h>
+#include <stdint.h> // uint64_t
+#include <stdlib.h> // calloc, strtoull
+#include <string.h>
+#include <sys/stat.h> // S_I*
+#include <time.h>
+#include <unistd.h> // write, fsync, close
+
+#ifdef __linux__
+#    include <sys/resource.h> // setpriority
+#    include <sys/syscall.h> // SYS_gettid, SYS_ioprio_set
+#endif
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#ifdef __linux__
+// From linux/ioprio.h, which is not exported by every libc.
+#    define HOUSEKEEPING_IOPRIO_WHO_PROCESS 1
+#    define HOUSEKEEPING_IOPRIO_CLASS_IDLE 3
+#    define HOUSEKEEPING_IOPRIO_CLASS_SHIFT 13
+#endif
+
+/**
+ * @brief The housekeeping queue.
+ */
+struct tagADUC_HousekeepingQueue
+{
+    char* queueDir; /**< The queue folder. */
+    ADUC_HousekeepingQueue_TaskFunc taskFunc; /**< Runs a task. */
+    void* context; /**< Context for taskFunc. */
+
+    pthread_t worker; /**< The worker thread. */
+    bool workerStarted; /**< True if worker must be joined. */
+
+    pthread_mutex_t mutex; /**< Guards the members below. */
+    pthread_cond_t cond; /**< Signaled when the members below change. */
+    uint64_t nextSequence; /**< Sequence number of the next task directory. */
+    uint64_t generation; /**< Incremented for each committed task. */
+    uint64_t scannedGeneration; /**< The generation at which the worker last found the queue empty. */
+    bool paused; /**< True while the worker must not start a task. */
+    bool running; /**< True while the worker runs a task. */
+    bool stop; /**< True when the worker must exit. */
+};
+
+/**
+ * @brief State for finding task directories.
+ */
+typedef struct tagADUC_HousekeepingScan
+{
+    uint64_t maxSequence; /**< Highest sequence number seen. */
+    uint64_t oldestSequence; /**< Lowest sequence number of a committed task. */
+    bool hasOldest; /**< True if oldestSequence is valid. */
+    bool removeUncommitted; /**< True to remove task directories without a task file. */
+} ADUC_HousekeepingScan;
+
+static bool ParseSequence(const char* name, uint64_t* sequence)
+{
+    char* end = NULL;
+
+    if (IsNullOrEmpty(name) || name[0] < '0' || name[0] > '9')
+    {
+        return false;
+    }
+
+    errno = 0;
+    *sequence = strtoull(name, &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+static void ScanTaskDir(void* context, const char* baseDir, const char* subDir)
+{
+    ADUC_HousekeepingScan* scan = (ADUC_HousekeepingScan*)context;
+    uint64_t sequence = 0;
+    char* taskFile = NULL;
+
+    if (!ParseSequence(subDir, &sequence))
+    {
+        return;
+    }
+
+    if (sequence > scan->maxSequence)
+    {
+        scan->maxSequence = sequence;
+    }
+
+    taskFile = ADUC_StringFormat("%s/%s/%s", baseDir, subDir, ADUC_HOUSEKEEPING_TASK_FILE);
+    if (taskFile == NULL)
+    {
+        return;
+    }
+
+    if (SystemUtils_IsFile(taskFile, NULL))
+    {
+        if (!scan->hasOldest || sequence < scan->oldestSequence)
+        {
+            scan->oldestSequence = sequence;
+            scan->hasOldest = true;
+        }
+    }
+    else if (scan->removeUncommitted)
+    {
+        char* taskDir = ADUC_StringFormat("%s/%s", baseDir, subDir);
+        if (taskDir != NULL)
+        {
+            Log_Info("Removing uncommitted housekeeping task %s", taskDir);
+            ADUC_SystemUtils_RmDirRecursive(taskDir);
+            free(taskDir);
+        }
+    }
+
+    free(taskFile);
+}
+
+static bool ScanQueue(const ADUC_HousekeepingQueue* queue, bool removeUncommitted, ADUC_HousekeepingScan* scan)
+{
+    ADUC_SystemUtils_ForEachDirFunctor functor = { .context = scan, .callbackFn = ScanTaskDir };
+
+    memset(scan, 0, sizeof(*scan));
+    scan->removeUncommitted = removeUncommitted;
+
+    return SystemUtils_ForEachDir(queue->queueDir, NULL /* excludeDir */, &functor) == 0;
+}
+
+/**
+ * @brief Writes @p content to @p filePath and flushes it to storage.
+ */
+static bool WriteFileSynced(const char* filePath, const char* content)
+{
+    bool succeeded = false;
+    const size_t length = strlen(content);
+    size_t written = 0;
+
+    const int fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    while (written < length)
+    {
+        const ssize_t count = write(fd, content + written, length - written);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            goto done;
+        }
+
+        written += (size_t)count;
+    }
+
+    succeeded = (fsync(fd) == 0);
+
+done:
+    close(fd);
+
+    return succeeded;
+}
+
+/**
+ * @brief Flushes the entries of a directory to storage, e.g. after a file in it was created or renamed.
+ */
+static bool SyncDir(const char* dirPath)
+{
+    const int fd = open(dirPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    const bool succeeded = (fsync(fd) == 0);
+    close(fd);
+
+    return succeeded;
+}
+
+/**
+ * @brief Atomically replaces the task file of a task directory.
+ */
+static bool WriteTaskFile(const char* taskDir, const JSON_Value* task)
+{
+    bool succeeded = false;
+    char* tempFile = ADUC_StringFormat("%s/%s.tmp", taskDir, ADUC_HOUSEKEEPING_TASK_FILE);
+    char* taskFile = ADUC_StringFormat("%s/%s", taskDir, ADUC_HOUSEKEEPING_TASK_FILE);
+    char* content = json_serialize_to_string(task);
+
+    if (tempFile == NULL || taskFile == NULL || content == NULL)
+    {
+        goto done;
+    }
+
+    // The rename makes the task file visible, so the worker never sees a partially written one.
+    // The file is synced before the rename and the directory after it, so the task file survives a power loss.
+    if (!WriteFileSynced(tempFile, content) || ADUCPAL_rename(tempFile, taskFile) != 0 || !SyncDir(taskDir))
+    {
+        Log_Error("Cannot write housekeeping task %s, errno %d", taskFile, errno);
+        remove(tempFile);
+        goto done;
+    }
+
+    succeeded = true;
+
+done:
+    json_free_serialized_string(content);
+    free(tempFile);
+    free(taskFile);
+
+    return succeeded;
+}
+
+/**
+ * @brief Runs the oldest committed task, and removes it unless it yielded.
+ *
+ * @return bool false if no task was pending, or if the task could not be removed.
+ */
+static bool RunOldestTask(ADUC_HousekeepingQueue* queue)
+{
+    ADUC_HousekeepingScan scan;
+    bool ranTask = true;
+    bool keepTask = false;
+    char* taskDir = NULL;
+    char* taskFile = NULL;
+    JSON_Value* taskValue = NULL;
+
+    if (!ScanQueue(queue, false /* removeUncommitted */, &scan) || !scan.hasOldest)
+    {
+        return false;
+    }
+
+    taskDir = ADUC_StringFormat("%s/%020" PRIu64, queue->queueDir, scan.oldestSequence);
+    if (taskDir == NULL)
+    {
+        return false;
+    }
+
+    taskFile = ADUC_StringFormat("%s/%s", taskDir, ADUC_HOUSEKEEPING_TASK_FILE);
+    if (taskFile == NULL)
+    {
+        goto done;
+    }
+
+    taskValue = json_parse_file(taskFile);
+    if (json_value_get_object(taskValue) == NULL)
+    {
+        Log_Warn("Dropping housekeeping task %s with invalid task file.", taskDir);
+        goto done;
+    }
+
+    Log_Info("Running housekeeping task %s", taskDir);
+
+    switch (queue->taskFunc(taskValue, taskDir, queue->context))
+    {
+    case ADUC_HousekeepingTaskResult_Succeeded:
+        break;
+
+    case ADUC_HousekeepingTaskResult_Yielded:
+        Log_Info("Housekeeping task %s yielded. It continues when the queue is resumed.", taskDir);
+        keepTask = true;
+        break;
+
+    default:
+        Log_Warn("Housekeeping task %s failed.", taskDir);
+        break;
+    }
+
+done:
+    // A failing task is not retried, so that it cannot block the queue.
+    if (!keepTask && ADUC_SystemUtils_RmDirRecursive(taskDir) != 0)
+    {
+        Log_Error("Cannot remove housekeeping task %s, errno %d", taskDir, errno);
+
+        // Uncommit the task at least, so that it is not found again.
+        if (taskFile == NULL || remove(taskFile) != 0)
+        {
+            ranTask = false;
+        }
+    }
+
+    json_value_free(taskValue);
+    free(taskFile);
+    free(taskDir);
+
+    return ranTask;
+}
+
+/**
+ * @brief Lowers the CPU and I/O priority of the calling thread, so that housekeeping yields to everything else.
+ */
+static void LowerThreadPriority(void)
+{
+#ifdef __linux__
+    const long tid = syscall(SYS_gettid);
+
+    if (setpriority(PRIO_PROCESS, (id_t)tid, 19) != 0)
+    {
+        Log_Warn("Cannot lower housekeeping CPU priority, errno %d", errno);
+    }
+
+    if (syscall(
+            SYS_ioprio_set,
+            HOUSEKEEPING_IOPRIO_WHO_PROCESS,
+            (int)tid,
+            HOUSEKEEPING_IOPRIO_CLASS_IDLE << HOUSEKEEPING_IOPRIO_CLASS_SHIFT)
+        != 0)
+    {
+        Log_Warn("Cannot lower housekeeping I/O priority, errno %d", errno);
+    }
+#endif
+}
+
+static void* HousekeepingWorker(void* arg)
+{
+    ADUC_HousekeepingQueue* queue = (ADUC_HousekeepingQueue*)arg;
+
+    LowerThreadPriority();
+
+    pthread_mutex_lock(&queue->mutex);
+
+    while (!queue->stop)
+    {
+        if (queue->paused || queue->scannedGeneration == queue->generation)
+        {
+            pthread_cond_wait(&queue->cond, &queue->mutex);
+            continue;
+        }
+
+        const uint64_t generation = queue->generation;
+        queue->running = true;
+
+        pthread_mutex_unlock(&queue->mutex);
+        const bool ranTask = RunOldestTask(queue);
+        pthread_mutex_lock(&queue->mutex);
+
+        queue->running = false;
+
+        if (!ranTask)
+        {
+            queue->scannedGeneration = generation;
+        }
+
+        pthread_cond_broadcast(&queue->cond);
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return NULL;
+}
+
+ADUC_HousekeepingQueue*
+ADUC_HousekeepingQueue_Create(const char* queueDir, ADUC_HousekeepingQueue_TaskFunc taskFunc, void* context)
+{
+    bool succeeded = false;
+    ADUC_HousekeepingQueue* queue = NULL;
+    ADUC_HousekeepingScan scan;
+
+    if (IsNullOrEmpty(queueDir) || taskFunc == NULL)
+    {
+        Log_Error("Invalid argument.");
+        goto done;
+    }
+
+    queue = calloc(1, sizeof(*queue));
+    if (queue == NULL)
+    {
+        goto done;
+    }
+
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+
+    queue->taskFunc = taskFunc;
+    queue->context = context;
+
+    if (mallocAndStrcpy_s(&queue->queueDir, queueDir) != 0)
+    {
+        goto done;
+    }
+
+    if (ADUC_SystemUtils_MkDirRecursiveDefault(queueDir) != 0)
+    {
+        Log_Error("Cannot create housekeeping folder %s", queueDir);
+        goto done;
+    }
+
+    if (!ScanQueue(queue, true /* removeUncommitted */, &scan))
+    {
+        Log_Error("Cannot read housekeeping folder %s", queueDir);
+        goto done;
+    }
+
+    queue->nextSequence = scan.maxSequence + 1;
+
+    // Make the worker look for tasks committed before.
+    queue->generation = 1;
+
+    if (pthread_create(&queue->worker, NULL, HousekeepingWorker, queue) != 0)
+    {
+        Log_Error("Cannot start housekeeping worker, errno %d", errno);
+        goto done;
+    }
+
+    queue->workerStarted = true;
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        ADUC_HousekeepingQueue_Destroy(queue);
+        queue = NULL;
+    }
+
+    return queue;
+}
+
+void ADUC_HousekeepingQueue_Destroy(ADUC_HousekeepingQueue* queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    if (queue->workerStarted)
+    {
+        pthread_mutex_lock(&queue->mutex);
+        queue->stop = true;
+        pthread_cond_broadcast(&queue->cond);
+        pthread_mutex_unlock(&queue->mutex);
+
+        pthread_join(queue->worker, NULL);
+    }
+
+    pthread_cond_destroy(&queue->cond);
+    pthread_mutex_destroy(&queue->mutex);
+
+    free(queue->queueDir);
+    free(queue);
+}
+
+char* ADUC_HousekeepingQueue_BeginTask(ADUC_HousekeepingQueue* queue)
+{
+    char* taskDir = NULL;
+
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    const uint64_t sequence = queue->nextSequence++;
+    pthread_mutex_unlock(&queue->mutex);
+
+    taskDir = ADUC_StringFormat("%s/%020" PRIu64, queue->queueDir, sequence);
+    if (taskDir == NULL)
+    {
+        return NULL;
+    }
+
+    if (ADUC_SystemUtils_MkDirDefault(taskDir) != 0)
+    {
+        Log_Error("Cannot create housekeeping task %s", taskDir);
+        free(taskDir);
+        return NULL;
+    }
+
+    return taskDir;
+}
+
+bool ADUC_HousekeepingQueue_CommitTask(ADUC_HousekeepingQueue* queue, const char* taskDir, const JSON_Value* task)
+{
+    bool succeeded = false;
+
+    if (queue == NULL || taskDir == NULL || json_value_get_object(task) == NULL)
+    {
+        Log_Error("Invalid argument.");
+        goto done;
+    }
+
+    // The task is committed by writing its task file.
+    if (!WriteTaskFile(taskDir, task))
+    {
+        goto done;
+    }
+
+    // Makes the new task directory itself survive a power loss.
+    if (!SyncDir(queue->queueDir))
+    {
+        Log_Warn("Cannot sync housekeeping folder %s, errno %d", queue->queueDir, errno);
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->generation++;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        ADUC_HousekeepingQueue_AbortTask(queue, taskDir);
+    }
+
+    return succeeded;
+}
+
+bool ADUC_HousekeepingQueue_UpdateTask(ADUC_HousekeepingQueue* queue, const char* taskDir, const JSON_Value* task)
+{
+    UNREFERENCED_PARAMETER(queue);
+
+    if (taskDir == NULL || json_value_get_object(task) == NULL)
+    {
+        Log_Error("Invalid argument.");
+        return false;
+    }
+
+    return WriteTaskFile(taskDir, task);
+}
+
+void ADUC_HousekeepingQueue_AbortTask(ADUC_HousekeepingQueue* queue, const char* taskDir)
+{
+    UNREFERENCED_PARAMETER(queue);
+
+    if (taskDir != NULL && ADUC_SystemUtils_RmDirRecursive(taskDir) != 0)
+    {
+        Log_Warn("Cannot remove housekeeping task %s, errno %d", taskDir, errno);
+    }
+}
+
+void ADUC_HousekeepingQueue_SetPaused(ADUC_HousekeepingQueue* queue, bool paused)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->paused = paused;
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+bool ADUC_HousekeepingQueue_IsPaused(ADUC_HousekeepingQueue* queue)
+{
+    bool paused = false;
+
+    if (queue == NULL)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    paused = queue->paused || queue->stop;
+    pthread_mutex_unlock(&queue->mutex);
+
+    return paused;
+}
+
+static void GetDeadline(unsigned int timeoutMilliseconds, struct timespec* deadline)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += timeoutMilliseconds / 1000;
+    deadline->tv_nsec += (long)(timeoutMilliseconds % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+bool ADUC_HousekeepingQueue_WaitForRunningTask(ADUC_HousekeepingQueue* queue, unsigned int timeoutMilliseconds)
+{
+    struct timespec deadline;
+    bool done = false;
+
+    if (queue == NULL)
+    {
+        return true;
+    }
+
+    GetDeadline(timeoutMilliseconds, &deadline);
+
+    pthread_mutex_lock(&queue->mutex);
+
+    while (!(done = !queue->running))
+    {
+        if (pthread_cond_timedwait(&queue->cond, &queue->mutex, &deadline) == ETIMEDOUT)
+        {
+            done = !queue->running;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return done;
+}
+
+bool ADUC_HousekeepingQueue_WaitIdle(ADUC_HousekeepingQueue* queue, unsigned int timeoutMilliseconds)
+{
+    struct timespec deadline;
+    bool idle = false;
+
+    if (queue == NULL)
+    {
+        return false;
+    }
+
+    GetDeadline(timeoutMilliseconds, &deadline);
+
+    pthread_mutex_lock(&queue->mutex);
+
+    while (!(idle = (queue->scannedGeneration == queue->generation)))
+    {
+        if (pthread_cond_timedwait(&queue->cond, &queue->mutex, &deadline) == ETIMEDOUT)
+        {
+            idle = (queue->scannedGeneration == queue->generation);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return idle;
+}
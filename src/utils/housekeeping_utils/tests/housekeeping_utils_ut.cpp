@@ -0,0 +1,331 @@
+/**
+ * @file housekeeping_utils_ut.cpp
+ * @brief Unit Tests for housekeeping_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/housekeeping_utils.h"
+#include "aduc/system_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <parson.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#define TEST_DIR "/tmp/adutest/housekeeping_utils_ut"
+
+/**
+ * @brief Records the tasks run by the queue.
+ */
+struct TaskRecorder
+{
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::string> payloads;
+    bool succeed = true;
+};
+
+static ADUC_HousekeepingTaskResult RecordTask(JSON_Value* task, const char* taskDir, void* context)
+{
+    auto* recorder = static_cast<TaskRecorder*>(context);
+    std::lock_guard<std::mutex> lock{ recorder->mutex };
+
+    recorder->names.emplace_back(json_object_get_string(json_value_get_object(task), "name"));
+
+    std::ifstream payload{ std::string{ taskDir } + "/payload" };
+    std::string content;
+    std::getline(payload, content);
+    recorder->payloads.emplace_back(content);
+
+    return recorder->succeed ? ADUC_HousekeepingTaskResult_Succeeded : ADUC_HousekeepingTaskResult_Failed;
+}
+
+static bool EnqueueTask(ADUC_HousekeepingQueue* queue, const char* name)
+{
+    char* taskDir = ADUC_HousekeepingQueue_BeginTask(queue);
+    REQUIRE(taskDir != nullptr);
+
+    {
+        std::ofstream payload{ std::string{ taskDir } + "/payload" };
+        payload << "payload of " << name;
+    }
+
+    JSON_Value* task = json_value_init_object();
+    json_object_set_string(json_value_get_object(task), "name", name);
+
+    const bool committed = ADUC_HousekeepingQueue_CommitTask(queue, taskDir, task);
+
+    json_value_free(task);
+    free(taskDir);
+    return committed;
+}
+
+static size_t CountTaskDirs(const std::string& queueDir)
+{
+    size_t count = 0;
+    ADUC_SystemUtils_ForEachDirFunctor functor = {
+        &count, [](void* context, const char*, const char*) { ++*static_cast<size_t*>(context); }
+    };
+    REQUIRE(SystemUtils_ForEachDir(queueDir.c_str(), nullptr, &functor) == 0);
+    return count;
+}
+
+class TestQueueDir
+{
+public:
+    TestQueueDir() : _root(TEST_DIR)
+    {
+        REQUIRE(_root.RemoveDir());
+        REQUIRE(_root.CreateDir());
+    }
+
+    TestQueueDir(const TestQueueDir&) = delete;
+    TestQueueDir& operator=(const TestQueueDir&) = delete;
+    TestQueueDir(TestQueueDir&&) = delete;
+    TestQueueDir& operator=(TestQueueDir&&) = delete;
+
+    std::string Path() const
+    {
+        return _root.GetDir() + "/queue";
+    }
+
+private:
+    aduc::AutoDir _root; // auto rmdir on scope exit
+};
+
+TEST_CASE("ADUC_HousekeepingQueue runs committed tasks in order")
+{
+    TestQueueDir dir;
+    TaskRecorder recorder;
+
+    ADUC_HousekeepingQueue* queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RecordTask, &recorder);
+    REQUIRE(queue != nullptr);
+
+    ADUC_HousekeepingQueue_SetPaused(queue, true);
+    REQUIRE(EnqueueTask(queue, "first"));
+    REQUIRE(EnqueueTask(queue, "second"));
+
+    SECTION("A paused queue starts no task")
+    {
+        CHECK_FALSE(ADUC_HousekeepingQueue_WaitIdle(queue, 200));
+        CHECK(recorder.names.empty());
+        CHECK(CountTaskDirs(dir.Path()) == 2);
+    }
+
+    SECTION("Tasks see their files and are removed after running")
+    {
+        ADUC_HousekeepingQueue_SetPaused(queue, false);
+        REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+
+        CHECK(recorder.names == std::vector<std::string>{ "first", "second" });
+        CHECK(recorder.payloads == std::vector<std::string>{ "payload of first", "payload of second" });
+        CHECK(CountTaskDirs(dir.Path()) == 0);
+    }
+
+    SECTION("Failed tasks are not retried")
+    {
+        recorder.succeed = false;
+        ADUC_HousekeepingQueue_SetPaused(queue, false);
+        REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+
+        CHECK(recorder.names.size() == 2);
+        CHECK(CountTaskDirs(dir.Path()) == 0);
+    }
+
+    ADUC_HousekeepingQueue_Destroy(queue);
+}
+
+/**
+ * @brief A task that runs until it is released, and records whether it saw the queue paused.
+ */
+struct BlockingTask
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    ADUC_HousekeepingQueue* queue = nullptr;
+    bool started = false;
+    bool released = false;
+    bool sawPause = false;
+};
+
+static ADUC_HousekeepingTaskResult RunBlockingTask(JSON_Value*, const char*, void* context)
+{
+    auto* blocking = static_cast<BlockingTask*>(context);
+    std::unique_lock<std::mutex> lock{ blocking->mutex };
+
+    blocking->started = true;
+    blocking->cond.notify_all();
+    blocking->cond.wait(lock, [blocking] { return blocking->released; });
+
+    blocking->sawPause = ADUC_HousekeepingQueue_IsPaused(blocking->queue);
+    return ADUC_HousekeepingTaskResult_Succeeded;
+}
+
+TEST_CASE("ADUC_HousekeepingQueue_WaitForRunningTask waits for the task that was running when paused")
+{
+    TestQueueDir dir;
+    BlockingTask blocking;
+
+    ADUC_HousekeepingQueue* queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RunBlockingTask, &blocking);
+    REQUIRE(queue != nullptr);
+    blocking.queue = queue;
+
+    CHECK(ADUC_HousekeepingQueue_WaitForRunningTask(queue, 0));
+
+    REQUIRE(EnqueueTask(queue, "blocking"));
+    {
+        std::unique_lock<std::mutex> lock{ blocking.mutex };
+        REQUIRE(blocking.cond.wait_for(lock, std::chrono::seconds(5), [&blocking] { return blocking.started; }));
+    }
+
+    ADUC_HousekeepingQueue_SetPaused(queue, true);
+    CHECK(ADUC_HousekeepingQueue_IsPaused(queue));
+    CHECK_FALSE(ADUC_HousekeepingQueue_WaitForRunningTask(queue, 200));
+
+    {
+        std::lock_guard<std::mutex> lock{ blocking.mutex };
+        blocking.released = true;
+        blocking.cond.notify_all();
+    }
+
+    CHECK(ADUC_HousekeepingQueue_WaitForRunningTask(queue, 5000));
+    CHECK(blocking.sawPause);
+    CHECK(CountTaskDirs(dir.Path()) == 0);
+
+    ADUC_HousekeepingQueue_Destroy(queue);
+}
+
+/**
+ * @brief A task of several steps that saves its progress and yields when the queue is paused.
+ */
+struct SteppedTask
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    ADUC_HousekeepingQueue* queue = nullptr;
+    std::vector<int> steps;
+    bool pauseAfterFirstStep = false;
+};
+
+static ADUC_HousekeepingTaskResult RunSteppedTask(JSON_Value* task, const char* taskDir, void* context)
+{
+    auto* stepped = static_cast<SteppedTask*>(context);
+    JSON_Object* taskObject = json_value_get_object(task);
+
+    for (int step = static_cast<int>(json_object_get_number(taskObject, "nextStep")); step < 3; ++step)
+    {
+        if (ADUC_HousekeepingQueue_IsPaused(stepped->queue))
+        {
+            return ADUC_HousekeepingTaskResult_Yielded;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{ stepped->mutex };
+            stepped->steps.push_back(step);
+            stepped->cond.notify_all();
+        }
+
+        json_object_set_number(taskObject, "nextStep", step + 1);
+        REQUIRE(ADUC_HousekeepingQueue_UpdateTask(stepped->queue, taskDir, task));
+
+        if (stepped->pauseAfterFirstStep)
+        {
+            stepped->pauseAfterFirstStep = false;
+            ADUC_HousekeepingQueue_SetPaused(stepped->queue, true);
+        }
+    }
+
+    return ADUC_HousekeepingTaskResult_Succeeded;
+}
+
+TEST_CASE("ADUC_HousekeepingQueue keeps a yielded task and continues it when resumed")
+{
+    TestQueueDir dir;
+    SteppedTask stepped;
+    stepped.pauseAfterFirstStep = true;
+
+    ADUC_HousekeepingQueue* queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RunSteppedTask, &stepped);
+    REQUIRE(queue != nullptr);
+    stepped.queue = queue;
+
+    REQUIRE(EnqueueTask(queue, "stepped"));
+    {
+        std::unique_lock<std::mutex> lock{ stepped.mutex };
+        REQUIRE(stepped.cond.wait_for(lock, std::chrono::seconds(5), [&stepped] { return !stepped.steps.empty(); }));
+    }
+
+    REQUIRE(ADUC_HousekeepingQueue_WaitForRunningTask(queue, 5000));
+    CHECK(stepped.steps == std::vector<int>{ 0 });
+    CHECK(CountTaskDirs(dir.Path()) == 1);
+
+    SECTION("The task continues after the pause")
+    {
+        ADUC_HousekeepingQueue_SetPaused(queue, false);
+        REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+    }
+
+    SECTION("The task continues after a restart")
+    {
+        ADUC_HousekeepingQueue_Destroy(queue);
+
+        // The new queue starts unpaused, so the task must not see it before it is returned.
+        stepped.queue = nullptr;
+        queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RunSteppedTask, &stepped);
+        REQUIRE(queue != nullptr);
+        REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+    }
+
+    CHECK(stepped.steps == std::vector<int>{ 0, 1, 2 });
+    CHECK(CountTaskDirs(dir.Path()) == 0);
+
+    ADUC_HousekeepingQueue_Destroy(queue);
+}
+
+TEST_CASE("ADUC_HousekeepingQueue resumes committed tasks after a restart")
+{
+    TestQueueDir dir;
+    TaskRecorder recorder;
+
+    ADUC_HousekeepingQueue* queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RecordTask, &recorder);
+    REQUIRE(queue != nullptr);
+
+    ADUC_HousekeepingQueue_SetPaused(queue, true);
+    REQUIRE(EnqueueTask(queue, "first"));
+    REQUIRE(EnqueueTask(queue, "second"));
+
+    // Simulates an agent stop in the middle of enqueuing.
+    char* uncommitted = ADUC_HousekeepingQueue_BeginTask(queue);
+    REQUIRE(uncommitted != nullptr);
+    free(uncommitted);
+
+    ADUC_HousekeepingQueue_Destroy(queue);
+    CHECK(recorder.names.empty());
+    CHECK(CountTaskDirs(dir.Path()) == 3);
+
+    queue = ADUC_HousekeepingQueue_Create(dir.Path().c_str(), RecordTask, &recorder);
+    REQUIRE(queue != nullptr);
+    REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+
+    CHECK(recorder.names == std::vector<std::string>{ "first", "second" });
+    CHECK(CountTaskDirs(dir.Path()) == 0);
+
+    // New tasks are ordered after the ones that were resumed.
+    REQUIRE(EnqueueTask(queue, "third"));
+    REQUIRE(ADUC_HousekeepingQueue_WaitIdle(queue, 5000));
+    CHECK(recorder.names.back() == "third");
+
+    ADUC_HousekeepingQueue_Destroy(queue);
+}
+
+TEST_CASE("ADUC_HousekeepingQueue_Create rejects invalid arguments")
+{
+    CHECK(ADUC_HousekeepingQueue_Create(nullptr, RecordTask, nullptr) == nullptr);
+    CHECK(ADUC_HousekeepingQueue_Create("/tmp", nullptr, nullptr) == nullptr);
+}
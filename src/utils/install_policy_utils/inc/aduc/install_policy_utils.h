@@ -0,0 +1,112 @@
+/**
+ * @file install_policy_utils.h
+ * @brief Local install policy: maintenance window and load threshold for staged deployments.
+ *
+ * The policy is read from the optional "installPolicy" object of du-config.json:
+ *
+ *   "installPolicy": {
+ *       "maintenanceWindow": { "start": "02:00", "end": "04:30" },
+ *       "maxLoadAverage": 0.5
+ *   }
+ *
+ * The window is in local time and may span midnight. When a policy is set, a deployment is
+ * downloaded right away and then staged until the window is open, or the 1-minute load
+ * average is at or below maxLoadAverage.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_INSTALL_POLICY_UTILS_H
+#define ADUC_INSTALL_POLICY_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Name of the file in the data folder that records the staged deployment.
+ */
+#define ADUC_INSTALL_POLICY_STAGED_MARKER_FILE "staged_deployment.json"
+
+/**
+ * @brief The local install policy.
+ */
+typedef struct tagADUC_InstallPolicy
+{
+    bool hasMaintenanceWindow; /**< True if a maintenance window is configured. */
+
+    unsigned int windowStartMinute; /**< Start of the window, in minutes after local midnight. */
+
+    unsigned int windowEndMinute; /**< End of the window (exclusive), in minutes after local midnight. */
+
+    double maxLoadAverage; /**< Install is allowed at or below this 1-minute load average. Zero means not set. */
+} ADUC_InstallPolicy;
+
+/**
+ * @brief Initializes @p policy from the "installPolicy" configuration object.
+ *
+ * @param[out] policy The policy to initialize.
+ * @param policyObj The "installPolicy" object. NULL results in a disabled policy.
+ * @return true on success; false if the object is malformed, in which case the policy is disabled.
+ */
+bool ADUC_InstallPolicy_Init(ADUC_InstallPolicy* policy, const JSON_Object* policyObj);
+
+/**
+ * @brief Returns whether the policy restricts when an install may run.
+ *
+ * @param policy The policy.
+ * @return true if a maintenance window or a load threshold is configured.
+ */
+bool ADUC_InstallPolicy_IsEnabled(const ADUC_InstallPolicy* policy);
+
+/**
+ * @brief Evaluates the policy for the given local time and load.
+ *
+ * @param policy The policy.
+ * @param minuteOfDay Local time, in minutes after midnight.
+ * @param loadAverage The current 1-minute load average, or a negative value if unknown.
+ * @return true if an install may run.
+ */
+bool ADUC_InstallPolicy_IsInstallAllowed(const ADUC_InstallPolicy* policy, unsigned int minuteOfDay, double loadAverage);
+
+/**
+ * @brief Evaluates the policy for the current local time and system load.
+ *
+ * @param policy The policy.
+ * @return true if an install may run now.
+ */
+bool ADUC_InstallPolicy_IsInstallAllowedNow(const ADUC_InstallPolicy* policy);
+
+/**
+ * @brief Records @p workflowId as staged in @p dataFolder.
+ *
+ * @param dataFolder The agent data folder.
+ * @param workflowId The id of the staged workflow.
+ * @param stagedTime The time the workflow was first staged.
+ * @return true on success.
+ */
+bool ADUC_InstallPolicy_WriteStagedMarker(const char* dataFolder, const char* workflowId, time_t stagedTime);
+
+/**
+ * @brief Reads the staged workflow record from @p dataFolder.
+ *
+ * @param dataFolder The agent data folder.
+ * @param[out] workflowId The id of the staged workflow. Caller must free.
+ * @param[out] stagedTime The time the workflow was first staged.
+ * @return true if a staged workflow is recorded.
+ */
+bool ADUC_InstallPolicy_ReadStagedMarker(const char* dataFolder, char** workflowId, time_t* stagedTime);
+
+/**
+ * @brief Removes the staged workflow record from @p dataFolder, if any.
+ *
+ * @param dataFolder The agent data folder.
+ */
+void ADUC_InstallPolicy_RemoveStagedMarker(const char* dataFolder);
+
+EXTERN_C_END
+
+#endif // ADUC_INSTALL_POLICY_UTILS_H
@@ -0,0 +1,248 @@
+/**
+ * @file install_policy_utils.c
+ * @brief Implements the local install policy for staged deployments.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/install_policy_utils.h"
+#include "aduc/logging.h"
+
+#include "aduc/string_c_utils.h" // ADUC_ParseTimeOfDay, ADUC_StringFormat, IsNullOrEmpty
+#include "azure_c_shared_utility/crt_abstractions.h" // for mallocAndStrcpy_s
+
+#include <errno.h>
+#include <stdio.h> // rename, remove
+#include <stdlib.h> // getloadavg
+#include <string.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define MINUTES_PER_DAY (24 * 60)
+
+static const char* CONFIG_MAINTENANCE_WINDOW = "maintenanceWindow";
+static const char* CONFIG_WINDOW_START = "start";
+static const char* CONFIG_WINDOW_END = "end";
+static const char* CONFIG_MAX_LOAD_AVERAGE = "maxLoadAverage";
+
+static const char* MARKER_WORKFLOW_ID = "workflowId";
+static const char* MARKER_STAGED_TIME = "stagedTime";
+
+/**
+ * @brief Returns the full path of the staged marker file. Caller must free.
+ */
+static char* GetStagedMarkerPath(const char* dataFolder)
+{
+    if (IsNullOrEmpty(dataFolder))
+    {
+        return NULL;
+    }
+
+    return ADUC_StringFormat("%s/%s", dataFolder, ADUC_INSTALL_POLICY_STAGED_MARKER_FILE);
+}
+
+bool ADUC_InstallPolicy_Init(ADUC_InstallPolicy* policy, const JSON_Object* policyObj)
+{
+    bool succeeded = false;
+
+    memset(policy, 0, sizeof(*policy));
+
+    if (policyObj == NULL)
+    {
+        return true;
+    }
+
+    const JSON_Object* windowObj = json_object_get_object(policyObj, CONFIG_MAINTENANCE_WINDOW);
+    if (windowObj != NULL)
+    {
+        const char* start = json_object_get_string(windowObj, CONFIG_WINDOW_START);
+        const char* end = json_object_get_string(windowObj, CONFIG_WINDOW_END);
+
+        if (!ADUC_ParseTimeOfDay(start, &policy->windowStartMinute)
+            || !ADUC_ParseTimeOfDay(end, &policy->windowEndMinute)
+            || policy->windowStartMinute == policy->windowEndMinute)
+        {
+            Log_Error("Invalid install policy %s, expected 'HH:MM' start and end.", CONFIG_MAINTENANCE_WINDOW);
+            goto done;
+        }
+
+        policy->hasMaintenanceWindow = true;
+    }
+
+    if (json_object_has_value(policyObj, CONFIG_MAX_LOAD_AVERAGE))
+    {
+        policy->maxLoadAverage = json_object_get_number(policyObj, CONFIG_MAX_LOAD_AVERAGE);
+        if (policy->maxLoadAverage <= 0)
+        {
+            Log_Error("Invalid install policy %s, expected a positive number.", CONFIG_MAX_LOAD_AVERAGE);
+            goto done;
+        }
+    }
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(policy, 0, sizeof(*policy));
+    }
+
+    return succeeded;
+}
+
+bool ADUC_InstallPolicy_IsEnabled(const ADUC_InstallPolicy* policy)
+{
+    return policy->hasMaintenanceWindow || policy->maxLoadAverage > 0;
+}
+
+bool ADUC_InstallPolicy_IsInstallAllowed(const ADUC_InstallPolicy* policy, unsigned int minuteOfDay, double loadAverage)
+{
+    if (!ADUC_InstallPolicy_IsEnabled(policy))
+    {
+        return true;
+    }
+
+    if (policy->hasMaintenanceWindow)
+    {
+        const unsigned int start = policy->windowStartMinute;
+        const unsigned int end = policy->windowEndMinute;
+        const bool inWindow = (start < end) ? (minuteOfDay >= start && minuteOfDay < end)
+                                            : (minuteOfDay >= start || minuteOfDay < end);
+        if (inWindow)
+        {
+            return true;
+        }
+    }
+
+    return policy->maxLoadAverage > 0 && loadAverage >= 0 && loadAverage <= policy->maxLoadAverage;
+}
+
+bool ADUC_InstallPolicy_IsInstallAllowedNow(const ADUC_InstallPolicy* policy)
+{
+    unsigned int minuteOfDay = 0;
+    double loadAverage = -1;
+
+    if (!ADUC_InstallPolicy_IsEnabled(policy))
+    {
+        return true;
+    }
+
+    if (policy->hasMaintenanceWindow)
+    {
+        time_t now = time(NULL);
+        struct tm localNow;
+        if (localtime_r(&now, &localNow) != NULL)
+        {
+            minuteOfDay = (unsigned int)(localNow.tm_hour * 60 + localNow.tm_min) % MINUTES_PER_DAY;
+        }
+    }
+
+    if (policy->maxLoadAverage > 0 && getloadavg(&loadAverage, 1) != 1)
+    {
+        loadAverage = -1;
+    }
+
+    return ADUC_InstallPolicy_IsInstallAllowed(policy, minuteOfDay, loadAverage);
+}
+
+bool ADUC_InstallPolicy_WriteStagedMarker(const char* dataFolder, const char* workflowId, time_t stagedTime)
+{
+    bool succeeded = false;
+    char* markerPath = GetStagedMarkerPath(dataFolder);
+    char* tempPath = NULL;
+    JSON_Value* rootValue = json_value_init_object();
+    JSON_Object* rootObj = json_value_get_object(rootValue);
+
+    if (markerPath == NULL || rootObj == NULL || IsNullOrEmpty(workflowId))
+    {
+        goto done;
+    }
+
+    if (json_object_set_string(rootObj, MARKER_WORKFLOW_ID, workflowId) != JSONSuccess
+        || json_object_set_number(rootObj, MARKER_STAGED_TIME, (double)stagedTime) != JSONSuccess)
+    {
+        goto done;
+    }
+
+    tempPath = ADUC_StringFormat("%s.tmp", markerPath);
+    if (tempPath == NULL)
+    {
+        goto done;
+    }
+
+    // Write and rename, so that an interrupted write never leaves a partial marker behind.
+    if (json_serialize_to_file(rootValue, tempPath) != JSONSuccess)
+    {
+        Log_Error("Could not write %s", tempPath);
+        goto done;
+    }
+
+    if (rename(tempPath, markerPath) != 0)
+    {
+        Log_Error("Could not rename %s, errno = %d", tempPath, errno);
+        (void)remove(tempPath);
+        goto done;
+    }
+
+    succeeded = true;
+
+done:
+    json_value_free(rootValue);
+    free(tempPath);
+    free(markerPath);
+
+    return succeeded;
+}
+
+bool ADUC_InstallPolicy_ReadStagedMarker(const char* dataFolder, char** workflowId, time_t* stagedTime)
+{
+    bool succeeded = false;
+    char* markerPath = GetStagedMarkerPath(dataFolder);
+    JSON_Value* rootValue = NULL;
+
+    *workflowId = NULL;
+    *stagedTime = 0;
+
+    if (markerPath == NULL)
+    {
+        goto done;
+    }
+
+    rootValue = json_parse_file(markerPath);
+    if (rootValue == NULL)
+    {
+        goto done;
+    }
+
+    const JSON_Object* rootObj = json_value_get_object(rootValue);
+    const char* id = json_object_get_string(rootObj, MARKER_WORKFLOW_ID);
+    if (IsNullOrEmpty(id))
+    {
+        goto done;
+    }
+
+    if (mallocAndStrcpy_s(workflowId, id) != 0)
+    {
+        goto done;
+    }
+
+    *stagedTime = (time_t)json_object_get_number(rootObj, MARKER_STAGED_TIME);
+    succeeded = true;
+
+done:
+    json_value_free(rootValue);
+    free(markerPath);
+
+    return succeeded;
+}
+
+void ADUC_InstallPolicy_RemoveStagedMarker(const char* dataFolder)
+{
+    char* markerPath = GetStagedMarkerPath(dataFolder);
+    if (markerPath != NULL)
+    {
+        (void)remove(markerPath);
+        free(markerPath);
+    }
+}
@@ -0,0 +1,163 @@
+/**
+ * @file install_policy_utils_ut.cpp
+ * @brief Unit Tests for install_policy_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/install_policy_utils.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstdlib>
+#include <parson.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static unsigned int Minute(unsigned int hours, unsigned int minutes)
+{
+    return hours * 60 + minutes;
+}
+
+class PolicyJson
+{
+public:
+    explicit PolicyJson(const char* json) : value(json_parse_string(json))
+    {
+    }
+
+    ~PolicyJson()
+    {
+        json_value_free(value);
+    }
+
+    PolicyJson(const PolicyJson&) = delete;
+    PolicyJson& operator=(const PolicyJson&) = delete;
+    PolicyJson(PolicyJson&&) = delete;
+    PolicyJson& operator=(PolicyJson&&) = delete;
+
+    const JSON_Object* Object() const
+    {
+        return json_value_get_object(value);
+    }
+
+private:
+    JSON_Value* value;
+};
+
+TEST_CASE("ADUC_InstallPolicy_Init")
+{
+    ADUC_InstallPolicy policy;
+
+    SECTION("No policy object means install is always allowed")
+    {
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, nullptr));
+        CHECK_FALSE(ADUC_InstallPolicy_IsEnabled(&policy));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 100.0));
+    }
+
+    SECTION("Window and load threshold")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"02:00","end":"04:30"},"maxLoadAverage":0.5})");
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+        CHECK(ADUC_InstallPolicy_IsEnabled(&policy));
+        CHECK(policy.hasMaintenanceWindow);
+        CHECK(policy.windowStartMinute == Minute(2, 0));
+        CHECK(policy.windowEndMinute == Minute(4, 30));
+        CHECK(policy.maxLoadAverage == Approx(0.5));
+    }
+
+    SECTION("Malformed window disables the policy")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"2:00","end":"25:00"}})");
+        CHECK_FALSE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+        CHECK_FALSE(ADUC_InstallPolicy_IsEnabled(&policy));
+    }
+
+    SECTION("Empty window is rejected")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"03:00","end":"03:00"}})");
+        CHECK_FALSE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+    }
+
+    SECTION("Non-positive load threshold is rejected")
+    {
+        PolicyJson json(R"({"maxLoadAverage":0})");
+        CHECK_FALSE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+    }
+}
+
+TEST_CASE("ADUC_InstallPolicy_IsInstallAllowed")
+{
+    ADUC_InstallPolicy policy;
+
+    SECTION("Window within a day")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"02:00","end":"04:30"}})");
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(1, 59), 0.0));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(2, 0), 0.0));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(4, 29), 0.0));
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(4, 30), 0.0));
+    }
+
+    SECTION("Window spanning midnight")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"23:00","end":"01:00"}})");
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(22, 59), 0.0));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(23, 30), 0.0));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(0, 30), 0.0));
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(1, 0), 0.0));
+    }
+
+    SECTION("Load threshold alone")
+    {
+        PolicyJson json(R"({"maxLoadAverage":0.5})");
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 0.25));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 0.5));
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 0.75));
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), -1.0));
+    }
+
+    SECTION("Low load opens an install outside the window")
+    {
+        PolicyJson json(R"({"maintenanceWindow":{"start":"02:00","end":"04:00"},"maxLoadAverage":0.5})");
+        REQUIRE(ADUC_InstallPolicy_Init(&policy, json.Object()));
+
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(3, 0), 4.0));
+        CHECK(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 0.1));
+        CHECK_FALSE(ADUC_InstallPolicy_IsInstallAllowed(&policy, Minute(12, 0), 4.0));
+    }
+}
+
+TEST_CASE("ADUC_InstallPolicy staged marker")
+{
+    const std::string dataFolder = std::string(ADUC_TMP_DIR_PATH) + "/install_policy_utils_ut";
+    (void)mkdir(ADUC_TMP_DIR_PATH, 0755);
+    (void)mkdir(dataFolder.c_str(), 0755);
+    ADUC_InstallPolicy_RemoveStagedMarker(dataFolder.c_str());
+
+    char* workflowId = nullptr;
+    time_t stagedTime = 0;
+
+    CHECK_FALSE(ADUC_InstallPolicy_ReadStagedMarker(dataFolder.c_str(), &workflowId, &stagedTime));
+    CHECK(workflowId == nullptr);
+
+    REQUIRE(ADUC_InstallPolicy_WriteStagedMarker(dataFolder.c_str(), "wf-1234", 1700000000));
+    REQUIRE(ADUC_InstallPolicy_ReadStagedMarker(dataFolder.c_str(), &workflowId, &stagedTime));
+    CHECK(std::string(workflowId) == "wf-1234");
+    CHECK(stagedTime == 1700000000);
+    free(workflowId);
+    workflowId = nullptr;
+
+    ADUC_InstallPolicy_RemoveStagedMarker(dataFolder.c_str());
+    CHECK_FALSE(ADUC_InstallPolicy_ReadStagedMarker(dataFolder.c_str(), &workflowId, &stagedTime));
+
+    (void)rmdir(dataFolder.c_str());
+}
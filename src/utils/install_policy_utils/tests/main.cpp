@@ -0,0 +1,9 @@
+/**
+ * @file main.cpp
+ * @brief install_policy_utils tests main entry point.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
@@ -0,0 +1,99 @@
+/**
+ * @file lazy_component_utils.h
+ * @brief Creates a PnP component on its first use and destroys it again once it has been idle for a while.
+ *
+ * Most devices never receive a request for some components, e.g. diagnostics. Such a component is registered
+ * with a descriptor only, and is created when its first desired property or command arrives. The request is
+ * then handled by the new instance right away. After idleTimeoutSeconds without requests, and once the
+ * component reports that it has no work in progress, the instance is destroyed again.
+ *
+ * The functions are not thread safe; they are called from the agent main loop.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_LAZY_COMPONENT_UTILS_H
+#define ADUC_LAZY_COMPONENT_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <stdbool.h>
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Creates the component instance.
+ */
+typedef bool (*ADUC_LazyComponent_CreateFunc)(void** componentContext, int argc, char** argv);
+
+/**
+ * @brief Destroys the component instance.
+ */
+typedef void (*ADUC_LazyComponent_DestroyFunc)(void** componentContext);
+
+/**
+ * @brief Returns false while the component has work in progress that must not be torn down.
+ */
+typedef bool (*ADUC_LazyComponent_IsIdleFunc)(void* componentContext);
+
+/**
+ * @brief A component that is created on first use.
+ */
+typedef struct tagADUC_LazyComponent
+{
+    const char* name; /**< The component name, for logging. */
+    const ADUC_LazyComponent_CreateFunc Create; /**< Creates the instance. */
+    const ADUC_LazyComponent_DestroyFunc Destroy; /**< Destroys the instance. */
+    const ADUC_LazyComponent_IsIdleFunc IsIdle; /**< Optional; the instance is always idle if NULL. */
+    const unsigned int idleTimeoutSeconds; /**< Time without use before the instance is destroyed; 0 for never. */
+    //
+    // Following data is dynamic.
+    // Must be initialized to zero and remain last entries in this struct.
+    //
+    int argc; /**< Arguments passed to Create. */
+    char** argv; /**< Arguments passed to Create. */
+    void* context; /**< The instance, valid if created is true. */
+    bool created; /**< True while the instance exists. */
+    time_t lastUsed; /**< Time of the last request. */
+    unsigned int createCount; /**< Number of times the instance was created. */
+} ADUC_LazyComponent;
+
+/**
+ * @brief Registers @p component without creating it.
+ *
+ * @param component The component.
+ * @param argc Count of arguments in @p argv. Passed to Create.
+ * @param argv Command line parameters. Must outlive the component.
+ */
+void ADUC_LazyComponent_Register(ADUC_LazyComponent* component, int argc, char** argv);
+
+/**
+ * @brief Gets the instance for a request, creating it first if needed.
+ *
+ * @param component The component.
+ * @param now The current time, of a monotonic clock.
+ * @param[out] createdNow Optional; set to true if the instance was created by this call.
+ * @return void* The instance context, or NULL if it could not be created. Check component->created to tell a
+ * NULL context from a failure.
+ */
+void* ADUC_LazyComponent_Acquire(ADUC_LazyComponent* component, time_t now, bool* createdNow);
+
+/**
+ * @brief Destroys the instance if it has been idle for idleTimeoutSeconds.
+ *
+ * @param component The component.
+ * @param now The current time, of the clock passed to ADUC_LazyComponent_Acquire.
+ * @return bool true if the instance was destroyed.
+ */
+bool ADUC_LazyComponent_DoWork(ADUC_LazyComponent* component, time_t now);
+
+/**
+ * @brief Destroys the instance if it exists.
+ *
+ * @param component The component.
+ */
+void ADUC_LazyComponent_Destroy(ADUC_LazyComponent* component);
+
+EXTERN_C_END
+
+#endif // ADUC_LAZY_COMPONENT_UTILS_H
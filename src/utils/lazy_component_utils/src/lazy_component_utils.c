@@ -0,0 +1,87 @@
+/**
+ * @file lazy_component_utils.c
+ * @brief Implements creating PnP components on first use.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/lazy_component_utils.h"
+#include "aduc/logging.h"
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+void ADUC_LazyComponent_Register(ADUC_LazyComponent* component, int argc, char** argv)
+{
+    component->argc = argc;
+    component->argv = argv;
+    component->context = NULL;
+    component->created = false;
+    component->lastUsed = 0;
+    component->createCount = 0;
+}
+
+void* ADUC_LazyComponent_Acquire(ADUC_LazyComponent* component, time_t now, bool* createdNow)
+{
+    if (createdNow != NULL)
+    {
+        *createdNow = false;
+    }
+
+    if (!component->created)
+    {
+        Log_Info("Creating PnP component '%s' on first use.", component->name);
+
+        if (!component->Create(&component->context, component->argc, component->argv))
+        {
+            Log_Error("Failed to create PnP component '%s'.", component->name);
+            component->context = NULL;
+            return NULL;
+        }
+
+        component->created = true;
+        ++component->createCount;
+
+        if (createdNow != NULL)
+        {
+            *createdNow = true;
+        }
+    }
+
+    component->lastUsed = now;
+    return component->context;
+}
+
+bool ADUC_LazyComponent_DoWork(ADUC_LazyComponent* component, time_t now)
+{
+    if (!component->created || component->idleTimeoutSeconds == 0
+        || now - component->lastUsed < (time_t)component->idleTimeoutSeconds)
+    {
+        return false;
+    }
+
+    if (component->IsIdle != NULL && !component->IsIdle(component->context))
+    {
+        return false;
+    }
+
+    Log_Info(
+        "Destroying PnP component '%s' after %u seconds without requests.",
+        component->name,
+        component->idleTimeoutSeconds);
+
+    ADUC_LazyComponent_Destroy(component);
+    return true;
+}
+
+void ADUC_LazyComponent_Destroy(ADUC_LazyComponent* component)
+{
+    if (!component->created)
+    {
+        return;
+    }
+
+    component->Destroy(&component->context);
+    component->context = NULL;
+    component->created = false;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file lazy_component_utils_ut.cpp
+ * @brief Unit Tests for lazy_component_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/lazy_component_utils.h"
+
+#include <catch2/catch.hpp>
+
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief Time the stub Create takes, like a component parsing its configuration.
+ */
+static const std::chrono::milliseconds createCost{ 20 };
+
+static int s_instance = 0;
+static int s_liveInstances = 0;
+static bool s_createFails = false;
+static bool s_busy = false;
+
+static bool StubCreate(void** componentContext, int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    std::this_thread::sleep_for(createCost);
+
+    if (s_createFails)
+    {
+        return false;
+    }
+
+    ++s_liveInstances;
+    *componentContext = &s_instance;
+    return true;
+}
+
+static void StubDestroy(void** componentContext)
+{
+    --s_liveInstances;
+    *componentContext = nullptr;
+}
+
+static bool StubIsIdle(void* componentContext)
+{
+    (void)componentContext;
+    return !s_busy;
+}
+
+static void ResetStubs()
+{
+    s_liveInstances = 0;
+    s_createFails = false;
+    s_busy = false;
+}
+
+TEST_CASE("ADUC_LazyComponent_Register")
+{
+    ResetStubs();
+    ADUC_LazyComponent component{ "test", StubCreate, StubDestroy, StubIsIdle, 60 };
+
+    SECTION("Registering does not create the instance")
+    {
+        ADUC_LazyComponent_Register(&component, 0, nullptr);
+
+        CHECK_FALSE(component.created);
+        CHECK(component.context == nullptr);
+        CHECK(component.createCount == 0);
+        CHECK(s_liveInstances == 0);
+    }
+}
+
+TEST_CASE("ADUC_LazyComponent_Acquire")
+{
+    ResetStubs();
+    ADUC_LazyComponent component{ "test", StubCreate, StubDestroy, StubIsIdle, 60 };
+    ADUC_LazyComponent_Register(&component, 0, nullptr);
+
+    SECTION("The first request is handled by an instance created in the same call")
+    {
+        bool createdNow = false;
+
+        const auto start = std::chrono::steady_clock::now();
+        void* context = ADUC_LazyComponent_Acquire(&component, 100, &createdNow);
+        const auto firstRequestLatency = std::chrono::steady_clock::now() - start;
+
+        CHECK(context == &s_instance);
+        CHECK(createdNow);
+        CHECK(component.created);
+        CHECK(component.lastUsed == 100);
+        CHECK(s_liveInstances == 1);
+
+        // The first request pays for creating the instance, and nothing more.
+        CHECK(firstRequestLatency >= createCost);
+        CHECK(firstRequestLatency < createCost + std::chrono::seconds(1));
+    }
+
+    SECTION("Later requests reuse the instance")
+    {
+        bool createdNow = false;
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 100, &createdNow) == &s_instance);
+
+        const auto start = std::chrono::steady_clock::now();
+        void* context = ADUC_LazyComponent_Acquire(&component, 110, &createdNow);
+        const auto latency = std::chrono::steady_clock::now() - start;
+
+        CHECK(context == &s_instance);
+        CHECK_FALSE(createdNow);
+        CHECK(component.createCount == 1);
+        CHECK(component.lastUsed == 110);
+        CHECK(s_liveInstances == 1);
+        CHECK(latency < createCost);
+    }
+
+    SECTION("A failed creation is retried on the next request")
+    {
+        bool createdNow = true;
+        s_createFails = true;
+
+        CHECK(ADUC_LazyComponent_Acquire(&component, 100, &createdNow) == nullptr);
+        CHECK_FALSE(createdNow);
+        CHECK_FALSE(component.created);
+        CHECK(component.createCount == 0);
+
+        s_createFails = false;
+
+        CHECK(ADUC_LazyComponent_Acquire(&component, 101, &createdNow) == &s_instance);
+        CHECK(createdNow);
+        CHECK(component.createCount == 1);
+    }
+
+    ADUC_LazyComponent_Destroy(&component);
+    CHECK(s_liveInstances == 0);
+}
+
+TEST_CASE("ADUC_LazyComponent_DoWork")
+{
+    ResetStubs();
+    ADUC_LazyComponent component{ "test", StubCreate, StubDestroy, StubIsIdle, 60 };
+    ADUC_LazyComponent_Register(&component, 0, nullptr);
+
+    SECTION("Nothing to do before the first request")
+    {
+        CHECK_FALSE(ADUC_LazyComponent_DoWork(&component, 1000));
+        CHECK(s_liveInstances == 0);
+    }
+
+    SECTION("The instance is destroyed after the idle timeout and created again on the next request")
+    {
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 100, nullptr) == &s_instance);
+
+        CHECK_FALSE(ADUC_LazyComponent_DoWork(&component, 159));
+        CHECK(component.created);
+
+        CHECK(ADUC_LazyComponent_DoWork(&component, 160));
+        CHECK_FALSE(component.created);
+        CHECK(component.context == nullptr);
+        CHECK(s_liveInstances == 0);
+
+        bool createdNow = false;
+        CHECK(ADUC_LazyComponent_Acquire(&component, 200, &createdNow) == &s_instance);
+        CHECK(createdNow);
+        CHECK(component.createCount == 2);
+    }
+
+    SECTION("A request restarts the idle timeout")
+    {
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 100, nullptr) == &s_instance);
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 150, nullptr) == &s_instance);
+
+        CHECK_FALSE(ADUC_LazyComponent_DoWork(&component, 160));
+        CHECK(ADUC_LazyComponent_DoWork(&component, 210));
+    }
+
+    SECTION("A busy instance is kept until it is idle")
+    {
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 100, nullptr) == &s_instance);
+        s_busy = true;
+
+        CHECK_FALSE(ADUC_LazyComponent_DoWork(&component, 1000));
+        CHECK(component.created);
+
+        s_busy = false;
+
+        CHECK(ADUC_LazyComponent_DoWork(&component, 1001));
+        CHECK(s_liveInstances == 0);
+    }
+
+    ADUC_LazyComponent_Destroy(&component);
+    CHECK(s_liveInstances == 0);
+}
+
+TEST_CASE("ADUC_LazyComponent_DoWork without idle timeout")
+{
+    ResetStubs();
+    ADUC_LazyComponent component{ "test", StubCreate, StubDestroy, nullptr, 0 };
+    ADUC_LazyComponent_Register(&component, 0, nullptr);
+
+    SECTION("The instance is kept until it is destroyed")
+    {
+        REQUIRE(ADUC_LazyComponent_Acquire(&component, 100, nullptr) == &s_instance);
+
+        CHECK_FALSE(ADUC_LazyComponent_DoWork(&component, 100000));
+        CHECK(component.created);
+
+        ADUC_LazyComponent_Destroy(&component);
+        CHECK_FALSE(component.created);
+        CHECK(s_liveInstances == 0);
+
+        // Destroying again is a no-op.
+        ADUC_LazyComponent_Destroy(&component);
+        CHECK(s_liveInstances == 0);
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file multicast_fec.h
+ * @brief Reed-Solomon erasure code for multicast payload distribution.
+ *
+ * A block of K source symbols is extended by R repair symbols, all of the same size. Any K of the
+ * K + R symbols reconstruct the block. The code is systematic, so received source symbols are used as
+ * they are and only lost ones are computed. Repair symbols use a Cauchy matrix over GF(2^8), which
+ * limits K + R to 256.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_MULTICAST_FEC_H
+#define ADUC_MULTICAST_FEC_H
+
+#include <aduc/c_utils.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum number of source and repair symbols of a block.
+ */
+#define ADUC_FEC_MAX_SYMBOLS 256
+
+/**
+ * @brief Computes the repair symbols of a block.
+ *
+ * @param source The @p sourceCount source symbols.
+ * @param sourceCount K, the number of source symbols.
+ * @param repair Buffers for the @p repairCount repair symbols.
+ * @param repairCount R, the number of repair symbols.
+ * @param symbolSize The size of each symbol.
+ * @return bool false if the arguments are invalid.
+ */
+bool ADUC_Fec_Encode(
+    const uint8_t* const* source, size_t sourceCount, uint8_t* const* repair, size_t repairCount, size_t symbolSize);
+
+/**
+ * @brief Reconstructs the lost source symbols of a block.
+ *
+ * @param symbols The K + R symbols, source symbols first. Lost source symbols are buffers to reconstruct into,
+ * and lost repair symbols may be NULL.
+ * @param received Whether each of the K + R symbols was received.
+ * @param sourceCount K, the number of source symbols.
+ * @param repairCount R, the number of repair symbols.
+ * @param symbolSize The size of each symbol.
+ * @return bool true if all source symbols are available, i.e. at least K symbols were received.
+ */
+bool ADUC_Fec_Decode(
+    uint8_t* const* symbols, const bool* received, size_t sourceCount, size_t repairCount, size_t symbolSize);
+
+EXTERN_C_END
+
+#endif // ADUC_MULTICAST_FEC_H
@@ -0,0 +1,154 @@
+/**
+ * @file multicast_utils.h
+ * @brief Distribution of update payloads over UDP multicast with forward error correction.
+ *
+ * A sender announces a transmission of a payload on the announce group, then sends the payload on its
+ * data group as blocks of source symbols, each followed by Reed-Solomon repair symbols (see multicast_fec.h).
+ * A receiver that needs the payload waits for an announcement of the payload hash, joins the data group,
+ * and reconstructs every block of which it received enough symbols. The ranges of the remaining blocks are
+ * fetched by unicast with a callback, so a receiver that joins late or loses too many packets still gets
+ * the whole payload.
+ *
+ * The receiver is configured by the optional "multicast" object of the "peerSharing" configuration:
+ *
+ *   "multicast": {
+ *       "announceGroup": "239.255.42.99",
+ *       "announcePort": 50992,
+ *       "interfaceAddress": "0.0.0.0",
+ *       "announceTimeoutMs": 2000,
+ *       "idleTimeoutMs": 3000
+ *   }
+ *
+ * Multicast is not authenticated. The caller must validate the payload against the manifest hash.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_MULTICAST_UTILS_H
+#define ADUC_MULTICAST_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum length of an IPv4 address literal, including the terminator.
+ */
+#define ADUC_MULTICAST_MAX_ADDRESS 16
+
+/**
+ * @brief Maximum length of a payload hash, including the terminator.
+ */
+#define ADUC_MULTICAST_MAX_HASH 128
+
+/**
+ * @brief Maximum symbol size, so that a symbol with its header fits in a datagram without IP fragmentation.
+ */
+#define ADUC_MULTICAST_MAX_SYMBOL_SIZE 1400
+
+/**
+ * @brief The receiver configuration.
+ */
+typedef struct tagADUC_Multicast_ReceiverConfig
+{
+    bool enabled; /**< True if "multicast" is configured. */
+    char announceGroup[ADUC_MULTICAST_MAX_ADDRESS]; /**< Group of the announcements. */
+    unsigned short announcePort; /**< Port of the announcements. */
+    char interfaceAddress[ADUC_MULTICAST_MAX_ADDRESS]; /**< Address of the interface to join on. */
+    unsigned int announceTimeoutMs; /**< Time to wait for an announcement of the payload. */
+    unsigned int idleTimeoutMs; /**< Time without packets after which the transmission is considered over. */
+} ADUC_Multicast_ReceiverConfig;
+
+/**
+ * @brief The sender options.
+ */
+typedef struct tagADUC_Multicast_SenderOptions
+{
+    char announceGroup[ADUC_MULTICAST_MAX_ADDRESS]; /**< Group of the announcements. */
+    unsigned short announcePort; /**< Port of the announcements. */
+    char dataGroup[ADUC_MULTICAST_MAX_ADDRESS]; /**< Group of the payload. */
+    unsigned short dataPort; /**< Port of the payload. */
+    char interfaceAddress[ADUC_MULTICAST_MAX_ADDRESS]; /**< Address of the interface to send on. */
+    unsigned int ttl; /**< Multicast TTL. */
+    unsigned int symbolSize; /**< Size of a symbol. */
+    unsigned int sourceSymbols; /**< Source symbols per block, K. */
+    unsigned int repairSymbols; /**< Repair symbols per block, R. */
+    unsigned int rateKBps; /**< Send rate in KiB/s, including repair symbols. 0 is unlimited. */
+    unsigned int leadTimeMs; /**< Time the transmission is announced before the payload is sent. */
+    unsigned int lossPercent; /**< Percentage of data packets dropped on purpose, to test receivers. */
+} ADUC_Multicast_SenderOptions;
+
+/**
+ * @brief Where the bytes of a received payload came from.
+ */
+typedef struct tagADUC_Multicast_Stats
+{
+    uint64_t bytesReceived; /**< Bytes of source symbols received. */
+    uint64_t bytesRepaired; /**< Bytes of source symbols reconstructed from repair symbols. */
+    uint64_t bytesFetched; /**< Bytes fetched by unicast. */
+} ADUC_Multicast_Stats;
+
+/**
+ * @brief Fetches a range of the payload by unicast.
+ *
+ * @param context The context passed to ADUC_Multicast_Receive.
+ * @param fd The target file, to be written at @p offset with pwrite.
+ * @param offset The offset of the range.
+ * @param length The length of the range.
+ * @return bool true if the whole range was written.
+ */
+typedef bool (*ADUC_Multicast_FetchRangeFunc)(void* context, int fd, uint64_t offset, uint64_t length);
+
+/**
+ * @brief Parses the "multicast" configuration object.
+ *
+ * @param[out] config The parsed configuration. Disabled if @p multicastObj is NULL or invalid.
+ * @param multicastObj The "multicast" object, or NULL if not configured.
+ * @return bool true if not configured or valid.
+ */
+bool ADUC_Multicast_ParseReceiverConfig(ADUC_Multicast_ReceiverConfig* config, const JSON_Object* multicastObj);
+
+/**
+ * @brief Initializes sender options with the defaults.
+ */
+void ADUC_Multicast_InitSenderOptions(ADUC_Multicast_SenderOptions* options);
+
+/**
+ * @brief Announces and sends a payload. Returns after the transmission.
+ *
+ * @param options The sender options.
+ * @param filePath The payload file.
+ * @param hash The hash of the payload from the update manifest.
+ * @return bool true if the payload was sent.
+ */
+bool ADUC_Multicast_Send(const ADUC_Multicast_SenderOptions* options, const char* filePath, const char* hash);
+
+/**
+ * @brief Receives a payload from a multicast transmission, and fetches the ranges that were not received.
+ *
+ * @param config An enabled receiver configuration.
+ * @param hash The hash of the payload from the update manifest.
+ * @param size The payload size, or 0 if unknown. Transmissions of another size are ignored.
+ * @param filePath The target file path.
+ * @param fetchRange The unicast fallback, or NULL to fail if a range was not received.
+ * @param context The context for @p fetchRange.
+ * @param[out] stats Where the bytes came from. May be NULL.
+ * @return bool true if the whole payload was written. false without touching @p filePath if no transmission
+ * of the payload was announced in time.
+ */
+bool ADUC_Multicast_Receive(
+    const ADUC_Multicast_ReceiverConfig* config,
+    const char* hash,
+    uint64_t size,
+    const char* filePath,
+    ADUC_Multicast_FetchRangeFunc fetchRange,
+    void* context,
+    ADUC_Multicast_Stats* stats);
+
+EXTERN_C_END
+
+#endif // ADUC_MULTICAST_UTILS_H
@@ -0,0 +1,170 @@
+/**
+ * @file main.c
+ * @brief Sends an update payload to the agents on the local network over multicast.
+ *
+ * Usage: adu-multicast-sender [options] <file> <hash>
+ *
+ * <hash> is the payload hash from the update manifest, which receivers look for in the announcements.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/logging.h"
+#include "aduc/multicast_utils.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+static void PrintUsage(const char* program)
+{
+    printf(
+        "Usage: %s [options] <file> <hash>\n"
+        "  -g, --announce-group <address>  Group of the announcements.\n"
+        "  -p, --announce-port <port>      Port of the announcements.\n"
+        "  -G, --data-group <address>      Group of the payload.\n"
+        "  -P, --data-port <port>          Port of the payload.\n"
+        "  -i, --interface <address>       Address of the interface to send on.\n"
+        "  -t, --ttl <hops>                Multicast TTL.\n"
+        "  -s, --symbol-size <bytes>       Size of a symbol, at most %d.\n"
+        "  -k, --source-symbols <count>    Source symbols per block.\n"
+        "  -r, --repair-symbols <count>    Repair symbols per block.\n"
+        "  -R, --rate <KiB/s>              Send rate, 0 for unlimited.\n"
+        "  -w, --lead-time <ms>            Time the payload is announced before it is sent.\n"
+        "  -x, --loss <percent>            Drop data packets on purpose, to test receivers.\n"
+        "  -l, --log-level <0-3>           Log verbosity level.\n"
+        "  -h, --help                      Show this help.\n",
+        program,
+        ADUC_MULTICAST_MAX_SYMBOL_SIZE);
+}
+
+static bool ParseUInt(const char* text, unsigned int maxValue, unsigned int* value)
+{
+    char* end = NULL;
+    errno = 0;
+    unsigned long number = strtoul(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || number > maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+static bool CopyAddress(char* address, const char* text)
+{
+    const size_t length = strlen(text);
+    return ADUC_Safe_StrCopyN(address, text, ADUC_MULTICAST_MAX_ADDRESS, length) == length;
+}
+
+int main(int argc, char** argv)
+{
+    ADUC_Multicast_SenderOptions options;
+    unsigned int port = 0;
+    unsigned int logLevel = ADUC_LOG_INFO;
+    bool valid = true;
+
+    // clang-format off
+    static const struct option longOptions[] =
+    {
+        { "announce-group", required_argument, NULL, 'g' },
+        { "announce-port",  required_argument, NULL, 'p' },
+        { "data-group",     required_argument, NULL, 'G' },
+        { "data-port",      required_argument, NULL, 'P' },
+        { "interface",      required_argument, NULL, 'i' },
+        { "ttl",            required_argument, NULL, 't' },
+        { "symbol-size",    required_argument, NULL, 's' },
+        { "source-symbols", required_argument, NULL, 'k' },
+        { "repair-symbols", required_argument, NULL, 'r' },
+        { "rate",           required_argument, NULL, 'R' },
+        { "lead-time",      required_argument, NULL, 'w' },
+        { "loss",           required_argument, NULL, 'x' },
+        { "log-level",      required_argument, NULL, 'l' },
+        { "help",           no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    // clang-format on
+
+    ADUC_Multicast_InitSenderOptions(&options);
+
+    while (valid)
+    {
+        int option = getopt_long(argc, argv, "g:p:G:P:i:t:s:k:r:R:w:x:l:h", longOptions, NULL);
+        if (option == -1)
+        {
+            break;
+        }
+
+
+        switch (option)
+        {
+        case 'g':
+            valid = CopyAddress(options.announceGroup, optarg);
+            break;
+        case 'p':
+            valid = ParseUInt(optarg, 65535, &port) && port > 0;
+            options.announcePort = (unsigned short)port;
+            break;
+        case 'G':
+            valid = CopyAddress(options.dataGroup, optarg);
+            break;
+        case 'P':
+            valid = ParseUInt(optarg, 65535, &port) && port > 0;
+            options.dataPort = (unsigned short)port;
+            break;
+        case 'i':
+            valid = CopyAddress(options.interfaceAddress, optarg);
+            break;
+        case 't':
+            valid = ParseUInt(optarg, 255, &options.ttl);
+            break;
+        case 's':
+            valid = ParseUInt(optarg, ADUC_MULTICAST_MAX_SYMBOL_SIZE, &options.symbolSize);
+            break;
+        case 'k':
+            valid = ParseUInt(optarg, 255, &options.sourceSymbols);
+            break;
+        case 'r':
+            valid = ParseUInt(optarg, 255, &options.repairSymbols);
+            break;
+        case 'R':
+            valid = ParseUInt(optarg, 1024 * 1024, &options.rateKBps);
+            break;
+        case 'w':
+            valid = ParseUInt(optarg, 60 * 60 * 1000, &options.leadTimeMs);
+            break;
+        case 'x':
+            valid = ParseUInt(optarg, 100, &options.lossPercent);
+            break;
+        case 'l':
+            valid = ParseUInt(optarg, ADUC_LOG_ERROR, &logLevel);
+            break;
+        case 'h':
+            PrintUsage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            valid = false;
+            break;
+        }
+    }
+
+    if (!valid || argc - optind != 2)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ADUC_Logging_Init((ADUC_LOG_SEVERITY)logLevel, "adu-multicast-sender");
+
+    const bool sent = ADUC_Multicast_Send(&options, argv[optind], argv[optind + 1]);
+
+    ADUC_Logging_Uninit();
+    return sent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,284 @@
+/**
+ * @file multicast_fec.c
+ * @brief Implements the Reed-Solomon erasure code for multicast payload distribution.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/multicast_fec.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+/**
+ * @brief The primitive polynomial x^8 + x^4 + x^3 + x^2 + 1 of GF(2^8).
+ */
+#define GF_POLYNOMIAL 0x11d
+
+static uint8_t s_gfExp[512];
+static uint8_t s_gfLog[256];
+static pthread_once_t s_gfTablesOnce = PTHREAD_ONCE_INIT;
+
+static void InitGfTables(void)
+{
+    unsigned int x = 1;
+    for (unsigned int i = 0; i < 255; ++i)
+    {
+        s_gfExp[i] = (uint8_t)x;
+        s_gfLog[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100)
+        {
+            x ^= GF_POLYNOMIAL;
+        }
+    }
+
+    // Doubling the table avoids the modulo in GfMul.
+    for (unsigned int i = 255; i < 512; ++i)
+    {
+        s_gfExp[i] = s_gfExp[i - 255];
+    }
+}
+
+static uint8_t GfMul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0)
+    {
+        return 0;
+    }
+
+    return s_gfExp[s_gfLog[a] + s_gfLog[b]];
+}
+
+static uint8_t GfInv(uint8_t a)
+{
+    return s_gfExp[255 - s_gfLog[a]];
+}
+
+/**
+ * @brief Element of the Cauchy matrix for repair symbol @p repairIndex and source symbol @p sourceIndex.
+ * @details 1 / (x + y) with x = K + repairIndex and y = sourceIndex, which are distinct for K + R <= 256.
+ */
+static uint8_t CauchyElement(size_t sourceCount, size_t repairIndex, size_t sourceIndex)
+{
+    return GfInv((uint8_t)((sourceCount + repairIndex) ^ sourceIndex));
+}
+
+/**
+ * @brief dest ^= coefficient * src over @p size bytes.
+ */
+static void MulAdd(uint8_t* dest, const uint8_t* src, uint8_t coefficient, size_t size)
+{
+    uint8_t table[256];
+
+    if (coefficient == 0)
+    {
+        return;
+    }
+
+    for (unsigned int b = 0; b < 256; ++b)
+    {
+        table[b] = GfMul(coefficient, (uint8_t)b);
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        dest[i] ^= table[src[i]];
+    }
+}
+
+static bool IsValidBlockShape(size_t sourceCount, size_t repairCount, size_t symbolSize)
+{
+    return sourceCount > 0 && symbolSize > 0 && sourceCount + repairCount <= ADUC_FEC_MAX_SYMBOLS;
+}
+
+bool ADUC_Fec_Encode(
+    const uint8_t* const* source, size_t sourceCount, uint8_t* const* repair, size_t repairCount, size_t symbolSize)
+{
+    if (source == NULL || (repair == NULL && repairCount > 0)
+        || !IsValidBlockShape(sourceCount, repairCount, symbolSize))
+    {
+        return false;
+    }
+
+    pthread_once(&s_gfTablesOnce, InitGfTables);
+
+    for (size_t r = 0; r < repairCount; ++r)
+    {
+        memset(repair[r], 0, symbolSize);
+        for (size_t s = 0; s < sourceCount; ++s)
+        {
+            MulAdd(repair[r], source[s], CauchyElement(sourceCount, r, s), symbolSize);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Inverts the @p n x @p n matrix @p m in place with Gauss-Jordan elimination.
+ *
+ * @param m The matrix, row-major. Holds the inverse on success.
+ * @param work Scratch space of n * n bytes.
+ * @return bool false if the matrix is singular, which does not happen for rows of the identity and Cauchy matrices.
+ */
+static bool InvertMatrix(uint8_t* m, uint8_t* work, size_t n)
+{
+    // work starts as the identity and becomes the inverse.
+    memset(work, 0, n * n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        work[i * n + i] = 1;
+    }
+
+    for (size_t col = 0; col < n; ++col)
+    {
+        size_t pivot = col;
+        while (pivot < n && m[pivot * n + col] == 0)
+        {
+            ++pivot;
+        }
+
+        if (pivot == n)
+        {
+            return false;
+        }
+
+        if (pivot != col)
+        {
+            for (size_t k = 0; k < n; ++k)
+            {
+                uint8_t tmp = m[col * n + k];
+                m[col * n + k] = m[pivot * n + k];
+                m[pivot * n + k] = tmp;
+
+                tmp = work[col * n + k];
+                work[col * n + k] = work[pivot * n + k];
+                work[pivot * n + k] = tmp;
+            }
+        }
+
+        const uint8_t scale = GfInv(m[col * n + col]);
+        for (size_t k = 0; k < n; ++k)
+        {
+            m[col * n + k] = GfMul(m[col * n + k], scale);
+            work[col * n + k] = GfMul(work[col * n + k], scale);
+        }
+
+        for (size_t row = 0; row < n; ++row)
+        {
+            const uint8_t factor = m[row * n + col];
+            if (row == col || factor == 0)
+            {
+                continue;
+            }
+
+            for (size_t k = 0; k < n; ++k)
+            {
+                m[row * n + k] ^= GfMul(factor, m[col * n + k]);
+                work[row * n + k] ^= GfMul(factor, work[col * n + k]);
+            }
+        }
+    }
+
+    memcpy(m, work, n * n);
+    return true;
+}
+
+bool ADUC_Fec_Decode(
+    uint8_t* const* symbols, const bool* received, size_t sourceCount, size_t repairCount, size_t symbolSize)
+{
+    bool succeeded = false;
+    size_t rows[ADUC_FEC_MAX_SYMBOLS];
+    size_t rowCount = 0;
+    size_t lostCount = 0;
+    uint8_t* matrix = NULL;
+    uint8_t* work = NULL;
+
+    if (symbols == NULL || received == NULL || !IsValidBlockShape(sourceCount, repairCount, symbolSize))
+    {
+        return false;
+    }
+
+    // Received source symbols first, so that as few repair symbols as possible are combined.
+    for (size_t s = 0; s < sourceCount; ++s)
+    {
+        if (received[s])
+        {
+            rows[rowCount++] = s;
+        }
+        else
+        {
+            ++lostCount;
+        }
+    }
+
+    if (lostCount == 0)
+    {
+        return true;
+    }
+
+    for (size_t r = 0; r < repairCount && rowCount < sourceCount; ++r)
+    {
+        if (received[sourceCount + r])
+        {
+            rows[rowCount++] = sourceCount + r;
+        }
+    }
+
+    if (rowCount < sourceCount)
+    {
+        return false;
+    }
+
+    pthread_once(&s_gfTablesOnce, InitGfTables);
+
+    matrix = malloc(sourceCount * sourceCount);
+    work = malloc(sourceCount * sourceCount);
+    if (matrix == NULL || work == NULL)
+    {
+        goto done;
+    }
+
+    // Row i of the matrix maps the source symbols to the i-th received symbol.
+    for (size_t i = 0; i < sourceCount; ++i)
+    {
+        for (size_t s = 0; s < sourceCount; ++s)
+        {
+            matrix[i * sourceCount + s] = rows[i] < sourceCount
+                ? (uint8_t)(rows[i] == s)
+                : CauchyElement(sourceCount, rows[i] - sourceCount, s);
+        }
+    }
+
+    if (!InvertMatrix(matrix, work, sourceCount))
+    {
+        goto done;
+    }
+
+    // Lost source symbol s is row s of the inverse applied to the received symbols.
+    for (size_t s = 0; s < sourceCount; ++s)
+    {
+        if (received[s])
+        {
+            continue;
+        }
+
+        memset(symbols[s], 0, symbolSize);
+        for (size_t i = 0; i < sourceCount; ++i)
+        {
+            MulAdd(symbols[s], symbols[rows[i]], matrix[s * sourceCount + i], symbolSize);
+        }
+    }
+
+    succeeded = true;
+
+done:
+    free(work);
+    free(matrix);
+    return succeeded;
+}
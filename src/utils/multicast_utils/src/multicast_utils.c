@@ -0,0 +1,1147 @@
+/**
+ * @file multicast_utils.c
+ * @brief Implements distribution of update payloads over UDP multicast with forward error correction.
+ *
+ * Announcements are text datagrams on the announce group:
+ *
+ *   ADUMCAST1 ANNOUNCE <hash> <sessionId> <dataGroup> <dataPort> <size> <symbolSize> <sourceSymbols>
+ *
+ * Symbols are binary datagrams on the data group, with a header in network byte order:
+ *
+ *   magic u32 | version u8 | type u8 | symbolSize u16 | sessionId u32 | blockIndex u32 | size u64 |
+ *   symbolIndex u16 | blockSourceSymbols u16 | blockRepairSymbols u16 | reserved u16 | symbol
+ *
+ * Blocks have sourceSymbols symbols, except the last one which has as many as the rest of the payload needs.
+ * The last symbol of the payload is padded with zeros.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/multicast_utils.h"
+#include "aduc/logging.h"
+#include "aduc/multicast_fec.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN, ADUC_StrNLen
+
+#include <arpa/inet.h> // inet_pton, htonl
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h> // PRIu64, SCNu64
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h> // snprintf, sscanf
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define ANNOUNCE_MAGIC "ADUMCAST1"
+#define PACKET_MAGIC 0x4144554dU // "ADUM"
+#define PACKET_VERSION 1
+#define PACKET_TYPE_DATA 1
+#define PACKET_TYPE_END 2
+#define PACKET_HEADER_SIZE 32
+
+/**
+ * @brief Maximum length of an announcement, including the terminator.
+ */
+#define MAX_ANNOUNCEMENT 256
+
+/**
+ * @brief Interval of the announcements during a transmission.
+ */
+#define ANNOUNCE_INTERVAL_MS 250
+
+/**
+ * @brief Number of end packets sent after the payload, in case some are lost.
+ */
+#define END_PACKET_COUNT 3
+
+/**
+ * @brief Receive buffer requested for the data socket, to ride out short scheduling delays.
+ */
+#define RECEIVE_BUFFER_SIZE (4 * 1024 * 1024)
+
+#define DEFAULT_ANNOUNCE_GROUP "239.255.42.99"
+#define DEFAULT_ANNOUNCE_PORT 50992
+#define DEFAULT_DATA_GROUP "239.255.42.100"
+#define DEFAULT_DATA_PORT 50993
+#define DEFAULT_INTERFACE_ADDRESS "0.0.0.0"
+#define DEFAULT_ANNOUNCE_TIMEOUT_MS 2000
+#define DEFAULT_IDLE_TIMEOUT_MS 3000
+#define DEFAULT_TTL 1
+#define DEFAULT_SYMBOL_SIZE 1024
+#define DEFAULT_SOURCE_SYMBOLS 64
+#define DEFAULT_REPAIR_SYMBOLS 16
+#define DEFAULT_RATE_KBPS 8192
+#define DEFAULT_LEAD_TIME_MS 5000
+
+static const char* CONFIG_MULTICAST = "peerSharing.multicast";
+static const char* CONFIG_ANNOUNCE_GROUP = "announceGroup";
+static const char* CONFIG_ANNOUNCE_PORT = "announcePort";
+static const char* CONFIG_INTERFACE_ADDRESS = "interfaceAddress";
+static const char* CONFIG_ANNOUNCE_TIMEOUT_MS = "announceTimeoutMs";
+static const char* CONFIG_IDLE_TIMEOUT_MS = "idleTimeoutMs";
+
+/**
+ * @brief The header of a symbol datagram.
+ */
+typedef struct tagADUC_Multicast_PacketHeader
+{
+    uint8_t type; /**< PACKET_TYPE_DATA or PACKET_TYPE_END. */
+    uint16_t symbolSize; /**< Size of the symbols. */
+    uint32_t sessionId; /**< Id of the transmission. */
+    uint32_t blockIndex; /**< Index of the block. */
+    uint64_t size; /**< Payload size. */
+    uint16_t symbolIndex; /**< Index of the symbol in the block. Source symbols come first. */
+    uint16_t blockSourceSymbols; /**< Source symbols of the block. */
+    uint16_t blockRepairSymbols; /**< Repair symbols of the block. */
+} ADUC_Multicast_PacketHeader;
+
+/**
+ * @brief An announced transmission.
+ */
+typedef struct tagADUC_Multicast_Session
+{
+    uint32_t sessionId; /**< Id of the transmission. */
+    char dataGroup[ADUC_MULTICAST_MAX_ADDRESS]; /**< Group of the payload. */
+    unsigned short dataPort; /**< Port of the payload. */
+    uint64_t size; /**< Payload size. */
+    unsigned int symbolSize; /**< Size of the symbols. */
+    unsigned int sourceSymbols; /**< Source symbols of a full block. */
+} ADUC_Multicast_Session;
+
+/**
+ * @brief Reception state of a block.
+ */
+typedef struct tagADUC_Multicast_Block
+{
+    bool complete; /**< True if all source symbols are in the file. */
+    unsigned int receivedCount; /**< Number of distinct symbols received. */
+    bool* received; /**< Whether each symbol was received. NULL until the first symbol. */
+    uint8_t* repair; /**< Received repair symbols. NULL until the first symbol. */
+} ADUC_Multicast_Block;
+
+//
+// Configuration
+//
+
+/**
+ * @brief Reads a non-negative integer field.
+ *
+ * @return false if the field is present but not a number in [0, @p maxValue].
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int maxValue, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 0 || number > (double)maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+/**
+ * @brief Reads an IPv4 address field. A multicast address is required if @p isGroup.
+ */
+static bool GetAddressField(const JSON_Object* obj, const char* name, bool isGroup, char* address)
+{
+    const char* value = address;
+    struct in_addr addr;
+
+    if (json_object_has_value(obj, name))
+    {
+        value = json_object_get_string(obj, name);
+    }
+
+    if (value == NULL || inet_pton(AF_INET, value, &addr) != 1 || (isGroup && !IN_MULTICAST(ntohl(addr.s_addr))))
+    {
+        return false;
+    }
+
+    return ADUC_Safe_StrCopyN(address, value, ADUC_MULTICAST_MAX_ADDRESS, strlen(value)) == strlen(value);
+}
+
+bool ADUC_Multicast_ParseReceiverConfig(ADUC_Multicast_ReceiverConfig* config, const JSON_Object* multicastObj)
+{
+    unsigned int announcePort = DEFAULT_ANNOUNCE_PORT;
+
+    memset(config, 0, sizeof(*config));
+
+    if (multicastObj == NULL)
+    {
+        return true;
+    }
+
+    memcpy(config->announceGroup, DEFAULT_ANNOUNCE_GROUP, sizeof(DEFAULT_ANNOUNCE_GROUP));
+    memcpy(config->interfaceAddress, DEFAULT_INTERFACE_ADDRESS, sizeof(DEFAULT_INTERFACE_ADDRESS));
+    config->announceTimeoutMs = DEFAULT_ANNOUNCE_TIMEOUT_MS;
+    config->idleTimeoutMs = DEFAULT_IDLE_TIMEOUT_MS;
+
+    if (!GetAddressField(multicastObj, CONFIG_ANNOUNCE_GROUP, true, config->announceGroup)
+        || !GetAddressField(multicastObj, CONFIG_INTERFACE_ADDRESS, false, config->interfaceAddress)
+        || !GetUIntField(multicastObj, CONFIG_ANNOUNCE_PORT, UINT16_MAX, &announcePort) || announcePort == 0
+        || !GetUIntField(multicastObj, CONFIG_ANNOUNCE_TIMEOUT_MS, 60 * 60 * 1000, &config->announceTimeoutMs)
+        || !GetUIntField(multicastObj, CONFIG_IDLE_TIMEOUT_MS, 60 * 60 * 1000, &config->idleTimeoutMs)
+        || config->idleTimeoutMs == 0)
+    {
+        Log_Error("Invalid %s, expected a multicast group, IPv4 addresses, a port and timeouts.", CONFIG_MULTICAST);
+        memset(config, 0, sizeof(*config));
+        return false;
+    }
+
+    config->announcePort = (unsigned short)announcePort;
+    config->enabled = true;
+    return true;
+}
+
+void ADUC_Multicast_InitSenderOptions(ADUC_Multicast_SenderOptions* options)
+{
+    memset(options, 0, sizeof(*options));
+    memcpy(options->announceGroup, DEFAULT_ANNOUNCE_GROUP, sizeof(DEFAULT_ANNOUNCE_GROUP));
+    options->announcePort = DEFAULT_ANNOUNCE_PORT;
+    memcpy(options->dataGroup, DEFAULT_DATA_GROUP, sizeof(DEFAULT_DATA_GROUP));
+    options->dataPort = DEFAULT_DATA_PORT;
+    memcpy(options->interfaceAddress, DEFAULT_INTERFACE_ADDRESS, sizeof(DEFAULT_INTERFACE_ADDRESS));
+    options->ttl = DEFAULT_TTL;
+    options->symbolSize = DEFAULT_SYMBOL_SIZE;
+    options->sourceSymbols = DEFAULT_SOURCE_SYMBOLS;
+    options->repairSymbols = DEFAULT_REPAIR_SYMBOLS;
+    options->rateKBps = DEFAULT_RATE_KBPS;
+    options->leadTimeMs = DEFAULT_LEAD_TIME_MS;
+}
+
+//
+// Helpers
+//
+
+static int64_t GetMonotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void SleepMs(int64_t ms)
+{
+    if (ms <= 0)
+    {
+        return;
+    }
+
+    struct timespec duration = { .tv_sec = (time_t)(ms / 1000), .tv_nsec = (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&duration, &duration) != 0 && errno == EINTR)
+    {
+    }
+}
+
+static bool IsValidHash(const char* hash)
+{
+    size_t length = ADUC_StrNLen(hash, ADUC_MULTICAST_MAX_HASH);
+    if (hash == NULL || length == 0 || length == ADUC_MULTICAST_MAX_HASH)
+    {
+        return false;
+    }
+
+    for (const char* c = hash; *c != '\0'; ++c)
+    {
+        if (*c <= ' ' || *c > '~')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool MakeSockAddr(const char* address, unsigned short port, struct sockaddr_in* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    return inet_pton(AF_INET, address, &addr->sin_addr) == 1;
+}
+
+/**
+ * @brief Creates a socket that receives datagrams of @p group on @p port.
+ */
+static int CreateGroupSocket(const char* group, unsigned short port, const char* interfaceAddress)
+{
+    struct sockaddr_in addr;
+    struct ip_mreq membership;
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    int receiveBufferSize = RECEIVE_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+    // Bound to the group, so that datagrams of other groups on the same port are not received.
+    memset(&membership, 0, sizeof(membership));
+    if (!MakeSockAddr(group, port, &addr) || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || inet_pton(AF_INET, group, &membership.imr_multiaddr) != 1
+        || inet_pton(AF_INET, interfaceAddress, &membership.imr_interface) != 1
+        || setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+    {
+        Log_Error("Cannot join %s:%u, errno: %d", group, port, errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void PutU16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+}
+
+static void PutU32(uint8_t* p, uint32_t value)
+{
+    PutU16(p, (uint16_t)(value >> 16));
+    PutU16(p + 2, (uint16_t)value);
+}
+
+static uint16_t GetU16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t GetU32(const uint8_t* p)
+{
+    return ((uint32_t)GetU16(p) << 16) | GetU16(p + 2);
+}
+
+static void WriteHeader(uint8_t* packet, const ADUC_Multicast_PacketHeader* header)
+{
+    memset(packet, 0, PACKET_HEADER_SIZE);
+    PutU32(packet, PACKET_MAGIC);
+    packet[4] = PACKET_VERSION;
+    packet[5] = header->type;
+    PutU16(packet + 6, header->symbolSize);
+    PutU32(packet + 8, header->sessionId);
+    PutU32(packet + 12, header->blockIndex);
+    PutU32(packet + 16, (uint32_t)(header->size >> 32));
+    PutU32(packet + 20, (uint32_t)header->size);
+    PutU16(packet + 24, header->symbolIndex);
+    PutU16(packet + 26, header->blockSourceSymbols);
+    PutU16(packet + 28, header->blockRepairSymbols);
+}
+
+static bool ReadHeader(const uint8_t* packet, size_t length, ADUC_Multicast_PacketHeader* header)
+{
+    if (length < PACKET_HEADER_SIZE || GetU32(packet) != PACKET_MAGIC || packet[4] != PACKET_VERSION)
+    {
+        return false;
+    }
+
+    header->type = packet[5];
+    header->symbolSize = GetU16(packet + 6);
+    header->sessionId = GetU32(packet + 8);
+    header->blockIndex = GetU32(packet + 12);
+    header->size = ((uint64_t)GetU32(packet + 16) << 32) | GetU32(packet + 20);
+    header->symbolIndex = GetU16(packet + 24);
+    header->blockSourceSymbols = GetU16(packet + 26);
+    header->blockRepairSymbols = GetU16(packet + 28);
+    return true;
+}
+
+/**
+ * @brief Gets the number of source symbols of block @p blockIndex.
+ */
+static unsigned int
+GetBlockSourceSymbols(uint64_t size, unsigned int symbolSize, unsigned int sourceSymbols, uint64_t blockIndex)
+{
+    const uint64_t blockSize = (uint64_t)symbolSize * sourceSymbols;
+    const uint64_t remaining = size - blockIndex * blockSize;
+    return remaining >= blockSize ? sourceSymbols : (unsigned int)((remaining + symbolSize - 1) / symbolSize);
+}
+
+/**
+ * @brief Gets the number of repair symbols of a block with @p blockSourceSymbols source symbols.
+ */
+static unsigned int GetBlockRepairSymbols(unsigned int blockSourceSymbols, unsigned int repairSymbols)
+{
+    const unsigned int maxRepair = ADUC_FEC_MAX_SYMBOLS - blockSourceSymbols;
+    return repairSymbols < maxRepair ? repairSymbols : maxRepair;
+}
+
+static uint64_t GetBlockCount(uint64_t size, unsigned int symbolSize, unsigned int sourceSymbols)
+{
+    const uint64_t blockSize = (uint64_t)symbolSize * sourceSymbols;
+    return (size + blockSize - 1) / blockSize;
+}
+
+/**
+ * @brief Reads @p length bytes at @p offset, zero-filling past the end of the file.
+ */
+static bool ReadAt(int fd, uint8_t* buffer, size_t length, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t readSize = pread(fd, buffer + done, length - done, (off_t)(offset + done));
+        if (readSize < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (readSize < 0)
+        {
+            return false;
+        }
+
+        if (readSize == 0)
+        {
+            memset(buffer + done, 0, length - done);
+            break;
+        }
+
+        done += (size_t)readSize;
+    }
+
+    return true;
+}
+
+static bool WriteAt(int fd, const uint8_t* buffer, size_t length, uint64_t offset)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t written = pwrite(fd, buffer + done, length - done, (off_t)(offset + done));
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+        done += (size_t)written;
+    }
+
+    return true;
+}
+
+//
+// Sender
+//
+
+/**
+ * @brief State of a transmission.
+ */
+typedef struct tagADUC_Multicast_Sender
+{
+    const ADUC_Multicast_SenderOptions* options; /**< The options. */
+    int fd; /**< The sending socket. */
+    struct sockaddr_in announceAddr; /**< Announce group. */
+    struct sockaddr_in dataAddr; /**< Data group. */
+    char announcement[MAX_ANNOUNCEMENT]; /**< The announcement. */
+    size_t announcementLength; /**< Length of the announcement. */
+    int64_t nextAnnounceMs; /**< Time of the next announcement. */
+    int64_t startMs; /**< Start of the payload transmission, for pacing. */
+    uint64_t bytesSent; /**< Bytes sent since startMs, for pacing. */
+    unsigned int lossSeed; /**< State of the simulated loss. */
+} ADUC_Multicast_Sender;
+
+/**
+ * @brief Sends the announcement if it is due.
+ */
+static void AnnounceIfDue(ADUC_Multicast_Sender* sender)
+{
+    const int64_t now = GetMonotonicMs();
+    if (now < sender->nextAnnounceMs)
+    {
+        return;
+    }
+
+    sendto(
+        sender->fd,
+        sender->announcement,
+        sender->announcementLength,
+        0,
+        (struct sockaddr*)&sender->announceAddr,
+        sizeof(sender->announceAddr));
+    sender->nextAnnounceMs = now + ANNOUNCE_INTERVAL_MS;
+}
+
+/**
+ * @brief Sends a data group packet, paced to the configured rate.
+ */
+static bool SendPacket(ADUC_Multicast_Sender* sender, const uint8_t* packet, size_t length, bool mayDrop)
+{
+    const unsigned int rateKBps = sender->options->rateKBps;
+
+    if (rateKBps > 0)
+    {
+        const int64_t dueMs = sender->startMs + (int64_t)(sender->bytesSent / rateKBps * 1000 / 1024);
+        SleepMs(dueMs - GetMonotonicMs());
+    }
+
+    sender->bytesSent += length;
+    AnnounceIfDue(sender);
+
+    if (mayDrop && sender->options->lossPercent > 0
+        && (unsigned int)(rand_r(&sender->lossSeed) % 100) < sender->options->lossPercent)
+    {
+        return true;
+    }
+
+    while (sendto(sender->fd, packet, length, 0, (struct sockaddr*)&sender->dataAddr, sizeof(sender->dataAddr)) < 0)
+    {
+        // The socket buffer is full when sending faster than the interface. Retry after a short wait.
+        if (errno != ENOBUFS && errno != EAGAIN && errno != EINTR)
+        {
+            Log_Error(
+                "Failed to send to %s:%u, errno: %d", sender->options->dataGroup, sender->options->dataPort, errno);
+            return false;
+        }
+
+        SleepMs(1);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Creates the sending socket.
+ */
+static int CreateSenderSocket(const ADUC_Multicast_SenderOptions* options)
+{
+    struct in_addr interfaceAddr;
+    unsigned char ttl = (unsigned char)(options->ttl > 255 ? 255 : options->ttl);
+    unsigned char loop = 1;
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    if (inet_pton(AF_INET, options->interfaceAddress, &interfaceAddr) != 1
+        || setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddr, sizeof(interfaceAddr)) != 0
+        || setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0
+        || setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) != 0)
+    {
+        Log_Error("Cannot configure multicast on %s, errno: %d", options->interfaceAddress, errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool ADUC_Multicast_Send(const ADUC_Multicast_SenderOptions* options, const char* filePath, const char* hash)
+{
+    bool succeeded = false;
+    int fileFd = -1;
+    uint8_t* blockBuffer = NULL;
+    uint8_t* packet = NULL;
+    ADUC_Multicast_Sender sender;
+
+    memset(&sender, 0, sizeof(sender));
+    sender.fd = -1;
+    sender.options = options;
+
+    if (options == NULL || filePath == NULL || !IsValidHash(hash) || options->symbolSize == 0
+        || options->symbolSize > ADUC_MULTICAST_MAX_SYMBOL_SIZE || options->sourceSymbols == 0
+        || options->sourceSymbols >= ADUC_FEC_MAX_SYMBOLS || options->lossPercent > 100)
+    {
+        Log_Error("Invalid multicast sender options");
+        return false;
+    }
+
+    fileFd = open(filePath, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fileFd == -1 || fstat(fileFd, &st) != 0)
+    {
+        Log_Error("Cannot open '%s', errno: %d", filePath, errno);
+        goto done;
+    }
+
+    const uint64_t size = (uint64_t)st.st_size;
+    const size_t symbolSize = options->symbolSize;
+    const uint32_t sessionId = (uint32_t)GetMonotonicMs() ^ ((uint32_t)getpid() << 16);
+
+    sender.fd = CreateSenderSocket(options);
+    if (sender.fd == -1 || !MakeSockAddr(options->announceGroup, options->announcePort, &sender.announceAddr)
+        || !MakeSockAddr(options->dataGroup, options->dataPort, &sender.dataAddr))
+    {
+        goto done;
+    }
+
+    int announcementLength = snprintf(
+        sender.announcement,
+        sizeof(sender.announcement),
+        ANNOUNCE_MAGIC " ANNOUNCE %s %08x %s %u %" PRIu64 " %u %u\n",
+        hash,
+        sessionId,
+        options->dataGroup,
+        options->dataPort,
+        size,
+        options->symbolSize,
+        options->sourceSymbols);
+    if (announcementLength <= 0 || (size_t)announcementLength >= sizeof(sender.announcement))
+    {
+        goto done;
+    }
+
+    sender.announcementLength = (size_t)announcementLength;
+    sender.lossSeed = sessionId;
+
+    blockBuffer = malloc((size_t)ADUC_FEC_MAX_SYMBOLS * symbolSize);
+    packet = malloc(PACKET_HEADER_SIZE + symbolSize);
+    if (blockBuffer == NULL || packet == NULL)
+    {
+        goto done;
+    }
+
+    Log_Info(
+        "Announcing '%s' on %s:%u, data on %s:%u",
+        filePath,
+        options->announceGroup,
+        options->announcePort,
+        options->dataGroup,
+        options->dataPort);
+
+    // Give receivers time to join the data group.
+    for (const int64_t leadEndMs = GetMonotonicMs() + options->leadTimeMs; GetMonotonicMs() < leadEndMs;)
+    {
+        AnnounceIfDue(&sender);
+        SleepMs(leadEndMs - GetMonotonicMs() < ANNOUNCE_INTERVAL_MS ? leadEndMs - GetMonotonicMs()
+                                                                     : ANNOUNCE_INTERVAL_MS);
+    }
+
+    sender.startMs = GetMonotonicMs();
+
+    ADUC_Multicast_PacketHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = PACKET_TYPE_DATA;
+    header.symbolSize = (uint16_t)symbolSize;
+    header.sessionId = sessionId;
+    header.size = size;
+
+    const uint64_t blockCount = GetBlockCount(size, options->symbolSize, options->sourceSymbols);
+    for (uint64_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        const unsigned int k = GetBlockSourceSymbols(size, options->symbolSize, options->sourceSymbols, blockIndex);
+        const unsigned int r = GetBlockRepairSymbols(k, options->repairSymbols);
+        const uint64_t blockOffset = blockIndex * options->sourceSymbols * symbolSize;
+        const uint8_t* source[ADUC_FEC_MAX_SYMBOLS];
+        uint8_t* repair[ADUC_FEC_MAX_SYMBOLS];
+
+        if (!ReadAt(fileFd, blockBuffer, k * symbolSize, blockOffset))
+        {
+            Log_Error("Failed to read '%s', errno: %d", filePath, errno);
+            goto done;
+        }
+
+        for (unsigned int i = 0; i < k + r; ++i)
+        {
+            if (i < k)
+            {
+                source[i] = blockBuffer + i * symbolSize;
+            }
+            else
+            {
+                repair[i - k] = blockBuffer + i * symbolSize;
+            }
+        }
+
+        if (!ADUC_Fec_Encode(source, k, repair, r, symbolSize))
+        {
+            goto done;
+        }
+
+        header.blockIndex = (uint32_t)blockIndex;
+        header.blockSourceSymbols = (uint16_t)k;
+        header.blockRepairSymbols = (uint16_t)r;
+
+        for (unsigned int i = 0; i < k + r; ++i)
+        {
+            header.symbolIndex = (uint16_t)i;
+            WriteHeader(packet, &header);
+            memcpy(packet + PACKET_HEADER_SIZE, blockBuffer + i * symbolSize, symbolSize);
+
+            if (!SendPacket(&sender, packet, PACKET_HEADER_SIZE + symbolSize, true /* mayDrop */))
+            {
+                goto done;
+            }
+        }
+    }
+
+    header.type = PACKET_TYPE_END;
+    WriteHeader(packet, &header);
+    for (unsigned int i = 0; i < END_PACKET_COUNT; ++i)
+    {
+        if (!SendPacket(&sender, packet, PACKET_HEADER_SIZE, false /* mayDrop */))
+        {
+            goto done;
+        }
+    }
+
+    Log_Info("Sent '%s', %" PRIu64 " bytes in %" PRIu64 " blocks", filePath, size, blockCount);
+    succeeded = true;
+
+done:
+    free(packet);
+    free(blockBuffer);
+
+    if (sender.fd != -1)
+    {
+        close(sender.fd);
+    }
+
+    if (fileFd != -1)
+    {
+        close(fileFd);
+    }
+
+    return succeeded;
+}
+
+//
+// Receiver
+//
+
+/**
+ * @brief Waits for an announcement of @p hash.
+ *
+ * @return bool true if a valid announcement arrived in time.
+ */
+static bool WaitForAnnouncement(
+    const ADUC_Multicast_ReceiverConfig* config, const char* hash, uint64_t size, ADUC_Multicast_Session* session)
+{
+    bool found = false;
+    char announcement[MAX_ANNOUNCEMENT];
+
+    int fd = CreateGroupSocket(config->announceGroup, config->announcePort, config->interfaceAddress);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    const int64_t deadline = GetMonotonicMs() + config->announceTimeoutMs;
+    for (int64_t now = GetMonotonicMs(); !found && now < deadline; now = GetMonotonicMs())
+    {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, (int)(deadline - now)) != 1)
+        {
+            continue;
+        }
+
+        ssize_t received = recv(fd, announcement, sizeof(announcement) - 1, 0);
+        if (received <= 0)
+        {
+            continue;
+        }
+
+        announcement[received] = '\0';
+
+        char announcedHash[ADUC_MULTICAST_MAX_HASH];
+        unsigned int dataPort = 0;
+        if (sscanf(
+                announcement,
+                ANNOUNCE_MAGIC " ANNOUNCE %127s %8x %15s %u %" SCNu64 " %u %u",
+                announcedHash,
+                &session->sessionId,
+                session->dataGroup,
+                &dataPort,
+                &session->size,
+                &session->symbolSize,
+                &session->sourceSymbols)
+            != 7)
+        {
+            continue;
+        }
+
+        struct in_addr group;
+        found = strcmp(announcedHash, hash) == 0 && (size == 0 || session->size == size) && dataPort > 0
+            && dataPort <= UINT16_MAX && session->symbolSize > 0
+            && session->symbolSize <= ADUC_MULTICAST_MAX_SYMBOL_SIZE && session->sourceSymbols > 0
+            && session->sourceSymbols < ADUC_FEC_MAX_SYMBOLS
+            && inet_pton(AF_INET, session->dataGroup, &group) == 1 && IN_MULTICAST(ntohl(group.s_addr))
+            && GetBlockCount(session->size, session->symbolSize, session->sourceSymbols) <= UINT32_MAX;
+        session->dataPort = (unsigned short)dataPort;
+    }
+
+    close(fd);
+    return found;
+}
+
+/**
+ * @brief Reconstructs the lost source symbols of a block that received enough symbols, and writes them.
+ */
+static bool RepairBlock(
+    int fileFd,
+    const ADUC_Multicast_Session* session,
+    ADUC_Multicast_Block* block,
+    uint64_t blockIndex,
+    ADUC_Multicast_Stats* stats)
+{
+    bool succeeded = false;
+    const size_t symbolSize = session->symbolSize;
+    const unsigned int k =
+        GetBlockSourceSymbols(session->size, session->symbolSize, session->sourceSymbols, blockIndex);
+    const unsigned int r = GetBlockRepairSymbols(k, ADUC_FEC_MAX_SYMBOLS);
+    const uint64_t blockOffset = blockIndex * session->sourceSymbols * symbolSize;
+    uint8_t* symbols[ADUC_FEC_MAX_SYMBOLS];
+
+    uint8_t* source = malloc(k * symbolSize);
+    if (source == NULL || !ReadAt(fileFd, source, k * symbolSize, blockOffset))
+    {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < k + r; ++i)
+    {
+        symbols[i] = i < k ? source + i * symbolSize : block->repair + (i - k) * symbolSize;
+    }
+
+    if (!ADUC_Fec_Decode(symbols, block->received, k, r, symbolSize))
+    {
+        goto done;
+    }
+
+    for (unsigned int i = 0; i < k; ++i)
+    {
+        const uint64_t offset = blockOffset + (uint64_t)i * symbolSize;
+        const size_t length = session->size - offset < symbolSize ? (size_t)(session->size - offset) : symbolSize;
+        if (block->received[i])
+        {
+            continue;
+        }
+
+        if (!WriteAt(fileFd, symbols[i], length, offset))
+        {
+            goto done;
+        }
+
+        stats->bytesRepaired += length;
+    }
+
+    succeeded = true;
+
+done:
+    free(source);
+    return succeeded;
+}
+
+/**
+ * @brief Stores a received symbol, and completes the block once it has enough symbols.
+ */
+static bool HandleSymbol(
+    int fileFd,
+    const ADUC_Multicast_Session* session,
+    ADUC_Multicast_Block* blocks,
+    const ADUC_Multicast_PacketHeader* header,
+    const uint8_t* symbol,
+    ADUC_Multicast_Stats* stats)
+{
+    const size_t symbolSize = session->symbolSize;
+    const unsigned int k =
+        GetBlockSourceSymbols(session->size, session->symbolSize, session->sourceSymbols, header->blockIndex);
+
+    // The receiver keeps the repair symbols of all R a block can have, so R is only bounded here.
+    if (header->blockSourceSymbols != k || k + header->blockRepairSymbols > ADUC_FEC_MAX_SYMBOLS
+        || header->symbolIndex >= k + header->blockRepairSymbols)
+    {
+        return true;
+    }
+
+    ADUC_Multicast_Block* block = &blocks[header->blockIndex];
+    if (block->complete)
+    {
+        return true;
+    }
+
+    if (block->received == NULL)
+    {
+        block->received = calloc(ADUC_FEC_MAX_SYMBOLS, sizeof(bool));
+        block->repair = malloc((ADUC_FEC_MAX_SYMBOLS - k) * symbolSize);
+        if (block->received == NULL || block->repair == NULL)
+        {
+            return false;
+        }
+    }
+
+    if (block->received[header->symbolIndex])
+    {
+        return true;
+    }
+
+    if (header->symbolIndex < k)
+    {
+        const uint64_t offset = (uint64_t)header->blockIndex * session->sourceSymbols * symbolSize
+            + (uint64_t)header->symbolIndex * symbolSize;
+        const size_t length = session->size - offset < symbolSize ? (size_t)(session->size - offset) : symbolSize;
+        if (!WriteAt(fileFd, symbol, length, offset))
+        {
+            return false;
+        }
+
+        stats->bytesReceived += length;
+    }
+    else
+    {
+        memcpy(block->repair + (header->symbolIndex - k) * symbolSize, symbol, symbolSize);
+    }
+
+    block->received[header->symbolIndex] = true;
+    ++block->receivedCount;
+
+    if (block->receivedCount < k)
+    {
+        return true;
+    }
+
+    if (!RepairBlock(fileFd, session, block, header->blockIndex, stats))
+    {
+        return false;
+    }
+
+    block->complete = true;
+    free(block->received);
+    free(block->repair);
+    block->received = NULL;
+    block->repair = NULL;
+    return true;
+}
+
+/**
+ * @brief Fetches a range with the unicast fallback.
+ */
+static bool FetchRange(
+    int fileFd,
+    uint64_t offset,
+    uint64_t length,
+    ADUC_Multicast_FetchRangeFunc fetchRange,
+    void* context,
+    ADUC_Multicast_Stats* stats)
+{
+    if (fetchRange == NULL || !fetchRange(context, fileFd, offset, length))
+    {
+        Log_Error("Failed to fetch %" PRIu64 " bytes at %" PRIu64, length, offset);
+        return false;
+    }
+
+    stats->bytesFetched += length;
+    return true;
+}
+
+/**
+ * @brief Fetches the source symbols that were neither received nor reconstructed, merging adjacent ones.
+ */
+static bool FetchMissingRanges(
+    int fileFd,
+    const ADUC_Multicast_Session* session,
+    const ADUC_Multicast_Block* blocks,
+    uint64_t blockCount,
+    ADUC_Multicast_FetchRangeFunc fetchRange,
+    void* context,
+    ADUC_Multicast_Stats* stats)
+{
+    const uint64_t symbolSize = session->symbolSize;
+    uint64_t rangeStart = 0;
+    uint64_t rangeEnd = 0;
+
+    for (uint64_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+    {
+        const ADUC_Multicast_Block* block = &blocks[blockIndex];
+        const unsigned int k =
+            GetBlockSourceSymbols(session->size, session->symbolSize, session->sourceSymbols, blockIndex);
+
+        for (unsigned int i = 0; i < k && !block->complete; ++i)
+        {
+            const uint64_t offset = (blockIndex * session->sourceSymbols + i) * symbolSize;
+            if (block->received != NULL && block->received[i])
+            {
+                continue;
+            }
+
+            if (offset != rangeEnd && rangeEnd > rangeStart)
+            {
+                if (!FetchRange(fileFd, rangeStart, rangeEnd - rangeStart, fetchRange, context, stats))
+                {
+                    return false;
+                }
+
+                rangeEnd = rangeStart;
+            }
+
+            if (rangeEnd == rangeStart)
+            {
+                rangeStart = offset;
+            }
+
+            rangeEnd = offset + symbolSize < session->size ? offset + symbolSize : session->size;
+        }
+    }
+
+    return rangeEnd == rangeStart || FetchRange(fileFd, rangeStart, rangeEnd - rangeStart, fetchRange, context, stats);
+}
+
+bool ADUC_Multicast_Receive(
+    const ADUC_Multicast_ReceiverConfig* config,
+    const char* hash,
+    uint64_t size,
+    const char* filePath,
+    ADUC_Multicast_FetchRangeFunc fetchRange,
+    void* context,
+    ADUC_Multicast_Stats* stats)
+{
+    bool succeeded = false;
+    int dataFd = -1;
+    int fileFd = -1;
+    uint64_t blockCount = 0;
+    ADUC_Multicast_Block* blocks = NULL;
+    uint8_t* packet = NULL;
+    ADUC_Multicast_Session session;
+    ADUC_Multicast_Stats localStats;
+
+    if (stats == NULL)
+    {
+        stats = &localStats;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    memset(&session, 0, sizeof(session));
+
+    if (config == NULL || !config->enabled || !IsValidHash(hash) || filePath == NULL)
+    {
+        return false;
+    }
+
+    if (!WaitForAnnouncement(config, hash, size, &session))
+    {
+        Log_Info("No multicast transmission of %s announced", hash);
+        return false;
+    }
+
+    Log_Info("Receiving %s from %s:%u", hash, session.dataGroup, session.dataPort);
+
+    dataFd = CreateGroupSocket(session.dataGroup, session.dataPort, config->interfaceAddress);
+    if (dataFd == -1)
+    {
+        goto done;
+    }
+
+    fileFd = open(filePath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    if (fileFd == -1 || ftruncate(fileFd, (off_t)session.size) != 0)
+    {
+        Log_Error("Cannot create '%s', errno: %d", filePath, errno);
+        goto done;
+    }
+
+    blockCount = GetBlockCount(session.size, session.symbolSize, session.sourceSymbols);
+    blocks = calloc(blockCount > 0 ? blockCount : 1, sizeof(*blocks));
+    packet = malloc(PACKET_HEADER_SIZE + session.symbolSize);
+    if (blocks == NULL || packet == NULL)
+    {
+        goto done;
+    }
+
+    for (uint64_t completeCount = 0; completeCount < blockCount;)
+    {
+        struct pollfd pfd = { .fd = dataFd, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, (int)config->idleTimeoutMs) != 1)
+        {
+            Log_Info("Multicast transmission of %s idle", hash);
+            break;
+        }
+
+        ssize_t received = recv(dataFd, packet, PACKET_HEADER_SIZE + session.symbolSize, 0);
+        ADUC_Multicast_PacketHeader header;
+        if (received <= 0 || !ReadHeader(packet, (size_t)received, &header) || header.sessionId != session.sessionId
+            || header.size != session.size || header.symbolSize != session.symbolSize)
+        {
+            continue;
+        }
+
+        if (header.type == PACKET_TYPE_END)
+        {
+            break;
+        }
+
+        if (header.type != PACKET_TYPE_DATA || (size_t)received != PACKET_HEADER_SIZE + session.symbolSize
+            || header.blockIndex >= blockCount || blocks[header.blockIndex].complete)
+        {
+            continue;
+        }
+
+        if (!HandleSymbol(fileFd, &session, blocks, &header, packet + PACKET_HEADER_SIZE, stats))
+        {
+            Log_Error("Failed to store block %u of '%s', errno: %d", header.blockIndex, filePath, errno);
+            goto done;
+        }
+
+        if (blocks[header.blockIndex].complete)
+        {
+            ++completeCount;
+        }
+    }
+
+    close(dataFd);
+    dataFd = -1;
+
+    if (!FetchMissingRanges(fileFd, &session, blocks, blockCount, fetchRange, context, stats) || fsync(fileFd) != 0)
+    {
+        goto done;
+    }
+
+    Log_Info(
+        "Received '%s', %" PRIu64 " bytes received, %" PRIu64 " repaired, %" PRIu64 " fetched",
+        filePath,
+        stats->bytesReceived,
+        stats->bytesRepaired,
+        stats->bytesFetched);
+
+    succeeded = true;
+
+done:
+    for (uint64_t i = 0; blocks != NULL && i < blockCount; ++i)
+    {
+        free(blocks[i].received);
+        free(blocks[i].repair);
+    }
+
+    free(blocks);
+    free(packet);
+
+    if (dataFd != -1)
+    {
+        close(dataFd);
+    }
+
+    if (fileFd != -1 && close(fileFd) != 0)
+    {
+        succeeded = false;
+    }
+
+    return succeeded;
+}
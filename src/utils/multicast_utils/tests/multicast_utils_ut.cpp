@@ -0,0 +1,350 @@
+/**
+ * @file multicast_utils_ut.cpp
+ * @brief Unit Tests for multicast_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/multicast_fec.h"
+#include "aduc/multicast_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <parson.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h> // access
+#include <vector>
+
+#define TEST_DIR "/tmp/adutest/multicast_utils_ut"
+
+static const char* TEST_HASH = "Jm3KVuYbV0Ev5RSNUgz2G9Fg2g6FMrcT0MjeHJa7FhE=";
+
+static bool ParseConfig(const char* json, ADUC_Multicast_ReceiverConfig* config)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool parsed = ADUC_Multicast_ParseReceiverConfig(config, json_value_get_object(value));
+    json_value_free(value);
+    return parsed;
+}
+
+static std::string ReadFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+class TestFolder
+{
+public:
+    TestFolder() : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+
+        // 200 KB of content that differs per symbol, with a size that is not a multiple of the symbol size.
+        for (size_t i = 0; _payload.size() < 200 * 1000; ++i)
+        {
+            _payload += std::to_string(i) + ",";
+        }
+
+        _payload.resize(200 * 1000 + 17);
+        std::ofstream{ Payload(), std::ios::binary } << _payload;
+    }
+
+    TestFolder(const TestFolder&) = delete;
+    TestFolder& operator=(const TestFolder&) = delete;
+    TestFolder(TestFolder&&) = delete;
+    TestFolder& operator=(TestFolder&&) = delete;
+
+    std::string Payload() const
+    {
+        return _dir.GetDir() + "/payload.bin";
+    }
+
+    std::string Target() const
+    {
+        return _dir.GetDir() + "/target.bin";
+    }
+
+    const std::string& Content() const
+    {
+        return _payload;
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+    std::string _payload;
+};
+
+/**
+ * @brief Unicast fallback that serves ranges of the test content.
+ */
+struct FakeOrigin
+{
+    const std::string* content;
+    size_t calls;
+};
+
+static bool FetchFromFakeOrigin(void* context, int fd, uint64_t offset, uint64_t length)
+{
+    auto* origin = static_cast<FakeOrigin*>(context);
+    ++origin->calls;
+    return pwrite(fd, origin->content->data() + offset, length, static_cast<off_t>(offset))
+        == static_cast<ssize_t>(length);
+}
+
+/**
+ * @brief Receiver and sender on loopback, on ports of their own.
+ */
+static void InitLoopback(
+    unsigned short basePort, ADUC_Multicast_ReceiverConfig* config, ADUC_Multicast_SenderOptions* options)
+{
+    std::string json = R"({"announceGroup":"239.255.42.99","interfaceAddress":"127.0.0.1",)"
+                       R"("announceTimeoutMs":3000,"idleTimeoutMs":1000,"announcePort":)"
+        + std::to_string(basePort) + "}";
+    REQUIRE(ParseConfig(json.c_str(), config));
+
+    ADUC_Multicast_InitSenderOptions(options);
+    options->announcePort = basePort;
+    options->dataPort = static_cast<unsigned short>(basePort + 1);
+    snprintf(options->interfaceAddress, sizeof(options->interfaceAddress), "127.0.0.1");
+    options->symbolSize = 1000;
+    options->sourceSymbols = 32;
+    options->repairSymbols = 8;
+    options->rateKBps = 0;
+    options->leadTimeMs = 300;
+}
+
+TEST_CASE("ADUC_Fec_Encode and ADUC_Fec_Decode")
+{
+    const size_t symbolSize = 64;
+    const size_t k = 20;
+    const size_t r = 6;
+    std::mt19937 random{ 42 };
+    std::vector<std::vector<uint8_t>> symbols(k + r, std::vector<uint8_t>(symbolSize));
+    std::vector<uint8_t*> pointers;
+
+    for (size_t i = 0; i < k; ++i)
+    {
+        for (auto& byte : symbols[i])
+        {
+            byte = static_cast<uint8_t>(random());
+        }
+    }
+
+    for (auto& symbol : symbols)
+    {
+        pointers.push_back(symbol.data());
+    }
+
+    REQUIRE(ADUC_Fec_Encode(pointers.data(), k, pointers.data() + k, r, symbolSize));
+    const auto original = symbols;
+
+    SECTION("Any K symbols reconstruct the block")
+    {
+        for (int round = 0; round < 50; ++round)
+        {
+            std::vector<size_t> order(k + r);
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                order[i] = i;
+            }
+
+            std::shuffle(order.begin(), order.end(), random);
+
+            bool received[k + r] = {};
+            for (size_t i = 0; i < k; ++i)
+            {
+                received[order[i]] = true;
+            }
+
+            for (size_t i = 0; i < k; ++i)
+            {
+                if (!received[i])
+                {
+                    std::fill(symbols[i].begin(), symbols[i].end(), 0xa5);
+                }
+            }
+
+            REQUIRE(ADUC_Fec_Decode(pointers.data(), received, k, r, symbolSize));
+            CHECK(symbols == original);
+        }
+    }
+
+    SECTION("Fewer than K symbols fail")
+    {
+        bool received[k + r] = {};
+        for (size_t i = 1; i < k + r && i < k + 1; ++i)
+        {
+            received[i] = i != k / 2;
+        }
+
+        CHECK_FALSE(ADUC_Fec_Decode(pointers.data(), received, k, r, symbolSize));
+    }
+
+    SECTION("Invalid block shapes fail")
+    {
+        CHECK_FALSE(ADUC_Fec_Encode(pointers.data(), 0, pointers.data(), r, symbolSize));
+        CHECK_FALSE(ADUC_Fec_Encode(pointers.data(), 200, pointers.data(), 57, symbolSize));
+    }
+}
+
+TEST_CASE("ADUC_Multicast_ParseReceiverConfig")
+{
+    ADUC_Multicast_ReceiverConfig config;
+
+    SECTION("Not configured")
+    {
+        REQUIRE(ADUC_Multicast_ParseReceiverConfig(&config, nullptr));
+        CHECK_FALSE(config.enabled);
+    }
+
+    SECTION("Defaults")
+    {
+        REQUIRE(ParseConfig("{}", &config));
+        CHECK(config.enabled);
+        CHECK(std::string{ config.announceGroup } == "239.255.42.99");
+        CHECK(config.announcePort == 50992);
+        CHECK(std::string{ config.interfaceAddress } == "0.0.0.0");
+        CHECK(config.announceTimeoutMs == 2000);
+        CHECK(config.idleTimeoutMs == 3000);
+    }
+
+    SECTION("Values")
+    {
+        REQUIRE(ParseConfig(
+            R"({"announceGroup":"239.1.2.3","announcePort":4000,"interfaceAddress":"192.168.1.2",)"
+            R"("announceTimeoutMs":0,"idleTimeoutMs":500})",
+            &config));
+        CHECK(config.enabled);
+        CHECK(std::string{ config.announceGroup } == "239.1.2.3");
+        CHECK(config.announcePort == 4000);
+        CHECK(std::string{ config.interfaceAddress } == "192.168.1.2");
+        CHECK(config.announceTimeoutMs == 0);
+        CHECK(config.idleTimeoutMs == 500);
+    }
+
+    SECTION("Invalid values")
+    {
+        CHECK_FALSE(ParseConfig(R"({"announceGroup":"192.168.1.2"})", &config));
+        CHECK_FALSE(config.enabled);
+        CHECK_FALSE(ParseConfig(R"({"announceGroup":"239.255.42"})", &config));
+        CHECK_FALSE(ParseConfig(R"({"interfaceAddress":"eth0"})", &config));
+        CHECK_FALSE(ParseConfig(R"({"announcePort":0})", &config));
+        CHECK_FALSE(ParseConfig(R"({"announcePort":70000})", &config));
+        CHECK_FALSE(ParseConfig(R"({"idleTimeoutMs":0})", &config));
+        CHECK_FALSE(ParseConfig(R"({"announceTimeoutMs":"1000"})", &config));
+    }
+}
+
+TEST_CASE("ADUC_Multicast_Receive")
+{
+    TestFolder folder;
+    ADUC_Multicast_ReceiverConfig config;
+    ADUC_Multicast_SenderOptions options;
+    ADUC_Multicast_Stats stats;
+    FakeOrigin origin{ &folder.Content(), 0 };
+
+    SECTION("Lost packets are repaired")
+    {
+        InitLoopback(47310, &config, &options);
+        options.lossPercent = 10;
+
+        bool sent = false;
+        std::thread sender{ [&] { sent = ADUC_Multicast_Send(&options, folder.Payload().c_str(), TEST_HASH); } };
+        const bool received = ADUC_Multicast_Receive(
+            &config,
+            TEST_HASH,
+            folder.Content().size(),
+            folder.Target().c_str(),
+            FetchFromFakeOrigin,
+            &origin,
+            &stats);
+        sender.join();
+
+        REQUIRE(sent);
+        REQUIRE(received);
+        CHECK(ReadFile(folder.Target()) == folder.Content());
+        CHECK(stats.bytesRepaired > 0);
+        CHECK(stats.bytesReceived + stats.bytesRepaired + stats.bytesFetched == folder.Content().size());
+    }
+
+    SECTION("Blocks that lost too many packets are fetched")
+    {
+        InitLoopback(47320, &config, &options);
+        options.lossPercent = 40;
+
+        std::thread sender{ [&] { ADUC_Multicast_Send(&options, folder.Payload().c_str(), TEST_HASH); } };
+        const bool received = ADUC_Multicast_Receive(
+            &config,
+            TEST_HASH,
+            folder.Content().size(),
+            folder.Target().c_str(),
+            FetchFromFakeOrigin,
+            &origin,
+            &stats);
+        sender.join();
+
+        REQUIRE(received);
+        CHECK(ReadFile(folder.Target()) == folder.Content());
+        CHECK(stats.bytesFetched > 0);
+        CHECK(origin.calls > 0);
+        CHECK(stats.bytesReceived + stats.bytesRepaired + stats.bytesFetched == folder.Content().size());
+    }
+
+    SECTION("Without a fallback, missing blocks fail")
+    {
+        InitLoopback(47330, &config, &options);
+        options.lossPercent = 100;
+
+        std::thread sender{ [&] { ADUC_Multicast_Send(&options, folder.Payload().c_str(), TEST_HASH); } };
+        const bool received = ADUC_Multicast_Receive(
+            &config, TEST_HASH, folder.Content().size(), folder.Target().c_str(), nullptr, nullptr, &stats);
+        sender.join();
+
+        CHECK_FALSE(received);
+    }
+
+    SECTION("Transmissions of other payloads are ignored")
+    {
+        InitLoopback(47340, &config, &options);
+        config.announceTimeoutMs = 600;
+
+        std::thread sender{ [&] { ADUC_Multicast_Send(&options, folder.Payload().c_str(), "other"); } };
+        const bool received = ADUC_Multicast_Receive(
+            &config,
+            TEST_HASH,
+            folder.Content().size(),
+            folder.Target().c_str(),
+            FetchFromFakeOrigin,
+            &origin,
+            &stats);
+        sender.join();
+
+        CHECK_FALSE(received);
+        CHECK(access(folder.Target().c_str(), F_OK) != 0);
+    }
+
+    SECTION("No transmission announced")
+    {
+        InitLoopback(47350, &config, &options);
+        config.announceTimeoutMs = 100;
+
+        CHECK_FALSE(ADUC_Multicast_Receive(
+            &config,
+            TEST_HASH,
+            folder.Content().size(),
+            folder.Target().c_str(),
+            FetchFromFakeOrigin,
+            &origin,
+            &stats));
+        CHECK(access(folder.Target().c_str(), F_OK) != 0);
+        CHECK(origin.calls == 0);
+    }
+}
@@ -0,0 +1,208 @@
+/**
+ * @file peer_sharing_utils.h
+ * @brief Sharing of verified update payloads between agents on the local network.
+ *
+ * Peer sharing is configured by the optional "peerSharing" object of du-config.json:
+ *
+ *   "peerSharing": {
+ *       "enabled": true,
+ *       "discoveryPort": 50990,
+ *       "servePort": 50991,
+ *       "discoveryAddress": "255.255.255.255",
+ *       "peers": [ "192.168.1.20:50990" ],
+ *       "discoveryTimeoutMs": 500,
+ *       "rangeKB": 1024,
+ *       "shareTimeoutSeconds": 3600,
+ *       "maxUploads": 4
+ *   }
+ *
+ * An agent that needs a payload sends a query with the payload hash to the discovery address and to each
+ * configured peer. Agents that hold a verified copy of the payload answer with their serve port, and the
+ * payload is then fetched from them in ranges over TCP. Addresses are IPv4 literals. A port of 0 picks a
+ * free port, and an empty discovery address disables the broadcast, so only the configured peers are asked.
+ *
+ * Peers are not trusted. The caller must validate the assembled file against the manifest hash before
+ * using or sharing it, and only shares files it validated itself. A shared file is served read-only until
+ * it is changed or removed, e.g. when the workflow sandbox is cleaned up, or until the share times out.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_PEER_SHARING_UTILS_H
+#define ADUC_PEER_SHARING_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <aduc/socket_tuning_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum number of configured peers.
+ */
+#define ADUC_PEER_SHARING_MAX_STATIC_PEERS 16
+
+/**
+ * @brief Maximum number of peers a payload is fetched from.
+ */
+#define ADUC_PEER_SHARING_MAX_PEERS 16
+
+/**
+ * @brief Maximum length of an IPv4 address literal, including the terminator.
+ */
+#define ADUC_PEER_SHARING_MAX_ADDRESS 16
+
+/**
+ * @brief Maximum length of a payload hash, including the terminator.
+ */
+#define ADUC_PEER_SHARING_MAX_HASH 128
+
+/**
+ * @brief An IPv4 address and port.
+ */
+typedef struct tagADUC_PeerSharing_Endpoint
+{
+    char address[ADUC_PEER_SHARING_MAX_ADDRESS]; /**< IPv4 address literal. */
+    unsigned short port; /**< Port in host byte order. */
+} ADUC_PeerSharing_Endpoint;
+
+/**
+ * @brief The peer sharing configuration.
+ */
+typedef struct tagADUC_PeerSharing_Config
+{
+    bool enabled; /**< True if "peerSharing" is configured and enabled. */
+    unsigned short discoveryPort; /**< UDP port for queries. */
+    unsigned short servePort; /**< TCP port for range requests. */
+    char discoveryAddress[ADUC_PEER_SHARING_MAX_ADDRESS]; /**< Broadcast address for queries, or empty. */
+    ADUC_PeerSharing_Endpoint staticPeers[ADUC_PEER_SHARING_MAX_STATIC_PEERS]; /**< Peers that are always asked. */
+    size_t staticPeerCount; /**< Number of staticPeers. */
+    unsigned int discoveryTimeoutMs; /**< Time to wait for answers to a query. */
+    unsigned int rangeKB; /**< Size of the ranges fetched from peers, in KiB. */
+    unsigned int shareTimeoutSeconds; /**< Time a file is shared after it was validated. */
+    unsigned int maxUploads; /**< Number of peers served at the same time. */
+    ADUC_SocketTuning_Profile socketTuning; /**< Tuning of range connections. Not parsed from "peerSharing". */
+} ADUC_PeerSharing_Config;
+
+/**
+ * @brief A peer that holds a payload.
+ */
+typedef struct tagADUC_PeerSharing_Peer
+{
+    ADUC_PeerSharing_Endpoint endpoint; /**< Address and serve port of the peer. */
+    uint64_t size; /**< Size of the payload announced by the peer. */
+} ADUC_PeerSharing_Peer;
+
+/**
+ * @brief Where the bytes of a download came from.
+ */
+typedef struct tagADUC_PeerSharing_Stats
+{
+    uint64_t bytesFromPeers; /**< Bytes fetched from peers. */
+    uint64_t bytesFromOrigin; /**< Bytes fetched with the origin fallback. */
+} ADUC_PeerSharing_Stats;
+
+/**
+ * @brief Fetches a range of the payload from its origin.
+ *
+ * @param context The context passed to ADUC_PeerSharing_Download.
+ * @param fd The target file, to be written at @p offset with pwrite.
+ * @param offset The offset of the range.
+ * @param length The length of the range.
+ * @return bool true if the whole range was written.
+ */
+typedef bool (*ADUC_PeerSharing_OriginRangeFunc)(void* context, int fd, uint64_t offset, uint64_t length);
+
+/**
+ * @brief Opaque peer sharing instance.
+ */
+typedef struct tagADUC_PeerSharing ADUC_PeerSharing;
+
+/**
+ * @brief Parses the "peerSharing" configuration object.
+ *
+ * @param[out] config The parsed configuration. Disabled if @p peerSharingObj is NULL or invalid.
+ * @param peerSharingObj The "peerSharing" object, or NULL if not configured.
+ * @return bool true if not configured or valid.
+ */
+bool ADUC_PeerSharing_ParseConfig(ADUC_PeerSharing_Config* config, const JSON_Object* peerSharingObj);
+
+/**
+ * @brief Binds the discovery and serve ports and starts answering peers.
+ *
+ * @param config An enabled configuration.
+ * @return ADUC_PeerSharing* The instance, or NULL on failure. Free with ADUC_PeerSharing_Destroy.
+ */
+ADUC_PeerSharing* ADUC_PeerSharing_Create(const ADUC_PeerSharing_Config* config);
+
+/**
+ * @brief Stops answering peers and frees the instance.
+ *
+ * @param sharing The instance. May be NULL.
+ */
+void ADUC_PeerSharing_Destroy(ADUC_PeerSharing* sharing);
+
+/**
+ * @brief Gets the bound discovery port, e.g. when 0 was configured.
+ */
+unsigned short ADUC_PeerSharing_GetDiscoveryPort(const ADUC_PeerSharing* sharing);
+
+/**
+ * @brief Gets the bound serve port, e.g. when 0 was configured.
+ */
+unsigned short ADUC_PeerSharing_GetServePort(const ADUC_PeerSharing* sharing);
+
+/**
+ * @brief Shares a file that was validated against @p hash.
+ *
+ * @param sharing The instance.
+ * @param hash The hash of the file from the update manifest.
+ * @param filePath The file path.
+ * @return bool true if the file is shared.
+ */
+bool ADUC_PeerSharing_ShareFile(ADUC_PeerSharing* sharing, const char* hash, const char* filePath);
+
+/**
+ * @brief Asks the local network for peers that hold a payload.
+ *
+ * @param sharing The instance.
+ * @param hash The hash of the payload from the update manifest.
+ * @param size The payload size, or 0 if unknown. Peers announcing another size are ignored.
+ * @param[out] peers The peers that answered in time.
+ * @param maxPeers The capacity of @p peers.
+ * @return size_t The number of peers found.
+ */
+size_t ADUC_PeerSharing_FindPeers(
+    ADUC_PeerSharing* sharing, const char* hash, uint64_t size, ADUC_PeerSharing_Peer* peers, size_t maxPeers);
+
+/**
+ * @brief Downloads a payload from peers. Ranges that no peer delivers are fetched with @p fetchOrigin.
+ * @details Ranges are spread over the peers round-robin. A peer that fails a range is not asked again.
+ * The caller must validate the file against the manifest hash before using it.
+ *
+ * @param sharing The instance.
+ * @param hash The hash of the payload from the update manifest.
+ * @param peers The peers from ADUC_PeerSharing_FindPeers. All must announce the same size.
+ * @param peerCount The number of peers.
+ * @param filePath The target file path.
+ * @param fetchOrigin The origin fallback, or NULL to fail if the peers cannot deliver the payload.
+ * @param context The context for @p fetchOrigin.
+ * @param[out] stats Where the bytes came from. May be NULL.
+ * @return bool true if the whole payload was written.
+ */
+bool ADUC_PeerSharing_Download(
+    ADUC_PeerSharing* sharing,
+    const char* hash,
+    const ADUC_PeerSharing_Peer* peers,
+    size_t peerCount,
+    const char* filePath,
+    ADUC_PeerSharing_OriginRangeFunc fetchOrigin,
+    void* context,
+    ADUC_PeerSharing_Stats* stats);
+
+EXTERN_C_END
+
+#endif // ADUC_PEER_SHARING_UTILS_H
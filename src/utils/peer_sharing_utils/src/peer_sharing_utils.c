@@ -0,0 +1,1260 @@
+/**
+ * @file peer_sharing_utils.c
+ * @brief Implements sharing of verified update payloads between agents on the local network.
+ *
+ * The protocol is line based. Discovery uses UDP datagrams:
+ *
+ *   ADUPEER1 QUERY <instanceId> <hash>
+ *   ADUPEER1 HAVE <hash> <servePort> <size>
+ *
+ * Ranges are requested over a TCP connection that may carry several requests:
+ *
+ *   ADUPEER1 GET <hash> <offset> <length>
+ *   ADUPEER1 OK <length>, followed by <length> bytes, or ADUPEER1 ERR
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/peer_sharing_utils.h"
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN, IsNullOrEmpty
+
+#include <arpa/inet.h> // inet_pton, inet_ntop
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h> // PRIu64, SCNu64
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h> // snprintf, sscanf
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h> // struct timeval
+#include <time.h>
+#include <unistd.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define PROTOCOL_MAGIC "ADUPEER1"
+
+/**
+ * @brief Maximum length of a protocol line, including the terminator.
+ */
+#define MAX_LINE 256
+
+/**
+ * @brief Maximum number of files shared at the same time. The share that expires first is replaced.
+ */
+#define MAX_SHARED_FILES 64
+
+/**
+ * @brief Interval at which the worker threads check for shutdown.
+ */
+#define STOP_POLL_INTERVAL_MS 250
+
+/**
+ * @brief Send and receive timeout of range connections.
+ */
+#define CONNECTION_TIMEOUT_SECONDS 10
+
+#define DEFAULT_DISCOVERY_PORT 50990
+#define DEFAULT_SERVE_PORT 50991
+#define DEFAULT_DISCOVERY_ADDRESS "255.255.255.255"
+#define DEFAULT_DISCOVERY_TIMEOUT_MS 500
+#define DEFAULT_RANGE_KB 1024
+#define DEFAULT_SHARE_TIMEOUT_SECONDS 3600
+#define DEFAULT_MAX_UPLOADS 4
+
+static const char* CONFIG_PEER_SHARING = "peerSharing";
+static const char* CONFIG_ENABLED = "enabled";
+static const char* CONFIG_DISCOVERY_PORT = "discoveryPort";
+static const char* CONFIG_SERVE_PORT = "servePort";
+static const char* CONFIG_DISCOVERY_ADDRESS = "discoveryAddress";
+static const char* CONFIG_PEERS = "peers";
+static const char* CONFIG_DISCOVERY_TIMEOUT_MS = "discoveryTimeoutMs";
+static const char* CONFIG_RANGE_KB = "rangeKB";
+static const char* CONFIG_SHARE_TIMEOUT_SECONDS = "shareTimeoutSeconds";
+static const char* CONFIG_MAX_UPLOADS = "maxUploads";
+
+/**
+ * @brief A file that is served to peers.
+ */
+typedef struct tagADUC_PeerSharing_SharedFile
+{
+    char hash[ADUC_PEER_SHARING_MAX_HASH]; /**< The manifest hash of the file. Empty if the slot is free. */
+    char* filePath; /**< The file path. */
+    uint64_t size; /**< File size when shared. */
+    time_t modifiedTime; /**< File modification time when shared. */
+    time_t expiresAt; /**< Monotonic time in seconds when the share ends. */
+} ADUC_PeerSharing_SharedFile;
+
+struct tagADUC_PeerSharing
+{
+    ADUC_PeerSharing_Config config; /**< The configuration. */
+    uint64_t instanceId; /**< Random id to ignore the own queries. */
+    int discoveryFd; /**< UDP socket answering queries. */
+    int listenFd; /**< TCP socket serving ranges. */
+    unsigned short discoveryPort; /**< Bound discovery port. */
+    unsigned short servePort; /**< Bound serve port. */
+
+    pthread_mutex_t mutex; /**< Guards sharedFiles, stopping and calibration. */
+    ADUC_PeerSharing_SharedFile sharedFiles[MAX_SHARED_FILES]; /**< The shared files. */
+    bool stopping; /**< Set when the threads must exit. */
+    ADUC_SocketTuning_Calibration calibration; /**< Receive buffer calibrated from the first range. */
+
+    pthread_t discoveryThread; /**< Answers queries. */
+    bool discoveryThreadStarted; /**< True if discoveryThread must be joined. */
+    pthread_t* uploadThreads; /**< Serve ranges. */
+    size_t uploadThreadCount; /**< Number of started uploadThreads. */
+};
+
+/**
+ * @brief A peer connection during a download.
+ */
+typedef struct tagADUC_PeerSharing_Connection
+{
+    const ADUC_PeerSharing_Peer* peer; /**< The peer. */
+    int fd; /**< The connection, or -1 if not connected. */
+    bool failed; /**< True if the peer failed a range. */
+} ADUC_PeerSharing_Connection;
+
+//
+// Configuration
+//
+
+/**
+ * @brief Reads a non-negative integer field.
+ *
+ * @return false if the field is present but not a number in [0, @p maxValue].
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int maxValue, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 0 || number > (double)maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+/**
+ * @brief Reads a port field.
+ */
+static bool GetPortField(const JSON_Object* obj, const char* name, unsigned short* port)
+{
+    unsigned int value = *port;
+    if (!GetUIntField(obj, name, UINT16_MAX, &value))
+    {
+        return false;
+    }
+
+    *port = (unsigned short)value;
+    return true;
+}
+
+/**
+ * @brief Checks that @p address is an IPv4 literal and copies it.
+ */
+static bool CopyAddress(char* dest, const char* address)
+{
+    struct in_addr addr;
+    if (address == NULL || inet_pton(AF_INET, address, &addr) != 1)
+    {
+        return false;
+    }
+
+    return ADUC_Safe_StrCopyN(dest, address, ADUC_PEER_SHARING_MAX_ADDRESS, strlen(address)) == strlen(address);
+}
+
+/**
+ * @brief Parses an "<IPv4 address>:<port>" peer.
+ */
+static bool ParseEndpoint(const char* str, ADUC_PeerSharing_Endpoint* endpoint)
+{
+    char address[ADUC_PEER_SHARING_MAX_ADDRESS];
+    unsigned int port = 0;
+    char trailing;
+
+    if (str == NULL || sscanf(str, "%15[0-9.]:%u%c", address, &port, &trailing) != 2 || port == 0
+        || port > UINT16_MAX)
+    {
+        return false;
+    }
+
+    endpoint->port = (unsigned short)port;
+    return CopyAddress(endpoint->address, address);
+}
+
+bool ADUC_PeerSharing_ParseConfig(ADUC_PeerSharing_Config* config, const JSON_Object* peerSharingObj)
+{
+    bool succeeded = false;
+
+    memset(config, 0, sizeof(*config));
+
+    if (peerSharingObj == NULL)
+    {
+        return true;
+    }
+
+    config->discoveryPort = DEFAULT_DISCOVERY_PORT;
+    config->servePort = DEFAULT_SERVE_PORT;
+    config->discoveryTimeoutMs = DEFAULT_DISCOVERY_TIMEOUT_MS;
+    config->rangeKB = DEFAULT_RANGE_KB;
+    config->shareTimeoutSeconds = DEFAULT_SHARE_TIMEOUT_SECONDS;
+    config->maxUploads = DEFAULT_MAX_UPLOADS;
+
+    if (json_object_has_value(peerSharingObj, CONFIG_ENABLED)
+        && !json_object_has_value_of_type(peerSharingObj, CONFIG_ENABLED, JSONBoolean))
+    {
+        Log_Error("Invalid %s.%s, expected a boolean.", CONFIG_PEER_SHARING, CONFIG_ENABLED);
+        goto done;
+    }
+
+    if (!GetPortField(peerSharingObj, CONFIG_DISCOVERY_PORT, &config->discoveryPort)
+        || !GetPortField(peerSharingObj, CONFIG_SERVE_PORT, &config->servePort)
+        || !GetUIntField(peerSharingObj, CONFIG_DISCOVERY_TIMEOUT_MS, 60 * 1000, &config->discoveryTimeoutMs)
+        || !GetUIntField(peerSharingObj, CONFIG_RANGE_KB, 64 * 1024, &config->rangeKB)
+        || !GetUIntField(peerSharingObj, CONFIG_SHARE_TIMEOUT_SECONDS, UINT32_MAX, &config->shareTimeoutSeconds)
+        || !GetUIntField(peerSharingObj, CONFIG_MAX_UPLOADS, 64, &config->maxUploads) || config->rangeKB == 0
+        || config->maxUploads == 0)
+    {
+        Log_Error("Invalid %s, expected ports and positive limits.", CONFIG_PEER_SHARING);
+        goto done;
+    }
+
+    const char* discoveryAddress = DEFAULT_DISCOVERY_ADDRESS;
+    if (json_object_has_value(peerSharingObj, CONFIG_DISCOVERY_ADDRESS))
+    {
+        discoveryAddress = json_object_get_string(peerSharingObj, CONFIG_DISCOVERY_ADDRESS);
+    }
+
+    if (discoveryAddress == NULL
+        || (*discoveryAddress != '\0' && !CopyAddress(config->discoveryAddress, discoveryAddress)))
+    {
+        Log_Error("Invalid %s.%s, expected an IPv4 address.", CONFIG_PEER_SHARING, CONFIG_DISCOVERY_ADDRESS);
+        goto done;
+    }
+
+    if (json_object_has_value(peerSharingObj, CONFIG_PEERS)
+        && !json_object_has_value_of_type(peerSharingObj, CONFIG_PEERS, JSONArray))
+    {
+        Log_Error("Invalid %s.%s, expected an array.", CONFIG_PEER_SHARING, CONFIG_PEERS);
+        goto done;
+    }
+
+    const JSON_Array* peers = json_object_get_array(peerSharingObj, CONFIG_PEERS);
+    config->staticPeerCount = json_array_get_count(peers);
+    if (config->staticPeerCount > ADUC_PEER_SHARING_MAX_STATIC_PEERS)
+    {
+        Log_Error(
+            "Too many %s.%s, max %d.", CONFIG_PEER_SHARING, CONFIG_PEERS, ADUC_PEER_SHARING_MAX_STATIC_PEERS);
+        goto done;
+    }
+
+    for (size_t i = 0; i < config->staticPeerCount; ++i)
+    {
+        if (!ParseEndpoint(json_array_get_string(peers, i), &config->staticPeers[i]))
+        {
+            Log_Error("Invalid %s.%s entry %zu, expected <IPv4 address>:<port>.", CONFIG_PEER_SHARING, CONFIG_PEERS, i);
+            goto done;
+        }
+    }
+
+    config->enabled = !json_object_has_value(peerSharingObj, CONFIG_ENABLED)
+        || json_object_get_boolean(peerSharingObj, CONFIG_ENABLED) == 1;
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(config, 0, sizeof(*config));
+    }
+
+    return succeeded;
+}
+
+//
+// Helpers
+//
+
+/**
+ * @brief Gets the monotonic time in seconds.
+ */
+static time_t GetMonotonicSeconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+/**
+ * @brief Gets the monotonic time in milliseconds.
+ */
+static int64_t GetMonotonicMs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Checks that @p hash can be sent in a protocol line.
+ */
+static bool IsValidHash(const char* hash)
+{
+    size_t length = ADUC_StrNLen(hash, ADUC_PEER_SHARING_MAX_HASH);
+    if (hash == NULL || length == 0 || length == ADUC_PEER_SHARING_MAX_HASH)
+    {
+        return false;
+    }
+
+    for (const char* c = hash; *c != '\0'; ++c)
+    {
+        if (*c <= ' ' || *c > '~')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool IsStopping(ADUC_PeerSharing* sharing)
+{
+    pthread_mutex_lock(&sharing->mutex);
+    bool stopping = sharing->stopping;
+    pthread_mutex_unlock(&sharing->mutex);
+    return stopping;
+}
+
+/**
+ * @brief Waits until @p fd is readable, the timeout expires, or the instance stops.
+ *
+ * @return bool true if @p fd is readable.
+ */
+static bool WaitReadable(int fd, int timeoutMs)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+    return poll(&pfd, 1, timeoutMs) == 1 && (pfd.revents & POLLIN) != 0;
+}
+
+static void SetSocketTimeouts(int fd)
+{
+    struct timeval timeout = { .tv_sec = CONNECTION_TIMEOUT_SECONDS, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static bool SendAll(int fd, const char* buffer, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, buffer, size, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        buffer += sent;
+        size -= (size_t)sent;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Reads one protocol line. Reads byte by byte, so that no payload bytes are consumed.
+ *
+ * @return bool true if a complete line was read. The newline is removed.
+ */
+static bool ReceiveLine(int fd, char* line, size_t size)
+{
+    size_t length = 0;
+    while (length + 1 < size)
+    {
+        char c;
+        ssize_t received = recv(fd, &c, 1, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (received != 1)
+        {
+            return false;
+        }
+
+        if (c == '\n')
+        {
+            line[length] = '\0';
+            return true;
+        }
+
+        line[length++] = c;
+    }
+
+    return false;
+}
+
+static bool MakeSockAddr(const ADUC_PeerSharing_Endpoint* endpoint, struct sockaddr_in* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(endpoint->port);
+    return inet_pton(AF_INET, endpoint->address, &addr->sin_addr) == 1;
+}
+
+/**
+ * @brief Creates a socket bound to INADDR_ANY and @p port, and returns the bound port.
+ */
+static int CreateBoundSocket(int type, unsigned short port, unsigned short* boundPort)
+{
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    socklen_t addrLength = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || getsockname(fd, (struct sockaddr*)&addr, &addrLength) != 0)
+    {
+        Log_Error("Cannot bind port %u, errno: %d", port, errno);
+        close(fd);
+        return -1;
+    }
+
+    *boundPort = ntohs(addr.sin_port);
+    return fd;
+}
+
+//
+// Shared files
+//
+
+static void ClearSharedFile(ADUC_PeerSharing_SharedFile* file)
+{
+    free(file->filePath);
+    memset(file, 0, sizeof(*file));
+}
+
+/**
+ * @brief Looks up a valid share of @p hash. Shares of changed or removed files and expired shares are dropped.
+ *
+ * @param[out] filePath The shared file path, if found. Caller must free().
+ * @param[out] size The shared file size, if found.
+ * @return bool true if found.
+ */
+static bool LookupSharedFile(ADUC_PeerSharing* sharing, const char* hash, char** filePath, uint64_t* size)
+{
+    bool found = false;
+    const time_t now = GetMonotonicSeconds();
+
+    pthread_mutex_lock(&sharing->mutex);
+
+    for (size_t i = 0; i < MAX_SHARED_FILES && !found; ++i)
+    {
+        ADUC_PeerSharing_SharedFile* file = &sharing->sharedFiles[i];
+        if (file->hash[0] == '\0' || strcmp(file->hash, hash) != 0)
+        {
+            continue;
+        }
+
+        struct stat st;
+        if (now >= file->expiresAt || stat(file->filePath, &st) != 0 || !S_ISREG(st.st_mode)
+            || (uint64_t)st.st_size != file->size || st.st_mtime != file->modifiedTime)
+        {
+            Log_Debug("Stop sharing %s", file->filePath);
+            ClearSharedFile(file);
+            continue;
+        }
+
+        *filePath = strdup(file->filePath);
+        *size = file->size;
+        found = (*filePath != NULL);
+    }
+
+    pthread_mutex_unlock(&sharing->mutex);
+
+    return found;
+}
+
+bool ADUC_PeerSharing_ShareFile(ADUC_PeerSharing* sharing, const char* hash, const char* filePath)
+{
+    bool succeeded = false;
+
+    if (sharing == NULL || !IsValidHash(hash) || filePath == NULL)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (stat(filePath, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    char* filePathCopy = strdup(filePath);
+    if (filePathCopy == NULL)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&sharing->mutex);
+
+    // Reuse the share of the same hash, or a free slot, or the share that expires first.
+    ADUC_PeerSharing_SharedFile* slot = &sharing->sharedFiles[0];
+    for (size_t i = 0; i < MAX_SHARED_FILES; ++i)
+    {
+        ADUC_PeerSharing_SharedFile* file = &sharing->sharedFiles[i];
+        if (file->hash[0] == '\0' || strcmp(file->hash, hash) == 0)
+        {
+            slot = file;
+            if (file->hash[0] != '\0')
+            {
+                break;
+            }
+        }
+        else if (slot->hash[0] != '\0' && file->expiresAt < slot->expiresAt)
+        {
+            slot = file;
+        }
+    }
+
+    ClearSharedFile(slot);
+    ADUC_Safe_StrCopyN(slot->hash, hash, sizeof(slot->hash), strlen(hash));
+    slot->filePath = filePathCopy;
+    slot->size = (uint64_t)st.st_size;
+    slot->modifiedTime = st.st_mtime;
+    slot->expiresAt = GetMonotonicSeconds() + (time_t)sharing->config.shareTimeoutSeconds;
+    succeeded = true;
+
+    pthread_mutex_unlock(&sharing->mutex);
+
+    Log_Info("Sharing %s with peers", filePath);
+
+    return succeeded;
+}
+
+//
+// Serving
+//
+
+/**
+ * @brief Answers queries for shared files.
+ */
+static void* DiscoveryThread(void* arg)
+{
+    ADUC_PeerSharing* sharing = (ADUC_PeerSharing*)arg;
+
+    while (!IsStopping(sharing))
+    {
+        if (!WaitReadable(sharing->discoveryFd, STOP_POLL_INTERVAL_MS))
+        {
+            continue;
+        }
+
+        char query[MAX_LINE];
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t received =
+            recvfrom(sharing->discoveryFd, query, sizeof(query) - 1, 0, (struct sockaddr*)&from, &fromLength);
+        if (received <= 0)
+        {
+            continue;
+        }
+
+        query[received] = '\0';
+
+        uint64_t instanceId = 0;
+        char hash[ADUC_PEER_SHARING_MAX_HASH];
+        if (sscanf(query, PROTOCOL_MAGIC " QUERY %" SCNx64 " %127s", &instanceId, hash) != 2
+            || instanceId == sharing->instanceId)
+        {
+            continue;
+        }
+
+        char* filePath = NULL;
+        uint64_t size = 0;
+        if (!LookupSharedFile(sharing, hash, &filePath, &size))
+        {
+            continue;
+        }
+
+        free(filePath);
+
+        char answer[MAX_LINE];
+        int length = snprintf(
+            answer, sizeof(answer), PROTOCOL_MAGIC " HAVE %s %u %" PRIu64 "\n", hash, sharing->servePort, size);
+        if (length > 0 && (size_t)length < sizeof(answer))
+        {
+            sendto(sharing->discoveryFd, answer, (size_t)length, 0, (struct sockaddr*)&from, fromLength);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Sends a range of a shared file.
+ *
+ * @return bool true if the connection can take another request.
+ */
+static bool ServeRange(ADUC_PeerSharing* sharing, int clientFd, const char* hash, uint64_t offset, uint64_t length)
+{
+    bool canContinue = false;
+    char* filePath = NULL;
+    uint64_t size = 0;
+    int fileFd = -1;
+    char header[MAX_LINE];
+
+    if (!LookupSharedFile(sharing, hash, &filePath, &size) || offset > size || length > size - offset)
+    {
+        goto done;
+    }
+
+    fileFd = open(filePath, O_RDONLY | O_CLOEXEC);
+    if (fileFd == -1)
+    {
+        goto done;
+    }
+
+    int headerLength = snprintf(header, sizeof(header), PROTOCOL_MAGIC " OK %" PRIu64 "\n", length);
+    if (!SendAll(clientFd, header, (size_t)headerLength))
+    {
+        close(fileFd);
+        free(filePath);
+        return false;
+    }
+
+    off_t fileOffset = (off_t)offset;
+    uint64_t remaining = length;
+    while (remaining > 0)
+    {
+        ssize_t sent = sendfile(clientFd, fileFd, &fileOffset, remaining > SIZE_MAX ? SIZE_MAX : (size_t)remaining);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (sent <= 0)
+        {
+            // The header promised the bytes, so the connection cannot be used anymore.
+            Log_Warn("Failed to send %s, errno: %d", filePath, errno);
+            close(fileFd);
+            free(filePath);
+            return false;
+        }
+
+        remaining -= (uint64_t)sent;
+    }
+
+    canContinue = true;
+
+done:
+    if (!canContinue && fileFd == -1)
+    {
+        canContinue = SendAll(clientFd, PROTOCOL_MAGIC " ERR\n", strlen(PROTOCOL_MAGIC " ERR\n"));
+    }
+
+    if (fileFd != -1)
+    {
+        close(fileFd);
+    }
+
+    free(filePath);
+    return canContinue;
+}
+
+/**
+ * @brief Serves range requests on a connection until the peer closes it.
+ */
+static void ServeConnection(ADUC_PeerSharing* sharing, int clientFd)
+{
+    char request[MAX_LINE];
+
+    while (!IsStopping(sharing) && ReceiveLine(clientFd, request, sizeof(request)))
+    {
+        char hash[ADUC_PEER_SHARING_MAX_HASH];
+        uint64_t offset = 0;
+        uint64_t length = 0;
+
+        if (sscanf(request, PROTOCOL_MAGIC " GET %127s %" SCNu64 " %" SCNu64, hash, &offset, &length) != 3
+            || !ServeRange(sharing, clientFd, hash, offset, length))
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Accepts connections and serves them. Several threads accept on the shared non-blocking socket.
+ */
+static void* UploadThread(void* arg)
+{
+    ADUC_PeerSharing* sharing = (ADUC_PeerSharing*)arg;
+
+    while (!IsStopping(sharing))
+    {
+        if (!WaitReadable(sharing->listenFd, STOP_POLL_INTERVAL_MS))
+        {
+            continue;
+        }
+
+        int clientFd = accept(sharing->listenFd, NULL, NULL);
+        if (clientFd == -1)
+        {
+            // Another thread took the connection.
+            continue;
+        }
+
+        fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+
+        ADUC_SocketTuning_Apply(&sharing->config.socketTuning, NULL, clientFd);
+        SetSocketTimeouts(clientFd);
+        ServeConnection(sharing, clientFd);
+        close(clientFd);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Creates a random id for the instance.
+ */
+static uint64_t CreateInstanceId(void)
+{
+    uint64_t id = 0;
+    int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+    {
+        if (read(fd, &id, sizeof(id)) != (ssize_t)sizeof(id))
+        {
+            id = 0;
+        }
+
+        close(fd);
+    }
+
+    if (id == 0)
+    {
+        id = ((uint64_t)getpid() << 32) ^ (uint64_t)GetMonotonicMs();
+    }
+
+    return id;
+}
+
+ADUC_PeerSharing* ADUC_PeerSharing_Create(const ADUC_PeerSharing_Config* config)
+{
+    bool succeeded = false;
+    ADUC_PeerSharing* sharing = NULL;
+
+    if (config == NULL || !config->enabled)
+    {
+        return NULL;
+    }
+
+    sharing = calloc(1, sizeof(*sharing));
+    if (sharing == NULL)
+    {
+        return NULL;
+    }
+
+    sharing->config = *config;
+    sharing->instanceId = CreateInstanceId();
+    sharing->listenFd = -1;
+    pthread_mutex_init(&sharing->mutex, NULL);
+
+    sharing->discoveryFd = CreateBoundSocket(SOCK_DGRAM, config->discoveryPort, &sharing->discoveryPort);
+    if (sharing->discoveryFd == -1)
+    {
+        goto done;
+    }
+
+    sharing->listenFd = CreateBoundSocket(SOCK_STREAM | SOCK_NONBLOCK, config->servePort, &sharing->servePort);
+    if (sharing->listenFd == -1 || listen(sharing->listenFd, (int)config->maxUploads) != 0)
+    {
+        goto done;
+    }
+
+    if (pthread_create(&sharing->discoveryThread, NULL, DiscoveryThread, sharing) != 0)
+    {
+        goto done;
+    }
+
+    sharing->discoveryThreadStarted = true;
+
+    sharing->uploadThreads = calloc(config->maxUploads, sizeof(pthread_t));
+    if (sharing->uploadThreads == NULL)
+    {
+        goto done;
+    }
+
+    for (; sharing->uploadThreadCount < config->maxUploads; ++sharing->uploadThreadCount)
+    {
+        if (pthread_create(&sharing->uploadThreads[sharing->uploadThreadCount], NULL, UploadThread, sharing) != 0)
+        {
+            goto done;
+        }
+    }
+
+    Log_Info(
+        "Peer sharing on discovery port %u, serve port %u", sharing->discoveryPort, sharing->servePort);
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        Log_Error("Failed to start peer sharing, errno: %d", errno);
+        ADUC_PeerSharing_Destroy(sharing);
+        sharing = NULL;
+    }
+
+    return sharing;
+}
+
+void ADUC_PeerSharing_Destroy(ADUC_PeerSharing* sharing)
+{
+    if (sharing == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&sharing->mutex);
+    sharing->stopping = true;
+    pthread_mutex_unlock(&sharing->mutex);
+
+    if (sharing->discoveryThreadStarted)
+    {
+        pthread_join(sharing->discoveryThread, NULL);
+    }
+
+    for (size_t i = 0; i < sharing->uploadThreadCount; ++i)
+    {
+        pthread_join(sharing->uploadThreads[i], NULL);
+    }
+
+    if (sharing->discoveryFd != -1)
+    {
+        close(sharing->discoveryFd);
+    }
+
+    if (sharing->listenFd != -1)
+    {
+        close(sharing->listenFd);
+    }
+
+    for (size_t i = 0; i < MAX_SHARED_FILES; ++i)
+    {
+        ClearSharedFile(&sharing->sharedFiles[i]);
+    }
+
+    pthread_mutex_destroy(&sharing->mutex);
+    free(sharing->uploadThreads);
+    free(sharing);
+}
+
+unsigned short ADUC_PeerSharing_GetDiscoveryPort(const ADUC_PeerSharing* sharing)
+{
+    return sharing != NULL ? sharing->discoveryPort : 0;
+}
+
+unsigned short ADUC_PeerSharing_GetServePort(const ADUC_PeerSharing* sharing)
+{
+    return sharing != NULL ? sharing->servePort : 0;
+}
+
+//
+// Downloading
+//
+
+/**
+ * @brief Adds a peer from an answer, unless it is known already or announces another size.
+ */
+static void AddPeer(
+    ADUC_PeerSharing_Peer* peers,
+    size_t* peerCount,
+    size_t maxPeers,
+    const struct sockaddr_in* from,
+    unsigned int servePort,
+    uint64_t size)
+{
+    ADUC_PeerSharing_Peer peer;
+    memset(&peer, 0, sizeof(peer));
+
+    if (servePort == 0 || servePort > UINT16_MAX || *peerCount >= maxPeers
+        || inet_ntop(AF_INET, &from->sin_addr, peer.endpoint.address, sizeof(peer.endpoint.address)) == NULL)
+    {
+        return;
+    }
+
+    peer.endpoint.port = (unsigned short)servePort;
+    peer.size = size;
+
+    for (size_t i = 0; i < *peerCount; ++i)
+    {
+        if (peers[i].size != size
+            || (peers[i].endpoint.port == peer.endpoint.port
+                && strcmp(peers[i].endpoint.address, peer.endpoint.address) == 0))
+        {
+            return;
+        }
+    }
+
+    peers[(*peerCount)++] = peer;
+}
+
+size_t ADUC_PeerSharing_FindPeers(
+    ADUC_PeerSharing* sharing, const char* hash, uint64_t size, ADUC_PeerSharing_Peer* peers, size_t maxPeers)
+{
+    size_t peerCount = 0;
+    int fd = -1;
+    char query[MAX_LINE];
+
+    if (sharing == NULL || !IsValidHash(hash) || peers == NULL || maxPeers == 0)
+    {
+        return 0;
+    }
+
+    int queryLength =
+        snprintf(query, sizeof(query), PROTOCOL_MAGIC " QUERY %016" PRIx64 " %s\n", sharing->instanceId, hash);
+    if (queryLength <= 0 || (size_t)queryLength >= sizeof(query))
+    {
+        return 0;
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    if (sharing->config.discoveryAddress[0] != '\0')
+    {
+        ADUC_PeerSharing_Endpoint broadcast = { .port = sharing->config.discoveryPort };
+        memcpy(broadcast.address, sharing->config.discoveryAddress, sizeof(broadcast.address));
+        if (MakeSockAddr(&broadcast, &addr))
+        {
+            sendto(fd, query, (size_t)queryLength, 0, (struct sockaddr*)&addr, sizeof(addr));
+        }
+    }
+
+    for (size_t i = 0; i < sharing->config.staticPeerCount; ++i)
+    {
+        if (MakeSockAddr(&sharing->config.staticPeers[i], &addr))
+        {
+            sendto(fd, query, (size_t)queryLength, 0, (struct sockaddr*)&addr, sizeof(addr));
+        }
+    }
+
+    const int64_t deadline = GetMonotonicMs() + sharing->config.discoveryTimeoutMs;
+    for (int64_t now = GetMonotonicMs(); now < deadline && peerCount < maxPeers; now = GetMonotonicMs())
+    {
+        if (!WaitReadable(fd, (int)(deadline - now)))
+        {
+            continue;
+        }
+
+        char answer[MAX_LINE];
+        struct sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        ssize_t received = recvfrom(fd, answer, sizeof(answer) - 1, 0, (struct sockaddr*)&from, &fromLength);
+        if (received <= 0)
+        {
+            continue;
+        }
+
+        answer[received] = '\0';
+
+        char answerHash[ADUC_PEER_SHARING_MAX_HASH];
+        unsigned int servePort = 0;
+        uint64_t peerSize = 0;
+        if (sscanf(answer, PROTOCOL_MAGIC " HAVE %127s %u %" SCNu64, answerHash, &servePort, &peerSize) != 3
+            || strcmp(answerHash, hash) != 0 || (size != 0 && peerSize != size))
+        {
+            continue;
+        }
+
+        AddPeer(peers, &peerCount, maxPeers, &from, servePort, peerSize);
+    }
+
+    close(fd);
+
+    Log_Info("Found %zu peers for payload %s", peerCount, hash);
+
+    return peerCount;
+}
+
+/**
+ * @brief Fetches a range from a peer and writes it at the same offset of @p fileFd.
+ *
+ * @return bool true if the whole range was written. On false, the connection is closed.
+ */
+static bool FetchPeerRange(
+    ADUC_PeerSharing* sharing,
+    ADUC_PeerSharing_Connection* connection,
+    const char* hash,
+    int fileFd,
+    uint64_t offset,
+    uint64_t length)
+{
+    bool succeeded = false;
+    char line[MAX_LINE];
+    char buffer[64 * 1024];
+
+    if (connection->fd == -1)
+    {
+        struct sockaddr_in addr;
+        if (!MakeSockAddr(&connection->peer->endpoint, &addr))
+        {
+            goto done;
+        }
+
+        connection->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connection->fd == -1)
+        {
+            goto done;
+        }
+
+        pthread_mutex_lock(&sharing->mutex);
+        ADUC_SocketTuning_Calibration calibration = sharing->calibration;
+        pthread_mutex_unlock(&sharing->mutex);
+
+        // The receive buffer must be set before connect() to be used for the window scale.
+        ADUC_SocketTuning_Apply(&sharing->config.socketTuning, &calibration, connection->fd);
+
+        // SO_SNDTIMEO also limits connect().
+        SetSocketTimeouts(connection->fd);
+        if (connect(connection->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            goto done;
+        }
+    }
+
+    int requestLength = snprintf(
+        line, sizeof(line), PROTOCOL_MAGIC " GET %s %" PRIu64 " %" PRIu64 "\n", hash, offset, length);
+    if (requestLength <= 0 || (size_t)requestLength >= sizeof(line)
+        || !SendAll(connection->fd, line, (size_t)requestLength) || !ReceiveLine(connection->fd, line, sizeof(line)))
+    {
+        goto done;
+    }
+
+    uint64_t responseLength = 0;
+    if (sscanf(line, PROTOCOL_MAGIC " OK %" SCNu64, &responseLength) != 1 || responseLength != length)
+    {
+        goto done;
+    }
+
+    const int64_t startMs = GetMonotonicMs();
+    uint64_t received = 0;
+    while (received < length)
+    {
+        size_t chunk = (length - received) < sizeof(buffer) ? (size_t)(length - received) : sizeof(buffer);
+        ssize_t readSize = recv(connection->fd, buffer, chunk, 0);
+        if (readSize < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (readSize <= 0)
+        {
+            goto done;
+        }
+
+        for (ssize_t written = 0; written < readSize;)
+        {
+            ssize_t writeSize =
+                pwrite(fileFd, buffer + written, (size_t)(readSize - written), (off_t)(offset + received));
+            if (writeSize < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (writeSize <= 0)
+            {
+                goto done;
+            }
+
+            written += writeSize;
+            received += (uint64_t)writeSize;
+        }
+    }
+
+    pthread_mutex_lock(&sharing->mutex);
+    ADUC_SocketTuning_Calibrate(
+        &sharing->config.socketTuning,
+        &sharing->calibration,
+        connection->fd,
+        received,
+        (double)(GetMonotonicMs() - startMs) / 1000);
+    pthread_mutex_unlock(&sharing->mutex);
+
+    succeeded = true;
+
+done:
+    if (!succeeded && connection->fd != -1)
+    {
+        close(connection->fd);
+        connection->fd = -1;
+    }
+
+    return succeeded;
+}
+
+bool ADUC_PeerSharing_Download(
+    ADUC_PeerSharing* sharing,
+    const char* hash,
+    const ADUC_PeerSharing_Peer* peers,
+    size_t peerCount,
+    const char* filePath,
+    ADUC_PeerSharing_OriginRangeFunc fetchOrigin,
+    void* context,
+    ADUC_PeerSharing_Stats* stats)
+{
+    bool succeeded = false;
+    int fileFd = -1;
+    ADUC_PeerSharing_Connection connections[ADUC_PEER_SHARING_MAX_PEERS];
+    ADUC_PeerSharing_Stats localStats = { 0, 0 };
+
+    if (stats == NULL)
+    {
+        stats = &localStats;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    if (sharing == NULL || !IsValidHash(hash) || peers == NULL || peerCount == 0 || filePath == NULL)
+    {
+        return false;
+    }
+
+    if (peerCount > ADUC_PEER_SHARING_MAX_PEERS)
+    {
+        peerCount = ADUC_PEER_SHARING_MAX_PEERS;
+    }
+
+    for (size_t i = 0; i < peerCount; ++i)
+    {
+        connections[i].peer = &peers[i];
+        connections[i].fd = -1;
+        connections[i].failed = false;
+    }
+
+    const uint64_t size = peers[0].size;
+    const uint64_t rangeSize = (uint64_t)sharing->config.rangeKB * 1024;
+
+    fileFd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    if (fileFd == -1 || ftruncate(fileFd, (off_t)size) != 0)
+    {
+        Log_Error("Cannot create '%s', errno: %d", filePath, errno);
+        goto done;
+    }
+
+    size_t rangeIndex = 0;
+    for (uint64_t offset = 0; offset < size; offset += rangeSize, ++rangeIndex)
+    {
+        const uint64_t length = (size - offset) < rangeSize ? (size - offset) : rangeSize;
+        bool fetched = false;
+
+        // Round-robin spreads the ranges over the peers. A failed peer is skipped for the remaining ranges.
+        for (size_t attempt = 0; attempt < peerCount && !fetched; ++attempt)
+        {
+            ADUC_PeerSharing_Connection* connection = &connections[(rangeIndex + attempt) % peerCount];
+            if (connection->failed)
+            {
+                continue;
+            }
+
+            fetched = FetchPeerRange(sharing, connection, hash, fileFd, offset, length);
+            if (fetched)
+            {
+                stats->bytesFromPeers += length;
+            }
+            else
+            {
+                Log_Warn(
+                    "Peer %s:%u failed range at %" PRIu64,
+                    connection->peer->endpoint.address,
+                    connection->peer->endpoint.port,
+                    offset);
+                connection->failed = true;
+            }
+        }
+
+        if (!fetched)
+        {
+            if (fetchOrigin == NULL || !fetchOrigin(context, fileFd, offset, length))
+            {
+                Log_Error("Failed to fetch range at %" PRIu64 " of '%s'", offset, filePath);
+                goto done;
+            }
+
+            stats->bytesFromOrigin += length;
+        }
+    }
+
+    if (fsync(fileFd) != 0)
+    {
+        goto done;
+    }
+
+    Log_Info(
+        "Downloaded '%s', %" PRIu64 " bytes from peers, %" PRIu64 " bytes from origin",
+        filePath,
+        stats->bytesFromPeers,
+        stats->bytesFromOrigin);
+
+    succeeded = true;
+
+done:
+    for (size_t i = 0; i < peerCount; ++i)
+    {
+        if (connections[i].fd != -1)
+        {
+            close(connections[i].fd);
+        }
+    }
+
+    if (fileFd != -1 && close(fileFd) != 0)
+    {
+        succeeded = false;
+    }
+
+    return succeeded;
+}
@@ -0,0 +1,316 @@
+/**
+ * @file peer_sharing_utils_ut.cpp
+ * @brief Unit Tests for peer_sharing_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/peer_sharing_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <parson.h>
+#include <string>
+#include <unistd.h> // unlink
+
+#define TEST_DIR "/tmp/adutest/peer_sharing_utils_ut"
+
+static ADUC_PeerSharing_Config ParseConfig(const char* json)
+{
+    ADUC_PeerSharing_Config config;
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    REQUIRE(ADUC_PeerSharing_ParseConfig(&config, json_value_get_object(value)));
+    json_value_free(value);
+    return config;
+}
+
+static bool ParseConfigFails(const char* json)
+{
+    ADUC_PeerSharing_Config config;
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool failed = !ADUC_PeerSharing_ParseConfig(&config, json_value_get_object(value)) && !config.enabled;
+    json_value_free(value);
+    return failed;
+}
+
+/**
+ * @brief Creates an instance on loopback with free ports that asks only @p peers.
+ */
+static ADUC_PeerSharing* CreateLoopbackPeer(
+    std::initializer_list<const ADUC_PeerSharing*> peers, const char* socketTuning = nullptr)
+{
+    ADUC_PeerSharing_Config config = ParseConfig(
+        R"({"discoveryPort":0,"servePort":0,"discoveryAddress":"",)"
+        R"("discoveryTimeoutMs":200,"rangeKB":64,"maxUploads":2})");
+
+    for (const ADUC_PeerSharing* peer : peers)
+    {
+        ADUC_PeerSharing_Endpoint* endpoint = &config.staticPeers[config.staticPeerCount++];
+        snprintf(endpoint->address, sizeof(endpoint->address), "127.0.0.1");
+        endpoint->port = ADUC_PeerSharing_GetDiscoveryPort(peer);
+    }
+
+    if (socketTuning != nullptr)
+    {
+        JSON_Value* value = json_parse_string(socketTuning);
+        REQUIRE(value != nullptr);
+        REQUIRE(ADUC_SocketTuning_ParseProfile(&config.socketTuning, json_value_get_object(value)));
+        json_value_free(value);
+    }
+
+    ADUC_PeerSharing* sharing = ADUC_PeerSharing_Create(&config);
+    REQUIRE(sharing != nullptr);
+    return sharing;
+}
+
+static std::string ReadFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+class TestFolder
+{
+public:
+    TestFolder() : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+
+        // 300 KiB of content that differs per range, so misplaced ranges are detected.
+        for (size_t i = 0; _payload.size() < 300 * 1024; ++i)
+        {
+            _payload += std::to_string(i) + ",";
+        }
+
+        _payload.resize(300 * 1024);
+        std::ofstream{ Payload(), std::ios::binary } << _payload;
+    }
+
+    TestFolder(const TestFolder&) = delete;
+    TestFolder& operator=(const TestFolder&) = delete;
+    TestFolder(TestFolder&&) = delete;
+    TestFolder& operator=(TestFolder&&) = delete;
+
+    std::string Payload() const
+    {
+        return _dir.GetDir() + "/payload.bin";
+    }
+
+    std::string Target() const
+    {
+        return _dir.GetDir() + "/target.bin";
+    }
+
+    const std::string& Content() const
+    {
+        return _payload;
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+    std::string _payload;
+};
+
+/**
+ * @brief Origin fallback that serves ranges of the test content.
+ */
+struct FakeOrigin
+{
+    const std::string* content;
+    size_t calls;
+};
+
+static bool FetchFromFakeOrigin(void* context, int fd, uint64_t offset, uint64_t length)
+{
+    auto* origin = static_cast<FakeOrigin*>(context);
+    ++origin->calls;
+    return pwrite(fd, origin->content->data() + offset, length, static_cast<off_t>(offset))
+        == static_cast<ssize_t>(length);
+}
+
+TEST_CASE("ADUC_PeerSharing_ParseConfig")
+{
+    SECTION("Not configured")
+    {
+        ADUC_PeerSharing_Config config;
+        REQUIRE(ADUC_PeerSharing_ParseConfig(&config, nullptr));
+        CHECK_FALSE(config.enabled);
+    }
+
+    SECTION("Defaults")
+    {
+        ADUC_PeerSharing_Config config = ParseConfig("{}");
+        CHECK(config.enabled);
+        CHECK(config.discoveryPort == 50990);
+        CHECK(config.servePort == 50991);
+        CHECK(std::string{ config.discoveryAddress } == "255.255.255.255");
+        CHECK(config.staticPeerCount == 0);
+        CHECK(config.rangeKB == 1024);
+    }
+
+    SECTION("Full configuration")
+    {
+        ADUC_PeerSharing_Config config = ParseConfig(
+            R"({"enabled":true,"discoveryPort":4000,"servePort":4001,"discoveryAddress":"192.168.1.255",)"
+            R"("peers":["10.0.0.1:4000","10.0.0.2:5000"],"discoveryTimeoutMs":100,"rangeKB":256,)"
+            R"("shareTimeoutSeconds":60,"maxUploads":8})");
+
+        CHECK(config.enabled);
+        CHECK(config.discoveryPort == 4000);
+        CHECK(config.servePort == 4001);
+        CHECK(std::string{ config.discoveryAddress } == "192.168.1.255");
+        REQUIRE(config.staticPeerCount == 2);
+        CHECK(std::string{ config.staticPeers[1].address } == "10.0.0.2");
+        CHECK(config.staticPeers[1].port == 5000);
+        CHECK(config.discoveryTimeoutMs == 100);
+        CHECK(config.rangeKB == 256);
+        CHECK(config.shareTimeoutSeconds == 60);
+        CHECK(config.maxUploads == 8);
+    }
+
+    SECTION("Disabled")
+    {
+        CHECK_FALSE(ParseConfig(R"({"enabled":false})").enabled);
+    }
+
+    SECTION("Invalid configurations")
+    {
+        CHECK(ParseConfigFails(R"({"enabled":"yes"})"));
+        CHECK(ParseConfigFails(R"({"discoveryPort":70000})"));
+        CHECK(ParseConfigFails(R"({"rangeKB":0})"));
+        CHECK(ParseConfigFails(R"({"maxUploads":0})"));
+        CHECK(ParseConfigFails(R"({"discoveryAddress":"peers.local"})"));
+        CHECK(ParseConfigFails(R"({"peers":"10.0.0.1:4000"})"));
+        CHECK(ParseConfigFails(R"({"peers":["10.0.0.1"]})"));
+        CHECK(ParseConfigFails(R"({"peers":["10.0.0.1:4000x"]})"));
+    }
+}
+
+TEST_CASE("ADUC_PeerSharing shares payloads between agents on loopback")
+{
+    TestFolder folder;
+    const uint64_t size = folder.Content().size();
+    FakeOrigin origin{ &folder.Content(), 0 };
+    ADUC_PeerSharing_Peer peers[ADUC_PEER_SHARING_MAX_PEERS];
+    ADUC_PeerSharing_Stats stats;
+
+    ADUC_PeerSharing* first = CreateLoopbackPeer({});
+    ADUC_PeerSharing* second = CreateLoopbackPeer({});
+    ADUC_PeerSharing* third = CreateLoopbackPeer({ first, second });
+
+    SECTION("Unknown payloads have no peers")
+    {
+        CHECK(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", 0, peers, ADUC_PEER_SHARING_MAX_PEERS) == 0);
+    }
+
+    SECTION("Ranges are fetched from all peers that hold the payload")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+        REQUIRE(ADUC_PeerSharing_ShareFile(second, "aGFzaA==", folder.Payload().c_str()));
+
+        const size_t peerCount =
+            ADUC_PeerSharing_FindPeers(third, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS);
+        REQUIRE(peerCount == 2);
+        CHECK(peers[0].size == size);
+
+        REQUIRE(ADUC_PeerSharing_Download(
+            third, "aGFzaA==", peers, peerCount, folder.Target().c_str(), FetchFromFakeOrigin, &origin, &stats));
+
+        CHECK(ReadFile(folder.Target()) == folder.Content());
+        CHECK(stats.bytesFromPeers == size);
+        CHECK(stats.bytesFromOrigin == 0);
+        CHECK(origin.calls == 0);
+    }
+
+    SECTION("Ranges are fetched over tuned connections")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+
+        ADUC_PeerSharing* tuned = CreateLoopbackPeer(
+            { first }, R"({"receiveBufferKB":256,"calibrate":true,"keepAliveIdleSeconds":60,"keepAliveCount":3})");
+
+        REQUIRE(ADUC_PeerSharing_FindPeers(tuned, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS) == 1);
+        REQUIRE(ADUC_PeerSharing_Download(
+            tuned, "aGFzaA==", peers, 1, folder.Target().c_str(), nullptr, nullptr, &stats));
+
+        CHECK(ReadFile(folder.Target()) == folder.Content());
+        CHECK(stats.bytesFromPeers == size);
+
+        ADUC_PeerSharing_Destroy(tuned);
+    }
+
+    SECTION("Peers announcing another size are ignored")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+        CHECK(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", size + 1, peers, ADUC_PEER_SHARING_MAX_PEERS) == 0);
+    }
+
+    SECTION("A downloaded payload can be shared on")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+
+        ADUC_PeerSharing* fourth = CreateLoopbackPeer({ third });
+
+        REQUIRE(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", 0, peers, ADUC_PEER_SHARING_MAX_PEERS) == 1);
+        REQUIRE(ADUC_PeerSharing_Download(
+            third, "aGFzaA==", peers, 1, folder.Target().c_str(), nullptr, nullptr, nullptr));
+        REQUIRE(ADUC_PeerSharing_ShareFile(third, "aGFzaA==", folder.Target().c_str()));
+
+        REQUIRE(ADUC_PeerSharing_FindPeers(fourth, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS) == 1);
+        CHECK(peers[0].endpoint.port == ADUC_PeerSharing_GetServePort(third));
+
+        ADUC_PeerSharing_Destroy(fourth);
+    }
+
+    SECTION("Ranges fall back to the origin when the peer stops sharing")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+        REQUIRE(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS) == 1);
+
+        // E.g. the sandbox of the peer was cleaned up.
+        REQUIRE(unlink(folder.Payload().c_str()) == 0);
+
+        REQUIRE(ADUC_PeerSharing_Download(
+            third, "aGFzaA==", peers, 1, folder.Target().c_str(), FetchFromFakeOrigin, &origin, &stats));
+
+        CHECK(ReadFile(folder.Target()) == folder.Content());
+        CHECK(stats.bytesFromPeers == 0);
+        CHECK(stats.bytesFromOrigin == size);
+        CHECK(origin.calls == 5);
+
+        CHECK(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS) == 0);
+    }
+
+    SECTION("Download fails without peers and origin")
+    {
+        REQUIRE(ADUC_PeerSharing_ShareFile(first, "aGFzaA==", folder.Payload().c_str()));
+        REQUIRE(ADUC_PeerSharing_FindPeers(third, "aGFzaA==", size, peers, ADUC_PEER_SHARING_MAX_PEERS) == 1);
+        REQUIRE(unlink(folder.Payload().c_str()) == 0);
+
+        CHECK_FALSE(ADUC_PeerSharing_Download(
+            third, "aGFzaA==", peers, 1, folder.Target().c_str(), nullptr, nullptr, &stats));
+    }
+
+    ADUC_PeerSharing_Destroy(third);
+    ADUC_PeerSharing_Destroy(second);
+    ADUC_PeerSharing_Destroy(first);
+}
+
+TEST_CASE("ADUC_PeerSharing rejects invalid arguments")
+{
+    ADUC_PeerSharing_Config config = ParseConfig(R"({"enabled":false})");
+    CHECK(ADUC_PeerSharing_Create(&config) == nullptr);
+    CHECK(ADUC_PeerSharing_Create(nullptr) == nullptr);
+
+    ADUC_PeerSharing* sharing = CreateLoopbackPeer({});
+    CHECK_FALSE(ADUC_PeerSharing_ShareFile(sharing, "has space", "/tmp"));
+    CHECK_FALSE(ADUC_PeerSharing_ShareFile(sharing, "aGFzaA==", "/tmp"));
+    CHECK_FALSE(ADUC_PeerSharing_ShareFile(sharing, "aGFzaA==", "/nonexistent"));
+    ADUC_PeerSharing_Destroy(sharing);
+}
@@ -0,0 +1,168 @@
+/**
+ * @file self_profile_utils.h
+ * @brief Samples the agent's own resource usage and keeps min/avg/max per deployment phase.
+ *
+ * The agent samples RSS, heap in use, open file descriptors, thread count and CPU usage from
+ * /proc/self and the allocator at a low rate. The summary is published through the
+ * deviceInformation component when it changes significantly.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_SELF_PROFILE_UTILS_H
+#define ADUC_SELF_PROFILE_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <aduc/types/update_content.h> // ADUCITF_State
+#include <parson.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Seconds between two samples.
+ */
+#define ADUC_SELF_PROFILE_SAMPLE_INTERVAL_SECONDS 60
+
+/**
+ * @brief Minimum seconds between two published summaries.
+ */
+#define ADUC_SELF_PROFILE_MIN_REPORT_INTERVAL_SECONDS (15 * 60)
+
+/**
+ * @brief The deployment phases that are profiled separately.
+ */
+typedef enum tagADUC_SelfProfile_Phase
+{
+    ADUC_SelfProfile_Phase_Idle = 0, /**< No deployment work in progress. */
+    ADUC_SelfProfile_Phase_Download, /**< Deployment acknowledged, or payloads being downloaded. */
+    ADUC_SelfProfile_Phase_Install, /**< Backup, install or restore in progress. */
+    ADUC_SelfProfile_Phase_Apply, /**< Apply in progress. */
+    ADUC_SelfProfile_Phase_Count
+} ADUC_SelfProfile_Phase;
+
+/**
+ * @brief The sampled metrics.
+ */
+typedef enum tagADUC_SelfProfile_Metric
+{
+    ADUC_SelfProfile_Metric_RssKb = 0, /**< Resident set size, in KiB. */
+    ADUC_SelfProfile_Metric_HeapKb, /**< Heap in use, in KiB. */
+    ADUC_SelfProfile_Metric_Fds, /**< Open file descriptors. */
+    ADUC_SelfProfile_Metric_Threads, /**< Threads. */
+    ADUC_SelfProfile_Metric_CpuPct, /**< CPU usage since the previous sample, in percent of one CPU. */
+    ADUC_SelfProfile_Metric_Count
+} ADUC_SelfProfile_Metric;
+
+/**
+ * @brief One sample of all metrics.
+ */
+typedef struct tagADUC_SelfProfile_Sample
+{
+    double values[ADUC_SelfProfile_Metric_Count]; /**< Values, indexed by ADUC_SelfProfile_Metric. */
+} ADUC_SelfProfile_Sample;
+
+/**
+ * @brief Min, max and sum of one metric.
+ */
+typedef struct tagADUC_SelfProfile_MetricStats
+{
+    double min; /**< Smallest sampled value. */
+    double max; /**< Largest sampled value. */
+    double sum; /**< Sum of all sampled values. */
+} ADUC_SelfProfile_MetricStats;
+
+/**
+ * @brief Statistics of one phase.
+ */
+typedef struct tagADUC_SelfProfile_PhaseStats
+{
+    unsigned int sampleCount; /**< Number of samples taken in this phase. */
+    ADUC_SelfProfile_MetricStats metrics[ADUC_SelfProfile_Metric_Count]; /**< Per-metric statistics. */
+} ADUC_SelfProfile_PhaseStats;
+
+/**
+ * @brief Statistics of all phases.
+ */
+typedef struct tagADUC_SelfProfile
+{
+    ADUC_SelfProfile_PhaseStats phases[ADUC_SelfProfile_Phase_Count]; /**< Per-phase statistics. */
+} ADUC_SelfProfile;
+
+/**
+ * @brief Maps a workflow state to the phase it is profiled in.
+ *
+ * @param state The workflow state.
+ * @return ADUC_SelfProfile_Phase The phase.
+ */
+ADUC_SelfProfile_Phase ADUC_SelfProfile_PhaseFromState(ADUCITF_State state);
+
+/**
+ * @brief Parses the content of /proc/self/stat.
+ *
+ * @param content The file content.
+ * @param[out] cpuTicks User plus system CPU time, in clock ticks.
+ * @param[out] threads Number of threads.
+ * @return true on success.
+ */
+bool ADUC_SelfProfile_ParseProcStat(const char* content, uint64_t* cpuTicks, unsigned int* threads);
+
+/**
+ * @brief Parses the content of /proc/self/statm.
+ *
+ * @param content The file content.
+ * @param[out] residentPages Resident set size, in pages.
+ * @return true on success.
+ */
+bool ADUC_SelfProfile_ParseProcStatm(const char* content, uint64_t* residentPages);
+
+/**
+ * @brief Adds @p sample to the statistics of @p phase.
+ *
+ * @param profile The profile.
+ * @param phase The phase the sample was taken in.
+ * @param sample The sample.
+ */
+void ADUC_SelfProfile_AddSample(
+    ADUC_SelfProfile* profile, ADUC_SelfProfile_Phase phase, const ADUC_SelfProfile_Sample* sample);
+
+/**
+ * @brief Compares two profiles.
+ *
+ * @param reported The last published profile.
+ * @param current The current profile.
+ * @return true if a phase has samples for the first time, or an average or maximum moved by more
+ * than 10% (and more than a small per-metric floor) since @p reported.
+ */
+bool ADUC_SelfProfile_HasSignificantChange(const ADUC_SelfProfile* reported, const ADUC_SelfProfile* current);
+
+/**
+ * @brief Builds the compact summary of @p profile.
+ * @details Each sampled phase maps to an object of metric name to [min, avg, max], e.g.
+ * {"idle":{"rssKb":[5120,5200,5300],...},"download":{...}}
+ *
+ * @param profile The profile.
+ * @return JSON_Value* The summary, or NULL on failure. Caller must free with json_value_free.
+ */
+JSON_Value* ADUC_SelfProfile_ToJson(const ADUC_SelfProfile* profile);
+
+/**
+ * @brief Sets the phase that the following samples of the agent profile belong to.
+ *
+ * @param phase The current phase.
+ */
+void ADUC_SelfProfile_SetPhase(ADUC_SelfProfile_Phase phase);
+
+/**
+ * @brief Samples the agent, if the sample interval has elapsed.
+ * @remark Call regularly from the main loop.
+ *
+ * @return JSON_Value* A new summary when it changed significantly since the last one returned,
+ * otherwise NULL. Caller must free with json_value_free.
+ */
+JSON_Value* ADUC_SelfProfile_DoWork(void);
+
+EXTERN_C_END
+
+#endif // ADUC_SELF_PROFILE_UTILS_H
@@ -0,0 +1,481 @@
+/**
+ * @file self_profile_utils.c
+ * @brief Implements sampling and summarizing of the agent's own resource usage.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/self_profile_utils.h"
+#include "aduc/logging.h"
+
+#include <aducpal/time.h> // clock_gettime, CLOCK_MONOTONIC
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h> // mallinfo2
+#include <math.h> // fabs
+#include <pthread.h>
+#include <stdlib.h> // strtoull
+#include <string.h>
+#include <unistd.h> // sysconf
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+/**
+ * @brief Size of the buffer for /proc/self/stat and /proc/self/statm.
+ */
+#define PROC_FILE_BUFFER_SIZE 1024
+
+/**
+ * @brief Relative change of an average or maximum that is significant.
+ */
+#define SIGNIFICANT_CHANGE_RATIO 0.1
+
+static const char* g_phaseNames[ADUC_SelfProfile_Phase_Count] = { "idle", "download", "install", "apply" };
+
+static const char* g_metricNames[ADUC_SelfProfile_Metric_Count] = { "rssKb", "heapKb", "fds", "threads", "cpuPct" };
+
+/**
+ * @brief Changes smaller than these are never significant, indexed by ADUC_SelfProfile_Metric.
+ */
+static const double g_metricChangeFloors[ADUC_SelfProfile_Metric_Count] = { 1024, 1024, 2, 1, 5 };
+
+/**
+ * @brief The profiling state of this process.
+ */
+typedef struct tagADUC_SelfProfile_State
+{
+    pthread_mutex_t mutex; /**< Guards this object. */
+    ADUC_SelfProfile_Phase phase; /**< The current phase. */
+    ADUC_SelfProfile profile; /**< Statistics since the agent started. */
+    ADUC_SelfProfile reportedProfile; /**< Statistics when the last summary was returned. */
+    time_t nextSampleTime; /**< Monotonic time of the next sample. */
+    time_t nextReportTime; /**< Monotonic time before which no summary is returned. */
+    bool hasBaseline; /**< True once CPU ticks and time of a previous sample are known. */
+    uint64_t lastCpuTicks; /**< CPU ticks at the previous sample. */
+    double lastSampleSeconds; /**< Monotonic time of the previous sample, in seconds. */
+} ADUC_SelfProfile_State;
+
+static ADUC_SelfProfile_State s_state = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+/**
+ * @brief Skips @p count space-separated fields of @p str.
+ */
+static const char* SkipFields(const char* str, unsigned int count)
+{
+    while (count > 0 && str != NULL)
+    {
+        str = strchr(str, ' ');
+        if (str != NULL)
+        {
+            ++str;
+        }
+        --count;
+    }
+
+    return str;
+}
+
+/**
+ * @brief Reads a small /proc file into @p buffer, NUL-terminated.
+ */
+static bool ReadProcFile(const char* path, char* buffer, size_t bufferSize)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    ssize_t length = read(fd, buffer, bufferSize - 1);
+    close(fd);
+
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    buffer[length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Counts the open file descriptors of this process.
+ */
+static unsigned int CountOpenFds(void)
+{
+    unsigned int count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+    {
+        return 0;
+    }
+
+    const struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+        {
+            ++count;
+        }
+    }
+
+    closedir(dir);
+
+    // Don't count the descriptor of the directory stream itself.
+    return count > 0 ? count - 1 : 0;
+}
+
+/**
+ * @brief Returns the heap in use, in bytes.
+ */
+static uint64_t GetHeapInUse(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return (uint64_t)info.uordblks + (uint64_t)info.hblkhd;
+#elif defined(__GLIBC__)
+    // mallinfo() wraps at 4GiB, which is far beyond the footprint of the agent.
+    struct mallinfo info = mallinfo();
+    return (uint64_t)(unsigned int)info.uordblks + (uint64_t)(unsigned int)info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Takes a sample of this process.
+ * @remark Must hold s_state.mutex.
+ *
+ * @param[out] sample The sample.
+ * @return true if a sample was taken. The first call only records the CPU baseline.
+ */
+static bool TakeSample(ADUC_SelfProfile_Sample* sample)
+{
+    char buffer[PROC_FILE_BUFFER_SIZE];
+    uint64_t cpuTicks = 0;
+    unsigned int threads = 0;
+    uint64_t residentPages = 0;
+    struct timespec now;
+
+    if (!ReadProcFile("/proc/self/stat", buffer, sizeof(buffer))
+        || !ADUC_SelfProfile_ParseProcStat(buffer, &cpuTicks, &threads))
+    {
+        return false;
+    }
+
+    if (!ReadProcFile("/proc/self/statm", buffer, sizeof(buffer))
+        || !ADUC_SelfProfile_ParseProcStatm(buffer, &residentPages))
+    {
+        return false;
+    }
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        return false;
+    }
+
+    const double nowSeconds = (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+    const bool hadBaseline = s_state.hasBaseline;
+    const double elapsedSeconds = nowSeconds - s_state.lastSampleSeconds;
+    const uint64_t elapsedTicks = cpuTicks - s_state.lastCpuTicks;
+
+    s_state.hasBaseline = true;
+    s_state.lastCpuTicks = cpuTicks;
+    s_state.lastSampleSeconds = nowSeconds;
+
+    if (!hadBaseline || elapsedSeconds <= 0)
+    {
+        return false;
+    }
+
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+    sample->values[ADUC_SelfProfile_Metric_RssKb] = (double)(residentPages * (uint64_t)pageSize / 1024);
+    sample->values[ADUC_SelfProfile_Metric_HeapKb] = (double)(GetHeapInUse() / 1024);
+    sample->values[ADUC_SelfProfile_Metric_Fds] = (double)CountOpenFds();
+    sample->values[ADUC_SelfProfile_Metric_Threads] = (double)threads;
+    sample->values[ADUC_SelfProfile_Metric_CpuPct] =
+        ticksPerSecond > 0 ? 100.0 * (double)elapsedTicks / (double)ticksPerSecond / elapsedSeconds : 0;
+
+    return true;
+}
+
+ADUC_SelfProfile_Phase ADUC_SelfProfile_PhaseFromState(ADUCITF_State state)
+{
+    switch (state)
+    {
+    case ADUCITF_State_DeploymentInProgress:
+    case ADUCITF_State_DownloadStarted:
+        return ADUC_SelfProfile_Phase_Download;
+
+    case ADUCITF_State_BackupStarted:
+    case ADUCITF_State_BackupSucceeded:
+    case ADUCITF_State_InstallStarted:
+    case ADUCITF_State_RestoreStarted:
+        return ADUC_SelfProfile_Phase_Install;
+
+    case ADUCITF_State_InstallSucceeded:
+    case ADUCITF_State_ApplyStarted:
+        return ADUC_SelfProfile_Phase_Apply;
+
+    default:
+        return ADUC_SelfProfile_Phase_Idle;
+    }
+}
+
+bool ADUC_SelfProfile_ParseProcStat(const char* content, uint64_t* cpuTicks, unsigned int* threads)
+{
+    // The command name may contain spaces and parentheses, so start after the last ')'.
+    // Then: state(3) ppid ... utime(14) stime(15) cutime cstime priority nice num_threads(20)
+    const char* fields = strrchr(content, ')');
+    if (fields == NULL || fields[1] != ' ')
+    {
+        return false;
+    }
+
+    // fields + 2 is field 3.
+    const char* utimeField = SkipFields(fields + 2, 14 - 3);
+    const char* threadsField = SkipFields(utimeField, 20 - 14);
+    if (utimeField == NULL || threadsField == NULL)
+    {
+        return false;
+    }
+
+    char* end = NULL;
+    errno = 0;
+    const unsigned long long utime = strtoull(utimeField, &end, 10);
+    if (errno != 0 || end == utimeField || *end != ' ')
+    {
+        return false;
+    }
+
+    const char* stimeField = end + 1;
+    const unsigned long long stime = strtoull(stimeField, &end, 10);
+    if (errno != 0 || end == stimeField)
+    {
+        return false;
+    }
+
+    const unsigned long long threadCount = strtoull(threadsField, &end, 10);
+    if (errno != 0 || end == threadsField)
+    {
+        return false;
+    }
+
+    *cpuTicks = (uint64_t)(utime + stime);
+    *threads = (unsigned int)threadCount;
+    return true;
+}
+
+bool ADUC_SelfProfile_ParseProcStatm(const char* content, uint64_t* residentPages)
+{
+    // size resident shared text lib data dt
+    const char* residentField = SkipFields(content, 1);
+    if (residentField == NULL)
+    {
+        return false;
+    }
+
+    char* end = NULL;
+    errno = 0;
+    const unsigned long long resident = strtoull(residentField, &end, 10);
+    if (errno != 0 || end == residentField)
+    {
+        return false;
+    }
+
+    *residentPages = (uint64_t)resident;
+    return true;
+}
+
+void ADUC_SelfProfile_AddSample(
+    ADUC_SelfProfile* profile, ADUC_SelfProfile_Phase phase, const ADUC_SelfProfile_Sample* sample)
+{
+    if ((unsigned int)phase >= ADUC_SelfProfile_Phase_Count)
+    {
+        return;
+    }
+
+    ADUC_SelfProfile_PhaseStats* stats = &profile->phases[phase];
+
+    for (unsigned int i = 0; i < ADUC_SelfProfile_Metric_Count; ++i)
+    {
+        ADUC_SelfProfile_MetricStats* metric = &stats->metrics[i];
+        const double value = sample->values[i];
+
+        if (stats->sampleCount == 0 || value < metric->min)
+        {
+            metric->min = value;
+        }
+
+        if (stats->sampleCount == 0 || value > metric->max)
+        {
+            metric->max = value;
+        }
+
+        metric->sum += value;
+    }
+
+    ++stats->sampleCount;
+}
+
+/**
+ * @brief Returns whether a value moved significantly from @p before to @p after.
+ */
+static bool IsSignificantChange(double before, double after, double floor)
+{
+    const double delta = fabs(after - before);
+    return delta > floor && delta > SIGNIFICANT_CHANGE_RATIO * fabs(before);
+}
+
+bool ADUC_SelfProfile_HasSignificantChange(const ADUC_SelfProfile* reported, const ADUC_SelfProfile* current)
+{
+    for (unsigned int phase = 0; phase < ADUC_SelfProfile_Phase_Count; ++phase)
+    {
+        const ADUC_SelfProfile_PhaseStats* before = &reported->phases[phase];
+        const ADUC_SelfProfile_PhaseStats* after = &current->phases[phase];
+
+        if (after->sampleCount == 0)
+        {
+            continue;
+        }
+
+        if (before->sampleCount == 0)
+        {
+            return true;
+        }
+
+        for (unsigned int i = 0; i < ADUC_SelfProfile_Metric_Count; ++i)
+        {
+            const double beforeAvg = before->metrics[i].sum / before->sampleCount;
+            const double afterAvg = after->metrics[i].sum / after->sampleCount;
+
+            if (IsSignificantChange(beforeAvg, afterAvg, g_metricChangeFloors[i])
+                || IsSignificantChange(before->metrics[i].max, after->metrics[i].max, g_metricChangeFloors[i]))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+JSON_Value* ADUC_SelfProfile_ToJson(const ADUC_SelfProfile* profile)
+{
+    bool succeeded = false;
+    JSON_Value* rootValue = json_value_init_object();
+    JSON_Object* rootObj = json_value_get_object(rootValue);
+
+    if (rootObj == NULL)
+    {
+        goto done;
+    }
+
+    for (unsigned int phase = 0; phase < ADUC_SelfProfile_Phase_Count; ++phase)
+    {
+        const ADUC_SelfProfile_PhaseStats* stats = &profile->phases[phase];
+        if (stats->sampleCount == 0)
+        {
+            continue;
+        }
+
+        JSON_Value* phaseValue = json_value_init_object();
+        if (json_object_set_value(rootObj, g_phaseNames[phase], phaseValue) != JSONSuccess)
+        {
+            json_value_free(phaseValue);
+            goto done;
+        }
+
+        JSON_Object* phaseObj = json_value_get_object(phaseValue);
+
+        for (unsigned int i = 0; i < ADUC_SelfProfile_Metric_Count; ++i)
+        {
+            const ADUC_SelfProfile_MetricStats* metric = &stats->metrics[i];
+
+            JSON_Value* triple = json_value_init_array();
+            if (json_object_set_value(phaseObj, g_metricNames[i], triple) != JSONSuccess)
+            {
+                json_value_free(triple);
+                goto done;
+            }
+
+            // Round to one decimal to keep the reported property compact.
+            JSON_Array* tripleArray = json_value_get_array(triple);
+            if (json_array_append_number(tripleArray, round(metric->min * 10) / 10) != JSONSuccess
+                || json_array_append_number(tripleArray, round(metric->sum / stats->sampleCount * 10) / 10)
+                    != JSONSuccess
+                || json_array_append_number(tripleArray, round(metric->max * 10) / 10) != JSONSuccess)
+            {
+                goto done;
+            }
+        }
+    }
+
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        json_value_free(rootValue);
+        rootValue = NULL;
+    }
+
+    return rootValue;
+}
+
+void ADUC_SelfProfile_SetPhase(ADUC_SelfProfile_Phase phase)
+{
+    pthread_mutex_lock(&s_state.mutex);
+    s_state.phase = phase;
+    pthread_mutex_unlock(&s_state.mutex);
+}
+
+JSON_Value* ADUC_SelfProfile_DoWork(void)
+{
+    JSON_Value* summary = NULL;
+    ADUC_SelfProfile_Sample sample;
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&s_state.mutex);
+
+    if (now.tv_sec < s_state.nextSampleTime)
+    {
+        goto done;
+    }
+
+    s_state.nextSampleTime = now.tv_sec + ADUC_SELF_PROFILE_SAMPLE_INTERVAL_SECONDS;
+
+    if (!TakeSample(&sample))
+    {
+        goto done;
+    }
+
+    ADUC_SelfProfile_AddSample(&s_state.profile, s_state.phase, &sample);
+
+    if (now.tv_sec < s_state.nextReportTime
+        || !ADUC_SelfProfile_HasSignificantChange(&s_state.reportedProfile, &s_state.profile))
+    {
+        goto done;
+    }
+
+    summary = ADUC_SelfProfile_ToJson(&s_state.profile);
+    if (summary != NULL)
+    {
+        s_state.reportedProfile = s_state.profile;
+        s_state.nextReportTime = now.tv_sec + ADUC_SELF_PROFILE_MIN_REPORT_INTERVAL_SECONDS;
+    }
+
+done:
+    pthread_mutex_unlock(&s_state.mutex);
+
+    return summary;
+}
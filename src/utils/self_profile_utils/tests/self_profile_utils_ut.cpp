@@ -0,0 +1,143 @@
+/**
+ * @file self_profile_utils_ut.cpp
+ * @brief Unit Tests for self_profile_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/self_profile_utils.h"
+
+#include <catch2/catch.hpp>
+
+#include <parson.h>
+#include <string>
+
+static ADUC_SelfProfile_Sample MakeSample(double rssKb, double heapKb, double fds, double threads, double cpuPct)
+{
+    ADUC_SelfProfile_Sample sample;
+    sample.values[ADUC_SelfProfile_Metric_RssKb] = rssKb;
+    sample.values[ADUC_SelfProfile_Metric_HeapKb] = heapKb;
+    sample.values[ADUC_SelfProfile_Metric_Fds] = fds;
+    sample.values[ADUC_SelfProfile_Metric_Threads] = threads;
+    sample.values[ADUC_SelfProfile_Metric_CpuPct] = cpuPct;
+    return sample;
+}
+
+TEST_CASE("ADUC_SelfProfile_ParseProcStat")
+{
+    SECTION("Command name with spaces and parentheses")
+    {
+        const char* stat = "1234 (AducIotAgent (x)) S 1 1234 1234 0 -1 4194560 2519 0 0 0 "
+                           "150 75 0 0 20 0 7 0 12345 123456789 1280 18446744073709551615";
+        uint64_t cpuTicks = 0;
+        unsigned int threads = 0;
+
+        REQUIRE(ADUC_SelfProfile_ParseProcStat(stat, &cpuTicks, &threads));
+        CHECK(cpuTicks == 225);
+        CHECK(threads == 7);
+    }
+
+    SECTION("Truncated content")
+    {
+        uint64_t cpuTicks = 0;
+        unsigned int threads = 0;
+
+        CHECK_FALSE(ADUC_SelfProfile_ParseProcStat("1234 (agent) S 1 1234", &cpuTicks, &threads));
+        CHECK_FALSE(ADUC_SelfProfile_ParseProcStat("garbage", &cpuTicks, &threads));
+    }
+}
+
+TEST_CASE("ADUC_SelfProfile_ParseProcStatm")
+{
+    uint64_t residentPages = 0;
+
+    REQUIRE(ADUC_SelfProfile_ParseProcStatm("4000 1500 900 200 0 1100 0\n", &residentPages));
+    CHECK(residentPages == 1500);
+
+    CHECK_FALSE(ADUC_SelfProfile_ParseProcStatm("4000", &residentPages));
+}
+
+TEST_CASE("ADUC_SelfProfile_PhaseFromState")
+{
+    CHECK(ADUC_SelfProfile_PhaseFromState(ADUCITF_State_Idle) == ADUC_SelfProfile_Phase_Idle);
+    CHECK(ADUC_SelfProfile_PhaseFromState(ADUCITF_State_Failed) == ADUC_SelfProfile_Phase_Idle);
+    CHECK(ADUC_SelfProfile_PhaseFromState(ADUCITF_State_DownloadStarted) == ADUC_SelfProfile_Phase_Download);
+    CHECK(ADUC_SelfProfile_PhaseFromState(ADUCITF_State_InstallStarted) == ADUC_SelfProfile_Phase_Install);
+    CHECK(ADUC_SelfProfile_PhaseFromState(ADUCITF_State_ApplyStarted) == ADUC_SelfProfile_Phase_Apply);
+}
+
+TEST_CASE("ADUC_SelfProfile_AddSample and ToJson")
+{
+    ADUC_SelfProfile profile = {};
+
+    ADUC_SelfProfile_Sample first = MakeSample(5000, 1000, 10, 4, 1.0);
+    ADUC_SelfProfile_Sample second = MakeSample(7000, 3000, 14, 6, 3.0);
+    ADUC_SelfProfile_AddSample(&profile, ADUC_SelfProfile_Phase_Download, &first);
+    ADUC_SelfProfile_AddSample(&profile, ADUC_SelfProfile_Phase_Download, &second);
+
+    const ADUC_SelfProfile_PhaseStats& stats = profile.phases[ADUC_SelfProfile_Phase_Download];
+    CHECK(stats.sampleCount == 2);
+    CHECK(stats.metrics[ADUC_SelfProfile_Metric_RssKb].min == Approx(5000));
+    CHECK(stats.metrics[ADUC_SelfProfile_Metric_RssKb].max == Approx(7000));
+    CHECK(stats.metrics[ADUC_SelfProfile_Metric_RssKb].sum == Approx(12000));
+    CHECK(profile.phases[ADUC_SelfProfile_Phase_Idle].sampleCount == 0);
+
+    JSON_Value* summary = ADUC_SelfProfile_ToJson(&profile);
+    REQUIRE(summary != nullptr);
+
+    const JSON_Object* summaryObj = json_value_get_object(summary);
+    CHECK(json_object_get_object(summaryObj, "idle") == nullptr);
+
+    const JSON_Array* rss = json_object_dotget_array(summaryObj, "download.rssKb");
+    REQUIRE(rss != nullptr);
+    REQUIRE(json_array_get_count(rss) == 3);
+    CHECK(json_array_get_number(rss, 0) == Approx(5000));
+    CHECK(json_array_get_number(rss, 1) == Approx(6000));
+    CHECK(json_array_get_number(rss, 2) == Approx(7000));
+
+    const JSON_Array* cpu = json_object_dotget_array(summaryObj, "download.cpuPct");
+    REQUIRE(cpu != nullptr);
+    CHECK(json_array_get_number(cpu, 1) == Approx(2.0));
+
+    json_value_free(summary);
+}
+
+TEST_CASE("ADUC_SelfProfile_HasSignificantChange")
+{
+    ADUC_SelfProfile reported = {};
+    ADUC_SelfProfile current = {};
+
+    ADUC_SelfProfile_Sample base = MakeSample(20000, 8000, 12, 5, 1.0);
+    ADUC_SelfProfile_AddSample(&current, ADUC_SelfProfile_Phase_Idle, &base);
+
+    SECTION("First samples of a phase are significant")
+    {
+        CHECK(ADUC_SelfProfile_HasSignificantChange(&reported, &current));
+    }
+
+    SECTION("Small drift is not significant")
+    {
+        reported = current;
+
+        ADUC_SelfProfile_Sample drift = MakeSample(20500, 8200, 13, 5, 2.0);
+        ADUC_SelfProfile_AddSample(&current, ADUC_SelfProfile_Phase_Idle, &drift);
+        CHECK_FALSE(ADUC_SelfProfile_HasSignificantChange(&reported, &current));
+    }
+
+    SECTION("Memory growth is significant")
+    {
+        reported = current;
+
+        ADUC_SelfProfile_Sample growth = MakeSample(30000, 8000, 12, 5, 1.0);
+        ADUC_SelfProfile_AddSample(&current, ADUC_SelfProfile_Phase_Idle, &growth);
+        CHECK(ADUC_SelfProfile_HasSignificantChange(&reported, &current));
+    }
+
+    SECTION("A new phase is significant")
+    {
+        reported = current;
+
+        ADUC_SelfProfile_AddSample(&current, ADUC_SelfProfile_Phase_Install, &base);
+        CHECK(ADUC_SelfProfile_HasSignificantChange(&reported, &current));
+    }
+}
@@ -0,0 +1,131 @@
+/**
+ * @file socket_tuning_utils.h
+ * @brief Per-socket TCP tuning of download connections.
+ *
+ * Kernel defaults cap the throughput of a single stream on paths with a large bandwidth-delay product, such
+ * as satellite and cellular links. The tuning profile sets the options per socket, so that system-wide
+ * sysctls stay untouched. It is configured by the optional "socketTuning" object of du-config.json:
+ *
+ *   "socketTuning": {
+ *       "receiveBufferKB": 0,
+ *       "calibrate": true,
+ *       "congestionControl": "bbr",
+ *       "notSentLowatKB": 128,
+ *       "keepAliveIdleSeconds": 60,
+ *       "keepAliveIntervalSeconds": 10,
+ *       "keepAliveCount": 6
+ *   }
+ *
+ * receiveBufferKB fixes the receive buffer. 0 keeps the kernel autotuning, and with calibrate the buffer is
+ * sized from the round-trip time and throughput measured on the first transfer of at least
+ * ADUC_SOCKET_TUNING_MIN_CALIBRATION_BYTES, for all later connections. congestionControl is used where the
+ * kernel offers it, otherwise the kernel default stays. The receive buffer only grows up to
+ * net.core.rmem_max. All fields are optional; an omitted field keeps the kernel default.
+ *
+ * The profile applies to the sockets of peer sharing, and to the downloads from the origin, which then run through
+ * libcurl in the agent instead of the curl command, see curl_download_utils.hpp.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_SOCKET_TUNING_UTILS_H
+#define ADUC_SOCKET_TUNING_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Maximum length of a congestion control name, including the terminator.
+ */
+#define ADUC_SOCKET_TUNING_MAX_CONGESTION_CONTROL 16
+
+/**
+ * @brief Smallest transfer a calibration is done from, so that the measured rate is past slow start.
+ */
+#define ADUC_SOCKET_TUNING_MIN_CALIBRATION_BYTES (512 * 1024)
+
+/**
+ * @brief Bounds of a calibrated receive buffer.
+ */
+#define ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER (64 * 1024)
+#define ADUC_SOCKET_TUNING_MAX_RECEIVE_BUFFER (16 * 1024 * 1024)
+
+/**
+ * @brief The tuning profile.
+ */
+typedef struct tagADUC_SocketTuning_Profile
+{
+    bool enabled; /**< True if "socketTuning" is configured. */
+    unsigned int receiveBufferBytes; /**< Fixed receive buffer size. 0 keeps autotuning. */
+    bool calibrate; /**< Size the receive buffer from the first transfer. */
+    char congestionControl[ADUC_SOCKET_TUNING_MAX_CONGESTION_CONTROL]; /**< Congestion control, or empty. */
+    unsigned int notSentLowatBytes; /**< TCP_NOTSENT_LOWAT of sending sockets. 0 keeps the default. */
+    unsigned int keepAliveIdleSeconds; /**< Idle time before keepalive probes. 0 disables keepalive tuning. */
+    unsigned int keepAliveIntervalSeconds; /**< Time between keepalive probes. 0 keeps the default. */
+    unsigned int keepAliveCount; /**< Unanswered probes before the connection is dropped. 0 keeps the default. */
+} ADUC_SocketTuning_Profile;
+
+/**
+ * @brief The result of a calibration, shared by the connections of a process.
+ */
+typedef struct tagADUC_SocketTuning_Calibration
+{
+    bool calibrated; /**< True once a transfer was measured. */
+    unsigned int receiveBufferBytes; /**< The receive buffer size for later connections. */
+} ADUC_SocketTuning_Calibration;
+
+/**
+ * @brief Parses the "socketTuning" configuration object.
+ *
+ * @param[out] profile The parsed profile. Disabled if @p tuningObj is NULL or invalid.
+ * @param tuningObj The "socketTuning" object, or NULL if not configured.
+ * @return bool true if not configured or valid.
+ */
+bool ADUC_SocketTuning_ParseProfile(ADUC_SocketTuning_Profile* profile, const JSON_Object* tuningObj);
+
+/**
+ * @brief Applies the profile to a TCP socket. Call it before connect(), since the receive buffer size
+ * determines the window scale negotiated in the handshake.
+ *
+ * @param profile The profile.
+ * @param calibration The calibration, or NULL.
+ * @param fd The socket.
+ * @return bool true if all configured options were set. Options the kernel does not support are logged and
+ * skipped, and the socket stays usable.
+ */
+bool ADUC_SocketTuning_Apply(
+    const ADUC_SocketTuning_Profile* profile, const ADUC_SocketTuning_Calibration* calibration, int fd);
+
+/**
+ * @brief Gets the receive buffer size for a path.
+ *
+ * @param bytesPerSecond The measured throughput.
+ * @param rttSeconds The measured round-trip time.
+ * @return unsigned int Twice the bandwidth-delay product, within the calibration bounds.
+ */
+unsigned int ADUC_SocketTuning_GetReceiveBufferSize(double bytesPerSecond, double rttSeconds);
+
+/**
+ * @brief Calibrates from a finished transfer, unless already calibrated or not requested by @p profile.
+ *
+ * @param profile The profile.
+ * @param calibration The calibration to update.
+ * @param fd The socket of the transfer, for its round-trip time.
+ * @param bytes The bytes received.
+ * @param seconds The duration of the transfer.
+ * @return bool true if @p calibration was updated.
+ */
+bool ADUC_SocketTuning_Calibrate(
+    const ADUC_SocketTuning_Profile* profile,
+    ADUC_SocketTuning_Calibration* calibration,
+    int fd,
+    uint64_t bytes,
+    double seconds);
+
+EXTERN_C_END
+
+#endif // ADUC_SOCKET_TUNING_UTILS_H
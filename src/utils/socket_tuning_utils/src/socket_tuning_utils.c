@@ -0,0 +1,259 @@
+/**
+ * @file socket_tuning_utils.c
+ * @brief Implements the per-socket TCP tuning of download connections.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/socket_tuning_utils.h"
+#include "aduc/logging.h"
+
+#include <errno.h>
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_CONGESTION, TCP_INFO, TCP_KEEPIDLE
+#include <stdint.h> // UINT32_MAX
+#include <string.h>
+#include <sys/socket.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+static const char* CONFIG_SOCKET_TUNING = "socketTuning";
+static const char* CONFIG_RECEIVE_BUFFER_KB = "receiveBufferKB";
+static const char* CONFIG_CALIBRATE = "calibrate";
+static const char* CONFIG_CONGESTION_CONTROL = "congestionControl";
+static const char* CONFIG_NOT_SENT_LOWAT_KB = "notSentLowatKB";
+static const char* CONFIG_KEEP_ALIVE_IDLE_SECONDS = "keepAliveIdleSeconds";
+static const char* CONFIG_KEEP_ALIVE_INTERVAL_SECONDS = "keepAliveIntervalSeconds";
+static const char* CONFIG_KEEP_ALIVE_COUNT = "keepAliveCount";
+
+/**
+ * @brief Largest configurable buffer or watermark, in KiB.
+ */
+#define MAX_SIZE_KB (1024 * 1024)
+
+/**
+ * @brief Reads a non-negative integer field.
+ *
+ * @return false if the field is present but not a number in [0, @p maxValue].
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int maxValue, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 0 || number > (double)maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+bool ADUC_SocketTuning_ParseProfile(ADUC_SocketTuning_Profile* profile, const JSON_Object* tuningObj)
+{
+    bool succeeded = false;
+    unsigned int receiveBufferKB = 0;
+    unsigned int notSentLowatKB = 0;
+
+    memset(profile, 0, sizeof(*profile));
+
+    if (tuningObj == NULL)
+    {
+        return true;
+    }
+
+    if (!GetUIntField(tuningObj, CONFIG_RECEIVE_BUFFER_KB, MAX_SIZE_KB, &receiveBufferKB)
+        || !GetUIntField(tuningObj, CONFIG_NOT_SENT_LOWAT_KB, MAX_SIZE_KB, &notSentLowatKB)
+        || !GetUIntField(tuningObj, CONFIG_KEEP_ALIVE_IDLE_SECONDS, UINT16_MAX, &profile->keepAliveIdleSeconds)
+        || !GetUIntField(
+            tuningObj, CONFIG_KEEP_ALIVE_INTERVAL_SECONDS, UINT16_MAX, &profile->keepAliveIntervalSeconds)
+        || !GetUIntField(tuningObj, CONFIG_KEEP_ALIVE_COUNT, 127, &profile->keepAliveCount))
+    {
+        Log_Error("Invalid %s, expected non-negative sizes, times and counts.", CONFIG_SOCKET_TUNING);
+        goto done;
+    }
+
+    if (json_object_has_value(tuningObj, CONFIG_CALIBRATE))
+    {
+        if (!json_object_has_value_of_type(tuningObj, CONFIG_CALIBRATE, JSONBoolean))
+        {
+            Log_Error("Invalid %s.%s, expected a boolean.", CONFIG_SOCKET_TUNING, CONFIG_CALIBRATE);
+            goto done;
+        }
+
+        profile->calibrate = json_object_get_boolean(tuningObj, CONFIG_CALIBRATE) == 1;
+    }
+
+    if (json_object_has_value(tuningObj, CONFIG_CONGESTION_CONTROL))
+    {
+        const char* congestionControl = json_object_get_string(tuningObj, CONFIG_CONGESTION_CONTROL);
+        if (congestionControl == NULL || *congestionControl == '\0'
+            || strlen(congestionControl) >= sizeof(profile->congestionControl))
+        {
+            Log_Error("Invalid %s.%s.", CONFIG_SOCKET_TUNING, CONFIG_CONGESTION_CONTROL);
+            goto done;
+        }
+
+        memcpy(profile->congestionControl, congestionControl, strlen(congestionControl) + 1);
+    }
+
+    profile->receiveBufferBytes = receiveBufferKB * 1024;
+    profile->notSentLowatBytes = notSentLowatKB * 1024;
+    profile->enabled = true;
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(profile, 0, sizeof(*profile));
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Sets an integer socket option, logging a failure.
+ */
+static bool SetIntOption(int fd, int level, int name, const char* optionName, unsigned int value)
+{
+    const int intValue = (int)value;
+    if (setsockopt(fd, level, name, &intValue, sizeof(intValue)) != 0)
+    {
+        Log_Warn("Cannot set %s to %u, errno: %d", optionName, value, errno);
+        return false;
+    }
+
+    return true;
+}
+
+bool ADUC_SocketTuning_Apply(
+    const ADUC_SocketTuning_Profile* profile, const ADUC_SocketTuning_Calibration* calibration, int fd)
+{
+    bool succeeded = true;
+
+    if (profile == NULL || !profile->enabled)
+    {
+        return true;
+    }
+
+    unsigned int receiveBufferBytes = profile->receiveBufferBytes;
+    if (receiveBufferBytes == 0 && calibration != NULL && calibration->calibrated)
+    {
+        receiveBufferBytes = calibration->receiveBufferBytes;
+    }
+
+    if (receiveBufferBytes != 0)
+    {
+        succeeded = SetIntOption(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", receiveBufferBytes) && succeeded;
+    }
+
+    if (profile->congestionControl[0] != '\0'
+        && setsockopt(
+               fd,
+               IPPROTO_TCP,
+               TCP_CONGESTION,
+               profile->congestionControl,
+               (socklen_t)strlen(profile->congestionControl))
+            != 0)
+    {
+        // ENOENT if the kernel does not offer it, EPERM if it is not in net.ipv4.tcp_allowed_congestion_control.
+        Log_Warn("Congestion control '%s' is not available, errno: %d", profile->congestionControl, errno);
+        succeeded = false;
+    }
+
+#ifdef TCP_NOTSENT_LOWAT
+    if (profile->notSentLowatBytes != 0)
+    {
+        succeeded =
+            SetIntOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "TCP_NOTSENT_LOWAT", profile->notSentLowatBytes)
+            && succeeded;
+    }
+#endif
+
+    if (profile->keepAliveIdleSeconds != 0)
+    {
+        succeeded = SetIntOption(fd, SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", 1)
+            && SetIntOption(fd, IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", profile->keepAliveIdleSeconds)
+            && succeeded;
+
+        if (profile->keepAliveIntervalSeconds != 0)
+        {
+            succeeded =
+                SetIntOption(fd, IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL", profile->keepAliveIntervalSeconds)
+                && succeeded;
+        }
+
+        if (profile->keepAliveCount != 0)
+        {
+            succeeded =
+                SetIntOption(fd, IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", profile->keepAliveCount) && succeeded;
+        }
+    }
+
+    return succeeded;
+}
+
+unsigned int ADUC_SocketTuning_GetReceiveBufferSize(double bytesPerSecond, double rttSeconds)
+{
+    const double size = 2 * bytesPerSecond * rttSeconds;
+
+    if (!(size > ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER))
+    {
+        return ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER;
+    }
+
+    if (size > ADUC_SOCKET_TUNING_MAX_RECEIVE_BUFFER)
+    {
+        return ADUC_SOCKET_TUNING_MAX_RECEIVE_BUFFER;
+    }
+
+    return (unsigned int)size;
+}
+
+bool ADUC_SocketTuning_Calibrate(
+    const ADUC_SocketTuning_Profile* profile,
+    ADUC_SocketTuning_Calibration* calibration,
+    int fd,
+    uint64_t bytes,
+    double seconds)
+{
+    struct tcp_info info;
+    socklen_t infoLength = sizeof(info);
+
+    if (profile == NULL || !profile->enabled || !profile->calibrate || profile->receiveBufferBytes != 0
+        || calibration == NULL || calibration->calibrated || bytes < ADUC_SOCKET_TUNING_MIN_CALIBRATION_BYTES
+        || seconds <= 0)
+    {
+        return false;
+    }
+
+    memset(&info, 0, sizeof(info));
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &infoLength) != 0 || info.tcpi_rtt == 0)
+    {
+        return false;
+    }
+
+    const double bytesPerSecond = (double)bytes / seconds;
+    const double rttSeconds = info.tcpi_rtt / 1e6;
+
+    calibration->receiveBufferBytes = ADUC_SocketTuning_GetReceiveBufferSize(bytesPerSecond, rttSeconds);
+    calibration->calibrated = true;
+
+    Log_Info(
+        "Calibrated receive buffer to %u bytes from %.0f bytes/s at %.1f ms round-trip time",
+        calibration->receiveBufferBytes,
+        bytesPerSecond,
+        rttSeconds * 1000);
+
+    return true;
+}
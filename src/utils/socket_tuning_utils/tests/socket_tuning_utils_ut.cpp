@@ -0,0 +1,258 @@
+/**
+ * @file socket_tuning_utils_ut.cpp
+ * @brief Unit Tests for socket_tuning_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/socket_tuning_utils.h"
+
+#include <catch2/catch.hpp>
+using Catch::Matchers::Equals;
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <parson.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static bool ParseProfile(const char* json, ADUC_SocketTuning_Profile* profile)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool parsed = ADUC_SocketTuning_ParseProfile(profile, json_value_get_object(value));
+    json_value_free(value);
+    return parsed;
+}
+
+static int GetIntOption(int fd, int level, int name)
+{
+    int value = 0;
+    socklen_t length = sizeof(value);
+    REQUIRE(getsockopt(fd, level, name, &value, &length) == 0);
+    return value;
+}
+
+/**
+ * @brief A connected pair of loopback TCP sockets.
+ */
+class LoopbackConnection
+{
+public:
+    explicit LoopbackConnection(const ADUC_SocketTuning_Profile* profile = nullptr,
+                                const ADUC_SocketTuning_Calibration* calibration = nullptr)
+    {
+        sockaddr_in addr{};
+        socklen_t addrLength = sizeof(addr);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        const int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(listenFd != -1);
+        REQUIRE(bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        REQUIRE(listen(listenFd, 1) == 0);
+        REQUIRE(getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLength) == 0);
+
+        client = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(client != -1);
+        if (profile != nullptr)
+        {
+            ADUC_SocketTuning_Apply(profile, calibration, client);
+        }
+
+        REQUIRE(connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        server = accept(listenFd, nullptr, nullptr);
+        REQUIRE(server != -1);
+        close(listenFd);
+    }
+
+    ~LoopbackConnection()
+    {
+        close(client);
+        close(server);
+    }
+
+    LoopbackConnection(const LoopbackConnection&) = delete;
+    LoopbackConnection& operator=(const LoopbackConnection&) = delete;
+    LoopbackConnection(LoopbackConnection&&) = delete;
+    LoopbackConnection& operator=(LoopbackConnection&&) = delete;
+
+    int client = -1;
+    int server = -1;
+};
+
+TEST_CASE("ADUC_SocketTuning_ParseProfile")
+{
+    ADUC_SocketTuning_Profile profile;
+
+    SECTION("Not configured")
+    {
+        REQUIRE(ADUC_SocketTuning_ParseProfile(&profile, nullptr));
+        CHECK_FALSE(profile.enabled);
+    }
+
+    SECTION("Defaults")
+    {
+        REQUIRE(ParseProfile("{}", &profile));
+        CHECK(profile.enabled);
+        CHECK(profile.receiveBufferBytes == 0);
+        CHECK_FALSE(profile.calibrate);
+        CHECK_THAT(profile.congestionControl, Equals(""));
+        CHECK(profile.notSentLowatBytes == 0);
+        CHECK(profile.keepAliveIdleSeconds == 0);
+    }
+
+    SECTION("Full profile")
+    {
+        REQUIRE(ParseProfile(
+            R"({"receiveBufferKB":4096,"calibrate":true,"congestionControl":"bbr","notSentLowatKB":128,)"
+            R"("keepAliveIdleSeconds":60,"keepAliveIntervalSeconds":10,"keepAliveCount":6})",
+            &profile));
+        CHECK(profile.enabled);
+        CHECK(profile.receiveBufferBytes == 4096 * 1024);
+        CHECK(profile.calibrate);
+        CHECK_THAT(profile.congestionControl, Equals("bbr"));
+        CHECK(profile.notSentLowatBytes == 128 * 1024);
+        CHECK(profile.keepAliveIdleSeconds == 60);
+        CHECK(profile.keepAliveIntervalSeconds == 10);
+        CHECK(profile.keepAliveCount == 6);
+    }
+
+    SECTION("Invalid profiles")
+    {
+        CHECK_FALSE(ParseProfile(R"({"receiveBufferKB":-1})", &profile));
+        CHECK_FALSE(profile.enabled);
+        CHECK_FALSE(ParseProfile(R"({"receiveBufferKB":"4M"})", &profile));
+        CHECK_FALSE(ParseProfile(R"({"calibrate":1})", &profile));
+        CHECK_FALSE(ParseProfile(R"({"congestionControl":""})", &profile));
+        CHECK_FALSE(ParseProfile(R"({"congestionControl":"a-very-long-algorithm"})", &profile));
+        CHECK_FALSE(ParseProfile(R"({"keepAliveCount":1000})", &profile));
+    }
+}
+
+TEST_CASE("ADUC_SocketTuning_Apply")
+{
+    ADUC_SocketTuning_Profile profile;
+
+    SECTION("Configured options are set")
+    {
+        REQUIRE(ParseProfile(
+            R"({"receiveBufferKB":256,"congestionControl":"reno","notSentLowatKB":64,)"
+            R"("keepAliveIdleSeconds":60,"keepAliveIntervalSeconds":10,"keepAliveCount":6})",
+            &profile));
+
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(fd != -1);
+        CHECK(ADUC_SocketTuning_Apply(&profile, nullptr, fd));
+
+        // The kernel doubles the requested size for its bookkeeping.
+        CHECK(GetIntOption(fd, SOL_SOCKET, SO_RCVBUF) >= 256 * 1024);
+        CHECK(GetIntOption(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT) == 64 * 1024);
+        CHECK(GetIntOption(fd, SOL_SOCKET, SO_KEEPALIVE) == 1);
+        CHECK(GetIntOption(fd, IPPROTO_TCP, TCP_KEEPIDLE) == 60);
+        CHECK(GetIntOption(fd, IPPROTO_TCP, TCP_KEEPINTVL) == 10);
+        CHECK(GetIntOption(fd, IPPROTO_TCP, TCP_KEEPCNT) == 6);
+
+        char congestionControl[16] = {};
+        socklen_t length = sizeof(congestionControl);
+        REQUIRE(getsockopt(fd, IPPROTO_TCP, TCP_CONGESTION, congestionControl, &length) == 0);
+        CHECK_THAT(congestionControl, Equals("reno"));
+        close(fd);
+    }
+
+    SECTION("Unavailable congestion control leaves the socket usable")
+    {
+        REQUIRE(ParseProfile(R"({"congestionControl":"nonexistent","keepAliveIdleSeconds":30})", &profile));
+
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(fd != -1);
+        CHECK_FALSE(ADUC_SocketTuning_Apply(&profile, nullptr, fd));
+        CHECK(GetIntOption(fd, IPPROTO_TCP, TCP_KEEPIDLE) == 30);
+        close(fd);
+    }
+
+    SECTION("Calibrated receive buffer")
+    {
+        REQUIRE(ParseProfile(R"({"calibrate":true})", &profile));
+        ADUC_SocketTuning_Calibration calibration{ true, 1024 * 1024 };
+
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(fd != -1);
+        const int defaultSize = GetIntOption(fd, SOL_SOCKET, SO_RCVBUF);
+        CHECK(ADUC_SocketTuning_Apply(&profile, &calibration, fd));
+        CHECK(GetIntOption(fd, SOL_SOCKET, SO_RCVBUF) != defaultSize);
+        close(fd);
+    }
+}
+
+TEST_CASE("ADUC_SocketTuning_GetReceiveBufferSize")
+{
+    // 10 MB/s at 600 ms, a satellite link.
+    CHECK(ADUC_SocketTuning_GetReceiveBufferSize(10e6, 0.6) == 12000000);
+    CHECK(ADUC_SocketTuning_GetReceiveBufferSize(1e6, 0.001) == ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER);
+    CHECK(ADUC_SocketTuning_GetReceiveBufferSize(100e6, 0.6) == ADUC_SOCKET_TUNING_MAX_RECEIVE_BUFFER);
+    CHECK(ADUC_SocketTuning_GetReceiveBufferSize(0, 0) == ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER);
+}
+
+TEST_CASE("ADUC_SocketTuning_Calibrate")
+{
+    ADUC_SocketTuning_Profile profile;
+    ADUC_SocketTuning_Calibration calibration{};
+    REQUIRE(ParseProfile(R"({"calibrate":true})", &profile));
+
+    LoopbackConnection connection{ &profile, &calibration };
+    const size_t size = 2 * ADUC_SOCKET_TUNING_MIN_CALIBRATION_BYTES;
+
+    std::thread sender{ [&] {
+        std::vector<char> data(size, 'x');
+        for (size_t sent = 0; sent < size;)
+        {
+            const ssize_t result = send(connection.server, data.data() + sent, size - sent, 0);
+            if (result <= 0)
+            {
+                break;
+            }
+
+            sent += static_cast<size_t>(result);
+        }
+    } };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<char> buffer(64 * 1024);
+    size_t received = 0;
+    while (received < size)
+    {
+        const ssize_t result = recv(connection.client, buffer.data(), buffer.size(), 0);
+        REQUIRE(result > 0);
+        received += static_cast<size_t>(result);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sender.join();
+
+    SECTION("Small transfers are not measured")
+    {
+        CHECK_FALSE(ADUC_SocketTuning_Calibrate(&profile, &calibration, connection.client, 1000, seconds));
+        CHECK_FALSE(calibration.calibrated);
+    }
+
+    SECTION("The first transfer calibrates")
+    {
+        REQUIRE(ADUC_SocketTuning_Calibrate(&profile, &calibration, connection.client, received, seconds));
+        CHECK(calibration.calibrated);
+        CHECK(calibration.receiveBufferBytes >= ADUC_SOCKET_TUNING_MIN_RECEIVE_BUFFER);
+        CHECK(calibration.receiveBufferBytes <= ADUC_SOCKET_TUNING_MAX_RECEIVE_BUFFER);
+
+        CHECK_FALSE(ADUC_SocketTuning_Calibrate(&profile, &calibration, connection.client, received, seconds));
+    }
+
+    SECTION("A fixed receive buffer is not calibrated")
+    {
+        profile.receiveBufferBytes = 1024 * 1024;
+        CHECK_FALSE(ADUC_SocketTuning_Calibrate(&profile, &calibration, connection.client, received, seconds));
+    }
+}
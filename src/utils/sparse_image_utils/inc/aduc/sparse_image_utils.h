@@ -0,0 +1,46 @@
+/**
+ * @file sparse_image_utils.h
+ * @brief Android sparse image payloads.
+ *
+ * A sparse image is a header followed by chunks of raw blocks, fill blocks, or blocks that are not written.
+ * Expanding one produces the raw image as a sparse file, with holes for the unwritten and zero blocks,
+ * so that mostly empty file system images take little disk space and I/O.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_SPARSE_IMAGE_UTILS_H
+#define ADUC_SPARSE_IMAGE_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief The magic number at the start of a sparse image.
+ */
+#define ADUC_SPARSE_IMAGE_MAGIC 0xed26ff3aU
+
+/**
+ * @brief Checks whether the file at @p path is a sparse image.
+ *
+ * @param path The file path.
+ * @return bool true if the file starts with a sparse image header of a supported version.
+ */
+bool ADUC_SparseImage_IsSparseImage(const char* path);
+
+/**
+ * @brief Expands the sparse image at @p imagePath into the raw image at @p rawPath.
+ *
+ * @param imagePath The sparse image.
+ * @param rawPath The raw image to create. Replaced if it exists, and removed on failure.
+ * @param[out] rawSize The size of the raw image. May be NULL.
+ * @return bool true on success.
+ */
+bool ADUC_SparseImage_Expand(const char* imagePath, const char* rawPath, uint64_t* rawSize);
+
+EXTERN_C_END
+
+#endif // ADUC_SPARSE_IMAGE_UTILS_H
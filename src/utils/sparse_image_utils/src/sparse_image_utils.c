@@ -0,0 +1,300 @@
+/**
+ * @file sparse_image_utils.c
+ * @brief Implements expanding Android sparse image payloads.
+ *
+ * The format, all little-endian:
+ *
+ *   header: magic u32 | major u16 | minor u16 | fileHeaderSize u16 | chunkHeaderSize u16 | blockSize u32 |
+ *           totalBlocks u32 | totalChunks u32 | checksum u32
+ *   chunk:  type u16 | reserved u16 | chunkBlocks u32 | totalSize u32 | data
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/sparse_image_utils.h"
+#include "aduc/logging.h"
+#include "aduc/system_utils.h" // ADUC_SystemUtils_WriteSparse
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h> // PRIu64
+#include <stdio.h> // remove
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+#define SPARSE_HEADER_SIZE 28
+#define CHUNK_HEADER_SIZE 12
+#define SUPPORTED_MAJOR_VERSION 1
+
+#define CHUNK_TYPE_RAW 0xcac1
+#define CHUNK_TYPE_FILL 0xcac2
+#define CHUNK_TYPE_DONT_CARE 0xcac3
+#define CHUNK_TYPE_CRC32 0xcac4
+
+/**
+ * @brief Size of the copy buffer. A multiple of 4, so that it holds whole fill patterns.
+ */
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+/**
+ * @brief The fields of the sparse image header that expanding needs.
+ */
+typedef struct tagADUC_SparseImage_Header
+{
+    uint16_t fileHeaderSize; /**< Size of the file header. Larger than SPARSE_HEADER_SIZE in newer minor versions. */
+    uint16_t chunkHeaderSize; /**< Size of the chunk headers. */
+    uint32_t blockSize; /**< Size of a block. */
+    uint32_t totalBlocks; /**< Blocks of the raw image. */
+    uint32_t totalChunks; /**< Chunks in the image. */
+} ADUC_SparseImage_Header;
+
+static uint16_t GetLE16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t GetLE32(const uint8_t* p)
+{
+    return (uint32_t)GetLE16(p) | ((uint32_t)GetLE16(p + 2) << 16);
+}
+
+/**
+ * @brief Reads exactly @p length bytes at @p offset.
+ */
+static bool ReadExact(int fd, void* buffer, size_t length, off_t offset)
+{
+    uint8_t* data = (uint8_t*)buffer;
+    while (length > 0)
+    {
+        const ssize_t readSize = pread(fd, data, length, offset);
+        if (readSize < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (readSize <= 0)
+        {
+            return false;
+        }
+
+        data += readSize;
+        length -= (size_t)readSize;
+        offset += readSize;
+    }
+
+    return true;
+}
+
+static bool ReadHeader(int fd, ADUC_SparseImage_Header* header)
+{
+    uint8_t buffer[SPARSE_HEADER_SIZE];
+
+    if (!ReadExact(fd, buffer, sizeof(buffer), 0) || GetLE32(buffer) != ADUC_SPARSE_IMAGE_MAGIC
+        || GetLE16(buffer + 4) != SUPPORTED_MAJOR_VERSION)
+    {
+        return false;
+    }
+
+    header->fileHeaderSize = GetLE16(buffer + 8);
+    header->chunkHeaderSize = GetLE16(buffer + 10);
+    header->blockSize = GetLE32(buffer + 12);
+    header->totalBlocks = GetLE32(buffer + 16);
+    header->totalChunks = GetLE32(buffer + 20);
+
+    return header->fileHeaderSize >= SPARSE_HEADER_SIZE && header->chunkHeaderSize >= CHUNK_HEADER_SIZE
+        && header->blockSize > 0 && header->blockSize % 4 == 0;
+}
+
+bool ADUC_SparseImage_IsSparseImage(const char* path)
+{
+    ADUC_SparseImage_Header header;
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    const bool isSparseImage = ReadHeader(fd, &header);
+    close(fd);
+    return isSparseImage;
+}
+
+/**
+ * @brief Copies the data of a raw chunk, leaving its zero blocks as holes.
+ */
+static bool CopyRawChunk(int imageFd, off_t imageOffset, int rawFd, off_t rawOffset, uint64_t length, uint8_t* buffer)
+{
+    for (uint64_t copied = 0; copied < length;)
+    {
+        const size_t chunk = length - copied < COPY_BUFFER_SIZE ? (size_t)(length - copied) : COPY_BUFFER_SIZE;
+        if (!ReadExact(imageFd, buffer, chunk, imageOffset + (off_t)copied)
+            || ADUC_SystemUtils_WriteSparse(rawFd, buffer, chunk, rawOffset + (off_t)copied, false /* punchHoles */)
+                != 0)
+        {
+            return false;
+        }
+
+        copied += chunk;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes a fill chunk. A zero fill is left as a hole.
+ */
+static bool WriteFillChunk(int rawFd, off_t rawOffset, uint64_t length, const uint8_t pattern[4], uint8_t* buffer)
+{
+    if (GetLE32(pattern) == 0)
+    {
+        return true;
+    }
+
+    for (size_t i = 0; i < COPY_BUFFER_SIZE; i += 4)
+    {
+        memcpy(buffer + i, pattern, 4);
+    }
+
+    for (uint64_t written = 0; written < length;)
+    {
+        const size_t chunk = length - written < COPY_BUFFER_SIZE ? (size_t)(length - written) : COPY_BUFFER_SIZE;
+        if (ADUC_SystemUtils_WriteSparse(rawFd, buffer, chunk, rawOffset + (off_t)written, false /* punchHoles */)
+            != 0)
+        {
+            return false;
+        }
+
+        written += chunk;
+    }
+
+    return true;
+}
+
+bool ADUC_SparseImage_Expand(const char* imagePath, const char* rawPath, uint64_t* rawSize)
+{
+    bool succeeded = false;
+    int imageFd = -1;
+    int rawFd = -1;
+    uint8_t* buffer = NULL;
+    ADUC_SparseImage_Header header;
+    uint64_t blocks = 0;
+
+    imageFd = open(imagePath, O_RDONLY | O_CLOEXEC);
+    if (imageFd == -1 || !ReadHeader(imageFd, &header))
+    {
+        Log_Error("'%s' is not a supported sparse image, errno: %d", imagePath, errno);
+        goto done;
+    }
+
+    rawFd = open(rawPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+    buffer = malloc(COPY_BUFFER_SIZE);
+    if (rawFd == -1 || buffer == NULL)
+    {
+        Log_Error("Cannot create '%s', errno: %d", rawPath, errno);
+        goto done;
+    }
+
+    off_t imageOffset = header.fileHeaderSize;
+    for (uint32_t chunkIndex = 0; chunkIndex < header.totalChunks; ++chunkIndex)
+    {
+        uint8_t chunkHeader[CHUNK_HEADER_SIZE];
+        uint8_t pattern[4];
+
+        if (!ReadExact(imageFd, chunkHeader, sizeof(chunkHeader), imageOffset))
+        {
+            Log_Error("Sparse image '%s' is truncated at chunk %u", imagePath, chunkIndex);
+            goto done;
+        }
+
+        const uint16_t type = GetLE16(chunkHeader);
+        const uint32_t chunkBlocks = GetLE32(chunkHeader + 4);
+        const uint32_t totalSize = GetLE32(chunkHeader + 8);
+        const uint64_t length = (uint64_t)chunkBlocks * header.blockSize;
+        const off_t rawOffset = (off_t)(blocks * header.blockSize);
+        const uint64_t dataSize = totalSize >= header.chunkHeaderSize ? totalSize - header.chunkHeaderSize : UINT64_MAX;
+
+        imageOffset += header.chunkHeaderSize;
+
+        bool valid = blocks + chunkBlocks <= header.totalBlocks;
+        switch (type)
+        {
+        case CHUNK_TYPE_RAW:
+            valid = valid && dataSize == length
+                && CopyRawChunk(imageFd, imageOffset, rawFd, rawOffset, length, buffer);
+            break;
+
+        case CHUNK_TYPE_FILL:
+            valid = valid && dataSize == sizeof(pattern) && ReadExact(imageFd, pattern, sizeof(pattern), imageOffset)
+                && WriteFillChunk(rawFd, rawOffset, length, pattern, buffer);
+            break;
+
+        case CHUNK_TYPE_DONT_CARE:
+            valid = valid && dataSize == 0;
+            break;
+
+        case CHUNK_TYPE_CRC32:
+            // The payload hash already covers the image, so the checksum is not verified.
+            valid = valid && dataSize == 4 && chunkBlocks == 0;
+            break;
+
+        default:
+            valid = false;
+            break;
+        }
+
+        if (!valid)
+        {
+            Log_Error("Invalid chunk %u of type 0x%x in sparse image '%s'", chunkIndex, type, imagePath);
+            goto done;
+        }
+
+        imageOffset += (off_t)dataSize;
+        blocks += chunkBlocks;
+    }
+
+    if (blocks != header.totalBlocks)
+    {
+        Log_Error("Sparse image '%s' has %" PRIu64 " of %u blocks", imagePath, blocks, header.totalBlocks);
+        goto done;
+    }
+
+    // Trailing holes do not extend the file.
+    if (ftruncate(rawFd, (off_t)(blocks * header.blockSize)) != 0)
+    {
+        Log_Error("Cannot set the size of '%s', errno: %d", rawPath, errno);
+        goto done;
+    }
+
+    if (rawSize != NULL)
+    {
+        *rawSize = blocks * header.blockSize;
+    }
+
+    Log_Info("Expanded sparse image '%s' to '%s', %" PRIu64 " bytes", imagePath, rawPath, blocks * header.blockSize);
+    succeeded = true;
+
+done:
+    free(buffer);
+
+    if (imageFd != -1)
+    {
+        close(imageFd);
+    }
+
+    if (rawFd != -1 && close(rawFd) != 0)
+    {
+        succeeded = false;
+    }
+
+    if (!succeeded && rawFd != -1)
+    {
+        remove(rawPath);
+    }
+
+    return succeeded;
+}
@@ -0,0 +1,246 @@
+/**
+ * @file sparse_image_utils_ut.cpp
+ * @brief Unit Tests for sparse_image_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/sparse_image_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h> // access
+#include <vector>
+
+#define TEST_DIR "/tmp/adutest/sparse_image_utils_ut"
+
+static const uint32_t BLOCK_SIZE = 4096;
+
+/**
+ * @brief Builds a sparse image, and the raw image it expands to.
+ */
+class SparseImageBuilder
+{
+public:
+    void AddRaw(uint32_t blocks, uint8_t seed)
+    {
+        std::vector<uint8_t> data(blocks * BLOCK_SIZE);
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            data[i] = static_cast<uint8_t>(seed + i * 7);
+        }
+
+        AddChunk(0xcac1, blocks, data);
+        _raw.insert(_raw.end(), data.begin(), data.end());
+    }
+
+    void AddZeroRaw(uint32_t blocks)
+    {
+        std::vector<uint8_t> data(blocks * BLOCK_SIZE);
+        AddChunk(0xcac1, blocks, data);
+        _raw.insert(_raw.end(), data.begin(), data.end());
+    }
+
+    void AddFill(uint32_t blocks, uint32_t value)
+    {
+        std::vector<uint8_t> pattern;
+        PutLE32(pattern, value);
+        AddChunk(0xcac2, blocks, pattern);
+
+        for (size_t i = 0; i < blocks * BLOCK_SIZE / 4; ++i)
+        {
+            _raw.insert(_raw.end(), pattern.begin(), pattern.end());
+        }
+    }
+
+    void AddDontCare(uint32_t blocks)
+    {
+        AddChunk(0xcac3, blocks, {});
+        _raw.resize(_raw.size() + blocks * BLOCK_SIZE);
+    }
+
+    void AddCrc32()
+    {
+        AddChunk(0xcac4, 0, { 1, 2, 3, 4 });
+    }
+
+    std::string Image(uint32_t extraBlocks = 0) const
+    {
+        std::vector<uint8_t> image;
+        PutLE32(image, ADUC_SPARSE_IMAGE_MAGIC);
+        PutLE16(image, 1); // major
+        PutLE16(image, 0); // minor
+        PutLE16(image, 28); // fileHeaderSize
+        PutLE16(image, 12); // chunkHeaderSize
+        PutLE32(image, BLOCK_SIZE);
+        PutLE32(image, _blocks + extraBlocks);
+        PutLE32(image, _chunks);
+        PutLE32(image, 0); // checksum
+        image.insert(image.end(), _chunkData.begin(), _chunkData.end());
+        return std::string{ image.begin(), image.end() };
+    }
+
+    std::string Raw() const
+    {
+        return std::string{ _raw.begin(), _raw.end() };
+    }
+
+private:
+    static void PutLE16(std::vector<uint8_t>& out, uint16_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    static void PutLE32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        PutLE16(out, static_cast<uint16_t>(value));
+        PutLE16(out, static_cast<uint16_t>(value >> 16));
+    }
+
+    void AddChunk(uint16_t type, uint32_t blocks, const std::vector<uint8_t>& data)
+    {
+        PutLE16(_chunkData, type);
+        PutLE16(_chunkData, 0);
+        PutLE32(_chunkData, blocks);
+        PutLE32(_chunkData, static_cast<uint32_t>(12 + data.size()));
+        _chunkData.insert(_chunkData.end(), data.begin(), data.end());
+        _blocks += blocks;
+        ++_chunks;
+    }
+
+    std::vector<uint8_t> _chunkData;
+    std::vector<uint8_t> _raw;
+    uint32_t _blocks = 0;
+    uint32_t _chunks = 0;
+};
+
+class TestFolder
+{
+public:
+    TestFolder() : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+    }
+
+    TestFolder(const TestFolder&) = delete;
+    TestFolder& operator=(const TestFolder&) = delete;
+    TestFolder(TestFolder&&) = delete;
+    TestFolder& operator=(TestFolder&&) = delete;
+
+    std::string Image() const
+    {
+        return _dir.GetDir() + "/image.simg";
+    }
+
+    std::string Raw() const
+    {
+        return _dir.GetDir() + "/image.raw";
+    }
+
+    void WriteImage(const std::string& content) const
+    {
+        std::ofstream{ Image(), std::ios::binary } << content;
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+};
+
+static std::string ReadFile(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+static uint64_t AllocatedBytes(const std::string& path)
+{
+    struct stat st;
+    REQUIRE(stat(path.c_str(), &st) == 0);
+    return static_cast<uint64_t>(st.st_blocks) * 512;
+}
+
+TEST_CASE("ADUC_SparseImage_IsSparseImage")
+{
+    TestFolder folder;
+
+    SECTION("Sparse image")
+    {
+        SparseImageBuilder builder;
+        builder.AddRaw(1, 1);
+        folder.WriteImage(builder.Image());
+        CHECK(ADUC_SparseImage_IsSparseImage(folder.Image().c_str()));
+    }
+
+    SECTION("Raw image")
+    {
+        folder.WriteImage(std::string(BLOCK_SIZE, 'x'));
+        CHECK_FALSE(ADUC_SparseImage_IsSparseImage(folder.Image().c_str()));
+    }
+
+    SECTION("Missing file")
+    {
+        CHECK_FALSE(ADUC_SparseImage_IsSparseImage(folder.Image().c_str()));
+    }
+}
+
+TEST_CASE("ADUC_SparseImage_Expand")
+{
+    TestFolder folder;
+    SparseImageBuilder builder;
+    uint64_t rawSize = 0;
+
+    SECTION("All chunk types")
+    {
+        builder.AddRaw(3, 1);
+        builder.AddDontCare(256);
+        builder.AddFill(2, 0xdeadbeef);
+        builder.AddCrc32();
+        builder.AddFill(256, 0);
+        builder.AddZeroRaw(64);
+        builder.AddRaw(1, 2);
+        builder.AddDontCare(512);
+        folder.WriteImage(builder.Image());
+
+        REQUIRE(ADUC_SparseImage_Expand(folder.Image().c_str(), folder.Raw().c_str(), &rawSize));
+        CHECK(rawSize == builder.Raw().size());
+        CHECK(ReadFile(folder.Raw()) == builder.Raw());
+
+        // Only the 6 blocks of data are allocated, give or take file system metadata.
+        CHECK(AllocatedBytes(folder.Raw()) < 64 * BLOCK_SIZE);
+    }
+
+    SECTION("Block count mismatch fails")
+    {
+        builder.AddRaw(2, 1);
+        folder.WriteImage(builder.Image(1));
+
+        CHECK_FALSE(ADUC_SparseImage_Expand(folder.Image().c_str(), folder.Raw().c_str(), &rawSize));
+        CHECK(access(folder.Raw().c_str(), F_OK) != 0);
+    }
+
+    SECTION("Truncated image fails")
+    {
+        builder.AddRaw(2, 1);
+        const std::string image = builder.Image();
+        folder.WriteImage(image.substr(0, image.size() - 100));
+
+        CHECK_FALSE(ADUC_SparseImage_Expand(folder.Image().c_str(), folder.Raw().c_str(), &rawSize));
+        CHECK(access(folder.Raw().c_str(), F_OK) != 0);
+    }
+
+    SECTION("Raw image fails")
+    {
+        folder.WriteImage(std::string(BLOCK_SIZE, 'x'));
+
+        CHECK_FALSE(ADUC_SparseImage_Expand(folder.Image().c_str(), folder.Raw().c_str(), &rawSize));
+        CHECK(access(folder.Raw().c_str(), F_OK) != 0);
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * @file startup_report_utils.h
+ * @brief Skips the sections of the startup report that the hub already acknowledged.
+ *
+ * The agent reports its device properties and compatibility property names on every connect.
+ * A digest of each section of the last acknowledged report is kept in the data folder, and
+ * sections with an unchanged digest are left out of the next report. A full report is still
+ * sent once the refresh interval has passed since the last full one, and when the device connects
+ * to another hub or with another identity, e.g. after it was reprovisioned.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_STARTUP_REPORT_UTILS_H
+#define ADUC_STARTUP_REPORT_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <parson.h>
+#include <stdbool.h>
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Name of the file in the data folder that records the last acknowledged startup report.
+ */
+#define ADUC_STARTUP_REPORT_STATE_FILE "startup_report.json"
+
+/**
+ * @brief Interval after which the full startup report is sent again, even if nothing changed.
+ */
+#define ADUC_STARTUP_REPORT_REFRESH_SECONDS (24 * 60 * 60)
+
+/**
+ * @brief The hub identity a startup report is sent with.
+ */
+typedef struct tagADUC_StartupReport_Identity
+{
+    const char* hostName; /**< The host name of the hub. */
+    const char* deviceId; /**< The device id. */
+    const char* moduleId; /**< The module id, or NULL for a device identity. */
+} ADUC_StartupReport_Identity;
+
+/**
+ * @brief A startup report on its way to the hub.
+ */
+typedef struct tagADUC_StartupReport
+{
+    char* stateFilePath; /**< The file that records the last acknowledged report. NULL if it is not recorded. */
+
+    JSON_Value* digests; /**< Digest of each section of the startup message, recorded on acknowledgement. */
+
+    JSON_Value* identity; /**< The hub identity of the report, recorded on acknowledgement. */
+
+    time_t lastFullReportTime; /**< Time of the last full report, this one included if it is full. */
+} ADUC_StartupReport;
+
+/**
+ * @brief Removes the sections of @p startupMsgObj that are unchanged since the last acknowledged report.
+ * @details Sections that were reported before but are no longer part of the message are set to null,
+ * so that they are removed from the twin. Nothing is removed if there is no record of an acknowledged
+ * report, if the report was acknowledged by another hub or identity than @p identity, or if
+ * @p refreshIntervalSeconds have passed since the last full report.
+ *
+ * @param[out] report The report to initialize. Call ADUC_StartupReport_Uninit to free it.
+ * @param dataFolder The agent data folder. NULL disables the record, so every report is full.
+ * @param identity The hub identity the report is sent with. NULL if it is unknown, so every report is full.
+ * @param startupMsgObj The startup message.
+ * @param now The current time.
+ * @param refreshIntervalSeconds The interval after which the full report is sent again.
+ * @return true if @p startupMsgObj still has something to report.
+ */
+bool ADUC_StartupReport_Prepare(
+    ADUC_StartupReport* report,
+    const char* dataFolder,
+    const ADUC_StartupReport_Identity* identity,
+    JSON_Object* startupMsgObj,
+    time_t now,
+    time_t refreshIntervalSeconds);
+
+/**
+ * @brief Records @p report as acknowledged by the hub.
+ *
+ * @param report The report prepared with ADUC_StartupReport_Prepare.
+ * @return true on success.
+ */
+bool ADUC_StartupReport_Acknowledge(const ADUC_StartupReport* report);
+
+/**
+ * @brief Frees the members of @p report.
+ *
+ * @param report The report.
+ */
+void ADUC_StartupReport_Uninit(ADUC_StartupReport* report);
+
+EXTERN_C_END
+
+#endif // ADUC_STARTUP_REPORT_UTILS_H
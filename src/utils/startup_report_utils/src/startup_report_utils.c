@@ -0,0 +1,245 @@
+/**
+ * @file startup_report_utils.c
+ * @brief Implements the record of acknowledged startup reports.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/startup_report_utils.h"
+#include "aduc/hash_utils.h" // ADUC_HashUtils_GetJsonValueHash
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_StringFormat, IsNullOrEmpty
+
+#include <errno.h>
+#include <stdio.h> // rename, remove
+#include <stdlib.h>
+#include <string.h>
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+static const char* STATE_SECTIONS = "sections";
+static const char* STATE_LAST_FULL_REPORT_TIME = "lastFullReportTime";
+static const char* STATE_IDENTITY = "identity";
+static const char* IDENTITY_HOST_NAME = "hostName";
+static const char* IDENTITY_DEVICE_ID = "deviceId";
+static const char* IDENTITY_MODULE_ID = "moduleId";
+
+/**
+ * @brief Sets @p name of @p identityObj to @p value, unless @p value is NULL.
+ *
+ * @return true on success.
+ */
+static bool SetIdentityValue(JSON_Object* identityObj, const char* name, const char* value)
+{
+    return value == NULL || json_object_set_string(identityObj, name, value) == JSONSuccess;
+}
+
+/**
+ * @brief Checks whether the identity of a recorded report is @p identityObj.
+ *
+ * @param recordedObj The recorded identity, or NULL if none is recorded.
+ * @param identityObj The identity of the report.
+ * @return true if all values are the same.
+ */
+static bool IsSameIdentity(const JSON_Object* recordedObj, const JSON_Object* identityObj)
+{
+    const char* names[] = { IDENTITY_HOST_NAME, IDENTITY_DEVICE_ID, IDENTITY_MODULE_ID };
+
+    if (recordedObj == NULL || json_object_get_count(identityObj) == 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        const char* recorded = json_object_get_string(recordedObj, names[i]);
+        const char* value = json_object_get_string(identityObj, names[i]);
+
+        if ((recorded == NULL) != (value == NULL) || (recorded != NULL && strcmp(recorded, value) != 0))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ADUC_StartupReport_Prepare(
+    ADUC_StartupReport* report,
+    const char* dataFolder,
+    const ADUC_StartupReport_Identity* identity,
+    JSON_Object* startupMsgObj,
+    time_t now,
+    time_t refreshIntervalSeconds)
+{
+    JSON_Value* stateValue = NULL;
+    const JSON_Object* ackedObj = NULL;
+    JSON_Object* digestsObj = NULL;
+    JSON_Object* identityObj = NULL;
+    time_t lastFullReportTime = 0;
+    bool isFull = true;
+
+    memset(report, 0, sizeof(*report));
+
+    report->digests = json_value_init_object();
+    digestsObj = json_value_get_object(report->digests);
+    report->identity = json_value_init_object();
+    identityObj = json_value_get_object(report->identity);
+    if (digestsObj == NULL || identityObj == NULL)
+    {
+        // Without digests nothing can be recorded, so the report is sent in full.
+        goto done;
+    }
+
+    if (identity != NULL
+        && (!SetIdentityValue(identityObj, IDENTITY_HOST_NAME, identity->hostName)
+            || !SetIdentityValue(identityObj, IDENTITY_DEVICE_ID, identity->deviceId)
+            || !SetIdentityValue(identityObj, IDENTITY_MODULE_ID, identity->moduleId)))
+    {
+        goto done;
+    }
+
+    if (!IsNullOrEmpty(dataFolder))
+    {
+        report->stateFilePath = ADUC_StringFormat("%s/%s", dataFolder, ADUC_STARTUP_REPORT_STATE_FILE);
+    }
+
+    if (report->stateFilePath != NULL)
+    {
+        stateValue = json_parse_file(report->stateFilePath);
+    }
+
+    const JSON_Object* stateObj = json_value_get_object(stateValue);
+    ackedObj = json_object_get_object(stateObj, STATE_SECTIONS);
+    lastFullReportTime = (time_t)json_object_get_number(stateObj, STATE_LAST_FULL_REPORT_TIME);
+
+    if (ackedObj != NULL && !IsSameIdentity(json_object_get_object(stateObj, STATE_IDENTITY), identityObj))
+    {
+        // The twin of another hub or identity has none of the acknowledged sections, so there is nothing to skip,
+        // and nothing to remove from it either.
+        Log_Info("Startup message was acknowledged with another hub identity. Reporting it in full.");
+        ackedObj = NULL;
+    }
+
+    // A clock that went backwards also forces a full report.
+    isFull = ackedObj == NULL || now < lastFullReportTime || now - lastFullReportTime >= refreshIntervalSeconds;
+
+    // Walk backwards, so that removing a section does not move the ones still to be visited.
+    for (size_t i = json_object_get_count(startupMsgObj); i > 0; i--)
+    {
+        const char* name = json_object_get_name(startupMsgObj, i - 1);
+        char* digest = NULL;
+
+        if (!ADUC_HashUtils_GetJsonValueHash(json_object_get_value_at(startupMsgObj, i - 1), SHA256, &digest))
+        {
+            Log_Warn("Cannot compute digest of startup message section '%s'. Reporting it.", name);
+            continue;
+        }
+
+        const char* ackedDigest = json_object_get_string(ackedObj, name);
+        const bool isUnchanged = ackedDigest != NULL && strcmp(ackedDigest, digest) == 0;
+
+        const JSON_Status status = json_object_set_string(digestsObj, name, digest);
+        free(digest);
+
+        if (status == JSONSuccess && isUnchanged && !isFull)
+        {
+            Log_Debug("Startup message section '%s' is unchanged. Skipping.", name);
+            json_object_remove(startupMsgObj, name);
+        }
+    }
+
+    // Sections that are no longer reported are removed from the twin.
+    for (size_t i = 0; i < json_object_get_count(ackedObj); i++)
+    {
+        const char* name = json_object_get_name(ackedObj, i);
+
+        if (!json_object_has_value(digestsObj, name) && !json_object_has_value(startupMsgObj, name))
+        {
+            (void)json_object_set_null(startupMsgObj, name);
+        }
+    }
+
+done:
+    report->lastFullReportTime = isFull ? now : lastFullReportTime;
+    json_value_free(stateValue);
+
+    return json_object_get_count(startupMsgObj) > 0;
+}
+
+bool ADUC_StartupReport_Acknowledge(const ADUC_StartupReport* report)
+{
+    bool succeeded = false;
+    char* tempPath = NULL;
+    JSON_Value* stateValue = json_value_init_object();
+    JSON_Object* stateObj = json_value_get_object(stateValue);
+    JSON_Value* sectionsValue = NULL;
+    JSON_Value* identityValue = NULL;
+
+    if (report->stateFilePath == NULL || report->digests == NULL || report->identity == NULL || stateObj == NULL)
+    {
+        goto done;
+    }
+
+    sectionsValue = json_value_deep_copy(report->digests);
+    if (sectionsValue == NULL || json_object_set_value(stateObj, STATE_SECTIONS, sectionsValue) != JSONSuccess)
+    {
+        json_value_free(sectionsValue);
+        goto done;
+    }
+
+    identityValue = json_value_deep_copy(report->identity);
+    if (identityValue == NULL || json_object_set_value(stateObj, STATE_IDENTITY, identityValue) != JSONSuccess)
+    {
+        json_value_free(identityValue);
+        goto done;
+    }
+
+    if (json_object_set_number(stateObj, STATE_LAST_FULL_REPORT_TIME, (double)report->lastFullReportTime)
+        != JSONSuccess)
+    {
+        goto done;
+    }
+
+    tempPath = ADUC_StringFormat("%s.tmp", report->stateFilePath);
+    if (tempPath == NULL)
+    {
+        goto done;
+    }
+
+    // Write and rename, so that an interrupted write never leaves a partial record behind.
+    if (json_serialize_to_file(stateValue, tempPath) != JSONSuccess)
+    {
+        Log_Error("Could not write %s", tempPath);
+        goto done;
+    }
+
+    if (rename(tempPath, report->stateFilePath) != 0)
+    {
+        Log_Error("Could not rename %s, errno = %d", tempPath, errno);
+        (void)remove(tempPath);
+        goto done;
+    }
+
+    succeeded = true;
+
+done:
+    json_value_free(stateValue);
+    free(tempPath);
+
+    return succeeded;
+}
+
+void ADUC_StartupReport_Uninit(ADUC_StartupReport* report)
+{
+    if (report == NULL)
+    {
+        return;
+    }
+
+    free(report->stateFilePath);
+    json_value_free(report->digests);
+    json_value_free(report->identity);
+    memset(report, 0, sizeof(*report));
+}
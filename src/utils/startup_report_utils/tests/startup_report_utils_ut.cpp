@@ -0,0 +1,223 @@
+/**
+ * @file startup_report_utils_ut.cpp
+ * @brief Unit Tests for startup_report_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/startup_report_utils.h"
+
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <parson.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char* STARTUP_MSG = R"({"deviceProperties":{"manufacturer":"contoso","model":"toaster","aduVer":"1.0"},)"
+                                 R"("compatPropertyNames":"manufacturer,model"})";
+
+static const char* UPDATED_STARTUP_MSG =
+    R"({"deviceProperties":{"manufacturer":"contoso","model":"toaster","aduVer":"1.1"},)"
+    R"("compatPropertyNames":"manufacturer,model"})";
+
+static const char* DEVICE_PROPERTIES_ONLY_MSG =
+    R"({"deviceProperties":{"manufacturer":"contoso","model":"toaster","aduVer":"1.0"}})";
+
+static const time_t REFRESH_SECONDS = 1000;
+
+static const ADUC_StartupReport_Identity HUB_IDENTITY = { "contoso.azure-devices.net", "toaster-1", nullptr };
+
+class StartupMsg
+{
+public:
+    explicit StartupMsg(const char* json) : value(json_parse_string(json))
+    {
+    }
+
+    ~StartupMsg()
+    {
+        json_value_free(value);
+    }
+
+    StartupMsg(const StartupMsg&) = delete;
+    StartupMsg& operator=(const StartupMsg&) = delete;
+    StartupMsg(StartupMsg&&) = delete;
+    StartupMsg& operator=(StartupMsg&&) = delete;
+
+    JSON_Object* Object() const
+    {
+        return json_value_get_object(value);
+    }
+
+private:
+    JSON_Value* value;
+};
+
+/**
+ * @brief Prepares @p json as a startup report with @p identity, and acknowledges it if @p acknowledge is set.
+ *
+ * @return The sections that are left to report, or "" if nothing is reported.
+ */
+static std::string Report(
+    const std::string& dataFolder,
+    const char* json,
+    time_t now,
+    bool acknowledge = true,
+    const ADUC_StartupReport_Identity* identity = &HUB_IDENTITY)
+{
+    std::string reported;
+    ADUC_StartupReport report;
+    StartupMsg msg(json);
+
+    if (ADUC_StartupReport_Prepare(&report, dataFolder.c_str(), identity, msg.Object(), now, REFRESH_SECONDS))
+    {
+        for (size_t i = 0; i < json_object_get_count(msg.Object()); i++)
+        {
+            reported += reported.empty() ? "" : ",";
+            reported += json_object_get_name(msg.Object(), i);
+        }
+    }
+
+    if (acknowledge)
+    {
+        CHECK(ADUC_StartupReport_Acknowledge(&report));
+    }
+
+    ADUC_StartupReport_Uninit(&report);
+    return reported;
+}
+
+TEST_CASE("ADUC_StartupReport")
+{
+    const std::string dataFolder = std::string(ADUC_TMP_DIR_PATH) + "/startup_report_utils_ut";
+    const std::string stateFile = dataFolder + "/" + ADUC_STARTUP_REPORT_STATE_FILE;
+    (void)mkdir(ADUC_TMP_DIR_PATH, 0755);
+    (void)mkdir(dataFolder.c_str(), 0755);
+    (void)remove(stateFile.c_str());
+
+    SECTION("First report is full")
+    {
+        CHECK(Report(dataFolder, STARTUP_MSG, 100) == "deviceProperties,compatPropertyNames");
+        CHECK(access(stateFile.c_str(), F_OK) == 0);
+    }
+
+    SECTION("Unchanged report after a reboot is skipped")
+    {
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, STARTUP_MSG, 200).empty());
+        CHECK(Report(dataFolder, STARTUP_MSG, 300).empty());
+    }
+
+    SECTION("Only the changed section is reported")
+    {
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, UPDATED_STARTUP_MSG, 200) == "deviceProperties");
+        CHECK(Report(dataFolder, UPDATED_STARTUP_MSG, 300).empty());
+    }
+
+    SECTION("Report that is not acknowledged is sent again")
+    {
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, UPDATED_STARTUP_MSG, 200, false /* acknowledge */) == "deviceProperties");
+        CHECK(Report(dataFolder, UPDATED_STARTUP_MSG, 300) == "deviceProperties");
+    }
+
+    SECTION("Full report is sent again after the refresh interval")
+    {
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, STARTUP_MSG, 100 + REFRESH_SECONDS - 1).empty());
+        CHECK(Report(dataFolder, STARTUP_MSG, 100 + REFRESH_SECONDS) == "deviceProperties,compatPropertyNames");
+
+        // The refresh interval restarts with the full report.
+        CHECK(Report(dataFolder, STARTUP_MSG, 100 + REFRESH_SECONDS + 1).empty());
+    }
+
+    SECTION("Clock that went backwards forces a full report")
+    {
+        Report(dataFolder, STARTUP_MSG, 1000);
+        CHECK(Report(dataFolder, STARTUP_MSG, 500) == "deviceProperties,compatPropertyNames");
+    }
+
+    SECTION("Section that is no longer reported is removed from the twin")
+    {
+        Report(dataFolder, STARTUP_MSG, 100);
+
+        ADUC_StartupReport report;
+        StartupMsg msg(DEVICE_PROPERTIES_ONLY_MSG);
+
+        REQUIRE(ADUC_StartupReport_Prepare(
+            &report, dataFolder.c_str(), &HUB_IDENTITY, msg.Object(), 200, REFRESH_SECONDS));
+        CHECK(json_object_get_count(msg.Object()) == 1);
+        CHECK(json_object_has_value_of_type(msg.Object(), "compatPropertyNames", JSONNull));
+        CHECK(ADUC_StartupReport_Acknowledge(&report));
+        ADUC_StartupReport_Uninit(&report);
+
+        CHECK(Report(dataFolder, DEVICE_PROPERTIES_ONLY_MSG, 300).empty());
+    }
+
+    SECTION("Another hub or identity forces a full report")
+    {
+        const ADUC_StartupReport_Identity otherHub = { "fabrikam.azure-devices.net", "toaster-1", nullptr };
+        const ADUC_StartupReport_Identity otherDevice = { "contoso.azure-devices.net", "toaster-2", nullptr };
+        const ADUC_StartupReport_Identity module = { "contoso.azure-devices.net", "toaster-1", "adu" };
+
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, STARTUP_MSG, 200, true, &otherHub) == "deviceProperties,compatPropertyNames");
+        CHECK(Report(dataFolder, STARTUP_MSG, 300, true, &otherHub).empty());
+        CHECK(Report(dataFolder, STARTUP_MSG, 400, true, &otherDevice) == "deviceProperties,compatPropertyNames");
+        CHECK(Report(dataFolder, STARTUP_MSG, 500, true, &module) == "deviceProperties,compatPropertyNames");
+        CHECK(Report(dataFolder, STARTUP_MSG, 600, true, &module).empty());
+    }
+
+    SECTION("Sections of another hub are not removed from the twin")
+    {
+        const ADUC_StartupReport_Identity otherHub = { "fabrikam.azure-devices.net", "toaster-1", nullptr };
+
+        Report(dataFolder, STARTUP_MSG, 100);
+        CHECK(Report(dataFolder, DEVICE_PROPERTIES_ONLY_MSG, 200, true, &otherHub) == "deviceProperties");
+    }
+
+    SECTION("Unknown identity results in a full report")
+    {
+        Report(dataFolder, STARTUP_MSG, 100, true, nullptr);
+        CHECK(Report(dataFolder, STARTUP_MSG, 200, true, nullptr) == "deviceProperties,compatPropertyNames");
+    }
+
+    SECTION("Record without an identity results in a full report")
+    {
+        FILE* file = fopen(stateFile.c_str(), "w");
+        REQUIRE(file != nullptr);
+        fputs(R"({"sections":{},"lastFullReportTime":100})", file);
+        fclose(file);
+
+        CHECK(Report(dataFolder, DEVICE_PROPERTIES_ONLY_MSG, 200) == "deviceProperties");
+        CHECK(Report(dataFolder, DEVICE_PROPERTIES_ONLY_MSG, 300).empty());
+    }
+
+    SECTION("Corrupt record results in a full report")
+    {
+        FILE* file = fopen(stateFile.c_str(), "w");
+        REQUIRE(file != nullptr);
+        fputs("garbage", file);
+        fclose(file);
+
+        CHECK(Report(dataFolder, STARTUP_MSG, 100) == "deviceProperties,compatPropertyNames");
+        CHECK(Report(dataFolder, STARTUP_MSG, 200).empty());
+    }
+
+    SECTION("Without a data folder every report is full")
+    {
+        ADUC_StartupReport report;
+        StartupMsg msg(STARTUP_MSG);
+
+        CHECK(ADUC_StartupReport_Prepare(&report, nullptr, &HUB_IDENTITY, msg.Object(), 100, REFRESH_SECONDS));
+        CHECK(json_object_get_count(msg.Object()) == 2);
+        CHECK_FALSE(ADUC_StartupReport_Acknowledge(&report));
+        ADUC_StartupReport_Uninit(&report);
+    }
+
+    (void)remove(stateFile.c_str());
+    (void)rmdir(dataFolder.c_str());
+}
@@ -14,11 +14,90 @@
 
 #include <aducpal/sys_stat.h> // mode_t
 #include <aducpal/unistd.h> // uid_t, gid_t
+#include <sys/types.h> // off_t
+
+/**
+ * @brief Environment variable that selects the page cache mode for large file I/O: "default" or "dropBehind".
+ */
+#define ADUC_PAGE_CACHE_MODE_ENV "ADUC_PAGE_CACHE_MODE"
+
+/**
+ * @brief Granularity of the zero blocks that ADUC_SystemUtils_WriteSparse leaves as holes.
+ */
+#define ADUC_SPARSE_BLOCK_SIZE 4096
 
 EXTERN_C_BEGIN
 
+/**
+ * @brief How large sequential file I/O, e.g. hashing and copying payloads, uses the page cache.
+ */
+typedef enum tagADUC_PageCacheMode
+{
+    ADUC_PageCacheMode_Default = 0, /**< No hints. The kernel caches the data as usual. */
+    ADUC_PageCacheMode_DropBehind = 1, /**< Read ahead sequentially, bound dirty pages, and drop the processed data. */
+} ADUC_PageCacheMode;
+
+/**
+ * @brief Tracks the progress of one sequential read or write of a file for drop-behind.
+ */
+typedef struct tagADUC_PageCacheStream
+{
+    int fd; /**< The file descriptor. -1 if drop-behind is not active. */
+    bool isWrite; /**< True if the file is written. */
+    off_t offset; /**< Bytes read or written so far. */
+    off_t flushedOffset; /**< Bytes already written back and dropped from the page cache. */
+} ADUC_PageCacheStream;
+
 typedef void (*ADUC_SystemUtils_ForEachDirFunc)(void* context, const char* baseDir, const char* subDir);
 
+/**
+ * @brief ADUC_SystemUtils_WalkDir flag: descend into subdirectories.
+ */
+#define ADUC_DIRWALK_RECURSIVE 0x1
+
+/**
+ * @brief ADUC_SystemUtils_WalkDir flag: report directories after their contents instead of before.
+ */
+#define ADUC_DIRWALK_POSTORDER 0x2
+
+/**
+ * @brief ADUC_SystemUtils_WalkDir flag: do not descend into directories on another file system.
+ */
+#define ADUC_DIRWALK_SAME_FS 0x4
+
+/**
+ * @brief Walk callback return value that skips the contents of the reported directory, and continues the walk.
+ */
+#define ADUC_DIRWALK_SKIP 1
+
+/**
+ * @brief The type of a directory entry, from d_type where the file system provides it.
+ */
+typedef enum tagADUC_DirWalk_EntryType
+{
+    ADUC_DirWalk_EntryType_File = 0, /**< A regular file. */
+    ADUC_DirWalk_EntryType_Dir = 1, /**< A directory. Symbolic links to directories are not followed. */
+    ADUC_DirWalk_EntryType_Other = 2, /**< Anything else, e.g. a symbolic link, fifo or socket. */
+} ADUC_DirWalk_EntryType;
+
+/**
+ * @brief A directory entry reported by ADUC_SystemUtils_WalkDir. Only valid during the callback.
+ */
+typedef struct tagADUC_DirWalk_Entry
+{
+    int dirFd; /**< File descriptor of the parent directory, for use with the *at() functions. */
+    const char* name; /**< The entry name, relative to dirFd. */
+    const char* path; /**< The full path of the entry. */
+    ADUC_DirWalk_EntryType type; /**< The entry type. */
+    unsigned int depth; /**< 0 for entries of the walked directory itself. */
+} ADUC_DirWalk_Entry;
+
+/**
+ * @brief Callback for each entry of ADUC_SystemUtils_WalkDir.
+ * @return 0 to continue, ADUC_DIRWALK_SKIP to not descend into a directory, or any other value to stop the walk.
+ */
+typedef int (*ADUC_DirWalk_Callback)(void* context, const ADUC_DirWalk_Entry* entry);
+
 /**
  * @brief A function object for use with SystemUtils_ForEachDir with optional context.
  *
@@ -49,8 +128,26 @@ bool ADUC_SystemUtils_Exists(const char* path);
 
 int ADUC_SystemUtils_RmDirRecursive(const char* path);
 
+int ADUC_SystemUtils_RmDirRecursiveParallel(const char* path, unsigned int threadCount);
+
+int ADUC_SystemUtils_WalkDir(const char* path, unsigned int flags, ADUC_DirWalk_Callback callback, void* context);
+
+int ADUC_SystemUtils_GetNextDataRange(int fd, off_t offset, off_t size, off_t* dataStart, off_t* dataEnd);
+
+int ADUC_SystemUtils_WriteSparse(int fd, const void* buffer, size_t length, off_t offset, bool punchHoles);
+
 int ADUC_SystemUtils_CopyFileToDir(const char* filePath, const char* dirPath, bool overwriteExistingFile);
 
+ADUC_PageCacheMode ADUC_SystemUtils_GetPageCacheMode();
+
+void ADUC_SystemUtils_SetPageCacheMode(ADUC_PageCacheMode mode);
+
+void ADUC_PageCacheStream_Init(ADUC_PageCacheStream* stream, int fd, bool isWrite);
+
+void ADUC_PageCacheStream_Advance(ADUC_PageCacheStream* stream, size_t bytes);
+
+void ADUC_PageCacheStream_Finish(ADUC_PageCacheStream* stream);
+
 int ADUC_SystemUtils_WriteStringToFile(const char* path, const char* buff);
 
 int ADUC_SystemUtils_ReadStringFromFile(const char* path, char* buff, size_t buffLen);
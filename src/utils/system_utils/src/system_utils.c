@@ -18,9 +18,11 @@
 #include <aducpal/unistd.h> // chown
 
 #include <aduc/string_c_utils.h>
+#include <azure_c_shared_utility/crt_abstractions.h> // mallocAndStrcpy_s
 #include <azure_c_shared_utility/strings.h>
 #include <aducpal/dirent.h>
 #include <errno.h>
+#include <fcntl.h> // posix_fadvise, sync_file_range
 #include <limits.h> // for PATH_MAX
 #include <stdio.h>
 #include <stdlib.h> // for getenv
@@ -28,6 +30,12 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef __linux__
+#    include <pthread.h>
+#    include <stdint.h>
+#    include <sys/syscall.h> // SYS_getdents64
+#endif
+
 // keep this last to avoid interfering with system headers
 #include "aduc/aduc_banned.h"
 
@@ -38,6 +46,18 @@
 #    define ALL_PERMS 07777
 #endif
 
+/**
+ * @brief Size of the window that drop-behind writes back and evicts at a time.
+ */
+#define PAGE_CACHE_WINDOW_SIZE (8 * 1024 * 1024)
+
+/**
+ * @brief The page cache mode. Initialized from ADUC_PAGE_CACHE_MODE_ENV on first use.
+ */
+static ADUC_PageCacheMode s_pageCacheMode = ADUC_PageCacheMode_DropBehind;
+
+static bool s_pageCacheModeInitialized = false;
+
 /**
  * @brief Retrieve system temporary path with a subfolder.
  *
@@ -349,6 +369,480 @@ int ADUC_SystemUtils_MkDirRecursiveAduUser(const char* path)
     return ADUC_SystemUtils_MkDirRecursive(path, aduUserId, (gid_t)-1, (mode_t)S_IRWXU);
 }
 
+#ifdef __linux__
+
+/**
+ * @brief Maximum directory depth below the walked directory.
+ */
+#    define DIRWALK_MAX_DEPTH 128
+
+/**
+ * @brief Size of the getdents64 buffer of each depth.
+ */
+#    define DIRWALK_BUFFER_SIZE (32 * 1024)
+
+/**
+ * @brief Layout of the records returned by getdents64.
+ */
+struct DirWalk_Dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * @brief The state of one ADUC_SystemUtils_WalkDir call.
+ */
+typedef struct tagDirWalk
+{
+    unsigned int flags; /**< ADUC_DIRWALK_* flags. */
+    ADUC_DirWalk_Callback callback; /**< The callback. */
+    void* context; /**< The callback context. */
+    dev_t rootDevice; /**< The device of the walked directory, for ADUC_DIRWALK_SAME_FS. */
+    char path[PATH_MAX]; /**< The path of the current entry, extended and truncated in place. */
+    char* buffers[DIRWALK_MAX_DEPTH]; /**< One getdents64 buffer per depth, reused for all directories at it. */
+} DirWalk;
+
+static int DirWalk_ReadDir(DirWalk* walk, int fd, size_t pathLen, unsigned int depth);
+
+static ADUC_DirWalk_EntryType DirWalk_TypeFromMode(mode_t mode)
+{
+    if (S_ISDIR(mode))
+    {
+        return ADUC_DirWalk_EntryType_Dir;
+    }
+
+    return S_ISREG(mode) ? ADUC_DirWalk_EntryType_File : ADUC_DirWalk_EntryType_Other;
+}
+
+/**
+ * @brief Reports one entry, and walks into it if it is a directory and the walk is recursive.
+ */
+static int DirWalk_Entry(
+    DirWalk* walk, int parentFd, const char* name, size_t pathLen, ADUC_DirWalk_EntryType type, unsigned int depth)
+{
+    int result = 0;
+    const ADUC_DirWalk_Entry entry = { parentFd, name, walk->path, type, depth };
+    const bool descend = (walk->flags & ADUC_DIRWALK_RECURSIVE) != 0 && type == ADUC_DirWalk_EntryType_Dir;
+
+    if (!descend || (walk->flags & ADUC_DIRWALK_POSTORDER) == 0)
+    {
+        result = walk->callback(walk->context, &entry);
+        if (!descend || result != 0)
+        {
+            return (result == ADUC_DIRWALK_SKIP) ? 0 : result;
+        }
+    }
+
+    const int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    struct stat st;
+    if ((walk->flags & ADUC_DIRWALK_SAME_FS) != 0 && (fstat(fd, &st) != 0 || st.st_dev != walk->rootDevice))
+    {
+        // A mount point: report it, but do not descend.
+        close(fd);
+    }
+    else
+    {
+        result = DirWalk_ReadDir(walk, fd, pathLen, depth + 1);
+        close(fd);
+
+        if (result != 0)
+        {
+            return result;
+        }
+    }
+
+    walk->path[pathLen] = '\0';
+
+    if ((walk->flags & ADUC_DIRWALK_POSTORDER) != 0)
+    {
+        result = walk->callback(walk->context, &entry);
+    }
+
+    return (result == ADUC_DIRWALK_SKIP) ? 0 : result;
+}
+
+/**
+ * @brief Reports the entries of the directory @p fd, whose path is the first @p pathLen characters of walk->path.
+ */
+static int DirWalk_ReadDir(DirWalk* walk, int fd, size_t pathLen, unsigned int depth)
+{
+    if (depth >= DIRWALK_MAX_DEPTH)
+    {
+        errno = ELOOP;
+        return -1;
+    }
+
+    if (walk->buffers[depth] == NULL)
+    {
+        walk->buffers[depth] = malloc(DIRWALK_BUFFER_SIZE);
+        if (walk->buffers[depth] == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    char* buffer = walk->buffers[depth];
+
+    for (;;)
+    {
+        const long readSize = syscall(SYS_getdents64, fd, buffer, DIRWALK_BUFFER_SIZE);
+        if (readSize < 0)
+        {
+            return -1;
+        }
+
+        if (readSize == 0)
+        {
+            return 0;
+        }
+
+        for (long pos = 0; pos < readSize;)
+        {
+            const struct DirWalk_Dirent64* dirent = (const struct DirWalk_Dirent64*)(buffer + pos);
+            pos += dirent->d_reclen;
+
+            const char* name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+
+            const size_t nameLen = strlen(name);
+            if (pathLen + 1 + nameLen >= sizeof(walk->path))
+            {
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+
+            walk->path[pathLen] = '/';
+            memcpy(walk->path + pathLen + 1, name, nameLen + 1);
+
+            ADUC_DirWalk_EntryType type = ADUC_DirWalk_EntryType_Other;
+            switch (dirent->d_type)
+            {
+            case DT_REG:
+                type = ADUC_DirWalk_EntryType_File;
+                break;
+
+            case DT_DIR:
+                type = ADUC_DirWalk_EntryType_Dir;
+                break;
+
+            case DT_UNKNOWN:
+            {
+                // Some file systems do not fill in d_type.
+                struct stat st;
+                if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    return -1;
+                }
+
+                type = DirWalk_TypeFromMode(st.st_mode);
+                break;
+            }
+
+            default:
+                break;
+            }
+
+            const int result = DirWalk_Entry(walk, fd, name, pathLen + 1 + nameLen, type, depth);
+            if (result != 0)
+            {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Walks the entries of the directory @p path. The directory itself is not reported.
+ * @details Directories are read with getdents64 into buffers that are reused for all directories at the same
+ * depth, entries are opened relative to their parent directory, and the entry type is taken from d_type, so
+ * no per-entry path building or stat calls are needed. Symbolic links are reported but not followed. That
+ * includes @p path itself: if it is a symbolic link, the walk fails with ENOTDIR.
+ *
+ * @param path The directory to walk.
+ * @param flags ADUC_DIRWALK_* flags.
+ * @param callback The callback for each entry.
+ * @param context The callback context.
+ * @return int 0 on success, the value that stopped the walk if the callback returned one, or -1 with errno set.
+ */
+int ADUC_SystemUtils_WalkDir(const char* path, unsigned int flags, ADUC_DirWalk_Callback callback, void* context)
+{
+    int result = -1;
+    int fd = -1;
+    DirWalk* walk = NULL;
+
+    if (IsNullOrEmpty(path) || callback == NULL)
+    {
+        errno = EINVAL;
+        goto done;
+    }
+
+    size_t pathLen = strlen(path);
+    while (pathLen > 1 && path[pathLen - 1] == '/')
+    {
+        --pathLen;
+    }
+
+    walk = calloc(1, sizeof(*walk));
+    if (walk == NULL)
+    {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    if (pathLen >= sizeof(walk->path))
+    {
+        errno = ENAMETOOLONG;
+        goto done;
+    }
+
+    memcpy(walk->path, path, pathLen);
+    walk->path[pathLen] = '\0';
+    walk->flags = flags;
+    walk->callback = callback;
+    walk->context = context;
+
+    fd = open(walk->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1)
+    {
+        // A symbolic link root is not walked, so that callers handle it like any other non-directory.
+        if (errno == ELOOP)
+        {
+            errno = ENOTDIR;
+        }
+        goto done;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        goto done;
+    }
+
+    walk->rootDevice = st.st_dev;
+
+    // "/" would otherwise yield "//name".
+    result = DirWalk_ReadDir(walk, fd, (pathLen == 1 && walk->path[0] == '/') ? 0 : pathLen, 0);
+
+done:
+    if (fd != -1)
+    {
+        const int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+    }
+
+    if (walk != NULL)
+    {
+        for (size_t i = 0; i < ARRAY_SIZE(walk->buffers); ++i)
+        {
+            free(walk->buffers[i]);
+        }
+
+        free(walk);
+    }
+
+    return result;
+}
+
+static int RmDirRecursive_WalkCallback(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    UNREFERENCED_PARAMETER(context);
+
+    return unlinkat(entry->dirFd, entry->name, (entry->type == ADUC_DirWalk_EntryType_Dir) ? AT_REMOVEDIR : 0);
+}
+
+/**
+ * @brief Remove a directory recursively.
+ *
+ * Contents are removed before the directory that contains them (postorder traversal). Symbolic links are
+ * removed, not followed, and mount points are not descended into. If @p path is not a directory, or is a
+ * symbolic link to one, it is removed.
+ *
+ * @return int 0 if success, -1 with errno set on failure.
+ */
+int ADUC_SystemUtils_RmDirRecursive(const char* path)
+{
+    const int result = ADUC_SystemUtils_WalkDir(
+        path,
+        ADUC_DIRWALK_RECURSIVE | ADUC_DIRWALK_POSTORDER | ADUC_DIRWALK_SAME_FS,
+        RmDirRecursive_WalkCallback,
+        NULL /* context */);
+
+    if (result != 0)
+    {
+        return (result == -1 && errno == ENOTDIR) ? ADUCPAL_remove(path) : -1;
+    }
+
+    return ADUCPAL_rmdir(path);
+}
+
+/**
+ * @brief Work shared by the threads of ADUC_SystemUtils_RmDirRecursiveParallel.
+ */
+typedef struct tagRmDirParallel_Work
+{
+    pthread_mutex_t mutex; /**< Guards nextIndex and result. */
+    char** subDirs; /**< Paths of the top-level subdirectories. */
+    size_t subDirCount; /**< Number of entries in subDirs. */
+    size_t subDirCapacity; /**< Allocated entries in subDirs. */
+    size_t nextIndex; /**< The next subdirectory to remove. */
+    int result; /**< 0, or -1 if any removal failed. */
+    int error; /**< errno of the first failure. */
+} RmDirParallel_Work;
+
+/**
+ * @brief Removes the files of the top-level directory, and collects its subdirectories.
+ */
+static int RmDirParallel_CollectCallback(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    RmDirParallel_Work* work = (RmDirParallel_Work*)context;
+
+    if (entry->type != ADUC_DirWalk_EntryType_Dir)
+    {
+        return unlinkat(entry->dirFd, entry->name, 0);
+    }
+
+    if (work->subDirCount == work->subDirCapacity)
+    {
+        const size_t capacity = (work->subDirCapacity == 0) ? 16 : work->subDirCapacity * 2;
+        char** subDirs = realloc(work->subDirs, capacity * sizeof(*subDirs));
+        if (subDirs == NULL)
+        {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        work->subDirs = subDirs;
+        work->subDirCapacity = capacity;
+    }
+
+    char* subDir = NULL;
+    if (mallocAndStrcpy_s(&subDir, entry->path) != 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    work->subDirs[work->subDirCount++] = subDir;
+    return 0;
+}
+
+static void* RmDirParallel_ThreadProc(void* arg)
+{
+    RmDirParallel_Work* work = (RmDirParallel_Work*)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&work->mutex);
+        const size_t index = work->nextIndex++;
+        pthread_mutex_unlock(&work->mutex);
+
+        if (index >= work->subDirCount)
+        {
+            return NULL;
+        }
+
+        if (ADUC_SystemUtils_RmDirRecursive(work->subDirs[index]) != 0)
+        {
+            const int error = errno;
+
+            pthread_mutex_lock(&work->mutex);
+            if (work->result == 0)
+            {
+                work->result = -1;
+                work->error = error;
+            }
+            pthread_mutex_unlock(&work->mutex);
+        }
+    }
+}
+
+/**
+ * @brief Remove a directory recursively, removing its top-level subdirectories in parallel.
+ * @details Useful for trees with many small files, e.g. leftover sandboxes or caches, on storage that can
+ * process several metadata updates at once. A @p threadCount of 0 or 1 is the same as
+ * ADUC_SystemUtils_RmDirRecursive.
+ *
+ * @param path The directory to remove.
+ * @param threadCount The maximum number of threads.
+ * @return int 0 if success, -1 with errno set on failure.
+ */
+int ADUC_SystemUtils_RmDirRecursiveParallel(const char* path, unsigned int threadCount)
+{
+    RmDirParallel_Work work = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+    pthread_t threads[16];
+    size_t threadsStarted = 0;
+
+    if (threadCount <= 1)
+    {
+        return ADUC_SystemUtils_RmDirRecursive(path);
+    }
+
+    int result = ADUC_SystemUtils_WalkDir(path, ADUC_DIRWALK_SAME_FS, RmDirParallel_CollectCallback, &work);
+    if (result != 0)
+    {
+        result = (result == -1 && errno == ENOTDIR) ? ADUCPAL_remove(path) : -1;
+        goto done;
+    }
+
+    if (threadCount > ARRAY_SIZE(threads))
+    {
+        threadCount = ARRAY_SIZE(threads);
+    }
+
+    // The calling thread removes subdirectories too.
+    while (threadsStarted + 1 < threadCount && threadsStarted + 1 < work.subDirCount)
+    {
+        if (pthread_create(&threads[threadsStarted], NULL, RmDirParallel_ThreadProc, &work) != 0)
+        {
+            break;
+        }
+
+        ++threadsStarted;
+    }
+
+    RmDirParallel_ThreadProc(&work);
+
+    for (size_t i = 0; i < threadsStarted; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (work.result != 0)
+    {
+        errno = work.error;
+        result = -1;
+        goto done;
+    }
+
+    result = ADUCPAL_rmdir(path);
+
+done:
+    for (size_t i = 0; i < work.subDirCount; ++i)
+    {
+        free(work.subDirs[i]);
+    }
+
+    free(work.subDirs);
+
+    return result;
+}
+
+#else // __linux__
+
 static int RmDirRecursive_helper(const char* fpath, const struct stat* sb, int typeflag, struct FTW* info)
 {
     UNREFERENCED_PARAMETER(sb);
@@ -384,6 +878,26 @@ int ADUC_SystemUtils_RmDirRecursive(const char* path)
     return ADUCPAL_nftw(path, RmDirRecursive_helper, 20 /*nfds*/, FTW_MOUNT | FTW_PHYS | FTW_DEPTH);
 }
 
+int ADUC_SystemUtils_RmDirRecursiveParallel(const char* path, unsigned int threadCount)
+{
+    UNREFERENCED_PARAMETER(threadCount);
+
+    return ADUC_SystemUtils_RmDirRecursive(path);
+}
+
+int ADUC_SystemUtils_WalkDir(const char* path, unsigned int flags, ADUC_DirWalk_Callback callback, void* context)
+{
+    UNREFERENCED_PARAMETER(path);
+    UNREFERENCED_PARAMETER(flags);
+    UNREFERENCED_PARAMETER(callback);
+    UNREFERENCED_PARAMETER(context);
+
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif // __linux__
+
 /**
  * @brief Takes the filename from @p filePath and concatenates it with @p dirPath and stores the result in @p newFilePath
  * @details newFilePath should be freed using STRING_delete() by caller
@@ -460,9 +974,193 @@ done:
     return succeeded;
 }
 
+/**
+ * @brief Finds the next range of @p fd that may hold data, at or after @p offset.
+ * @details Holes of sparse files are found with SEEK_DATA and SEEK_HOLE. Where the file system does not support
+ * them, the rest of the file is one data range.
+ *
+ * @param fd The file descriptor.
+ * @param offset The offset to start at.
+ * @param size The file size.
+ * @param[out] dataStart The start of the range, or @p size if there is no more data.
+ * @param[out] dataEnd The end of the range.
+ * @return int 0 on success, errno otherwise.
+ */
+int ADUC_SystemUtils_GetNextDataRange(int fd, off_t offset, off_t size, off_t* dataStart, off_t* dataEnd)
+{
+    *dataStart = size;
+    *dataEnd = size;
+
+    if (offset >= size)
+    {
+        return 0;
+    }
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    const off_t start = lseek(fd, offset, SEEK_DATA);
+    if (start == -1 && errno == ENXIO)
+    {
+        // Only a hole is left.
+        return 0;
+    }
+
+    if (start != -1)
+    {
+        const off_t end = lseek(fd, start, SEEK_HOLE);
+        if (end == -1)
+        {
+            return errno;
+        }
+
+        *dataStart = start;
+        *dataEnd = end < size ? end : size;
+        return 0;
+    }
+
+    if (errno != EINVAL && errno != EOPNOTSUPP)
+    {
+        return errno;
+    }
+#else
+    UNREFERENCED_PARAMETER(fd);
+#endif
+
+    *dataStart = offset;
+    return 0;
+}
+
+/**
+ * @brief Returns true if @p length bytes of @p buffer are zero.
+ */
+static bool IsZeroBlock(const unsigned char* buffer, size_t length)
+{
+    static const unsigned char zeros[ADUC_SPARSE_BLOCK_SIZE] = { 0 };
+    return length <= sizeof(zeros) && memcmp(buffer, zeros, length) == 0;
+}
+
+/**
+ * @brief Writes @p length bytes of @p buffer at @p offset with pwrite, all of them.
+ */
+static int WriteFully(int fd, const unsigned char* buffer, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        const ssize_t written = pwrite(fd, buffer, length, offset);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return written == 0 ? EIO : errno;
+        }
+
+        buffer += written;
+        length -= (size_t)written;
+        offset += written;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates a range of @p fd, so that it reads as zeros. Writes zeros if holes are not supported.
+ */
+static int PunchHole(int fd, off_t offset, off_t length)
+{
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0)
+    {
+        return 0;
+    }
+
+    if (errno != EOPNOTSUPP && errno != ENOSYS)
+    {
+        return errno;
+    }
+#endif
+
+    static const unsigned char zeros[ADUC_SPARSE_BLOCK_SIZE] = { 0 };
+    while (length > 0)
+    {
+        const size_t chunk = length < (off_t)sizeof(zeros) ? (size_t)length : sizeof(zeros);
+        const int err = WriteFully(fd, zeros, chunk, offset);
+        if (err != 0)
+        {
+            return err;
+        }
+
+        offset += (off_t)chunk;
+        length -= (off_t)chunk;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Writes @p length bytes at @p offset, leaving the blocks of ADUC_SPARSE_BLOCK_SIZE zeros as holes.
+ * @details Trailing holes do not extend the file, so the caller sets the file size with ftruncate when done.
+ *
+ * @param fd The file descriptor.
+ * @param buffer The data.
+ * @param length The length of @p buffer.
+ * @param offset The file offset to write at.
+ * @param punchHoles True if the range may hold data, which is then deallocated for the zero blocks. False if the
+ * range is known to read as zeros already, e.g. past the end of a truncated file.
+ * @return int 0 on success, errno otherwise.
+ */
+int ADUC_SystemUtils_WriteSparse(int fd, const void* buffer, size_t length, off_t offset, bool punchHoles)
+{
+    const unsigned char* data = (const unsigned char*)buffer;
+    size_t runStart = 0;
+    bool runIsZero = false;
+
+    // Runs of zero and non-zero blocks are written with one call each. The position one past the end flushes the last.
+    for (size_t position = 0; position <= length;)
+    {
+        // Blocks are aligned to the file offset, so that holes match the file system blocks.
+        const off_t fileOffset = offset + (off_t)position;
+        const size_t blockLength = ADUC_SPARSE_BLOCK_SIZE - (size_t)(fileOffset % ADUC_SPARSE_BLOCK_SIZE);
+        const size_t chunkLength = blockLength < length - position ? blockLength : length - position;
+        const bool isZero = position < length && IsZeroBlock(data + position, chunkLength);
+
+        if (position > runStart && (position == length || isZero != runIsZero))
+        {
+            int err = 0;
+            if (!runIsZero)
+            {
+                err = WriteFully(fd, data + runStart, position - runStart, offset + (off_t)runStart);
+            }
+            else if (punchHoles)
+            {
+                err = PunchHole(fd, offset + (off_t)runStart, (off_t)(position - runStart));
+            }
+
+            if (err != 0)
+            {
+                return err;
+            }
+
+            runStart = position;
+        }
+
+        if (position == length)
+        {
+            break;
+        }
+
+        runIsZero = isZero;
+        position += chunkLength;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Copies the file at @p filePath to @p dirPath with the same name
- * @details Preserves the ownership and filemode bit permissions
+ * @details Preserves the ownership and filemode bit permissions. Holes of the source file, and blocks of zeros,
+ * are left as holes in the copy.
  * @param filePath path to the file
  * @param dirPath path to the directory
  * @param overwriteExistingFile if set to true will overwrite the existing file in @p dirPath named with the filename in @p fileName if it exists
@@ -473,12 +1171,15 @@ int ADUC_SystemUtils_CopyFileToDir(const char* filePath, const char* dirPath, co
     int result = -1;
     STRING_HANDLE destFilePath = NULL;
 
-    FILE* sourceFile = NULL;
-    FILE* destFile = NULL;
-    unsigned char readBuff[1024];
-    const size_t readMaxBuffSize = ARRAY_SIZE(readBuff);
+    int sourceFd = -1;
+    int destFd = -1;
+    ADUC_PageCacheStream sourceStream;
+    ADUC_PageCacheStream destStream;
+    unsigned char readBuff[16 * 1024];
+    struct stat buff;
 
-    memset(readBuff, 0, readMaxBuffSize);
+    ADUC_PageCacheStream_Init(&sourceStream, -1, false);
+    ADUC_PageCacheStream_Init(&destStream, -1, true);
 
     if (filePath == NULL || dirPath == NULL)
     {
@@ -490,49 +1191,62 @@ int ADUC_SystemUtils_CopyFileToDir(const char* filePath, const char* dirPath, co
         goto done;
     }
 
-    sourceFile = fopen(filePath, "rb");
+    sourceFd = open(filePath, O_RDONLY | O_CLOEXEC);
 
-    if (sourceFile == NULL)
+    if (sourceFd == -1 || fstat(sourceFd, &buff) != 0)
     {
         goto done;
     }
 
-    if (overwriteExistingFile)
-    {
-        destFile = fopen(STRING_c_str(destFilePath), "wb+");
-    }
-    else
-    {
-        destFile = fopen(STRING_c_str(destFilePath), "wb");
-    }
+    // The copy is written from scratch either way, so its holes need no punching.
+    UNREFERENCED_PARAMETER(overwriteExistingFile);
+    destFd = open(STRING_c_str(destFilePath), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
 
-    if (destFile == NULL)
+    if (destFd == -1)
     {
         goto done;
     }
 
-    size_t readBytes = fread(readBuff, readMaxBuffSize, sizeof(readBuff[0]), sourceFile);
+    ADUC_PageCacheStream_Init(&sourceStream, sourceFd, false);
+    ADUC_PageCacheStream_Init(&destStream, destFd, true);
 
-    while (readBytes != 0 && feof(sourceFile) != 0)
+    off_t dataStart;
+    off_t dataEnd;
+    for (off_t offset = 0; offset < buff.st_size; offset = dataEnd)
     {
-        const size_t writtenBytes = fwrite(readBuff, readBytes, sizeof(readBuff[0]), destFile);
-
-        result = ferror(destFile);
-        if (writtenBytes != readBytes || result != 0)
+        if (ADUC_SystemUtils_GetNextDataRange(sourceFd, offset, buff.st_size, &dataStart, &dataEnd) != 0)
         {
             goto done;
         }
 
-        readBytes = fread(readBuff, readMaxBuffSize, sizeof(readBuff[0]), sourceFile);
-        result = ferror(sourceFile);
-        if (result != 0)
+        // Holes are skipped in both files, which keeps the drop-behind windows aligned to the offsets.
+        ADUC_PageCacheStream_Advance(&sourceStream, (size_t)(dataStart - offset));
+        ADUC_PageCacheStream_Advance(&destStream, (size_t)(dataStart - offset));
+
+        for (off_t position = dataStart; position < dataEnd;)
         {
-            goto done;
+            const size_t toRead =
+                dataEnd - position < (off_t)sizeof(readBuff) ? (size_t)(dataEnd - position) : sizeof(readBuff);
+            const ssize_t readBytes = pread(sourceFd, readBuff, toRead, position);
+            if (readBytes < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (readBytes <= 0
+                || ADUC_SystemUtils_WriteSparse(destFd, readBuff, (size_t)readBytes, position, false /* punchHoles */)
+                    != 0)
+            {
+                goto done;
+            }
+
+            ADUC_PageCacheStream_Advance(&sourceStream, (size_t)readBytes);
+            ADUC_PageCacheStream_Advance(&destStream, (size_t)readBytes);
+            position += readBytes;
         }
     }
 
-    struct stat buff;
-    if (stat(filePath, &buff) != 0)
+    if (ftruncate(destFd, buff.st_size) != 0)
     {
         goto done;
     }
@@ -545,10 +1259,20 @@ int ADUC_SystemUtils_CopyFileToDir(const char* filePath, const char* dirPath, co
     result = 0;
 done:
 
-    fclose(sourceFile);
-    fclose(destFile);
+    ADUC_PageCacheStream_Finish(&sourceStream);
+    ADUC_PageCacheStream_Finish(&destStream);
 
-    if (result != 0)
+    if (sourceFd != -1)
+    {
+        close(sourceFd);
+    }
+
+    if (destFd != -1 && close(destFd) != 0)
+    {
+        result = -1;
+    }
+
+    if (result != 0 && destFilePath != NULL)
     {
         remove(STRING_c_str(destFilePath));
     }
@@ -557,6 +1281,150 @@ done:
     return result;
 }
 
+/**
+ * @brief Gets the page cache mode for large sequential file I/O.
+ * @details Defaults to ADUC_PageCacheMode_DropBehind. Setting ADUC_PAGE_CACHE_MODE_ENV to "default" disables the hints.
+ *
+ * @return ADUC_PageCacheMode The mode.
+ */
+ADUC_PageCacheMode ADUC_SystemUtils_GetPageCacheMode()
+{
+    if (!s_pageCacheModeInitialized)
+    {
+        const char* mode = getenv(ADUC_PAGE_CACHE_MODE_ENV);
+        if (mode != NULL && strcmp(mode, "default") == 0)
+        {
+            s_pageCacheMode = ADUC_PageCacheMode_Default;
+        }
+
+        s_pageCacheModeInitialized = true;
+    }
+
+    return s_pageCacheMode;
+}
+
+/**
+ * @brief Sets the page cache mode for large sequential file I/O of this process.
+ *
+ * @param mode The mode.
+ */
+void ADUC_SystemUtils_SetPageCacheMode(ADUC_PageCacheMode mode)
+{
+    s_pageCacheMode = mode;
+    s_pageCacheModeInitialized = true;
+}
+
+/**
+ * @brief Writes back (for written files) and evicts the range of @p stream up to @p endOffset.
+ */
+static void PageCacheStream_Drop(ADUC_PageCacheStream* stream, off_t endOffset)
+{
+    const off_t length = endOffset - stream->flushedOffset;
+    if (length <= 0)
+    {
+        return;
+    }
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    // Dirty pages cannot be evicted, so wait for their writeback first.
+    if (stream->isWrite)
+    {
+        (void)sync_file_range(
+            stream->fd,
+            stream->flushedOffset,
+            length,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    }
+#endif
+
+#if !defined(WIN32)
+    (void)posix_fadvise(stream->fd, stream->flushedOffset, length, POSIX_FADV_DONTNEED);
+#endif
+
+    stream->flushedOffset = endOffset;
+}
+
+/**
+ * @brief Starts tracking a sequential read or write of @p fd. Does nothing unless the page cache mode is
+ * ADUC_PageCacheMode_DropBehind.
+ *
+ * @param stream The stream to initialize.
+ * @param fd The file descriptor, or -1 to only initialize @p stream.
+ * @param isWrite True if the file is written.
+ */
+void ADUC_PageCacheStream_Init(ADUC_PageCacheStream* stream, int fd, bool isWrite)
+{
+    stream->fd = -1;
+    stream->isWrite = isWrite;
+    stream->offset = 0;
+    stream->flushedOffset = 0;
+
+    if (fd < 0 || ADUC_SystemUtils_GetPageCacheMode() != ADUC_PageCacheMode_DropBehind)
+    {
+        return;
+    }
+
+    stream->fd = fd;
+
+#if !defined(WIN32)
+    if (!isWrite)
+    {
+        (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+}
+
+/**
+ * @brief Accounts @p bytes read or written. Each time a window completes, its writeback is started, and the
+ * window before it is evicted. So at most about two windows of the file stay in the page cache.
+ *
+ * @param stream The stream.
+ * @param bytes The number of bytes read or written.
+ */
+void ADUC_PageCacheStream_Advance(ADUC_PageCacheStream* stream, size_t bytes)
+{
+    if (stream->fd == -1)
+    {
+        return;
+    }
+
+    const off_t previousWindow = stream->offset / PAGE_CACHE_WINDOW_SIZE;
+    stream->offset += (off_t)bytes;
+
+    const off_t currentWindowStart = (stream->offset / PAGE_CACHE_WINDOW_SIZE) * PAGE_CACHE_WINDOW_SIZE;
+    if (currentWindowStart / PAGE_CACHE_WINDOW_SIZE == previousWindow)
+    {
+        return;
+    }
+
+    const off_t completedWindowStart = currentWindowStart - PAGE_CACHE_WINDOW_SIZE;
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    if (stream->isWrite)
+    {
+        (void)sync_file_range(stream->fd, completedWindowStart, PAGE_CACHE_WINDOW_SIZE, SYNC_FILE_RANGE_WRITE);
+    }
+#endif
+
+    PageCacheStream_Drop(stream, completedWindowStart);
+}
+
+/**
+ * @brief Writes back and evicts the rest of the file. Buffered writers must flush before calling this.
+ *
+ * @param stream The stream.
+ */
+void ADUC_PageCacheStream_Finish(ADUC_PageCacheStream* stream)
+{
+    if (stream->fd == -1)
+    {
+        return;
+    }
+
+    PageCacheStream_Drop(stream, stream->offset);
+    stream->fd = -1;
+}
+
 /**
  * @brief Removes the file when caller knows the path refers to a file
  * @remark On POSIX systems, it will remove a link to the name so it might not delete right away if there are other links
@@ -752,6 +1620,59 @@ done:
     return is_file;
 }
 
+#ifdef __linux__
+
+/**
+ * @brief Context of the ForEachDir walk callback.
+ */
+typedef struct tagForEachDir_Context
+{
+    const char* baseDir; /**< The base dir, as given by the caller. */
+    const char* excludedDir; /**< The dir name to exclude, or NULL. */
+    ADUC_SystemUtils_ForEachDirFunctor* functor; /**< The caller's functor. */
+} ForEachDir_Context;
+
+static int ForEachDir_WalkCallback(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    ForEachDir_Context* forEachContext = (ForEachDir_Context*)context;
+
+    if (forEachContext->excludedDir == NULL || strcmp(entry->name, forEachContext->excludedDir) != 0)
+    {
+        forEachContext->functor->callbackFn(forEachContext->functor->context, forEachContext->baseDir, entry->name);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief For each dir_name in the baseDir, it calls the action function with the baseDir and dir_name.
+ * @param baseDir The base dir to list directories in.
+ * @param excludedDir A dir to exclude via exact match in addition to . and .. dirs. NULL means to exclude only . and .. dirs.
+ * @param perDirActionFunctor The functor to apply for each dir in the baseDir.
+ * @returns 0 if succeeded in calling the action func for every dir in baseDir (except . and .. dirs).
+ */
+int SystemUtils_ForEachDir(
+    const char* baseDir, const char* excludedDir, ADUC_SystemUtils_ForEachDirFunctor* perDirActionFunctor)
+{
+    if (baseDir == NULL || (perDirActionFunctor == NULL) || (perDirActionFunctor->callbackFn == NULL))
+    {
+        return -1;
+    }
+
+    ForEachDir_Context context = { baseDir, excludedDir, perDirActionFunctor };
+
+    if (ADUC_SystemUtils_WalkDir(baseDir, 0 /* flags */, ForEachDir_WalkCallback, &context) != 0)
+    {
+        const int err_ret = errno;
+        Log_Error("walk '%s' failed: %d", baseDir, err_ret);
+        return err_ret;
+    }
+
+    return 0;
+}
+
+#else // __linux__
+
 /**
  * @brief For each dir_name in the baseDir, it calls the action function with the baseDir and dir_name.
  * @param baseDir The base dir to list directories in.
@@ -818,3 +1739,5 @@ done:
 
     return err_ret;
 }
+
+#endif // __linux__
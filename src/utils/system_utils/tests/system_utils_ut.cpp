@@ -11,9 +11,23 @@ using Catch::Matchers::Equals;
 #include "aduc/system_utils.h"
 #include <aduc/auto_opendir.hpp>
 #include <aduc/string_handle_wrapper.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h> // posix_fadvise
+#include <fstream>
+#include <ftw.h> // nftw, for the walker benchmark baseline
+#include <iterator>
+#include <sys/mman.h> // mincore
 #include <sys/stat.h>
+#include <sys/vfs.h> // statfs
+#include <unistd.h>
 #include <vector>
 
+/**
+ * @brief The statfs magic of tmpfs, whose pages cannot be evicted from the page cache.
+ */
+#define TEST_TMPFS_MAGIC 0x01021994
+
 // fwd-decl
 class TestCaseFixture;
 
@@ -339,6 +353,26 @@ TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_RmDirRecursive")
         CHECK_FALSE(stat(TestPath(), &st) == 0);
         CHECK_FALSE(S_ISDIR(st.st_mode));
     }
+
+    SECTION("Remove symlink to a directory")
+    {
+        const std::string base{ TestPath() };
+        REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault((base + "/target").c_str()));
+        std::ofstream{ base + "/target/file" } << "content";
+        REQUIRE(symlink((base + "/target").c_str(), (base + "/link").c_str()) == 0);
+
+        CHECK(ADUC_SystemUtils_RmDirRecursive((base + "/link").c_str()) == 0);
+
+        // Only the link is removed. The target and its contents are left alone.
+        struct stat st = {};
+        CHECK(lstat((base + "/link").c_str(), &st) == -1);
+        CHECK(ADUC_SystemUtils_Exists((base + "/target/file").c_str()));
+
+        REQUIRE(symlink((base + "/target").c_str(), (base + "/link").c_str()) == 0);
+        CHECK(ADUC_SystemUtils_RmDirRecursiveParallel((base + "/link").c_str(), 4) == 0);
+        CHECK(lstat((base + "/link").c_str(), &st) == -1);
+        CHECK(ADUC_SystemUtils_Exists((base + "/target/file").c_str()));
+    }
 }
 
 TEST_CASE_METHOD(TestCaseFixture, "SystemUtils_ForEachDir")
@@ -485,3 +519,390 @@ TEST_CASE("ADUC_SystemUtils_FormatFilePathHelper")
         CHECK_THAT(STRING_c_str(newFilePath.get()), Equals("/path/to/folder/file.ext"));
     }
 }
+
+/**
+ * @brief Gets the fraction of the pages of the file at @p path that are in the page cache.
+ *
+ * @param path The file path.
+ * @return double The resident fraction, between 0 and 1.
+ */
+static double GetResidentFraction(const std::string& path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    REQUIRE(fd != -1);
+
+    struct stat st;
+    REQUIRE(fstat(fd, &st) == 0);
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    REQUIRE(mapped != MAP_FAILED);
+
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::vector<unsigned char> residency((size + pageSize - 1) / pageSize);
+    REQUIRE(mincore(mapped, size, residency.data()) == 0);
+
+    size_t residentPages = 0;
+    for (unsigned char page : residency)
+    {
+        residentPages += page & 1;
+    }
+
+    munmap(mapped, size);
+    close(fd);
+
+    return static_cast<double>(residentPages) / static_cast<double>(residency.size());
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_CopyFileToDir page cache usage")
+{
+    struct statfs fs;
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(TestPath()));
+    REQUIRE(statfs(TestPath(), &fs) == 0);
+    if (fs.f_type == TEST_TMPFS_MAGIC)
+    {
+        WARN("Skipped, the page cache of tmpfs cannot be dropped. Set TMPDIR to a disk-backed folder.");
+        return;
+    }
+
+    // 8 times the drop-behind window.
+    const size_t payloadSize = 64 * 1024 * 1024;
+    const std::string sourcePath = std::string{ TestPath() } + "/payload.bin";
+    const std::string destDir = std::string{ TestPath() } + "/cache";
+    const std::string destPath = destDir + "/payload.bin";
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(destDir.c_str()));
+
+    {
+        // Not zeros, which the copy would leave as holes.
+        std::vector<char> chunk(1024 * 1024, 'x');
+        std::ofstream source{ sourcePath, std::ios::binary };
+        for (size_t offset = 0; offset < payloadSize; offset += chunk.size())
+        {
+            chunk[0] = static_cast<char>(offset / chunk.size());
+            source.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        }
+    }
+
+    // Start with a cold source file.
+    const int sourceFd = open(sourcePath.c_str(), O_RDONLY);
+    REQUIRE(sourceFd != -1);
+    REQUIRE(fdatasync(sourceFd) == 0);
+    REQUIRE(posix_fadvise(sourceFd, 0, 0, POSIX_FADV_DONTNEED) == 0);
+    close(sourceFd);
+
+    ADUC_SystemUtils_SetPageCacheMode(ADUC_PageCacheMode_DropBehind);
+    REQUIRE(ADUC_SystemUtils_CopyFileToDir(sourcePath.c_str(), destDir.c_str(), true) == 0);
+
+    const double dropBehindSource = GetResidentFraction(sourcePath);
+    const double dropBehindDest = GetResidentFraction(destPath);
+
+    struct stat st;
+    REQUIRE(stat(destPath.c_str(), &st) == 0);
+    CHECK(static_cast<size_t>(st.st_size) == payloadSize);
+
+    ADUC_SystemUtils_SetPageCacheMode(ADUC_PageCacheMode_Default);
+    REQUIRE(ADUC_SystemUtils_CopyFileToDir(sourcePath.c_str(), destDir.c_str(), true) == 0);
+
+    const double defaultDest = GetResidentFraction(destPath);
+
+    ADUC_SystemUtils_SetPageCacheMode(ADUC_PageCacheMode_DropBehind);
+
+    INFO(
+        "dropBehind source: " << dropBehindSource << ", dest: " << dropBehindDest
+                              << ", default dest: " << defaultDest);
+    CHECK(dropBehindSource < 0.25);
+    CHECK(dropBehindDest < 0.25);
+    CHECK(defaultDest > dropBehindDest);
+}
+
+static std::string ReadFileContent(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    return std::string{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+}
+
+static off_t GetAllocatedBytes(const std::string& path)
+{
+    struct stat st;
+    REQUIRE(stat(path.c_str(), &st) == 0);
+    return st.st_blocks * 512;
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_CopyFileToDir sparse file")
+{
+    const off_t fileSize = 16 * 1024 * 1024;
+    const std::string sourcePath = std::string{ TestPath() } + "/image.bin";
+    const std::string destDir = std::string{ TestPath() } + "/cache";
+    const std::string destPath = destDir + "/image.bin";
+    const std::vector<char> data(64 * 1024, 'd');
+    const std::vector<char> zeros(1024 * 1024, 0);
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(destDir.c_str()));
+
+    // Data at the start, middle and end, a hole, and a megabyte of zeros that was written out.
+    const int fd = open(sourcePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd != -1);
+    REQUIRE(ftruncate(fd, fileSize) == 0);
+    REQUIRE(pwrite(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()));
+    REQUIRE(pwrite(fd, data.data(), data.size(), 5 * 1024 * 1024 + 100) == static_cast<ssize_t>(data.size()));
+    REQUIRE(pwrite(fd, zeros.data(), zeros.size(), 8 * 1024 * 1024) == static_cast<ssize_t>(zeros.size()));
+    REQUIRE(pwrite(fd, data.data(), 100, fileSize - 100) == 100);
+    close(fd);
+
+    REQUIRE(ADUC_SystemUtils_CopyFileToDir(sourcePath.c_str(), destDir.c_str(), true) == 0);
+
+    CHECK(ReadFileContent(destPath) == ReadFileContent(sourcePath));
+    CHECK(GetAllocatedBytes(destPath) < 1024 * 1024);
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_WriteSparse")
+{
+    const std::string path = std::string{ TestPath() } + "/file.bin";
+    const std::vector<char> data(1024 * 1024, 'd');
+    std::vector<char> content(data);
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(TestPath()));
+
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd != -1);
+    REQUIRE(ADUC_SystemUtils_WriteSparse(fd, data.data(), data.size(), 0, false /* punchHoles */) == 0);
+    REQUIRE(fsync(fd) == 0);
+    const off_t denseBytes = GetAllocatedBytes(path);
+
+    SECTION("Zero blocks over data are punched")
+    {
+        // Unaligned, so that the partial blocks at both ends are written as zeros.
+        std::fill(content.begin() + 1000, content.begin() + 600 * 1024, 0);
+        REQUIRE(
+            ADUC_SystemUtils_WriteSparse(fd, content.data() + 1000, 600 * 1024 - 1000, 1000, true /* punchHoles */)
+            == 0);
+        REQUIRE(fsync(fd) == 0);
+
+        CHECK(GetAllocatedBytes(path) < denseBytes - 512 * 1024);
+    }
+
+    SECTION("Mixed blocks")
+    {
+        for (size_t offset = 0; offset < content.size(); offset += 3 * ADUC_SPARSE_BLOCK_SIZE)
+        {
+            std::fill(content.begin() + offset, content.begin() + offset + ADUC_SPARSE_BLOCK_SIZE, 0);
+        }
+
+        content[content.size() - 1] = 'e';
+        REQUIRE(ADUC_SystemUtils_WriteSparse(fd, content.data(), content.size(), 0, true /* punchHoles */) == 0);
+    }
+
+    close(fd);
+    CHECK(ReadFileContent(path) == std::string(content.begin(), content.end()));
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_GetNextDataRange")
+{
+    const std::string path = std::string{ TestPath() } + "/file.bin";
+    const off_t fileSize = 4 * 1024 * 1024;
+    const std::vector<char> data(ADUC_SPARSE_BLOCK_SIZE, 'd');
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(TestPath()));
+
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd != -1);
+    REQUIRE(ftruncate(fd, fileSize) == 0);
+    REQUIRE(pwrite(fd, data.data(), data.size(), 2 * 1024 * 1024) == static_cast<ssize_t>(data.size()));
+
+    off_t dataStart = 0;
+    off_t dataEnd = 0;
+    off_t dataBytes = 0;
+    for (off_t offset = 0; offset < fileSize; offset = dataEnd)
+    {
+        REQUIRE(ADUC_SystemUtils_GetNextDataRange(fd, offset, fileSize, &dataStart, &dataEnd) == 0);
+        REQUIRE(dataStart >= offset);
+        REQUIRE(dataEnd >= dataStart);
+        REQUIRE(dataEnd <= fileSize);
+        dataBytes += dataEnd - dataStart;
+    }
+
+    // The data block is always in a data range, and without hole support everything is.
+    CHECK(dataBytes >= static_cast<off_t>(data.size()));
+    CHECK(dataBytes < fileSize);
+
+    REQUIRE(ADUC_SystemUtils_GetNextDataRange(fd, fileSize, fileSize, &dataStart, &dataEnd) == 0);
+    CHECK(dataStart == fileSize);
+    close(fd);
+}
+
+/**
+ * @brief Records the entries reported by ADUC_SystemUtils_WalkDir.
+ */
+struct WalkRecord
+{
+    std::vector<std::string> paths;
+    std::vector<ADUC_DirWalk_EntryType> types;
+    std::string skipName;
+};
+
+static int RecordWalkEntry(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    WalkRecord* record = static_cast<WalkRecord*>(context);
+    record->paths.emplace_back(entry->path);
+    record->types.push_back(entry->type);
+    return (record->skipName == entry->name) ? ADUC_DIRWALK_SKIP : 0;
+}
+
+static void CreateFile(const std::string& path)
+{
+    std::ofstream file{ path };
+    file << "x";
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_WalkDir")
+{
+    const std::string base{ TestPath() };
+    REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault((base + "/a/b").c_str()));
+    CreateFile(base + "/a/b/file2");
+    CreateFile(base + "/file1");
+    REQUIRE(symlink((base + "/a").c_str(), (base + "/link").c_str()) == 0);
+
+    SECTION("Preorder, recursive")
+    {
+        WalkRecord record;
+        REQUIRE(ADUC_SystemUtils_WalkDir(TestPath(), ADUC_DIRWALK_RECURSIVE, RecordWalkEntry, &record) == 0);
+
+        REQUIRE(record.paths.size() == 5);
+        const auto pos = [&record](const std::string& path) {
+            return std::find(record.paths.begin(), record.paths.end(), path) - record.paths.begin();
+        };
+        CHECK(pos(base + "/a") < pos(base + "/a/b"));
+        CHECK(pos(base + "/a/b") < pos(base + "/a/b/file2"));
+        CHECK(record.types[pos(base + "/a")] == ADUC_DirWalk_EntryType_Dir);
+        CHECK(record.types[pos(base + "/file1")] == ADUC_DirWalk_EntryType_File);
+
+        // The symlink is reported, but not followed.
+        CHECK(record.types[pos(base + "/link")] == ADUC_DirWalk_EntryType_Other);
+    }
+
+    SECTION("Postorder reports directories after their contents")
+    {
+        WalkRecord record;
+        REQUIRE(
+            ADUC_SystemUtils_WalkDir(
+                TestPath(), ADUC_DIRWALK_RECURSIVE | ADUC_DIRWALK_POSTORDER, RecordWalkEntry, &record)
+            == 0);
+
+        const auto pos = [&record](const std::string& path) {
+            return std::find(record.paths.begin(), record.paths.end(), path) - record.paths.begin();
+        };
+        CHECK(pos(base + "/a/b/file2") < pos(base + "/a/b"));
+        CHECK(pos(base + "/a/b") < pos(base + "/a"));
+    }
+
+    SECTION("Skip and non-recursive")
+    {
+        WalkRecord record;
+        record.skipName = "b";
+        REQUIRE(ADUC_SystemUtils_WalkDir(TestPath(), ADUC_DIRWALK_RECURSIVE, RecordWalkEntry, &record) == 0);
+        CHECK(record.paths.size() == 4);
+
+        WalkRecord topLevel;
+        REQUIRE(ADUC_SystemUtils_WalkDir(TestPath(), 0, RecordWalkEntry, &topLevel) == 0);
+        CHECK(topLevel.paths.size() == 3);
+    }
+
+    SECTION("Missing directory")
+    {
+        WalkRecord record;
+        CHECK(ADUC_SystemUtils_WalkDir((base + "/missing").c_str(), 0, RecordWalkEntry, &record) == -1);
+        CHECK(errno == ENOENT);
+    }
+
+    SECTION("Symlink root is not followed")
+    {
+        WalkRecord record;
+        CHECK(ADUC_SystemUtils_WalkDir((base + "/link").c_str(), 0, RecordWalkEntry, &record) == -1);
+        CHECK(errno == ENOTDIR);
+        CHECK(record.paths.empty());
+    }
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_RmDirRecursiveParallel")
+{
+    const std::string base{ TestPath() };
+    for (int dir = 0; dir < 8; ++dir)
+    {
+        const std::string subDir = base + "/sandbox/dir" + std::to_string(dir) + "/nested";
+        REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(subDir.c_str()));
+        for (int file = 0; file < 20; ++file)
+        {
+            CreateFile(subDir + "/file" + std::to_string(file));
+        }
+    }
+    CreateFile(base + "/sandbox/top");
+
+    CHECK(ADUC_SystemUtils_RmDirRecursiveParallel((base + "/sandbox").c_str(), 4) == 0);
+    CHECK_FALSE(ADUC_SystemUtils_Exists((base + "/sandbox").c_str()));
+}
+
+static size_t g_nftwFileCount = 0;
+
+static int CountWithNftw(const char* fpath, const struct stat* sb, int typeflag, struct FTW* info)
+{
+    (void)info;
+
+    // The per-entry stat that the directory walker avoids.
+    struct stat st;
+    if (typeflag == FTW_F && stat(fpath, &st) == 0 && S_ISREG(sb->st_mode))
+    {
+        ++g_nftwFileCount;
+    }
+
+    return 0;
+}
+
+static int CountWithWalker(void* context, const ADUC_DirWalk_Entry* entry)
+{
+    if (entry->type == ADUC_DirWalk_EntryType_File)
+    {
+        ++*static_cast<size_t*>(context);
+    }
+
+    return 0;
+}
+
+TEST_CASE_METHOD(TestCaseFixture, "ADUC_SystemUtils_WalkDir benchmark", "[.][benchmark]")
+{
+    const size_t dirCount = 100;
+    const size_t filesPerDir = 200;
+    const std::string tree = std::string{ TestPath() } + "/tree";
+
+    for (size_t dir = 0; dir < dirCount; ++dir)
+    {
+        const std::string subDir = tree + "/d" + std::to_string(dir % 10) + "/d" + std::to_string(dir);
+        REQUIRE(0 == ADUC_SystemUtils_MkDirRecursiveDefault(subDir.c_str()));
+        for (size_t file = 0; file < filesPerDir; ++file)
+        {
+            const int fd = open((subDir + "/f" + std::to_string(file)).c_str(), O_CREAT | O_WRONLY, 0644);
+            REQUIRE(fd != -1);
+            close(fd);
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    g_nftwFileCount = 0;
+    auto start = Clock::now();
+    REQUIRE(nftw(tree.c_str(), CountWithNftw, 20, FTW_PHYS) == 0);
+    const double nftwSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    size_t walkerFileCount = 0;
+    start = Clock::now();
+    REQUIRE(ADUC_SystemUtils_WalkDir(tree.c_str(), ADUC_DIRWALK_RECURSIVE, CountWithWalker, &walkerFileCount) == 0);
+    const double walkerSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    REQUIRE(ADUC_SystemUtils_RmDirRecursive(tree.c_str()) == 0);
+    const double removeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    WARN(
+        "scan of " << dirCount * filesPerDir << " files: nftw+stat " << nftwSeconds << " s, walker " << walkerSeconds
+                   << " s; remove " << removeSeconds << " s");
+
+    CHECK(g_nftwFileCount == dirCount * filesPerDir);
+    CHECK(walkerFileCount == dirCount * filesPerDir);
+    CHECK(walkerSeconds < nftwSeconds);
+}
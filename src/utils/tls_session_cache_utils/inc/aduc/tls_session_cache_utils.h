@@ -0,0 +1,216 @@
+/**
+ * @file tls_session_cache_utils.h
+ * @brief Persisted TLS session cache of download connections.
+ *
+ * A full TLS handshake costs noticeable CPU on small devices, and several round trips on high-latency links.
+ * curl 8.12 and later can import and export the TLS sessions of a connection with --ssl-sessions, so that a
+ * later curl resumes the session instead of doing a full handshake. The cache keeps one session file per
+ * endpoint (host and port) in a folder only the agent can access. It is configured by the optional
+ * "tlsSessionCache" object of du-config.json:
+ *
+ *   "tlsSessionCache": {
+ *       "maxAgeSeconds": 7200,
+ *       "maxEndpoints": 16,
+ *       "maxFileKB": 64,
+ *       "credentialFiles": [ "/etc/ssl/certs/ca-certificates.crt" ]
+ *   }
+ *
+ * A session file older than maxAgeSeconds, or larger than maxFileKB, is removed before it is used. At most
+ * maxEndpoints files are kept; the oldest one is evicted first. All sessions are dropped when
+ * the content of a credential file or the curl version changes, and the session of an endpoint is dropped
+ * when a transfer to it fails with a TLS error. All fields are optional.
+ *
+ * A cache is not thread safe; the downloaders use it from their single download thread.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#ifndef ADUC_TLS_SESSION_CACHE_UTILS_H
+#define ADUC_TLS_SESSION_CACHE_UTILS_H
+
+#include <aduc/c_utils.h>
+#include <limits.h> // PATH_MAX
+#include <parson.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h> // off_t
+#include <time.h>
+
+EXTERN_C_BEGIN
+
+/**
+ * @brief Name of the cache folder in the agent data folder.
+ */
+#define ADUC_TLS_SESSION_CACHE_FOLDER_NAME "tlssessions"
+
+/**
+ * @brief Maximum number of configured credential files.
+ */
+#define ADUC_TLS_SESSION_CACHE_MAX_CREDENTIAL_FILES 8
+
+/**
+ * @brief Default and maximum of the policy limits.
+ */
+#define ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_AGE_SECONDS 7200
+#define ADUC_TLS_SESSION_CACHE_MAX_MAX_AGE_SECONDS (7 * 24 * 3600)
+#define ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_ENDPOINTS 16
+#define ADUC_TLS_SESSION_CACHE_MAX_MAX_ENDPOINTS 256
+#define ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_FILE_KB 64
+#define ADUC_TLS_SESSION_CACHE_MAX_MAX_FILE_KB 1024
+
+/**
+ * @brief The CA bundle of curl, the default credential file.
+ */
+#define ADUC_TLS_SESSION_CACHE_DEFAULT_CREDENTIAL_FILE "/etc/ssl/certs/ca-certificates.crt"
+
+/**
+ * @brief The first curl version that supports --ssl-sessions.
+ */
+#define ADUC_TLS_SESSION_CACHE_MIN_CURL_MAJOR 8
+#define ADUC_TLS_SESSION_CACHE_MIN_CURL_MINOR 12
+
+/**
+ * @brief The feature of `curl --version` that curl lists if its TLS backend can export sessions.
+ */
+#define ADUC_TLS_SESSION_CACHE_CURL_FEATURE "SSLS-EXPORT"
+
+/**
+ * @brief The cache policy.
+ */
+typedef struct tagADUC_TlsSessionCache_Policy
+{
+    bool enabled; /**< True if "tlsSessionCache" is configured. */
+    unsigned int maxAgeSeconds; /**< Age after which a session file is removed. */
+    unsigned int maxEndpoints; /**< Number of session files that are kept. */
+    unsigned int maxFileBytes; /**< Size above which a session file is removed. */
+    size_t credentialFileCount; /**< Number of entries in credentialFiles. */
+    char credentialFiles[ADUC_TLS_SESSION_CACHE_MAX_CREDENTIAL_FILES][PATH_MAX]; /**< Credential files. */
+} ADUC_TlsSessionCache_Policy;
+
+/**
+ * @brief The identity of a credential file, to notice a change without hashing it again.
+ */
+typedef struct tagADUC_TlsSessionCache_FileStamp
+{
+    bool exists; /**< True if the file existed. */
+    dev_t device; /**< Device of the file. */
+    ino_t inode; /**< Inode of the file. */
+    off_t size; /**< Size of the file. */
+    time_t changed; /**< Status change time of the file, seconds part. */
+    long changedNanoseconds; /**< Status change time of the file, nanoseconds part. */
+} ADUC_TlsSessionCache_FileStamp;
+
+/**
+ * @brief An open cache.
+ */
+typedef struct tagADUC_TlsSessionCache
+{
+    bool isOpen; /**< True if the cache is usable. */
+    ADUC_TlsSessionCache_Policy policy; /**< The policy. */
+    char folder[PATH_MAX]; /**< The cache folder. */
+    char* salt; /**< Text that is part of the fingerprint besides the credentials, e.g. the curl version. */
+    ADUC_TlsSessionCache_FileStamp stamps[ADUC_TLS_SESSION_CACHE_MAX_CREDENTIAL_FILES]; /**< Credential stamps. */
+} ADUC_TlsSessionCache;
+
+/**
+ * @brief Parses the "tlsSessionCache" configuration object.
+ *
+ * @param policy The policy to initialize.
+ * @param cacheObj The configuration object, or NULL if not configured.
+ * @return true on success. On failure, @p policy is disabled.
+ */
+bool ADUC_TlsSessionCache_ParsePolicy(ADUC_TlsSessionCache_Policy* policy, const JSON_Object* cacheObj);
+
+/**
+ * @brief Checks whether the curl of a `curl --version` output supports --ssl-sessions.
+ *
+ * @param versionOutput The output of `curl --version`.
+ * @return true if the curl version is ADUC_TLS_SESSION_CACHE_MIN_CURL_MAJOR.ADUC_TLS_SESSION_CACHE_MIN_CURL_MINOR
+ * or later, and its "Features:" line lists ADUC_TLS_SESSION_CACHE_CURL_FEATURE.
+ */
+bool ADUC_TlsSessionCache_IsCurlSupported(const char* versionOutput);
+
+/**
+ * @brief Gets the endpoint of an https URL as a file name, "<host>_<port>".
+ *
+ * @param url The URL.
+ * @param name The buffer for the name. Characters other than letters, digits, '.' and '-' become '_'.
+ * @param nameSize The size of @p name.
+ * @return false if @p url is not an https URL with a host, or the name does not fit into @p name.
+ */
+bool ADUC_TlsSessionCache_GetEndpointName(const char* url, char* name, size_t nameSize);
+
+/**
+ * @brief Opens the cache in @p folder.
+ *
+ * Creates the folder accessible by the owner only, and drops all sessions if the credential fingerprint
+ * differs from the one the sessions were stored with.
+ *
+ * @param cache The cache to initialize.
+ * @param policy The enabled policy.
+ * @param folder The cache folder. It must not be a symbolic link, and must be owned by the effective user.
+ * @param salt Text that is part of the fingerprint besides the credential files, e.g. the first line of
+ * `curl --version`. May be NULL.
+ * @return true on success. On failure, the cache stays closed and all calls on it are no-ops.
+ */
+bool ADUC_TlsSessionCache_Open(
+    ADUC_TlsSessionCache* cache, const ADUC_TlsSessionCache_Policy* policy, const char* folder, const char* salt);
+
+/**
+ * @brief Opens the cache of curl downloads in the agent data folder, if curl supports it.
+ *
+ * @param cache The cache to initialize.
+ * @param policy The policy. Nothing is opened if it is disabled.
+ * @param dataFolder The agent data folder. The cache is its ADUC_TLS_SESSION_CACHE_FOLDER_NAME subfolder.
+ * @param curlVersionOutput The output of `curl --version`. Its first line is the salt of the fingerprint.
+ * @return true if the cache is open.
+ */
+bool ADUC_TlsSessionCache_OpenForCurl(
+    ADUC_TlsSessionCache* cache,
+    const ADUC_TlsSessionCache_Policy* policy,
+    const char* dataFolder,
+    const char* curlVersionOutput);
+
+/**
+ * @brief Closes the cache. The session files stay for the next process.
+ *
+ * @param cache The cache.
+ */
+void ADUC_TlsSessionCache_Close(ADUC_TlsSessionCache* cache);
+
+/**
+ * @brief Gets the session file of the endpoint of @p url, to be passed to curl with --ssl-sessions.
+ *
+ * Drops all sessions if a credential file changed, removes the session file of the endpoint if it is expired
+ * or too large, and evicts the oldest session files if the endpoint has none and the cache is full.
+ *
+ * @param cache The cache.
+ * @param url The download URL.
+ * @param path The buffer for the session file path.
+ * @param pathSize The size of @p path.
+ * @return false if the cache is closed, or @p url is not an https URL.
+ */
+bool ADUC_TlsSessionCache_GetSessionFile(ADUC_TlsSessionCache* cache, const char* url, char* path, size_t pathSize);
+
+/**
+ * @brief Finishes a transfer with the session file @p path.
+ *
+ * Restricts the session file that curl wrote to the owner, and removes it if it is too large, or if the
+ * transfer failed with a TLS error.
+ *
+ * @param cache The cache.
+ * @param path The session file from ADUC_TlsSessionCache_GetSessionFile.
+ * @param curlExitCode The exit code of curl.
+ */
+void ADUC_TlsSessionCache_FinishTransfer(ADUC_TlsSessionCache* cache, const char* path, int curlExitCode);
+
+/**
+ * @brief Removes all session files.
+ *
+ * @param cache The cache.
+ */
+void ADUC_TlsSessionCache_Clear(ADUC_TlsSessionCache* cache);
+
+EXTERN_C_END
+
+#endif // ADUC_TLS_SESSION_CACHE_UTILS_H
@@ -0,0 +1,769 @@
+/**
+ * @file tls_session_cache_utils.c
+ * @brief Implements the persisted TLS session cache of download connections.
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/tls_session_cache_utils.h"
+#include "aduc/hash_utils.h" // ADUC_HashUtils_GetFileHash
+#include "aduc/logging.h"
+#include "aduc/string_c_utils.h" // ADUC_Safe_StrCopyN, ADUC_StringFormat
+
+#include <ctype.h> // isalnum, isdigit, tolower
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h> // open
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h> // geteuid, unlink
+
+// keep this last to avoid interfering with system headers
+#include "aduc/aduc_banned.h"
+
+static const char* CONFIG_TLS_SESSION_CACHE = "tlsSessionCache";
+static const char* CONFIG_MAX_AGE_SECONDS = "maxAgeSeconds";
+static const char* CONFIG_MAX_ENDPOINTS = "maxEndpoints";
+static const char* CONFIG_MAX_FILE_KB = "maxFileKB";
+static const char* CONFIG_CREDENTIAL_FILES = "credentialFiles";
+
+static const char* HTTPS_SCHEME = "https://";
+static const char* CURL_FEATURES_PREFIX = "Features:";
+static const char* SESSION_FILE_SUFFIX = ".sessions";
+static const char* FINGERPRINT_FILE_NAME = "fingerprint";
+
+/**
+ * @brief The curl exit codes of a failed TLS handshake or certificate check, after which the session
+ * of the endpoint is not reused.
+ */
+static const int s_curlTlsExitCodes[] = {
+    35, // CURLE_SSL_CONNECT_ERROR
+    51, // CURLE_PEER_FAILED_VERIFICATION, before curl 7.62
+    53, // CURLE_SSL_ENGINE_NOTFOUND
+    54, // CURLE_SSL_ENGINE_SETFAILED
+    58, // CURLE_SSL_CERTPROBLEM
+    59, // CURLE_SSL_CIPHER
+    60, // CURLE_PEER_FAILED_VERIFICATION
+    66, // CURLE_SSL_ENGINE_INITFAILED
+    77, // CURLE_SSL_CACERT_BADFILE
+    80, // CURLE_SSL_SHUTDOWN_FAILED
+    82, // CURLE_SSL_CRL_BADFILE
+    83, // CURLE_SSL_ISSUER_ERROR
+    90, // CURLE_SSL_PINNEDPUBKEYNOTMATCH
+    91, // CURLE_SSL_INVALIDCERTSTATUS
+    98, // CURLE_SSL_CLIENTCERT
+};
+
+/**
+ * @brief Reads a positive integer field.
+ *
+ * @return false if the field is present but not a number in [1, @p maxValue].
+ */
+static bool GetUIntField(const JSON_Object* obj, const char* name, unsigned int maxValue, unsigned int* value)
+{
+    if (!json_object_has_value(obj, name))
+    {
+        return true;
+    }
+
+    if (!json_object_has_value_of_type(obj, name, JSONNumber))
+    {
+        return false;
+    }
+
+    double number = json_object_get_number(obj, name);
+    if (number < 1 || number > (double)maxValue)
+    {
+        return false;
+    }
+
+    *value = (unsigned int)number;
+    return true;
+}
+
+static void AddCredentialFile(ADUC_TlsSessionCache_Policy* policy, const char* path)
+{
+    char* credentialFile = policy->credentialFiles[policy->credentialFileCount++];
+    ADUC_Safe_StrCopyN(credentialFile, path, PATH_MAX, strlen(path));
+}
+
+bool ADUC_TlsSessionCache_ParsePolicy(ADUC_TlsSessionCache_Policy* policy, const JSON_Object* cacheObj)
+{
+    bool succeeded = false;
+    unsigned int maxFileKB = ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_FILE_KB;
+
+    memset(policy, 0, sizeof(*policy));
+
+    if (cacheObj == NULL)
+    {
+        return true;
+    }
+
+    policy->maxAgeSeconds = ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_AGE_SECONDS;
+    policy->maxEndpoints = ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_ENDPOINTS;
+
+    if (!GetUIntField(
+            cacheObj, CONFIG_MAX_AGE_SECONDS, ADUC_TLS_SESSION_CACHE_MAX_MAX_AGE_SECONDS, &policy->maxAgeSeconds)
+        || !GetUIntField(
+            cacheObj, CONFIG_MAX_ENDPOINTS, ADUC_TLS_SESSION_CACHE_MAX_MAX_ENDPOINTS, &policy->maxEndpoints)
+        || !GetUIntField(cacheObj, CONFIG_MAX_FILE_KB, ADUC_TLS_SESSION_CACHE_MAX_MAX_FILE_KB, &maxFileKB))
+    {
+        Log_Error("Invalid %s, expected positive times, counts and sizes.", CONFIG_TLS_SESSION_CACHE);
+        goto done;
+    }
+
+    if (json_object_has_value(cacheObj, CONFIG_CREDENTIAL_FILES))
+    {
+        const JSON_Array* credentialFiles = json_object_get_array(cacheObj, CONFIG_CREDENTIAL_FILES);
+        const size_t count = json_array_get_count(credentialFiles);
+        if (credentialFiles == NULL || count > ADUC_TLS_SESSION_CACHE_MAX_CREDENTIAL_FILES)
+        {
+            Log_Error(
+                "Invalid %s.%s, expected an array of at most %d paths.",
+                CONFIG_TLS_SESSION_CACHE,
+                CONFIG_CREDENTIAL_FILES,
+                ADUC_TLS_SESSION_CACHE_MAX_CREDENTIAL_FILES);
+            goto done;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const char* path = json_array_get_string(credentialFiles, i);
+            if (path == NULL || *path != '/' || strlen(path) >= PATH_MAX)
+            {
+                Log_Error(
+                    "Invalid %s.%s entry, expected an absolute path.",
+                    CONFIG_TLS_SESSION_CACHE,
+                    CONFIG_CREDENTIAL_FILES);
+                goto done;
+            }
+
+            AddCredentialFile(policy, path);
+        }
+    }
+    else
+    {
+        AddCredentialFile(policy, ADUC_TLS_SESSION_CACHE_DEFAULT_CREDENTIAL_FILE);
+    }
+
+    policy->maxFileBytes = maxFileKB * 1024;
+    policy->enabled = true;
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        memset(policy, 0, sizeof(*policy));
+    }
+
+    return succeeded;
+}
+
+/**
+ * @brief Checks whether the "Features:" line of a `curl --version` output lists @p feature.
+ */
+static bool HasCurlFeature(const char* versionOutput, const char* feature)
+{
+    const size_t featureLength = strlen(feature);
+
+    for (const char* line = versionOutput; *line != '\0'; line += strspn(line, "\r\n"))
+    {
+        const size_t lineLength = strcspn(line, "\r\n");
+
+        if (strncmp(line, CURL_FEATURES_PREFIX, strlen(CURL_FEATURES_PREFIX)) == 0)
+        {
+            const char* end = line + lineLength;
+
+            for (const char* word = line + strlen(CURL_FEATURES_PREFIX); word < end;)
+            {
+                const size_t wordLength = strcspn(word, " \t\r\n");
+                if (wordLength == featureLength && strncmp(word, feature, featureLength) == 0)
+                {
+                    return true;
+                }
+
+                word += wordLength;
+                word += strspn(word, " \t");
+            }
+        }
+
+        line += lineLength;
+    }
+
+    return false;
+}
+
+bool ADUC_TlsSessionCache_IsCurlSupported(const char* versionOutput)
+{
+    unsigned int major = 0;
+    unsigned int minor = 0;
+
+    if (versionOutput == NULL || sscanf(versionOutput, "curl %u.%u", &major, &minor) != 2)
+    {
+        return false;
+    }
+
+    if (major < ADUC_TLS_SESSION_CACHE_MIN_CURL_MAJOR
+        || (major == ADUC_TLS_SESSION_CACHE_MIN_CURL_MAJOR && minor < ADUC_TLS_SESSION_CACHE_MIN_CURL_MINOR))
+    {
+        return false;
+    }
+
+    // The option also needs a TLS backend that can export sessions.
+    return HasCurlFeature(versionOutput, ADUC_TLS_SESSION_CACHE_CURL_FEATURE);
+}
+
+static bool HasHttpsScheme(const char* url)
+{
+    for (const char* scheme = HTTPS_SCHEME; *scheme != '\0'; ++scheme, ++url)
+    {
+        if (tolower((unsigned char)*url) != *scheme)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool ADUC_TlsSessionCache_GetEndpointName(const char* url, char* name, size_t nameSize)
+{
+    if (url == NULL || !HasHttpsScheme(url))
+    {
+        return false;
+    }
+
+    const char* start = url + strlen(HTTPS_SCHEME);
+    const char* end = start + strcspn(start, "/?#");
+
+    // Skip user info.
+    for (const char* p = start; p < end; ++p)
+    {
+        if (*p == '@')
+        {
+            start = p + 1;
+        }
+    }
+
+    const char* hostEnd = NULL;
+    const char* portStart = NULL;
+    if (*start == '[')
+    {
+        ++start;
+        hostEnd = memchr(start, ']', (size_t)(end - start));
+        if (hostEnd == NULL)
+        {
+            return false;
+        }
+
+        portStart = (hostEnd + 1 < end && hostEnd[1] == ':') ? hostEnd + 2 : NULL;
+    }
+    else
+    {
+        hostEnd = memchr(start, ':', (size_t)(end - start));
+        portStart = (hostEnd != NULL) ? hostEnd + 1 : NULL;
+        if (hostEnd == NULL)
+        {
+            hostEnd = end;
+        }
+    }
+
+    const size_t hostLength = (size_t)(hostEnd - start);
+    const char* port = "443";
+    size_t portLength = 3;
+
+    if (portStart != NULL && portStart < end)
+    {
+        port = portStart;
+        portLength = (size_t)(end - portStart);
+        for (size_t i = 0; i < portLength; ++i)
+        {
+            if (!isdigit((unsigned char)port[i]))
+            {
+                return false;
+            }
+        }
+    }
+
+    // <host>_<port> and the terminator.
+    if (hostLength == 0 || hostLength + 1 + portLength + 1 > nameSize)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < hostLength; ++i)
+    {
+        const char c = start[i];
+        name[i] = (char)((isalnum((unsigned char)c) || c == '.' || c == '-') ? tolower((unsigned char)c) : '_');
+    }
+
+    name[hostLength] = '_';
+    memcpy(name + hostLength + 1, port, portLength);
+    name[hostLength + 1 + portLength] = '\0';
+    return true;
+}
+
+static bool IsSessionFileName(const char* name)
+{
+    const size_t length = strlen(name);
+    const size_t suffixLength = strlen(SESSION_FILE_SUFFIX);
+    return length > suffixLength && strcmp(name + length - suffixLength, SESSION_FILE_SUFFIX) == 0;
+}
+
+static void GetFileStamp(const char* path, ADUC_TlsSessionCache_FileStamp* stamp)
+{
+    struct stat st;
+
+    memset(stamp, 0, sizeof(*stamp));
+    if (stat(path, &st) == 0)
+    {
+        stamp->exists = true;
+        stamp->device = st.st_dev;
+        stamp->inode = st.st_ino;
+        stamp->size = st.st_size;
+        // The status change time also changes on a rewrite of the same size within the same second.
+        stamp->changed = st.st_ctim.tv_sec;
+        stamp->changedNanoseconds = st.st_ctim.tv_nsec;
+    }
+}
+
+/**
+ * @brief Builds the fingerprint of the salt and the content of the credential files, and records their stamps.
+ *
+ * @return char* The fingerprint, or NULL on failure. The caller frees it.
+ */
+static char* ComputeFingerprint(ADUC_TlsSessionCache* cache)
+{
+    char* fingerprint = ADUC_StringFormat("%s\n", cache->salt != NULL ? cache->salt : "");
+
+    for (size_t i = 0; fingerprint != NULL && i < cache->policy.credentialFileCount; ++i)
+    {
+        const char* path = cache->policy.credentialFiles[i];
+        char* hash = NULL;
+
+        GetFileStamp(path, &cache->stamps[i]);
+        if (cache->stamps[i].exists && !ADUC_HashUtils_GetFileHash(path, SHA256, &hash))
+        {
+            Log_Warn("Cannot hash TLS credential file %s.", path);
+        }
+
+        char* line = ADUC_StringFormat("%s%s %s\n", fingerprint, path, hash != NULL ? hash : "-");
+        free(hash);
+        free(fingerprint);
+        fingerprint = line;
+    }
+
+    return fingerprint;
+}
+
+static char* GetFolderFilePath(const ADUC_TlsSessionCache* cache, const char* name)
+{
+    return ADUC_StringFormat("%s/%s", cache->folder, name);
+}
+
+/**
+ * @brief Reads the fingerprint the session files were stored with.
+ *
+ * @return char* The fingerprint, or NULL if there is none. The caller frees it.
+ */
+static char* ReadFingerprint(const ADUC_TlsSessionCache* cache)
+{
+    char* fingerprint = NULL;
+    char* path = GetFolderFilePath(cache, FINGERPRINT_FILE_NAME);
+    FILE* file = NULL;
+    long size = 0;
+
+    if (path == NULL)
+    {
+        goto done;
+    }
+
+    file = fopen(path, "rb");
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+    {
+        goto done;
+    }
+
+    fingerprint = malloc((size_t)size + 1);
+    if (fingerprint == NULL)
+    {
+        goto done;
+    }
+
+    if (fread(fingerprint, 1, (size_t)size, file) != (size_t)size)
+    {
+        free(fingerprint);
+        fingerprint = NULL;
+        goto done;
+    }
+
+    fingerprint[size] = '\0';
+
+done:
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+
+    free(path);
+    return fingerprint;
+}
+
+static bool WriteFingerprint(const ADUC_TlsSessionCache* cache, const char* fingerprint)
+{
+    bool succeeded = false;
+    char* path = GetFolderFilePath(cache, FINGERPRINT_FILE_NAME);
+    int fd = -1;
+    const size_t length = strlen(fingerprint);
+
+    if (path == NULL)
+    {
+        goto done;
+    }
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1 || write(fd, fingerprint, length) != (ssize_t)length)
+    {
+        Log_Warn("Cannot write TLS session cache fingerprint %s, errno: %d", path, errno);
+        goto done;
+    }
+
+    succeeded = true;
+
+done:
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    free(path);
+    return succeeded;
+}
+
+/**
+ * @brief Drops all sessions if the fingerprint differs from the stored one, and stores the new fingerprint.
+ */
+static bool SyncFingerprint(ADUC_TlsSessionCache* cache)
+{
+    bool succeeded = false;
+    char* fingerprint = ComputeFingerprint(cache);
+    char* storedFingerprint = ReadFingerprint(cache);
+
+    if (fingerprint == NULL)
+    {
+        goto done;
+    }
+
+    if (storedFingerprint != NULL && strcmp(fingerprint, storedFingerprint) == 0)
+    {
+        succeeded = true;
+        goto done;
+    }
+
+    if (storedFingerprint != NULL)
+    {
+        Log_Info("TLS credentials or curl changed, dropping the TLS sessions.");
+    }
+
+    ADUC_TlsSessionCache_Clear(cache);
+    succeeded = WriteFingerprint(cache, fingerprint);
+
+done:
+    free(storedFingerprint);
+    free(fingerprint);
+    return succeeded;
+}
+
+static bool HaveCredentialsChanged(const ADUC_TlsSessionCache* cache)
+{
+    for (size_t i = 0; i < cache->policy.credentialFileCount; ++i)
+    {
+        ADUC_TlsSessionCache_FileStamp stamp;
+        GetFileStamp(cache->policy.credentialFiles[i], &stamp);
+        if (memcmp(&stamp, &cache->stamps[i], sizeof(stamp)) != 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool IsUsableSessionFile(const ADUC_TlsSessionCache* cache, const struct stat* st, time_t now)
+{
+    return S_ISREG(st->st_mode) && st->st_size <= (off_t)cache->policy.maxFileBytes
+        && st->st_mtime <= now && now - st->st_mtime < (time_t)cache->policy.maxAgeSeconds;
+}
+
+/**
+ * @brief Removes the unusable session files, and the oldest ones while there are more than @p maxCount.
+ */
+static void PruneSessionFiles(const ADUC_TlsSessionCache* cache, size_t maxCount)
+{
+    const time_t now = time(NULL);
+
+    for (;;)
+    {
+        DIR* dir = opendir(cache->folder);
+        if (dir == NULL)
+        {
+            return;
+        }
+
+        size_t count = 0;
+        char oldestName[NAME_MAX + 1] = "";
+        time_t oldestTime = 0;
+        const struct dirent* entry = NULL;
+
+        while ((entry = readdir(dir)) != NULL)
+        {
+            struct stat st;
+            if (!IsSessionFileName(entry->d_name)
+                || fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            {
+                continue;
+            }
+
+            if (!IsUsableSessionFile(cache, &st, now))
+            {
+                unlinkat(dirfd(dir), entry->d_name, 0);
+                continue;
+            }
+
+            if (count == 0 || st.st_mtime < oldestTime)
+            {
+                oldestTime = st.st_mtime;
+                ADUC_Safe_StrCopyN(oldestName, entry->d_name, sizeof(oldestName), strlen(entry->d_name));
+            }
+
+            ++count;
+        }
+
+        if (count > maxCount)
+        {
+            Log_Debug("TLS session cache is full, evicting %s.", oldestName);
+            unlinkat(dirfd(dir), oldestName, 0);
+        }
+
+        closedir(dir);
+
+        if (count <= maxCount + 1)
+        {
+            return;
+        }
+    }
+}
+
+bool ADUC_TlsSessionCache_Open(
+    ADUC_TlsSessionCache* cache, const ADUC_TlsSessionCache_Policy* policy, const char* folder, const char* salt)
+{
+    bool succeeded = false;
+    struct stat st;
+
+    memset(cache, 0, sizeof(*cache));
+
+    if (policy == NULL || !policy->enabled || folder == NULL || strlen(folder) >= sizeof(cache->folder))
+    {
+        goto done;
+    }
+
+    cache->policy = *policy;
+    ADUC_Safe_StrCopyN(cache->folder, folder, sizeof(cache->folder), strlen(folder));
+
+    if (salt != NULL)
+    {
+        cache->salt = ADUC_StringFormat("%s", salt);
+        if (cache->salt == NULL)
+        {
+            goto done;
+        }
+    }
+
+    if (mkdir(folder, S_IRWXU) != 0 && errno != EEXIST)
+    {
+        Log_Error("Cannot create TLS session cache folder %s, errno: %d", folder, errno);
+        goto done;
+    }
+
+    // Sessions are secrets: only a folder of our own that nobody else can access is used.
+    if (lstat(folder, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid())
+    {
+        Log_Error("TLS session cache folder %s is not a folder owned by the agent.", folder);
+        goto done;
+    }
+
+    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0 && chmod(folder, S_IRWXU) != 0)
+    {
+        Log_Error("Cannot restrict TLS session cache folder %s, errno: %d", folder, errno);
+        goto done;
+    }
+
+    cache->isOpen = true;
+
+    if (!SyncFingerprint(cache))
+    {
+        goto done;
+    }
+
+    PruneSessionFiles(cache, cache->policy.maxEndpoints);
+    succeeded = true;
+
+done:
+    if (!succeeded)
+    {
+        ADUC_TlsSessionCache_Close(cache);
+    }
+
+    return succeeded;
+}
+
+bool ADUC_TlsSessionCache_OpenForCurl(
+    ADUC_TlsSessionCache* cache,
+    const ADUC_TlsSessionCache_Policy* policy,
+    const char* dataFolder,
+    const char* curlVersionOutput)
+{
+    bool succeeded = false;
+    char* folder = NULL;
+    char* salt = NULL;
+
+    memset(cache, 0, sizeof(*cache));
+
+    if (!policy->enabled || dataFolder == NULL)
+    {
+        goto done;
+    }
+
+    if (!ADUC_TlsSessionCache_IsCurlSupported(curlVersionOutput))
+    {
+        Log_Warn("curl does not support --ssl-sessions, TLS sessions are not cached.");
+        goto done;
+    }
+
+    folder = ADUC_StringFormat("%s/%s", dataFolder, ADUC_TLS_SESSION_CACHE_FOLDER_NAME);
+    salt = ADUC_StringFormat("%.*s", (int)strcspn(curlVersionOutput, "\r\n"), curlVersionOutput);
+    if (folder == NULL || salt == NULL)
+    {
+        goto done;
+    }
+
+    succeeded = ADUC_TlsSessionCache_Open(cache, policy, folder, salt);
+    if (succeeded)
+    {
+        Log_Info("Caching TLS sessions of downloads in %s.", folder);
+    }
+
+done:
+    free(salt);
+    free(folder);
+    return succeeded;
+}
+
+void ADUC_TlsSessionCache_Close(ADUC_TlsSessionCache* cache)
+{
+    free(cache->salt);
+    memset(cache, 0, sizeof(*cache));
+}
+
+bool ADUC_TlsSessionCache_GetSessionFile(ADUC_TlsSessionCache* cache, const char* url, char* path, size_t pathSize)
+{
+    char name[NAME_MAX + 1];
+    struct stat st;
+
+    if (!cache->isOpen
+        || !ADUC_TlsSessionCache_GetEndpointName(url, name, sizeof(name) - strlen(SESSION_FILE_SUFFIX)))
+    {
+        return false;
+    }
+
+    const int length = snprintf(path, pathSize, "%s/%s%s", cache->folder, name, SESSION_FILE_SUFFIX);
+    if (length < 0 || (size_t)length >= pathSize)
+    {
+        return false;
+    }
+
+    if (HaveCredentialsChanged(cache) && !SyncFingerprint(cache))
+    {
+        ADUC_TlsSessionCache_Clear(cache);
+        return false;
+    }
+
+    if (lstat(path, &st) == 0)
+    {
+        if (IsUsableSessionFile(cache, &st, time(NULL)))
+        {
+            return true;
+        }
+
+        Log_Debug("Dropping expired TLS sessions of %s.", name);
+        unlink(path);
+    }
+
+    // Make room for the session file curl is about to write.
+    PruneSessionFiles(cache, cache->policy.maxEndpoints - 1);
+    return true;
+}
+
+static bool IsTlsFailure(int curlExitCode)
+{
+    for (size_t i = 0; i < sizeof(s_curlTlsExitCodes) / sizeof(s_curlTlsExitCodes[0]); ++i)
+    {
+        if (s_curlTlsExitCodes[i] == curlExitCode)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ADUC_TlsSessionCache_FinishTransfer(ADUC_TlsSessionCache* cache, const char* path, int curlExitCode)
+{
+    struct stat st;
+
+    if (!cache->isOpen || path == NULL || lstat(path, &st) != 0)
+    {
+        return;
+    }
+
+    if (IsTlsFailure(curlExitCode))
+    {
+        Log_Info("TLS failure, curl exit code: %d. Dropping the TLS sessions of the endpoint.", curlExitCode);
+        unlink(path);
+        return;
+    }
+
+    if (!S_ISREG(st.st_mode) || st.st_size > (off_t)cache->policy.maxFileBytes)
+    {
+        Log_Warn("Dropping TLS session file %s of unexpected type or size.", path);
+        unlink(path);
+        return;
+    }
+
+    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+    {
+        chmod(path, S_IRUSR | S_IWUSR);
+    }
+}
+
+void ADUC_TlsSessionCache_Clear(ADUC_TlsSessionCache* cache)
+{
+    DIR* dir = cache->isOpen ? opendir(cache->folder) : NULL;
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    const struct dirent* entry = NULL;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (IsSessionFileName(entry->d_name))
+        {
+            unlinkat(dirfd(dir), entry->d_name, 0);
+        }
+    }
+
+    closedir(dir);
+}
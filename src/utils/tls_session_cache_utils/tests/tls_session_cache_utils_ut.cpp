@@ -0,0 +1,454 @@
+/**
+ * @file tls_session_cache_utils_ut.cpp
+ * @brief Unit Tests for tls_session_cache_utils library
+ *
+ * @copyright Copyright (c) F&S Elektronik Systeme.
+ * Licensed under the MIT License.
+ */
+#include "aduc/tls_session_cache_utils.h"
+
+#include <aduc/auto_dir.hpp> // aduc::AutoDir
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <parson.h>
+#include <signal.h> // kill
+#include <stdio.h> // popen
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/time.h> // utimes
+#include <sys/wait.h> // waitpid
+#include <unistd.h>
+
+#define TEST_DIR "/tmp/adutest/tls_session_cache_utils_ut"
+
+static bool ParsePolicy(ADUC_TlsSessionCache_Policy* policy, const char* json)
+{
+    JSON_Value* value = json_parse_string(json);
+    REQUIRE(value != nullptr);
+    bool parsed = ADUC_TlsSessionCache_ParsePolicy(policy, json_value_get_object(value));
+    json_value_free(value);
+    return parsed;
+}
+
+static bool Exists(const std::string& path)
+{
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+static void WriteFile(const std::string& path, const std::string& content)
+{
+    std::ofstream{ path, std::ios::binary | std::ios::trunc } << content;
+}
+
+static void SetAge(const std::string& path, time_t ageSeconds)
+{
+    struct timeval times[2] = {};
+    times[0].tv_sec = time(nullptr) - ageSeconds;
+    times[1].tv_sec = times[0].tv_sec;
+    REQUIRE(utimes(path.c_str(), times) == 0);
+}
+
+/**
+ * @brief A temporary folder with a credential file, and the cache folder in it.
+ */
+class TestFolder
+{
+public:
+    TestFolder() : _dir(TEST_DIR)
+    {
+        REQUIRE(_dir.RemoveDir());
+        REQUIRE(_dir.CreateDir());
+        WriteFile(CredentialFile(), "CA 1");
+    }
+
+    TestFolder(const TestFolder&) = delete;
+    TestFolder& operator=(const TestFolder&) = delete;
+    TestFolder(TestFolder&&) = delete;
+    TestFolder& operator=(TestFolder&&) = delete;
+
+    std::string CredentialFile() const
+    {
+        return _dir.GetDir() + "/ca.pem";
+    }
+
+    std::string DataFolder() const
+    {
+        return _dir.GetDir();
+    }
+
+    std::string CacheFolder() const
+    {
+        return _dir.GetDir() + "/" ADUC_TLS_SESSION_CACHE_FOLDER_NAME;
+    }
+
+    std::string Policy(const char* limits) const
+    {
+        return std::string{ R"({"credentialFiles":[")" } + CredentialFile() + R"("])" + limits + "}";
+    }
+
+private:
+    aduc::AutoDir _dir; // auto rmdir on scope exit
+};
+
+/**
+ * @brief Gets the session file of @p url, in which curl would store the sessions.
+ */
+static std::string GetSessionFile(ADUC_TlsSessionCache* cache, const char* url)
+{
+    char path[PATH_MAX];
+    REQUIRE(ADUC_TlsSessionCache_GetSessionFile(cache, url, path, sizeof(path)));
+    return path;
+}
+
+/**
+ * @brief Stores a session for @p url, as curl does at the end of a transfer.
+ */
+static std::string StoreSession(ADUC_TlsSessionCache* cache, const char* url)
+{
+    const std::string path = GetSessionFile(cache, url);
+    WriteFile(path, "session");
+    ADUC_TlsSessionCache_FinishTransfer(cache, path.c_str(), 0);
+    return path;
+}
+
+TEST_CASE("ADUC_TlsSessionCache_ParsePolicy")
+{
+    ADUC_TlsSessionCache_Policy policy;
+
+    SECTION("Not configured")
+    {
+        REQUIRE(ADUC_TlsSessionCache_ParsePolicy(&policy, nullptr));
+        CHECK_FALSE(policy.enabled);
+    }
+
+    SECTION("Defaults")
+    {
+        REQUIRE(ParsePolicy(&policy, "{}"));
+        CHECK(policy.enabled);
+        CHECK(policy.maxAgeSeconds == ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_AGE_SECONDS);
+        CHECK(policy.maxEndpoints == ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_ENDPOINTS);
+        CHECK(policy.maxFileBytes == ADUC_TLS_SESSION_CACHE_DEFAULT_MAX_FILE_KB * 1024);
+        REQUIRE(policy.credentialFileCount == 1);
+        CHECK(std::string{ policy.credentialFiles[0] } == ADUC_TLS_SESSION_CACHE_DEFAULT_CREDENTIAL_FILE);
+    }
+
+    SECTION("All fields")
+    {
+        REQUIRE(ParsePolicy(
+            &policy,
+            R"({"maxAgeSeconds":600,"maxEndpoints":4,"maxFileKB":8,)"
+            R"("credentialFiles":["/etc/aduc/ca.pem","/etc/aduc/client.pem"]})"));
+        CHECK(policy.maxAgeSeconds == 600);
+        CHECK(policy.maxEndpoints == 4);
+        CHECK(policy.maxFileBytes == 8 * 1024);
+        REQUIRE(policy.credentialFileCount == 2);
+        CHECK(std::string{ policy.credentialFiles[1] } == "/etc/aduc/client.pem");
+    }
+
+    SECTION("Invalid fields")
+    {
+        CHECK_FALSE(ParsePolicy(&policy, R"({"maxAgeSeconds":0})"));
+        CHECK_FALSE(policy.enabled);
+        CHECK_FALSE(ParsePolicy(&policy, R"({"maxAgeSeconds":604801})"));
+        CHECK_FALSE(ParsePolicy(&policy, R"({"maxEndpoints":"4"})"));
+        CHECK_FALSE(ParsePolicy(&policy, R"({"maxFileKB":-1})"));
+        CHECK_FALSE(ParsePolicy(&policy, R"({"credentialFiles":"/etc/aduc/ca.pem"})"));
+        CHECK_FALSE(ParsePolicy(&policy, R"({"credentialFiles":["ca.pem"]})"));
+        CHECK_FALSE(ParsePolicy(&policy, R"({"credentialFiles":["/1","/2","/3","/4","/5","/6","/7","/8","/9"]})"));
+    }
+}
+
+TEST_CASE("ADUC_TlsSessionCache_IsCurlSupported")
+{
+    CHECK(ADUC_TlsSessionCache_IsCurlSupported(
+        "curl 8.12.0 (x86_64-pc-linux-gnu) libcurl/8.12.0 OpenSSL/3.0.15\n"
+        "Release-Date: 2025-02-05\n"
+        "Protocols: file http https\n"
+        "Features: alt-svc AsynchDNS HSTS HTTP2 HTTPS-proxy IPv6 Largefile libz SSL SSLS-EXPORT threadsafe\n"));
+    CHECK(ADUC_TlsSessionCache_IsCurlSupported("curl 9.0.1 (aarch64-unknown-linux-gnu)\r\nFeatures: SSLS-EXPORT\r\n"));
+
+    // A TLS backend that cannot export sessions.
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported(
+        "curl 8.12.0 (arm-poky-linux-gnueabi) libcurl/8.12.0 mbedTLS/2.28.8\n"
+        "Features: AsynchDNS HTTPS-proxy IPv6 SSL SSLS-EXPORTS\n"));
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported("curl 8.12.0 (x86_64-pc-linux-gnu)\nProtocols: SSLS-EXPORT\n"));
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported("curl 8.12.0 (x86_64-pc-linux-gnu) libcurl/8.12.0"));
+
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported("curl 8.11.1 (arm-poky-linux-gnueabi)\nFeatures: SSLS-EXPORT\n"));
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported("curl 7.88.1 (x86_64-pc-linux-gnu)"));
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported("wget 1.21"));
+    CHECK_FALSE(ADUC_TlsSessionCache_IsCurlSupported(nullptr));
+}
+
+TEST_CASE("ADUC_TlsSessionCache_GetEndpointName")
+{
+    char name[64];
+
+    CHECK(ADUC_TlsSessionCache_GetEndpointName("https://CDN.example.com/a/b?c#d", name, sizeof(name)));
+    CHECK(std::string{ name } == "cdn.example.com_443");
+    CHECK(ADUC_TlsSessionCache_GetEndpointName("https://user@cdn.example.com:8443/a", name, sizeof(name)));
+    CHECK(std::string{ name } == "cdn.example.com_8443");
+    CHECK(ADUC_TlsSessionCache_GetEndpointName("HTTPS://[fe80::1]:8443", name, sizeof(name)));
+    CHECK(std::string{ name } == "fe80__1_8443");
+    CHECK(ADUC_TlsSessionCache_GetEndpointName("https://host_1", name, sizeof(name)));
+    CHECK(std::string{ name } == "host_1_443");
+
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName("http://cdn.example.com/a", name, sizeof(name)));
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName("https:///a", name, sizeof(name)));
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName("https://cdn.example.com:http/a", name, sizeof(name)));
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName("https://[fe80::1", name, sizeof(name)));
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName("https://cdn.example.com", name, 8));
+    CHECK_FALSE(ADUC_TlsSessionCache_GetEndpointName(nullptr, name, sizeof(name)));
+}
+
+TEST_CASE("ADUC_TlsSessionCache")
+{
+    TestFolder folder;
+    ADUC_TlsSessionCache_Policy policy;
+    ADUC_TlsSessionCache cache;
+
+    SECTION("Open creates a private folder")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), "curl 8.12.0"));
+
+        struct stat st;
+        REQUIRE(stat(folder.CacheFolder().c_str(), &st) == 0);
+        CHECK((st.st_mode & 0777) == 0700);
+
+        const std::string path = StoreSession(&cache, "https://cdn.example.com/file");
+        CHECK(path == folder.CacheFolder() + "/cdn.example.com_443.sessions");
+        REQUIRE(stat(path.c_str(), &st) == 0);
+        CHECK((st.st_mode & 0777) == 0600);
+
+        char otherPath[PATH_MAX];
+        CHECK_FALSE(ADUC_TlsSessionCache_GetSessionFile(&cache, "http://cdn.example.com/file", otherPath, PATH_MAX));
+        ADUC_TlsSessionCache_Close(&cache);
+        CHECK_FALSE(ADUC_TlsSessionCache_GetSessionFile(&cache, "https://cdn.example.com/file", otherPath, PATH_MAX));
+    }
+
+    SECTION("Sessions survive a reopen with the same credentials")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), "curl 8.12.0"));
+        const std::string path = StoreSession(&cache, "https://cdn.example.com/file");
+        ADUC_TlsSessionCache_Close(&cache);
+
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), "curl 8.12.0"));
+        CHECK(GetSessionFile(&cache, "https://cdn.example.com/other") == path);
+        CHECK(Exists(path));
+        ADUC_TlsSessionCache_Close(&cache);
+
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), "curl 8.13.0"));
+        CHECK_FALSE(Exists(path));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+
+    SECTION("A credential change drops all sessions")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), nullptr));
+        const std::string path = StoreSession(&cache, "https://a.example.com/file");
+
+        WriteFile(folder.CredentialFile(), "CA 2");
+        GetSessionFile(&cache, "https://b.example.com/file");
+        CHECK_FALSE(Exists(path));
+
+        // The same content under a new timestamp keeps the sessions.
+        StoreSession(&cache, "https://a.example.com/file");
+        SetAge(folder.CredentialFile(), 60);
+        GetSessionFile(&cache, "https://b.example.com/file");
+        CHECK(Exists(path));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+
+    SECTION("Expired and oversized sessions are dropped")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy(R"(,"maxAgeSeconds":60,"maxFileKB":1)").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), nullptr));
+
+        const std::string path = StoreSession(&cache, "https://a.example.com/file");
+        SetAge(path, 59);
+        CHECK(GetSessionFile(&cache, "https://a.example.com/file") == path);
+        CHECK(Exists(path));
+
+        SetAge(path, 61);
+        GetSessionFile(&cache, "https://a.example.com/file");
+        CHECK_FALSE(Exists(path));
+
+        GetSessionFile(&cache, "https://a.example.com/file");
+        WriteFile(path, std::string(1025, 's'));
+        ADUC_TlsSessionCache_FinishTransfer(&cache, path.c_str(), 0);
+        CHECK_FALSE(Exists(path));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+
+    SECTION("A full cache evicts the oldest session")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy(R"(,"maxEndpoints":2)").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), nullptr));
+
+        const std::string oldest = StoreSession(&cache, "https://a.example.com/file");
+        const std::string newer = StoreSession(&cache, "https://b.example.com/file");
+        SetAge(oldest, 30);
+        SetAge(newer, 20);
+
+        // An endpoint that has a session does not evict.
+        GetSessionFile(&cache, "https://b.example.com/file");
+        CHECK(Exists(oldest));
+
+        const std::string newest = StoreSession(&cache, "https://c.example.com/file");
+        CHECK_FALSE(Exists(oldest));
+        CHECK(Exists(newer));
+        CHECK(Exists(newest));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+
+    SECTION("A TLS failure drops the session of the endpoint")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), nullptr));
+
+        const std::string path = StoreSession(&cache, "https://a.example.com/file");
+        const std::string other = StoreSession(&cache, "https://b.example.com/file");
+
+        // CURLE_COULDNT_CONNECT is no TLS failure.
+        ADUC_TlsSessionCache_FinishTransfer(&cache, path.c_str(), 7);
+        CHECK(Exists(path));
+
+        // CURLE_PEER_FAILED_VERIFICATION
+        ADUC_TlsSessionCache_FinishTransfer(&cache, path.c_str(), 60);
+        CHECK_FALSE(Exists(path));
+        CHECK(Exists(other));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+
+    SECTION("Open for curl")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        CHECK_FALSE(ADUC_TlsSessionCache_OpenForCurl(
+            &cache, &policy, folder.DataFolder().c_str(), "curl 8.11.1 (x86_64-pc-linux-gnu)\nFeatures: SSLS-EXPORT"));
+        CHECK_FALSE(Exists(folder.CacheFolder()));
+
+        REQUIRE(ADUC_TlsSessionCache_OpenForCurl(
+            &cache, &policy, folder.DataFolder().c_str(), "curl 8.12.0 (x86_64-pc-linux-gnu)\nFeatures: SSLS-EXPORT"));
+        CHECK(std::string{ cache.folder } == folder.CacheFolder());
+        CHECK(std::string{ cache.salt } == "curl 8.12.0 (x86_64-pc-linux-gnu)");
+        ADUC_TlsSessionCache_Close(&cache);
+
+        REQUIRE(ADUC_TlsSessionCache_ParsePolicy(&policy, nullptr));
+        CHECK_FALSE(ADUC_TlsSessionCache_OpenForCurl(&cache, &policy, folder.DataFolder().c_str(), "curl 8.12.0"));
+    }
+
+    SECTION("A folder of another kind is refused")
+    {
+        REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+        REQUIRE(symlink("/tmp", folder.CacheFolder().c_str()) == 0);
+        CHECK_FALSE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), nullptr));
+
+        char path[PATH_MAX];
+        CHECK_FALSE(ADUC_TlsSessionCache_GetSessionFile(&cache, "https://a.example.com/file", path, PATH_MAX));
+        ADUC_TlsSessionCache_Close(&cache);
+    }
+}
+
+/**
+ * @brief Runs @p command and returns its output.
+ */
+static std::string RunCommand(const std::string& command)
+{
+    std::string output;
+    FILE* pipe = popen(command.c_str(), "r");
+    REQUIRE(pipe != nullptr);
+
+    char buffer[4096];
+    size_t size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    {
+        output.append(buffer, size);
+    }
+
+    pclose(pipe);
+    return output;
+}
+
+/**
+ * @brief Downloads from a local TLS server with curl and the cache, and checks that the server resumes the
+ * session of the first download in the later ones.
+ *
+ * Hidden, run it with: tls_session_cache_utils_unit_tests "[integration]"
+ * It needs the openssl command and curl 8.12 or later, and listens on port 44300 + pid % 1000 of localhost.
+ * "openssl s_server -www" answers with "New," for a full handshake and "Reused," for a resumed one, and
+ * counts the "session cache hits".
+ */
+TEST_CASE("ADUC_TlsSessionCache - resumption with a local TLS server", "[.][integration]")
+{
+    const std::string curlVersion = RunCommand("curl --version");
+    if (!ADUC_TlsSessionCache_IsCurlSupported(curlVersion.c_str()))
+    {
+        WARN("curl does not support --ssl-sessions, skipped: " << curlVersion.substr(0, curlVersion.find('\n')));
+        return;
+    }
+
+    TestFolder folder;
+    const std::string port = std::to_string(44300 + getpid() % 1000);
+    const std::string url = "https://localhost:" + port + "/";
+    const std::string keyFile = folder.CredentialFile() + ".key";
+
+    REQUIRE(
+        system(("openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost -days 1 -keyout '" + keyFile
+                + "' -out '" + folder.CredentialFile() + "' 2>/dev/null")
+                   .c_str())
+        == 0);
+
+    const pid_t server = fork();
+    REQUIRE(server != -1);
+    if (server == 0)
+    {
+        execlp(
+            "openssl",
+            "openssl",
+            "s_server",
+            "-www",
+            "-quiet",
+            "-accept",
+            port.c_str(),
+            "-cert",
+            folder.CredentialFile().c_str(),
+            "-key",
+            keyFile.c_str(),
+            nullptr);
+        _exit(EXIT_FAILURE);
+    }
+
+    ADUC_TlsSessionCache_Policy policy;
+    ADUC_TlsSessionCache cache;
+    REQUIRE(ParsePolicy(&policy, folder.Policy("").c_str()));
+    REQUIRE(ADUC_TlsSessionCache_Open(&cache, &policy, folder.CacheFolder().c_str(), curlVersion.c_str()));
+
+    std::string responses[3];
+    for (std::string& response : responses)
+    {
+        const std::string sessionFile = GetSessionFile(&cache, url.c_str());
+        for (int attempt = 0; attempt < 20 && response.empty(); attempt++)
+        {
+            response = RunCommand(
+                "curl -sS --retry-connrefused --retry 5 --cacert '" + folder.CredentialFile() + "' --ssl-sessions '"
+                + sessionFile + "' " + url);
+        }
+
+        ADUC_TlsSessionCache_FinishTransfer(&cache, sessionFile.c_str(), 0);
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, nullptr, 0);
+    ADUC_TlsSessionCache_Close(&cache);
+
+    CHECK(responses[0].find("\nNew, ") != std::string::npos);
+    CHECK(responses[1].find("\nReused, ") != std::string::npos);
+    CHECK(responses[2].find("\nReused, ") != std::string::npos);
+    CHECK(responses[2].find("   2 session cache hits") != std::string::npos);
+}
@@ -49,6 +49,17 @@ ADUC_Result workflow_init(const char* updateManifestJson, bool validateManifest,
 ADUC_Result
 workflow_init_from_file(const char* updateManifestFile, bool validateManifest, ADUC_WorkflowHandle* handle);
 
+/**
+ * @brief Instantiate and initialize workflow object with info from an already parsed update action.
+ *
+ * @param updateActionJsonValue The update action JSON value. The workflow takes ownership of it, also on failure.
+ * @param validateManifest A boolean indicates whether to validate the manifest signature.
+ * @param handle A workflow object handle with information about the workflow.
+ * @return ADUC_Result
+ */
+ADUC_Result
+workflow_init_from_value(JSON_Value* updateActionJsonValue, bool validateManifest, ADUC_WorkflowHandle* handle);
+
 /**
  * @brief Instantiate and initialize workflow object with info from the @p sourceHandle inline step.
  *
@@ -722,6 +733,18 @@ const char* workflow_peek_update_manifest_step_handler(ADUC_WorkflowHandle handl
 const char*
 workflow_peek_update_manifest_handler_properties_string(ADUC_WorkflowHandle handle, const char* propertyName);
 
+/**
+ * @brief Get a read-only handlerProperties object value.
+ *
+ * @param handle A workflow object handle.
+ * @param propertyName
+ *
+ * @return A read-only object value of specified property in handlerProperties map.
+ *         Returns NULL if specifed property doesnot exist, or not an 'object' type.
+ */
+const JSON_Object*
+workflow_peek_update_manifest_handler_properties_object(ADUC_WorkflowHandle handle, const char* propertyName);
+
 /**
  * @brief Gets a reference step update manifest file at specified index.
  *
@@ -783,6 +806,16 @@ ADUC_Result workflow_parse_peek_unprotected_workflow_properties(
     char** outRootkeyPkgUrl_optional,
     char** outWorkflowId_optional);
 
+/**
+ * @brief Serializes the acknowledgement of a desired update action.
+ * @details To reduce the twin size, the acknowledgement omits the update manifest signature and the file urls,
+ * which are set to null in @p updateActionJsonObj.
+ *
+ * @param updateActionJsonObj The JSON object of the update action JSON.
+ * @return char* The serialized acknowledgement, or NULL on failure. Caller must call json_free_serialized_string().
+ */
+char* workflow_serialize_update_action_ack(JSON_Object* updateActionJsonObj);
+
 /**
  * @brief Allocate and initialize a workflow handle onto the workflow Data.
  *
@@ -807,6 +807,30 @@ done:
     return result;
 }
 
+/**
+ * @brief Serializes the acknowledgement of a desired update action.
+ * @details To reduce the twin size, the acknowledgement omits the update manifest signature and the file urls,
+ * which are set to null in @p updateActionJsonObj.
+ *
+ * @param updateActionJsonObj The JSON object of the update action JSON.
+ * @return char* The serialized acknowledgement, or NULL on failure. Caller must call json_free_serialized_string().
+ */
+char* workflow_serialize_update_action_ack(JSON_Object* updateActionJsonObj)
+{
+    if (updateActionJsonObj == NULL)
+    {
+        return NULL;
+    }
+
+    if (json_object_set_null(updateActionJsonObj, ADUCITF_FIELDNAME_UPDATEMANIFESTSIGNATURE) != JSONSuccess
+        || json_object_set_null(updateActionJsonObj, ADUCITF_FIELDNAME_FILE_URLS) != JSONSuccess)
+    {
+        return NULL;
+    }
+
+    return json_serialize_to_string(json_object_get_wrapping_value(updateActionJsonObj));
+}
+
 /**
  * @brief Helper function for checking the hash of the updatemanifest is equal to the
  * hash held within the signature
@@ -1225,25 +1249,24 @@ done:
 }
 
 /**
- * @brief A helper function for parsing workflow data from file, or from string.
+ * @brief A helper function for parsing workflow data from file, from string, or from a parsed value.
  *
- * @param updateActionJson The update action JSON value.
+ * @param updateActionJson The update action JSON value. The workflow takes ownership of it, also on failure.
  * @param validateManifest A boolean indicates whether to validate the manifest.
  * @param handle An output workflow object handle.
  * @return ADUC_Result The result.
  */
-ADUC_Result _workflow_parse(const JSON_Value* updateActionJson, bool validateManifest, ADUC_WorkflowHandle* handle)
+ADUC_Result _workflow_parse(JSON_Value* updateActionJson, bool validateManifest, ADUC_WorkflowHandle* handle)
 {
     ADUC_Result result = { .ResultCode = ADUC_GeneralResult_Failure, .ExtendedResultCode = 0 };
 
     ADUC_Workflow* wf = NULL;
-    JSON_Value* updateActionJsonClone = NULL;
     ADUCITF_UpdateAction updateAction = ADUCITF_UpdateAction_Undefined;
 
     if (handle == NULL)
     {
         result.ExtendedResultCode = ADUC_ERC_UTILITIES_WORKFLOW_UTIL_ERROR_BAD_PARAM;
-        return result;
+        goto done;
     }
 
     *handle = NULL;
@@ -1257,13 +1280,10 @@ ADUC_Result _workflow_parse(const JSON_Value* updateActionJson, bool validateMan
 
     memset(wf, 0, sizeof(*wf));
 
-    updateActionJsonClone = json_value_deep_copy(updateActionJson);
+    // commit ownership of the JSON_Value to the workflow's UpdateActionObject.
+    wf->UpdateActionObject = json_value_get_object(updateActionJson);
     updateActionJson = NULL;
 
-    // commit ownership of cloned JSON_Value to the workflow's UpdateActionObject.
-    wf->UpdateActionObject = json_value_get_object(updateActionJsonClone);
-    updateActionJsonClone = NULL;
-
     // At this point, we have had a side-effect of committing to the
     // wf->UpdateActionObject.
     //
@@ -1342,13 +1362,12 @@ ADUC_Result _workflow_parse(const JSON_Value* updateActionJson, bool validateMan
 
 done:
 
-    if (updateActionJsonClone != NULL)
-    {
-        json_value_free(updateActionJsonClone);
-    }
+    json_value_free(updateActionJson);
 
-    if (IsAducResultCodeFailure(result.ResultCode))
+    if (IsAducResultCodeFailure(result.ResultCode) && wf != NULL)
     {
+        json_value_free(json_object_get_wrapping_value(wf->UpdateActionObject));
+        json_value_free(json_object_get_wrapping_value(wf->UpdateManifestObject));
         free(wf);
         wf = NULL;
     }
@@ -2592,6 +2611,7 @@ workflow_init_from_file(const char* updateManifestFile, bool validateManifest, A
     }
 
     result = _workflow_parse(rootJsonValue, validateManifest, &workflowHandle);
+    rootJsonValue = NULL;
     if (IsAducResultCodeFailure(result.ResultCode))
     {
         goto done;
@@ -2883,7 +2903,43 @@ ADUC_Result workflow_init(const char* updateManifestJsonStr, bool validateManife
         goto done;
     }
 
-    result = _workflow_parse(rootJsonValue, validateManifest, handle);
+    result = workflow_init_from_value(rootJsonValue, validateManifest, handle);
+
+done:
+
+    return result;
+}
+
+/**
+ * @brief Instantiate and initialize workflow object with info from the already parsed update action.
+ *
+ * @param updateActionJsonValue The update action JSON value. The workflow takes ownership of it, also on failure.
+ * @param validateManifest A boolean indicates whether to validate the update manifest.
+ * @param handle An output workflow object handle.
+ * @return ADUC_Result
+ */
+ADUC_Result
+workflow_init_from_value(JSON_Value* updateActionJsonValue, bool validateManifest, ADUC_WorkflowHandle* handle)
+{
+    ADUC_Result result = { .ResultCode = ADUC_GeneralResult_Failure, .ExtendedResultCode = 0 };
+
+    if (updateActionJsonValue == NULL || handle == NULL)
+    {
+        result.ExtendedResultCode = ADUC_ERC_UTILITIES_WORKFLOW_UTIL_ERROR_BAD_PARAM;
+        goto done;
+    }
+
+    memset(handle, 0, sizeof(*handle));
+
+    if (json_value_get_type(updateActionJsonValue) != JSONObject)
+    {
+        Log_Error("Invalid json root type.");
+        result.ExtendedResultCode = ADUC_ERC_UTILITIES_UPDATE_DATA_PARSER_INVALID_ACTION_JSON;
+        goto done;
+    }
+
+    result = _workflow_parse(updateActionJsonValue, validateManifest, handle);
+    updateActionJsonValue = NULL;
     if (IsAducResultCodeFailure(result.ResultCode))
     {
         goto done;
@@ -2899,7 +2955,7 @@ ADUC_Result workflow_init(const char* updateManifestJsonStr, bool validateManife
     result.ResultCode = ADUC_GeneralResult_Success;
 done:
 
-    json_value_free(rootJsonValue);
+    json_value_free(updateActionJsonValue);
 
     if (IsAducResultCodeFailure(result.ResultCode))
     {
@@ -3928,6 +3984,22 @@ workflow_peek_update_manifest_handler_properties_string(ADUC_WorkflowHandle hand
     return json_object_get_string(properties, propertyName);
 }
 
+/**
+ * @brief Get a read-only handlerProperties object value.
+ *
+ * @param handle A workflow object handle.
+ * @param propertyName
+ *
+ * @return A read-only object value of specified property in handlerProperties map.
+ */
+const JSON_Object*
+workflow_peek_update_manifest_handler_properties_object(ADUC_WorkflowHandle handle, const char* propertyName)
+{
+    const JSON_Object* manifest = _workflow_get_update_manifest(handle);
+    const JSON_Object* properties = json_object_get_object(manifest, STEP_PROPERTY_FIELD_HANDLER_PROPERTIES);
+    return json_object_get_object(properties, propertyName);
+}
+
 /**
  * @brief Returns whether the specified step is an 'inline' step.
  *
@@ -13,6 +13,9 @@
 #include <catch2/catch.hpp>
 using Catch::Matchers::Equals;
 
+#include <fstream>
+#include <iterator>
+#include <parson.h>
 #include <sstream>
 #include <string>
 
@@ -728,3 +731,113 @@ TEST_CASE("Request workflow cancellation")
 
     workflow_free(handle);
 }
+
+static std::string get_update_action_ack_test_file_path(const char* fileName)
+{
+    std::string path{ ADUC_TEST_DATA_FOLDER };
+    path += "/update_action_ack/";
+    path += fileName;
+    return path;
+}
+
+static std::string read_test_file(const std::string& path)
+{
+    std::ifstream file{ path, std::ios::binary };
+    REQUIRE(file.is_open());
+    std::string content{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+    return content.substr(0, content.find_last_not_of("\r\n") + 1);
+}
+
+static std::string serialize_update_action_ack(JSON_Value* updateActionValue)
+{
+    char* ack = workflow_serialize_update_action_ack(json_value_get_object(updateActionValue));
+    REQUIRE(ack != nullptr);
+    std::string ackString{ ack };
+    json_free_serialized_string(ack);
+    return ackString;
+}
+
+TEST_CASE("workflow_serialize_update_action_ack")
+{
+    JSON_Value* updateActionValue =
+        json_parse_file(get_update_action_ack_test_file_path("updateAction.json").c_str());
+    REQUIRE(updateActionValue != nullptr);
+
+    SECTION("Matches the golden ACK")
+    {
+        CHECK(
+            serialize_update_action_ack(updateActionValue)
+            == read_test_file(get_update_action_ack_test_file_path("expectedAck.json")));
+    }
+
+    SECTION("Matches the ACK of the re-parsed property value")
+    {
+        // The property value used to be serialized and parsed again before the ACK was built from it.
+        char* serialized = json_serialize_to_string(updateActionValue);
+        REQUIRE(serialized != nullptr);
+        JSON_Value* reparsedValue = json_parse_string(serialized);
+        json_free_serialized_string(serialized);
+        REQUIRE(reparsedValue != nullptr);
+
+        CHECK(serialize_update_action_ack(updateActionValue) == serialize_update_action_ack(reparsedValue));
+
+        json_value_free(reparsedValue);
+    }
+
+    SECTION("Invalid input")
+    {
+        CHECK(workflow_serialize_update_action_ack(nullptr) == nullptr);
+    }
+
+    json_value_free(updateActionValue);
+}
+
+TEST_CASE("workflow_init_from_value")
+{
+    SECTION("Matches workflow_init")
+    {
+        ADUC_WorkflowHandle stringHandle = nullptr;
+        ADUC_Result result = workflow_init(action_parent_update, false /* validateManifest */, &stringHandle);
+        REQUIRE(IsAducResultCodeSuccess(result.ResultCode));
+
+        ADUC_WorkflowHandle valueHandle = nullptr;
+        result = workflow_init_from_value(
+            json_parse_string(action_parent_update), false /* validateManifest */, &valueHandle);
+        REQUIRE(IsAducResultCodeSuccess(result.ResultCode));
+
+        CHECK(workflow_get_action(valueHandle) == workflow_get_action(stringHandle));
+        CHECK_THAT(workflow_peek_id(valueHandle), Equals(workflow_peek_id(stringHandle)));
+        CHECK(workflow_get_update_files_count(valueHandle) == workflow_get_update_files_count(stringHandle));
+
+        char* stringManifest = workflow_get_serialized_update_manifest(stringHandle, false /* pretty */);
+        char* valueManifest = workflow_get_serialized_update_manifest(valueHandle, false /* pretty */);
+        REQUIRE(stringManifest != nullptr);
+        CHECK_THAT(valueManifest, Equals(stringManifest));
+        workflow_free_string(stringManifest);
+        workflow_free_string(valueManifest);
+
+        ADUC_FileEntity stringFile = {};
+        ADUC_FileEntity valueFile = {};
+        REQUIRE(workflow_get_update_file(stringHandle, 0, &stringFile));
+        REQUIRE(workflow_get_update_file(valueHandle, 0, &valueFile));
+        CHECK_THAT(valueFile.DownloadUri, Equals(stringFile.DownloadUri));
+        ADUC_FileEntity_Uninit(&stringFile);
+        ADUC_FileEntity_Uninit(&valueFile);
+
+        workflow_free(stringHandle);
+        workflow_free(valueHandle);
+    }
+
+    SECTION("Invalid input")
+    {
+        ADUC_WorkflowHandle handle = nullptr;
+
+        ADUC_Result result = workflow_init_from_value(json_value_init_array(), false /* validateManifest */, &handle);
+        CHECK(IsAducResultCodeFailure(result.ResultCode));
+        CHECK(result.ExtendedResultCode == ADUC_ERC_UTILITIES_UPDATE_DATA_PARSER_INVALID_ACTION_JSON);
+        CHECK(handle == nullptr);
+
+        result = workflow_init_from_value(nullptr, false /* validateManifest */, &handle);
+        CHECK(result.ExtendedResultCode == ADUC_ERC_UTILITIES_WORKFLOW_UTIL_ERROR_BAD_PARAM);
+    }
+}